@@ -39,6 +39,10 @@
 #include "config.h"
 #include "led_strip.h"
 #include "message.h"
+#include "clock_sync.h"
+#include "events.h"
+#include "web_snapshot.h"
+#include "fixed_format.h"
 // #include "altcp_tls_mbedtls_structs.h"
 // #include "powerwall.h"
 #include "pluto.h"
@@ -104,6 +108,9 @@ void anemometer_task(void *params)
     int lowest_adc_reading = 819;
     int highest_adc_reading = 4095;
     int range_of_adc_readings = 4095 - 819;
+    int wind_speed;
+    uint64_t sample_time_us;
+    char speed_string[FFMT_NUMBER_MAX];
 
     if (strcasecmp(APP_NAME, "Anemometer") == 0)
     {
@@ -131,6 +138,7 @@ void anemometer_task(void *params)
     {
         // Read the raw ADC value
         result = adc_read();
+        sample_time_us = clock_sync_get_time_us();
         
         // Print the value to the console
         printf("Raw ADC value: %u\t", result);
@@ -145,28 +153,34 @@ void anemometer_task(void *params)
             lowest_adc_reading = result;
         }
 
-        // update web interface
-        web.anemometer_adc_max = highest_adc_reading;
-        web.anemometer_adc_min = lowest_adc_reading;
-
         range_of_adc_readings = highest_adc_reading - lowest_adc_reading;
 
 
         if (result < 819)
         {
             // at or below minimum measurable wind speed
-            web.anemometer_wind_speed = 0;
+            wind_speed = 0;
         }
         else
         {
             // wind speed = (I-4)/16*A+B  where I = current in mA, A = wind speed range (0 to 45m/s), B = lowest wind speed (0.8 m/s)
-            web.anemometer_wind_speed = ((((result - lowest_adc_reading)*100)/range_of_adc_readings)*45 + 80)/10;            
+            wind_speed = ((((result - lowest_adc_reading)*100)/range_of_adc_readings)*45 + 80)/10;            
         }
 
         // compute moving average
-        web.anemometer_wind_speed = anemometer_get_moving_average_wind_speed(web.anemometer_wind_speed);
+        wind_speed = anemometer_get_moving_average_wind_speed(wind_speed);
+
+        // update web interface
+        web_write_begin(WEB_GROUP_WIND);
+        web.anemometer_sample_time_us = sample_time_us;
+        web.anemometer_adc_max = highest_adc_reading;
+        web.anemometer_adc_min = lowest_adc_reading;
+        web.anemometer_wind_speed = wind_speed;
+        web_write_end(WEB_GROUP_WIND);
+        events_publish(EVENT_WIND);
 
-        printf("Wind Speed = %c%ld.%ld m/s\n", web.anemometer_wind_speed<0?'-':' ', abs(web.anemometer_wind_speed)/10, abs(web.anemometer_wind_speed%10));
+        ffmt_fixed(speed_string, sizeof(speed_string), wind_speed, 1, ' ');
+        printf("Wind Speed = %s m/s\n", speed_string);
 
         SLEEP_MS(1000);
 
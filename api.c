@@ -0,0 +1,463 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/mem.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "weather.h"
+#include "config.h"
+#include "clock_sync.h"
+#include "store_forward.h"
+#include "pluto.h"
+#include "json_writer.h"
+#include "custom_files.h"
+#include "api.h"
+#include "events.h"
+#include "ssi_render.h"
+#include "web_snapshot.h"
+#ifdef INCORPORATE_HOME_CONTROLLER
+#include "hc_rules.h"
+#include "hc_task.h"
+#endif
+
+#ifdef USE_GIT_HASH_AS_VERSION
+#include "githash.h"
+#endif
+
+/*
+ * Machine readable api
+ *
+ * Each endpoint takes a snapshot of the web variable groups it reports before writing anything, so that values
+ * derived from one another (e.g. a reading and its sample time) always come from the same update.  The json is written straight
+ * into the response buffer behind space reserved for the http header, and the header is placed in front of it once
+ * the body length is known.  Units are always metric (tenths kept as one decimal place) regardless of the web ui
+ * setting, except for the thermostat which reports in its configured units.
+ */
+
+typedef struct
+{
+    int length;
+    int offset;
+    const char *start;
+    char data[API_RESPONSE_MAX];
+} API_RESPONSE_T;
+
+typedef void (*API_WRITER_T)(JSON_WRITER_T *writer);
+
+// prototypes
+static void *api_respond(API_WRITER_T writer_function, int *length);
+static int api_wind_speed(const WEB_WIND_T *wind, const WEB_WEATHER_T *weather);
+
+// external variables
+extern WEB_VARIABLES_T web;
+extern NON_VOL_VARIABLES_T config;
+extern uint32_t unix_time;
+
+/*!
+ * \brief Open /api/v1/wind
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length
+ *
+ * \return response state or NULL
+ */
+void *api_wind_open(__unused const char *name, int *length)
+{
+    return(api_respond(api_write_wind, length));
+}
+
+/*!
+ * \brief Open /api/v1/weather
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length
+ *
+ * \return response state or NULL
+ */
+void *api_weather_open(__unused const char *name, int *length)
+{
+    return(api_respond(api_write_weather, length));
+}
+
+#ifdef INCORPORATE_THERMOSTAT
+/*!
+ * \brief Open /api/v1/thermostat
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length
+ *
+ * \return response state or NULL
+ */
+void *api_thermostat_open(__unused const char *name, int *length)
+{
+    return(api_respond(api_write_thermostat, length));
+}
+#endif
+
+/*!
+ * \brief Open /api/v1/status
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length
+ *
+ * \return response state or NULL
+ */
+void *api_status_open(__unused const char *name, int *length)
+{
+    return(api_respond(api_write_status, length));
+}
+
+#ifdef INCORPORATE_HOME_CONTROLLER
+/*!
+ * \brief Open /api/v1/rules
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length
+ *
+ * \return response state or NULL
+ */
+void *api_rules_open(__unused const char *name, int *length)
+{
+    return(api_respond(api_write_rules, length));
+}
+#endif
+
+/*!
+ * \brief Copy the next part of a response into the tcp send buffer
+ *
+ * \param[in]   state     response state
+ * \param[out]  buffer    destination
+ * \param[in]   count     size of destination
+ *
+ * \return bytes copied
+ */
+int api_read(void *state, char *buffer, int count)
+{
+    API_RESPONSE_T *response = (API_RESPONSE_T *)state;
+
+    if (count > response->length - response->offset)
+    {
+        count = response->length - response->offset;
+    }
+
+    memcpy(buffer, response->start + response->offset, count);
+    response->offset += count;
+
+    return(count);
+}
+
+/*!
+ * \brief Release a response
+ *
+ * \param[in]   state     response state
+ *
+ * \return nothing
+ */
+void api_close(void *state)
+{
+    mem_free(state);
+}
+
+/*!
+ * \brief Build a complete response
+ *
+ * \param[in]   writer_function   writes the json body
+ * \param[out]  length            total response length
+ *
+ * \return response state or NULL if out of memory or the body did not fit
+ */
+static void *api_respond(API_WRITER_T writer_function, int *length)
+{
+    API_RESPONSE_T *response;
+    JSON_WRITER_T writer;
+    char header[CUSTOM_FILE_HEADER_MAX];
+    int header_length;
+    int body_length;
+
+    response = (API_RESPONSE_T *)mem_malloc(sizeof(API_RESPONSE_T));
+    if (!response)
+    {
+        return(NULL);
+    }
+
+    jsonw_init(&writer, response->data + CUSTOM_FILE_HEADER_MAX, sizeof(response->data) - CUSTOM_FILE_HEADER_MAX);
+    writer_function(&writer);
+    body_length = jsonw_finish(&writer);
+
+    header_length = custom_file_header(header, sizeof(header), "application/json", body_length);
+
+    if ((body_length < 0) || (header_length >= (int)sizeof(header)))
+    {
+        printf("api: response does not fit in %d bytes\n", API_RESPONSE_MAX);
+        mem_free(response);
+        return(NULL);
+    }
+
+    // header goes immediately in front of the body
+    response->start = response->data + CUSTOM_FILE_HEADER_MAX - header_length;
+    memcpy((char *)response->start, header, header_length);
+    response->length = header_length + body_length;
+    response->offset = 0;
+
+    *length = response->length;
+
+    return(response);
+}
+
+/*!
+ * \brief Write /api/v1/wind
+ *
+ * \param[in]   writer    json writer
+ *
+ * \return nothing
+ */
+void api_write_wind(JSON_WRITER_T *writer)
+{
+    bool from_anemometer = (config.anemometer_remote_enable) || (config.personality == ANEMOMETER);
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+
+    web_snapshot_wind(&wind);
+    web_snapshot_weather(&weather);
+
+    jsonw_object_begin(writer, NULL);
+    jsonw_fixed(writer, "speed", api_wind_speed(&wind, &weather), 1);
+    jsonw_string(writer, "units", "m/s");
+    jsonw_string(writer, "source", from_anemometer ? "anemometer" : "weather_station");
+    if (from_anemometer && wind.sample_time_us)
+    {
+        jsonw_uint64(writer, "sample_time_us", wind.sample_time_us);
+    }
+    else
+    {
+        jsonw_null(writer, "sample_time_us");
+    }
+    jsonw_bool(writer, "clock_synchronised", clock_sync_synchronised());
+    jsonw_object_end(writer);
+}
+
+/*!
+ * \brief Write /api/v1/weather
+ *
+ * \param[in]   writer    json writer
+ *
+ * \return nothing
+ */
+void api_write_weather(JSON_WRITER_T *writer)
+{
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+    int i;
+
+    web_snapshot_wind(&wind);
+    web_snapshot_weather(&weather);
+
+    jsonw_object_begin(writer, NULL);
+    jsonw_fixed(writer, "temperature", weather.outside_temperature, 1);
+    jsonw_fixed(writer, "wind_speed", api_wind_speed(&wind, &weather), 1);
+    jsonw_fixed(writer, "wind_gust", weather.wind_gust, 1);
+    jsonw_fixed(writer, "rain_day", weather.daily_rain, 1);
+    jsonw_fixed(writer, "rain_week", weather.weekly_rain, 1);
+    jsonw_fixed(writer, "rain_seven_days", weather.trailing_seven_days_rain, 1);
+    jsonw_array_begin(writer, "soil_moisture");
+    for (i = 0; i < (int)NUM_ROWS(weather.soil_moisture); i++)
+    {
+        jsonw_int(writer, NULL, weather.soil_moisture[i]);
+    }
+    jsonw_array_end(writer);
+    if (weather.us_last_rx_packet)
+    {
+        jsonw_int(writer, "last_packet_age_s", (time_us_32() - weather.us_last_rx_packet)/1000000);
+    }
+    else
+    {
+        jsonw_null(writer, "last_packet_age_s");
+    }
+    jsonw_object_end(writer);
+}
+
+#ifdef INCORPORATE_THERMOSTAT
+/*!
+ * \brief Write /api/v1/thermostat
+ *
+ * \param[in]   writer    json writer
+ *
+ * \return nothing
+ */
+void api_write_thermostat(JSON_WRITER_T *writer)
+{
+    static const char *mode_names[] = {"auto", "off", "heating_only", "cooling_only", "fan_only", "heat_and_cool"};
+    WEB_THERMOSTAT_T thermostat;
+
+    web_snapshot_thermostat(&thermostat);
+
+    jsonw_object_begin(writer, NULL);
+    jsonw_string(writer, "units", config.use_archaic_units ? "F" : "C");
+    if (thermostat.temperature == TEMPERATURE_INVALID)
+    {
+        jsonw_null(writer, "temperature");
+    }
+    else
+    {
+        jsonw_fixed(writer, "temperature", thermostat.temperature, 1);
+    }
+    jsonw_fixed(writer, "set_point", thermostat.set_point, 1);
+    jsonw_fixed(writer, "heating_set_point", thermostat.heating_set_point, 1);
+    jsonw_fixed(writer, "cooling_set_point", thermostat.cooling_set_point, 1);
+    jsonw_string(writer, "mode", ((unsigned)thermostat.effective_mode < NUM_ROWS(mode_names)) ? mode_names[thermostat.effective_mode] : "unknown");
+    jsonw_fixed(writer, "moving_average", thermostat.moving_average, 1);
+    jsonw_int(writer, "gradient", thermostat.gradient);
+    jsonw_int(writer, "samples_to_set_point", thermostat.prediction);
+    jsonw_object_end(writer);
+}
+#endif
+
+/*!
+ * \brief Write /api/v1/status
+ *
+ * \param[in]   writer    json writer
+ *
+ * \return nothing
+ */
+void api_write_status(JSON_WRITER_T *writer)
+{
+    STORE_FORWARD_STATS_T syslog_queue;
+    EVENTS_STATS_T events;
+    SSI_RENDER_STATS_T pages;
+    WEB_NETWORK_T network;
+
+    store_forward_get_stats(&syslog_queue);
+    events_get_stats(&events);
+    ssi_render_get_stats(&pages);
+    web_snapshot_network(&network);
+
+    jsonw_object_begin(writer, NULL);
+    jsonw_string(writer, "app", APP_NAME);
+    jsonw_string(writer, "version", PLUTO_VER);
+#ifdef USE_GIT_HASH_AS_VERSION
+    jsonw_string(writer, "build", GITHASH);
+#else
+    jsonw_string(writer, "build", PLUTO_VER);
+#endif
+    jsonw_int(writer, "personality", config.personality);
+    jsonw_uint64(writer, "uptime_s", time_us_64()/1000000);
+    jsonw_uint64(writer, "unix_time", unix_time);
+    jsonw_bool(writer, "clock_synchronised", clock_sync_synchronised());
+    jsonw_string(writer, "status", web.status_message);
+    jsonw_string(writer, "watchdog_time", web.watchdog_timestring);
+
+    jsonw_object_begin(writer, "network");
+    jsonw_bool(writer, "access_point_mode", network.access_point_mode);
+    jsonw_string(writer, "ip", network.ip_address_string);
+    jsonw_string(writer, "netmask", network.network_mask_string);
+    jsonw_string(writer, "gateway", network.gateway_string);
+    jsonw_object_end(writer);
+
+    jsonw_object_begin(writer, "failures");
+    jsonw_int(writer, "socket_max", web.socket_max);
+    jsonw_int(writer, "bind", web.bind_failures);
+    jsonw_int(writer, "connect", web.connect_failures);
+    jsonw_int(writer, "syslog", web.syslog_transmit_failures);
+    jsonw_int(writer, "govee", web.govee_transmit_failures);
+    jsonw_int(writer, "weather_station", web.weather_station_transmit_failures);
+    jsonw_int(writer, "pluto", web.pluto_transmit_failures);
+    jsonw_object_end(writer);
+
+    jsonw_object_begin(writer, "syslog_queue");
+    jsonw_int(writer, "queued", syslog_queue.queued);
+    jsonw_int(writer, "dropped", syslog_queue.dropped);
+    jsonw_int(writer, "replayed", syslog_queue.replayed);
+    jsonw_object_end(writer);
+
+    jsonw_object_begin(writer, "events");
+    jsonw_int(writer, "connections", events.connections);
+    jsonw_int(writer, "refused", events.refused);
+    jsonw_int(writer, "coalesced", events.coalesced);
+    jsonw_object_end(writer);
+
+    jsonw_object_begin(writer, "pages");
+    jsonw_int(writer, "deferred", pages.deferred);
+    jsonw_int(writer, "declined", pages.declined);
+    jsonw_int(writer, "render_max_us", pages.render_max_us);
+    jsonw_object_end(writer);
+
+    jsonw_object_end(writer);
+}
+
+#ifdef INCORPORATE_HOME_CONTROLLER
+/*!
+ * \brief Write /api/v1/rules
+ *
+ * \param[in]   writer    json writer
+ *
+ * \return nothing
+ */
+void api_write_rules(JSON_WRITER_T *writer)
+{
+    static char text[HC_RULES_TEXT_MAX];
+    HC_TASK_RULES_STATUS_T status;
+    HC_RULE_T rule;
+    bool truncated = false;
+    int i;
+
+    hc_task_rules_status(&status);
+
+    jsonw_object_begin(writer, NULL);
+    jsonw_string(writer, "error", status.error);
+    jsonw_array_begin(writer, "rules");
+    for (i = 0; !hc_rules_get(config.hc_rules, sizeof(config.hc_rules), i, &rule); i++)
+    {
+        hc_rules_format(&rule, text, sizeof(text));
+
+        // leave room for the statistics
+        if (writer->length + (int)strlen(text) + 256 > writer->size)
+        {
+            truncated = true;
+            break;
+        }
+
+        jsonw_object_begin(writer, NULL);
+        jsonw_string(writer, "rule", text);
+        jsonw_string(writer, "state", (status.fired & (1UL << i)) ? "fired" : (status.holding & (1UL << i)) ? "holding" : "armed");
+        jsonw_object_end(writer);
+    }
+    jsonw_array_end(writer);
+    jsonw_bool(writer, "truncated", truncated);
+    jsonw_int(writer, "evaluations", status.evaluations);
+    jsonw_int(writer, "actions", status.actions);
+    jsonw_int(writer, "failures", status.failures);
+    jsonw_int(writer, "passes", status.passes);
+    jsonw_int(writer, "last_us", status.last_us);
+    jsonw_int(writer, "worst_us", status.worst_us);
+    jsonw_object_end(writer);
+}
+#endif
+
+/*!
+ * \brief Wind speed from the same source the web ui shows
+ *
+ * \param[in]   wind      anemometer snapshot
+ * \param[in]   weather   weather station snapshot
+ *
+ * \return wind speed in tenths of m/s
+ */
+static int api_wind_speed(const WEB_WIND_T *wind, const WEB_WEATHER_T *weather)
+{
+    if ((config.anemometer_remote_enable) || (config.personality == ANEMOMETER))
+    {
+        return(wind->wind_speed);
+    }
+
+    return(weather->wind_speed);
+}
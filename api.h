@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef API_H
+#define API_H
+
+#include "json_writer.h"
+
+#define API_RESPONSE_MAX    (1024)      // header and body of the largest response
+
+// custom files serving /api/v1/..., see html_common/api/v1/schema.json
+void *api_wind_open(const char *name, int *length);
+void *api_weather_open(const char *name, int *length);
+#ifdef INCORPORATE_THERMOSTAT
+void *api_thermostat_open(const char *name, int *length);
+#endif
+void *api_status_open(const char *name, int *length);
+#ifdef INCORPORATE_HOME_CONTROLLER
+void *api_rules_open(const char *name, int *length);
+#endif
+int api_read(void *state, char *buffer, int count);
+void api_close(void *state);
+
+// response bodies, also sent by /events
+void api_write_wind(JSON_WRITER_T *writer);
+void api_write_weather(JSON_WRITER_T *writer);
+#ifdef INCORPORATE_THERMOSTAT
+void api_write_thermostat(JSON_WRITER_T *writer);
+#endif
+void api_write_status(JSON_WRITER_T *writer);
+#ifdef INCORPORATE_HOME_CONTROLLER
+void api_write_rules(JSON_WRITER_T *writer);
+#endif
+
+#endif
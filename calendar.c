@@ -37,6 +37,7 @@
 #include "time.h"
 #include "utility.h"
 #include "config.h"
+#include "fixed_format.h"
 
 
 //#define IRRIGATION_TEST (1)
@@ -61,6 +62,9 @@ static int daylight_saving_end_month;
 static int daylight_saving_end_day;
 static int irrigation_test_start_mow = -1;
 
+// prototypes
+static void format_timestamp(datetime_t *t, char *timestamp, int len, int isoformat, int localtime);
+
 
 const char *weekdays[] =
 {
@@ -431,7 +435,6 @@ int get_timestamp(char *timestamp, int len, int isoformat, int localtime)
 {
    int ok = 0;
    datetime_t t;
-   char timezone_offset[12];
 
 #ifdef FAKE_RTC
    if (localtime)
@@ -446,33 +449,7 @@ int get_timestamp(char *timestamp, int len, int isoformat, int localtime)
 
    if (ok)
    {
-      if (!localtime || (config.timezone_offset == 0)) 
-      {
-         // zulu time
-         if (isoformat)
-         {
-            sprintf(timezone_offset, "Z");
-         }
-         else
-         {
-            sprintf(timezone_offset, "");
-         }
-      }
-      else
-      {
-         sprintf(timezone_offset, "%c%02d:%02d", config.timezone_offset<0?'-':'+', abs(config.timezone_offset/60), abs(config.timezone_offset%60));
-      }
-
-      if (isoformat)
-      {
-         // iso format needed for syslog
-         snprintf(timestamp, len, "%04d-%02d-%02dT%02d:%02d:%02d.000%s", t.year, t.month, t.day, t.hour, t.min, t.sec, timezone_offset);
-      }
-      else
-      {
-        // human readable format
-        snprintf(timestamp, len, "%04d-%02d-%02d %02d:%02d:%02d UTC%s", t.year, t.month, t.day, t.hour, t.min, t.sec, timezone_offset);
-      }
+      format_timestamp(&t, timestamp, len, isoformat, localtime);
     }
     else
     {
@@ -1119,40 +1096,13 @@ int get_timestamp_from_unix_time(uint32_t unixtime, char *timestamp, int len, in
 {
    int ok = 0;
    datetime_t t;
-   char timezone_offset[12];
 
 
    ok = get_datetime_from_unix_time(unixtime, &t, localtime);      
 
    if (ok)
    {
-      if (!localtime || (config.timezone_offset == 0)) 
-      {
-         // zulu time
-         if (isoformat)
-         {
-            sprintf(timezone_offset, "Z");
-         }
-         else
-         {
-            sprintf(timezone_offset, "");
-         }
-      }
-      else
-      {
-         sprintf(timezone_offset, "%c%02d:%02d", config.timezone_offset<0?'-':'+', abs(config.timezone_offset/60), abs(config.timezone_offset%60));
-      }
-
-      if (isoformat)
-      {
-         // iso format needed for syslog
-         snprintf(timestamp, len, "%04d-%02d-%02dT%02d:%02d:%02d.000%s", t.year, t.month, t.day, t.hour, t.min, t.sec, timezone_offset);
-      }
-      else
-      {
-        // human readable format
-        snprintf(timestamp, len, "%04d-%02d-%02d %02d:%02d:%02d UTC%s", t.year, t.month, t.day, t.hour, t.min, t.sec, timezone_offset);
-      }
+      format_timestamp(&t, timestamp, len, isoformat, localtime);
     }
     else
     {
@@ -1161,3 +1111,39 @@ int get_timestamp_from_unix_time(uint32_t unixtime, char *timestamp, int len, in
 
     return !ok;
 }
+
+/*!
+ * \brief Format a date and time as a time stamp without going through printf
+ *
+ * \param[in]   t           date and time
+ * \param[out]  timestamp   pointer to string to store the timestamp 
+ * \param[in]   len         max length of timestamp string  
+ * \param[in]   isoformat   use iso format
+ * \param[in]   localtime   t is local time
+ * 
+ * \return nothing
+ */
+static void format_timestamp(datetime_t *t, char *timestamp, int len, int isoformat, int localtime)
+{
+   char text[FFMT_TIMESTAMP_MAX + 12];
+   int printed;
+
+   printed = ffmt_timestamp(text, sizeof(text), t->year, t->month, t->day, t->hour, t->min, t->sec, isoformat?'T':' ');
+
+   // iso format needed for syslog, otherwise human readable
+   memcpy(text + printed, isoformat?".000":" UTC", 4);
+   printed += 4;
+
+   if (localtime && (config.timezone_offset != 0))
+   {
+      printed += ffmt_utc_offset(text + printed, sizeof(text) - printed, config.timezone_offset);
+   }
+   else if (isoformat)
+   {
+      // zulu time
+      text[printed++] = 'Z';
+   }
+   text[printed] = 0;
+
+   STRNCPY(timestamp, text, len);
+}
@@ -10,6 +10,7 @@
 #include "pico/types.h"
 #include "pico/stdlib.h"
 #include <string.h>
+#include <ctype.h>
 
  #include "hardware/watchdog.h"
 
@@ -30,6 +31,10 @@
 #include "thermostat.h"
 #include "worker_tasks.h"
 #include "pluto.h"
+#include "web_snapshot.h"
+#include "cgi_bind.h"
+#include "shelly_status.h"
+#include "hc_task.h"
 
 
 extern NON_VOL_VARIABLES_T config;
@@ -39,6 +44,22 @@ extern WORKER_TASK_T worker_tasks[];
 extern char current_calendar_web_page[50];
 static bool test_end_redirect = false;
 
+// form parameters bound to config fields, see cgi_bind.c
+#define CONFIG_INT(name, field, min, max)       CGI_BIND(name, CGI_BIND_INT, NON_VOL_VARIABLES_T, field, min, max, CGI_UNIT_NONE, NULL)
+#define CONFIG_TENTHS(name, field, min, max)    CGI_BIND(name, CGI_BIND_TENTHS, NON_VOL_VARIABLES_T, field, min, max, CGI_UNIT_NONE, NULL)
+#define CONFIG_MEASURE(name, field, unit)       CGI_BIND(name, CGI_BIND_TENTHS, NON_VOL_VARIABLES_T, field, INT32_MIN, INT32_MAX, unit, NULL)
+#define CONFIG_STRING(name, field)              CGI_BIND(name, CGI_BIND_STRING, NON_VOL_VARIABLES_T, field, 0, 0, CGI_UNIT_NONE, NULL)
+#define CONFIG_PASSWORD(name, field)            CGI_BIND(name, CGI_BIND_PASSWORD, NON_VOL_VARIABLES_T, field, 0, 0, CGI_UNIT_NONE, NULL)
+#define CONFIG_CHECKBOX(name, field)            CGI_BIND(name, CGI_BIND_CHECKBOX, NON_VOL_VARIABLES_T, field, 0, 1, CGI_UNIT_NONE, NULL)
+
+// prototypes
+static void led_pattern_applied(void);
+static void led_speed_applied(void);
+static const char *cgi_dispatch(int iIndex, int iNumParams, char *pcParam[], char *pcValue[]);
+#ifdef INCORPORATE_HOME_CONTROLLER
+static void cgi_url_decode(char *value);
+#endif
+
 
 /*!
  * \brief print all the parameters passed to a cgi handler
@@ -436,6 +457,8 @@ const char * cgi_time_handler(int iIndex, int iNumParams, char *pcParam[], char
     char *param = NULL;
     char *value = NULL;
     int new_value = 0;
+    bool clock_sync_form = false;
+    int clock_sync_enable = 0;
        
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
@@ -519,17 +542,50 @@ const char * cgi_time_handler(int iIndex, int iNumParams, char *pcParam[], char
                     config.daylightsaving_enable = 0;
                 }                              
             }
+
+            if (strcasecmp("csip", param) == 0)
+            {
+                // clock sync settings only appear on some personalities so only touch them if the form has them
+                STRNCPY(config.clock_sync_master_ip, value, sizeof(config.clock_sync_master_ip));
+                clock_sync_form = true;
+            }
+
+            if (strcasecmp("csen", param) == 0)
+            {
+                if (value[0])
+                {
+                    clock_sync_enable = 1;
+                } 
+            }
         }
 
         i++;
     }
 
+    if (clock_sync_form)
+    {
+        config.clock_sync_enable = clock_sync_enable;
+    }
+
 
     // Send the next page back to the user
     config_changed();
     return "/time.shtml";
 }
 
+// /ecowitt.cgi parameters
+static const CGI_BINDING_T ecowitt_bindings[] =
+{
+    CONFIG_CHECKBOX("wse", weather_station_enable),
+    CONFIG_STRING("ecoip", weather_station_ip),
+    CONFIG_MEASURE("wkrn", rain_week_threshold, CGI_UNIT_RAIN),
+    CONFIG_MEASURE("dyrn", rain_day_threshold, CGI_UNIT_RAIN),
+    CONFIG_INT("soilt1", soil_moisture_threshold[0], INT32_MIN, INT32_MAX),
+    CONFIG_MEASURE("wndt", wind_threshold, CGI_UNIT_SPEED),
+    CONFIG_MEASURE("tempth", outside_temperature_threshold, CGI_UNIT_TEMPERATURE),
+};
+CGI_FORM(ecowitt_form, ecowitt_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -542,70 +598,10 @@ const char * cgi_time_handler(int iIndex, int iNumParams, char *pcParam[], char
  */
 const char * cgi_ecowitt_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL; 
-
-    // despicable but necessary as we only receive parameter when checked
-    config.weather_station_enable = 0;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
- 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
 
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-
-            if (strcasecmp("wse", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.weather_station_enable = 1;
-                } 
-                else
-                {
-                    config.weather_station_enable = 0;  // should never happen
-                }                             
-            } 
-
-            if (strcasecmp("ecoip", param) == 0)
-            {
-                STRNCPY(config.weather_station_ip, value, sizeof(config.weather_station_ip));
-            }
-
-            if (strcasecmp("wkrn", param) == 0)
-            {
-                config.rain_week_threshold = get_int_with_tenths_from_string(value);  
-            }
-
-            if (strcasecmp("dyrn", param) == 0)
-            {
-                config.rain_day_threshold = get_int_with_tenths_from_string(value); 
-            }
-
-            if (strcasecmp("soilt1", param) == 0)
-            {
-                sscanf(value, "%d", &config.soil_moisture_threshold[0]); 
-            }                                     
-    
-            if (strcasecmp("wndt", param) == 0)
-            {
-                config.wind_threshold = get_int_with_tenths_from_string(value);                
-            }     
-
-            if (strcasecmp("tempth", param) == 0)
-            {
-                config.outside_temperature_threshold= get_int_with_tenths_from_string(value);                
-            }               
-        }
-
-        i++;
-    }
+    // thresholds are entered in the units shown on the page, cgi_units_handler() converts them by their bindings
+    cgi_bind_apply(&ecowitt_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
@@ -669,7 +665,9 @@ const char * cgi_network_handler(int iIndex, int iNumParams, char *pcParam[], ch
                     STRNCPY(config.ip_address, value, sizeof(config.ip_address));
                     if (!config.dhcp_enable)
                     {
+                        web_write_begin(WEB_GROUP_NETWORK);
                         STRNCPY(web.ip_address_string, value, sizeof(web.ip_address_string));
+                        web_write_end(WEB_GROUP_NETWORK);
                     }                    
                 }
 
@@ -683,7 +681,9 @@ const char * cgi_network_handler(int iIndex, int iNumParams, char *pcParam[], ch
                     STRNCPY(config.network_mask, value, sizeof(config.network_mask));
                     if (!config.dhcp_enable)
                     {
+                        web_write_begin(WEB_GROUP_NETWORK);
                         STRNCPY(web.network_mask_string, value, sizeof(web.network_mask_string));
+                        web_write_end(WEB_GROUP_NETWORK);
                     }                     
                 }                   
                 
@@ -697,7 +697,9 @@ const char * cgi_network_handler(int iIndex, int iNumParams, char *pcParam[], ch
                     STRNCPY(config.gateway, value, sizeof(config.gateway));
                     if (!config.dhcp_enable)
                     {
+                        web_write_begin(WEB_GROUP_NETWORK);
                         STRNCPY(web.gateway_string, value, sizeof(web.gateway_string));
+                        web_write_end(WEB_GROUP_NETWORK);
                     }                     
                 }                   
                 
@@ -728,6 +730,21 @@ const char * cgi_network_handler(int iIndex, int iNumParams, char *pcParam[], ch
     return "/network.shtml";
 }
 
+// /aled.cgi parameters
+static const CGI_BINDING_T led_bindings[] =
+{
+    CGI_BIND("lpat", CGI_BIND_INT, NON_VOL_VARIABLES_T, led_pattern, INT32_MIN, INT32_MAX, CGI_UNIT_NONE, led_pattern_applied),
+    CGI_BIND("lspd", CGI_BIND_INT, NON_VOL_VARIABLES_T, led_speed, INT32_MIN, INT32_MAX, CGI_UNIT_NONE, led_speed_applied),
+    CONFIG_INT("lpin", led_pin, INT32_MIN, INT32_MAX),
+    CONFIG_CHECKBOX("lrgbw", led_rgbw),
+    CONFIG_INT("lnum", led_number, INT32_MIN, INT32_MAX),
+    CONFIG_CHECKBOX("lie", use_led_strip_to_indicate_irrigation_status),
+    CONFIG_INT("lia", led_pattern_when_irrigation_active, INT32_MIN, INT32_MAX),
+    CONFIG_INT("liu", led_pattern_when_irrigation_terminated, INT32_MIN, INT32_MAX),
+    CONFIG_INT("lis", led_sustain_duration, INT32_MIN, INT32_MAX),
+};
+CGI_FORM(led_form, led_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -740,94 +757,9 @@ const char * cgi_network_handler(int iIndex, int iNumParams, char *pcParam[], ch
  */
 const char * cgi_led_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-
-    config.use_led_strip_to_indicate_irrigation_status = 0;   
-    config.led_rgbw = 0;   
-
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-
-            
-            if (strcasecmp("lpat", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_pattern);    
-
-                set_led_pattern_local(config.led_pattern);         
-            }
-
-            if (strcasecmp("lspd", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_speed);
-
-                set_led_speed_local(config.led_speed);              
-            }  
-
-            if (strcasecmp("lpin", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_pin);             
-            }
-
-            if (strcasecmp("lrgbw", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.led_rgbw = 1;
-                } 
-                else
-                {
-                    config.led_rgbw = 0;
-                }                             
-            }            
-
-            if (strcasecmp("lnum", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_number);             
-            }  
-
-            if (strcasecmp("lie", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.use_led_strip_to_indicate_irrigation_status = 1;
-                } 
-                else
-                {
-                    config.use_led_strip_to_indicate_irrigation_status = 0;
-                }                             
-            }
-
-            if (strcasecmp("lia", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_pattern_when_irrigation_active);             
-            }  
-
-            if (strcasecmp("liu", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_pattern_when_irrigation_terminated);             
-            }  
-
-            if (strcasecmp("lis", param) == 0)
-            {
-                sscanf(value, "%d", &config.led_sustain_duration);             
-            }                          
-
-        }
-
-        i++;
-    }
-
+    cgi_bind_apply(&led_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
@@ -1129,6 +1061,14 @@ const char * cgi_mood_handler(int iIndex, int iNumParams, char *pcParam[], char
     return "/moodlight.shtml";
 }
 
+// /syslog.cgi parameters
+static const CGI_BINDING_T syslog_bindings[] =
+{
+    CONFIG_CHECKBOX("sloge", syslog_enable),
+    CONFIG_STRING("slog", syslog_server_ip),
+};
+CGI_FORM(syslog_form, syslog_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -1141,46 +1081,9 @@ const char * cgi_mood_handler(int iIndex, int iNumParams, char *pcParam[], char
  */
 const char * cgi_syslog_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-
-       
-    // vile design caused by web browser not sending unchecked parameters, they must be presumed unchecked
-    config.syslog_enable = 0;       
-
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-            if (strcasecmp("sloge", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.syslog_enable = 1;
-                } 
-                else
-                {
-                    config.syslog_enable = 0; // unfortunately will never occur, hence unconditionally forced to zero at start of function 
-                }                              
-            }
-            
-            if (strcasecmp("slog", param) == 0)
-            {
-                STRNCPY(config.syslog_server_ip, value, sizeof(config.syslog_server_ip));
-            }  
-        }
-
-        i++;
-    }
-
+    cgi_bind_apply(&syslog_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
@@ -1267,24 +1170,8 @@ const char * cgi_units_handler(int iIndex, int iNumParams, char *pcParam[], char
     {
         config.use_archaic_units = new_use_archaic_units;
 
-        switch (new_use_archaic_units)
-        {
-            case false:  // convert from archaic units to SI
-                config.wind_threshold = (1000*config.wind_threshold + 1641)/3281;
-                config.rain_week_threshold = (254*config.rain_week_threshold + 5)/10;
-                config.rain_day_threshold = (254*config.rain_day_threshold + 5)/10;
-                config.outside_temperature_threshold = ((config.outside_temperature_threshold*9)/5) + 320;
-
-            break;
-            case true:   // convert from SI to archaic units
-                config.wind_threshold = (config.wind_threshold*3281 + 500)/1000;
-                config.rain_week_threshold = (10*config.rain_week_threshold + 127)/254;
-                config.rain_day_threshold = (10*config.rain_day_threshold + 127)/254; 
-                config.outside_temperature_threshold = ((config.outside_temperature_threshold - 320)*5)/9;                   
-                break;
-            default:
-            break;
-        }
+        // convert the weather thresholds, their bindings say what they measure
+        cgi_bind_convert_units(&ecowitt_form, &config, new_use_archaic_units);
 #ifdef INCORPORATE_THERMOSTAT
         // convert thermostat scheduled temperatures
         sanatize_schedule_temperatures();
@@ -1350,6 +1237,19 @@ const char * cgi_software_load_handler(int iIndex, int iNumParams, char *pcParam
     return "/software_load.shtml";
 }
 
+// /remote_led_strips.cgi parameters
+static const CGI_BINDING_T remote_led_strip_bindings[] =
+{
+    CONFIG_STRING("rsadr1", led_strip_remote_ip[0]),
+    CONFIG_STRING("rsadr2", led_strip_remote_ip[1]),
+    CONFIG_STRING("rsadr3", led_strip_remote_ip[2]),
+    CONFIG_STRING("rsadr4", led_strip_remote_ip[3]),
+    CONFIG_STRING("rsadr5", led_strip_remote_ip[4]),
+    CONFIG_STRING("rsadr6", led_strip_remote_ip[5]),
+    CONFIG_CHECKBOX("rse", led_strip_remote_enable),
+};
+CGI_FORM(remote_led_strip_form, remote_led_strip_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -1362,65 +1262,9 @@ const char * cgi_software_load_handler(int iIndex, int iNumParams, char *pcParam
  */
 const char * cgi_remote_led_strips(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    // set off by default
-    config.led_strip_remote_enable  = 0; 
-
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-
-            if (strcasecmp("rsadr1", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[0], value, sizeof(config.led_strip_remote_ip[0]));
-            }
-            if (strcasecmp("rsadr2", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[1], value, sizeof(config.led_strip_remote_ip[1]));
-            }
-            if (strcasecmp("rsadr3", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[2], value, sizeof(config.led_strip_remote_ip[2]));
-            }
-            if (strcasecmp("rsadr4", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[3], value, sizeof(config.led_strip_remote_ip[3]));
-            }
-            if (strcasecmp("rsadr5", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[4], value, sizeof(config.led_strip_remote_ip[4]));
-            }
-            if (strcasecmp("rsadr6", param) == 0)
-            {
-                STRNCPY(config.led_strip_remote_ip[5], value, sizeof(config.led_strip_remote_ip[5]));
-            }
-            
-            if (strcasecmp("rse", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.led_strip_remote_enable = 1;
-                } 
-                else
-                {
-                    config.led_strip_remote_enable = 0;  // this should never happen, since the parameter is only passed if "on"
-                }   
-            } 
-        }
-
-        i++;
-    }
+    cgi_bind_apply(&remote_led_strip_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
@@ -2704,6 +2548,21 @@ const char * cgi_thermostat_schedule_handler(int iIndex, int iNumParams, char *p
     return "/t_schedule.shtml";    
 }
 
+// /powerwall.cgi parameters
+static const CGI_BINDING_T powerwall_bindings[] =
+{
+    CONFIG_STRING("pwip", powerwall_ip),
+    CONFIG_STRING("pwhost", powerwall_hostname),
+    CONFIG_PASSWORD("pwpass", powerwall_password),
+    CONFIG_TENTHS("pwgdhd", grid_down_heating_setpoint_decrease, INT32_MIN, INT32_MAX),
+    CONFIG_TENTHS("pwgdci", grid_down_cooling_setpoint_increase, INT32_MIN, INT32_MAX),
+    CONFIG_TENTHS("pwblhd", grid_down_heating_disable_battery_level, INT32_MIN, INT32_MAX),
+    CONFIG_TENTHS("pwblhe", grid_down_heating_enable_battery_level, INT32_MIN, INT32_MAX),
+    CONFIG_TENTHS("pwblcd", grid_down_cooling_disable_battery_level, INT32_MIN, INT32_MAX),
+    CONFIG_TENTHS("pwblce", grid_down_cooling_enable_battery_level, INT32_MIN, INT32_MAX),
+};
+CGI_FORM(powerwall_form, powerwall_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -2716,78 +2575,9 @@ const char * cgi_thermostat_schedule_handler(int iIndex, int iNumParams, char *p
  */
 const char * cgi_powerwall_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL; 
-
-    // despicable but necessary as we only receive parameter when checked
-    config.weather_station_enable = 0;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
- 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
 
-
-            if (strcasecmp("pwip", param) == 0)
-            {
-                STRNCPY(config.powerwall_ip, value, sizeof(config.powerwall_ip));
-            }
-
-            if (strcasecmp("pwhost", param) == 0)
-            {
-                STRNCPY(config.powerwall_hostname, value, sizeof(config.powerwall_hostname));
-            }      
-            
-            if (strcasecmp("pwpass", param) == 0)
-            {
-                if (strcasecmp(value, "********") != 0)
-                {
-                    STRNCPY(config.powerwall_password, value, sizeof(config.powerwall_password));
-                }
-            }              
-            
-            if (strcasecmp("pwgdhd", param) == 0)
-            {
-                config.grid_down_heating_setpoint_decrease = get_int_with_tenths_from_string(value);  
-                printf("CGI setting grid down heating setpoint decrease to %d\n", config.grid_down_heating_setpoint_decrease);
-            }
-
-            if (strcasecmp("pwgdci", param) == 0)
-            {
-                config.grid_down_cooling_setpoint_increase = get_int_with_tenths_from_string(value);  
-            }
-
-            if (strcasecmp("pwblhd", param) == 0)
-            {
-                config.grid_down_heating_disable_battery_level = get_int_with_tenths_from_string(value);  
-            }
-
-            if (strcasecmp("pwblhe", param) == 0)
-            {
-                config.grid_down_heating_enable_battery_level = get_int_with_tenths_from_string(value);  
-            } 
-            
-            if (strcasecmp("pwblcd", param) == 0)
-            {
-                config.grid_down_cooling_disable_battery_level = get_int_with_tenths_from_string(value);  
-            }     
-
-            if (strcasecmp("pwblce", param) == 0)
-            {
-                config.grid_down_cooling_enable_battery_level = get_int_with_tenths_from_string(value);  
-            }                                       
-        }
-
-        i++;
-    }
+    cgi_bind_apply(&powerwall_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
@@ -2823,7 +2613,7 @@ const char * cgi_thermostat_copy_handler(int iIndex, int iNumParams, char *pcPar
        
 
 
-    printf("Got request to copy thermostat schedule from day %sd\n", web.thermostat_day);
+    printf("Got request to copy thermostat schedule from day %d\n", web.thermostat_day);
 
     dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
@@ -3115,6 +2905,18 @@ const char * cgi_gpio_default_handler(int iIndex, int iNumParams, char *pcParam[
     return "/gpio_defaults.shtml";    
 }
 
+// /t_sensors.cgi parameters
+static const CGI_BINDING_T temperature_sensor_bindings[] =
+{
+    CONFIG_STRING("tsadr1", temperature_sensor_remote_ip[0]),
+    CONFIG_STRING("tsadr2", temperature_sensor_remote_ip[1]),
+    CONFIG_STRING("tsadr3", temperature_sensor_remote_ip[2]),
+    CONFIG_STRING("tsadr4", temperature_sensor_remote_ip[3]),
+    CONFIG_STRING("tsadr5", temperature_sensor_remote_ip[4]),
+    CONFIG_STRING("tsadr6", temperature_sensor_remote_ip[5]),
+};
+CGI_FORM(temperature_sensor_form, temperature_sensor_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -3127,59 +2929,29 @@ const char * cgi_gpio_default_handler(int iIndex, int iNumParams, char *pcParam[
  */
 const char * cgi_temperature_sensors(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    // set off by default
-    config.led_strip_remote_enable  = 0; 
-
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-
-            if (strcasecmp("tsadr1", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[0], value, sizeof(config.temperature_sensor_remote_ip[0]));
-            }
-            if (strcasecmp("tsadr2", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[1], value, sizeof(config.temperature_sensor_remote_ip[1]));
-            }
-            if (strcasecmp("tsadr3", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[2], value, sizeof(config.temperature_sensor_remote_ip[2]));
-            }
-            if (strcasecmp("tsadr4", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[3], value, sizeof(config.temperature_sensor_remote_ip[3]));
-            }
-            if (strcasecmp("tsadr5", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[4], value, sizeof(config.temperature_sensor_remote_ip[4]));
-            }
-            if (strcasecmp("tsadr6", param) == 0)
-            {
-                STRNCPY(config.temperature_sensor_remote_ip[5], value, sizeof(config.temperature_sensor_remote_ip[5]));
-            }
-        }
-
-        i++;
-    }
+    cgi_bind_apply(&temperature_sensor_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
     return "/t_sensors.shtml";
 }
 
+// /t_advanced.cgi parameters
+static const CGI_BINDING_T advanced_bindings[] =
+{
+    CONFIG_INT("htclm", heating_to_cooling_lockout_mins, 1, 60),
+    CONFIG_INT("mhonm", minimum_heating_on_mins, 1, 60),
+    CONFIG_INT("mconm", minimum_cooling_on_mins, 1, 60),
+    CONFIG_INT("mhoffm", minimum_heating_off_mins, 1, 60),
+    CONFIG_INT("mcoffm", minimum_cooling_off_mins, 1, 60),
+    CONFIG_TENTHS("hvachys", thermostat_hysteresis, 10, 100),
+    CONFIG_INT("disbri", thermostat_display_brightness, 0, 7),
+    CONFIG_INT("disdig", thermostat_display_num_digits, 0, 6),
+};
+CGI_FORM(advanced_form, advanced_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -3192,81 +2964,23 @@ const char * cgi_temperature_sensors(int iIndex, int iNumParams, char *pcParam[]
  */
 const char * cgi_advanced_settings(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-    int setting = 0;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
-
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
-
-            if (strcasecmp("htclm", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 1, 60);
-                config.heating_to_cooling_lockout_mins = setting;
-            }
-            if (strcasecmp("mhonm", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 1, 60);
-                config.minimum_heating_on_mins = setting;
-            }
-            if (strcasecmp("mconm", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 1, 60);
-                config.minimum_cooling_on_mins = setting;
-            }
-            if (strcasecmp("mhoffm", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 1, 60);
-                config.minimum_heating_off_mins = setting;
-            }
-            if (strcasecmp("mcoffm", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 1, 60);
-                config.minimum_cooling_off_mins = setting;
-            }
-            if (strcasecmp("hvachys", param) == 0)
-            {
-                setting = get_int_with_tenths_from_string(value); 
-                CLIP(setting, 10, 100);
-                config.thermostat_hysteresis = setting; 
-            }
-            if (strcasecmp("disbri", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 0, 7);
-                config.thermostat_display_brightness = setting; 
-            }  
-            if (strcasecmp("disdig", param) == 0)
-            {
-                sscanf(value, "%d", &setting);
-                CLIP(setting, 0, 6);
-                config.thermostat_display_num_digits = setting; 
-            }                       
-        }
-
-        i++;
-    }
+    cgi_bind_apply(&advanced_form, &config, iNumParams, pcParam, pcValue);
 
     // Send the next page back to the user
     config_changed();
     return "/t_advanced.shtml";
 }
 
+// /anemometer.cgi parameters
+static const CGI_BINDING_T anemometer_bindings[] =
+{
+    CONFIG_STRING("anip", anemometer_remote_ip),
+    CONFIG_CHECKBOX("anen", anemometer_remote_enable),
+};
+CGI_FORM(anemometer_form, anemometer_bindings);
+
 /*!
  * \brief cgi handler
  *
@@ -3279,49 +2993,124 @@ const char * cgi_advanced_settings(int iIndex, int iNumParams, char *pcParam[],
  */
 const char * cgi_anemometer_settings(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
-    int i = 0;
-    char *param = NULL;
-    char *value = NULL;
-       
     //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
 
-    // set off by default
-    config.anemometer_remote_enable  = 0; 
+    cgi_bind_apply(&anemometer_form, &config, iNumParams, pcParam, pcValue);
 
-    i = 0;
-    while (i < iNumParams)
-    {
-        param = pcParam[i];
-        value = pcValue[i];
+    // Send the next page back to the user
+    config_changed();
+    return "/weather.shtml";
+}
 
-        if (param && value)
-        {
-            //printf("Parameter: %s has Value: %s\n", param, value);
+/*!
+ * \brief cgi handler for events pushed by shelly webhooks, e.g. /shelly_event.cgi?ip=192.168.1.20&ch=0&on=1
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return short json reply, the device ignores it
+ */
+const char * cgi_shelly_event_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+#ifdef INCORPORATE_HOME_CONTROLLER
+    shelly_status_webhook(iNumParams, pcParam, pcValue);
+#endif
 
-            if (strcasecmp("anip", param) == 0)
-            {
-                STRNCPY(config.anemometer_remote_ip, value, sizeof(config.anemometer_remote_ip));
-            }
-            
-            if (strcasecmp("anen", param) == 0)
-            {
-                if (value[0])
-                {
-                    config.anemometer_remote_enable = 1;
-                } 
-                else
-                {
-                    config.anemometer_remote_enable = 0;  // this should never happen, since the parameter is only passed if "on"
-                }   
-            } 
+    return "/api/v1/status";
+}
+
+/*!
+ * \brief cgi handler that replaces, adds or deletes a home controller rule, e.g. /hc_rule.cgi?n=0&rule=gust+%3E+12.5+...
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return the rules with the outcome of the edit
+ */
+const char * cgi_hc_rule_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+#ifdef INCORPORATE_HOME_CONTROLLER
+    char *text = NULL;
+    int index = -1;
+    int i;
+
+    for (i = 0; i < iNumParams; i++)
+    {
+        if (strcasecmp(pcParam[i], "n") == 0)
+        {
+            index = atoi(pcValue[i]);
+        }
+        else if (strcasecmp(pcParam[i], "rule") == 0)
+        {
+            text = pcValue[i];
+            cgi_url_decode(text);
         }
+    }
 
-        i++;
+    if (text && (index >= 0))
+    {
+        hc_task_rule_edit(index, text);
     }
 
-    // Send the next page back to the user
-    config_changed();
-    return "/weather.shtml";
+    return "/api/v1/rules";
+#else
+    return "/index.shtml";
+#endif
+}
+
+#ifdef INCORPORATE_HOME_CONTROLLER
+/*!
+ * \brief Decode a url encoded parameter value in place, '+' is a space and %XX a byte
+ *
+ * \param[in,out]  value    parameter value
+ *
+ * \return nothing
+ */
+static void cgi_url_decode(char *value)
+{
+    char *out = value;
+    unsigned int byte;
+
+    while (*value)
+    {
+        if ((value[0] == '%') && isxdigit((unsigned char)value[1]) && isxdigit((unsigned char)value[2]) &&
+            (sscanf(value + 1, "%2x", &byte) == 1))
+        {
+            *out++ = (char)byte;
+            value += 3;
+        }
+        else
+        {
+            *out++ = (*value == '+') ? ' ' : *value;
+            value++;
+        }
+    }
+    *out = 0;
+}
+#endif
+
+/*!
+ * \brief Show a newly submitted led pattern straight away
+ *
+ * \return nothing
+ */
+static void led_pattern_applied(void)
+{
+    set_led_pattern_local(config.led_pattern);
+}
+
+/*!
+ * \brief Use a newly submitted led speed straight away
+ *
+ * \return nothing
+ */
+static void led_speed_applied(void)
+{
+    set_led_speed_local(config.led_speed);
 }
 
 // CGI requests and their respective handlers  --Add new entires at bottom--
@@ -3374,9 +3163,36 @@ static const tCGI cgi_handlers[] = {
     {"/t_sensors.cgi",                  cgi_temperature_sensors},
     {"/t_advanced.cgi",                 cgi_advanced_settings},    
     {"/anemometer.cgi",                 cgi_anemometer_settings},     
+    {SHELLY_EVENT_CGI,                  cgi_shelly_event_handler},
+    {HC_RULE_CGI,                       cgi_hc_rule_handler},
      
 };
 
+// what httpd is given: the names in cgi_handlers[], each calling cgi_dispatch()
+static tCGI cgi_dispatched[NUM_ROWS(cgi_handlers)];
+
+/*!
+ * \brief Call a handler from cgi_handlers[] with config marked as changing, so the ssi render task never shows
+ *        a setting the handler has only half written
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value
+ *
+ * \return uri returned by the handler
+ */
+static const char *cgi_dispatch(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    const char *uri;
+
+    config_change_begin();
+    uri = cgi_handlers[iIndex].pfnCGIHandler(iIndex, iNumParams, pcParam, pcValue);
+    config_change_end();
+
+    return(uri);
+}
+
 /*!
  * \brief initialize cgi handlers
  * 
@@ -3384,5 +3200,13 @@ static const tCGI cgi_handlers[] = {
  */
 void cgi_init(void)
 {
-    http_set_cgi_handlers(cgi_handlers, NUM_ROWS(cgi_handlers));
+    int i;
+
+    for (i = 0; i < NUM_ROWS(cgi_handlers); i++)
+    {
+        cgi_dispatched[i].pcCGIName = cgi_handlers[i].pcCGIName;
+        cgi_dispatched[i].pfnCGIHandler = cgi_dispatch;
+    }
+
+    http_set_cgi_handlers(cgi_dispatched, NUM_ROWS(cgi_dispatched));
 }
\ No newline at end of file
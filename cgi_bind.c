@@ -0,0 +1,313 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "weather.h"
+#include "config.h"
+#include "pluto.h"
+#include "cgi_bind.h"
+
+/*
+ * Declarative cgi forms
+ *
+ * A settings form is described by a table of bindings (parameter name, field offset and size, type, range) instead of
+ * a handler that compares every parameter against every name it knows.  Each parameter name is hashed once and only
+ * compared in full with the binding whose hash matches, so the cost per parameter no longer grows with the size of the
+ * form.  Binding name hashes are worked out the first time a form is submitted.
+ *
+ * Browsers leave unchecked boxes out of a submission, so every checkbox of the form is cleared before the parameters
+ * are applied and only the ones that are sent are set again.
+ *
+ * Measurements are stored in the units the page shows.  A binding names what its field measures, so when the user
+ * switches between SI and archaic units cgi_bind_convert_units() converts every such field of a form.
+ *
+ * Only called from cgi handlers on the tcpip thread.
+ */
+
+// prototypes
+static uint32_t cgi_bind_hash(const char *name);
+static const CGI_BINDING_T *cgi_bind_find(CGI_FORM_T *form, const char *name);
+static bool cgi_bind_write(const CGI_BINDING_T *binding, void *base, char *value);
+static void cgi_bind_store_int(void *field, int size, int32_t value);
+static int32_t cgi_bind_load_int(const void *field, int size);
+static int32_t cgi_bind_convert(int32_t value, CGI_UNIT_T unit, bool archaic);
+
+/*!
+ * \brief Apply a form submission to the structure its bindings describe
+ *
+ * \param[in]   form          form bindings
+ * \param[out]  base          structure the field offsets are relative to, e.g. &config
+ * \param[in]   iNumParams    number of parameters
+ * \param[in]   pcParam       parameter names
+ * \param[in]   pcValue       parameter values
+ *
+ * \return number of parameters applied
+ */
+int cgi_bind_apply(CGI_FORM_T *form, void *base, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    const CGI_BINDING_T *binding;
+    int applied = 0;
+    int i;
+
+    if (!form->hashed)
+    {
+        for (i = 0; i < form->count; i++)
+        {
+            form->hashes[i] = cgi_bind_hash(form->bindings[i].name);
+        }
+        form->hashed = true;
+    }
+
+    // unchecked boxes are not sent
+    for (i = 0; i < form->count; i++)
+    {
+        if (form->bindings[i].type == CGI_BIND_CHECKBOX)
+        {
+            cgi_bind_store_int((char *)base + form->bindings[i].offset, form->bindings[i].size, 0);
+        }
+    }
+
+    for (i = 0; i < iNumParams; i++)
+    {
+        if (!pcParam[i] || !pcValue[i])
+        {
+            continue;
+        }
+
+        binding = cgi_bind_find(form, pcParam[i]);
+
+        if (binding && cgi_bind_write(binding, base, pcValue[i]))
+        {
+            if (binding->applied)
+            {
+                binding->applied();
+            }
+            applied++;
+        }
+    }
+
+    return(applied);
+}
+
+/*!
+ * \brief Convert the measurements bound by a form to new units
+ *
+ * \param[in]   form          form bindings
+ * \param[out]  base          structure the field offsets are relative to, e.g. &config
+ * \param[in]   archaic       true to convert from SI to archaic units, false for the reverse
+ *
+ * \return nothing
+ */
+void cgi_bind_convert_units(const CGI_FORM_T *form, void *base, bool archaic)
+{
+    const CGI_BINDING_T *binding;
+    char *field;
+    int i;
+
+    for (i = 0; i < form->count; i++)
+    {
+        binding = &form->bindings[i];
+
+        if (binding->unit != CGI_UNIT_NONE)
+        {
+            field = (char *)base + binding->offset;
+            cgi_bind_store_int(field, binding->size, cgi_bind_convert(cgi_bind_load_int(field, binding->size), binding->unit, archaic));
+        }
+    }
+}
+
+/*!
+ * \brief Case insensitive FNV-1a hash of a parameter name
+ *
+ * \param[in]   name      parameter name
+ *
+ * \return hash
+ */
+static uint32_t cgi_bind_hash(const char *name)
+{
+    uint32_t hash = 0x811C9DC5;
+    char c;
+
+    while ((c = *name++))
+    {
+        if ((c >= 'A') && (c <= 'Z'))
+        {
+            c += 'a' - 'A';
+        }
+        hash ^= (uint8_t)c;
+        hash *= 0x01000193;
+    }
+
+    return(hash);
+}
+
+/*!
+ * \brief Find the binding for a parameter
+ *
+ * \param[in]   form      form bindings
+ * \param[in]   name      parameter name
+ *
+ * \return binding or NULL if the form has no such parameter
+ */
+static const CGI_BINDING_T *cgi_bind_find(CGI_FORM_T *form, const char *name)
+{
+    uint32_t hash = cgi_bind_hash(name);
+    int i;
+
+    for (i = 0; i < form->count; i++)
+    {
+        if ((form->hashes[i] == hash) && (strcasecmp(form->bindings[i].name, name) == 0))
+        {
+            return(&form->bindings[i]);
+        }
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Validate a value and write it to its field
+ *
+ * \param[in]   binding   parameter binding
+ * \param[out]  base      structure the field offset is relative to
+ * \param[in]   value     parameter value as sent by the browser
+ *
+ * \return true if the field was written
+ */
+static bool cgi_bind_write(const CGI_BINDING_T *binding, void *base, char *value)
+{
+    char *field = (char *)base + binding->offset;
+    char *end;
+    long number;
+
+    switch(binding->type)
+    {
+        case CGI_BIND_INT:
+            number = strtol(value, &end, 10);
+            if (end == value)
+            {
+                // not a number, leave the setting alone
+                return(false);
+            }
+            CLIP(number, binding->min, binding->max);
+            cgi_bind_store_int(field, binding->size, number);
+            break;
+        case CGI_BIND_TENTHS:
+            number = get_int_with_tenths_from_string(value);
+            CLIP(number, binding->min, binding->max);
+            cgi_bind_store_int(field, binding->size, number);
+            break;
+        case CGI_BIND_PASSWORD:
+            if (strcasecmp(value, CGI_BIND_MASKED_PASSWORD) == 0)
+            {
+                return(false);
+            }
+            STRNCPY(field, value, binding->size);
+            break;
+        case CGI_BIND_STRING:
+            STRNCPY(field, value, binding->size);
+            break;
+        case CGI_BIND_CHECKBOX:
+            cgi_bind_store_int(field, binding->size, value[0] ? 1 : 0);
+            break;
+        default:
+            return(false);
+    }
+
+    return(true);
+}
+
+/*!
+ * \brief Store an integer in a field of any integer size
+ *
+ * \param[out]  field     field to write
+ * \param[in]   size      size of the field in bytes
+ * \param[in]   value     value to store
+ *
+ * \return nothing
+ */
+static void cgi_bind_store_int(void *field, int size, int32_t value)
+{
+    switch(size)
+    {
+        case sizeof(int8_t):
+            *(int8_t *)field = value;
+            break;
+        case sizeof(int16_t):
+            *(int16_t *)field = value;
+            break;
+        case sizeof(int32_t):
+            *(int32_t *)field = value;
+            break;
+        default:
+            printf("cgi_bind: unsupported integer size %d\n", size);
+            break;
+    }
+}
+
+/*!
+ * \brief Load an integer from a field of any integer size
+ *
+ * \param[in]   field     field to read
+ * \param[in]   size      size of the field in bytes
+ *
+ * \return value
+ */
+static int32_t cgi_bind_load_int(const void *field, int size)
+{
+    int32_t value = 0;
+
+    switch(size)
+    {
+        case sizeof(int8_t):
+            value = *(const int8_t *)field;
+            break;
+        case sizeof(int16_t):
+            value = *(const int16_t *)field;
+            break;
+        case sizeof(int32_t):
+            value = *(const int32_t *)field;
+            break;
+        default:
+            printf("cgi_bind: unsupported integer size %d\n", size);
+            break;
+    }
+
+    return(value);
+}
+
+/*!
+ * \brief Convert a measurement x10 between SI and archaic units
+ *
+ * \param[in]   value     measurement x10
+ * \param[in]   unit      what it measures
+ * \param[in]   archaic   true to convert from SI to archaic units, false for the reverse
+ *
+ * \return converted measurement x10
+ */
+static int32_t cgi_bind_convert(int32_t value, CGI_UNIT_T unit, bool archaic)
+{
+    switch(unit)
+    {
+        case CGI_UNIT_TEMPERATURE:
+            value = archaic ? (value*9)/5 + 320 : ((value - 320)*5)/9;
+            break;
+        case CGI_UNIT_SPEED:
+            value = archaic ? (value*3281 + 500)/1000 : (1000*value + 1641)/3281;
+            break;
+        case CGI_UNIT_RAIN:
+            value = archaic ? (10*value + 127)/254 : (254*value + 5)/10;
+            break;
+        case CGI_UNIT_NONE:
+        default:
+            break;
+    }
+
+    return(value);
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef CGI_BIND_H
+#define CGI_BIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CGI_BIND_MASKED_PASSWORD    "********"      // shown in password fields, submitting it leaves the password unchanged
+
+typedef enum
+{
+    CGI_BIND_INT = 0,           // decimal integer clipped to [min, max]
+    CGI_BIND_TENTHS,            // number with one decimal place stored x10, clipped to [min, max]
+    CGI_BIND_STRING,            // copied and truncated to the field size
+    CGI_BIND_PASSWORD,          // as string, unless the masked password was sent back
+    CGI_BIND_CHECKBOX,          // 1 if sent, browsers omit unchecked boxes so it is cleared before the form is applied
+} CGI_BIND_TYPE_T;
+
+// what a value measures, it is stored in the units the page shows and converted when the user changes units
+typedef enum
+{
+    CGI_UNIT_NONE = 0,
+    CGI_UNIT_TEMPERATURE,       // celsius or fahrenheit x10
+    CGI_UNIT_SPEED,             // m/s or ft/s x10
+    CGI_UNIT_RAIN,              // mm or inches x10
+} CGI_UNIT_T;
+
+// one form parameter and the field it is written to
+typedef struct
+{
+    const char *name;
+    uint8_t type;               // CGI_BIND_TYPE_T
+    uint8_t unit;               // CGI_UNIT_T
+    uint16_t offset;            // offset of the field in the bound structure
+    uint16_t size;              // size of the field
+    int32_t min;
+    int32_t max;
+    void (*applied)(void);      // optional, called after the field is written
+} CGI_BINDING_T;
+
+typedef struct
+{
+    const CGI_BINDING_T *bindings;
+    int count;
+    uint32_t *hashes;           // hash of each binding name, filled in on first use
+    bool hashed;
+} CGI_FORM_T;
+
+// describe a field of a structure, e.g. CGI_BIND("slog", CGI_BIND_STRING, NON_VOL_VARIABLES_T, syslog_server_ip, 0, 0, CGI_UNIT_NONE, NULL)
+#define CGI_BIND(name, type, structure, field, min, max, unit, applied) \
+    {(name), (type), (unit), offsetof(structure, field), sizeof(((structure *)0)->field), (min), (max), (applied)}
+
+// declare a form over a binding table
+#define CGI_FORM(form, table) \
+    static uint32_t form##_hashes[sizeof(table)/sizeof(table[0])]; \
+    static CGI_FORM_T form = {(table), sizeof(table)/sizeof(table[0]), form##_hashes, false}
+
+int cgi_bind_apply(CGI_FORM_T *form, void *base, int iNumParams, char *pcParam[], char *pcValue[]);
+void cgi_bind_convert_units(const CGI_FORM_T *form, void *base, bool archaic);
+
+#endif
@@ -0,0 +1,532 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include "message_codec.h"
+#include "anemometer_client.h"
+
+/*
+ * Command line front end for the client library
+ *
+ * Polls one or more devices for the chosen message and reports per device loss and latency percentiles.  With a
+ * zero interval and a deep pipeline it becomes a load generator for message_task.  Given expected results (-L, -T,
+ * -W, -O) it checks them, and every confirm, and exits with 1 if any is not met, so a run against loopback_server
+ * is a test of the client library and the message codec.
+ */
+
+#define CLI_MAX_DEVICES     (1024)
+#define CLI_MAX_LINE        (256)
+
+typedef struct
+{
+    int64_t offset_us;          // most recent clock offset per device for -m time
+} CLI_DEVICE_T;
+
+// results a run is expected to give, a range is unchecked while its maximum is negative
+typedef struct
+{
+    bool enabled;               // any expectation given, which also rules out rejected confirms and send errors
+    double loss_min;            // percent
+    double loss_max;
+    double p50_min;             // median latency, ms
+    double p50_max;
+    bool check_wind;
+    int wind_speed;             // every wind confirm reports this
+    int64_t offset_max_us;      // every clock offset within this, 0 for unchecked
+} CLI_EXPECT_T;
+
+// prototypes
+static void cli_usage(const char *program);
+static int cli_add_devices(AC_CLIENT_T *client, const char *spec, int count);
+static int cli_add_device_file(AC_CLIENT_T *client, const char *filename, int count);
+static void cli_callback(AC_CLIENT_T *client, int device, AC_RESULT_T result, MESSAGE_FIELDS_T *psFields, uint64_t latency_us, void *context);
+static void cli_report(AC_CLIENT_T *client, double elapsed_s, bool time_mode);
+static bool cli_check(AC_CLIENT_T *client);
+static int cli_range(const char *text, double *minimum, double *maximum);
+static void cli_signal(int signal_number);
+
+// static variables
+static AC_CLIENT_T *cli_client = NULL;
+static CLI_DEVICE_T cli_device[CLI_MAX_DEVICES];
+static bool cli_verbose = false;
+static CLI_EXPECT_T cli_expect = {false, 0, -1, 0, -1, false, 0, 0};
+static uint32_t cli_wrong = 0;              // confirms that did not carry what was expected
+
+int main(int argc, char *argv[])
+{
+    MESSAGE_FIELDS_T sRequest;
+    int interval_ms = 1000;
+    int pipeline = 1;
+    int timeout_ms = 1000;
+    int duration_s = 10;
+    int count = 1;
+    const char *device_file = NULL;
+    bool time_mode = false;
+    int device_count;
+    uint64_t start_us;
+    int option;
+    int device;
+    int result = 0;
+    int i;
+
+    memset(&sRequest, 0, sizeof(sRequest));
+    sRequest.sHeader.message = WIND_SPEED_RQST;
+
+    while ((option = getopt(argc, argv, "m:i:d:t:s:n:f:L:T:W:O:vh")) != -1)
+    {
+        switch(option)
+        {
+            case 'm':
+                if (strcmp(optarg, "wind") == 0)
+                {
+                    sRequest.sHeader.message = WIND_SPEED_RQST;
+                }
+                else if (strcmp(optarg, "time") == 0)
+                {
+                    sRequest.sHeader.message = TIME_SYNC_RQST;
+                    time_mode = true;
+                }
+                else if (strncmp(optarg, "led", 3) == 0)
+                {
+                    // led[=pattern[,speed]]
+                    sRequest.sHeader.message = LED_STRIP_RQST;
+                    sscanf(optarg, "led=%d,%d", &sRequest.pattern, &sRequest.speed);
+                }
+                else
+                {
+                    cli_usage(argv[0]);
+                    return(1);
+                }
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                break;
+            case 'd':
+                pipeline = atoi(optarg);
+                break;
+            case 't':
+                timeout_ms = atoi(optarg);
+                break;
+            case 's':
+                duration_s = atoi(optarg);
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'f':
+                device_file = optarg;
+                break;
+            case 'L':
+                if (cli_range(optarg, &cli_expect.loss_min, &cli_expect.loss_max))
+                {
+                    cli_usage(argv[0]);
+                    return(1);
+                }
+                cli_expect.enabled = true;
+                break;
+            case 'T':
+                if (cli_range(optarg, &cli_expect.p50_min, &cli_expect.p50_max))
+                {
+                    cli_usage(argv[0]);
+                    return(1);
+                }
+                cli_expect.enabled = true;
+                break;
+            case 'W':
+                cli_expect.wind_speed = atoi(optarg);
+                cli_expect.check_wind = true;
+                cli_expect.enabled = true;
+                break;
+            case 'O':
+                cli_expect.offset_max_us = atoll(optarg);
+                cli_expect.enabled = true;
+                break;
+            case 'v':
+                cli_verbose = true;
+                break;
+            case 'h':
+            default:
+                cli_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((interval_ms < 0) || (pipeline < 1) || (pipeline > AC_MAX_PIPELINE) || (timeout_ms < 1) || (duration_s < 1) || (count < 1))
+    {
+        cli_usage(argv[0]);
+        return(1);
+    }
+
+    cli_client = ac_client_create(CLI_MAX_DEVICES, CLI_MAX_DEVICES * pipeline);
+    if (!cli_client)
+    {
+        perror("failed to create client");
+        return(1);
+    }
+
+    if (device_file && cli_add_device_file(cli_client, device_file, count))
+    {
+        ac_client_destroy(cli_client);
+        return(1);
+    }
+
+    for (i = optind; i < argc; i++)
+    {
+        if (cli_add_devices(cli_client, argv[i], count))
+        {
+            ac_client_destroy(cli_client);
+            return(1);
+        }
+    }
+
+    device_count = 0;
+    while (ac_client_device_name(cli_client, device_count)[0])
+    {
+        device_count++;
+    }
+
+    if (device_count == 0)
+    {
+        cli_usage(argv[0]);
+        ac_client_destroy(cli_client);
+        return(1);
+    }
+
+    for (device = 0; device < device_count; device++)
+    {
+        ac_client_subscribe(cli_client, device, &sRequest, interval_ms, pipeline, timeout_ms, cli_callback, &(cli_device[device]));
+    }
+
+    signal(SIGINT, cli_signal);
+
+    start_us = ac_client_realtime_us();
+    ac_client_run(cli_client, duration_s * 1000);
+    duration_s = (int)((ac_client_realtime_us() - start_us + 500000)/1000000);
+
+    // let requests in flight complete or time out so that they are not miscounted as lost
+    ac_client_cancel_subscriptions(cli_client);
+    ac_client_run(cli_client, timeout_ms + 100);
+
+    cli_report(cli_client, duration_s ? duration_s : 1, time_mode);
+
+    if (cli_expect.enabled)
+    {
+        result = cli_check(cli_client) ? 0 : 1;
+        printf("%s\n", result ? "FAILED" : "passed");
+    }
+
+    ac_client_destroy(cli_client);
+
+    return(result);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void cli_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options] host[:port] ...\n"
+            "  -m wind|time|led[=pattern,speed]  message to request (default wind)\n"
+            "  -i ms       interval between requests per device, 0 = as fast as pipeline allows (default 1000)\n"
+            "  -d depth    requests in flight per device, 1 to %d (default 1)\n"
+            "  -t ms       timeout per request (default 1000)\n"
+            "  -s seconds  test duration (default 10)\n"
+            "  -n count    expand each host into count devices on consecutive ports (default 1)\n"
+            "  -f file     read hosts from file, one per line\n"
+            "  -L min,max  expect the loss percentage of every device in this range\n"
+            "  -T min,max  expect the median latency of every device in this range, ms\n"
+            "  -W speed    expect every wind confirm to report this speed\n"
+            "  -O us       expect every clock offset within this many microseconds of zero\n"
+            "  -v          print every confirm\n",
+            program, AC_MAX_PIPELINE);
+}
+
+/*!
+ * \brief Add devices described by host[:port]
+ *
+ * \param[in]  client   client
+ * \param[in]  spec     host[:port]
+ * \param[in]  count    number of consecutive ports to add
+ *
+ * \return 0 on success
+ */
+static int cli_add_devices(AC_CLIENT_T *client, const char *spec, int count)
+{
+    char host[CLI_MAX_LINE];
+    char *colon;
+    int port = MESSAGE_PORT;
+    int i;
+
+    snprintf(host, sizeof(host), "%s", spec);
+
+    colon = strchr(host, ':');
+    if (colon)
+    {
+        *colon = 0;
+        port = atoi(colon + 1);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (ac_client_add_device(client, host, port + i) < 0)
+        {
+            fprintf(stderr, "cannot add device %s:%d\n", host, port + i);
+            return(1);
+        }
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Add devices listed in a file, blank lines and lines starting with # are ignored
+ *
+ * \param[in]  client     client
+ * \param[in]  filename   file to read
+ * \param[in]  count      number of consecutive ports to add per line
+ *
+ * \return 0 on success
+ */
+static int cli_add_device_file(AC_CLIENT_T *client, const char *filename, int count)
+{
+    char line[CLI_MAX_LINE];
+    char spec[CLI_MAX_LINE];
+    FILE *file;
+    int err = 0;
+
+    file = fopen(filename, "r");
+    if (!file)
+    {
+        perror(filename);
+        return(1);
+    }
+
+    while (!err && fgets(line, sizeof(line), file))
+    {
+        if ((sscanf(line, "%255s", spec) == 1) && (spec[0] != '#'))
+        {
+            err = cli_add_devices(client, spec, count);
+        }
+    }
+
+    fclose(file);
+
+    return(err);
+}
+
+/*!
+ * \brief Completion callback
+ *
+ * \return nothing
+ */
+static void cli_callback(AC_CLIENT_T *client, int device, AC_RESULT_T result, MESSAGE_FIELDS_T *psFields, uint64_t latency_us, void *context)
+{
+    CLI_DEVICE_T *psDevice = (CLI_DEVICE_T *)context;
+    uint64_t t4;
+
+    if (result == AC_RESULT_TIMEOUT)
+    {
+        if (cli_verbose)
+        {
+            printf("%s timeout\n", ac_client_device_name(client, device));
+        }
+        return;
+    }
+
+    if ((psFields->sHeader.message == TIME_SYNC_CNFM) && (result == AC_RESULT_CONFIRMED))
+    {
+        // same on-wire calculation the device uses, t4 reconstructed from the measured round trip
+        t4 = psFields->originate_us + latency_us;
+        psDevice->offset_us = ((int64_t)(psFields->receive_us - psFields->originate_us) + (int64_t)(psFields->transmit_us - t4))/2;
+
+        if (cli_expect.offset_max_us && (llabs(psDevice->offset_us) > cli_expect.offset_max_us))
+        {
+            cli_wrong++;
+        }
+    }
+
+    if (cli_expect.check_wind && (psFields->sHeader.message == WIND_SPEED_CNFM) && (psFields->wind_speed != cli_expect.wind_speed))
+    {
+        cli_wrong++;
+    }
+
+    if (cli_verbose)
+    {
+        printf("%s seq %u latency %llu us", ac_client_device_name(client, device), psFields->sHeader.sequence, (unsigned long long)latency_us);
+        switch(psFields->sHeader.message)
+        {
+            case WIND_SPEED_CNFM:
+                printf(" wind %d sampled %llu", psFields->wind_speed, (unsigned long long)psFields->sample_time_us);
+                break;
+            case TIME_SYNC_CNFM:
+                printf(" offset %lld us", (long long)psDevice->offset_us);
+                break;
+            default:
+                break;
+        }
+        printf("%s\n", result == AC_RESULT_REJECTED ? " (error)" : "");
+    }
+}
+
+/*!
+ * \brief Print per device loss and latency table
+ *
+ * \param[in]  client      client
+ * \param[in]  elapsed_s   test duration
+ * \param[in]  time_mode   include clock offset column
+ *
+ * \return nothing
+ */
+static void cli_report(AC_CLIENT_T *client, double elapsed_s, bool time_mode)
+{
+    static const double percentile[] = {50.0, 90.0, 99.0};
+    uint64_t latency_us[3];
+    AC_DEVICE_STATS_T stats;
+    AC_DEVICE_STATS_T total;
+    uint32_t answered;
+    int device;
+
+    memset(&total, 0, sizeof(total));
+
+    printf("%-24s %8s %8s %7s %6s %10s %10s %10s %10s", "device", "sent", "rcvd", "loss%", "late", "p50(ms)", "p90(ms)", "p99(ms)", "max(ms)");
+    printf(time_mode ? " %12s\n" : "\n", "offset(us)");
+
+    for (device = 0; ac_client_get_stats(client, device, &stats) == 0; device++)
+    {
+        ac_client_latency_percentiles(client, device, percentile, latency_us, 3);
+        answered = stats.confirmed + stats.rejected;
+
+        printf("%-24s %8u %8u %7.2f %6u %10.3f %10.3f %10.3f %10.3f",
+               ac_client_device_name(client, device),
+               stats.sent,
+               answered,
+               stats.sent ? 100.0 * stats.timeouts / stats.sent : 0.0,
+               stats.late,
+               latency_us[0]/1000.0,
+               latency_us[1]/1000.0,
+               latency_us[2]/1000.0,
+               stats.latency_max_us/1000.0);
+
+        if (time_mode)
+        {
+            printf(" %12lld", (long long)cli_device[device].offset_us);
+        }
+        printf("\n");
+
+        total.sent += stats.sent;
+        total.confirmed += answered;
+        total.timeouts += stats.timeouts;
+        total.late += stats.late;
+        total.send_errors += stats.send_errors;
+        if (stats.latency_max_us > total.latency_max_us) total.latency_max_us = stats.latency_max_us;
+        total.latency_sum_us += stats.latency_sum_us;
+    }
+
+    printf("total: %d devices, %u sent, %u received, %.2f%% loss, %u late, %u send errors, mean %.3f ms, max %.3f ms, %.1f requests/s\n",
+           device,
+           total.sent,
+           total.confirmed,
+           total.sent ? 100.0 * total.timeouts / total.sent : 0.0,
+           total.late,
+           total.send_errors,
+           total.confirmed ? total.latency_sum_us / 1000.0 / total.confirmed : 0.0,
+           total.latency_max_us/1000.0,
+           total.sent / elapsed_s);
+}
+
+/*!
+ * \brief Check every device against the expected results
+ *
+ * \param[in]  client  client
+ *
+ * \return true if all were met
+ */
+static bool cli_check(AC_CLIENT_T *client)
+{
+    static const double median = 50.0;
+    AC_DEVICE_STATS_T stats;
+    uint64_t latency_us;
+    double loss;
+    bool passed = (cli_wrong == 0);
+    int device;
+
+    if (cli_wrong)
+    {
+        printf("%u confirms did not carry the expected wind speed or clock offset\n", cli_wrong);
+    }
+
+    for (device = 0; ac_client_get_stats(client, device, &stats) == 0; device++)
+    {
+        loss = stats.sent ? 100.0 * stats.timeouts / stats.sent : 0.0;
+        ac_client_latency_percentiles(client, device, &median, &latency_us, 1);
+
+        if ((cli_expect.loss_max >= 0) && ((loss < cli_expect.loss_min) || (loss > cli_expect.loss_max)))
+        {
+            printf("%s: loss %.2f%% outside %.2f to %.2f%%\n", ac_client_device_name(client, device), loss, cli_expect.loss_min, cli_expect.loss_max);
+            passed = false;
+        }
+
+        if ((cli_expect.p50_max >= 0) && ((latency_us/1000.0 < cli_expect.p50_min) || (latency_us/1000.0 > cli_expect.p50_max)))
+        {
+            printf("%s: median latency %.3f ms outside %.3f to %.3f ms\n", ac_client_device_name(client, device), latency_us/1000.0,
+                   cli_expect.p50_min, cli_expect.p50_max);
+            passed = false;
+        }
+
+        if (!stats.sent || stats.rejected || stats.send_errors)
+        {
+            printf("%s: %u sent, %u rejected, %u send errors\n", ac_client_device_name(client, device), stats.sent, stats.rejected, stats.send_errors);
+            passed = false;
+        }
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Parse min,max
+ *
+ * \param[in]   text      argument
+ * \param[out]  minimum   minimum
+ * \param[out]  maximum   maximum
+ *
+ * \return 0 on success
+ */
+static int cli_range(const char *text, double *minimum, double *maximum)
+{
+    if ((sscanf(text, "%lf,%lf", minimum, maximum) != 2) || (*minimum > *maximum) || (*maximum < 0))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Stop cleanly on ctrl-c so that the report is still printed
+ *
+ * \return nothing
+ */
+static void cli_signal(int signal_number)
+{
+    (void)signal_number;
+
+    if (cli_client)
+    {
+        ac_client_stop(cli_client);
+    }
+}
@@ -0,0 +1,1078 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "message_codec.h"
+#include "anemometer_client.h"
+
+/*
+ * Linux client for the udp message protocol (message_defs.h)
+ *
+ * All devices share a single non-blocking socket serviced by an epoll loop.  Requests are matched to confirms by
+ * transaction identifier through a hash index so that many requests can be in flight to each device at once.
+ * Subscriptions re-issue a request periodically, or as fast as the pipeline allows if the interval is zero, which
+ * makes the same loop usable for monitoring a fleet of devices or for load testing message_task.
+ */
+
+#define AC_SOCKET_BUFFER_BYTES  (4*1024*1024)
+#define AC_LATE_HISTORY         (1024)      // timed out transactions remembered so that late confirms can be counted
+#define AC_EPOLL_EVENTS         (8)
+
+typedef struct
+{
+    struct sockaddr_in address;
+    char name[64];
+    uint32_t sequence;
+    AC_DEVICE_STATS_T stats;
+    uint32_t latency_us[AC_LATENCY_SAMPLES];
+    int latency_index;
+    int latency_population;
+} AC_DEVICE_T;
+
+typedef struct
+{
+    bool in_use;
+    uint32_t transaction;
+    int device;
+    int subscription;                   // -1 for a one shot request
+    teMSG_ID message;
+    uint64_t sent_us;
+    uint64_t deadline_us;
+    AC_CALLBACK_T callback;
+    void *context;
+} AC_PENDING_T;
+
+typedef struct
+{
+    bool active;
+    int device;
+    MESSAGE_FIELDS_T request;
+    uint64_t interval_us;
+    uint64_t next_send_us;
+    int pipeline;
+    int outstanding;
+    int timeout_ms;
+    AC_CALLBACK_T callback;
+    void *context;
+} AC_SUBSCRIPTION_T;
+
+typedef struct
+{
+    uint32_t transaction;
+    int device;
+} AC_LATE_T;
+
+struct AC_CLIENT
+{
+    int epoll_fd;
+    int socket_fd;
+    bool stop;
+
+    AC_DEVICE_T *device;
+    int device_count;
+    int max_devices;
+
+    AC_PENDING_T *pending;              // pool of request slots
+    int *free_slot;
+    int free_count;
+    int max_outstanding;
+    int *index;                         // open addressed hash of transaction to pending slot, -1 if empty
+    uint32_t index_mask;
+    uint64_t next_deadline_us;
+
+    AC_SUBSCRIPTION_T *subscription;
+    int subscription_count;
+    int subscription_capacity;
+
+    AC_LATE_T late[AC_LATE_HISTORY];
+    int late_index;
+
+    uint32_t random_state;
+};
+
+// prototypes
+static uint64_t ac_monotonic_us(void);
+static uint32_t ac_new_transaction(AC_CLIENT_T *client);
+static int ac_index_find(AC_CLIENT_T *client, uint32_t transaction);
+static void ac_index_insert(AC_CLIENT_T *client, uint32_t transaction, int slot);
+static void ac_index_remove(AC_CLIENT_T *client, uint32_t transaction);
+static int ac_send(AC_CLIENT_T *client, int device, int subscription, const MESSAGE_FIELDS_T *psFields, int timeout_ms, AC_CALLBACK_T callback, void *context);
+static void ac_complete(AC_CLIENT_T *client, int slot, AC_RESULT_T result, MESSAGE_FIELDS_T *psFields, uint64_t now_us);
+static uint64_t ac_service_subscriptions(AC_CLIENT_T *client, uint64_t now_us, bool *active);
+static void ac_expire(AC_CLIENT_T *client, uint64_t now_us);
+static void ac_receive(AC_CLIENT_T *client);
+static int ac_compare_u32(const void *a, const void *b);
+
+/*!
+ * \brief Create a client
+ *
+ * \param[in]  max_devices       maximum number of devices that will be added
+ * \param[in]  max_outstanding   maximum number of requests in flight across all devices
+ *
+ * \return client or NULL on failure
+ */
+AC_CLIENT_T *ac_client_create(int max_devices, int max_outstanding)
+{
+    AC_CLIENT_T *client;
+    struct sockaddr_in local;
+    struct epoll_event event;
+    int buffer_bytes = AC_SOCKET_BUFFER_BYTES;
+    uint32_t index_size = 1;
+    int i;
+
+    if ((max_devices <= 0) || (max_outstanding <= 0))
+    {
+        return(NULL);
+    }
+
+    client = calloc(1, sizeof(AC_CLIENT_T));
+    if (!client)
+    {
+        return(NULL);
+    }
+
+    // keep the hash at most half full so that probe sequences stay short
+    while (index_size < (uint32_t)max_outstanding*2)
+    {
+        index_size <<= 1;
+    }
+
+    client->epoll_fd = -1;
+    client->socket_fd = -1;
+    client->max_devices = max_devices;
+    client->max_outstanding = max_outstanding;
+    client->device = calloc(max_devices, sizeof(AC_DEVICE_T));
+    client->pending = calloc(max_outstanding, sizeof(AC_PENDING_T));
+    client->free_slot = calloc(max_outstanding, sizeof(int));
+    client->index = malloc(index_size * sizeof(int));
+    client->index_mask = index_size - 1;
+    client->next_deadline_us = UINT64_MAX;
+    client->random_state = (uint32_t)ac_monotonic_us() ^ ((uint32_t)getpid() << 16) ^ 0x9e3779b9;
+
+    if (!client->device || !client->pending || !client->free_slot || !client->index)
+    {
+        ac_client_destroy(client);
+        return(NULL);
+    }
+
+    for (i = 0; i < (int)index_size; i++)
+    {
+        client->index[i] = -1;
+    }
+
+    // hand out low numbered slots first
+    for (i = 0; i < max_outstanding; i++)
+    {
+        client->free_slot[i] = max_outstanding - 1 - i;
+    }
+    client->free_count = max_outstanding;
+
+    client->socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (client->socket_fd < 0)
+    {
+        ac_client_destroy(client);
+        return(NULL);
+    }
+
+    setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer_bytes, sizeof(buffer_bytes));
+    setsockopt(client->socket_fd, SOL_SOCKET, SO_SNDBUF, &buffer_bytes, sizeof(buffer_bytes));
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = 0;
+
+    if (bind(client->socket_fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+    {
+        ac_client_destroy(client);
+        return(NULL);
+    }
+
+    client->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (client->epoll_fd < 0)
+    {
+        ac_client_destroy(client);
+        return(NULL);
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = client->socket_fd;
+
+    if (epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, client->socket_fd, &event) < 0)
+    {
+        ac_client_destroy(client);
+        return(NULL);
+    }
+
+    return(client);
+}
+
+/*!
+ * \brief Destroy a client -- outstanding requests are discarded without callbacks
+ *
+ * \param[in]  client   client to destroy
+ *
+ * \return nothing
+ */
+void ac_client_destroy(AC_CLIENT_T *client)
+{
+    if (client)
+    {
+        if (client->epoll_fd >= 0) close(client->epoll_fd);
+        if (client->socket_fd >= 0) close(client->socket_fd);
+        free(client->device);
+        free(client->pending);
+        free(client->free_slot);
+        free(client->index);
+        free(client->subscription);
+        free(client);
+    }
+}
+
+/*!
+ * \brief Add a device
+ *
+ * \param[in]  client   client
+ * \param[in]  host     ip address or host name
+ * \param[in]  port     udp port, normally MESSAGE_PORT
+ *
+ * \return device index or -1 on failure
+ */
+int ac_client_add_device(AC_CLIENT_T *client, const char *host, int port)
+{
+    AC_DEVICE_T *device;
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+
+    if (client->device_count >= client->max_devices)
+    {
+        return(-1);
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if ((getaddrinfo(host, NULL, &hints, &result) != 0) || !result)
+    {
+        return(-1);
+    }
+
+    device = &(client->device[client->device_count]);
+    memset(device, 0, sizeof(AC_DEVICE_T));
+    memcpy(&(device->address), result->ai_addr, sizeof(struct sockaddr_in));
+    device->address.sin_port = htons(port);
+    device->stats.latency_min_us = UINT64_MAX;
+    snprintf(device->name, sizeof(device->name), "%s:%d", host, port);
+
+    freeaddrinfo(result);
+
+    return(client->device_count++);
+}
+
+/*!
+ * \brief Get printable device name
+ *
+ * \param[in]  client   client
+ * \param[in]  device   device index
+ *
+ * \return name in the form host:port
+ */
+const char *ac_client_device_name(AC_CLIENT_T *client, int device)
+{
+    if ((device < 0) || (device >= client->device_count))
+    {
+        return("");
+    }
+
+    return(client->device[device].name);
+}
+
+/*!
+ * \brief Send a single request
+ *
+ * \param[in]  client      client
+ * \param[in]  device      device index
+ * \param[in]  psFields    request to send, only the header message field and its parameters are used
+ * \param[in]  timeout_ms  time to wait for the confirm
+ * \param[in]  callback    called when the request completes, may be NULL
+ * \param[in]  context     passed to callback
+ *
+ * \return 0 on success, -1 if the request could not be sent
+ */
+int ac_client_request(AC_CLIENT_T *client, int device, const MESSAGE_FIELDS_T *psFields, int timeout_ms, AC_CALLBACK_T callback, void *context)
+{
+    return(ac_send(client, device, -1, psFields, timeout_ms, callback, context));
+}
+
+/*!
+ * \brief Send a request to a device repeatedly until cancelled
+ *
+ * \param[in]  client       client
+ * \param[in]  device       device index
+ * \param[in]  psFields     request to send, only the header message field and its parameters are used
+ * \param[in]  interval_ms  time between requests, 0 to send whenever the pipeline has room
+ * \param[in]  pipeline     maximum requests in flight to this device
+ * \param[in]  timeout_ms   time to wait for each confirm
+ * \param[in]  callback     called when each request completes, may be NULL
+ * \param[in]  context      passed to callback
+ *
+ * \return subscription index or -1 on failure
+ */
+int ac_client_subscribe(AC_CLIENT_T *client, int device, const MESSAGE_FIELDS_T *psFields, int interval_ms, int pipeline, int timeout_ms, AC_CALLBACK_T callback, void *context)
+{
+    AC_SUBSCRIPTION_T *subscription;
+    AC_SUBSCRIPTION_T *grown;
+    int capacity;
+
+    if ((device < 0) || (device >= client->device_count) || (interval_ms < 0) || (timeout_ms <= 0) ||
+        (pipeline <= 0) || (pipeline > AC_MAX_PIPELINE))
+    {
+        return(-1);
+    }
+
+    if (client->subscription_count >= client->subscription_capacity)
+    {
+        capacity = client->subscription_capacity ? client->subscription_capacity*2 : 16;
+        grown = realloc(client->subscription, capacity * sizeof(AC_SUBSCRIPTION_T));
+        if (!grown)
+        {
+            return(-1);
+        }
+        client->subscription = grown;
+        client->subscription_capacity = capacity;
+    }
+
+    subscription = &(client->subscription[client->subscription_count]);
+    memset(subscription, 0, sizeof(AC_SUBSCRIPTION_T));
+    subscription->active = true;
+    subscription->device = device;
+    subscription->request = *psFields;
+    subscription->interval_us = (uint64_t)interval_ms * 1000;
+    subscription->next_send_us = ac_monotonic_us();
+    subscription->pipeline = pipeline;
+    subscription->timeout_ms = timeout_ms;
+    subscription->callback = callback;
+    subscription->context = context;
+
+    return(client->subscription_count++);
+}
+
+/*!
+ * \brief Stop issuing new requests for all subscriptions, requests in flight still complete
+ *
+ * \param[in]  client   client
+ *
+ * \return nothing
+ */
+void ac_client_cancel_subscriptions(AC_CLIENT_T *client)
+{
+    int i;
+
+    for (i = 0; i < client->subscription_count; i++)
+    {
+        client->subscription[i].active = false;
+    }
+}
+
+/*!
+ * \brief Run the event loop
+ *
+ * Returns early if ac_client_stop() is called or if there is nothing left to do.
+ *
+ * \param[in]  client       client
+ * \param[in]  duration_ms  maximum time to run
+ *
+ * \return 0 on success, -1 on socket error
+ */
+int ac_client_run(AC_CLIENT_T *client, int duration_ms)
+{
+    struct epoll_event event[AC_EPOLL_EVENTS];
+    uint64_t now_us;
+    uint64_t end_us;
+    uint64_t wake_us;
+    uint64_t next_send_us;
+    bool active;
+    int timeout_ms;
+    int ready;
+    int i;
+
+    client->stop = false;
+    end_us = ac_monotonic_us() + (uint64_t)duration_ms * 1000;
+
+    while (!client->stop)
+    {
+        now_us = ac_monotonic_us();
+
+        ac_expire(client, now_us);
+        next_send_us = ac_service_subscriptions(client, now_us, &active);
+
+        if (now_us >= end_us)
+        {
+            break;
+        }
+
+        if (!active && (client->free_count == client->max_outstanding))
+        {
+            // no subscriptions and nothing in flight
+            break;
+        }
+
+        wake_us = end_us;
+        if (next_send_us < wake_us) wake_us = next_send_us;
+        if (client->next_deadline_us < wake_us) wake_us = client->next_deadline_us;
+
+        timeout_ms = 0;
+        if (wake_us > now_us)
+        {
+            timeout_ms = (int)((wake_us - now_us + 999)/1000);
+        }
+
+        ready = epoll_wait(client->epoll_fd, event, AC_EPOLL_EVENTS, timeout_ms);
+
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return(-1);
+        }
+
+        for (i = 0; i < ready; i++)
+        {
+            if (event[i].data.fd == client->socket_fd)
+            {
+                ac_receive(client);
+            }
+        }
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Make ac_client_run() return -- may be called from a callback
+ *
+ * \param[in]  client   client
+ *
+ * \return nothing
+ */
+void ac_client_stop(AC_CLIENT_T *client)
+{
+    client->stop = true;
+}
+
+/*!
+ * \brief Get number of requests in flight
+ *
+ * \param[in]  client   client
+ *
+ * \return number of requests awaiting confirm or timeout
+ */
+int ac_client_outstanding(AC_CLIENT_T *client)
+{
+    return(client->max_outstanding - client->free_count);
+}
+
+/*!
+ * \brief Get device statistics
+ *
+ * \param[in]  client   client
+ * \param[in]  device   device index
+ * \param[out] stats    statistics
+ *
+ * \return 0 on success, -1 if device does not exist
+ */
+int ac_client_get_stats(AC_CLIENT_T *client, int device, AC_DEVICE_STATS_T *stats)
+{
+    if ((device < 0) || (device >= client->device_count))
+    {
+        return(-1);
+    }
+
+    *stats = client->device[device].stats;
+
+    if (stats->confirmed + stats->rejected == 0)
+    {
+        stats->latency_min_us = 0;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Get latency percentiles over the most recent AC_LATENCY_SAMPLES confirms
+ *
+ * \param[in]  client       client
+ * \param[in]  device       device index
+ * \param[in]  percentile   array of percentiles in the range 0 to 100
+ * \param[out] latency_us   array of latencies, zero if no confirms have been received
+ * \param[in]  count        number of percentiles
+ *
+ * \return number of samples the percentiles were taken over or -1 if device does not exist
+ */
+int ac_client_latency_percentiles(AC_CLIENT_T *client, int device, const double *percentile, uint64_t *latency_us, int count)
+{
+    AC_DEVICE_T *psDevice;
+    uint32_t *sorted;
+    int population;
+    int rank;
+    int i;
+
+    if ((device < 0) || (device >= client->device_count))
+    {
+        return(-1);
+    }
+
+    psDevice = &(client->device[device]);
+    population = psDevice->latency_population;
+
+    for (i = 0; i < count; i++)
+    {
+        latency_us[i] = 0;
+    }
+
+    if (population == 0)
+    {
+        return(0);
+    }
+
+    sorted = malloc(population * sizeof(uint32_t));
+    if (!sorted)
+    {
+        return(-1);
+    }
+
+    memcpy(sorted, psDevice->latency_us, population * sizeof(uint32_t));
+    qsort(sorted, population, sizeof(uint32_t), ac_compare_u32);
+
+    // nearest rank method
+    for (i = 0; i < count; i++)
+    {
+        rank = (int)((percentile[i] * population + 99.999)/100.0);
+        if (rank < 1) rank = 1;
+        if (rank > population) rank = population;
+        latency_us[i] = sorted[rank - 1];
+    }
+
+    free(sorted);
+
+    return(population);
+}
+
+/*!
+ * \brief Get wall clock time in the same units as the device shared timebase
+ *
+ * \return microseconds since unix epoch
+ */
+uint64_t ac_client_realtime_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return((uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec/1000);
+}
+
+/*!
+ * \brief Get monotonic time for latency measurement
+ *
+ * \return microseconds
+ */
+static uint64_t ac_monotonic_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return((uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec/1000);
+}
+
+/*!
+ * \brief Pick a transaction identifier not currently in flight
+ *
+ * \param[in]  client   client
+ *
+ * \return non-zero transaction identifier
+ */
+static uint32_t ac_new_transaction(AC_CLIENT_T *client)
+{
+    uint32_t x;
+
+    do
+    {
+        // xorshift32
+        x = client->random_state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        client->random_state = x;
+    } while ((x == 0) || (ac_index_find(client, x) >= 0));
+
+    return(x);
+}
+
+/*!
+ * \brief Find pending slot for a transaction
+ *
+ * \param[in]  client        client
+ * \param[in]  transaction   transaction identifier
+ *
+ * \return slot or -1 if not found
+ */
+static int ac_index_find(AC_CLIENT_T *client, uint32_t transaction)
+{
+    uint32_t position;
+    int slot;
+
+    position = (transaction * 2654435761U) & client->index_mask;
+
+    while ((slot = client->index[position]) >= 0)
+    {
+        if (client->pending[slot].transaction == transaction)
+        {
+            return(slot);
+        }
+        position = (position + 1) & client->index_mask;
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Add transaction to hash index
+ *
+ * \param[in]  client        client
+ * \param[in]  transaction   transaction identifier
+ * \param[in]  slot          pending slot holding the request
+ *
+ * \return nothing
+ */
+static void ac_index_insert(AC_CLIENT_T *client, uint32_t transaction, int slot)
+{
+    uint32_t position;
+
+    position = (transaction * 2654435761U) & client->index_mask;
+
+    while (client->index[position] >= 0)
+    {
+        position = (position + 1) & client->index_mask;
+    }
+
+    client->index[position] = slot;
+}
+
+/*!
+ * \brief Remove transaction from hash index (backward shift deletion, no tombstones)
+ *
+ * \param[in]  client        client
+ * \param[in]  transaction   transaction identifier
+ *
+ * \return nothing
+ */
+static void ac_index_remove(AC_CLIENT_T *client, uint32_t transaction)
+{
+    uint32_t position;
+    uint32_t next;
+    uint32_t home;
+    int slot;
+
+    position = (transaction * 2654435761U) & client->index_mask;
+
+    while ((slot = client->index[position]) >= 0)
+    {
+        if (client->pending[slot].transaction == transaction)
+        {
+            break;
+        }
+        position = (position + 1) & client->index_mask;
+    }
+
+    if (slot < 0)
+    {
+        return;
+    }
+
+    // pull later members of the probe sequence back into the hole
+    next = position;
+    for (;;)
+    {
+        next = (next + 1) & client->index_mask;
+        slot = client->index[next];
+        if (slot < 0)
+        {
+            break;
+        }
+
+        home = (client->pending[slot].transaction * 2654435761U) & client->index_mask;
+
+        if (((next - home) & client->index_mask) >= ((next - position) & client->index_mask))
+        {
+            client->index[position] = slot;
+            position = next;
+        }
+    }
+
+    client->index[position] = -1;
+}
+
+/*!
+ * \brief Encode and send a request, recording it as pending
+ *
+ * \param[in]  client        client
+ * \param[in]  device        device index
+ * \param[in]  subscription  subscription index or -1
+ * \param[in]  psFields      request to send
+ * \param[in]  timeout_ms    time to wait for the confirm
+ * \param[in]  callback      completion callback
+ * \param[in]  context       passed to callback
+ *
+ * \return 0 on success, -1 on failure
+ */
+static int ac_send(AC_CLIENT_T *client, int device, int subscription, const MESSAGE_FIELDS_T *psFields, int timeout_ms, AC_CALLBACK_T callback, void *context)
+{
+    uint8_t buffer[MESSAGE_MAX_LENGTH];
+    AC_DEVICE_T *psDevice;
+    AC_PENDING_T *psPending;
+    uint32_t transaction;
+    uint64_t now_us;
+    int length = -1;
+    int slot;
+
+    if ((device < 0) || (device >= client->device_count) || (client->free_count == 0))
+    {
+        return(-1);
+    }
+
+    psDevice = &(client->device[device]);
+    transaction = ac_new_transaction(client);
+
+    switch(psFields->sHeader.message)
+    {
+        case LED_STRIP_RQST:
+            length = message_encode_led_strip_request((tsLED_STRIP_RQST *)buffer, transaction, psDevice->sequence, psFields->pattern, psFields->speed);
+            break;
+        case WIND_SPEED_RQST:
+            length = message_encode_wind_speed_request((tsWIND_SPEED_RQST *)buffer, transaction, psDevice->sequence);
+            break;
+        case TIME_SYNC_RQST:
+            length = message_encode_time_sync_request((tsTIME_SYNC_RQST *)buffer, transaction, psDevice->sequence, ac_client_realtime_us());
+            break;
+        default:
+            // confirms are never requested
+            break;
+    }
+
+    if (length < 0)
+    {
+        return(-1);
+    }
+
+    now_us = ac_monotonic_us();
+
+    if (sendto(client->socket_fd, buffer, length, 0, (struct sockaddr *)&(psDevice->address), sizeof(struct sockaddr_in)) != length)
+    {
+        psDevice->stats.send_errors++;
+        return(-1);
+    }
+
+    slot = client->free_slot[--client->free_count];
+    psPending = &(client->pending[slot]);
+    psPending->in_use = true;
+    psPending->transaction = transaction;
+    psPending->device = device;
+    psPending->subscription = subscription;
+    psPending->message = psFields->sHeader.message;
+    psPending->sent_us = now_us;
+    psPending->deadline_us = now_us + (uint64_t)timeout_ms * 1000;
+    psPending->callback = callback;
+    psPending->context = context;
+    ac_index_insert(client, transaction, slot);
+
+    if (psPending->deadline_us < client->next_deadline_us)
+    {
+        client->next_deadline_us = psPending->deadline_us;
+    }
+
+    psDevice->sequence++;
+    psDevice->stats.sent++;
+    psDevice->stats.outstanding++;
+
+    if (subscription >= 0)
+    {
+        client->subscription[subscription].outstanding++;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Finish a pending request, update statistics and call back
+ *
+ * \param[in]  client     client
+ * \param[in]  slot       pending slot
+ * \param[in]  result     how the request completed
+ * \param[in]  psFields   decoded confirm or NULL on timeout
+ * \param[in]  now_us     monotonic time now
+ *
+ * \return nothing
+ */
+static void ac_complete(AC_CLIENT_T *client, int slot, AC_RESULT_T result, MESSAGE_FIELDS_T *psFields, uint64_t now_us)
+{
+    AC_PENDING_T pending;
+    AC_DEVICE_T *psDevice;
+    uint64_t latency_us = 0;
+
+    // release slot before calling back so that the callback may issue a new request
+    pending = client->pending[slot];
+    ac_index_remove(client, pending.transaction);
+    client->pending[slot].in_use = false;
+    client->free_slot[client->free_count++] = slot;
+
+    psDevice = &(client->device[pending.device]);
+    psDevice->stats.outstanding--;
+
+    if (pending.subscription >= 0)
+    {
+        client->subscription[pending.subscription].outstanding--;
+    }
+
+    if (result == AC_RESULT_TIMEOUT)
+    {
+        psDevice->stats.timeouts++;
+
+        client->late[client->late_index].transaction = pending.transaction;
+        client->late[client->late_index].device = pending.device;
+        client->late_index = (client->late_index + 1) % AC_LATE_HISTORY;
+    }
+    else
+    {
+        latency_us = now_us - pending.sent_us;
+
+        if (result == AC_RESULT_REJECTED)
+        {
+            psDevice->stats.rejected++;
+        }
+        else
+        {
+            psDevice->stats.confirmed++;
+        }
+
+        if (latency_us < psDevice->stats.latency_min_us) psDevice->stats.latency_min_us = latency_us;
+        if (latency_us > psDevice->stats.latency_max_us) psDevice->stats.latency_max_us = latency_us;
+        psDevice->stats.latency_sum_us += latency_us;
+
+        psDevice->latency_us[psDevice->latency_index] = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+        psDevice->latency_index = (psDevice->latency_index + 1) % AC_LATENCY_SAMPLES;
+        if (psDevice->latency_population < AC_LATENCY_SAMPLES)
+        {
+            psDevice->latency_population++;
+        }
+    }
+
+    if (pending.callback)
+    {
+        pending.callback(client, pending.device, result, psFields, latency_us, pending.context);
+    }
+}
+
+/*!
+ * \brief Issue requests for subscriptions that are due
+ *
+ * \param[in]  client   client
+ * \param[in]  now_us   monotonic time now
+ * \param[out] active   true if any subscription is still active
+ *
+ * \return time at which the next request will be due or UINT64_MAX if none
+ */
+static uint64_t ac_service_subscriptions(AC_CLIENT_T *client, uint64_t now_us, bool *active)
+{
+    AC_SUBSCRIPTION_T *subscription;
+    uint64_t next_send_us = UINT64_MAX;
+    int i;
+
+    *active = false;
+
+    for (i = 0; i < client->subscription_count; i++)
+    {
+        subscription = &(client->subscription[i]);
+
+        if (!subscription->active)
+        {
+            continue;
+        }
+
+        while ((subscription->outstanding < subscription->pipeline) && (now_us >= subscription->next_send_us))
+        {
+            if (ac_send(client, subscription->device, i, &(subscription->request), subscription->timeout_ms,
+                        subscription->callback, subscription->context))
+            {
+                // socket buffer or slot pool exhausted -- back off briefly rather than spin
+                subscription->next_send_us = now_us + 1000;
+                break;
+            }
+
+            if (subscription->interval_us)
+            {
+                subscription->next_send_us += subscription->interval_us;
+
+                // do not burst to catch up after a stall
+                if (subscription->next_send_us + subscription->interval_us < now_us)
+                {
+                    subscription->next_send_us = now_us;
+                }
+            }
+        }
+
+        *active = true;
+
+        // a full pipeline is woken by a confirm or timeout so only count subscriptions with room
+        if ((subscription->outstanding < subscription->pipeline) && (subscription->next_send_us < next_send_us))
+        {
+            next_send_us = subscription->next_send_us;
+        }
+    }
+
+    return(next_send_us);
+}
+
+/*!
+ * \brief Time out requests that have passed their deadline
+ *
+ * \param[in]  client   client
+ * \param[in]  now_us   monotonic time now
+ *
+ * \return nothing
+ */
+static void ac_expire(AC_CLIENT_T *client, uint64_t now_us)
+{
+    uint64_t next_deadline_us = UINT64_MAX;
+    int slot;
+
+    if (now_us < client->next_deadline_us)
+    {
+        return;
+    }
+
+    // callbacks may send new requests which lower this again
+    client->next_deadline_us = UINT64_MAX;
+
+    for (slot = 0; slot < client->max_outstanding; slot++)
+    {
+        if (client->pending[slot].in_use)
+        {
+            if (client->pending[slot].deadline_us <= now_us)
+            {
+                ac_complete(client, slot, AC_RESULT_TIMEOUT, NULL, now_us);
+            }
+            else if (client->pending[slot].deadline_us < next_deadline_us)
+            {
+                next_deadline_us = client->pending[slot].deadline_us;
+            }
+        }
+    }
+
+    if (next_deadline_us < client->next_deadline_us)
+    {
+        client->next_deadline_us = next_deadline_us;
+    }
+}
+
+/*!
+ * \brief Drain socket and match confirms to pending requests
+ *
+ * \param[in]  client   client
+ *
+ * \return nothing
+ */
+static void ac_receive(AC_CLIENT_T *client)
+{
+    uint8_t buffer[MESSAGE_MAX_LENGTH];
+    MESSAGE_FIELDS_T sFields;
+    struct sockaddr_in source;
+    socklen_t source_length;
+    AC_PENDING_T *psPending;
+    struct sockaddr_in *expected;
+    uint64_t now_us;
+    ssize_t received;
+    int slot;
+    int i;
+
+    for (;;)
+    {
+        source_length = sizeof(source);
+        received = recvfrom(client->socket_fd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr *)&source, &source_length);
+        now_us = ac_monotonic_us();
+
+        if (received < 0)
+        {
+            break;
+        }
+
+        if (message_decode(buffer, (int)received, &sFields))
+        {
+            continue;
+        }
+
+        slot = ac_index_find(client, sFields.sHeader.transaction);
+
+        if (slot < 0)
+        {
+            for (i = 0; i < AC_LATE_HISTORY; i++)
+            {
+                if (client->late[i].transaction && (client->late[i].transaction == sFields.sHeader.transaction))
+                {
+                    client->device[client->late[i].device].stats.late++;
+                    client->late[i].transaction = 0;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // a confirm identifier is always one more than its request
+        psPending = &(client->pending[slot]);
+        expected = &(client->device[psPending->device].address);
+
+        if ((sFields.sHeader.message != psPending->message + 1) ||
+            (source.sin_addr.s_addr != expected->sin_addr.s_addr) ||
+            (source.sin_port != expected->sin_port))
+        {
+            continue;
+        }
+
+        ac_complete(client, slot, sFields.iError ? AC_RESULT_REJECTED : AC_RESULT_CONFIRMED, &sFields, now_us);
+    }
+}
+
+/*!
+ * \brief qsort comparison for latencies
+ *
+ * \return <0, 0, >0
+ */
+static int ac_compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return((x > y) - (x < y));
+}
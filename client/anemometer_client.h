@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ANEMOMETER_CLIENT_H
+#define ANEMOMETER_CLIENT_H
+
+#include <stdint.h>
+
+#include "message_codec.h"
+
+#define AC_LATENCY_SAMPLES      (4096)      // most recent latencies kept per device for percentiles
+#define AC_MAX_PIPELINE         (64)        // maximum requests in flight per subscription
+
+typedef enum
+{
+    AC_RESULT_CONFIRMED     = 0,    // confirm received
+    AC_RESULT_REJECTED      = 1,    // confirm received with iError set
+    AC_RESULT_TIMEOUT       = 2,    // no confirm before the deadline
+} AC_RESULT_T;
+
+typedef struct AC_CLIENT AC_CLIENT_T;
+
+// called from ac_client_run() for every completed request, psFields is NULL on timeout
+typedef void (*AC_CALLBACK_T)(AC_CLIENT_T *client, int device, AC_RESULT_T result, MESSAGE_FIELDS_T *psFields, uint64_t latency_us, void *context);
+
+typedef struct
+{
+    uint32_t sent;
+    uint32_t confirmed;
+    uint32_t rejected;                  // confirm had iError set
+    uint32_t timeouts;
+    uint32_t late;                      // confirm arrived after its request timed out
+    uint32_t send_errors;
+    uint32_t outstanding;
+    uint64_t latency_min_us;
+    uint64_t latency_max_us;
+    uint64_t latency_sum_us;
+} AC_DEVICE_STATS_T;
+
+AC_CLIENT_T *ac_client_create(int max_devices, int max_outstanding);
+void ac_client_destroy(AC_CLIENT_T *client);
+int ac_client_add_device(AC_CLIENT_T *client, const char *host, int port);
+const char *ac_client_device_name(AC_CLIENT_T *client, int device);
+int ac_client_request(AC_CLIENT_T *client, int device, const MESSAGE_FIELDS_T *psFields, int timeout_ms, AC_CALLBACK_T callback, void *context);
+int ac_client_subscribe(AC_CLIENT_T *client, int device, const MESSAGE_FIELDS_T *psFields, int interval_ms, int pipeline, int timeout_ms, AC_CALLBACK_T callback, void *context);
+void ac_client_cancel_subscriptions(AC_CLIENT_T *client);
+int ac_client_run(AC_CLIENT_T *client, int duration_ms);
+void ac_client_stop(AC_CLIENT_T *client);
+int ac_client_outstanding(AC_CLIENT_T *client);
+int ac_client_get_stats(AC_CLIENT_T *client, int device, AC_DEVICE_STATS_T *stats);
+int ac_client_latency_percentiles(AC_CLIENT_T *client, int device, const double *percentile, uint64_t *latency_us, int count);
+uint64_t ac_client_realtime_us(void);
+
+#endif
@@ -0,0 +1,544 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "lwip/apps/fs.h"
+
+#include "weather.h"
+#include "config.h"
+#include "thermostat.h"
+#include "store_forward.h"
+#include "custom_files.h"
+#include "events.h"
+#include "ssi_render.h"
+#include "json_parser.h"
+
+/*
+ * JSON api benchmark
+ *
+ * Links api.c, json_writer.c and custom_files.c against the host stand-ins in client/shim and serves every
+ * /api/v1 endpoint the way httpd does.  Each response is checked against html_common/api/v1/schema.json:
+ *
+ *   - the body parses as json and its length matches the Content-Length header
+ *   - every member the schema requires is present and every member sent is one the schema describes
+ *
+ * once with ordinary readings and once with awkward ones (negative tenths, a failed sensor, quotes and control
+ * characters in strings).  Then each endpoint is timed from fs_open() to fs_close() reading in 1460 byte pieces.
+ * Exits with 1 if any check fails.
+ */
+
+#define AB_RESPONSE_MAX         (4096)
+#define AB_SCHEMA_MAX           (32768)
+#define AB_NAMES_MAX            (32)
+#define AB_NAME_LENGTH          (40)
+#define AB_READ_SIZE            (1460)          // one tcp segment
+
+typedef struct
+{
+    const char *endpoint;                       // schema $defs entry, uri is /api/v1/<endpoint>
+    char required[AB_NAMES_MAX][AB_NAME_LENGTH];
+    int num_required;
+    char properties[AB_NAMES_MAX][AB_NAME_LENGTH];
+    int num_properties;
+} AB_SCHEMA_T;
+
+typedef struct
+{
+    char names[AB_NAMES_MAX][AB_NAME_LENGTH];
+    int num_names;
+} AB_MEMBERS_T;
+
+// prototypes
+static void ab_usage(const char *program);
+static int ab_load_schema(const char *name);
+static void ab_schema_value(void *arg, const char *path, const char *value);
+static void ab_member_value(void *arg, const char *path, const char *value);
+static bool ab_add_name(char names[][AB_NAME_LENGTH], int *count, const char *name, int length);
+static bool ab_has_name(char names[][AB_NAME_LENGTH], int count, const char *name);
+static bool ab_check(AB_SCHEMA_T *schema, const char *fixture, bool verbose);
+static int ab_serve(const char *uri, char *response, int size);
+static void ab_fixture(bool awkward);
+static double ab_now_us(void);
+
+// stand-ins for the firmware globals api.c reads
+WEB_VARIABLES_T web;
+NON_VOL_VARIABLES_T config;
+uint32_t unix_time = 1760000000;
+
+// static variables
+static AB_SCHEMA_T ab_schemas[] =
+{
+    {.endpoint = "wind"},
+    {.endpoint = "weather"},
+    {.endpoint = "thermostat"},
+    {.endpoint = "status"},
+};
+
+static const int ab_num_schemas = sizeof(ab_schemas)/sizeof(ab_schemas[0]);
+
+int main(int argc, char *argv[])
+{
+    static char response[AB_RESPONSE_MAX];
+    const char *schema_name = "../html_common/api/v1/schema.json";
+    char uri[64];
+    double start;
+    double elapsed;
+    bool verbose = false;
+    bool passed = true;
+    int renders = 100000;
+    int length;
+    int option;
+    int render;
+    int i;
+
+    while ((option = getopt(argc, argv, "n:s:vh")) != -1)
+    {
+        switch(option)
+        {
+            case 'n':
+                renders = atoi(optarg);
+                break;
+            case 's':
+                schema_name = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+            default:
+                ab_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((renders <= 0) || ab_load_schema(schema_name))
+    {
+        ab_usage(argv[0]);
+        return(1);
+    }
+
+    ab_fixture(true);
+    for (i=0; i<ab_num_schemas; i++)
+    {
+        passed &= ab_check(&ab_schemas[i], "awkward", verbose);
+    }
+
+    ab_fixture(false);
+    for (i=0; i<ab_num_schemas; i++)
+    {
+        passed &= ab_check(&ab_schemas[i], "ordinary", verbose);
+    }
+
+    for (i=0; i<ab_num_schemas; i++)
+    {
+        snprintf(uri, sizeof(uri), "/api/v1/%s", ab_schemas[i].endpoint);
+
+        start = ab_now_us();
+        for (render=0; render<renders; render++)
+        {
+            length = ab_serve(uri, response, sizeof(response));
+        }
+        elapsed = ab_now_us() - start;
+
+        printf("%-20s %4d bytes %6.2f us %10.0f responses/s\n", uri, length, elapsed/renders, renders/(elapsed/1e6));
+    }
+
+    if (shim_mem_allocated)
+    {
+        printf("%ld blocks not released\n", shim_mem_allocated);
+        passed = false;
+    }
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void ab_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-n renders] [-s schema] [-v]\n"
+            "  -n count     times to serve each endpoint (default 100000)\n"
+            "  -s file      json schema (default ../html_common/api/v1/schema.json)\n"
+            "  -v           print every response\n",
+            program);
+}
+
+/*!
+ * \brief Read the required and described members of each endpoint from the schema
+ *
+ * \param[in]  name     schema file
+ *
+ * \return 0 on success, -1 if the schema cannot be read or describes an endpoint with no members
+ */
+static int ab_load_schema(const char *name)
+{
+    static char text[AB_SCHEMA_MAX];
+    FILE *file;
+    size_t length;
+    int i;
+
+    file = fopen(name, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", name);
+        return(-1);
+    }
+    length = fread(text, 1, sizeof(text) - 1, file);
+    text[length] = 0;
+    fclose(file);
+
+    if (jsonp_parse_string(text, NULL, 0, ab_schema_value, NULL))
+    {
+        fprintf(stderr, "%s is not valid json\n", name);
+        return(-1);
+    }
+
+    for (i=0; i<ab_num_schemas; i++)
+    {
+        if (!ab_schemas[i].num_required || !ab_schemas[i].num_properties)
+        {
+            fprintf(stderr, "%s does not describe %s\n", name, ab_schemas[i].endpoint);
+            return(-1);
+        }
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Collect required and property names from schema paths root."$defs"."<endpoint>"...
+ *
+ * \param[in]  arg      unused
+ * \param[in]  path     path of value
+ * \param[in]  value    value text
+ *
+ * \return nothing
+ */
+static void ab_schema_value(__unused void *arg, const char *path, const char *value)
+{
+    AB_SCHEMA_T *schema;
+    char prefix[64];
+    const char *rest;
+    int i;
+
+    for (i=0; i<ab_num_schemas; i++)
+    {
+        schema = &ab_schemas[i];
+        snprintf(prefix, sizeof(prefix), "root.\"$defs\".\"%s\".", schema->endpoint);
+        if (strncmp(path, prefix, strlen(prefix)))
+        {
+            continue;
+        }
+        rest = path + strlen(prefix);
+
+        if (!strncmp(rest, "\"required\".index", 16))
+        {
+            ab_add_name(schema->required, &schema->num_required, value + 1, strlen(value) - 2);
+        }
+        else if (!strncmp(rest, "\"properties\".\"", 14))
+        {
+            rest += 14;
+            ab_add_name(schema->properties, &schema->num_properties, rest, strcspn(rest, "\""));
+        }
+    }
+}
+
+/*!
+ * \brief Collect the top level member names of a response from paths root."<name>"...
+ *
+ * \param[in]  arg      AB_MEMBERS_T
+ * \param[in]  path     path of value
+ * \param[in]  value    unused
+ *
+ * \return nothing
+ */
+static void ab_member_value(void *arg, const char *path, __unused const char *value)
+{
+    AB_MEMBERS_T *members = (AB_MEMBERS_T *)arg;
+
+    if (!strncmp(path, "root.\"", 6))
+    {
+        ab_add_name(members->names, &members->num_names, path + 6, strcspn(path + 6, "\""));
+    }
+}
+
+/*!
+ * \brief Add a name to a list unless it is already there
+ *
+ * \param[in,out] names     list
+ * \param[in,out] count     names in list
+ * \param[in]     name      name, need not be terminated
+ * \param[in]     length    characters in name
+ *
+ * \return true if added
+ */
+static bool ab_add_name(char names[][AB_NAME_LENGTH], int *count, const char *name, int length)
+{
+    char copy[AB_NAME_LENGTH];
+
+    if ((length <= 0) || (length >= AB_NAME_LENGTH) || (*count >= AB_NAMES_MAX))
+    {
+        return(false);
+    }
+    memcpy(copy, name, length);
+    copy[length] = 0;
+
+    if (ab_has_name(names, *count, copy))
+    {
+        return(false);
+    }
+    strcpy(names[(*count)++], copy);
+
+    return(true);
+}
+
+/*!
+ * \brief Look for a name in a list
+ *
+ * \param[in]  names    list
+ * \param[in]  count    names in list
+ * \param[in]  name     name to find
+ *
+ * \return true if found
+ */
+static bool ab_has_name(char names[][AB_NAME_LENGTH], int count, const char *name)
+{
+    int i;
+
+    for (i=0; i<count; i++)
+    {
+        if (!strcmp(names[i], name))
+        {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+/*!
+ * \brief Serve one endpoint and check the response against its schema
+ *
+ * \param[in]  schema       endpoint and its members
+ * \param[in]  fixture      name of the readings served, for messages
+ * \param[in]  verbose      print the response
+ *
+ * \return true if the response is valid
+ */
+static bool ab_check(AB_SCHEMA_T *schema, const char *fixture, bool verbose)
+{
+    static char response[AB_RESPONSE_MAX];
+    AB_MEMBERS_T members;
+    const char *content_length;
+    const char *body;
+    char uri[64];
+    bool passed = true;
+    int length;
+    int i;
+
+    snprintf(uri, sizeof(uri), "/api/v1/%s", schema->endpoint);
+
+    length = ab_serve(uri, response, sizeof(response));
+    if (length <= 0)
+    {
+        printf("%-20s %-9s cannot be served\n", uri, fixture);
+        return(false);
+    }
+
+    if (verbose)
+    {
+        printf("%s\n", response);
+    }
+
+    body = strstr(response, "\r\n\r\n");
+    content_length = strstr(response, "Content-Length: ");
+    if (!body || !content_length || (content_length > body) || (atoi(content_length + 16) != (int)strlen(body + 4)))
+    {
+        printf("%-20s %-9s Content-Length does not match the body\n", uri, fixture);
+        return(false);
+    }
+    body += 4;
+
+    memset(&members, 0, sizeof(members));
+    if (jsonp_parse_string(body, NULL, 0, ab_member_value, &members))
+    {
+        printf("%-20s %-9s body is not valid json\n  %s\n", uri, fixture, body);
+        return(false);
+    }
+
+    for (i=0; i<schema->num_required; i++)
+    {
+        if (!ab_has_name(members.names, members.num_names, schema->required[i]))
+        {
+            printf("%-20s %-9s required member %s missing\n", uri, fixture, schema->required[i]);
+            passed = false;
+        }
+    }
+
+    for (i=0; i<members.num_names; i++)
+    {
+        if (!ab_has_name(schema->properties, schema->num_properties, members.names[i]))
+        {
+            printf("%-20s %-9s member %s is not in the schema\n", uri, fixture, members.names[i]);
+            passed = false;
+        }
+    }
+
+    if (passed)
+    {
+        printf("%-20s %-9s %4d bytes, %2d members match the schema  ok\n", uri, fixture, length, members.num_names);
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Open a uri and read it all as httpd does
+ *
+ * \param[in]  uri          uri
+ * \param[out] response     destination, nul terminated
+ * \param[in]  size         size of destination
+ *
+ * \return bytes read or -1 if the uri cannot be served in full
+ */
+static int ab_serve(const char *uri, char *response, int size)
+{
+    struct fs_file file;
+    int length = 0;
+    int read;
+
+    if (fs_open(&file, uri) != ERR_OK)
+    {
+        return(-1);
+    }
+
+    while (fs_bytes_left(&file) > 0)
+    {
+        read = fs_read_async_custom(&file, response + length, (size - 1 - length) < AB_READ_SIZE ? (size - 1 - length) : AB_READ_SIZE, NULL, NULL);
+        if (read <= 0)
+        {
+            break;
+        }
+        length += read;
+    }
+
+    fs_close(&file);
+
+    if ((length != file.len) || (length >= size))
+    {
+        return(-1);
+    }
+    response[length] = 0;
+
+    return(length);
+}
+
+/*!
+ * \brief Set the readings the api reports
+ *
+ * \param[in]  awkward  values that need escaping, signs or nulls
+ *
+ * \return nothing
+ */
+static void ab_fixture(bool awkward)
+{
+    int i;
+
+    memset(&web, 0, sizeof(web));
+    memset(&config, 0, sizeof(config));
+
+    config.personality = HVAC_THERMOSTAT;
+    config.use_archaic_units = awkward;
+    web.anemometer_wind_speed = 42;
+    web.anemometer_sample_time_us = awkward ? 0 : 1760000000123456ULL;
+    web.outside_temperature = awkward ? -5 : 215;
+    web.wind_speed = 31;
+    web.wind_gust = 77;
+    web.daily_rain = 12;
+    web.weekly_rain = 48;
+    web.trailing_seven_days_rain = 51;
+    for (i=0; i<(int)sizeof(web.soil_moisture); i++)
+    {
+        web.soil_moisture[i] = awkward ? 100*(i & 1) : 40 + i;
+    }
+    web.us_last_rx_packet = awkward ? 0 : 1;
+    web.thermostat_temperature = awkward ? TEMPERATURE_INVALID : 212;
+    web.thermostat_set_point = 210;
+    web.thermostat_heating_set_point = 200;
+    web.thermostat_cooling_set_point = 240;
+    web.thermostat_temperature_moving_average = awkward ? -7 : 211;
+    web.thermostat_temperature_gradient = awkward ? -3 : 1;
+    web.thermostat_temperature_prediction = 12;
+    web.thermostat_effective_mode = awkward ? 99 : 1;
+    strcpy(web.status_message, awkward ? "say \"hello\"\\\n\tback\x01" : "ok");
+    strcpy(web.watchdog_timestring, "2025-10-09 08:00:00");
+    strcpy(web.ip_address_string, "192.168.1.20");
+    strcpy(web.network_mask_string, "255.255.255.0");
+    strcpy(web.gateway_string, "192.168.1.1");
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+static double ab_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
+
+bool clock_sync_synchronised(void)
+{
+    return(true);
+}
+
+void store_forward_get_stats(STORE_FORWARD_STATS_T *stats)
+{
+    memset(stats, 0, sizeof(STORE_FORWARD_STATS_T));
+}
+
+void events_get_stats(EVENTS_STATS_T *stats)
+{
+    memset(stats, 0, sizeof(EVENTS_STATS_T));
+}
+
+void ssi_render_get_stats(SSI_RENDER_STATS_T *stats)
+{
+    memset(stats, 0, sizeof(SSI_RENDER_STATS_T));
+}
+
+int copy_temperature_history(__unused uint32_t *unix_time, __unused int16_t *temperaturex10, __unused int max_points)
+{
+    return(0);
+}
+
+// the other custom files are not under test
+void *events_open(__unused const char *name, __unused int *length) { return(NULL); }
+int events_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool events_ready(__unused void *state) { return(false); }
+void events_close(__unused void *state) { }
+void *ssi_render_open(__unused const char *name, __unused int *length) { return(NULL); }
+int ssi_render_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool ssi_render_ready(__unused void *state) { return(false); }
+void ssi_render_close(__unused void *state) { }
@@ -0,0 +1,419 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "weather.h"
+#include "config.h"
+#include "worker_tasks.h"
+#include "pluto.h"
+
+/*
+ * CGI form replay
+ *
+ * Replays recorded submissions of every settings form that cgi.c describes with a binding table through the current
+ * handlers and through the handlers as they were before (cgi_replay_old.c), each starting from the same poisoned
+ * config, and compares the config they leave.  Each form is sent complete, with its last field missing (an unchecked
+ * box or an empty field the browser dropped) and with its numbers garbled.  Switching units is replayed the same way
+ * to check the conversions the bindings now drive.  Then both sets of handlers are timed on the complete submissions.
+ *
+ * Two differences are expected and allowed for: the old powerwall and temperature sensor handlers cleared a checkbox
+ * belonging to another form, and the old units handler converted the outside temperature threshold the wrong way.
+ * Exits with 1 if any other difference is found.
+ */
+
+#define CR_PARAMS_MAX           (12)
+
+typedef const char *(*CR_HANDLER_T)(int iIndex, int iNumParams, char *pcParam[], char *pcValue[]);
+
+typedef struct
+{
+    const char *uri;
+    CR_HANDLER_T old_handler;
+    CR_HANDLER_T new_handler;
+    int count;
+    char *params[CR_PARAMS_MAX];
+    char *values[CR_PARAMS_MAX];
+} CR_SUBMISSION_T;
+
+// outside temperature threshold in celsius and fahrenheit x10
+typedef struct
+{
+    int si;
+    int archaic;
+} CR_TEMPERATURE_T;
+
+// prototypes
+static int cr_replay_forms(void);
+static int cr_replay_units(void);
+static void cr_units_start(int threshold, const CR_TEMPERATURE_T *temperature, bool archaic);
+static bool cr_compare(const char *uri, int variant, NON_VOL_VARIABLES_T *old_config, NON_VOL_VARIABLES_T *new_config);
+static void cr_poison(void);
+static void cr_time(int calls);
+static double cr_now_ns(void);
+
+#define CR_HANDLERS(handler)    const char *handler##_old(int, int, char *[], char *[]); const char *handler(int, int, char *[], char *[]);
+CR_HANDLERS(cgi_syslog_handler)
+CR_HANDLERS(cgi_ecowitt_handler)
+CR_HANDLERS(cgi_led_handler)
+CR_HANDLERS(cgi_remote_led_strips)
+CR_HANDLERS(cgi_powerwall_handler)
+CR_HANDLERS(cgi_temperature_sensors)
+CR_HANDLERS(cgi_advanced_settings)
+CR_HANDLERS(cgi_anemometer_settings)
+CR_HANDLERS(cgi_units_handler)
+
+// external variables used by cgi.c
+NON_VOL_VARIABLES_T config;
+WEB_VARIABLES_T web;
+WORKER_TASK_T worker_tasks[1];
+char current_calendar_web_page[50];
+
+// submissions as browsers send them for the shipped forms
+static CR_SUBMISSION_T cr_submissions[] =
+{
+    {"/syslog.cgi", cgi_syslog_handler_old, cgi_syslog_handler, 2,
+        {"sloge", "slog"},
+        {"on", "192.168.1.10"}},
+    {"/ecowitt.cgi", cgi_ecowitt_handler_old, cgi_ecowitt_handler, 7,
+        {"wse", "ecoip", "wkrn", "dyrn", "soilt1", "wndt", "tempth"},
+        {"on", "192.168.1.20", "12.7", "6.35", "40", "5.5", "-2.5"}},
+    {"/aled.cgi", cgi_led_handler_old, cgi_led_handler, 8,
+        {"lpat", "lspd", "lpin", "lnum", "lie", "lia", "liu", "lis"},
+        {"3", "5", "2", "60", "on", "4", "7", "30"}},
+    {"/remote_led_strips.cgi", cgi_remote_led_strips_old, cgi_remote_led_strips, 7,
+        {"rsadr1", "rsadr2", "rsadr3", "rsadr4", "rsadr5", "rsadr6", "rse"},
+        {"192.168.1.31", "192.168.1.32", "", "", "", "", "on"}},
+    {"/powerwall.cgi", cgi_powerwall_handler_old, cgi_powerwall_handler, 9,
+        {"pwip", "pwhost", "pwpass", "pwgdhd", "pwgdci", "pwblhd", "pwblhe", "pwblcd", "pwblce"},
+        {"192.168.1.40", "powerwall", "********", "2.0", "3.5", "20", "30", "40", "50.5"}},
+    {"/t_sensors.cgi", cgi_temperature_sensors_old, cgi_temperature_sensors, 6,
+        {"tsadr1", "tsadr2", "tsadr3", "tsadr4", "tsadr5", "tsadr6"},
+        {"192.168.1.51", "", "", "", "", ""}},
+    {"/t_advanced.cgi", cgi_advanced_settings_old, cgi_advanced_settings, 8,
+        {"htclm", "mhonm", "mconm", "mhoffm", "mcoffm", "hvachys", "disbri", "disdig"},
+        {"30", "5", "5", "99", "0", "1.55", "3", "4"}},
+    {"/anemometer.cgi", cgi_anemometer_settings_old, cgi_anemometer_settings, 2,
+        {"anip", "anen"},
+        {"192.168.1.60", "on"}},
+};
+
+// the same temperatures in both units, conversions truncate so these are exact both ways
+static const CR_TEMPERATURE_T cr_temperatures[] =
+{
+    {-400, -400},
+    {0, 320},
+    {50, 410},
+    {370, 986},
+    {1000, 2120},
+};
+
+// thresholds in tenths to convert
+static const int cr_thresholds[] = {-127, 0, 1, 5, 55, 127, 254, 999, 12345};
+
+int main(int argc, char *argv[])
+{
+    int differences;
+    int calls = 200000;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'n':
+                calls = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (calls <= 0)
+    {
+        fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+        return(1);
+    }
+
+    differences = cr_replay_forms();
+    differences += cr_replay_units();
+    printf("%d unexpected config differences\n", differences);
+
+    cr_time(calls);
+
+    printf("%s\n", differences ? "FAILED" : "passed");
+
+    return(differences ? 1 : 0);
+}
+
+/*!
+ * \brief Replay every form through the old and new handlers
+ *
+ * \return number of replays that left a different config
+ */
+static int cr_replay_forms(void)
+{
+    static NON_VOL_VARIABLES_T old_config;
+    char *values[CR_PARAMS_MAX];
+    CR_SUBMISSION_T *submission;
+    int differences = 0;
+    int variant;
+    int count;
+    int form;
+    int i;
+
+    for (form=0; form<(int)NUM_ROWS(cr_submissions); form++)
+    {
+        submission = &cr_submissions[form];
+
+        for (variant=0; variant<3; variant++)
+        {
+            // 0 as sent, 1 without the last field, 2 with every number garbled
+            count = (variant == 1) ? submission->count - 1 : submission->count;
+            for (i=0; i<count; i++)
+            {
+                values[i] = ((variant == 2) && strcmp(submission->values[i], "on")) ? "1.4.9" : submission->values[i];
+            }
+
+            cr_poison();
+            submission->old_handler(0, count, submission->params, values);
+            old_config = config;
+
+            cr_poison();
+            submission->new_handler(0, count, submission->params, values);
+
+            // the old handlers also cleared a checkbox of another form
+            if (!strcmp(submission->uri, "/powerwall.cgi"))
+            {
+                old_config.weather_station_enable = config.weather_station_enable;
+            }
+            if (!strcmp(submission->uri, "/t_sensors.cgi"))
+            {
+                old_config.led_strip_remote_enable = config.led_strip_remote_enable;
+            }
+
+            differences += !cr_compare(submission->uri, variant, &old_config, &config);
+        }
+    }
+
+    return(differences);
+}
+
+/*!
+ * \brief Switch units both ways with the old and new units handler
+ *
+ * \return number of switches that left a different config
+ */
+static int cr_replay_units(void)
+{
+    static NON_VOL_VARIABLES_T old_config;
+    char *params[] = {"uau"};
+    char *values[] = {"on"};
+    const CR_TEMPERATURE_T *temperature;
+    int differences = 0;
+    int archaic;
+    int i;
+
+    for (i=0; i<(int)NUM_ROWS(cr_thresholds); i++)
+    {
+        temperature = &cr_temperatures[i % NUM_ROWS(cr_temperatures)];
+
+        // the checkbox is only sent when switching to archaic units
+        for (archaic=0; archaic<2; archaic++)
+        {
+            cr_units_start(cr_thresholds[i], temperature, archaic);
+            cgi_units_handler_old(0, archaic, params, values);
+            old_config = config;
+
+            cr_units_start(cr_thresholds[i], temperature, archaic);
+            cgi_units_handler(0, archaic, params, values);
+
+            // the old handler converted the temperature threshold the wrong way
+            old_config.outside_temperature_threshold = archaic ? temperature->archaic : temperature->si;
+
+            differences += !cr_compare("/units.cgi", archaic, &old_config, &config);
+        }
+    }
+
+    return(differences);
+}
+
+/*!
+ * \brief Set up config before switching units
+ *
+ * \param[in]  threshold    wind and rain thresholds x10
+ * \param[in]  temperature  outside temperature threshold in both units
+ * \param[in]  archaic      switching to archaic units
+ *
+ * \return nothing
+ */
+static void cr_units_start(int threshold, const CR_TEMPERATURE_T *temperature, bool archaic)
+{
+    cr_poison();
+    config.use_archaic_units = !archaic;
+    config.wind_threshold = threshold;
+    config.rain_week_threshold = threshold;
+    config.rain_day_threshold = threshold/2;
+    config.outside_temperature_threshold = archaic ? temperature->si : temperature->archaic;
+}
+
+/*!
+ * \brief Compare the config left by the old and new handlers
+ *
+ * \param[in]  uri          form submitted
+ * \param[in]  variant      which submission of the form
+ * \param[in]  old_config   config left by the old handler
+ * \param[in]  new_config   config left by the new handler
+ *
+ * \return true if they are the same
+ */
+static bool cr_compare(const char *uri, int variant, NON_VOL_VARIABLES_T *old_config, NON_VOL_VARIABLES_T *new_config)
+{
+    const uint8_t *old_bytes = (const uint8_t *)old_config;
+    const uint8_t *new_bytes = (const uint8_t *)new_config;
+    int i;
+
+    for (i=0; i<(int)sizeof(NON_VOL_VARIABLES_T); i++)
+    {
+        if (old_bytes[i] != new_bytes[i])
+        {
+            printf("%-24s variant %d differs from byte %d of config\n", uri, variant, i);
+            return(false);
+        }
+    }
+
+    return(true);
+}
+
+/*!
+ * \brief Fill config with a pattern no handler writes
+ *
+ * \return nothing
+ */
+static void cr_poison(void)
+{
+    memset(&config, 0x5A, sizeof(config));
+}
+
+/*!
+ * \brief Time the old and new handlers on complete submissions
+ *
+ * \param[in]  calls    submissions per form
+ *
+ * \return nothing
+ */
+static void cr_time(int calls)
+{
+    CR_SUBMISSION_T *submission;
+    double old_total = 0;
+    double new_total = 0;
+    double old_ns;
+    double new_ns;
+    double start;
+    int form;
+    int i;
+
+    for (form=0; form<(int)NUM_ROWS(cr_submissions); form++)
+    {
+        submission = &cr_submissions[form];
+
+        start = cr_now_ns();
+        for (i=0; i<calls; i++)
+        {
+            submission->old_handler(0, submission->count, submission->params, submission->values);
+        }
+        old_ns = (cr_now_ns() - start)/calls;
+
+        start = cr_now_ns();
+        for (i=0; i<calls; i++)
+        {
+            submission->new_handler(0, submission->count, submission->params, submission->values);
+        }
+        new_ns = (cr_now_ns() - start)/calls;
+
+        printf("%-24s %d params  old %6.0f ns  new %6.0f ns\n", submission->uri, submission->count, old_ns, new_ns);
+        old_total += old_ns;
+        new_total += new_ns;
+    }
+
+    printf("%-24s           old %6.0f ns  new %6.0f ns\n", "all forms", old_total, new_total);
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return nanoseconds
+ */
+static double cr_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e9 + now.tv_nsec);
+}
+
+// stand-ins for the rest of the firmware, none of it is reached by the forms replayed
+void config_changed(void) { }
+void config_change_begin(void) { }
+void config_change_end(void) { }
+void set_led_pattern_local(__unused int pattern) { }
+void set_led_speed_local(__unused int speed) { }
+int set_calendar_html_page(void) { return(0); }
+int make_schedule_grid(void) { return(0); }
+void sanatize_schedule_temperatures(void) { }
+int copy_schedule(__unused int source_day, __unused int destination_day) { return(0); }
+const char *day_name(__unused int day) { return(""); }
+int sanitize_daylight_saving_date(__unused char *in, __unused char *out, __unused int len) { return(0); }
+int string_to_mow(__unused char *string, __unused int length) { return(0); }
+int time_string_to_mow(__unused char *string, __unused int length, __unused int day) { return(0); }
+int deplus_string(__unused char *string, __unused int max_len) { return(0); }
+bool gpio_valid(__unused int gpio_number) { return(false); }
+int initialize_relay_gpio(__unused int gpio_number) { return(0); }
+void set_irrigation_relay_test_zone(__unused int zone) { }
+int get_irrigation_relay_test_zone(void) { return(0); }
+int application_restart(__unused REBOOT_REASON_T reason) { return(0); }
+
+/*!
+ * \brief The same as pluto.c, which cannot be built on the host
+ *
+ * \param[in]  value_string     number with up to two decimal places
+ *
+ * \return value x10
+ */
+int get_int_with_tenths_from_string(char *value_string)
+{
+    int whole_part = 0;
+    int tenths_part = 0;
+    char first_decimal = '0';
+    char second_decimal = '0';
+
+    sscanf(value_string, ".%c%c", &first_decimal, &second_decimal);
+    sscanf(value_string, "%d.%c%c", &whole_part, &first_decimal, &second_decimal);
+
+    if ((first_decimal < '0') || (first_decimal > '9')) first_decimal = '0';
+    if ((second_decimal < '0') || (second_decimal > '9')) second_decimal = '0';
+
+    tenths_part = first_decimal - '0';
+    if ((second_decimal - '0') >= 5)
+    {
+        tenths_part++;
+    }
+    if (tenths_part > 9)
+    {
+        tenths_part -= 10;
+        whole_part++;
+    }
+
+    return(whole_part*10 + tenths_part);
+}
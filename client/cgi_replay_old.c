@@ -0,0 +1,767 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+#include "lwip/sockets.h"
+
+#include "weather.h"
+#include "calendar.h"
+#include "utility.h"
+#include "config.h"
+#include "led_strip.h"
+#include "thermostat.h"
+#include "pluto.h"
+
+/*
+ * CGI handlers as they were before cgi_bind.c
+ *
+ * The settings form handlers that now use binding tables, and cgi_units_handler() with its own conversions, copied
+ * unchanged from cgi.c except for the _old suffix.  cgi_replay.c replays the same submissions through these and the
+ * current handlers and compares the config each leaves behind.  Their console output is dropped so that it does not
+ * swamp the timings.
+ */
+
+#define printf(...)     do { } while (0)
+
+extern NON_VOL_VARIABLES_T config;
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_syslog_handler_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+
+       
+    // vile design caused by web browser not sending unchecked parameters, they must be presumed unchecked
+    config.syslog_enable = 0;       
+
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+            if (strcasecmp("sloge", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.syslog_enable = 1;
+                } 
+                else
+                {
+                    config.syslog_enable = 0; // unfortunately will never occur, hence unconditionally forced to zero at start of function 
+                }                              
+            }
+            
+            if (strcasecmp("slog", param) == 0)
+            {
+                STRNCPY(config.syslog_server_ip, value, sizeof(config.syslog_server_ip));
+            }  
+        }
+
+        i++;
+    }
+
+
+    // Send the next page back to the user
+    config_changed();
+    return "/syslog.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_ecowitt_handler_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL; 
+
+    // despicable but necessary as we only receive parameter when checked
+    config.weather_station_enable = 0;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+ 
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            if (strcasecmp("wse", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.weather_station_enable = 1;
+                } 
+                else
+                {
+                    config.weather_station_enable = 0;  // should never happen
+                }                             
+            } 
+
+            if (strcasecmp("ecoip", param) == 0)
+            {
+                STRNCPY(config.weather_station_ip, value, sizeof(config.weather_station_ip));
+            }
+
+            if (strcasecmp("wkrn", param) == 0)
+            {
+                config.rain_week_threshold = get_int_with_tenths_from_string(value);  
+            }
+
+            if (strcasecmp("dyrn", param) == 0)
+            {
+                config.rain_day_threshold = get_int_with_tenths_from_string(value); 
+            }
+
+            if (strcasecmp("soilt1", param) == 0)
+            {
+                sscanf(value, "%d", &config.soil_moisture_threshold[0]); 
+            }                                     
+    
+            if (strcasecmp("wndt", param) == 0)
+            {
+                config.wind_threshold = get_int_with_tenths_from_string(value);                
+            }     
+
+            if (strcasecmp("tempth", param) == 0)
+            {
+                config.outside_temperature_threshold= get_int_with_tenths_from_string(value);                
+            }               
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+    return "/weather.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_led_handler_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+
+    config.use_led_strip_to_indicate_irrigation_status = 0;   
+    config.led_rgbw = 0;   
+
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            
+            if (strcasecmp("lpat", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_pattern);    
+
+                set_led_pattern_local(config.led_pattern);         
+            }
+
+            if (strcasecmp("lspd", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_speed);
+
+                set_led_speed_local(config.led_speed);              
+            }  
+
+            if (strcasecmp("lpin", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_pin);             
+            }
+
+            if (strcasecmp("lrgbw", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.led_rgbw = 1;
+                } 
+                else
+                {
+                    config.led_rgbw = 0;
+                }                             
+            }            
+
+            if (strcasecmp("lnum", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_number);             
+            }  
+
+            if (strcasecmp("lie", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.use_led_strip_to_indicate_irrigation_status = 1;
+                } 
+                else
+                {
+                    config.use_led_strip_to_indicate_irrigation_status = 0;
+                }                             
+            }
+
+            if (strcasecmp("lia", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_pattern_when_irrigation_active);             
+            }  
+
+            if (strcasecmp("liu", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_pattern_when_irrigation_terminated);             
+            }  
+
+            if (strcasecmp("lis", param) == 0)
+            {
+                sscanf(value, "%d", &config.led_sustain_duration);             
+            }                          
+
+        }
+
+        i++;
+    }
+
+
+    // Send the next page back to the user
+    config_changed();
+    return "/addressable_led.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_remote_led_strips_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    // set off by default
+    config.led_strip_remote_enable  = 0; 
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            if (strcasecmp("rsadr1", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[0], value, sizeof(config.led_strip_remote_ip[0]));
+            }
+            if (strcasecmp("rsadr2", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[1], value, sizeof(config.led_strip_remote_ip[1]));
+            }
+            if (strcasecmp("rsadr3", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[2], value, sizeof(config.led_strip_remote_ip[2]));
+            }
+            if (strcasecmp("rsadr4", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[3], value, sizeof(config.led_strip_remote_ip[3]));
+            }
+            if (strcasecmp("rsadr5", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[4], value, sizeof(config.led_strip_remote_ip[4]));
+            }
+            if (strcasecmp("rsadr6", param) == 0)
+            {
+                STRNCPY(config.led_strip_remote_ip[5], value, sizeof(config.led_strip_remote_ip[5]));
+            }
+            
+            if (strcasecmp("rse", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.led_strip_remote_enable = 1;
+                } 
+                else
+                {
+                    config.led_strip_remote_enable = 0;  // this should never happen, since the parameter is only passed if "on"
+                }   
+            } 
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+    return "/remote_led_strips.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_powerwall_handler_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL; 
+
+    // despicable but necessary as we only receive parameter when checked
+    config.weather_station_enable = 0;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+ 
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+
+            if (strcasecmp("pwip", param) == 0)
+            {
+                STRNCPY(config.powerwall_ip, value, sizeof(config.powerwall_ip));
+            }
+
+            if (strcasecmp("pwhost", param) == 0)
+            {
+                STRNCPY(config.powerwall_hostname, value, sizeof(config.powerwall_hostname));
+            }      
+            
+            if (strcasecmp("pwpass", param) == 0)
+            {
+                if (strcasecmp(value, "********") != 0)
+                {
+                    STRNCPY(config.powerwall_password, value, sizeof(config.powerwall_password));
+                }
+            }              
+            
+            if (strcasecmp("pwgdhd", param) == 0)
+            {
+                config.grid_down_heating_setpoint_decrease = get_int_with_tenths_from_string(value);  
+                printf("CGI setting grid down heating setpoint decrease to %d\n", config.grid_down_heating_setpoint_decrease);
+            }
+
+            if (strcasecmp("pwgdci", param) == 0)
+            {
+                config.grid_down_cooling_setpoint_increase = get_int_with_tenths_from_string(value);  
+            }
+
+            if (strcasecmp("pwblhd", param) == 0)
+            {
+                config.grid_down_heating_disable_battery_level = get_int_with_tenths_from_string(value);  
+            }
+
+            if (strcasecmp("pwblhe", param) == 0)
+            {
+                config.grid_down_heating_enable_battery_level = get_int_with_tenths_from_string(value);  
+            } 
+            
+            if (strcasecmp("pwblcd", param) == 0)
+            {
+                config.grid_down_cooling_disable_battery_level = get_int_with_tenths_from_string(value);  
+            }     
+
+            if (strcasecmp("pwblce", param) == 0)
+            {
+                config.grid_down_cooling_enable_battery_level = get_int_with_tenths_from_string(value);  
+            }                                       
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+
+    return "/powerwall.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_temperature_sensors_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    // set off by default
+    config.led_strip_remote_enable  = 0; 
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            if (strcasecmp("tsadr1", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[0], value, sizeof(config.temperature_sensor_remote_ip[0]));
+            }
+            if (strcasecmp("tsadr2", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[1], value, sizeof(config.temperature_sensor_remote_ip[1]));
+            }
+            if (strcasecmp("tsadr3", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[2], value, sizeof(config.temperature_sensor_remote_ip[2]));
+            }
+            if (strcasecmp("tsadr4", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[3], value, sizeof(config.temperature_sensor_remote_ip[3]));
+            }
+            if (strcasecmp("tsadr5", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[4], value, sizeof(config.temperature_sensor_remote_ip[4]));
+            }
+            if (strcasecmp("tsadr6", param) == 0)
+            {
+                STRNCPY(config.temperature_sensor_remote_ip[5], value, sizeof(config.temperature_sensor_remote_ip[5]));
+            }
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+    return "/t_sensors.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_advanced_settings_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+    int setting = 0;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            if (strcasecmp("htclm", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 1, 60);
+                config.heating_to_cooling_lockout_mins = setting;
+            }
+            if (strcasecmp("mhonm", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 1, 60);
+                config.minimum_heating_on_mins = setting;
+            }
+            if (strcasecmp("mconm", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 1, 60);
+                config.minimum_cooling_on_mins = setting;
+            }
+            if (strcasecmp("mhoffm", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 1, 60);
+                config.minimum_heating_off_mins = setting;
+            }
+            if (strcasecmp("mcoffm", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 1, 60);
+                config.minimum_cooling_off_mins = setting;
+            }
+            if (strcasecmp("hvachys", param) == 0)
+            {
+                setting = get_int_with_tenths_from_string(value); 
+                CLIP(setting, 10, 100);
+                config.thermostat_hysteresis = setting; 
+            }
+            if (strcasecmp("disbri", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 0, 7);
+                config.thermostat_display_brightness = setting; 
+            }  
+            if (strcasecmp("disdig", param) == 0)
+            {
+                sscanf(value, "%d", &setting);
+                CLIP(setting, 0, 6);
+                config.thermostat_display_num_digits = setting; 
+            }                       
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+    return "/t_advanced.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_anemometer_settings_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+       
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+
+    // set off by default
+    config.anemometer_remote_enable  = 0; 
+
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+            //printf("Parameter: %s has Value: %s\n", param, value);
+
+            if (strcasecmp("anip", param) == 0)
+            {
+                STRNCPY(config.anemometer_remote_ip, value, sizeof(config.anemometer_remote_ip));
+            }
+            
+            if (strcasecmp("anen", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.anemometer_remote_enable = 1;
+                } 
+                else
+                {
+                    config.anemometer_remote_enable = 0;  // this should never happen, since the parameter is only passed if "on"
+                }   
+            } 
+        }
+
+        i++;
+    }
+
+    // Send the next page back to the user
+    config_changed();
+    return "/weather.shtml";
+}
+
+/*!
+ * \brief cgi handler
+ *
+ * \param[in]  iIndex       index of cgi handler in cgi_handlers table
+ * \param[in]  iNumParams   number of parameters
+ * \param[in]  pcParam      parameter name
+ * \param[in]  pcValue      parameter value 
+ * 
+ * \return nothing
+ */
+const char * cgi_units_handler_old(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    int i = 0;
+    char *param = NULL;
+    char *value = NULL;
+    int new_use_archaic_units = 0;   
+
+    // set off by default
+    config.use_simplified_english  = 0; 
+    config.use_monday_as_week_start = 0; 
+
+    //dump_parameters(iIndex, iNumParams, pcParam, pcValue);
+ 
+    i = 0;
+    while (i < iNumParams)
+    {
+        param = pcParam[i];
+        value = pcValue[i];
+
+        if (param && value)
+        {
+
+            if (strcasecmp("uau", param) == 0)
+            {
+                if (value[0])
+                {
+                    new_use_archaic_units = 1;
+                } 
+                else
+                {
+                    new_use_archaic_units = 0;  // this should never happen, since the parameter is only passed if "on"
+                }   
+            }   
+
+            if (strcasecmp("simpe", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.use_simplified_english = 1;
+                } 
+                else
+                {
+                    config.use_simplified_english  = 0;  // this should never happen, since the parameter is only passed if "on"
+                }   
+            }   
+
+            if (strcasecmp("mweek", param) == 0)
+            {
+                if (value[0])
+                {
+                    config.use_monday_as_week_start = 1;
+                } 
+                else
+                {
+                    config.use_monday_as_week_start = 0;  // this should never happen, since the parameter is only passed if "on"
+                } 
+            }                                                                   
+        }
+
+        i++;
+    }
+
+    // set the default week long calendar page
+    set_calendar_html_page();  
+
+    // check for change in units
+    if (new_use_archaic_units != config.use_archaic_units)
+    {
+        config.use_archaic_units = new_use_archaic_units;
+
+        switch (new_use_archaic_units)
+        {
+            case false:  // convert from archaic units to SI
+                config.wind_threshold = (1000*config.wind_threshold + 1641)/3281;
+                config.rain_week_threshold = (254*config.rain_week_threshold + 5)/10;
+                config.rain_day_threshold = (254*config.rain_day_threshold + 5)/10;
+                config.outside_temperature_threshold = ((config.outside_temperature_threshold*9)/5) + 320;
+
+            break;
+            case true:   // convert from SI to archaic units
+                config.wind_threshold = (config.wind_threshold*3281 + 500)/1000;
+                config.rain_week_threshold = (10*config.rain_week_threshold + 127)/254;
+                config.rain_day_threshold = (10*config.rain_day_threshold + 127)/254; 
+                config.outside_temperature_threshold = ((config.outside_temperature_threshold - 320)*5)/9;                   
+                break;
+            default:
+            break;
+        }
+#ifdef INCORPORATE_THERMOSTAT
+        // convert thermostat scheduled temperatures
+        sanatize_schedule_temperatures();
+        make_schedule_grid();
+#endif
+    }     
+
+
+    // Send the next page back to the user
+    config_changed();
+    return "/units.shtml";
+}
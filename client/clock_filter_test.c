@@ -0,0 +1,374 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "clock_filter.h"
+
+/*
+ * Clock filter test
+ *
+ * Runs the firmware's offset estimator against a simulated master whose clock is offset and skewed from the local
+ * one, over networks with different delay distributions, and checks the rms error of the estimate once it has settled.
+ * Exchanges are made every 16 seconds as clock_sync does once synchronised.  A second test moves the master's clock
+ * back and checks that the monotonic clock keeps advancing while it slews onto the new offset.  A third steps the
+ * reference of an SNTP disciplined master back and checks that a peer disciplined from the master's slewed clock stays
+ * close to it throughout the slew.
+ * Exits with 1 if any bound is exceeded.
+ */
+
+#define CT_POLL_US              (16000000)      // CLOCK_SYNC_POLL_SLOW_MS
+#define CT_POLL_FAST_US         (4000000)       // CLOCK_SYNC_POLL_FAST_MS
+#define CT_EXCHANGES            (2000)
+#define CT_SETTLE               (64)            // exchanges ignored while the frequency loop locks
+#define CT_PROCESSING_US        (200)           // master's time between receiving the request and sending the confirm
+
+typedef enum
+{
+    CT_EXPONENTIAL = 0,         // queuing on a quiet lan
+    CT_UNIFORM,                 // busy wifi
+    CT_POPCORN,                 // exponential with occasional 200 ms spikes
+    CT_ASYMMETRIC,              // request path slower than the confirm path
+} CT_NETWORK_T;
+
+typedef struct
+{
+    const char *name;
+    CT_NETWORK_T network;
+    double skew_ppm;            // master clock rate relative to local
+    double max_rms_us;          // bound on the settled rms error
+} CT_SCENARIO_T;
+
+// prototypes
+static bool ct_run(const CT_SCENARIO_T *scenario, bool verbose);
+static bool ct_slew(int64_t step_us);
+static bool ct_follow(int64_t step_us);
+static double ct_delay(CT_NETWORK_T network, bool request, int exchange);
+static double ct_random(void);
+
+// static variables
+static uint64_t ct_seed = 88172645463325252ULL;
+
+static const CT_SCENARIO_T ct_scenarios[] =
+{
+    // name                         network          skew     bound
+    {"lan, exponential 1+3 ms",     CT_EXPONENTIAL,   40.0,   1000},
+    {"wifi, uniform 1-50 ms",       CT_UNIFORM,      -25.0,  10000},
+    {"lan with 200 ms spikes",      CT_POPCORN,       40.0,   2000},
+    {"asymmetric 8 ms / 1 ms",      CT_ASYMMETRIC,   100.0,   4000},     // half the asymmetry can never be seen
+    {"fast crystal, exponential",   CT_EXPONENTIAL,  400.0,   3000},
+};
+
+int main(int argc, char *argv[])
+{
+    bool verbose = false;
+    bool passed = true;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "vs:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'v':
+                verbose = true;
+                break;
+            case 's':
+                ct_seed = strtoull(optarg, NULL, 0) | 1;
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-v] [-s seed]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    for (i=0; i<(int)(sizeof(ct_scenarios)/sizeof(ct_scenarios[0])); i++)
+    {
+        passed &= ct_run(&ct_scenarios[i], verbose);
+    }
+
+    passed &= ct_slew(-2000000);
+    passed &= ct_slew(-60000000);
+    passed &= ct_slew(3000000);
+
+    passed &= ct_follow(-60000000);
+    passed &= ct_follow(-2000000);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Run one scenario and report the settled error
+ *
+ * \param[in]  scenario     network and clocks
+ * \param[in]  verbose      print every 100th exchange
+ *
+ * \return true if the rms error stayed within the scenario's bound
+ */
+static bool ct_run(const CT_SCENARIO_T *scenario, bool verbose)
+{
+    CLOCK_FILTER_T filter;
+    double skew = scenario->skew_ppm/1e6;
+    double offset = 5000000.0;
+    double error;
+    double max_error = 0;
+    double sum_squares = 0;
+    double rms;
+    uint64_t local = 1000000;
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t t3;
+    uint64_t t4;
+    int result;
+    int samples = 0;
+    int k;
+    bool passed;
+
+    clock_filter_init(&filter);
+
+    for (k=0; k<CT_EXCHANGES; k++)
+    {
+        local += CT_POLL_US;
+
+        // master time is offset + local*(1 + skew)
+        t1 = local;
+        t2 = (uint64_t)(offset + (t1 + ct_delay(scenario->network, true, k))*(1 + skew));
+        t3 = t2 + CT_PROCESSING_US;
+        t4 = (uint64_t)((t3 - offset)/(1 + skew) + ct_delay(scenario->network, false, k));
+
+        result = clock_filter_add_exchange(&filter, t1, t2, t3, t4);
+
+        error = clock_filter_offset_at(&filter, t4) - (offset + t4*skew);
+        if (k >= CT_SETTLE)
+        {
+            max_error = fabs(error) > max_error ? fabs(error) : max_error;
+            sum_squares += error*error;
+            samples++;
+        }
+
+        if (verbose && !(k % 100))
+        {
+            printf("  %4d: result %d error %8.0f us frequency %7d ppb\n", k, result, error, filter.frequency_ppb);
+        }
+    }
+
+    // the worst single error depends on a few unlucky exchanges so only the rms is held to a bound
+    rms = sqrt(sum_squares/samples);
+    passed = (rms <= scenario->max_rms_us);
+    printf("%-28s error rms %6.0f us (bound %5.0f) max %6.0f us  frequency %7d ppb (true %7.0f)  accepted %4u rejected %4u steps %u  %s\n",
+           scenario->name, rms, scenario->max_rms_us, max_error,
+           filter.frequency_ppb, scenario->skew_ppm*1000, filter.accepted, filter.rejected, filter.steps, passed ? "ok" : "FAIL");
+
+    return(passed);
+}
+
+/*!
+ * \brief Move the master clock and follow the monotonic clock read every 10 ms while it slews onto the new offset
+ *
+ * \param[in]  step_us  change of the master clock, negative to move it back
+ *
+ * \return true if the clock never stopped or went back and reached the new offset when expected
+ */
+static bool ct_slew(int64_t step_us)
+{
+    CLOCK_FILTER_T filter;
+    CLOCK_MONOTONIC_T clock;
+    int64_t offset = 5000000;
+    uint64_t local = 1000000;
+    uint64_t next_exchange = local;
+    uint64_t step_at = 600000000;
+    uint64_t converged_at = 0;
+    uint64_t shared;
+    uint64_t last = 0;
+    uint64_t model;
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t t4;
+    double slowest = 1.0;
+    double expected_s;
+    bool passed;
+
+    clock_filter_init(&filter);
+    memset(&clock, 0, sizeof(clock));
+
+    for (; local < step_at + (CLOCK_FILTER_SAMPLES + 2)*CT_POLL_US + (uint64_t)llabs(step_us)*25; local += 10000)
+    {
+        if (local >= step_at)
+        {
+            offset = 5000000 + step_us;
+        }
+
+        if (local >= next_exchange)
+        {
+            t1 = local;
+            t2 = t1 + offset + 1000;
+            t4 = t1 + 2000 + CT_PROCESSING_US;
+            clock_filter_add_exchange(&filter, t1, t2, t2 + CT_PROCESSING_US, t4);
+            next_exchange += CT_POLL_US;
+        }
+
+        model = local + clock_filter_offset_at(&filter, local);
+        shared = clock_filter_monotonic(&clock, local, model);
+
+        if (last)
+        {
+            if (shared <= last)
+            {
+                printf("step %+9.3f s: clock stopped or went back at %.3f s\n", step_us/1e6, local/1e6);
+                return(false);
+            }
+            slowest = (shared - last)/10000.0 < slowest ? (shared - last)/10000.0 : slowest;
+        }
+        last = shared;
+
+        if ((local > step_at) && !converged_at && (shared == model) && (llabs((int64_t)(model - (local + offset))) < 5000))
+        {
+            converged_at = local;
+        }
+    }
+
+    // the filter takes CLOCK_FILTER_SAMPLES exchanges to accept a step, then a backward step is slewed out
+    expected_s = (CLOCK_FILTER_SAMPLES + 1)*CT_POLL_US/1e6 + (step_us < 0 ? -step_us/1e6/(CLOCK_FILTER_SLEW_PPM/1e6) : 0);
+    passed = converged_at && ((converged_at - step_at)/1e6 <= expected_s*1.05) && (slowest >= 1 - CLOCK_FILTER_SLEW_PPM/1e6 - 1e-9);
+
+    printf("step %+9.3f s: slowest rate %.3f, converged after %8.1f s (expected %8.1f s)  %s\n",
+           step_us/1e6, slowest, converged_at ? (converged_at - step_at)/1e6 : -1.0, expected_s, passed ? "ok" : "FAIL");
+
+    return(passed);
+}
+
+/*!
+ * \brief Step an SNTP disciplined master back and follow a peer disciplined from the master's slewed clock
+ *
+ * \param[in]  step_us  change of the master's reference clock, negative to move it back
+ *
+ * \return true if the peer's clock stayed close to the master's while it slewed and agreed with it afterwards
+ */
+static bool ct_follow(int64_t step_us)
+{
+    CLOCK_FILTER_T master;
+    CLOCK_FILTER_T peer;
+    CLOCK_MONOTONIC_T master_clock;
+    CLOCK_MONOTONIC_T peer_clock;
+    int64_t reference_offset = 5000000;
+    uint64_t local = 1000000;
+    uint64_t next_exchange = local;
+    uint64_t step_at = 600000000;
+    uint64_t end_at = step_at + (CLOCK_FILTER_SAMPLES + 2)*CT_POLL_US + (uint64_t)llabs(step_us)*25;
+    uint64_t master_shared;
+    uint64_t peer_shared;
+    uint64_t t2;
+    double disagreement;
+    double worst = 0;
+    double bound;
+    double final = 0;
+    bool passed;
+
+    clock_filter_init(&master);
+    clock_filter_init(&peer);
+    memset(&master_clock, 0, sizeof(master_clock));
+    memset(&peer_clock, 0, sizeof(peer_clock));
+
+    for (; local < end_at; local += 10000)
+    {
+        if (local >= step_at)
+        {
+            reference_offset = 5000000 + step_us;
+        }
+
+        // the master's sample clock, and the peer's, whose counter is 123 ms ahead
+        master_shared = clock_filter_monotonic(&master_clock, local, local + clock_filter_offset_at(&master, local));
+        peer_shared = clock_filter_monotonic(&peer_clock, local + 123000,
+                                             local + 123000 + clock_filter_offset_at(&peer, local + 123000));
+
+        if (local >= next_exchange)
+        {
+            // sntp on the master, and an exchange with the peer answered from the master's sample clock
+            clock_filter_add_exchange(&master, local, local + reference_offset, local + reference_offset, local);
+            t2 = master_shared + 1000;
+            clock_filter_add_exchange(&peer, local + 123000, t2, t2 + CT_PROCESSING_US, local + 123000 + 2000 + CT_PROCESSING_US);
+
+            // as clock_sync_poll_interval()
+            next_exchange += (peer.consecutive_outliers || (peer.sample_population < CLOCK_FILTER_MIN_POPULATION)) ?
+                             CT_POLL_FAST_US : CT_POLL_US;
+        }
+
+        if (local >= step_at)
+        {
+            disagreement = fabs((double)(int64_t)(peer_shared - master_shared));
+            worst = disagreement > worst ? disagreement : worst;
+            final = disagreement;
+        }
+    }
+
+    // the peer falls behind while it gathers enough exchanges to believe the master has moved
+    bound = (CT_POLL_US + CLOCK_FILTER_SAMPLES*CT_POLL_FAST_US)*(CLOCK_FILTER_SLEW_PPM/1e6)*1.25;
+    passed = (worst <= bound) && (final < 5000);
+
+    printf("step %+9.3f s: peer of a slewing master within %8.3f s (bound %.3f s), %6.3f ms apart after  %s\n",
+           step_us/1e6, worst/1e6, bound/1e6, final/1e3, passed ? "ok" : "FAIL");
+
+    return(passed);
+}
+
+/*!
+ * \brief One way network delay
+ *
+ * \param[in]  network      delay distribution
+ * \param[in]  request      true for the request path, false for the confirm path
+ * \param[in]  exchange     exchange number
+ *
+ * \return microseconds
+ */
+static double ct_delay(CT_NETWORK_T network, bool request, int exchange)
+{
+    double delay;
+
+    switch(network)
+    {
+        case CT_UNIFORM:
+            delay = 1000 + ct_random()*49000;
+            break;
+        case CT_POPCORN:
+            delay = 1000 - log(ct_random() + 1e-12)*3000;
+            if (request && !(exchange % 13))
+            {
+                delay += 200000;
+            }
+            break;
+        case CT_ASYMMETRIC:
+            delay = request ? 8000 - log(ct_random() + 1e-12)*2000 : 1000 - log(ct_random() + 1e-12)*500;
+            break;
+        case CT_EXPONENTIAL:
+        default:
+            delay = 1000 - log(ct_random() + 1e-12)*3000;
+            break;
+    }
+
+    return(delay);
+}
+
+/*!
+ * \brief Repeatable uniform random number
+ *
+ * \return value in [0, 1)
+ */
+static double ct_random(void)
+{
+    ct_seed ^= ct_seed << 13;
+    ct_seed ^= ct_seed >> 7;
+    ct_seed ^= ct_seed << 17;
+
+    return((ct_seed >> 11) * (1.0/9007199254740992.0));
+}
@@ -0,0 +1,564 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "ecowitt.h"
+
+/*
+ * Ecowitt parser test bench
+ *
+ * Reads gateway replies from a file (one per line as hex bytes, # starts a comment) and runs them through the
+ * firmware's reassembly stream and decoder:
+ *
+ *   - each reply on its own, printing what was decoded
+ *   - all replies with noise between them, split at random points, checking every reply is found and the decoded
+ *     observation matches
+ *   - with -z, mutated replies and random bytes, for running under the address and undefined behaviour sanitizers
+ *   - timing of the decoder and of the stream fed in tcp sized pieces
+ */
+
+#define EB_FRAMES_MAX           (64)
+#define EB_LINE_MAX             (4096)
+#define EB_STREAM_MAX           (EB_FRAMES_MAX*(ECOWITT_FRAME_MAX + 16))
+#define EB_TCP_MSS              (1460)
+
+typedef struct
+{
+    uint8_t bytes[ECOWITT_FRAME_MAX];
+    int length;
+} EB_FRAME_T;
+
+// prototypes
+static void eb_usage(const char *program);
+static int eb_load(const char *name);
+static int eb_feed(ECOWITT_STREAM_T *stream, const uint8_t *data, int length, int chunk_max, ECOWITT_OBSERVATION_T *observation, int *results);
+static void eb_print(const ECOWITT_OBSERVATION_T *observation);
+static int eb_split(int loops);
+static void eb_fuzz(int loops);
+static void eb_time(int loops);
+static uint32_t eb_random(void);
+static double eb_now_us(void);
+
+// static variables
+static EB_FRAME_T eb_frames[EB_FRAMES_MAX];
+static int eb_num_frames = 0;
+static uint8_t eb_stream_bytes[EB_STREAM_MAX];
+static uint32_t eb_seed = 1;
+
+int main(int argc, char *argv[])
+{
+    ECOWITT_STREAM_T stream;
+    ECOWITT_OBSERVATION_T observation;
+    ECOWITT_OBSERVATION_T single;
+    static const char *result_name[] = {"ok", "not data", "unknown item", "truncated"};
+    const char *frames_name = NULL;
+    int results[4];
+    int loops = 100000;
+    int splits = 1000;
+    int fuzz = 0;
+    int found;
+    int option;
+    int i;
+    int j;
+
+    while ((option = getopt(argc, argv, "f:l:r:z:s:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'f':
+                frames_name = optarg;
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            case 'r':
+                splits = atoi(optarg);
+                break;
+            case 'z':
+                fuzz = atoi(optarg);
+                break;
+            case 's':
+                eb_seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'h':
+            default:
+                eb_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (!frames_name || (loops < 0) || (splits < 0) || (fuzz < 0) || eb_load(frames_name))
+    {
+        eb_usage(argv[0]);
+        return(1);
+    }
+
+    // each reply on its own
+    memset(&observation, 0, sizeof(observation));
+    for (i=0; i<eb_num_frames; i++)
+    {
+        memset(&single, 0, sizeof(single));
+        memset(results, 0, sizeof(results));
+        ecowitt_stream_init(&stream);
+        found = eb_feed(&stream, eb_frames[i].bytes, eb_frames[i].length, eb_frames[i].length, &single, results);
+        ecowitt_decode(eb_frames[i].bytes, eb_frames[i].length, &observation);
+
+        for (j=0; (j<4) && !results[j]; j++)
+        {
+        }
+        printf("reply %d: command 0x%02x, %d bytes, %s%s", i, eb_frames[i].bytes[2], eb_frames[i].length,
+               found == 1 ? "" : "NOT FOUND, ", j < 4 ? result_name[j] : "-");
+        if (j == ECOWITT_UNKNOWN_ITEM)
+        {
+            printf(" 0x%02x", single.unknown_item);
+        }
+        printf("\n");
+
+        if (found != 1)
+        {
+            return(1);
+        }
+    }
+    eb_print(&observation);
+
+    if (splits && eb_split(splits))
+    {
+        return(1);
+    }
+
+    if (fuzz)
+    {
+        eb_fuzz(fuzz);
+    }
+
+    if (loops)
+    {
+        eb_time(loops);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void eb_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s -f replies [-l loops] [-r splits] [-z fuzz] [-s seed]\n"
+            "  -f file      gateway replies, one per line as hex bytes\n"
+            "  -l count     decode each reply this many times for timing (default 100000, 0 to skip)\n"
+            "  -r count     split the replies at random points this many times (default 1000)\n"
+            "  -z count     feed this many mutated reply streams (default 0)\n"
+            "  -s seed      random seed (default 1)\n",
+            program);
+}
+
+/*!
+ * \brief Read the replies
+ *
+ * \param[in]  name     file name
+ *
+ * \return 0 on success, -1 on error
+ */
+static int eb_load(const char *name)
+{
+    char line[EB_LINE_MAX];
+    FILE *file;
+    EB_FRAME_T *frame;
+    char *text;
+    char *end;
+    unsigned long byte;
+
+    file = fopen(name, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", name, strerror(errno));
+        return(-1);
+    }
+
+    while (fgets(line, sizeof(line), file) && (eb_num_frames < EB_FRAMES_MAX))
+    {
+        line[strcspn(line, "#\r\n")] = 0;
+
+        frame = &eb_frames[eb_num_frames];
+        frame->length = 0;
+
+        for (text=line; ; text=end)
+        {
+            byte = strtoul(text, &end, 16);
+            if ((end == text) || (byte > 0xff) || (frame->length >= ECOWITT_FRAME_MAX))
+            {
+                break;
+            }
+            frame->bytes[frame->length++] = (uint8_t)byte;
+        }
+
+        if (frame->length)
+        {
+            eb_num_frames++;
+        }
+    }
+
+    fclose(file);
+
+    if (!eb_num_frames)
+    {
+        fprintf(stderr, "no replies in %s\n", name);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Feed bytes to a stream in random sized pieces and decode every frame it returns
+ *
+ * \param[in,out] stream        stream
+ * \param[in]     data          bytes as received
+ * \param[in]     length        bytes in data
+ * \param[in]     chunk_max     largest piece
+ * \param[in,out] observation   receives the decoded values
+ * \param[in,out] results       count of each ECOWITT_RESULT_T
+ *
+ * \return number of frames
+ */
+static int eb_feed(ECOWITT_STREAM_T *stream, const uint8_t *data, int length, int chunk_max, ECOWITT_OBSERVATION_T *observation, int *results)
+{
+    const uint8_t *frame;
+    uint8_t *space;
+    ECOWITT_RESULT_T result;
+    int frame_length;
+    int space_len;
+    int chunk;
+    int frames = 0;
+
+    while (length > 0)
+    {
+        space = ecowitt_stream_space(stream, &space_len);
+
+        chunk = (chunk_max > 1) ? 1 + eb_random() % chunk_max : 1;
+        chunk = chunk < length ? chunk : length;
+        chunk = chunk < space_len ? chunk : space_len;
+
+        memcpy(space, data, chunk);
+        ecowitt_stream_received(stream, chunk);
+        data += chunk;
+        length -= chunk;
+
+        while (ecowitt_stream_next(stream, &frame, &frame_length))
+        {
+            if ((frame_length > ECOWITT_FRAME_MAX) || (frame[0] != 0xff) || (frame[1] != 0xff))
+            {
+                fprintf(stderr, "bad frame returned\n");
+                abort();
+            }
+
+            result = ecowitt_decode(frame, frame_length, observation);
+            if ((unsigned int)result > ECOWITT_TRUNCATED)
+            {
+                fprintf(stderr, "bad decode result %d\n", result);
+                abort();
+            }
+            results[result]++;
+            frames++;
+        }
+    }
+
+    return(frames);
+}
+
+/*!
+ * \brief Print the values of interest to the firmware
+ *
+ * \param[in]  observation  decoded values
+ *
+ * \return nothing
+ */
+static void eb_print(const ECOWITT_OBSERVATION_T *observation)
+{
+    int items = 0;
+    int i;
+
+    for (i=0; i<256; i++)
+    {
+        items += ecowitt_present(observation, i);
+    }
+
+    printf("%d items: outdoor %d.%d C, wind %d.%d m/s, gust %d.%d m/s, piezo rain day %u.%u mm week %u.%u mm, soil %d%% %d%%\n",
+           items,
+           observation->outdoor_temperature / 10, abs(observation->outdoor_temperature % 10),
+           observation->wind_speed / 10, observation->wind_speed % 10,
+           observation->gust_speed / 10, observation->gust_speed % 10,
+           observation->piezo_rain_day / 10, observation->piezo_rain_day % 10,
+           observation->piezo_rain_week / 10, observation->piezo_rain_week % 10,
+           observation->soil_moisture[0], observation->soil_moisture[1]);
+}
+
+/*!
+ * \brief Check that replies split at random points and separated by noise are all found and decode the same
+ *
+ * \param[in]  loops    number of random streams
+ *
+ * \return 0 on success, -1 on a mismatch
+ */
+static int eb_split(int loops)
+{
+    ECOWITT_STREAM_T stream;
+    ECOWITT_OBSERVATION_T expected;
+    ECOWITT_OBSERVATION_T observation;
+    int results[4];
+    int length;
+    int noise;
+    int found;
+    int loop;
+    int i;
+
+    memset(&expected, 0, sizeof(expected));
+    memset(results, 0, sizeof(results));
+    for (i=0; i<eb_num_frames; i++)
+    {
+        ecowitt_stream_init(&stream);
+        eb_feed(&stream, eb_frames[i].bytes, eb_frames[i].length, eb_frames[i].length, &expected, results);
+    }
+
+    for (loop=0; loop<loops; loop++)
+    {
+        // noise never holds 0xff so that it cannot start a frame
+        length = 0;
+        for (i=0; i<eb_num_frames; i++)
+        {
+            for (noise = eb_random() % 8; noise; noise--)
+            {
+                eb_stream_bytes[length++] = eb_random() % 0xff;
+            }
+            memcpy(eb_stream_bytes + length, eb_frames[i].bytes, eb_frames[i].length);
+            length += eb_frames[i].length;
+        }
+
+        memset(&observation, 0, sizeof(observation));
+        ecowitt_stream_init(&stream);
+        found = eb_feed(&stream, eb_stream_bytes, length, 1 + eb_random() % (2*ECOWITT_FRAME_MAX), &observation, results);
+
+        if ((found != eb_num_frames) || memcmp(&observation, &expected, sizeof(observation)))
+        {
+            fprintf(stderr, "split %d: found %d of %d replies%s\n", loop, found, eb_num_frames,
+                    memcmp(&observation, &expected, sizeof(observation)) ? ", values differ" : "");
+            return(-1);
+        }
+    }
+
+    printf("%d split streams, every reply found and decoded the same\n", loops);
+
+    return(0);
+}
+
+/*!
+ * \brief Feed mutated replies, with and without their checksums corrected, and random bytes
+ *
+ * \param[in]  loops    number of streams
+ *
+ * \return nothing
+ */
+static void eb_fuzz(int loops)
+{
+    ECOWITT_STREAM_T stream;
+    ECOWITT_OBSERVATION_T observation;
+    EB_FRAME_T *frame;
+    int results[4];
+    int found = 0;
+    int length;
+    int start;
+    int end;
+    int checksum;
+    int loop;
+    int count;
+    int i;
+    int j;
+
+    memset(results, 0, sizeof(results));
+    memset(&observation, 0, sizeof(observation));
+    ecowitt_stream_init(&stream);
+
+    for (loop=0; loop<loops; loop++)
+    {
+        length = 0;
+        for (count = 1 + eb_random() % 4; count; count--)
+        {
+            start = length;
+            switch(eb_random() % 4)
+            {
+                case 0:
+                    // random bytes, mostly 0xff
+                    for (i = eb_random() % 64; i; i--)
+                    {
+                        eb_stream_bytes[length++] = (eb_random() & 1) ? 0xff : eb_random();
+                    }
+                    break;
+
+                default:
+                    // a reply with some bytes changed, moved or cut off
+                    frame = &eb_frames[eb_random() % eb_num_frames];
+                    memcpy(eb_stream_bytes + length, frame->bytes, frame->length);
+                    length += frame->length;
+
+                    for (i = eb_random() % 4; i && (length > start); i--)
+                    {
+                        j = start + eb_random() % (length - start);
+                        switch(eb_random() % 3)
+                        {
+                            case 0:
+                                eb_stream_bytes[j] = eb_random();
+                                break;
+                            case 1:
+                                eb_stream_bytes[j] ^= 1 << (eb_random() % 8);
+                                break;
+                            default:
+                                memmove(eb_stream_bytes + j, eb_stream_bytes + j + 1, length - j - 1);
+                                length--;
+                                break;
+                        }
+                    }
+
+                    if ((eb_random() % 8 == 0) && (length > start))
+                    {
+                        length = start + eb_random() % (length - start);
+                    }
+
+                    // most of the time make the size and checksum good so the decoder sees the damage
+                    if ((eb_random() % 4) && (length - start > 5))
+                    {
+                        end = length - 1;
+                        eb_stream_bytes[start+3] = (end - start - 1) >> 8;
+                        eb_stream_bytes[start+4] = (end - start - 1) & 0xff;
+                        checksum = 0;
+                        for (j=start+2; j<end; j++)
+                        {
+                            checksum += eb_stream_bytes[j];
+                        }
+                        eb_stream_bytes[end] = checksum;
+                    }
+                    break;
+            }
+        }
+
+        found += eb_feed(&stream, eb_stream_bytes, length, 1 + eb_random() % 256, &observation, results);
+    }
+
+    printf("%d fuzz streams, %d frames: %d ok, %d not data, %d unknown item, %d truncated, %u checksum errors, %u bytes skipped\n",
+           loops, found, results[ECOWITT_OK], results[ECOWITT_NOT_DATA], results[ECOWITT_UNKNOWN_ITEM], results[ECOWITT_TRUNCATED],
+           stream.checksum_errors, stream.discarded);
+}
+
+/*!
+ * \brief Time the decoder and the stream
+ *
+ * \param[in]  loops    times each reply is decoded
+ *
+ * \return nothing
+ */
+static void eb_time(int loops)
+{
+    ECOWITT_STREAM_T stream;
+    ECOWITT_OBSERVATION_T observation;
+    const uint8_t *frame;
+    uint8_t *space;
+    int frame_length;
+    int space_len;
+    int offset;
+    int chunk;
+    int bytes = 0;
+    int length = 0;
+    int loop;
+    int i;
+    double start;
+    double elapsed;
+
+    memset(&observation, 0, sizeof(observation));
+    start = eb_now_us();
+    for (loop=0; loop<loops; loop++)
+    {
+        for (i=0; i<eb_num_frames; i++)
+        {
+            ecowitt_decode(eb_frames[i].bytes, eb_frames[i].length, &observation);
+            bytes += (loop == 0) ? eb_frames[i].length : 0;
+        }
+    }
+    elapsed = eb_now_us() - start;
+
+    printf("decode: %.1f ns per reply, %.2f ns per byte\n",
+           elapsed*1000 / ((double)loops*eb_num_frames), elapsed*1000 / ((double)loops*bytes));
+
+    for (i=0; (length + eb_frames[i % eb_num_frames].length) <= EB_STREAM_MAX; i++)
+    {
+        memcpy(eb_stream_bytes + length, eb_frames[i % eb_num_frames].bytes, eb_frames[i % eb_num_frames].length);
+        length += eb_frames[i % eb_num_frames].length;
+    }
+
+    // whole segments as tcp would deliver them
+    ecowitt_stream_init(&stream);
+    loops = 1 + loops / i;
+    start = eb_now_us();
+    for (loop=0; loop<loops; loop++)
+    {
+        for (offset=0; offset<length; offset+=chunk)
+        {
+            space = ecowitt_stream_space(&stream, &space_len);
+            chunk = (length - offset) < EB_TCP_MSS ? length - offset : EB_TCP_MSS;
+            chunk = chunk < space_len ? chunk : space_len;
+            memcpy(space, eb_stream_bytes + offset, chunk);
+            ecowitt_stream_received(&stream, chunk);
+
+            while (ecowitt_stream_next(&stream, &frame, &frame_length))
+            {
+                ecowitt_decode(frame, frame_length, &observation);
+            }
+        }
+    }
+    elapsed = eb_now_us() - start;
+
+    printf("stream and decode: %.1f ns per reply, %.1f MB/s in %d byte segments\n",
+           elapsed*1000 / ((double)loops*i), (double)loops*length / elapsed, EB_TCP_MSS);
+}
+
+/*!
+ * \brief Small repeatable random number generator
+ *
+ * \return next number
+ */
+static uint32_t eb_random(void)
+{
+    eb_seed ^= eb_seed << 13;
+    eb_seed ^= eb_seed >> 17;
+    eb_seed ^= eb_seed << 5;
+
+    return(eb_seed);
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double eb_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
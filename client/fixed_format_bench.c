@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "fixed_format.h"
+
+/*
+ * Fixed point formatter benchmark
+ *
+ * Checks every formatter in fixed_format.c against the snprintf() format it replaces, over +-200000 in each fixed
+ * point form, the integer limits, addresses, timestamps, utc offsets and truncated output, then times both and
+ * measures how much stack each takes below its caller by painting the stack before the call.
+ * Exits with 1 if any output differs from snprintf().
+ */
+
+#define FB_TEXT_MAX             (64)
+#define FB_PAINT                (16384)         // bytes of stack painted to measure usage
+#define FB_PAINT_BYTE           (0x5A)
+
+// prototypes
+static long fb_check(void);
+static void fb_paint(void);
+static int fb_scan(void);
+static int fb_stack(void (*function)(void));
+static void fb_call_nothing(void);
+static void fb_call_snprintf(void);
+static void fb_call_ffmt(void);
+static double fb_now_ns(void);
+
+// static variables
+static char fb_text[FB_TEXT_MAX];
+static volatile int fb_sink;
+
+// time one snprintf() and its replacement over values -1000 to 2999
+#define FB_TIME(label, snprintf_call, ffmt_call)                                                        \
+{                                                                                                       \
+    double start;                                                                                       \
+    double snprintf_ns;                                                                                 \
+    double ffmt_ns;                                                                                     \
+    int v;                                                                                              \
+                                                                                                        \
+    start = fb_now_ns();                                                                                \
+    for (i=0; i<calls; i++)                                                                             \
+    {                                                                                                   \
+        v = (i*37)%4000 - 1000;                                                                         \
+        fb_sink += snprintf_call;                                                                       \
+    }                                                                                                   \
+    snprintf_ns = (fb_now_ns() - start)/calls;                                                          \
+                                                                                                        \
+    start = fb_now_ns();                                                                                \
+    for (i=0; i<calls; i++)                                                                             \
+    {                                                                                                   \
+        v = (i*37)%4000 - 1000;                                                                         \
+        fb_sink += ffmt_call;                                                                           \
+    }                                                                                                   \
+    ffmt_ns = (fb_now_ns() - start)/calls;                                                              \
+                                                                                                        \
+    printf("%-26s snprintf %6.1f ns  ffmt %5.1f ns  x%.1f\n", label, snprintf_ns, ffmt_ns, snprintf_ns/ffmt_ns); \
+}
+
+int main(int argc, char *argv[])
+{
+    char a[FB_TEXT_MAX];
+    long mismatches;
+    int calls = 2000000;
+    int baseline;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'n':
+                calls = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (calls <= 0)
+    {
+        fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+        return(1);
+    }
+
+    mismatches = fb_check();
+    printf("%ld outputs differ from snprintf\n", mismatches);
+
+    FB_TIME("x10 \"%c%d.%d\"", snprintf(a, sizeof(a), "%c%d.%d", v<0?'-':' ', abs(v/10), abs(v%10)), ffmt_fixed(a, sizeof(a), v, 1, ' '))
+    FB_TIME("x100 \"%c%d.%02d\"", snprintf(a, sizeof(a), "%c%d.%02d", v<0?'-':' ', abs(v/100), abs(v%100)), ffmt_fixed(a, sizeof(a), v, 2, ' '))
+    FB_TIME("\"%d\"", snprintf(a, sizeof(a), "%d", v), ffmt_int(a, sizeof(a), v))
+    FB_TIME("ipv4", snprintf(a, sizeof(a), "%d.%d.%d.%d", 192, 168, v&255, (v>>3)&255), ffmt_ipv4(a, sizeof(a), 0xC0A80000 | ((v&255)<<8) | ((v>>3)&255)))
+    FB_TIME("timestamp", snprintf(a, sizeof(a), "%04d-%02d-%02dT%02d:%02d:%02d", 2024, (v&7)+1, (v&15)+1, v&15, v&31, v&31),
+            ffmt_timestamp(a, sizeof(a), 2024, (v&7)+1, (v&15)+1, v&15, v&31, v&31, 'T'))
+    FB_TIME("uint64 \"%llu\"", snprintf(a, sizeof(a), "%llu", 1700000000000000ULL + v), ffmt_uint64(a, sizeof(a), 1700000000000000ULL + v))
+
+    baseline = fb_stack(fb_call_nothing);
+    printf("stack below the caller: snprintf %d bytes, ffmt_fixed %d bytes\n", fb_stack(fb_call_snprintf) - baseline, fb_stack(fb_call_ffmt) - baseline);
+
+    printf("%s\n", mismatches ? "FAILED" : "passed");
+
+    return(mismatches ? 1 : 0);
+}
+
+/*!
+ * \brief Compare every formatter with snprintf()
+ *
+ * \return number of outputs that differ
+ */
+static long fb_check(void)
+{
+    static const int32_t int_limits[] = {INT32_MIN, INT32_MAX, -1, 0};
+    static const uint64_t uint64_values[] = {0, 9, UINT32_MAX, (uint64_t)UINT32_MAX + 1, 1700000000123456ULL, UINT64_MAX};
+    char a[FB_TEXT_MAX];
+    char b[FB_TEXT_MAX];
+    long mismatches = 0;
+    uint32_t address;
+    int v;
+    int y;
+    int m;
+    int s;
+    int n;
+    int i;
+
+    for (v=-200000; v<=200000; v++)
+    {
+        snprintf(a, sizeof(a), "%c%d.%d", v<0?'-':' ', abs(v/10), abs(v%10));
+        ffmt_fixed(b, sizeof(b), v, 1, ' ');
+        mismatches += (strcmp(a, b) != 0);
+
+        snprintf(a, sizeof(a), "%c%d.%02d", v<0?'-':' ', abs(v/100), abs(v%100));
+        ffmt_fixed(b, sizeof(b), v, 2, ' ');
+        mismatches += (strcmp(a, b) != 0);
+
+        snprintf(a, sizeof(a), "%d", v);
+        ffmt_int(b, sizeof(b), v);
+        mismatches += (strcmp(a, b) != 0);
+
+        if (v >= 0)
+        {
+            snprintf(a, sizeof(a), "%d.%d", v/10, v%10);
+            ffmt_fixed(b, sizeof(b), v, 1, 0);
+            mismatches += (strcmp(a, b) != 0);
+
+            snprintf(a, sizeof(a), "%u", (unsigned)v);
+            ffmt_uint(b, sizeof(b), v);
+            mismatches += (strcmp(a, b) != 0);
+        }
+    }
+
+    for (i=0; i<(int)(sizeof(int_limits)/sizeof(int_limits[0])); i++)
+    {
+        snprintf(a, sizeof(a), "%ld", (long)int_limits[i]);
+        ffmt_int(b, sizeof(b), int_limits[i]);
+        mismatches += (strcmp(a, b) != 0);
+    }
+
+    for (i=0; i<(int)(sizeof(uint64_values)/sizeof(uint64_values[0])); i++)
+    {
+        snprintf(a, sizeof(a), "%llu", (unsigned long long)uint64_values[i]);
+        ffmt_uint64(b, sizeof(b), uint64_values[i]);
+        mismatches += (strcmp(a, b) != 0);
+    }
+
+    for (i=0; i<3000000; i+=7919)
+    {
+        address = (uint32_t)i*2654435761u;
+        snprintf(a, sizeof(a), "%u.%u.%u.%u", address>>24, (address>>16)&255, (address>>8)&255, address&255);
+        ffmt_ipv4(b, sizeof(b), address);
+        mismatches += (strcmp(a, b) != 0);
+    }
+
+    for (y=1999; y<2100; y+=7)
+    {
+        for (m=1; m<=12; m++)
+        {
+            for (s=0; s<60; s+=13)
+            {
+                snprintf(a, sizeof(a), "%04d-%02d-%02dT%02d:%02d:%02d", y, m, m+9, m+5, s, 59-s);
+                ffmt_timestamp(b, sizeof(b), y, m, m+9, m+5, s, 59-s, 'T');
+                mismatches += (strcmp(a, b) != 0);
+            }
+        }
+    }
+
+    for (v=-720; v<=840; v+=15)
+    {
+        snprintf(a, sizeof(a), "%c%02d:%02d", v<0?'-':'+', abs(v/60), abs(v%60));
+        ffmt_utc_offset(b, sizeof(b), v);
+        mismatches += (strcmp(a, b) != 0);
+    }
+
+    // truncated output and return value as snprintf
+    for (n=0; n<8; n++)
+    {
+        memset(a, 'x', sizeof(a));
+        memset(b, 'x', sizeof(b));
+        mismatches += (snprintf(a, n, " 21.5") != ffmt_fixed(b, n, 215, 1, ' '));
+        mismatches += (memcmp(a, b, sizeof(a)) != 0);
+    }
+
+    return(mismatches);
+}
+
+/*!
+ * \brief Fill the stack below the caller with a known byte
+ *
+ * \return nothing
+ */
+static __attribute__((noinline)) void fb_paint(void)
+{
+    char stack[FB_PAINT];
+
+    memset(stack, FB_PAINT_BYTE, sizeof(stack));
+    __asm__ volatile("" : : "r"(stack) : "memory");
+}
+
+/*!
+ * \brief Find how much of the painted stack has been overwritten
+ *
+ * \return bytes used
+ */
+static __attribute__((noinline)) int fb_scan(void)
+{
+    char stack[FB_PAINT];
+    int i;
+
+    // the compiler must read what the last call left here
+    __asm__ volatile("" : : "r"(stack) : "memory");
+    for (i=0; (i<FB_PAINT) && (stack[i] == FB_PAINT_BYTE); i++);
+
+    return(FB_PAINT - i);
+}
+
+/*!
+ * \brief Measure the stack a function uses
+ *
+ * \param[in]  function     function to call
+ *
+ * \return bytes, including this harness's own frames
+ */
+static int fb_stack(void (*function)(void))
+{
+    fb_paint();
+    function();
+
+    return(fb_scan());
+}
+
+static __attribute__((noinline)) void fb_call_nothing(void)
+{
+    fb_sink = 0;
+}
+
+static __attribute__((noinline)) void fb_call_snprintf(void)
+{
+    int v = -215;
+
+    fb_sink = snprintf(fb_text, sizeof(fb_text), "%c%d.%d", v<0?'-':' ', abs(v/10), abs(v%10));
+}
+
+static __attribute__((noinline)) void fb_call_ffmt(void)
+{
+    fb_sink = ffmt_fixed(fb_text, sizeof(fb_text), -215, 1, ' ');
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return nanoseconds
+ */
+static double fb_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e9 + now.tv_nsec);
+}
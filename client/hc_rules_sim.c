@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "hc_rules.h"
+
+/*
+ * Home controller rule simulator
+ *
+ * Compiles a rules file with the firmware's rule compiler, then feeds it a stream of simulated inputs and prints when
+ * each rule would act.  Each line of the input stream is
+ *
+ *   <seconds> <input> [address:channel] <value>
+ *
+ * with the value in the units hc_rules_update() takes (m/s, C, mm and W x 10) or one of on, off, up, down.  Lines must
+ * be in time order.  Blank lines and lines starting with # are ignored.  The time taken by every evaluation is measured
+ * and the worst case reported, -l replays the stream to get a steadier figure.
+ */
+
+#define HS_LINE_MAX             (512)
+
+// prototypes
+static void hs_usage(const char *program);
+static char *hs_read(const char *name);
+static int hs_event(const char *line, HC_INPUT_T *input, uint32_t *device, int *channel, int32_t *value, uint32_t *ms);
+static void hs_fired(const HC_RULES_T *rules, uint32_t fired, uint32_t now_ms, bool quiet);
+static double hs_now_us(void);
+
+// static variables
+static uint32_t hs_actions = 0;
+
+int main(int argc, char *argv[])
+{
+    HC_RULES_T rules;
+    uint8_t code[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    char text[HC_RULES_TEXT_MAX];
+    char line[HS_LINE_MAX];
+    const char *rules_name = NULL;
+    const char *inputs_name = NULL;
+    char *rules_text;
+    FILE *file;
+    HC_INPUT_T input;
+    uint32_t device;
+    uint32_t event_ms;
+    uint32_t now_ms = 0;
+    uint32_t base_ms = 0;
+    uint32_t last_ms = 0;
+    uint32_t wait_ms;
+    uint32_t fired;
+    uint32_t updates = 0;
+    int32_t value;
+    int channel;
+    int code_length;
+    int num_rules;
+    int loops = 1;
+    int loop;
+    int option;
+    int i;
+    double start;
+    double elapsed;
+    double worst = 0;
+    double total = 0;
+
+    while ((option = getopt(argc, argv, "r:i:l:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'r':
+                rules_name = optarg;
+                break;
+            case 'i':
+                inputs_name = optarg;
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                hs_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (!rules_name || !inputs_name || (loops < 1))
+    {
+        hs_usage(argv[0]);
+        return(1);
+    }
+
+    rules_text = hs_read(rules_name);
+    if (!rules_text)
+    {
+        return(1);
+    }
+
+    num_rules = hc_rules_compile(rules_text, code, sizeof(code), error, sizeof(error));
+    free(rules_text);
+    if (num_rules < 0)
+    {
+        fprintf(stderr, "%s: %s\n", rules_name, error);
+        return(1);
+    }
+
+    for(code_length=0; (code_length < (int)sizeof(code)) && code[code_length]; code_length += code[code_length])
+    {
+    }
+
+    if (hc_rules_load(&rules, code, sizeof(code)) != num_rules)
+    {
+        fprintf(stderr, "compiled rules did not load\n");
+        return(1);
+    }
+
+    printf("%d rules in %d of %d bytes\n", num_rules, code_length + 1, (int)sizeof(code));
+    for(i=0; i<rules.num_rules; i++)
+    {
+        hc_rules_format(&rules.rule[i], text, sizeof(text));
+        printf("  %2d: %s\n", i, text);
+    }
+
+    file = fopen(inputs_name, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", inputs_name, strerror(errno));
+        return(1);
+    }
+
+    for(loop=0; loop<loops; loop++)
+    {
+        rewind(file);
+        base_ms = now_ms;
+
+        while (fgets(line, sizeof(line), file))
+        {
+            line[strcspn(line, "\r\n")] = 0;
+            if ((line[0] == '#') || (strspn(line, " \t") == strlen(line)))
+            {
+                continue;
+            }
+
+            if (hs_event(line, &input, &device, &channel, &value, &event_ms))
+            {
+                fprintf(stderr, "ignored: %s\n", line);
+                continue;
+            }
+            event_ms += base_ms;
+
+            // holds that run out up to this event, at the time they run out
+            for (;;)
+            {
+                hs_fired(&rules, hc_rules_tick(&rules, now_ms, &wait_ms), now_ms, loop);
+                if (wait_ms > event_ms - now_ms)
+                {
+                    break;
+                }
+                now_ms += wait_ms;
+            }
+            now_ms = event_ms;
+
+            start = hs_now_us();
+            fired = hc_rules_update(&rules, input, device, channel, value, now_ms);
+            elapsed = hs_now_us() - start;
+
+            total += elapsed;
+            if (elapsed > worst)
+            {
+                worst = elapsed;
+            }
+            updates++;
+
+            hs_fired(&rules, fired, now_ms, loop);
+            last_ms = now_ms;
+        }
+
+        // holds still running at the end of the stream, then start the next pass an hour later
+        event_ms = last_ms + 3600000;
+        for (;;)
+        {
+            hs_fired(&rules, hc_rules_tick(&rules, now_ms, &wait_ms), now_ms, loop);
+            if (wait_ms > event_ms - now_ms)
+            {
+                break;
+            }
+            now_ms += wait_ms;
+        }
+        now_ms = event_ms;
+    }
+
+    fclose(file);
+
+    printf("%u updates, %u rule evaluations, %u actions\n", updates, rules.evaluations, hs_actions);
+    if (updates)
+    {
+        printf("update mean %.3f us worst %.3f us\n", total / updates, worst);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void hs_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s -r rules -i inputs [-l loops]\n"
+            "  -r file      rules, one per line\n"
+            "  -i file      input stream: seconds input [address:channel] value\n"
+            "  -l count     replay the input stream this many times (default 1)\n",
+            program);
+}
+
+/*!
+ * \brief Read a whole file
+ *
+ * \param[in]  name     file name
+ *
+ * \return allocated nul terminated contents, NULL on error
+ */
+static char *hs_read(const char *name)
+{
+    FILE *file;
+    char *text = NULL;
+    long size;
+
+    file = fopen(name, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", name, strerror(errno));
+        return(NULL);
+    }
+
+    if (!fseek(file, 0, SEEK_END) && ((size = ftell(file)) >= 0) && !fseek(file, 0, SEEK_SET))
+    {
+        text = malloc(size + 1);
+        if (text)
+        {
+            text[fread(text, 1, size, file)] = 0;
+        }
+    }
+
+    fclose(file);
+
+    return(text);
+}
+
+/*!
+ * \brief Parse one line of the input stream
+ *
+ * \param[in]   line        e.g. "12.5 power 192.168.1.20:0 15000"
+ * \param[out]  input       input
+ * \param[out]  device      shelly address or 0
+ * \param[out]  channel     shelly channel or 0
+ * \param[out]  value       value
+ * \param[out]  ms          time of the event
+ *
+ * \return 0 on success, -1 if the line is not understood
+ */
+static int hs_event(const char *line, HC_INPUT_T *input, uint32_t *device, int *channel, int32_t *value, uint32_t *ms)
+{
+    static const struct { const char *name; int32_t value; } words[] = {{"on", 1}, {"off", 0}, {"up", 1}, {"down", 0}};
+    char name[24];
+    char argument[2][24];
+    const char *text;
+    unsigned int octet[4];
+    double seconds;
+    char *end;
+    int fields;
+    int i;
+
+    fields = sscanf(line, "%lf %23s %23s %23s", &seconds, name, argument[0], argument[1]);
+    if ((fields < 3) || (seconds < 0))
+    {
+        return(-1);
+    }
+
+    for(i=HC_INPUT_NONE+1; (i<NUM_HC_INPUTS) && strcmp(name, hc_rules_input_name((HC_INPUT_T)i)); i++)
+    {
+    }
+    if (i == NUM_HC_INPUTS)
+    {
+        return(-1);
+    }
+
+    *input = (HC_INPUT_T)i;
+    *device = 0;
+    *channel = 0;
+    *ms = (uint32_t)(seconds*1000);
+    text = argument[0];
+
+    if (fields == 4)
+    {
+        if ((sscanf(argument[0], "%u.%u.%u.%u:%d", &octet[0], &octet[1], &octet[2], &octet[3], channel) != 5) ||
+            (octet[0] > 255) || (octet[1] > 255) || (octet[2] > 255) || (octet[3] > 255))
+        {
+            return(-1);
+        }
+        *device = (octet[0] << 24) | (octet[1] << 16) | (octet[2] << 8) | octet[3];
+        text = argument[1];
+    }
+
+    for(i=0; i<(int)(sizeof(words)/sizeof(words[0])); i++)
+    {
+        if (!strcasecmp(text, words[i].name))
+        {
+            *value = words[i].value;
+            return(0);
+        }
+    }
+
+    *value = (int32_t)strtol(text, &end, 10);
+
+    return(*end ? -1 : 0);
+}
+
+/*!
+ * \brief Print the actions of rules that fired
+ *
+ * \param[in]  rules    rule table
+ * \param[in]  fired    mask of rules that fired
+ * \param[in]  now_ms   simulated time
+ * \param[in]  quiet    count but do not print
+ *
+ * \return nothing
+ */
+static void hs_fired(const HC_RULES_T *rules, uint32_t fired, uint32_t now_ms, bool quiet)
+{
+    char text[HC_RULES_TEXT_MAX];
+    int i;
+
+    for(; fired; fired &= fired - 1)
+    {
+        i = __builtin_ctz(fired);
+        hs_actions++;
+
+        if (!quiet)
+        {
+            hc_rules_format(&rules->rule[i], text, sizeof(text));
+            printf("%9.3f s  rule %d: %s\n", now_ms / 1000.0, i, strstr(text, "-> ") ? strstr(text, "-> ") + 3 : text);
+        }
+    }
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double hs_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
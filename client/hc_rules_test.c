@@ -0,0 +1,645 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "hc_rules.h"
+
+/*
+ * Home controller rules test
+ *
+ * Runs hc_rules.c through the rule text it must accept and reject, edits of compiled code, corrupt code, and a timed
+ * stream of inputs whose actions are known.  Built twice by the Makefile: hc_rules_test with INCORPORATE_THERMOSTAT,
+ * as the thermostat builds the rules, and hc_rules_controller_test without it, as the home controller does.
+ *
+ * Checks that:
+ *
+ *   - canonical rules compile, format back to the same text, and the text compiles to the same code
+ *   - rules written loosely (case, spacing, state words, whole numbers, comments) format to their canonical text
+ *   - bad rules are rejected with the expected error, setpoint included in builds without the thermostat
+ *   - rules are added, replaced and deleted one at a time, and an edit that fails leaves the code unchanged
+ *   - corrupt code loads no rules
+ *   - each input's mask holds exactly the rules that test it, so grid and battery rules ask for the powerwall
+ *   - a stream of inputs fires the expected rules at the expected times, with the clock starting at zero and just
+ *     before it wraps, and an unchanged reading evaluates nothing
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#define HR_DEVICE(a, b, c, d)   (((uint32_t)(a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+#define HR_FIRED_MAX            (32)
+#define HR_SIMPLE_RULE          "wind > 5.0 -> relay 1.2.3.4:0 on"      // 16 bytes of code
+
+typedef struct
+{
+    const char *text;
+    const char *canonical;      // NULL if the text is canonical
+} HR_ROUND_TRIP_T;
+
+typedef struct
+{
+    const char *text;
+    const char *error;
+} HR_REJECT_T;
+
+typedef struct
+{
+    uint32_t ms;
+    HC_INPUT_T input;
+    uint32_t device;
+    int channel;
+    int32_t value;
+} HR_EVENT_T;
+
+typedef struct
+{
+    uint32_t ms;
+    int rule;
+} HR_FIRED_T;
+
+// prototypes
+static void hr_usage(const char *program);
+static bool hr_round_trip(const char *text, const char *canonical);
+static bool hr_reject(const char *text, const char *expected, int code_size);
+static bool hr_edit(void);
+static bool hr_corrupt(void);
+static bool hr_depends(void);
+static bool hr_sequence(uint32_t base_ms);
+static int hr_record(HR_FIRED_T *fired, int count, uint32_t mask, uint32_t ms);
+
+// static variables
+static bool hr_verbose = false;
+
+static const HR_ROUND_TRIP_T hr_round_trips[] =
+{
+    {"wind >= 10.0 -> relay 192.168.1.20:0 on", NULL},
+    {"gust > 12.5 for 30 -> relay 192.168.1.20:0 off", NULL},
+    {"anemometer < 0.5 and temperature <= -2.5 -> relay 10.0.0.1:7 on", NULL},
+    {"rain_day == 0.0 and rain_week != 25.4 for 65535 -> relay 192.168.1.20:1 off", NULL},
+    {"grid == down and battery < 30 -> relay 192.168.1.21:0 off", NULL},
+    {"grid != up -> relay 192.168.1.21:0 on", NULL},
+    {"battery >= 95 -> relay 192.168.1.21:0 on", NULL},
+    {"relay 192.168.1.21:0 == on and power 192.168.1.21:0 > 1500.0 for 600 -> relay 192.168.1.21:0 off", NULL},
+    {"input 192.168.1.30:2 == off and wind < 3.0 and gust < 5.0 and temperature > 30.0 -> relay 192.168.1.30:0 on", NULL},
+    {"power 255.255.255.255:0 > -1.5 -> relay 0.0.0.0:0 off", NULL},
+    {"  GUST>12.5   for 30->RELAY 192.168.1.20:0 OFF  ", "gust > 12.5 for 30 -> relay 192.168.1.20:0 off"},
+    {"wind > 10 -> relay 192.168.1.20:0 true", "wind > 10.0 -> relay 192.168.1.20:0 on"},
+    {"grid == 0 -> relay 1.2.3.4:0 1", "grid == down -> relay 1.2.3.4:0 on"},
+    {"grid == 2 -> relay 1.2.3.4:0 0", "grid == 2 -> relay 1.2.3.4:0 off"},
+    {"battery < 30 for 0 -> relay 1.2.3.4:0 off", "battery < 30 -> relay 1.2.3.4:0 off"},
+    {"relay 1.2.3.4:0 == true and rain_day > 1. -> relay 1.2.3.4:1 off",
+     "relay 1.2.3.4:0 == on and rain_day > 1.0 -> relay 1.2.3.4:1 off"},
+    {"wind > 5 -> relay 1.2.3.4:0 on # too windy", "wind > 5.0 -> relay 1.2.3.4:0 on"},
+    {"\n\n# first line\ntemperature>-0.5->relay 1.2.3.4:3 off\n", "temperature > -0.5 -> relay 1.2.3.4:3 off"},
+#ifdef INCORPORATE_THERMOSTAT
+    {"grid == down and battery < 30 -> setpoint -2.0", NULL},
+    {"temperature > 35.0 for 300 -> setpoint 1.5", NULL},
+    {"wind > 5 -> SETPOINT 3", "wind > 5.0 -> setpoint 3.0"},
+#endif
+};
+
+static const HR_REJECT_T hr_rejects[] =
+{
+    {"humidity > 50 -> relay 1.2.3.4:0 on", "unknown input 'humidity'"},
+    {"power > 5 -> relay 1.2.3.4:0 on", "power needs address:channel, not '>'"},
+    {"power 1.2.3.4:8 > 5 -> relay 1.2.3.4:0 on", "power needs address:channel, not '1.2.3.4:8'"},
+    {"relay 1.2.3.256:0 == on -> relay 1.2.3.4:0 on", "relay needs address:channel, not '1.2.3.256:0'"},
+    {"wind => 5 -> relay 1.2.3.4:0 on", "unknown comparison '=>'"},
+    {"wind 5 -> relay 1.2.3.4:0 on", "unknown comparison '5'"},
+    {"wind > fast -> relay 1.2.3.4:0 on", "bad value 'fast' for wind"},
+    {"wind > 2.55 -> relay 1.2.3.4:0 on", "bad value '2.55' for wind"},
+    {"battery > 5.5 -> relay 1.2.3.4:0 on", "bad value '5.5' for battery"},
+    {"wind > 5 for 65536 -> relay 1.2.3.4:0 on", "bad hold time '65536'"},
+    {"wind > 5 for -1 -> relay 1.2.3.4:0 on", "bad hold time '-1'"},
+    {"wind > 5 relay 1.2.3.4:0 on", "expected '->' not 'relay'"},
+    {"wind > 5 or gust > 5 -> relay 1.2.3.4:0 on", "expected '->' not 'or'"},
+    {"wind > 5 -> relay 1.2.3.4 on", "relay needs address:channel, not '1.2.3.4'"},
+    {"wind > 5 -> relay 1.2.3.4:0 2", "relay needs on or off, not '2'"},
+    {"wind > 5 -> light 1.2.3.4:0 on", "unknown action 'light'"},
+    {"wind > 5 -> relay 1.2.3.4:0 on off", "unexpected 'off' after action"},
+    {"wind > 1 and wind > 2 and wind > 3 and wind > 4 and wind > 5 -> relay 1.2.3.4:0 on", "more than 4 conditions"},
+    {"wind > 5 -> relay 1.2.3.4:0 on\ngust > -> relay 1.2.3.4:0 off", "bad value '->' for gust"},
+#ifdef INCORPORATE_THERMOSTAT
+    {"wind > 5 -> setpoint 3276.8", "bad setpoint offset '3276.8'"},
+    {"wind > 5 -> setpoint", "bad setpoint offset ''"},
+#else
+    {"grid == down and battery < 30 -> setpoint -2.0", "setpoint needs the thermostat"},
+#endif
+};
+
+// the rules and inputs of the timed stream, and the actions they must give
+static const char hr_sequence_rules[] =
+    "gust > 12.5 for 30 -> relay 192.168.1.20:0 off\n"
+    "gust <= 8.0 for 60 -> relay 192.168.1.20:0 on\n"
+    "grid == down and battery < 30 -> relay 192.168.1.21:0 off\n"
+    "relay 192.168.1.22:1 == on and power 192.168.1.22:1 > 1500.0 for 600 -> relay 192.168.1.22:1 off\n"
+    "temperature < -2.5 -> relay 192.168.1.23:0 on\n";
+
+static const HR_EVENT_T hr_events[] =
+{
+    {     0, HC_INPUT_GUST,        0,                          0,   100},
+    { 10000, HC_INPUT_GUST,        0,                          0,   130},     // rule 0 starts holding
+    { 20000, HC_INPUT_GUST,        0,                          0,   120},     // and stops
+    { 25000, HC_INPUT_GUST,        0,                          0,   140},     // rule 0 holds from here
+    { 60000, HC_INPUT_GUST,        0,                          0,   150},     // already fired
+    { 70000, HC_INPUT_GUST,        0,                          0,    70},     // rule 1 holds from here
+    {100000, HC_INPUT_GRID,        0,                          0,     1},
+    {110000, HC_INPUT_BATTERY,     0,                          0,    25},
+    {120000, HC_INPUT_GRID,        0,                          0,     0},     // rule 2 fires
+    {125000, HC_INPUT_BATTERY,     0,                          0,    25},     // unchanged
+    {140000, HC_INPUT_BATTERY,     0,                          0,    35},
+    {150000, HC_INPUT_BATTERY,     0,                          0,    20},     // rule 2 fires again
+    {200000, HC_INPUT_RELAY,       HR_DEVICE(192, 168, 1, 22), 1,     1},
+    {200000, HC_INPUT_POWER,       HR_DEVICE(192, 168, 1, 22), 1, 16000},     // rule 3 holds from here
+    {300000, HC_INPUT_POWER,       HR_DEVICE(192, 168, 1, 22), 1, 17000},     // still true, hold not restarted
+    {500000, HC_INPUT_POWER,       HR_DEVICE(192, 168, 1, 22), 0,     0},     // another channel
+    {600000, HC_INPUT_POWER,       HR_DEVICE(192, 168, 1, 23), 1,     0},     // another device
+    {900000, HC_INPUT_TEMPERATURE, 0,                          0,   -30},
+    {910000, HC_INPUT_TEMPERATURE, 0,                          0,   -25},
+    {920000, HC_INPUT_TEMPERATURE, 0,                          0,   -26},
+};
+
+static const HR_FIRED_T hr_expected[] =
+{
+    { 55000, 0},
+    {120000, 2},
+    {130000, 1},
+    {150000, 2},
+    {800000, 3},
+    {900000, 4},
+    {920000, 4},
+};
+
+int main(int argc, char *argv[])
+{
+    bool passed = true;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "vh")) != -1)
+    {
+        switch (option)
+        {
+            case 'v':
+                hr_verbose = true;
+                break;
+            default:
+                hr_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    for (i = 0; i < (int)(sizeof(hr_round_trips)/sizeof(hr_round_trips[0])); i++)
+    {
+        passed &= hr_round_trip(hr_round_trips[i].text, hr_round_trips[i].canonical);
+    }
+
+    for (i = 0; i < (int)(sizeof(hr_rejects)/sizeof(hr_rejects[0])); i++)
+    {
+        passed &= hr_reject(hr_rejects[i].text, hr_rejects[i].error, HC_RULES_CODE_SIZE);
+    }
+
+    passed &= hr_edit();
+    passed &= hr_corrupt();
+    passed &= hr_depends();
+    passed &= hr_sequence(0);
+    passed &= hr_sequence(UINT32_MAX - 100000);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void hr_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-v]\n"
+            "  -v           print every rule checked\n",
+            program);
+}
+
+/*!
+ * \brief Compile a rule, format it back and compile the result again
+ *
+ * \param[in]  text        rule
+ * \param[in]  canonical   text it must format to, NULL if that is text itself
+ *
+ * \return true if the check passed
+ */
+static bool hr_round_trip(const char *text, const char *canonical)
+{
+    uint8_t code[HC_RULES_CODE_SIZE];
+    uint8_t again[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    char formatted[HC_RULES_TEXT_MAX];
+    HC_RULE_T rule;
+    int length;
+
+    if (!canonical)
+    {
+        canonical = text;
+    }
+
+    if (hc_rules_compile(text, code, sizeof(code), error, sizeof(error)) != 1)
+    {
+        printf("round trip: '%s' did not compile: %s\n", text, error);
+        return(false);
+    }
+
+    if (hc_rules_get(code, sizeof(code), 0, &rule) || !hc_rules_get(code, sizeof(code), 1, &rule) ||
+        hc_rules_get(code, sizeof(code), 0, &rule))
+    {
+        printf("round trip: '%s' could not be read back\n", text);
+        return(false);
+    }
+
+    length = hc_rules_format(&rule, formatted, sizeof(formatted));
+    if ((length != (int)strlen(formatted)) || strcmp(formatted, canonical))
+    {
+        printf("round trip: '%s' formatted as '%s', expected '%s'\n", text, formatted, canonical);
+        return(false);
+    }
+
+    if ((hc_rules_compile(formatted, again, sizeof(again), error, sizeof(error)) != 1) || memcmp(code, again, sizeof(code)))
+    {
+        printf("round trip: '%s' compiled to different code\n", formatted);
+        return(false);
+    }
+
+    if (hr_verbose)
+    {
+        printf("round trip: %s\n", formatted);
+    }
+
+    return(true);
+}
+
+/*!
+ * \brief Compile rules that must be rejected
+ *
+ * \param[in]  text        rules
+ * \param[in]  expected    error they must give
+ * \param[in]  code_size   space to compile them into
+ *
+ * \return true if the check passed
+ */
+static bool hr_reject(const char *text, const char *expected, int code_size)
+{
+    uint8_t code[2*HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    int compiled;
+
+    compiled = hc_rules_compile(text, code, code_size, error, sizeof(error));
+    if ((compiled != -1) || strcmp(error, expected))
+    {
+        printf("reject: '%.60s' gave %d '%s', expected '%s'\n", text, compiled, compiled < 0 ? error : "", expected);
+        return(false);
+    }
+
+    if (hr_verbose)
+    {
+        printf("reject: %s\n", error);
+    }
+
+    return(true);
+}
+
+/*!
+ * \brief Add, replace and delete rules in compiled code, and edits that must fail
+ *
+ * \return true if every check passed
+ */
+static bool hr_edit(void)
+{
+    static const struct { int index; const char *text; int rules; const char *error; } edits[] =
+    {
+        {2, "battery < 20 -> relay 1.2.3.4:2 off", 3, NULL},
+        {0, "grid == down -> relay 1.2.3.4:0 off", 3, NULL},
+        {1, "", 2, NULL},
+        {3, HR_SIMPLE_RULE, -1, "no rule 3"},
+        {-1, HR_SIMPLE_RULE, -1, "no rule -1"},
+        {0, HR_SIMPLE_RULE "\n" HR_SIMPLE_RULE, -1, "one rule at a time"},
+        {0, "wind > -> relay 1.2.3.4:0 on", -1, "bad value '->' for wind"},
+    };
+    static const char *expected[] = {"grid == down -> relay 1.2.3.4:0 off", "battery < 20 -> relay 1.2.3.4:2 off"};
+    uint8_t code[HC_RULES_CODE_SIZE];
+    uint8_t before[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    char text[HC_RULES_TEXT_MAX];
+    char many[(sizeof(HR_SIMPLE_RULE) + 1)*(HC_RULES_MAX + 1)];
+    HC_RULE_T rule;
+    bool passed = true;
+    int result;
+    int i;
+
+    if (hc_rules_compile("wind > 10 -> relay 1.2.3.4:0 off\ngust > 15 -> relay 1.2.3.4:1 off", code, sizeof(code),
+                         error, sizeof(error)) != 2)
+    {
+        printf("edit: rules did not compile: %s\n", error);
+        return(false);
+    }
+
+    for (i = 0; i < (int)(sizeof(edits)/sizeof(edits[0])); i++)
+    {
+        memcpy(before, code, sizeof(code));
+        error[0] = 0;
+        result = hc_rules_edit(code, sizeof(code), edits[i].index, edits[i].text, error, sizeof(error));
+        if ((result != edits[i].rules) || (edits[i].error && (strcmp(error, edits[i].error) || memcmp(before, code, sizeof(code)))))
+        {
+            printf("edit: %d '%s' gave %d '%s'\n", edits[i].index, edits[i].text, result, error);
+            passed = false;
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        text[0] = 0;
+        if (!hc_rules_get(code, sizeof(code), i, &rule))
+        {
+            hc_rules_format(&rule, text, sizeof(text));
+        }
+        if (strcmp(text, expected[i]))
+        {
+            printf("edit: rule %d is '%s', expected '%s'\n", i, text, expected[i]);
+            passed = false;
+        }
+    }
+    if (!hc_rules_get(code, sizeof(code), 2, &rule))
+    {
+        printf("edit: deleted rule still there\n");
+        passed = false;
+    }
+
+    // 31 rules of 16 bytes leave 16 bytes, of which the terminator needs one
+    memset(code, 0, sizeof(code));
+    for (i = 0; i < 31; i++)
+    {
+        if (hc_rules_edit(code, sizeof(code), i, HR_SIMPLE_RULE, error, sizeof(error)) != i + 1)
+        {
+            printf("edit: could not add rule %d: %s\n", i, error);
+            return(false);
+        }
+    }
+    memcpy(before, code, sizeof(code));
+    if ((hc_rules_edit(code, sizeof(code), 31, HR_SIMPLE_RULE, error, sizeof(error)) != -1) ||
+        strcmp(error, "rules do not fit in 512 bytes") || memcmp(before, code, sizeof(code)))
+    {
+        printf("edit: overflow was not rejected\n");
+        passed = false;
+    }
+    if (hc_rules_edit(code, sizeof(code), 30, "wind > 1 -> relay 1.2.3.4:1 off", error, sizeof(error)) != 31)
+    {
+        printf("edit: rule could not be replaced in full code: %s\n", error);
+        passed = false;
+    }
+
+    // the same limits when compiling
+    many[0] = 0;
+    for (i = 0; i < HC_RULES_MAX + 1; i++)
+    {
+        strcat(many, HR_SIMPLE_RULE ";");
+    }
+    passed &= hr_reject(many, "rule 32 does not fit in 512 bytes", HC_RULES_CODE_SIZE);
+    passed &= hr_reject(many, "more than 32 rules", 2*HC_RULES_CODE_SIZE);
+
+    return(passed);
+}
+
+/*!
+ * \brief Load code that has been damaged
+ *
+ * \return true if every check passed
+ */
+static bool hr_corrupt(void)
+{
+    uint8_t good[HC_RULES_CODE_SIZE];
+    uint8_t code[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    HC_RULES_T rules;
+    bool passed = true;
+    int damage;
+    int loaded;
+
+    // relay action (10 bytes) then a gust condition (6 bytes), then a second rule
+    if ((hc_rules_compile("gust > 12.5 -> relay 1.2.3.4:0 off\n" HR_SIMPLE_RULE, good, sizeof(good), error, sizeof(error)) != 2) ||
+        (hc_rules_load(&rules, good, sizeof(good)) != 2) || (good[0] != 16))
+    {
+        printf("corrupt: rules did not compile and load\n");
+        return(false);
+    }
+
+    for (damage = 0; damage < 6; damage++)
+    {
+        memcpy(code, good, sizeof(code));
+        switch (damage)
+        {
+            case 0:
+                code[3] = NUM_HC_ACTIONS;               // unknown action
+                break;
+            case 1:
+                code[10] = NUM_HC_INPUTS;               // unknown input
+                break;
+            case 2:
+                code[11] = NUM_HC_OPS;                  // unknown comparison
+                break;
+            case 3:
+                code[0] = 10;                           // no conditions
+                break;
+            case 4:
+                code[0] = 8;                            // action cut short
+                break;
+            case 5:
+                code[16] = 250;                         // second rule runs past the end
+                break;
+        }
+
+        // the rule without conditions is loaded alone, else the bytes after it fail to decode whatever it does
+        loaded = hc_rules_load(&rules, code, (damage == 3) ? 10 : (damage == 5) ? 32 : (int)sizeof(code));
+        if ((loaded != -1) || rules.num_rules)
+        {
+            printf("corrupt: damage %d loaded %d rules\n", damage, loaded);
+            passed = false;
+        }
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Check each input's mask names the rules that test it
+ *
+ * \return true if every check passed
+ */
+static bool hr_depends(void)
+{
+    static const uint32_t expected[NUM_HC_INPUTS] =
+    {
+        [HC_INPUT_GUST] = 0x03,
+        [HC_INPUT_GRID] = 0x04,
+        [HC_INPUT_BATTERY] = 0x04,
+        [HC_INPUT_RELAY] = 0x08,
+        [HC_INPUT_POWER] = 0x08,
+        [HC_INPUT_TEMPERATURE] = 0x10,
+    };
+    uint8_t code[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    HC_RULES_T rules;
+    bool passed = true;
+    int i;
+
+    if ((hc_rules_compile(hr_sequence_rules, code, sizeof(code), error, sizeof(error)) != 5) ||
+        (hc_rules_load(&rules, code, sizeof(code)) != 5))
+    {
+        printf("depends: rules did not compile and load: %s\n", error);
+        return(false);
+    }
+
+    for (i = 0; i < NUM_HC_INPUTS; i++)
+    {
+        if (rules.depends[i] != expected[i])
+        {
+            printf("depends: %s is 0x%x, expected 0x%x\n", hc_rules_input_name((HC_INPUT_T)i), rules.depends[i], expected[i]);
+            passed = false;
+        }
+    }
+
+    // what hc_task asks powerwall_task for
+    if (!(rules.depends[HC_INPUT_GRID] | rules.depends[HC_INPUT_BATTERY]) ||
+        (hc_rules_edit(code, sizeof(code), 2, "", error, sizeof(error)) != 4) || (hc_rules_load(&rules, code, sizeof(code)) != 4) ||
+        (rules.depends[HC_INPUT_GRID] | rules.depends[HC_INPUT_BATTERY]))
+    {
+        printf("depends: powerwall wanted without grid or battery rules\n");
+        passed = false;
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Feed the timed stream of inputs to the rules, as hc_rules_sim does, and compare the actions
+ *
+ * \param[in]  base_ms   clock at the start of the stream
+ *
+ * \return true if every check passed
+ */
+static bool hr_sequence(uint32_t base_ms)
+{
+    uint8_t code[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    HC_RULES_T rules;
+    HR_FIRED_T fired[HR_FIRED_MAX];
+    const HR_EVENT_T *event;
+    uint32_t now_ms = base_ms;
+    uint32_t event_ms;
+    uint32_t wait_ms;
+    uint32_t evaluations;
+    bool passed = true;
+    int count = 0;
+    int i;
+
+    if ((hc_rules_compile(hr_sequence_rules, code, sizeof(code), error, sizeof(error)) != 5) ||
+        (hc_rules_load(&rules, code, sizeof(code)) != 5))
+    {
+        printf("sequence: rules did not compile and load: %s\n", error);
+        return(false);
+    }
+
+    for (i = 0; i < (int)(sizeof(hr_events)/sizeof(hr_events[0])); i++)
+    {
+        event = &hr_events[i];
+        event_ms = base_ms + event->ms;
+
+        // holds that run out up to this event, at the time they run out
+        for (;;)
+        {
+            count = hr_record(fired, count, hc_rules_tick(&rules, now_ms, &wait_ms), now_ms - base_ms);
+            if (wait_ms > event_ms - now_ms)
+            {
+                break;
+            }
+            if (!wait_ms)
+            {
+                printf("sequence: hold ran out but did not fire at %u ms\n", now_ms - base_ms);
+                return(false);
+            }
+            now_ms += wait_ms;
+        }
+        now_ms = event_ms;
+
+        evaluations = rules.evaluations;
+        count = hr_record(fired, count, hc_rules_update(&rules, event->input, event->device, event->channel, event->value, now_ms),
+                          now_ms - base_ms);
+
+        if ((event->ms == 125000) && (rules.evaluations != evaluations))
+        {
+            printf("sequence: an unchanged reading was evaluated\n");
+            passed = false;
+        }
+    }
+
+    // nothing is left holding
+    count = hr_record(fired, count, hc_rules_tick(&rules, now_ms + 3600000, &wait_ms), now_ms + 3600000 - base_ms);
+    if (rules.holding || (wait_ms != UINT32_MAX))
+    {
+        printf("sequence: rules still holding at the end\n");
+        passed = false;
+    }
+
+    if (count != (int)(sizeof(hr_expected)/sizeof(hr_expected[0])))
+    {
+        printf("sequence from %u ms: %d actions, expected %d\n", base_ms, count, (int)(sizeof(hr_expected)/sizeof(hr_expected[0])));
+        passed = false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((i >= (int)(sizeof(hr_expected)/sizeof(hr_expected[0]))) ||
+            (fired[i].ms != hr_expected[i].ms) || (fired[i].rule != hr_expected[i].rule))
+        {
+            printf("sequence from %u ms: rule %d fired at %u ms\n", base_ms, fired[i].rule, fired[i].ms);
+            passed = false;
+        }
+        else if (hr_verbose)
+        {
+            printf("sequence from %u ms: rule %d fired at %u ms\n", base_ms, fired[i].rule, fired[i].ms);
+        }
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Add the rules that fired to the list, in rule order
+ *
+ * \param[out]  fired   list of actions
+ * \param[in]   count   actions in the list
+ * \param[in]   mask    rules that fired
+ * \param[in]   ms      time since the start of the stream
+ *
+ * \return actions now in the list
+ */
+static int hr_record(HR_FIRED_T *fired, int count, uint32_t mask, uint32_t ms)
+{
+    for (; mask && (count < HR_FIRED_MAX); mask &= mask - 1)
+    {
+        fired[count].ms = ms;
+        fired[count].rule = __builtin_ctz(mask);
+        count++;
+    }
+
+    return(count);
+}
@@ -0,0 +1,398 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "lwip/apps/fs.h"
+
+#include "thermostat.h"
+#include "custom_files.h"
+
+/*
+ * History stream test
+ *
+ * Links custom_files.c against the host stand-ins in client/shim and a made up temperature history, opens /history
+ * the way httpd does and checks that:
+ *
+ *   - the response is the same whatever size of piece httpd reads it in, from 1 byte up
+ *   - the Content-Length in the header is the length of the body that follows
+ *   - the body is the JSON the graph expects, compared with a copy formatted here in one go
+ *   - every byte allocated with mem_malloc() is released on close
+ *
+ * for histories that are empty, part full, full, and full with extreme times and temperatures.  Then it times
+ * rendering the full history against the per-point iso timestamp formatting of the SSI tags it replaced.
+ * Exits with 1 if any check fails.
+ */
+
+#define HT_READ_MAX             (600)           // largest piece read, more than the whole response
+#define HT_RESPONSE_MAX         (8192)
+#define HT_RENDERS              (20000)
+
+typedef enum
+{
+    HT_EMPTY = 0,
+    HT_ONE,
+    HT_PART,
+    HT_FULL,
+    HT_EXTREME,
+} HT_HISTORY_T;
+
+// prototypes
+static bool ht_check(HT_HISTORY_T history, bool verbose);
+static int ht_render(char *response, int size, int piece);
+static int ht_expected(char *body, int size);
+static void ht_fill(HT_HISTORY_T history);
+static double ht_time_old(int *length);
+static double ht_time_new(int *length);
+static double ht_now_us(void);
+
+// static variables
+static uint32_t ht_unix_time[SIZE_CLIMATE_HISTORY];
+static int16_t ht_temperaturex10[SIZE_CLIMATE_HISTORY];
+static int ht_count = 0;
+
+static const char *ht_names[] = {"empty", "one sample", "part full", "full", "full, extreme values"};
+
+int main(int argc, char *argv[])
+{
+    bool verbose = false;
+    bool passed = true;
+    double old_us;
+    double new_us;
+    int old_length;
+    int new_length;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "vh")) != -1)
+    {
+        switch(option)
+        {
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    for (i=HT_EMPTY; i<=HT_EXTREME; i++)
+    {
+        passed &= ht_check((HT_HISTORY_T)i, verbose);
+    }
+
+    ht_fill(HT_FULL);
+    old_us = ht_time_old(&old_length);
+    new_us = ht_time_new(&new_length);
+    printf("ssi tags:  %5d bytes %6.1f us per render (plus %d tag lookups)\n", old_length, old_us, SIZE_CLIMATE_HISTORY);
+    printf("/history:  %5d bytes %6.1f us per render\n", new_length, new_us);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Check the response for one history read in every piece size
+ *
+ * \param[in]  history      samples to serve
+ * \param[in]  verbose      print the response
+ *
+ * \return true if all checks passed
+ */
+static bool ht_check(HT_HISTORY_T history, bool verbose)
+{
+    static char whole[HT_RESPONSE_MAX];
+    static char pieces[HT_RESPONSE_MAX];
+    static char expected[HT_RESPONSE_MAX];
+    const char *content_length;
+    const char *body;
+    int whole_length;
+    int length;
+    int piece;
+
+    ht_fill(history);
+
+    whole_length = ht_render(whole, sizeof(whole), HT_READ_MAX);
+    if (whole_length <= 0)
+    {
+        printf("%-22s cannot open /history\n", ht_names[history]);
+        return(false);
+    }
+    whole[whole_length] = 0;
+
+    if (verbose)
+    {
+        printf("%s\n", whole);
+    }
+
+    body = strstr(whole, "\r\n\r\n");
+    content_length = strstr(whole, "Content-Length: ");
+    if (!body || !content_length || (content_length > body))
+    {
+        printf("%-22s header has no Content-Length\n", ht_names[history]);
+        return(false);
+    }
+    body += 4;
+
+    if (atoi(content_length + 16) != (int)strlen(body))
+    {
+        printf("%-22s Content-Length %d but body is %d bytes\n", ht_names[history], atoi(content_length + 16), (int)strlen(body));
+        return(false);
+    }
+
+    ht_expected(expected, sizeof(expected));
+    if (strcmp(body, expected))
+    {
+        printf("%-22s body\n  %s\nexpected\n  %s\n", ht_names[history], body, expected);
+        return(false);
+    }
+
+    for (piece=1; piece<=HT_READ_MAX; piece++)
+    {
+        length = ht_render(pieces, sizeof(pieces), piece);
+        if ((length != whole_length) || memcmp(pieces, whole, whole_length))
+        {
+            printf("%-22s read %d bytes at a time gives a different response\n", ht_names[history], piece);
+            return(false);
+        }
+    }
+
+    if (shim_mem_allocated)
+    {
+        printf("%-22s %ld bytes not released\n", ht_names[history], shim_mem_allocated);
+        return(false);
+    }
+
+    printf("%-22s %3d samples %5d bytes, same for every read size 1 to %d  ok\n", ht_names[history], ht_count, whole_length, HT_READ_MAX);
+
+    return(true);
+}
+
+/*!
+ * \brief Open /history and read it all as httpd does
+ *
+ * \param[out] response     destination
+ * \param[in]  size         size of destination
+ * \param[in]  piece        bytes to ask for per read
+ *
+ * \return bytes read or -1 if the file cannot be opened, is too long or does not match its length
+ */
+static int ht_render(char *response, int size, int piece)
+{
+    struct fs_file file;
+    int length = 0;
+    int read;
+
+    if (fs_open(&file, "/history") != ERR_OK)
+    {
+        return(-1);
+    }
+
+    while (fs_bytes_left(&file) > 0)
+    {
+        if (length + piece >= size)
+        {
+            length = -1;
+            break;
+        }
+
+        read = fs_read_async_custom(&file, response + length, piece, NULL, NULL);
+        if (read <= 0)
+        {
+            break;
+        }
+        length += read;
+    }
+
+    if ((length >= 0) && (length != file.len))
+    {
+        length = -1;
+    }
+
+    fs_close(&file);
+
+    return(length);
+}
+
+/*!
+ * \brief Format the body the graph expects
+ *
+ * \param[out] body     destination
+ * \param[in]  size     size of destination
+ *
+ * \return length of body
+ */
+static int ht_expected(char *body, int size)
+{
+    uint32_t base = ht_count ? ht_unix_time[0] : 0;
+    int length;
+    int i;
+
+    length = snprintf(body, size, "{\"base\":%lu,\"points\":[", (unsigned long)base);
+    for (i=0; i<ht_count; i++)
+    {
+        length += snprintf(body + length, size - length, "%s[%lu,%d]", i ? "," : "", (unsigned long)(ht_unix_time[i] - base), ht_temperaturex10[i]);
+    }
+    length += snprintf(body + length, size - length, "]}");
+
+    return(length);
+}
+
+/*!
+ * \brief Make up a temperature history
+ *
+ * \param[in]  history      which one
+ *
+ * \return nothing
+ */
+static void ht_fill(HT_HISTORY_T history)
+{
+    int i;
+
+    switch(history)
+    {
+        case HT_EMPTY:
+            ht_count = 0;
+            break;
+        case HT_ONE:
+            ht_count = 1;
+            break;
+        case HT_PART:
+            ht_count = SIZE_CLIMATE_HISTORY/3;
+            break;
+        case HT_FULL:
+        case HT_EXTREME:
+        default:
+            ht_count = SIZE_CLIMATE_HISTORY;
+            break;
+    }
+
+    for (i=0; i<ht_count; i++)
+    {
+        if (history == HT_EXTREME)
+        {
+            // a clock that was set late and temperatures at the limits of the type
+            ht_unix_time[i] = i ? 4000000000UL - (SIZE_CLIMATE_HISTORY - i)*7 : 0;
+            ht_temperaturex10[i] = (i & 1) ? INT16_MIN + i : INT16_MAX - i;
+        }
+        else
+        {
+            ht_unix_time[i] = 1760000000 + i*600;
+            ht_temperaturex10[i] = (i == 5) ? -15 : 200 + (i*7)%60;
+        }
+    }
+}
+
+/*!
+ * \brief Time the SSI output the history page used before /history, four points per tag with an iso timestamp each
+ *
+ * \param[out] length   bytes inserted into the page
+ *
+ * \return microseconds per render
+ */
+static double ht_time_old(int *length)
+{
+    static char page[HT_RESPONSE_MAX];
+    char iso_timestamp[32];
+    time_t unix_time;
+    double start;
+    int render;
+    int i;
+
+    start = ht_now_us();
+    for (render=0; render<HT_RENDERS; render++)
+    {
+        *length = 0;
+        for (i=0; i<ht_count; i++)
+        {
+            unix_time = ht_unix_time[i];
+            strftime(iso_timestamp, sizeof(iso_timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&unix_time));
+            *length += snprintf(page + *length, sizeof(page) - *length, "{x: '%s', y: %d.%d },\n",
+                                iso_timestamp, ht_temperaturex10[i]/10, ht_temperaturex10[i]%10);
+        }
+    }
+
+    return((ht_now_us() - start)/HT_RENDERS);
+}
+
+/*!
+ * \brief Time rendering /history in the pieces a default tcp send buffer allows
+ *
+ * \param[out] length   bytes of the response
+ *
+ * \return microseconds per render
+ */
+static double ht_time_new(int *length)
+{
+    static char response[HT_RESPONSE_MAX];
+    double start;
+    int render;
+
+    start = ht_now_us();
+    for (render=0; render<HT_RENDERS; render++)
+    {
+        *length = ht_render(response, sizeof(response), 536);
+    }
+
+    return((ht_now_us() - start)/HT_RENDERS);
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+static double ht_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
+
+/*!
+ * \brief Stand-in for thermostat_metrics.c
+ *
+ * \param[out]  unix_time        sample times
+ * \param[out]  temperaturex10   sample temperatures
+ * \param[in]   max_points       size of output arrays
+ *
+ * \return number of samples copied
+ */
+int copy_temperature_history(uint32_t *unix_time, int16_t *temperaturex10, int max_points)
+{
+    int count = ht_count < max_points ? ht_count : max_points;
+
+    memcpy(unix_time, ht_unix_time, count*sizeof(uint32_t));
+    memcpy(temperaturex10, ht_temperaturex10, count*sizeof(int16_t));
+
+    return(count);
+}
+
+// the other custom files are not under test
+void *api_wind_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_weather_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_status_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_thermostat_open(__unused const char *name, __unused int *length) { return(NULL); }
+int api_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+void api_close(__unused void *state) { }
+void *events_open(__unused const char *name, __unused int *length) { return(NULL); }
+int events_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool events_ready(__unused void *state) { return(false); }
+void events_close(__unused void *state) { }
+void *ssi_render_open(__unused const char *name, __unused int *length) { return(NULL); }
+int ssi_render_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool ssi_render_ready(__unused void *state) { return(false); }
+void ssi_render_close(__unused void *state) { }
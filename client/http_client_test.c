@@ -0,0 +1,826 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "http_client.h"
+
+/*
+ * Http client test
+ *
+ * Runs http_client.c unchanged on a linux host, over the altcp stand-in in client/shim (sockets, with OpenSSL for
+ * tls), against http servers on threads of this program that can be told to close connections after a number of
+ * responses, with or without saying so first, or to stop answering.  Every response carries the number in the url
+ * that asked for it, so a response handed to the wrong request is seen.  It checks:
+ *
+ *   - requests one after another reuse one pooled connection
+ *   - requests pipelined four deep on one connection
+ *   - a server closing after every response, and after every third with "Connection: close", without retries
+ *   - a server closing after every fifth response without warning, the unanswered requests resent once
+ *   - chunked bodies streamed to the body callback, in pbufs of 7 bytes and of 512
+ *   - bodies read until the server closes, and posts
+ *   - five servers through four pooled connections
+ *   - a server that stops answering timing out, an unused connection closed when idle, and a refused connection
+ *   - every pbuf freed at the end
+ *
+ * and reports requests per second with and without pooling and pipelining, and the most memory the client used.  The
+ * rates are the host's, with new connections waiting on the stand-in's 2 ms loop, so only compare with each other.
+ * The timeouts are reached by skipping the tick count forward (shim_ticks_skipped) rather than by waiting.
+ *
+ * With -t it then logs in to the gateway emulated by http_standin.py over tls, as powerwall.c does, and pipelines
+ * status requests with the token, logging in again when the token expires; the stand-in's connection limit shows the
+ * client resuming tls sessions.
+ * Exits with 1 if any check fails.
+ */
+
+#define CT_SERVERS              (5)             // one more than HTTP_CLIENT_CONNECTIONS
+#define CT_BUFFER_MAX           (8192)
+#define CT_CHUNKED_MAX          (20000)         // longest chunked body
+#define CT_REPORT_MAX           (10)            // failures printed
+#define CT_WAIT_MS              (5000)
+#define CT_TLS_REQUESTS         (400)
+
+typedef enum
+{
+    CT_VALUE = 0,               // {"id":n} with a Content-Length
+    CT_CHUNKED,                 // n bytes, chunked
+    CT_CLOSE,                   // {"id":n}, HTTP/1.0 and read until the server closes
+    CT_POST,                    // {"id":length of the content posted}
+    CT_NUM_URLS
+} CT_URL_T;
+
+typedef struct
+{
+    HTTP_CLIENT_REQUEST_T request;
+    JSONP_FILTER_T filter;
+    CT_URL_T url_type;
+    int n;
+    char url[64];
+    char id[16];
+    char content[64];
+    long body_length;
+    uint32_t body_sum;
+} CT_REQUEST_T;
+
+// how the servers behave, changed between runs
+typedef struct
+{
+    volatile int close_after;   // responses on a connection before the server closes it, 0 for never
+    volatile bool announce;     // the last response before closing says "Connection: close"
+    volatile bool silent;       // requests are read but never answered
+} CT_BEHAVIOUR_T;
+
+// prototypes
+static void ct_usage(const char *program);
+static int ct_start_servers(void);
+static void *ct_listen(void *arg);
+static void *ct_serve(void *arg);
+static bool ct_respond(int fd, const char *method, const char *url, int content_length, bool last);
+static int ct_send(int fd, const char *data, int length);
+static void ct_prepare(CT_REQUEST_T *ct, int port, CT_URL_T url_type, int n);
+static bool ct_check(CT_REQUEST_T *ct, int status);
+static void ct_body(void *arg, const char *data, int length);
+static char ct_body_byte(int n, int i);
+static long ct_batch(const char *name, int port, CT_URL_T url_type, int count, int depth);
+static long ct_expect(const char *what, bool good);
+static long ct_tls(const char *address, int port);
+static double ct_now_us(void);
+
+// static variables
+static CT_BEHAVIOUR_T ct_behaviour = {0, false, false};
+static int ct_ports[CT_SERVERS];
+static long ct_closed = 0;              // connections closed by the client
+static long ct_reported = 0;
+static const char *ct_url_names[CT_NUM_URLS] = {"value", "chunked", "close", "post"};
+
+int main(int argc, char *argv[])
+{
+    HTTP_CLIENT_STATS_T before;
+    HTTP_CLIENT_STATS_T after;
+    CT_REQUEST_T ct;
+    const char *address = "127.0.0.1";
+    double start;
+    long closed;
+    long failures = 0;
+    int tls_port = 0;
+    int refused_port;
+    int status;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "a:t:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'a':
+                address = optarg;
+                break;
+            case 't':
+                tls_port = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                ct_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if (ct_start_servers())
+    {
+        printf("cannot start the servers\n");
+        return(1);
+    }
+    shim_altcp_start();
+
+    printf("%-44s %8s %10s\n", "", "failures", "req/s");
+
+    // pooling and pipelining
+    http_client_get_stats(&before);
+    failures += ct_batch("keep-alive, one after another", ct_ports[0], CT_VALUE, 500, 1);
+    http_client_get_stats(&after);
+    failures += ct_expect("one connection for all of them", (after.connections - before.connections == 1) &&
+                          (after.reused - before.reused == 499));
+
+    before = after;
+    failures += ct_batch("keep-alive, pipelined 4 deep", ct_ports[0], CT_VALUE, 2000, 4);
+    http_client_get_stats(&after);
+    failures += ct_expect("pipelined on the same connection", (after.connections == before.connections) &&
+                          (after.pipelined - before.pipelined >= 1000));
+
+    // servers closing connections
+    ct_behaviour.close_after = 1;
+    ct_behaviour.announce = true;
+    before = after;
+    failures += ct_batch("connection per request", ct_ports[0], CT_VALUE, 300, 1);
+    http_client_get_stats(&after);
+    // the first goes on the connection left open by the runs before
+    failures += ct_expect("a connection for each", after.connections - before.connections == 299);
+
+    ct_behaviour.close_after = 3;
+    before = after;
+    failures += ct_batch("Connection: close after 3, pipelined", ct_ports[0], CT_VALUE, 600, 4);
+    http_client_get_stats(&after);
+    failures += ct_expect("requests behind the close moved, not retried", (after.retried == before.retried) &&
+                          (after.connections - before.connections >= 200));
+
+    ct_behaviour.close_after = 5;
+    ct_behaviour.announce = false;
+    before = after;
+    failures += ct_batch("silent close after 5, pipelined", ct_ports[0], CT_VALUE, 600, 4);
+    http_client_get_stats(&after);
+    failures += ct_expect("unanswered requests resent", after.retried > before.retried);
+
+    // bodies
+    ct_behaviour.close_after = 0;
+    shim_pbuf_size = 7;
+    failures += ct_batch("chunked, 7 byte pbufs", ct_ports[0], CT_CHUNKED, 100, 4);
+    shim_pbuf_size = 512;
+    failures += ct_batch("chunked, 512 byte pbufs", ct_ports[0], CT_CHUNKED, 400, 4);
+    failures += ct_batch("read until close", ct_ports[0], CT_CLOSE, 100, 1);
+    failures += ct_batch("post, pipelined", ct_ports[0], CT_POST, 400, 4);
+
+    // more servers than pooled connections
+    before = after;
+    for (i=0; i<CT_SERVERS*40; i++)
+    {
+        failures += ct_batch(NULL, ct_ports[i%CT_SERVERS], CT_VALUE, 1, 1);
+    }
+    http_client_get_stats(&after);
+    failures += ct_expect("5 servers through the pool", (after.connections_max <= HTTP_CLIENT_CONNECTIONS) &&
+                          (shim_sockets_max <= HTTP_CLIENT_CONNECTIONS));
+
+    // a server that stops answering times out, then the client recovers
+    ct_behaviour.silent = true;
+    ct_prepare(&ct, ct_ports[1], CT_VALUE, 1);
+    http_client_get_stats(&before);
+    status = http_client_submit(&ct.request);
+    sleep_ms(100);
+    shim_ticks_skipped += HTTP_CLIENT_TIMEOUT_MS + 1000;
+    start = ct_now_us();
+    status = (status < 0) ? status : http_client_wait(&ct.request, 3000);
+    http_client_get_stats(&after);
+    failures += ct_expect("silent server timed out by the poll callback", (status == -1) &&
+                          (ct_now_us() - start < 2e6) && (after.failed == before.failed + 1));
+    ct_behaviour.silent = false;
+    failures += ct_batch("after the timeout", ct_ports[1], CT_VALUE, 10, 1);
+
+    // an unused connection is closed once idle
+    failures += ct_batch(NULL, ct_ports[2], CT_VALUE, 1, 1);
+    closed = __atomic_load_n(&ct_closed, __ATOMIC_SEQ_CST);
+    shim_ticks_skipped += HTTP_CLIENT_IDLE_TIMEOUT_MS + 1000;
+    sleep_ms(HTTP_CLIENT_POLL_INTERVAL*500 + 500);
+    failures += ct_expect("idle connections closed", __atomic_load_n(&ct_closed, __ATOMIC_SEQ_CST) > closed);
+    http_client_get_stats(&before);
+    failures += ct_batch(NULL, ct_ports[2], CT_VALUE, 1, 1);
+    http_client_get_stats(&after);
+    failures += ct_expect("then reopened", after.connections == before.connections + 1);
+
+    // nothing listening
+    refused_port = ct_ports[CT_SERVERS - 1] + 1000;
+    ct_prepare(&ct, refused_port, CT_VALUE, 1);
+    start = ct_now_us();
+    status = http_client_fetch(&ct.request);
+    failures += ct_expect("refused connection fails at once", (status == -1) && (ct_now_us() - start < 1e6));
+
+    if (tls_port)
+    {
+        failures += ct_tls(address, tls_port);
+    }
+
+    // leaks show once the stand-in has freed everything closed
+    sleep_ms(50);
+    http_client_get_stats(&after);
+    failures += ct_expect("every pbuf freed", !__atomic_load_n(&shim_pbuf_bytes, __ATOMIC_SEQ_CST));
+    printf("memory: request buffer %d bytes, longest request %u bytes, %u connections open at most, "
+           "%ld bytes in pbufs at most\n", HTTP_CLIENT_REQUEST_MAX, after.request_max, after.connections_max, shim_pbuf_bytes_max);
+    printf("%u connections, %u requests, %u reused, %u pipelined, %u retried, %u failed, %u handshakes, %u resumed\n",
+           after.connections, after.requests, after.reused, after.pipelined, after.retried, after.failed,
+           after.handshakes, after.resumed);
+
+    shim_altcp_stop();
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return(failures ? 1 : 0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void ct_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-t port [-a address]]\n"
+            "  -t port      also run against the gateway emulated by http_standin.py on this https port\n"
+            "  -a address   address of http_standin.py (default 127.0.0.1)\n",
+            program);
+}
+
+/*!
+ * \brief Start the servers on ports the system chooses
+ *
+ * \return 0 on success, -1 on error
+ */
+static int ct_start_servers(void)
+{
+    struct sockaddr_in server;
+    socklen_t length;
+    pthread_t thread;
+    intptr_t fd;
+    int i;
+
+    for (i=0; i<CT_SERVERS; i++)
+    {
+        memset(&server, 0, sizeof(server));
+        server.sin_family = AF_INET;
+        server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        length = sizeof(server);
+
+        if (((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || bind(fd, (struct sockaddr *)&server, sizeof(server)) ||
+            listen(fd, 64) || getsockname(fd, (struct sockaddr *)&server, &length))
+        {
+            return(-1);
+        }
+        ct_ports[i] = ntohs(server.sin_port);
+
+        if (pthread_create(&thread, NULL, ct_listen, (void *)fd))
+        {
+            return(-1);
+        }
+        pthread_detach(thread);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Accept connections, each served by its own thread
+ *
+ * \param[in]  arg  listening socket
+ *
+ * \return never
+ */
+static void *ct_listen(void *arg)
+{
+    pthread_t thread;
+    intptr_t fd;
+    int nodelay = 1;
+
+    while (true)
+    {
+        if ((fd = accept((intptr_t)arg, NULL, NULL)) < 0)
+        {
+            continue;
+        }
+
+        // pipelined responses would otherwise wait on the client's delayed acks
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        if (pthread_create(&thread, NULL, ct_serve, (void *)fd))
+        {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Read requests from a connection and answer them in order, as ct_behaviour says
+ *
+ * \param[in]  arg  connected socket
+ *
+ * \return NULL
+ */
+static void *ct_serve(void *arg)
+{
+    char buffer[CT_BUFFER_MAX + 1];
+    char method[16];
+    char url[256];
+    char *end;
+    char *header;
+    intptr_t fd = (intptr_t)arg;
+    int content_length;
+    int pending = 0;
+    int served = 0;
+    int length;
+    int used;
+    bool last;
+
+    while (true)
+    {
+        buffer[pending] = 0;
+        if (!(end = strstr(buffer, "\r\n\r\n")))
+        {
+            if ((pending >= CT_BUFFER_MAX) || ((length = recv(fd, buffer + pending, CT_BUFFER_MAX - pending, 0)) <= 0))
+            {
+                // the client closed, or sent more than a request
+                __atomic_add_fetch(&ct_closed, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            pending += length;
+            continue;
+        }
+
+        content_length = 0;
+        if ((header = strstr(buffer, "\r\nContent-Length:")) && (header < end))
+        {
+            content_length = atoi(header + 17);
+        }
+        used = end + 4 - buffer + content_length;
+        if (used > pending)
+        {
+            if ((used > CT_BUFFER_MAX) || ((length = recv(fd, buffer + pending, CT_BUFFER_MAX - pending, 0)) <= 0))
+            {
+                __atomic_add_fetch(&ct_closed, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            pending += length;
+            continue;
+        }
+
+        if (sscanf(buffer, "%15s %255s", method, url) != 2)
+        {
+            break;
+        }
+        memmove(buffer, buffer + used, pending - used);
+        pending -= used;
+
+        if (ct_behaviour.silent)
+        {
+            continue;
+        }
+
+        served++;
+        last = ct_behaviour.close_after && (served >= ct_behaviour.close_after);
+        if (!ct_respond(fd, method, url, content_length, last && ct_behaviour.announce) || last)
+        {
+            break;
+        }
+    }
+
+    close(fd);
+
+    return(NULL);
+}
+
+/*!
+ * \brief Answer a request
+ *
+ * \param[in]  fd               socket
+ * \param[in]  method           GET or POST
+ * \param[in]  url              /value/n, /chunked/n, /close/n or /post
+ * \param[in]  content_length   length of the content posted
+ * \param[in]  last             say the connection closes after this response
+ *
+ * \return true to carry on, false if the connection closes
+ */
+static bool ct_respond(int fd, const char *method, const char *url, int content_length, bool last)
+{
+    static const char *json_header = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n";
+    char response[CT_BUFFER_MAX];
+    char body[64];
+    int length;
+    int chunk;
+    int n;
+    int i;
+    int j;
+
+    if (sscanf(url, "/value/%d", &n) == 1)
+    {
+        snprintf(body, sizeof(body), "{\"id\":%d,\"output\":true}", n);
+        length = snprintf(response, sizeof(response), "%sContent-Length: %d\r\n%s\r\n%s", json_header, (int)strlen(body),
+                          last ? "Connection: close\r\n" : "", body);
+        return(!ct_send(fd, response, length));
+    }
+
+    if (sscanf(url, "/chunked/%d", &n) == 1)
+    {
+        length = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n%s\r\n",
+                          last ? "Connection: close\r\n" : "");
+        if (ct_send(fd, response, length))
+        {
+            return(false);
+        }
+
+        // chunks of assorted sizes, some with extensions, and a trailer on odd lengths
+        for (i=0; i<n; i+=chunk)
+        {
+            chunk = 1 + (i*13 + n) % 700;
+            chunk = (chunk > n - i) ? n - i : chunk;
+            length = snprintf(response, sizeof(response), "%x%s\r\n", chunk, (i % 3) ? "" : ";ext=1");
+            for (j=0; j<chunk; j++)
+            {
+                response[length++] = ct_body_byte(n, i + j);
+            }
+            response[length++] = '\r';
+            response[length++] = '\n';
+            if (ct_send(fd, response, length))
+            {
+                return(false);
+            }
+        }
+        length = snprintf(response, sizeof(response), "0\r\n%s\r\n", (n & 1) ? "X-Trailer: 1\r\n" : "");
+        return(!ct_send(fd, response, length));
+    }
+
+    if (sscanf(url, "/close/%d", &n) == 1)
+    {
+        length = snprintf(response, sizeof(response), "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n{\"id\":%d}", n);
+        ct_send(fd, response, length);
+        return(false);
+    }
+
+    if (!strcmp(method, "POST") && !strcmp(url, "/post"))
+    {
+        snprintf(body, sizeof(body), "{\"id\":%d}", content_length);
+        length = snprintf(response, sizeof(response), "%sContent-Length: %d\r\n%s\r\n%s", json_header, (int)strlen(body),
+                          last ? "Connection: close\r\n" : "", body);
+        return(!ct_send(fd, response, length));
+    }
+
+    length = snprintf(response, sizeof(response), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+
+    return(!ct_send(fd, response, length));
+}
+
+/*!
+ * \brief Send all of a buffer
+ *
+ * \param[in]  fd       socket
+ * \param[in]  data     data
+ * \param[in]  length   bytes
+ *
+ * \return 0 on success, -1 if the connection failed
+ */
+static int ct_send(int fd, const char *data, int length)
+{
+    int sent;
+
+    while (length > 0)
+    {
+        if ((sent = send(fd, data, length, MSG_NOSIGNAL)) <= 0)
+        {
+            return(-1);
+        }
+        data += sent;
+        length -= sent;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Fill in a request to one of the servers
+ *
+ * \param[out]  ct          request
+ * \param[in]   port        server port
+ * \param[in]   url_type    what to ask for
+ * \param[in]   n           number in the url, or length of the chunked body
+ *
+ * \return nothing
+ */
+static void ct_prepare(CT_REQUEST_T *ct, int port, CT_URL_T url_type, int n)
+{
+    memset(ct, 0, sizeof(*ct));
+    ct->url_type = url_type;
+    ct->n = n;
+    ct->filter = (JSONP_FILTER_T){"root.\"id\"", ct->id, sizeof(ct->id), false, false, 0};
+
+    if (url_type == CT_POST)
+    {
+        snprintf(ct->url, sizeof(ct->url), "/post");
+        snprintf(ct->content, sizeof(ct->content), "{\"id\":%d,\"on\":%s}", n, (n & 1) ? "true" : "false");
+        ct->n = strlen(ct->content);
+        ct->request.type = HTTP_POST;
+        ct->request.content = ct->content;
+    }
+    else
+    {
+        snprintf(ct->url, sizeof(ct->url), "/%s/%d", ct_url_names[url_type], n);
+        ct->request.type = HTTP_GET;
+    }
+
+    ct->request.address = "127.0.0.1";
+    ct->request.port = port;
+    ct->request.url = ct->url;
+    ct->request.filters = &ct->filter;
+    ct->request.num_filters = 1;
+    ct->request.body = ct_body;
+    ct->request.callback_arg = ct;
+}
+
+/*!
+ * \brief Check a response is the one asked for
+ *
+ * \param[in]  ct       request
+ * \param[in]  status   http status
+ *
+ * \return true if it is
+ */
+static bool ct_check(CT_REQUEST_T *ct, int status)
+{
+    uint32_t sum = 0;
+    int i;
+
+    if (status != 200)
+    {
+        return(false);
+    }
+
+    if (ct->url_type == CT_CHUNKED)
+    {
+        for (i=0; i<ct->n; i++)
+        {
+            sum = sum*31 + (uint8_t)ct_body_byte(ct->n, i);
+        }
+        return((ct->body_length == ct->n) && (ct->body_sum == sum));
+    }
+
+    return(ct->filter.found && (atoi(ct->id) == ct->n));
+}
+
+/*!
+ * \brief Body callback, keep the length and a checksum
+ *
+ * \param[in]  arg      CT_REQUEST_T
+ * \param[in]  data     next part of the body
+ * \param[in]  length   its length
+ *
+ * \return nothing
+ */
+static void ct_body(void *arg, const char *data, int length)
+{
+    CT_REQUEST_T *ct = (CT_REQUEST_T *)arg;
+    int i;
+
+    for (i=0; i<length; i++)
+    {
+        ct->body_sum = ct->body_sum*31 + (uint8_t)data[i];
+    }
+    ct->body_length += length;
+}
+
+/*!
+ * \brief Byte of a chunked body
+ *
+ * \param[in]  n    body length
+ * \param[in]  i    offset
+ *
+ * \return byte
+ */
+static char ct_body_byte(int n, int i)
+{
+    return('a' + (i*7 + n) % 26);
+}
+
+/*!
+ * \brief Send a run of requests, depth at a time, and check the responses
+ *
+ * \param[in]  name         printed with the result and the rate, NULL to print only failures
+ * \param[in]  port         server port
+ * \param[in]  url_type     what to ask for
+ * \param[in]  count        requests
+ * \param[in]  depth        requests submitted before waiting for the first
+ *
+ * \return number of failures
+ */
+static long ct_batch(const char *name, int port, CT_URL_T url_type, int count, int depth)
+{
+    static CT_REQUEST_T requests[HTTP_CLIENT_PIPELINE_DEPTH];
+    double start = ct_now_us();
+    long failures = 0;
+    int status[HTTP_CLIENT_PIPELINE_DEPTH];
+    int done;
+    int i;
+    int j;
+
+    for (done=0; done<count; done+=depth)
+    {
+        for (j=0; (j<depth) && (done + j<count); j++)
+        {
+            i = done + j;
+            ct_prepare(&requests[j], port, url_type, (url_type == CT_CHUNKED) ? (i*997) % CT_CHUNKED_MAX : i);
+            status[j] = http_client_submit(&requests[j].request);
+        }
+        for (j=0; (j<depth) && (done + j<count); j++)
+        {
+            if (status[j] >= 0)
+            {
+                status[j] = http_client_wait(&requests[j].request, CT_WAIT_MS);
+            }
+            if (!ct_check(&requests[j], status[j]))
+            {
+                if (ct_reported++ < CT_REPORT_MAX)
+                {
+                    printf("%s %s: status %d, id '%s', body %ld bytes\n", name ? name : "", requests[j].url, status[j],
+                           requests[j].id, requests[j].body_length);
+                }
+                failures++;
+            }
+        }
+    }
+
+    if (name)
+    {
+        printf("%-44s %8ld %10.0f\n", name, failures, count/((ct_now_us() - start)/1e6));
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Report a check
+ *
+ * \param[in]  what     what was checked
+ * \param[in]  good     whether it passed
+ *
+ * \return number of failures
+ */
+static long ct_expect(const char *what, bool good)
+{
+    printf("  %-42s %s\n", what, good ? "ok" : "FAILED");
+
+    return(good ? 0 : 1);
+}
+
+/*!
+ * \brief Log in to the emulated gateway over tls and pipeline status requests, as powerwall.c does
+ *
+ * \param[in]  address  http_standin.py address
+ * \param[in]  port     its https port
+ *
+ * \return number of failures
+ */
+static long ct_tls(const char *address, int port)
+{
+    static HTTP_CLIENT_REQUEST_T requests[HTTP_CLIENT_PIPELINE_DEPTH];
+    static char percentages[HTTP_CLIENT_PIPELINE_DEPTH][32];
+    static JSONP_FILTER_T filters[HTTP_CLIENT_PIPELINE_DEPTH];
+    HTTP_CLIENT_STATS_T before;
+    HTTP_CLIENT_STATS_T after;
+    HTTP_CLIENT_REQUEST_T login;
+    JSONP_FILTER_T token_filter;
+    char cookies[1024];
+    char token[256];
+    char headers[sizeof(cookies) + sizeof(token) + 40];
+    double start;
+    long failures = 0;
+    int logins = 0;
+    int status;
+    int done;
+    int j;
+
+    http_client_get_stats(&before);
+    start = ct_now_us();
+
+    for (done=0; (done<CT_TLS_REQUESTS) && (logins<CT_TLS_REQUESTS); )
+    {
+        if (!logins || !token[0])
+        {
+            token[0] = cookies[0] = 0;
+            token_filter = (JSONP_FILTER_T){"root.\"token\"", token, sizeof(token), true, false, 0};
+            memset(&login, 0, sizeof(login));
+            login.type = HTTP_POST;
+            login.address = address;
+            login.port = port;
+            login.tls = true;
+            login.host = "powerwall";
+            login.url = "/api/login/Basic";
+            login.content = "{\"username\":\"customer\",\"password\":\"ABCDE\"}";
+            login.filters = &token_filter;
+            login.num_filters = 1;
+            login.cookies = cookies;
+            login.cookies_size = sizeof(cookies);
+            logins++;
+            if ((http_client_fetch(&login) != 200) || !token_filter.found || !strstr(cookies, "AuthCookie="))
+            {
+                printf("login to %s:%d failed\n", address, port);
+                return(failures + 1);
+            }
+            snprintf(headers, sizeof(headers), "Cookie: %s\r\nAuthorization: Bearer %s\r\n", cookies, token);
+        }
+
+        for (j=0; j<HTTP_CLIENT_PIPELINE_DEPTH; j++)
+        {
+            memset(&requests[j], 0, sizeof(requests[j]));
+            percentages[j][0] = 0;
+            filters[j] = (JSONP_FILTER_T){"root.\"percentage\"", percentages[j], sizeof(percentages[j]), false, false, 0};
+            requests[j].type = HTTP_GET;
+            requests[j].address = address;
+            requests[j].port = port;
+            requests[j].tls = true;
+            requests[j].host = "powerwall";
+            requests[j].url = "/api/system_status/soe";
+            requests[j].headers = headers;
+            requests[j].filters = &filters[j];
+            requests[j].num_filters = 1;
+            http_client_submit(&requests[j]);
+        }
+        for (j=0; j<HTTP_CLIENT_PIPELINE_DEPTH; j++)
+        {
+            status = http_client_wait(&requests[j], CT_WAIT_MS);
+            if (status == 401)
+            {
+                // token used up, log in again and carry on
+                token[0] = 0;
+            }
+            else if ((status == 200) && !strcmp(percentages[j], "84.03846153846153"))
+            {
+                done++;
+            }
+            else if (failures++ < CT_REPORT_MAX)
+            {
+                printf("https %s: status %d percentage '%s'\n", requests[j].url, status, percentages[j]);
+            }
+        }
+    }
+
+    http_client_get_stats(&after);
+    printf("%-44s %8ld %10.0f\n", "https to the stand-in, pipelined 4 deep", failures, done/((ct_now_us() - start)/1e6));
+    printf("  %u connections, %u full handshakes, %u resumed, %d logins, %u retried\n", after.connections - before.connections,
+           after.handshakes - before.handshakes, after.resumed - before.resumed, logins, after.retried - before.retried);
+    failures += ct_expect("every status read", done >= CT_TLS_REQUESTS);
+    failures += ct_expect("reconnections resumed the tls session", (after.resumed > before.resumed) &&
+                          (after.handshakes - before.handshakes < after.resumed - before.resumed));
+
+    return(failures);
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double ct_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
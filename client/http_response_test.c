@@ -0,0 +1,670 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#ifdef HR_TLS
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#endif
+
+#include "http_response.h"
+
+/*
+ * Http response parser test
+ *
+ * Runs http_response.c and json_parser.c on a linux host against the recorded responses in http_responses.txt and
+ * checks the status, the Set-Cookie values, the json value looked for and where the response ends when each response
+ * is parsed:
+ *
+ *   - whole
+ *   - split in two at every offset
+ *   - split in three at every pair of offsets (every seventh first offset for long responses)
+ *   - one after another in the same stream, in random pieces, as pipelined responses arrive
+ *
+ * Each piece is copied to its own allocation, as a pbuf payload would be, so that the address sanitizer sees any read
+ * past it (build with CFLAGS="-O1 -g -fsanitize=address,undefined").
+ *
+ * Built with HR_TLS (make http_response_tls, which needs openssl) it also fetches each response over TLS from
+ * http_standin.py, which sends it in records of random sizes, and parses it as it is read in random sized pieces.
+ * Exits with 1 if any check fails.
+ */
+
+#define HR_LINE_MAX             (8192)
+#define HR_RESPONSES_MAX        (32)
+#define HR_RESPONSE_MAX         (8192)
+#define HR_TEXT_MAX             (256)
+#define HR_PAIRS_MAX            (600)           // longer responses are split in three at every seventh first offset
+#define HR_PIPELINE_RUNS        (2000)
+#define HR_PIECE_MAX            (100)
+#define HR_REPORT_MAX           (10)            // failures printed
+#define HR_TLS_FETCHES          (40)            // times each response is fetched over TLS
+#define HR_TLS_READ_MAX         (97)
+
+typedef struct
+{
+    char name[HR_TEXT_MAX];
+    int status;
+    char path[HR_TEXT_MAX];
+    char value[HR_TEXT_MAX];            // empty if the body has no value at path
+    char cookies[HR_TEXT_MAX];
+    bool close;                         // the body ends when the connection closes
+    bool error;                         // malformed
+    char text[HR_RESPONSE_MAX];
+    int length;
+} HR_RESPONSE_T;
+
+typedef struct
+{
+    HTTP_RESPONSE_T response;
+    JSON_PARSER_CONTEXT_T json;
+    JSONP_FILTER_T filter;
+    char value[HR_TEXT_MAX];
+    char cookies[HR_TEXT_MAX];
+} HR_PARSER_T;
+
+// prototypes
+static void hr_usage(const char *program);
+static int hr_load(const char *name);
+static int hr_unescape(const char *text, char *out, int size);
+static long hr_check_splits(HR_RESPONSE_T *response);
+static bool hr_split(HR_RESPONSE_T *response, const int *cuts, int num_cuts);
+static long hr_check_pipeline(int runs);
+static void hr_begin(HR_PARSER_T *parser, HR_RESPONSE_T *response);
+static int hr_feed(HR_PARSER_T *parser, const char *data, int length);
+static bool hr_result(HR_PARSER_T *parser, HR_RESPONSE_T *response, const char *how);
+#ifdef HR_TLS
+static long hr_check_tls(const char *address, int port);
+static int hr_tls_connect(SSL_CTX *context, const char *address, int port, SSL **ssl);
+#endif
+static uint32_t hr_random(void);
+
+// static variables
+static HR_RESPONSE_T hr_responses[HR_RESPONSES_MAX];
+static int hr_num_responses = 0;
+static uint32_t hr_seed = 1;
+static int hr_reported = 0;
+
+int main(int argc, char *argv[])
+{
+    const char *responses_name = "http_responses.txt";
+    const char *address = "127.0.0.1";
+    int port = 0;
+    long failures = 0;
+    long count;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "f:s:a:t:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'f':
+                responses_name = optarg;
+                break;
+            case 'a':
+                address = optarg;
+                break;
+            case 't':
+                port = atoi(optarg);
+                break;
+            case 's':
+                hr_seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'h':
+            default:
+                hr_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (!hr_seed || hr_load(responses_name))
+    {
+        hr_usage(argv[0]);
+        return(1);
+    }
+
+    for (i=0; i<hr_num_responses; i++)
+    {
+        count = hr_check_splits(&hr_responses[i]);
+        printf("%-18s %5d bytes, whole and split at every offset: %ld failures\n", hr_responses[i].name, hr_responses[i].length, count);
+        failures += count;
+    }
+
+    count = hr_check_pipeline(HR_PIPELINE_RUNS);
+    printf("%d pipelined streams in random pieces: %ld failures\n", HR_PIPELINE_RUNS, count);
+    failures += count;
+
+    if (port)
+    {
+#ifdef HR_TLS
+        count = hr_check_tls(address, port);
+        printf("%d fetches of each response over TLS: %ld failures\n", HR_TLS_FETCHES, count);
+        failures += count;
+#else
+        printf("-t %s:%d needs a build with HR_TLS (make http_response_tls)\n", address, port);
+        failures++;
+#endif
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return(failures ? 1 : 0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void hr_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-f responses] [-s seed] [-t port [-a address]]\n"
+            "  -f file      recorded responses (default http_responses.txt)\n"
+            "  -s seed      random seed, not 0 (default 1)\n"
+            "  -t port      also fetch each response over TLS from http_standin.py on this port\n"
+            "  -a address   address of http_standin.py (default 127.0.0.1)\n",
+            program);
+}
+
+/*!
+ * \brief Read the recorded responses
+ *
+ * \param[in]  name     file name
+ *
+ * \return 0 on success, -1 on error
+ */
+static int hr_load(const char *name)
+{
+    char line[HR_LINE_MAX];
+    HR_RESPONSE_T *response = NULL;
+    FILE *file;
+    int number = 0;
+    int length;
+    bool ok = true;
+
+    if (!(file = fopen(name, "r")))
+    {
+        fprintf(stderr, "cannot open %s\n", name);
+        return(-1);
+    }
+
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        number++;
+        length = strlen(line);
+        while (length && ((line[length-1] == '\n') || (line[length-1] == '\r')))
+        {
+            line[--length] = 0;
+        }
+
+        if ((line[0] == '#') || !length)
+        {
+            continue;
+        }
+
+        if (!strncmp(line, "response ", 9) && (hr_num_responses < HR_RESPONSES_MAX))
+        {
+            response = &hr_responses[hr_num_responses++];
+            ok = (sscanf(line + 9, "%255s %d %255s", response->name, &response->status, response->path) == 3);
+        }
+        else if (!response)
+        {
+            ok = false;
+        }
+        else if (!strncmp(line, "value ", 6))
+        {
+            snprintf(response->value, sizeof(response->value), "%.255s", line + 6);
+        }
+        else if (!strncmp(line, "cookies ", 8))
+        {
+            snprintf(response->cookies, sizeof(response->cookies), "%.255s", line + 8);
+        }
+        else if (!strcmp(line, "close"))
+        {
+            response->close = true;
+        }
+        else if (!strcmp(line, "error"))
+        {
+            response->error = true;
+        }
+        else if (!strncmp(line, "text ", 5))
+        {
+            length = hr_unescape(line + 5, response->text + response->length, sizeof(response->text) - response->length);
+            ok = (length >= 0);
+            response->length += length;
+        }
+        else if (!strncmp(line, "body ", 5) && (response->length + length - 5 < (int)sizeof(response->text)))
+        {
+            memcpy(response->text + response->length, line + 5, length - 5);
+            response->length += length - 5;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    fclose(file);
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%d: not understood\n", name, number);
+        return(-1);
+    }
+
+    if (!hr_num_responses)
+    {
+        fprintf(stderr, "no responses in %s\n", name);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Turn \r, \n and \\ escapes into the characters
+ *
+ * \param[in]   text    escaped text
+ * \param[out]  out     characters, not nul terminated
+ * \param[in]   size    size of out
+ *
+ * \return number of characters, -1 if they do not fit or an escape is unknown
+ */
+static int hr_unescape(const char *text, char *out, int size)
+{
+    int length = 0;
+
+    for (; *text && (length < size); text++)
+    {
+        if (*text != '\\')
+        {
+            out[length++] = *text;
+            continue;
+        }
+
+        switch(*++text)
+        {
+            case 'r':
+                out[length++] = '\r';
+                break;
+            case 'n':
+                out[length++] = '\n';
+                break;
+            case '\\':
+                out[length++] = '\\';
+                break;
+            default:
+                return(-1);
+        }
+    }
+
+    return(*text ? -1 : length);
+}
+
+/*!
+ * \brief Parse a response whole, split in two at every offset and in three at every pair of offsets
+ *
+ * \param[in]  response     recorded response
+ *
+ * \return number of failures
+ */
+static long hr_check_splits(HR_RESPONSE_T *response)
+{
+    long failures = 0;
+    int cuts[2];
+    int step;
+
+    failures += !hr_split(response, cuts, 0);
+
+    for (cuts[0]=1; cuts[0]<response->length; cuts[0]++)
+    {
+        failures += !hr_split(response, cuts, 1);
+    }
+
+    step = (response->length > HR_PAIRS_MAX) ? 7 : 1;
+    for (cuts[0]=1; cuts[0]<response->length; cuts[0]+=step)
+    {
+        for (cuts[1]=cuts[0]+1; cuts[1]<response->length; cuts[1]++)
+        {
+            failures += !hr_split(response, cuts, 2);
+        }
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Parse a response in pieces and check the result
+ *
+ * \param[in]  response     recorded response
+ * \param[in]  cuts         offsets the pieces start at, in order
+ * \param[in]  num_cuts     number of cuts
+ *
+ * \return true if the result is as recorded
+ */
+static bool hr_split(HR_RESPONSE_T *response, const int *cuts, int num_cuts)
+{
+    HR_PARSER_T parser;
+    char how[64];
+    int offset = 0;
+    int used = 0;
+    int end;
+    int i;
+
+    hr_begin(&parser, response);
+
+    for (i=0; (i<=num_cuts) && (used >= 0); i++)
+    {
+        end = (i < num_cuts) ? cuts[i] : response->length;
+        used = hr_feed(&parser, response->text + offset, end - offset);
+        offset = end;
+    }
+
+    if (!http_response_finished(&parser.response))
+    {
+        // the server closes the connection
+        http_response_close(&parser.response);
+    }
+
+    snprintf(how, sizeof(how), "cut at %d %d", (num_cuts > 0) ? cuts[0] : -1, (num_cuts > 1) ? cuts[1] : -1);
+
+    return(hr_result(&parser, response, how));
+}
+
+/*!
+ * \brief Parse the responses one after another in one stream, as pipelined responses arrive
+ *
+ * \param[in]  runs     number of streams, each in different random pieces
+ *
+ * \return number of failures
+ */
+static long hr_check_pipeline(int runs)
+{
+    static char stream[HR_RESPONSES_MAX*HR_RESPONSE_MAX];
+    HR_RESPONSE_T *order[HR_RESPONSES_MAX];
+    HR_PARSER_T parser;
+    long failures = 0;
+    int num_responses = 0;
+    int length = 0;
+    int offset;
+    int piece;
+    int used;
+    int next;
+    int i;
+
+    // responses that end with the connection or are malformed can only be last, so are left out
+    for (i=0; i<hr_num_responses; i++)
+    {
+        if (!hr_responses[i].close && !hr_responses[i].error)
+        {
+            order[num_responses++] = &hr_responses[i];
+            memcpy(stream + length, hr_responses[i].text, hr_responses[i].length);
+            length += hr_responses[i].length;
+        }
+    }
+
+    while (runs--)
+    {
+        next = 0;
+        hr_begin(&parser, order[next]);
+
+        for (offset=0; offset<length; offset+=piece)
+        {
+            piece = 1 + hr_random()%HR_PIECE_MAX;
+            if (piece > length - offset)
+            {
+                piece = length - offset;
+            }
+
+            // a piece can hold the end of one response and the start of the next
+            while (piece > 0)
+            {
+                used = hr_feed(&parser, stream + offset, piece);
+                if (used < 0)
+                {
+                    break;
+                }
+                if (http_response_finished(&parser.response))
+                {
+                    failures += !hr_result(&parser, order[next], "pipelined");
+                    if (++next < num_responses)
+                    {
+                        hr_begin(&parser, order[next]);
+                    }
+                }
+                offset += used;
+                piece -= used;
+            }
+
+            if ((used < 0) || (next >= num_responses))
+            {
+                break;
+            }
+        }
+
+        if (next != num_responses)
+        {
+            printf("pipelined: %d of %d responses parsed\n", next, num_responses);
+            failures++;
+        }
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Start parsing a response, looking for its json value
+ *
+ * \param[out]  parser      parser state
+ * \param[in]   response    recorded response
+ *
+ * \return nothing
+ */
+static void hr_begin(HR_PARSER_T *parser, HR_RESPONSE_T *response)
+{
+    parser->filter = (JSONP_FILTER_T){response->path, parser->value, sizeof(parser->value), false, false, 0};
+    jsonp_begin(&parser->json, &parser->filter, 1, NULL, NULL);
+    http_response_begin(&parser->response, &parser->json, parser->cookies, sizeof(parser->cookies));
+}
+
+/*!
+ * \brief Parse bytes from a copy of their own, as a pbuf payload
+ *
+ * \param[in]  parser   parser state
+ * \param[in]  data     bytes
+ * \param[in]  length   number of bytes
+ *
+ * \return bytes used, -1 if the response is malformed
+ */
+static int hr_feed(HR_PARSER_T *parser, const char *data, int length)
+{
+    char *payload;
+    int used;
+
+    if (!(payload = malloc(length ? length : 1)))
+    {
+        return(-1);
+    }
+    memcpy(payload, data, length);
+    used = http_response_parse(&parser->response, payload, length);
+    free(payload);
+
+    return(used);
+}
+
+/*!
+ * \brief Compare what was parsed with the recording
+ *
+ * \param[in]  parser       parser state, finished
+ * \param[in]  response     recorded response
+ * \param[in]  how          how it was fed, for the report
+ *
+ * \return true if they match
+ */
+static bool hr_result(HR_PARSER_T *parser, HR_RESPONSE_T *response, const char *how)
+{
+    bool ok;
+
+    if (response->error)
+    {
+        ok = (parser->response.state == HTTP_RESPONSE_ERROR);
+    }
+    else
+    {
+        ok = (parser->response.state == HTTP_RESPONSE_DONE) && (parser->response.status == response->status) &&
+             !strcmp(parser->cookies, response->cookies) && (parser->response.close == response->close) &&
+             (response->value[0] ? (parser->filter.found && !strcmp(parser->value, response->value)) : !parser->filter.found);
+    }
+
+    if (!ok && (hr_reported++ < HR_REPORT_MAX))
+    {
+        printf("%s %s: state %d status %d close %d cookies [%s] value [%s]\n", response->name, how, parser->response.state,
+               parser->response.status, parser->response.close, parser->cookies, parser->filter.found ? parser->value : "-");
+    }
+
+    return(ok);
+}
+
+#ifdef HR_TLS
+/*!
+ * \brief Fetch each response from http_standin.py over TLS and parse it as it is read
+ *
+ * \param[in]  address  stand-in address
+ * \param[in]  port     stand-in port
+ *
+ * \return number of failures
+ */
+static long hr_check_tls(const char *address, int port)
+{
+    char request[HR_TEXT_MAX + 32];
+    char data[HR_TLS_READ_MAX];
+    HR_RESPONSE_T *response;
+    HR_PARSER_T parser;
+    SSL_CTX *context;
+    SSL *ssl;
+    long failures = 0;
+    int socket;
+    int length;
+    int i;
+    int j;
+
+    if (!(context = SSL_CTX_new(TLS_client_method())))
+    {
+        return(1);
+    }
+
+    for (i=0; i<hr_num_responses; i++)
+    {
+        response = &hr_responses[i];
+        for (j=0; j<HR_TLS_FETCHES; j++)
+        {
+            if ((socket = hr_tls_connect(context, address, port, &ssl)) < 0)
+            {
+                printf("cannot reach the stand-in at %s:%d\n", address, port);
+                SSL_CTX_free(context);
+                return(failures + 1);
+            }
+
+            snprintf(request, sizeof(request), "GET /%s HTTP/1.1\r\nHost: %s\r\n\r\n", response->name, address);
+            SSL_write(ssl, request, strlen(request));
+
+            hr_begin(&parser, response);
+            while (!http_response_finished(&parser.response))
+            {
+                length = SSL_read(ssl, data, 1 + hr_random()%HR_TLS_READ_MAX);
+                if (length <= 0)
+                {
+                    http_response_close(&parser.response);
+                    break;
+                }
+                if (hr_feed(&parser, data, length) < 0)
+                {
+                    break;
+                }
+            }
+
+            failures += !hr_result(&parser, response, "over TLS");
+
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+            close(socket);
+        }
+    }
+
+    SSL_CTX_free(context);
+
+    return(failures);
+}
+
+/*!
+ * \brief Open a TLS connection, the stand-in's certificate is not checked
+ *
+ * \param[in]   context  openssl context
+ * \param[in]   address  stand-in address
+ * \param[in]   port     stand-in port
+ * \param[out]  ssl      connection
+ *
+ * \return socket, -1 on error
+ */
+static int hr_tls_connect(SSL_CTX *context, const char *address, int port, SSL **ssl)
+{
+    struct sockaddr_in server;
+    int one = 1;
+    int s;
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if ((inet_pton(AF_INET, address, &server.sin_addr) != 1) || ((s = socket(AF_INET, SOCK_STREAM, 0)) < 0))
+    {
+        return(-1);
+    }
+
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(s, (struct sockaddr *)&server, sizeof(server)))
+    {
+        close(s);
+        return(-1);
+    }
+
+    *ssl = SSL_new(context);
+    SSL_set_fd(*ssl, s);
+    if (SSL_connect(*ssl) != 1)
+    {
+        SSL_free(*ssl);
+        close(s);
+        return(-1);
+    }
+
+    return(s);
+}
+#endif
+
+/*!
+ * \brief Small repeatable random number generator
+ *
+ * \return next number
+ */
+static uint32_t hr_random(void)
+{
+    hr_seed ^= hr_seed << 13;
+    hr_seed ^= hr_seed >> 17;
+    hr_seed ^= hr_seed << 5;
+
+    return(hr_seed);
+}
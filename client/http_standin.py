@@ -0,0 +1,204 @@
+#!/usr/bin/python3
+
+# HTTPS stand-in for the Powerwall gateway, for testing the firmware's http code on a linux host.
+#
+# "GET /<name>" is answered with the recorded response of that name from http_responses.txt, sent in TLS records of
+# random sizes so the client sees it split at awkward places, and the connection is then closed.  "GET /quit" stops
+# the stand-in.  A self-signed certificate is made with openssl the first time it is run.
+#
+# The gateway's own api is also emulated, as far as the firmware uses it: POST /api/login/Basic returns a token and
+# the AuthCookie and UserRecord cookies, GET /api/system_status/grid_status and /api/system_status/soe need the token
+# and answer 401 once it has been used for --token-requests requests, and GET /api/logout drops it.  Connections are
+# kept alive, and closed after --close-after requests as the gateway does.  Like the gateway it only talks TLS 1.2,
+# and it issues session tickets so a client can resume.  --handshake-delay and --response-delay slow it down to the
+# pico's TLS handshake and response times.
+#
+#   python3 http_standin.py &
+#   ./http_response_tls -t 8443        (or just: make tls-test)
+#   ./powerwall_session_bench
+#
+#   python3 http_standin.py -k 4 -H 0.8 -D 0.1 &
+#   ./powerwall_session_bench -j 300
+
+import argparse
+import json
+import os
+import random
+import secrets
+import socket
+import ssl
+import subprocess
+import sys
+import threading
+import time
+
+# sizes of the pieces a response is sent in, each becomes a TLS record
+record_sizes = (1, 2, 3, 7, 16, 61, 200, 1460)
+
+def load_responses(name):
+    responses = {}
+    current = None
+    with open(name) as f:
+        for line in f:
+            line = line.rstrip('\r\n')
+            if line.startswith('response '):
+                current = line.split()[1]
+                responses[current] = b''
+            elif line.startswith('text ') and current:
+                text = line[5:].replace('\\\\', '\0').replace('\\r', '\r').replace('\\n', '\n').replace('\0', '\\')
+                responses[current] += text.encode()
+            elif line.startswith('body ') and current:
+                responses[current] += line[5:].encode()
+    return responses
+
+def make_certificate(name):
+    if not os.path.exists(name):
+        subprocess.run(['openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-subj', '/CN=localhost',
+                        '-days', '3650', '-keyout', name, '-out', name], check=True, capture_output=True)
+
+def read_request(connection, pending):
+    # requests are read up to the blank line; blank lines before a request are ignored (RFC 9112 2.2)
+    while b'\r\n\r\n' not in pending.lstrip(b'\r\n'):
+        data = connection.recv(4096)
+        if not data:
+            return None, b''
+        pending += data
+    head, pending = pending.lstrip(b'\r\n').split(b'\r\n\r\n', 1)
+    lines = head.decode(errors='replace').split('\r\n')
+    method, url = lines[0].split()[:2]
+    headers = {}
+    for line in lines[1:]:
+        if ':' in line:
+            key, value = line.split(':', 1)
+            headers[key.strip().lower()] = value.strip()
+    length = int(headers.get('content-length', 0))
+    while len(pending) < length:
+        data = connection.recv(4096)
+        if not data:
+            return None, b''
+        pending += data
+    return (method, url, headers, pending[:length]), pending[length:]
+
+class Standin:
+    def __init__(self, options):
+        self.options = options
+        self.responses = load_responses(options.responses)
+        self.random = random.Random(options.seed)
+        self.lock = threading.Lock()
+        self.done = threading.Event()
+        self.tokens = {}                # token to the number of requests it is still good for
+
+    def send_in_pieces(self, connection, data):
+        i = 0
+        while i < len(data):
+            with self.lock:
+                size = self.random.choice(record_sizes)
+                pause = self.random.random() < 0.2
+            connection.sendall(data[i:i + size])
+            i += size
+            if pause:
+                time.sleep(0.0005)
+
+    def reply(self, connection, status, body, headers=''):
+        time.sleep(self.options.response_delay)
+        data = json.dumps(body).encode() if body else b''
+        connection.sendall(('HTTP/1.1 %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n%s\r\n' %
+                            (status, len(data), headers)).encode() + data)
+
+    def gateway(self, connection, method, url, headers):
+        if (method, url) == ('POST', '/api/login/Basic'):
+            token = secrets.token_urlsafe(64)
+            with self.lock:
+                self.tokens[token] = self.options.token_requests
+            self.reply(connection, '200 OK',
+                       {'email': '', 'firstname': 'Tesla', 'lastname': 'Energy', 'roles': ['Home_Owner'], 'token': token,
+                        'provider': 'Basic', 'loginTime': '2024-05-01T10:00:00.000000-07:00'},
+                       'Set-Cookie: AuthCookie=%s; path=/\r\n'
+                       'Set-Cookie: UserRecord=eyJlbWFpbCI6IiIsImZpcnN0bmFtZSI6IlRlc2xhIn0=; path=/\r\n' % token)
+            return
+
+        token = headers.get('authorization', '')[len('Bearer '):]
+        with self.lock:
+            valid = self.tokens.get(token, 0) > 0
+            if valid:
+                self.tokens[token] -= 1
+        if not valid:
+            self.reply(connection, '401 Unauthorized', {'code': 401, 'error': 'bad token', 'message': 'Invalid bearer token'})
+        elif url == '/api/system_status/grid_status':
+            self.reply(connection, '200 OK', {'grid_status': 'SystemGridConnected', 'grid_services_active': False})
+        elif url == '/api/system_status/soe':
+            self.reply(connection, '200 OK', {'percentage': 84.03846153846153})
+        elif url == '/api/logout':
+            with self.lock:
+                self.tokens.pop(token, None)
+            self.reply(connection, '204 No Content', None)
+        else:
+            self.reply(connection, '404 Not Found', None)
+
+    def serve(self, connection):
+        pending = b''
+        served = 0
+        while not self.options.close_after or served < self.options.close_after:
+            request, pending = read_request(connection, pending)
+            if not request:
+                return
+            method, url, headers, body = request
+            served += 1
+            if url == '/quit':
+                self.done.set()
+                return
+            elif url[1:] in self.responses:
+                # recorded responses may be read until the connection closes
+                self.send_in_pieces(connection, self.responses[url[1:]])
+                return
+            self.gateway(connection, method, url, headers)
+
+    def connection(self, client, context):
+        try:
+            time.sleep(self.options.handshake_delay)
+            connection = context.wrap_socket(client, server_side=True)
+            self.serve(connection)
+            connection.close()
+        except (OSError, ssl.SSLError) as e:
+            if self.options.verbose:
+                print('stand-in:', e, file=sys.stderr)
+        finally:
+            client.close()
+
+    def run(self):
+        make_certificate(self.options.cert)
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(self.options.cert)
+        context.maximum_version = ssl.TLSVersion.TLSv1_2
+
+        listener = socket.socket()
+        listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        listener.bind((self.options.address, self.options.port))
+        listener.listen(16)
+        listener.settimeout(0.2)
+        print('stand-in listening on %s:%d' % (self.options.address, self.options.port), flush=True)
+
+        while not self.done.is_set():
+            try:
+                client, _ = listener.accept()
+            except socket.timeout:
+                continue
+            client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            threading.Thread(target=self.connection, args=(client, context), daemon=True).start()
+
+def main():
+    parser = argparse.ArgumentParser(description='HTTPS stand-in for the Powerwall gateway')
+    parser.add_argument('-a', '--address', default='127.0.0.1', help='address to listen on (default 127.0.0.1)')
+    parser.add_argument('-p', '--port', type=int, default=8443, help='https port (default 8443)')
+    parser.add_argument('-c', '--cert', default='standin.pem', help='certificate and key, made if missing (default standin.pem)')
+    parser.add_argument('-r', '--responses', default='http_responses.txt', help='recorded responses (default http_responses.txt)')
+    parser.add_argument('-s', '--seed', type=int, default=1, help='random seed for the record sizes (default 1)')
+    parser.add_argument('-t', '--token-requests', type=int, default=50, help='requests a login token is good for (default 50)')
+    parser.add_argument('-k', '--close-after', type=int, default=20, help='requests before a connection is closed, 0 for never (default 20)')
+    parser.add_argument('-H', '--handshake-delay', type=float, default=0, help='seconds added to every TLS handshake (default 0)')
+    parser.add_argument('-D', '--response-delay', type=float, default=0, help='seconds added to every api response (default 0)')
+    parser.add_argument('-v', '--verbose', action='store_true', help='report connections that fail')
+    Standin(parser.parse_args()).run()
+
+if __name__ == '__main__':
+    main()
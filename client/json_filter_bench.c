@@ -0,0 +1,334 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "json_parser.h"
+
+/*
+ * Json filter lookup benchmark
+ *
+ * Parses the recorded responses in json_responses.txt with the filters the firmware uses on each, plus a number of
+ * filters for paths the response does not have, and compares the parser's hashed filter lookup with a linear search
+ * that runs strcasecmp() against every filter for every value, as the parser did before paths were hashed.  Both must
+ * find the same values; then each is timed, best of several runs.
+ * Exits with 1 if the two lookups find different values.
+ */
+
+#define JF_LINE_MAX             (8192)
+#define JF_RESPONSES_MAX        (32)
+#define JF_FILTERS_MAX          (64)
+#define JF_VALUE_MAX            (JSONP_VALUE_MAX - 2)   // short enough that the callback text always covers it
+#define JF_RUNS                 (10)
+
+typedef struct
+{
+    char *json;
+    char *label;                // comment before the response
+    int num_filters;
+    char *paths[JF_FILTERS_MAX];
+    bool strip_quotes[JF_FILTERS_MAX];
+} JF_RESPONSE_T;
+
+typedef struct
+{
+    JSONP_FILTER_T *filters;
+    int num_filters;
+    long compares;
+} JF_LINEAR_T;
+
+// prototypes
+static void jf_usage(const char *program);
+static int jf_load(const char *name, int absent);
+static void jf_parse(const char *json, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *arg);
+static void jf_linear(void *arg, const char *path, const char *value);
+static double jf_now_us(void);
+
+// static variables
+static JF_RESPONSE_T jf_responses[JF_RESPONSES_MAX];
+static int jf_num_responses = 0;
+
+int main(int argc, char *argv[])
+{
+    static char hashed_values[JF_FILTERS_MAX][JF_VALUE_MAX];
+    static char linear_values[JF_FILTERS_MAX][JF_VALUE_MAX];
+    JSONP_FILTER_T hashed[JF_FILTERS_MAX];
+    JSONP_FILTER_T linear[JF_FILTERS_MAX];
+    const char *responses_name = "json_responses.txt";
+    JF_RESPONSE_T *response;
+    JF_LINEAR_T search;
+    double hashed_us;
+    double linear_us;
+    double start;
+    double elapsed;
+    long mismatches = 0;
+    int absent = 8;
+    int loops = 2000;
+    int option;
+    int run;
+    int i;
+    int j;
+
+    while ((option = getopt(argc, argv, "f:a:l:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'f':
+                responses_name = optarg;
+                break;
+            case 'a':
+                absent = atoi(optarg);
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                jf_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((absent < 0) || (loops <= 0) || jf_load(responses_name, absent))
+    {
+        jf_usage(argv[0]);
+        return(1);
+    }
+
+    printf("%-50s filters  linear strcasecmp      hashed\n", "response");
+
+    for (i=0; i<jf_num_responses; i++)
+    {
+        response = &jf_responses[i];
+
+        // both lookups find the same values
+        for (j=0; j<response->num_filters; j++)
+        {
+            hashed[j] = (JSONP_FILTER_T){response->paths[j], hashed_values[j], JF_VALUE_MAX, response->strip_quotes[j], false, 0};
+            linear[j] = hashed[j];
+            linear[j].value = linear_values[j];
+            linear_values[j][0] = 0;
+        }
+        search = (JF_LINEAR_T){linear, response->num_filters, 0};
+        jf_parse(response->json, hashed, response->num_filters, NULL, NULL);
+        jf_parse(response->json, NULL, 0, jf_linear, &search);
+
+        for (j=0; j<response->num_filters; j++)
+        {
+            if ((hashed[j].found != linear[j].found) || strcmp(hashed_values[j], linear_values[j]))
+            {
+                printf("%s: %s is %s hashed and %s linear\n", response->label, response->paths[j],
+                       hashed[j].found ? hashed_values[j] : "missing", linear[j].found ? linear_values[j] : "missing");
+                mismatches++;
+            }
+        }
+
+        hashed_us = linear_us = 1e12;
+        for (run=0; run<JF_RUNS; run++)
+        {
+            start = jf_now_us();
+            for (j=0; j<loops; j++)
+            {
+                jf_parse(response->json, hashed, response->num_filters, NULL, NULL);
+            }
+            elapsed = (jf_now_us() - start)/loops;
+            hashed_us = (elapsed < hashed_us) ? elapsed : hashed_us;
+
+            start = jf_now_us();
+            for (j=0; j<loops; j++)
+            {
+                search.compares = 0;
+                jf_parse(response->json, NULL, 0, jf_linear, &search);
+            }
+            elapsed = (jf_now_us() - start)/loops;
+            linear_us = (elapsed < linear_us) ? elapsed : linear_us;
+        }
+
+        printf("%-50.50s %7d %8.2f us %5ld cmp %8.2f us\n", response->label, response->num_filters, linear_us, search.compares, hashed_us);
+    }
+
+    printf("%s\n", mismatches ? "FAILED" : "passed");
+
+    return(mismatches ? 1 : 0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void jf_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-f responses] [-a absent] [-l loops]\n"
+            "  -f file      recorded responses (default json_responses.txt)\n"
+            "  -a count     filters added for paths the responses do not have (default 8)\n"
+            "  -l count     parses of each response per timed run (default 2000)\n",
+            program);
+}
+
+/*!
+ * \brief Read the recorded responses and the paths the firmware filters on
+ *
+ * \param[in]  name     file name, as read by json_parser_test
+ * \param[in]  absent   filters to add to each response for paths it does not have
+ *
+ * \return 0 on success, -1 on error
+ */
+static int jf_load(const char *name, int absent)
+{
+    static char label[JF_LINE_MAX] = "";
+    char line[JF_LINE_MAX];
+    char path[JSONP_PATH_MAX];
+    JF_RESPONSE_T *response = NULL;
+    FILE *file;
+    char *text;
+    char *end;
+    int length;
+    int i;
+
+    if (!(file = fopen(name, "r")))
+    {
+        fprintf(stderr, "cannot open %s\n", name);
+        return(-1);
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        length = strlen(line);
+        while (length && ((line[length-1] == '\n') || (line[length-1] == '\r')))
+        {
+            line[--length] = 0;
+        }
+
+        if (line[0] == '#')
+        {
+            for (text = line + 1; *text == ' '; text++);
+            if (*text)
+            {
+                strcpy(label, text);
+            }
+        }
+        else if (!strncmp(line, "json ", 5) && (jf_num_responses < JF_RESPONSES_MAX))
+        {
+            response = &jf_responses[jf_num_responses++];
+            response->json = strdup(line + 5);
+            response->label = strdup(label);
+        }
+        else if (response && (response->num_filters < JF_FILTERS_MAX - absent) &&
+                 (!strncmp(line, "value ", 6) || !strncmp(line, "stripped ", 9) || !strncmp(line, "missing ", 8)))
+        {
+            text = strchr(line, ' ') + 1;
+            if ((end = strchr(text, ' ')))
+            {
+                *end = 0;
+            }
+            response->strip_quotes[response->num_filters] = (line[0] == 's');
+            response->paths[response->num_filters++] = strdup(text);
+        }
+    }
+
+    fclose(file);
+
+    if (!jf_num_responses || (absent > JF_FILTERS_MAX))
+    {
+        fprintf(stderr, "no responses in %s\n", name);
+        return(-1);
+    }
+
+    for (i=0; i<absent; i++)
+    {
+        snprintf(path, sizeof(path), "root.\"absent\".index%d", i);
+        for (response=jf_responses; response<jf_responses+jf_num_responses; response++)
+        {
+            response->strip_quotes[response->num_filters] = false;
+            response->paths[response->num_filters++] = strdup(path);
+        }
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Parse a response, without the message jsonp_parse_string() prints for a malformed one
+ *
+ * \param[in]  json         response
+ * \param[in]  filters      values wanted
+ * \param[in]  num_filters  number of filters
+ * \param[in]  callback     called for every value, may be NULL
+ * \param[in]  arg          passed to the callback
+ *
+ * \return nothing
+ */
+static void jf_parse(const char *json, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *arg)
+{
+    JSON_PARSER_CONTEXT_T context;
+
+    jsonp_begin(&context, filters, num_filters, callback, arg);
+    jsonp_parse_buffer(&context, json, strlen(json));
+    jsonp_end(&context);
+}
+
+/*!
+ * \brief Callback finding the filter for a value by comparing its path with every filter
+ *
+ * \param[in]  arg      JF_LINEAR_T
+ * \param[in]  path     path of the value
+ * \param[in]  value    value text, at most JSONP_VALUE_MAX - 1 characters
+ *
+ * \return nothing
+ */
+static void jf_linear(void *arg, const char *path, const char *value)
+{
+    JF_LINEAR_T *search = (JF_LINEAR_T *)arg;
+    JSONP_FILTER_T *filter;
+    int length;
+    int i;
+
+    for (i=0; i<search->num_filters; i++)
+    {
+        search->compares++;
+        if (!strcasecmp(search->filters[i].path, path))
+        {
+            filter = &search->filters[i];
+            length = strlen(value);
+            if (filter->strip_quotes && (value[0] == '"'))
+            {
+                value++;
+                length--;
+                if ((length > 0) && (value[length-1] == '"'))
+                {
+                    length--;
+                }
+            }
+            snprintf(filter->value, filter->value_length, "%.*s", length, value);
+            filter->found = true;
+            break;
+        }
+    }
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double jf_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
@@ -0,0 +1,900 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "json_parser.h"
+
+/*
+ * Json parser test
+ *
+ * Runs json_parser.c on a linux host and checks that:
+ *
+ *   - recorded Shelly and Powerwall responses (json_responses.txt) give the values the firmware filters on, parsed
+ *     whole and in pieces of every size, and that the pieces give the same callback output as the whole response
+ *   - nesting too deep, paths too long, values longer than the filter, mismatched brackets, responses cut short and a
+ *     document that is a single literal are handled as documented
+ *   - randomly generated documents parsed in random pieces report every value with the path and text they were
+ *     generated with
+ *   - mutated documents never pass the callback a path or value longer than the limits, nor overrun a filter
+ *
+ * Then it times each recorded response.  Build with CFLAGS="-O1 -g -fsanitize=address,undefined" to run the mutated
+ * documents under the sanitizers.
+ * Exits with 1 if any check fails.
+ */
+
+#define JT_LINE_MAX             (8192)
+#define JT_RESPONSES_MAX        (32)
+#define JT_EXPECTS_MAX          (256)
+#define JT_TEXT_MAX             (1 << 16)
+#define JT_FILTER_VALUE_MAX     (256)
+#define JT_GENERATED_DEPTH      (5)             // keeps generated paths inside JSONP_PATH_MAX
+#define JT_PIECE_MAX            (40)
+
+typedef enum
+{
+    JT_VALUE = 0,
+    JT_STRIPPED,
+    JT_MISSING
+} JT_KIND_T;
+
+typedef struct
+{
+    JT_KIND_T kind;
+    char *path;
+    char *text;
+} JT_EXPECT_T;
+
+typedef struct
+{
+    char *json;
+    char *label;                // comment before the response
+    bool error;                 // the response is malformed
+    int first_expect;
+    int num_expects;
+} JT_RESPONSE_T;
+
+typedef struct
+{
+    char *text;
+    int length;
+    int size;
+    bool overflow;              // text did not fit
+} JT_TEXT_T;
+
+// prototypes
+static void jt_usage(const char *program);
+static int jt_load(const char *name);
+static long jt_check_responses(void);
+static long jt_check_response(JT_RESPONSE_T *response, int piece);
+static long jt_check_cases(void);
+static long jt_check_generated(int documents);
+static long jt_check_mutated(int documents);
+static void jt_time(int loops);
+static int jt_parse(const char *json, int length, int piece, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *arg);
+static void jt_generate(JT_TEXT_T *document, JT_TEXT_T *values, const char *path, int depth);
+static void jt_generate_string(JT_TEXT_T *text, bool key);
+static void jt_space(JT_TEXT_T *document);
+static void jt_record(void *arg, const char *path, const char *value);
+static void jt_limits(void *arg, const char *path, const char *value);
+static void jt_start(JT_TEXT_T *text, char *buffer, int size);
+static void jt_append(JT_TEXT_T *text, const char *format, ...);
+static uint32_t jt_random(void);
+static double jt_now_us(void);
+
+// static variables
+static JT_RESPONSE_T jt_responses[JT_RESPONSES_MAX];
+static int jt_num_responses = 0;
+static JT_EXPECT_T jt_expects[JT_EXPECTS_MAX];
+static int jt_num_expects = 0;
+static char jt_whole_text[JT_TEXT_MAX];
+static char jt_piece_text[JT_TEXT_MAX];
+static char jt_expected_text[JT_TEXT_MAX];
+static char jt_document_text[JT_TEXT_MAX];
+static uint32_t jt_seed = 1;
+static long jt_over_limit = 0;
+
+int main(int argc, char *argv[])
+{
+    const char *responses_name = "json_responses.txt";
+    int documents = 20000;
+    int loops = 20000;
+    long failures = 0;
+    long count;
+    int option;
+
+    while ((option = getopt(argc, argv, "f:n:l:s:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'f':
+                responses_name = optarg;
+                break;
+            case 'n':
+                documents = atoi(optarg);
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            case 's':
+                jt_seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'h':
+            default:
+                jt_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((documents < 0) || (loops < 0) || !jt_seed || jt_load(responses_name))
+    {
+        jt_usage(argv[0]);
+        return(1);
+    }
+
+    count = jt_check_responses();
+    printf("%d recorded responses whole and in pieces of every size: %ld failures\n", jt_num_responses, count);
+    failures += count;
+
+    count = jt_check_cases();
+    printf("edge cases: %ld failures\n", count);
+    failures += count;
+
+    count = jt_check_generated(documents);
+    printf("%d generated documents in random pieces: %ld failures\n", documents, count);
+    failures += count;
+
+    count = jt_check_mutated(documents);
+    printf("%d mutated documents: %ld paths, values or filters over their limits\n", documents, count);
+    failures += count;
+
+    if (loops)
+    {
+        jt_time(loops);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return(failures ? 1 : 0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void jt_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-f responses] [-n documents] [-l loops] [-s seed]\n"
+            "  -f file      recorded responses (default json_responses.txt)\n"
+            "  -n count     generated and mutated documents (default 20000)\n"
+            "  -l count     parse each response this many times for timing (default 20000, 0 to skip)\n"
+            "  -s seed      random seed, not 0 (default 1)\n",
+            program);
+}
+
+/*!
+ * \brief Read the recorded responses and the values expected from them
+ *
+ * \param[in]  name     file name
+ *
+ * \return 0 on success, -1 on error
+ */
+static int jt_load(const char *name)
+{
+    static char label[JT_LINE_MAX] = "";
+    char line[JT_LINE_MAX];
+    JT_RESPONSE_T *response = NULL;
+    JT_EXPECT_T *expect;
+    FILE *file;
+    char *text;
+    int number = 0;
+    int length;
+
+    if (!(file = fopen(name, "r")))
+    {
+        fprintf(stderr, "cannot open %s\n", name);
+        return(-1);
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        number++;
+        length = strlen(line);
+        while (length && ((line[length-1] == '\n') || (line[length-1] == '\r')))
+        {
+            line[--length] = 0;
+        }
+
+        if (line[0] == '#')
+        {
+            for (text = line + 1; *text == ' '; text++);
+            if (*text)
+            {
+                strcpy(label, text);
+            }
+            continue;
+        }
+
+        if (!length)
+        {
+            continue;
+        }
+
+        if (!strncmp(line, "json ", 5) && (jt_num_responses < JT_RESPONSES_MAX))
+        {
+            response = &jt_responses[jt_num_responses++];
+            response->json = strdup(line + 5);
+            response->label = strdup(label);
+            response->first_expect = jt_num_expects;
+            continue;
+        }
+
+        if (response && !strcmp(line, "error"))
+        {
+            response->error = true;
+            continue;
+        }
+
+        if (!response || (jt_num_expects >= JT_EXPECTS_MAX))
+        {
+            fprintf(stderr, "%s:%d: not expected here\n", name, number);
+            fclose(file);
+            return(-1);
+        }
+
+        expect = &jt_expects[jt_num_expects];
+        if (!strncmp(line, "value ", 6))
+        {
+            expect->kind = JT_VALUE;
+            text = line + 6;
+        }
+        else if (!strncmp(line, "stripped ", 9))
+        {
+            expect->kind = JT_STRIPPED;
+            text = line + 9;
+        }
+        else if (!strncmp(line, "missing ", 8))
+        {
+            expect->kind = JT_MISSING;
+            text = line + 8;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: unknown line\n", name, number);
+            fclose(file);
+            return(-1);
+        }
+
+        expect->path = strdup(text);
+        expect->text = strchr(expect->path, ' ');
+        if (expect->text)
+        {
+            *expect->text++ = 0;
+        }
+        if ((expect->kind == JT_MISSING) == (expect->text != NULL))
+        {
+            fprintf(stderr, "%s:%d: value %s\n", name, number, expect->text ? "not expected" : "missing");
+            fclose(file);
+            return(-1);
+        }
+
+        jt_num_expects++;
+        response->num_expects++;
+    }
+
+    fclose(file);
+
+    if (!jt_num_responses)
+    {
+        fprintf(stderr, "no responses in %s\n", name);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Check every recorded response whole and in pieces of every size
+ *
+ * \return number of failures
+ */
+static long jt_check_responses(void)
+{
+    JT_RESPONSE_T *response;
+    long failures = 0;
+    int length;
+    int piece;
+    int i;
+
+    for (i=0; i<jt_num_responses; i++)
+    {
+        response = &jt_responses[i];
+        length = strlen(response->json);
+
+        // the whole response is the reference for the pieces
+        failures += jt_check_response(response, 0);
+        for (piece=1; piece<length; piece++)
+        {
+            failures += jt_check_response(response, piece);
+        }
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Parse one response and check the filters, the result and the callback output
+ *
+ * \param[in]  response     recorded response
+ * \param[in]  piece        size of the pieces, 0 to parse it whole and keep its callback output as the reference
+ *
+ * \return number of failures
+ */
+static long jt_check_response(JT_RESPONSE_T *response, int piece)
+{
+    static char values[JT_EXPECTS_MAX][JT_FILTER_VALUE_MAX];
+    JSONP_FILTER_T filters[JT_EXPECTS_MAX];
+    JT_EXPECT_T *expect;
+    JT_TEXT_T text;
+    long failures = 0;
+    int result;
+    int i;
+
+    for (i=0; i<response->num_expects; i++)
+    {
+        expect = &jt_expects[response->first_expect + i];
+        filters[i] = (JSONP_FILTER_T){expect->path, values[i], sizeof(values[i]), expect->kind == JT_STRIPPED, false, 0};
+    }
+
+    jt_start(&text, piece ? jt_piece_text : jt_whole_text, JT_TEXT_MAX);
+    result = jt_parse(response->json, strlen(response->json), piece ? piece : JT_TEXT_MAX, filters, response->num_expects, jt_record, &text);
+
+    if (result != (response->error ? -1 : 0))
+    {
+        printf("%s, pieces of %d: parse %s\n", response->label, piece, result ? "failed" : "completed");
+        failures++;
+    }
+
+    for (i=0; i<response->num_expects; i++)
+    {
+        expect = &jt_expects[response->first_expect + i];
+        if ((expect->kind == JT_MISSING) ? filters[i].found : (!filters[i].found || strcmp(values[i], expect->text)))
+        {
+            printf("%s, pieces of %d: %s is %s\n", response->label, piece, expect->path, filters[i].found ? values[i] : "missing");
+            failures++;
+        }
+    }
+
+    if (text.overflow || (piece && strcmp(jt_piece_text, jt_whole_text)))
+    {
+        printf("%s, pieces of %d: callback output differs from the whole response\n", response->label, piece);
+        failures++;
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Check the documented limits and malformed documents
+ *
+ * \return number of failures
+ */
+static long jt_check_cases(void)
+{
+    char document[1024];
+    char value[8];
+    char path[JSONP_PATH_MAX + 64];
+    JSONP_FILTER_T filters[] = {{"root.\"b\"", value, sizeof(value), false, false, 0}};
+    JT_TEXT_T text;
+    long failures = 0;
+    int result;
+    int i;
+
+    #define JT_CASE(condition, description)                                                     \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            printf("edge case: %s\n", description);                                            \
+            failures++;                                                                         \
+        }
+
+    // JSONP_MAX_DEPTH levels are parsed, one more is an error
+    memset(document, 0, sizeof(document));
+    memset(document, '[', JSONP_MAX_DEPTH);
+    document[JSONP_MAX_DEPTH] = '1';
+    memset(document + JSONP_MAX_DEPTH + 1, ']', JSONP_MAX_DEPTH);
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    result = jt_parse(document, strlen(document), JT_TEXT_MAX, NULL, 0, jt_record, &text);
+    strcpy(path, "root");
+    for (i=0; i<JSONP_MAX_DEPTH; i++)
+    {
+        strcat(path, ".index0");
+    }
+    strcat(path, " = 1\n");
+    JT_CASE(!result && !strcmp(jt_piece_text, path), "deepest nesting not parsed")
+
+    memset(document, 0, sizeof(document));
+    memset(document, '[', JSONP_MAX_DEPTH + 1);
+    document[JSONP_MAX_DEPTH + 1] = '1';
+    memset(document + JSONP_MAX_DEPTH + 2, ']', JSONP_MAX_DEPTH + 1);
+    JT_CASE(jt_parse(document, strlen(document), JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "nesting too deep not an error")
+
+    // a path that does not fit is reported as (long path) and later paths are matched again
+    strcpy(document, "{\"a\":{\"");
+    memset(document + strlen(document), 'x', JSONP_PATH_MAX);
+    document[7 + JSONP_PATH_MAX] = 0;
+    strcat(document, "\":{\"y\":1}},\"b\":\"ok\"}");
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    result = jt_parse(document, strlen(document), JT_TEXT_MAX, filters, 1, jt_record, &text);
+    JT_CASE(!result && !strcmp(jt_piece_text, "(long path) = 1\nroot.\"b\" = \"ok\"\n"), "long path not reported as (long path)")
+    JT_CASE(filters[0].found && !strcmp(value, "\"ok\""), "value after a long path not found")
+
+    // a filter receives as much of a long value as fits and the callback up to JSONP_VALUE_MAX - 1 characters
+    strcpy(document, "{\"b\":\"");
+    memset(document + strlen(document), 'v', 2*JSONP_VALUE_MAX);
+    document[6 + 2*JSONP_VALUE_MAX] = 0;
+    strcat(document, "\"}");
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    result = jt_parse(document, strlen(document), 5, filters, 1, jt_record, &text);
+    JT_CASE(!result && filters[0].found && !strcmp(value, "\"vvvvvv"), "long value not truncated to the filter")
+    snprintf(path, sizeof(path), "root.\"b\" = %.*s\n", JSONP_VALUE_MAX - 1, document + 5);
+    JT_CASE(!strcmp(jt_piece_text, path), "long value not truncated for the callback")
+
+    // a filter of one byte is left empty and one of no bytes is not written
+    filters[0].value_length = 1;
+    JT_CASE((jsonp_parse_string("{\"b\":12}", filters, 1, NULL, NULL) == 1) && !value[0], "one byte filter not empty")
+    value[0] = 'z';
+    filters[0].value_length = 0;
+    JT_CASE(!jsonp_parse_string("{\"b\":12}", filters, 1, NULL, NULL) && (value[0] == 'z'), "empty filter written")
+    filters[0].value_length = sizeof(value);
+
+    // paths are matched ignoring case, and only in full
+    filters[0].path = "ROOT.\"B\"";
+    JT_CASE(jsonp_parse_string("{\"b\":true}", filters, 1, NULL, NULL) == 1, "path matched with case")
+    filters[0].path = "root.\"b";
+    JT_CASE(!jsonp_parse_string("{\"b\":true}", filters, 1, NULL, NULL), "partial path matched")
+    filters[0].path = "root.\"b\"";
+
+    // malformed documents
+    JT_CASE(jt_parse("{\"b\":[1}", 8, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "mismatched bracket not an error")
+    JT_CASE(jt_parse("{\"b\" 1}", 7, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "missing colon not an error")
+    JT_CASE(jt_parse("{b:1}", 5, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "unquoted key not an error")
+    JT_CASE(jt_parse("{\"b\":1 2}", 9, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "missing comma not an error")
+    JT_CASE(jt_parse("{\"b\":\"x", 7, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "unterminated string completed")
+    JT_CASE(jt_parse("", 0, JT_TEXT_MAX, NULL, 0, NULL, NULL) == -1, "empty document completed")
+
+    // a document that is a single literal ends with its text, text after a complete document is ignored
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    JT_CASE(!jt_parse("42", 2, 1, NULL, 0, jt_record, &text) && !strcmp(jt_piece_text, "root = 42\n"), "root literal not reported")
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    JT_CASE(!jt_parse("{\"b\":1} {\"c\":2}", 15, JT_TEXT_MAX, NULL, 0, jt_record, &text) && !strcmp(jt_piece_text, "root.\"b\" = 1\n"),
+            "text after the document parsed")
+
+    // escaped quotes do not end strings or keys
+    jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+    result = jt_parse("{\"k\\\"}\":\"v\\\"}\"}", 15, 1, NULL, 0, jt_record, &text);
+    JT_CASE(!result && !strcmp(jt_piece_text, "root.\"k\\\"}\" = \"v\\\"}\"\n"), "escaped quote ends a string")
+
+    #undef JT_CASE
+
+    return(failures);
+}
+
+/*!
+ * \brief Parse generated documents in random pieces and compare the values with those they were generated with
+ *
+ * \param[in]  documents    number of documents
+ *
+ * \return number of failures
+ */
+static long jt_check_generated(int documents)
+{
+    JT_TEXT_T document;
+    JT_TEXT_T expected;
+    JT_TEXT_T text;
+    long failures = 0;
+    int result;
+    int i;
+
+    for (i=0; i<documents; i++)
+    {
+        jt_start(&document, jt_document_text, JT_TEXT_MAX);
+        jt_start(&expected, jt_expected_text, JT_TEXT_MAX);
+        jt_generate(&document, &expected, "root", 0);
+
+        jt_start(&text, jt_piece_text, JT_TEXT_MAX);
+        result = jt_parse(document.text, document.length, 1 + jt_random()%JT_PIECE_MAX, NULL, 0, jt_record, &text);
+
+        if (document.overflow || expected.overflow)
+        {
+            continue;
+        }
+
+        if (result || text.overflow || strcmp(jt_piece_text, jt_expected_text))
+        {
+            if (!failures)
+            {
+                printf("document %s\ngave\n%sexpected\n%s", jt_document_text, jt_piece_text, jt_expected_text);
+            }
+            failures++;
+        }
+    }
+
+    return(failures);
+}
+
+/*!
+ * \brief Parse mutated documents and check nothing is passed on over its limit
+ *
+ * \param[in]  documents    number of documents
+ *
+ * \return number of paths, values or filters over their limit
+ */
+static long jt_check_mutated(int documents)
+{
+    static const char structure[] = "{}[]\":,\\ x0-";
+    char short_value[4];
+    char long_value[JT_FILTER_VALUE_MAX];
+    JSONP_FILTER_T filters[] = {{"root.index0", short_value, sizeof(short_value), false, false, 0},
+                                {"root.\"a\"", long_value, sizeof(long_value), true, false, 0}};
+    JT_TEXT_T document;
+    JT_TEXT_T expected;
+    int position;
+    int mutations;
+    int run;
+    int i;
+    int j;
+
+    jt_over_limit = 0;
+
+    for (i=0; i<documents; i++)
+    {
+        jt_start(&document, jt_document_text, JT_TEXT_MAX);
+        jt_start(&expected, jt_expected_text, JT_TEXT_MAX);
+        jt_generate(&document, &expected, "root", 0);
+
+        mutations = 1 + jt_random()%4;
+        for (j=0; (j<mutations) && document.length; j++)
+        {
+            position = jt_random()%document.length;
+            switch(jt_random()%5)
+            {
+                case 0:
+                    document.text[position] = structure[jt_random()%(sizeof(structure) - 1)];
+                    break;
+                case 1:
+                    document.text[position] = 1 + jt_random()%255;
+                    break;
+                case 2:
+                    memmove(document.text + position, document.text + position + 1, document.length - position);
+                    document.length--;
+                    break;
+                case 3:
+                    document.length = position;
+                    break;
+                default:
+                    // a long run of one character makes long keys, strings, numbers or nesting
+                    run = jt_random()%(2*JSONP_PATH_MAX);
+                    if (document.length + run < JT_TEXT_MAX)
+                    {
+                        memmove(document.text + position + run, document.text + position, document.length - position);
+                        memset(document.text + position, structure[jt_random()%(sizeof(structure) - 1)], run);
+                        document.length += run;
+                    }
+                    break;
+            }
+        }
+
+        jt_parse(document.text, document.length, 1 + jt_random()%JT_PIECE_MAX, filters, 2, jt_limits, NULL);
+
+        if ((filters[0].found && (strnlen(short_value, sizeof(short_value)) >= (int)sizeof(short_value))) ||
+            (filters[1].found && (strnlen(long_value, sizeof(long_value)) >= (int)sizeof(long_value))))
+        {
+            jt_over_limit++;
+        }
+    }
+
+    return(jt_over_limit);
+}
+
+/*!
+ * \brief Time the recorded responses
+ *
+ * \param[in]  loops    parses of each response
+ *
+ * \return nothing
+ */
+static void jt_time(int loops)
+{
+    static char values[JT_EXPECTS_MAX][JT_FILTER_VALUE_MAX];
+    JSONP_FILTER_T filters[JT_EXPECTS_MAX];
+    JT_RESPONSE_T *response;
+    JT_EXPECT_T *expect;
+    volatile int found = 0;
+    double start;
+    int i;
+    int j;
+
+    printf("parser context %d bytes\n", (int)sizeof(JSON_PARSER_CONTEXT_T));
+
+    for (i=0; i<jt_num_responses; i++)
+    {
+        response = &jt_responses[i];
+        for (j=0; j<response->num_expects; j++)
+        {
+            expect = &jt_expects[response->first_expect + j];
+            filters[j] = (JSONP_FILTER_T){expect->path, values[j], sizeof(values[j]), expect->kind == JT_STRIPPED, false, 0};
+        }
+
+        start = jt_now_us();
+        for (j=0; j<loops; j++)
+        {
+            found += jt_parse(response->json, strlen(response->json), JT_TEXT_MAX, filters, response->num_expects, NULL, NULL);
+        }
+        printf("%-50.50s %5d bytes %8.2f us\n", response->label, (int)strlen(response->json), (jt_now_us() - start)/loops);
+    }
+}
+
+/*!
+ * \brief Parse a document in pieces
+ *
+ * \param[in]  json         document, need not be nul terminated
+ * \param[in]  length       length of json
+ * \param[in]  piece        size of each piece
+ * \param[in]  filters      values wanted
+ * \param[in]  num_filters  number of filters
+ * \param[in]  callback     called for every value, may be NULL
+ * \param[in]  arg          passed to the callback
+ *
+ * \return 0 if a complete document was parsed, -1 otherwise
+ */
+static int jt_parse(const char *json, int length, int piece, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *arg)
+{
+    JSON_PARSER_CONTEXT_T context;
+    int offset;
+    int size;
+
+    jsonp_begin(&context, filters, num_filters, callback, arg);
+
+    for (offset=0; offset<length; offset+=size)
+    {
+        size = (length - offset < piece) ? length - offset : piece;
+        if (jsonp_parse_buffer(&context, json + offset, size))
+        {
+            return(-1);
+        }
+    }
+
+    return(jsonp_end(&context));
+}
+
+/*!
+ * \brief Generate a random value and the callback output expected for it
+ *
+ * \param[in,out]  document     json text
+ * \param[in,out]  values       "path = value" line for each scalar
+ * \param[in]      path         path of the value
+ * \param[in]      depth        objects and arrays it is inside
+ *
+ * \return nothing
+ */
+static void jt_generate(JT_TEXT_T *document, JT_TEXT_T *values, const char *path, int depth)
+{
+    static const char *literals[] = {"true", "false", "null", "0", "-7", "3.25", "1e3", "-1.5E-7", "12345678901234567890", "-0.0"};
+    char child[JSONP_PATH_MAX];
+    JT_TEXT_T text;
+    uint32_t choice = jt_random()%10;
+    int members;
+    int i;
+
+    if ((depth < JT_GENERATED_DEPTH) && (choice < 4))
+    {
+        jt_append(document, (choice < 2) ? "{" : "[");
+        members = jt_random()%5;
+        for (i=0; i<members; i++)
+        {
+            if (i)
+            {
+                jt_append(document, ",");
+            }
+            jt_space(document);
+            if (choice < 2)
+            {
+                jt_start(&text, child, sizeof(child));
+                jt_append(&text, "%s.", path);
+                jt_generate_string(&text, true);
+                jt_append(document, "%s", child + strlen(path) + 1);
+                jt_space(document);
+                jt_append(document, ":");
+                jt_space(document);
+            }
+            else
+            {
+                snprintf(child, sizeof(child), "%s.index%d", path, i);
+            }
+            jt_generate(document, values, child, depth + 1);
+            jt_space(document);
+        }
+        jt_append(document, (choice < 2) ? "}" : "]");
+    }
+    else
+    {
+        jt_start(&text, child, sizeof(child));
+        if (choice < 7)
+        {
+            jt_generate_string(&text, false);
+        }
+        else
+        {
+            jt_append(&text, "%s", literals[jt_random()%(sizeof(literals)/sizeof(literals[0]))]);
+        }
+        jt_append(document, "%s", child);
+        jt_append(values, "%s = %s\n", path, child);
+
+        // a number at the end of the document needs something after it to end
+        if (!depth)
+        {
+            jt_append(document, " ");
+        }
+    }
+}
+
+/*!
+ * \brief Generate a quoted string of up to eight characters or escapes
+ *
+ * \param[in,out]  text     receives the string
+ * \param[in]      key      a key, shorter so that paths stay inside JSONP_PATH_MAX
+ *
+ * \return nothing
+ */
+static void jt_generate_string(JT_TEXT_T *text, bool key)
+{
+    static const char *pieces[] = {"a", "b", "Z", "0", "9", " ", "_", ":", "-", ".", "/", "{", "]", ",",
+                                   "\\\"", "\\\\", "\\n", "\\/", "\\u00e9"};
+    int length = jt_random()%(key ? 5 : 9);
+    int i;
+
+    jt_append(text, "\"");
+    for (i=0; i<length; i++)
+    {
+        jt_append(text, "%s", pieces[jt_random()%(sizeof(pieces)/sizeof(pieces[0]))]);
+    }
+    jt_append(text, "\"");
+}
+
+/*!
+ * \brief Append random json whitespace, usually none
+ *
+ * \param[in,out]  document     json text
+ *
+ * \return nothing
+ */
+static void jt_space(JT_TEXT_T *document)
+{
+    static const char *spaces[] = {" ", "\n", "\t", "\r\n  "};
+    uint32_t choice = jt_random()%8;
+
+    if (choice < 4)
+    {
+        jt_append(document, "%s", spaces[choice]);
+    }
+}
+
+/*!
+ * \brief Callback adding a "path = value" line for each value
+ *
+ * \param[in]  arg      JT_TEXT_T
+ * \param[in]  path     path of the value
+ * \param[in]  value    value text
+ *
+ * \return nothing
+ */
+static void jt_record(void *arg, const char *path, const char *value)
+{
+    jt_append((JT_TEXT_T *)arg, "%s = %s\n", path, value);
+}
+
+/*!
+ * \brief Callback counting paths and values over their limits
+ *
+ * \param[in]  arg      not used
+ * \param[in]  path     path of the value
+ * \param[in]  value    value text
+ *
+ * \return nothing
+ */
+static void jt_limits(void *arg, const char *path, const char *value)
+{
+    (void)arg;
+
+    if ((strnlen(path, JSONP_PATH_MAX) >= JSONP_PATH_MAX) || (strnlen(value, JSONP_VALUE_MAX) >= JSONP_VALUE_MAX))
+    {
+        jt_over_limit++;
+    }
+}
+
+/*!
+ * \brief Start an empty text
+ *
+ * \param[out]  text       text
+ * \param[in]   buffer     where the text is kept
+ * \param[in]   size       size of buffer
+ *
+ * \return nothing
+ */
+static void jt_start(JT_TEXT_T *text, char *buffer, int size)
+{
+    text->text = buffer;
+    text->length = 0;
+    text->size = size;
+    text->overflow = false;
+    buffer[0] = 0;
+}
+
+/*!
+ * \brief Append formatted text, marking the text as overflowed if it does not fit
+ *
+ * \param[in,out]  text     text to append to, nul terminated
+ * \param[in]      format   printf format
+ *
+ * \return nothing
+ */
+static void jt_append(JT_TEXT_T *text, const char *format, ...)
+{
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(text->text + text->length, text->size - text->length, format, args);
+    va_end(args);
+
+    if (text->length + length >= text->size)
+    {
+        text->overflow = true;
+        text->length = text->size - 1;
+    }
+    else
+    {
+        text->length += length;
+    }
+}
+
+/*!
+ * \brief Small repeatable random number generator
+ *
+ * \return next number
+ */
+static uint32_t jt_random(void)
+{
+    jt_seed ^= jt_seed << 13;
+    jt_seed ^= jt_seed >> 17;
+    jt_seed ^= jt_seed << 5;
+
+    return(jt_seed);
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double jt_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
@@ -0,0 +1,359 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "message_codec.h"
+
+/*
+ * Stand-in for message_task on a linux host
+ *
+ * Listens on a range of consecutive ports so that each port looks like a separate device to anemometer_cli, and
+ * answers requests using the same encoders as the firmware (message_codec.c).  Optional random loss allows the
+ * client timeout and loss accounting to be exercised without hardware, and an optional delay gives the client a
+ * known latency to measure.
+ */
+
+#define LS_MAX_PORTS        (1024)
+#define LS_EPOLL_EVENTS     (64)
+#define LS_PENDING_MAX      (8192)          // delayed answers
+
+// an answer waiting out the delay, encoded when it is sent so the transmit timestamp is right
+typedef struct
+{
+    int socket_fd;
+    struct sockaddr_in destination;
+    MESSAGE_FIELDS_T sFields;
+    uint64_t receive_us;
+    uint64_t due_us;
+} LS_PENDING_T;
+
+// prototypes
+static void ls_usage(const char *program);
+static uint64_t ls_realtime_us(void);
+static void ls_answer(int socket_fd);
+static void ls_send(int socket_fd, struct sockaddr_in *destination, MESSAGE_FIELDS_T *psFields, uint64_t receive_us);
+static void ls_send_due(void);
+static int ls_wait_ms(void);
+static void ls_signal(int signal_number);
+
+// static variables
+static volatile bool ls_running = true;
+static int ls_loss_percent = 0;
+static int ls_wind_speed = 42;
+static uint32_t ls_requests = 0;
+static uint32_t ls_dropped = 0;
+static int ls_delay_us = 0;
+static LS_PENDING_T ls_pending[LS_PENDING_MAX];
+static int ls_pending_head = 0;             // next to send
+static int ls_pending_count = 0;
+
+int main(int argc, char *argv[])
+{
+    struct epoll_event event[LS_EPOLL_EVENTS];
+    struct epoll_event registration;
+    struct sockaddr_in local;
+    const char *address = "127.0.0.1";
+    int base_port = MESSAGE_PORT;
+    int port_count = 1;
+    int epoll_fd;
+    int socket_fd;
+    int ready;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "a:p:n:l:w:D:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'a':
+                address = optarg;
+                break;
+            case 'p':
+                base_port = atoi(optarg);
+                break;
+            case 'n':
+                port_count = atoi(optarg);
+                break;
+            case 'l':
+                ls_loss_percent = atoi(optarg);
+                break;
+            case 'w':
+                ls_wind_speed = atoi(optarg);
+                break;
+            case 'D':
+                ls_delay_us = atoi(optarg)*1000;
+                break;
+            case 'h':
+            default:
+                ls_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((port_count < 1) || (port_count > LS_MAX_PORTS) || (ls_loss_percent < 0) || (ls_loss_percent > 100) || (ls_delay_us < 0))
+    {
+        ls_usage(argv[0]);
+        return(1);
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        return(1);
+    }
+
+    for (i = 0; i < port_count; i++)
+    {
+        socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (socket_fd < 0)
+        {
+            perror("socket");
+            return(1);
+        }
+
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons(base_port + i);
+        if (inet_pton(AF_INET, address, &(local.sin_addr)) != 1)
+        {
+            fprintf(stderr, "invalid address %s\n", address);
+            return(1);
+        }
+
+        if (bind(socket_fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+        {
+            fprintf(stderr, "cannot bind %s:%d: %s\n", address, base_port + i, strerror(errno));
+            return(1);
+        }
+
+        memset(&registration, 0, sizeof(registration));
+        registration.events = EPOLLIN;
+        registration.data.fd = socket_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_fd, &registration);
+    }
+
+    srand((unsigned)ls_realtime_us());
+    signal(SIGINT, ls_signal);
+    signal(SIGTERM, ls_signal);
+
+    printf("answering on %s ports %d to %d\n", address, base_port, base_port + port_count - 1);
+
+    while (ls_running)
+    {
+        ready = epoll_wait(epoll_fd, event, LS_EPOLL_EVENTS, ls_wait_ms());
+
+        for (i = 0; i < ready; i++)
+        {
+            ls_answer(event[i].data.fd);
+        }
+
+        ls_send_due();
+    }
+
+    printf("%u requests, %u dropped\n", ls_requests, ls_dropped);
+
+    return(0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void ls_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -a address  address to listen on (default 127.0.0.1)\n"
+            "  -p port     first port (default %d)\n"
+            "  -n count    number of consecutive ports, one simulated device each (default 1)\n"
+            "  -l percent  randomly drop this percentage of requests (default 0)\n"
+            "  -w speed    wind speed to report (default 42)\n"
+            "  -D ms       delay every answer by this long (default 0)\n",
+            program, MESSAGE_PORT);
+}
+
+/*!
+ * \brief Get wall clock in the same units as the device shared timebase
+ *
+ * \return microseconds since unix epoch
+ */
+static uint64_t ls_realtime_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return((uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec/1000);
+}
+
+/*!
+ * \brief Drain a socket answering every request the way message_task does
+ *
+ * \param[in]  socket_fd   socket with pending datagrams
+ *
+ * \return nothing
+ */
+static void ls_answer(int socket_fd)
+{
+    uint8_t request[MESSAGE_MAX_LENGTH];
+    MESSAGE_FIELDS_T sFields;
+    struct sockaddr_in source;
+    socklen_t source_length;
+    LS_PENDING_T *psPending;
+    uint64_t receive_us;
+    ssize_t received;
+
+    for (;;)
+    {
+        source_length = sizeof(source);
+        received = recvfrom(socket_fd, request, sizeof(request), MSG_DONTWAIT, (struct sockaddr *)&source, &source_length);
+        receive_us = ls_realtime_us();
+
+        if (received < 0)
+        {
+            break;
+        }
+
+        if (message_decode(request, (int)received, &sFields))
+        {
+            continue;
+        }
+
+        ls_requests++;
+
+        if (ls_loss_percent && ((rand() % 100) < ls_loss_percent))
+        {
+            ls_dropped++;
+            continue;
+        }
+
+        if (!ls_delay_us)
+        {
+            ls_send(socket_fd, &source, &sFields, receive_us);
+        }
+        else if (ls_pending_count < LS_PENDING_MAX)
+        {
+            psPending = &ls_pending[(ls_pending_head + ls_pending_count++) % LS_PENDING_MAX];
+            psPending->socket_fd = socket_fd;
+            psPending->destination = source;
+            psPending->sFields = sFields;
+            psPending->receive_us = receive_us;
+            psPending->due_us = receive_us + ls_delay_us;
+        }
+        else
+        {
+            ls_dropped++;
+        }
+    }
+}
+
+/*!
+ * \brief Answer a request the way message_task does
+ *
+ * \param[in]  socket_fd     socket the request arrived on
+ * \param[in]  destination   requestor
+ * \param[in]  psFields      decoded request
+ * \param[in]  receive_us    when the request arrived
+ *
+ * \return nothing
+ */
+static void ls_send(int socket_fd, struct sockaddr_in *destination, MESSAGE_FIELDS_T *psFields, uint64_t receive_us)
+{
+    uint8_t confirm[MESSAGE_MAX_LENGTH];
+    int length = -1;
+
+    switch(psFields->sHeader.message)
+    {
+        case LED_STRIP_RQST:
+            length = message_encode_led_strip_confirm((tsLED_STRIP_CNFM *)confirm, psFields->sHeader.transaction, psFields->sHeader.sequence, 0);
+            break;
+        case WIND_SPEED_RQST:
+            length = message_encode_wind_speed_confirm((tsWIND_SPEED_CNFM *)confirm, psFields->sHeader.transaction, psFields->sHeader.sequence, 0, ls_wind_speed, receive_us);
+            break;
+        case TIME_SYNC_RQST:
+            length = message_encode_time_sync_confirm((tsTIME_SYNC_CNFM *)confirm, psFields->sHeader.transaction, psFields->sHeader.sequence, 0,
+                                                      psFields->originate_us, receive_us, ls_realtime_us());
+            break;
+        default:
+            break;
+    }
+
+    if (length > 0)
+    {
+        sendto(socket_fd, confirm, length, 0, (struct sockaddr *)destination, sizeof(*destination));
+    }
+}
+
+/*!
+ * \brief Send every delayed answer that is due
+ *
+ * \return nothing
+ */
+static void ls_send_due(void)
+{
+    LS_PENDING_T *psPending;
+    uint64_t now_us = ls_realtime_us();
+
+    while (ls_pending_count && (ls_pending[ls_pending_head].due_us <= now_us))
+    {
+        psPending = &ls_pending[ls_pending_head];
+        ls_send(psPending->socket_fd, &(psPending->destination), &(psPending->sFields), psPending->receive_us);
+        ls_pending_head = (ls_pending_head + 1) % LS_PENDING_MAX;
+        ls_pending_count--;
+    }
+}
+
+/*!
+ * \brief Time epoll may wait before the next delayed answer is due
+ *
+ * \return milliseconds
+ */
+static int ls_wait_ms(void)
+{
+    uint64_t now_us;
+    uint64_t due_us;
+
+    if (!ls_pending_count)
+    {
+        return(1000);
+    }
+
+    now_us = ls_realtime_us();
+    due_us = ls_pending[ls_pending_head].due_us;
+
+    return(due_us <= now_us ? 0 : (int)((due_us - now_us + 999)/1000));
+}
+
+/*!
+ * \brief Stop cleanly on ctrl-c
+ *
+ * \return nothing
+ */
+static void ls_signal(int signal_number)
+{
+    (void)signal_number;
+
+    ls_running = false;
+}
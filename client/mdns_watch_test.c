@@ -0,0 +1,731 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+
+#include "lwip/udp.h"
+#include "mdns_watch.h"
+
+/*
+ * mDNS listener test
+ *
+ * Links mdns_watch.c unchanged against the udp pcb stand-in in client/shim, watching for the services shelly.c
+ * watches, and delivers crafted responses to it: gen2 and gen1 announcements, compressed names, records in the
+ * additional section, queries, and malformed packets with compression loops, pointers past the end, reserved label
+ * types, truncated records, overlong names and record lengths, and announcements longer than the receive buffer.
+ * Then copies of them are changed at random, a few bytes each or cut short, and delivered again.
+ *
+ * Checks that:
+ *
+ *   - starting binds port 5353 and joins 224.0.0.251, stopping leaves the group and removes the pcb
+ *   - a query asks for every watched service by PTR, sent to 224.0.0.251 port 5353
+ *   - each crafted packet reports its source, once, exactly when it names a watched service
+ *   - a mutated packet is only reported if it still contains "shelly", and always with its own source
+ *   - every pbuf is freed
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#define MW_SOURCE               (0xc0a80100u)       // 192.168.1.0/24, host order, each packet comes from its own host
+#define MW_PACKET_MAX           (1400)
+#define MW_MUTATIONS_MAX        (8)                 // changes made to each mutated packet
+#define MW_CASES                (25)
+
+typedef struct
+{
+    const char *name;
+    bool reported;                                  // names a watched service within the receive buffer
+    int length;
+    u8_t data[MW_PACKET_MAX];
+} MW_PACKET_T;
+
+// prototypes
+static void mw_usage(const char *program);
+static bool mw_start_stop(void);
+static bool mw_query(void);
+static bool mw_crafted(void);
+static bool mw_mutated(int mutations);
+static void mw_build(int index, MW_PACKET_T *packet);
+static void mw_header(MW_PACKET_T *packet, u16_t flags, u16_t questions, u16_t answers, u16_t authorities, u16_t additionals);
+static int mw_name(MW_PACKET_T *packet, const char *dotted, int pointer);
+static int mw_record(MW_PACKET_T *packet, u16_t type, u16_t rdlen);
+static void mw_rdlen(MW_PACKET_T *packet, int at);
+static void mw_put(MW_PACKET_T *packet, const void *data, int length);
+static void mw_u16(MW_PACKET_T *packet, u16_t value);
+static int mw_deliver(const MW_PACKET_T *packet, u32_t source, bool chained);
+static bool mw_contains_shelly(const MW_PACKET_T *packet);
+static err_t mw_output(struct pbuf *p, const ip_addr_t *destination, u16_t port);
+static void mw_found(void *arg, u32_t ip);
+
+// static variables
+static const MDNS_WATCH_T mw_watch[] =
+{
+    {"_shelly._tcp", NULL},
+    {"_http._tcp", "shelly"},
+};
+static u8_t mw_sent[512];
+static int mw_sent_length = 0;
+static u32_t mw_sent_to = 0;                        // host order
+static u16_t mw_sent_port = 0;
+static u32_t mw_found_ip[4];
+static int mw_found_count = 0;
+
+int main(int argc, char *argv[])
+{
+    bool passed = true;
+    int mutations = 20000;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:s:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                mutations = atoi(optarg);
+                break;
+            case 's':
+                srand(atoi(optarg));
+                break;
+            default:
+                mw_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    shim_udp_output = mw_output;
+
+    passed &= mw_start_stop();
+
+    if (mdns_watch_start(mw_watch, LWIP_ARRAYSIZE(mw_watch), mw_found, NULL) != 0)
+    {
+        printf("mdns_watch_start() failed\n");
+        return(1);
+    }
+
+    passed &= mw_query();
+    passed &= mw_crafted();
+    passed &= mw_mutated(mutations);
+
+    mdns_watch_stop();
+
+    printf("%ld pbuf bytes not freed\n", shim_pbuf_bytes);
+    passed &= (shim_pbuf_bytes == 0);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void mw_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-n mutated packets] [-s seed]\n", program);
+}
+
+/*!
+ * \brief Start and stop the listener and check the pcb and group it uses
+ *
+ * \return true if every check passed
+ */
+static bool mw_start_stop(void)
+{
+    bool passed;
+    ip4_addr_t group;
+
+    IP4_ADDR(&group, 224, 0, 0, 251);
+
+    passed = (mdns_watch_start(mw_watch, LWIP_ARRAYSIZE(mw_watch), mw_found, NULL) == 0) &&
+             (shim_udp_pcbs == 1) && (shim_igmp_groups == 1) && (shim_igmp_group.addr == group.addr);
+
+    mdns_watch_stop();
+
+    passed = passed && (shim_udp_pcbs == 0) && (shim_igmp_groups == 0) && (mdns_watch_query() == -1);
+
+    printf("start and stop: %s\n", passed ? "ok" : "wrong pcb or group");
+
+    return(passed);
+}
+
+/*!
+ * \brief Send a query and check it against the one expected
+ *
+ * \return true if every check passed
+ */
+static bool mw_query(void)
+{
+    static const u8_t expected[] =
+    {
+        0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0,
+        7, '_', 's', 'h', 'e', 'l', 'l', 'y', 4, '_', 't', 'c', 'p', 5, 'l', 'o', 'c', 'a', 'l', 0, 0, 12, 0, 1,
+        5, '_', 'h', 't', 't', 'p', 4, '_', 't', 'c', 'p', 5, 'l', 'o', 'c', 'a', 'l', 0, 0, 12, 0, 1,
+    };
+    bool passed;
+
+    mw_sent_length = 0;
+
+    passed = (mdns_watch_query() == 0) && (mw_sent_to == 0xe00000fbu) && (mw_sent_port == MDNS_WATCH_PORT) &&
+             (mw_sent_length == sizeof(expected)) && !memcmp(mw_sent, expected, sizeof(expected));
+
+    printf("query: %s\n", passed ? "ok" : "wrong packet");
+
+    return(passed);
+}
+
+/*!
+ * \brief Deliver each crafted packet, whole and as a pbuf chain, and check which are reported
+ *
+ * \return true if every check passed
+ */
+static bool mw_crafted(void)
+{
+    MW_PACKET_T packet;
+    bool passed = true;
+    int reports;
+    int chained;
+    int i;
+
+    for (i = 0; i < MW_CASES; i++)
+    {
+        mw_build(i, &packet);
+
+        for (chained = 0; chained < 2; chained++)
+        {
+            reports = mw_deliver(&packet, MW_SOURCE | (i + 10), chained);
+
+            if ((reports != packet.reported) || (reports && (mw_found_ip[0] != (MW_SOURCE | (i + 10)))))
+            {
+                printf("%s%s: reported %d times from 0x%08x, expected %d\n", packet.name, chained ? " in a chain" : "",
+                       reports, reports ? mw_found_ip[0] : 0, packet.reported);
+                passed = false;
+            }
+        }
+    }
+
+    printf("%d crafted packets: %s\n", MW_CASES, passed ? "ok" : "FAILED");
+
+    return(passed);
+}
+
+/*!
+ * \brief Deliver mutated copies of the crafted packets and check nothing is reported that should not be
+ *
+ * \param[in]  mutations    packets to deliver
+ *
+ * \return true if every check passed
+ */
+static bool mw_mutated(int mutations)
+{
+    MW_PACKET_T packet;
+    u32_t source;
+    int reported = 0;
+    int wrong = 0;
+    int reports;
+    int changes;
+    int at;
+    int i;
+
+    for (i = 0; i < mutations; i++)
+    {
+        mw_build(rand() % MW_CASES, &packet);
+
+        for (changes = 1 + rand() % MW_MUTATIONS_MAX; changes > 0; changes--)
+        {
+            at = rand() % packet.length;
+            switch (rand() % 4)
+            {
+                case 0:
+                    packet.data[at] = (u8_t)rand();
+                    break;
+                case 1:
+                    packet.data[at] ^= 1 << (rand() % 8);
+                    break;
+                case 2:
+                    // a compression pointer to anywhere
+                    packet.data[at] = 0xc0 | (rand() & 0x3f);
+                    break;
+                default:
+                    packet.length = at + 1;
+                    break;
+            }
+        }
+
+        source = MW_SOURCE | (rand() & 0xff);
+        reports = mw_deliver(&packet, source, rand() & 1);
+        reported += (reports > 0);
+
+        if ((reports > 1) || (reports && ((mw_found_ip[0] != source) || !mw_contains_shelly(&packet))))
+        {
+            if (wrong++ < 10)
+            {
+                printf("mutated %s: reported %d times from 0x%08x\n", packet.name, reports, mw_found_ip[0]);
+            }
+        }
+    }
+
+    printf("%d mutated packets, %d reported, %d wrongly: %s\n", mutations, reported, wrong, wrong ? "FAILED" : "ok");
+
+    return(wrong == 0);
+}
+
+/*!
+ * \brief Build one of the crafted packets
+ *
+ * \param[in]  index    0 to MW_CASES - 1
+ * \param[out] packet   packet
+ *
+ * \return nothing
+ */
+static void mw_build(int index, MW_PACKET_T *packet)
+{
+    static const u8_t loop[] = {0xc0, 12};
+    static const u8_t past_end[] = {0xc3, 0xff};
+    static const u8_t reserved_40[] = {0x47, '_', 's', 'h', 'e', 'l', 'l', 'y', 0};
+    static const u8_t reserved_80[] = {0x87, '_', 's', 'h', 'e', 'l', 'l', 'y', 0};
+    static const u8_t long_label[] = {40, '_', 's', 'h', 'e', 'l', 'l', 'y'};
+    char overlong[MDNS_WATCH_NAME_MAX + 64];
+    int service;
+    int rdlen;
+    int i;
+
+    memset(packet, 0, sizeof(*packet));
+
+    switch (index)
+    {
+        case 0:
+            packet->name = "gen2 ptr announcement";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            service = mw_name(packet, "_shelly._tcp.local", -1);
+            rdlen = mw_record(packet, 12, 0);
+            mw_name(packet, "shellyplus1-a8032ab12345", service);
+            mw_rdlen(packet, rdlen);
+            break;
+        case 1:
+            packet->name = "gen2 srv only, upper case";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "ShellyPlus1-A8032AB12345._SHELLY._TCP.local", -1);
+            mw_record(packet, 33, 8);
+            mw_put(packet, "\x00\x00\x00\x00\x00\x50\x00\x00", 8);
+            break;
+        case 2:
+            packet->name = "gen1 http ptr, compressed target";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            service = mw_name(packet, "_http._tcp.local", -1);
+            rdlen = mw_record(packet, 12, 0);
+            mw_name(packet, "shelly1-0123AB", service);
+            mw_rdlen(packet, rdlen);
+            break;
+        case 3:
+            packet->name = "gen1 http ptr, upper case instance";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            service = mw_name(packet, "_http._tcp.local", -1);
+            rdlen = mw_record(packet, 12, 0);
+            mw_name(packet, "SHELLYHT-6B1A2C", service);
+            mw_rdlen(packet, rdlen);
+            break;
+        case 4:
+            packet->name = "http ptr to a printer";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            service = mw_name(packet, "_http._tcp.local", -1);
+            rdlen = mw_record(packet, 12, 0);
+            mw_name(packet, "printer", service);
+            mw_rdlen(packet, rdlen);
+            break;
+        case 5:
+            packet->name = "http service name alone";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "_http._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 6:
+            packet->name = "query for shelly";
+            mw_header(packet, 0x0000, 1, 0, 0, 0);
+            mw_name(packet, "_shelly._tcp.local", -1);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            break;
+        case 7:
+            packet->name = "question repeated in the response";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 1, 1, 0, 0);
+            service = mw_name(packet, "_shelly._tcp.local", -1);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            mw_name(packet, "", service);
+            rdlen = mw_record(packet, 12, 0);
+            mw_name(packet, "shellypro4pm-c8f09e000001", service);
+            mw_rdlen(packet, rdlen);
+            break;
+        case 8:
+            packet->name = "question only, no records";
+            mw_header(packet, 0x8400, 1, 0, 0, 0);
+            mw_name(packet, "_shelly._tcp.local", -1);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            break;
+        case 9:
+            packet->name = "srv in the additional section";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 1, 0, 1);
+            mw_name(packet, "printer._ipp._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            mw_name(packet, "shelly1pm-84cca8ad0000._http._tcp.local", -1);
+            mw_record(packet, 33, 8);
+            mw_put(packet, "\x00\x00\x00\x00\x00\x50\x00\x00", 8);
+            break;
+        case 10:
+            packet->name = "compression loop";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_put(packet, loop, sizeof(loop));
+            mw_record(packet, 12, 0);
+            break;
+        case 11:
+            packet->name = "compression loop in the ptr target";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "_http._tcp.local", -1);
+            rdlen = mw_record(packet, 12, 0);
+            mw_put(packet, "\x06shelly", 7);
+            mw_u16(packet, 0xc000 | (packet->length - 7));
+            mw_rdlen(packet, rdlen);
+            break;
+        case 12:
+            packet->name = "pointer past the end";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_put(packet, past_end, sizeof(past_end));
+            mw_record(packet, 12, 0);
+            break;
+        case 13:
+            packet->name = "0x40 label";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_put(packet, reserved_40, sizeof(reserved_40));
+            mw_record(packet, 12, 0);
+            break;
+        case 14:
+            packet->name = "0x80 label";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_put(packet, reserved_80, sizeof(reserved_80));
+            mw_record(packet, 12, 0);
+            break;
+        case 15:
+            packet->name = "label past the end";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_put(packet, long_label, sizeof(long_label));
+            break;
+        case 16:
+            packet->name = "record header cut short";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local", -1);
+            mw_put(packet, "\x00\x21\x80\x01", 4);
+            break;
+        case 17:
+            packet->name = "header cut short";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            packet->length = 11;
+            break;
+        case 18:
+            // longer names are truncated to MDNS_WATCH_NAME_MAX, losing the service
+            packet->name = "overlong instance name";
+            for (i = 0; i < (int)sizeof(overlong) - 1; i++)
+            {
+                overlong[i] = ((i % 32) == 31) ? '.' : 'a';
+            }
+            overlong[sizeof(overlong) - 1] = 0;
+            mw_header(packet, 0x8400, 1, 1, 0, 0);
+            service = mw_name(packet, "_shelly._tcp.local", -1);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            mw_name(packet, overlong, service);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 19:
+            packet->name = "huge record length hides the next record";
+            mw_header(packet, 0x8400, 0, 2, 0, 0);
+            mw_name(packet, "printer._ipp._tcp.local", -1);
+            mw_record(packet, 16, 0xffff);
+            mw_put(packet, "", 1);
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 20:
+            packet->name = "shelly without a dot";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "x_shelly._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 21:
+            packet->name = "shelly service under another domain";
+            mw_header(packet, 0x8400, 0, 1, 0, 0);
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local.example", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 22:
+            packet->name = "shelly record past the receive buffer";
+            mw_header(packet, 0x8400, 0, 2, 0, 0);
+            mw_name(packet, "printer._ipp._tcp.local", -1);
+            mw_record(packet, 16, MDNS_WATCH_BUFFER_SIZE);
+            packet->length += MDNS_WATCH_BUFFER_SIZE;
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        case 23:
+            packet->name = "shelly record after a name of two pointers";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 2, 2, 0, 0);
+            service = mw_name(packet, "_tcp.local", -1);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            service = mw_name(packet, "_ipp", service);
+            mw_put(packet, "\x00\x0c\x00\x01", 4);
+            mw_name(packet, "printer", service);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            break;
+        default:
+            packet->name = "shelly record before a long tail";
+            packet->reported = true;
+            mw_header(packet, 0x8400, 0, 2, 0, 0);
+            mw_name(packet, "shellyplus1-a8032ab12345._shelly._tcp.local", -1);
+            mw_record(packet, 16, 1);
+            mw_put(packet, "", 1);
+            mw_name(packet, "printer._ipp._tcp.local", -1);
+            mw_record(packet, 16, MDNS_WATCH_BUFFER_SIZE);
+            packet->length += MDNS_WATCH_BUFFER_SIZE;
+            break;
+    }
+}
+
+/*!
+ * \brief Write the dns header
+ *
+ * \param[out] packet       packet, written from the start
+ * \param[in]  flags        e.g. 0x8400 for an authoritative response
+ * \param[in]  questions    question count
+ * \param[in]  answers      answer count
+ * \param[in]  authorities  authority count
+ * \param[in]  additionals  additional count
+ *
+ * \return nothing
+ */
+static void mw_header(MW_PACKET_T *packet, u16_t flags, u16_t questions, u16_t answers, u16_t authorities, u16_t additionals)
+{
+    packet->length = 0;
+    mw_u16(packet, 0);
+    mw_u16(packet, flags);
+    mw_u16(packet, questions);
+    mw_u16(packet, answers);
+    mw_u16(packet, authorities);
+    mw_u16(packet, additionals);
+}
+
+/*!
+ * \brief Append a name as labels
+ *
+ * \param[out] packet   packet
+ * \param[in]  dotted   labels separated by dots, may be empty
+ * \param[in]  pointer  offset of a name to continue with, or -1 to end the name here
+ *
+ * \return offset of the name
+ */
+static int mw_name(MW_PACKET_T *packet, const char *dotted, int pointer)
+{
+    const char *dot;
+    int start = packet->length;
+    int length;
+
+    while (*dotted)
+    {
+        dot = strchr(dotted, '.');
+        length = dot ? dot - dotted : (int)strlen(dotted);
+        mw_put(packet, (u8_t []){length}, 1);
+        mw_put(packet, dotted, length);
+        dotted += length + (dot ? 1 : 0);
+    }
+
+    if (pointer >= 0)
+    {
+        mw_u16(packet, 0xc000 | pointer);
+    }
+    else
+    {
+        mw_put(packet, "", 1);
+    }
+
+    return(start);
+}
+
+/*!
+ * \brief Append the fixed part of a record following its name, class IN with the cache flush bit
+ *
+ * \param[out] packet   packet
+ * \param[in]  type     e.g. 12 for PTR
+ * \param[in]  rdlen    length of the data that follows
+ *
+ * \return offset of the data length, for mw_rdlen()
+ */
+static int mw_record(MW_PACKET_T *packet, u16_t type, u16_t rdlen)
+{
+    mw_u16(packet, type);
+    mw_u16(packet, 0x8001);
+    mw_u16(packet, 0);
+    mw_u16(packet, 120);
+    mw_u16(packet, rdlen);
+
+    return(packet->length - 2);
+}
+
+/*!
+ * \brief Set the data length of the last record to the bytes appended after it
+ *
+ * \param[out] packet   packet
+ * \param[in]  at       offset returned by mw_record()
+ *
+ * \return nothing
+ */
+static void mw_rdlen(MW_PACKET_T *packet, int at)
+{
+    packet->data[at] = (packet->length - at - 2) >> 8;
+    packet->data[at + 1] = (packet->length - at - 2) & 0xff;
+}
+
+/*!
+ * \brief Append bytes
+ *
+ * \param[out] packet   packet
+ * \param[in]  data     bytes
+ * \param[in]  length   number of bytes
+ *
+ * \return nothing
+ */
+static void mw_put(MW_PACKET_T *packet, const void *data, int length)
+{
+    if (packet->length + length <= MW_PACKET_MAX)
+    {
+        memcpy(&packet->data[packet->length], data, length);
+        packet->length += length;
+    }
+}
+
+/*!
+ * \brief Append a 16 bit value in network order
+ *
+ * \param[out] packet   packet
+ * \param[in]  value    value
+ *
+ * \return nothing
+ */
+static void mw_u16(MW_PACKET_T *packet, u16_t value)
+{
+    mw_put(packet, (u8_t []){value >> 8, value & 0xff}, 2);
+}
+
+/*!
+ * \brief Deliver a packet to port 5353 as the tcpip thread would
+ *
+ * \param[in]  packet   packet
+ * \param[in]  source   address it comes from, host order
+ * \param[in]  chained  split it into a chain of two pbufs
+ *
+ * \return number of times the source was reported
+ */
+static int mw_deliver(const MW_PACKET_T *packet, u32_t source, bool chained)
+{
+    struct pbuf *p;
+    ip_addr_t from;
+    int first = chained ? packet->length / 2 : packet->length;
+
+    from.addr = htonl(source);
+    mw_found_count = 0;
+
+    p = pbuf_alloc(PBUF_TRANSPORT, first, PBUF_RAM);
+    pbuf_take(p, packet->data, first);
+    if (first < packet->length)
+    {
+        p->next = pbuf_alloc(PBUF_TRANSPORT, packet->length - first, PBUF_RAM);
+        pbuf_take(p->next, &packet->data[first], packet->length - first);
+        p->tot_len = packet->length;
+    }
+
+    shim_udp_input(p, &from, MDNS_WATCH_PORT, MDNS_WATCH_PORT);
+
+    return(mw_found_count);
+}
+
+/*!
+ * \brief Check whether the part of a packet that fits the receive buffer contains "shelly" in any case
+ *
+ * \param[in]  packet   packet
+ *
+ * \return true if it does
+ */
+static bool mw_contains_shelly(const MW_PACKET_T *packet)
+{
+    int length = (packet->length < MDNS_WATCH_BUFFER_SIZE) ? packet->length : MDNS_WATCH_BUFFER_SIZE;
+    int i;
+
+    for (i = 0; i + 6 <= length; i++)
+    {
+        if (!strncasecmp((const char *)&packet->data[i], "shelly", 6))
+        {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+/*!
+ * \brief Keep what the listener sends, in place of the network
+ *
+ * \param[in]  p            payload, still owned by the caller
+ * \param[in]  destination  destination
+ * \param[in]  port         destination port
+ *
+ * \return ERR_OK
+ */
+static err_t mw_output(struct pbuf *p, const ip_addr_t *destination, u16_t port)
+{
+    mw_sent_length = pbuf_copy_partial(p, mw_sent, sizeof(mw_sent), 0);
+    mw_sent_to = ntohl(destination->addr);
+    mw_sent_port = port;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Record each address the listener reports
+ *
+ * \param[in]  arg  unused
+ * \param[in]  ip   host order
+ *
+ * \return nothing
+ */
+static void mw_found(__unused void *arg, u32_t ip)
+{
+    if (mw_found_count < (int)LWIP_ARRAYSIZE(mw_found_ip))
+    {
+        mw_found_ip[mw_found_count] = ip;
+    }
+    mw_found_count++;
+}
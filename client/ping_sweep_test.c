@@ -0,0 +1,482 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "lwip/raw.h"
+#include "lwip/icmp.h"
+#include "usurper_ping.h"
+
+/*
+ * Subnet sweep test
+ *
+ * Links ping_core.c unchanged against the raw pcb stand-in in client/shim and sweeps a simulated /24.  A sixth of the
+ * hosts are live and answer each echo after 2 to 150 ms, echoes and replies are lost at random each way, and the
+ * network adds a late duplicate, a reply with the previous sweep's id, a reply from the wrong source, a reply with a
+ * sequence number past the end of the sweep and destination unreachables from the router.  Every packet delivered
+ * is logged with whether the sweep's receive callback ate it.
+ *
+ * Checks that:
+ *
+ *   - exactly the hosts whose reply got through are reported, each once, and the sweep returns their number
+ *   - replies to the sweep, duplicates included, are eaten while it runs
+ *   - stale id, wrong source, out of range and unreachable packets are passed on to the stack, not eaten
+ *   - no more than rate echoes plus one burst go out in any second
+ *   - every pbuf is freed and the raw pcb is removed
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#define PS_NETWORK              (0xc0a80100u)       // 192.168.1.0/24, host order
+#define PS_FIRST                (1)                 // .1 to .254 are swept
+#define PS_COUNT                (254)
+#define PS_ROUTER               (PS_NETWORK | 1)
+#define PS_PENDING_MAX          (8192)
+#define PS_SENT_MAX             (8192)
+#define PS_DUPLICATE_MS         (300)               // a duplicate arrives this long after the reply
+#define PS_STRAY_PERCENT        (25)                // chance of each kind of stray packet per reply
+
+typedef enum
+{
+    PS_REPLY = 0,
+    PS_DUPLICATE,
+    PS_STALE_ID,
+    PS_WRONG_SOURCE,
+    PS_OUT_OF_RANGE,
+    PS_UNREACHABLE,
+    PS_KINDS
+} PS_KIND_T;
+
+typedef struct
+{
+    uint64_t due_us;
+    uint32_t source;                                // host order
+    PS_KIND_T kind;
+    int length;
+    uint8_t packet[PBUF_IP_HLEN + sizeof(struct icmp_echo_hdr) + 64];
+} PS_PACKET_T;
+
+// prototypes
+static void ps_usage(const char *program);
+static bool ps_sweep(int rate, int attempts, int timeout_ms);
+static err_t ps_output(struct pbuf *p, const ip_addr_t *destination);
+static void ps_queue(uint64_t due_us, uint32_t source, PS_KIND_T kind, const uint8_t *icmp, int length);
+static void *ps_network(void *arg);
+static void ps_found(void *arg, u32_t ip);
+
+// static variables
+static const char *ps_kind_names[PS_KINDS] = {"reply", "duplicate", "stale id", "wrong source", "out of range", "unreachable"};
+static pthread_mutex_t ps_lock = PTHREAD_MUTEX_INITIALIZER;
+static PS_PACKET_T ps_pending[PS_PENDING_MAX];
+static int ps_pending_count = 0;
+static uint64_t ps_sent_us[PS_SENT_MAX];
+static int ps_sent = 0;
+static int ps_bad_echoes = 0;
+static int ps_loss_percent = 5;
+static bool ps_live[256];
+static int ps_latency_ms[256];
+static bool ps_answered[256];                       // a reply was delivered while the sweep ran
+static int ps_reported[256];
+static int ps_delivered[PS_KINDS];
+static int ps_eaten[PS_KINDS];
+static int ps_late = 0;                             // replies delivered after the sweep ended
+static volatile bool ps_sweeping = false;
+static volatile bool ps_stop = false;
+
+int main(int argc, char *argv[])
+{
+    pthread_t network;
+    bool passed = true;
+    int rate = 200;
+    int attempts = 2;
+    int timeout_ms = 1000;
+    int sweeps = 2;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "r:a:t:l:n:s:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            case 'a':
+                attempts = atoi(optarg);
+                break;
+            case 't':
+                timeout_ms = atoi(optarg);
+                break;
+            case 'l':
+                ps_loss_percent = atoi(optarg);
+                break;
+            case 'n':
+                sweeps = atoi(optarg);
+                break;
+            case 's':
+                srand(atoi(optarg));
+                break;
+            default:
+                ps_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    shim_raw_output = ps_output;
+    pthread_create(&network, NULL, ps_network, NULL);
+
+    for (i = 0; i < sweeps; i++)
+    {
+        passed &= ps_sweep(rate, attempts, timeout_ms);
+    }
+
+    ps_stop = true;
+    pthread_join(network, NULL);
+
+    printf("%ld pbuf bytes not freed, %d raw pcbs not removed\n", shim_pbuf_bytes, shim_raw_pcbs);
+    passed &= (shim_pbuf_bytes == 0) && (shim_raw_pcbs == 0);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void ps_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-r echoes per second] [-a attempts] [-t timeout ms] [-l loss %% each way] [-n sweeps] [-s seed]\n", program);
+}
+
+/*!
+ * \brief Sweep the simulated subnet once with a new set of live hosts and check the results
+ *
+ * \param[in]  rate         echoes per second
+ * \param[in]  attempts     echoes sent to a host that does not reply
+ * \param[in]  timeout_ms   wait after each attempt
+ *
+ * \return true if every check passed
+ */
+static bool ps_sweep(int rate, int attempts, int timeout_ms)
+{
+    uint64_t start_us;
+    bool passed = true;
+    int returned;
+    int live = 0;
+    int answered = 0;
+    int reported = 0;
+    int wrong = 0;
+    int burst_max = 0;
+    int first;
+    int last;
+    int host;
+    int kind;
+
+    pthread_mutex_lock(&ps_lock);
+    for (host = 0; host < 256; host++)
+    {
+        ps_live[host] = (host >= PS_FIRST) && (host < PS_FIRST + PS_COUNT) && (host != (PS_ROUTER & 0xff)) && (rand() % 6 == 0);
+        ps_latency_ms[host] = 2 + rand() % 149;
+        ps_answered[host] = false;
+        ps_reported[host] = 0;
+        live += ps_live[host];
+    }
+    memset(ps_delivered, 0, sizeof(ps_delivered));
+    memset(ps_eaten, 0, sizeof(ps_eaten));
+    ps_late = 0;
+    ps_sent = 0;
+    ps_bad_echoes = 0;
+    ps_sweeping = true;
+    pthread_mutex_unlock(&ps_lock);
+
+    start_us = time_us_64();
+    returned = ping_sweep(PS_NETWORK + PS_FIRST, PS_COUNT, rate, attempts, timeout_ms, ps_found, NULL);
+
+    pthread_mutex_lock(&ps_lock);
+    ps_sweeping = false;
+    pthread_mutex_unlock(&ps_lock);
+
+    // let everything still in flight arrive
+    while (true)
+    {
+        pthread_mutex_lock(&ps_lock);
+        first = ps_pending_count;
+        pthread_mutex_unlock(&ps_lock);
+        if (!first)
+        {
+            break;
+        }
+        sleep_ms(10);
+    }
+
+    for (host = 0; host < 256; host++)
+    {
+        answered += ps_answered[host];
+        reported += ps_reported[host];
+        wrong += (ps_reported[host] != (ps_answered[host] ? 1 : 0));
+    }
+
+    // echoes in any one second
+    for (first = 0, last = 0; last < ps_sent; last++)
+    {
+        while (ps_sent_us[last] - ps_sent_us[first] >= 1000000)
+        {
+            first++;
+        }
+        if (last - first + 1 > burst_max)
+        {
+            burst_max = last - first + 1;
+        }
+    }
+
+    printf("sweep at %d/s, %d attempts: %.2f s, %d echoes sent, %d live, %d replies got through, %d reported, "
+           "returned %d, %d wrongly reported, at most %d echoes in a second\n",
+           rate, attempts, (time_us_64() - start_us)/1e6, ps_sent, live, answered, reported, returned, wrong, burst_max);
+
+    passed &= (wrong == 0) && (returned == answered) && (ps_bad_echoes == 0) && (burst_max <= rate + PING_SWEEP_BURST);
+
+    for (kind = 0; kind < PS_KINDS; kind++)
+    {
+        printf("  %-13s %4d delivered, %4d eaten\n", ps_kind_names[kind], ps_delivered[kind], ps_eaten[kind]);
+
+        if ((kind == PS_REPLY) || (kind == PS_DUPLICATE))
+        {
+            passed &= (ps_eaten[kind] == ps_delivered[kind]);
+        }
+        else
+        {
+            passed &= (ps_eaten[kind] == 0);
+        }
+    }
+
+    if (ps_late)
+    {
+        printf("  %d replies arrived after the sweep ended\n", ps_late);
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief The network: answer echoes to live hosts after their latency, with losses and stray packets
+ *
+ * \param[in]  p            echo request without ip header
+ * \param[in]  destination  address
+ *
+ * \return ERR_OK
+ */
+static err_t ps_output(struct pbuf *p, const ip_addr_t *destination)
+{
+    struct icmp_echo_hdr echo;
+    uint8_t reply[sizeof(ps_pending[0].packet)];
+    uint32_t address = ntohl(destination->addr);
+    uint64_t now_us = time_us_64();
+    uint64_t due_us;
+    int host = address & 0xff;
+    int length = p->len;
+    int other;
+
+    pthread_mutex_lock(&ps_lock);
+
+    memcpy(&echo, p->payload, sizeof(echo));
+    if (((address & 0xffffff00) != PS_NETWORK) || (host < PS_FIRST) || (host >= PS_FIRST + PS_COUNT) ||
+        (echo.type != ICMP_ECHO) || (inet_chksum(p->payload, p->len) != 0) || (length > (int)sizeof(reply)))
+    {
+        ps_bad_echoes++;
+        pthread_mutex_unlock(&ps_lock);
+        return(ERR_OK);
+    }
+
+    if (ps_sent < PS_SENT_MAX)
+    {
+        ps_sent_us[ps_sent++] = now_us;
+    }
+
+    memcpy(reply, p->payload, length);
+
+    if (!ps_live[host])
+    {
+        // the router gives up on arp now and then
+        if (rand() % 10 == 0)
+        {
+            reply[0] = ICMP_DUR;
+            ps_queue(now_us + 10000, PS_ROUTER, PS_UNREACHABLE, reply, length);
+        }
+    }
+    else if ((rand() % 100 >= ps_loss_percent) && (rand() % 100 >= ps_loss_percent))
+    {
+        due_us = now_us + ps_latency_ms[host]*1000;
+        reply[0] = ICMP_ER;
+        ps_queue(due_us, address, PS_REPLY, reply, length);
+
+        if (rand() % 100 < PS_STRAY_PERCENT)
+        {
+            ps_queue(due_us + PS_DUPLICATE_MS*1000, address, PS_DUPLICATE, reply, length);
+        }
+
+        if (rand() % 100 < PS_STRAY_PERCENT)
+        {
+            // a late reply to the previous sweep
+            ((struct icmp_echo_hdr *)reply)->id = htons(ntohs(echo.id) - 1);
+            ps_queue(due_us, address, PS_STALE_ID, reply, length);
+            ((struct icmp_echo_hdr *)reply)->id = echo.id;
+        }
+
+        if (rand() % 100 < PS_STRAY_PERCENT)
+        {
+            // the right id and sequence number from another host in the sweep that is not live
+            for (other = host + 1; ps_live[PS_FIRST + (other - PS_FIRST) % PS_COUNT]; other++);
+            ps_queue(due_us, PS_NETWORK | (PS_FIRST + (other - PS_FIRST) % PS_COUNT), PS_WRONG_SOURCE, reply, length);
+        }
+
+        if (rand() % 100 < PS_STRAY_PERCENT)
+        {
+            ((struct icmp_echo_hdr *)reply)->seqno = htons(PS_COUNT + host);
+            ps_queue(due_us, address, PS_OUT_OF_RANGE, reply, length);
+            ((struct icmp_echo_hdr *)reply)->seqno = echo.seqno;
+        }
+    }
+
+    pthread_mutex_unlock(&ps_lock);
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Queue a packet for delivery, adding an ip header
+ *
+ * \param[in]  due_us   when it arrives
+ * \param[in]  source   address it comes from, host order
+ * \param[in]  kind     what it is
+ * \param[in]  icmp     icmp message
+ * \param[in]  length   bytes in icmp
+ *
+ * \return nothing
+ */
+static void ps_queue(uint64_t due_us, uint32_t source, PS_KIND_T kind, const uint8_t *icmp, int length)
+{
+    PS_PACKET_T *packet;
+
+    if (ps_pending_count >= PS_PENDING_MAX)
+    {
+        return;
+    }
+
+    packet = &ps_pending[ps_pending_count++];
+    memset(packet->packet, 0, PBUF_IP_HLEN);
+    packet->packet[0] = 0x45;
+    packet->packet[9] = IP_PROTO_ICMP;
+    memcpy(packet->packet + PBUF_IP_HLEN, icmp, length);
+    packet->due_us = due_us;
+    packet->source = source;
+    packet->kind = kind;
+    packet->length = PBUF_IP_HLEN + length;
+}
+
+/*!
+ * \brief Deliver packets that are due, as the tcpip thread
+ *
+ * \param[in]  arg  unused
+ *
+ * \return NULL
+ */
+static void *ps_network(__unused void *arg)
+{
+    PS_PACKET_T packet;
+    struct pbuf *p;
+    ip_addr_t source;
+    uint64_t now_us;
+    bool due;
+    bool sweeping;
+    u8_t eaten;
+    int i;
+
+    while (!ps_stop)
+    {
+        sleep_ms(1);
+
+        do
+        {
+            due = false;
+            now_us = time_us_64();
+
+            pthread_mutex_lock(&ps_lock);
+            for (i = 0; i < ps_pending_count; i++)
+            {
+                if (ps_pending[i].due_us <= now_us)
+                {
+                    packet = ps_pending[i];
+                    ps_pending[i] = ps_pending[--ps_pending_count];
+                    due = true;
+                    break;
+                }
+            }
+            sweeping = ps_sweeping;
+            pthread_mutex_unlock(&ps_lock);
+
+            if (!due)
+            {
+                break;
+            }
+
+            p = pbuf_alloc(PBUF_IP, packet.length, PBUF_RAM);
+            memcpy(p->payload, packet.packet, packet.length);
+            source.addr = htonl(packet.source);
+            eaten = shim_raw_input(p, &source);
+
+            pthread_mutex_lock(&ps_lock);
+            if (!sweeping && ((packet.kind == PS_REPLY) || (packet.kind == PS_DUPLICATE)))
+            {
+                // nothing is listening any more, lwIP passes it on
+                ps_late++;
+            }
+            else
+            {
+                ps_delivered[packet.kind]++;
+                ps_eaten[packet.kind] += eaten;
+                if (packet.kind == PS_REPLY)
+                {
+                    ps_answered[packet.source & 0xff] = true;
+                }
+            }
+            pthread_mutex_unlock(&ps_lock);
+        } while (due);
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Called by the sweep for each host that replied
+ *
+ * \param[in]  arg  unused
+ * \param[in]  ip   address, host order
+ *
+ * \return nothing
+ */
+static void ps_found(__unused void *arg, u32_t ip)
+{
+    pthread_mutex_lock(&ps_lock);
+    if ((ip & 0xffffff00) == PS_NETWORK)
+    {
+        ps_reported[ip & 0xff]++;
+    }
+    else
+    {
+        ps_reported[0]++;
+    }
+    pthread_mutex_unlock(&ps_lock);
+}
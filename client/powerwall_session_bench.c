@@ -0,0 +1,675 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <math.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/tcp.h>
+#include <openssl/ssl.h>
+
+#include "http_response.h"
+#include "web_snapshot.h"
+
+/*
+ * Powerwall session benchmark
+ *
+ * Refreshes the grid status and state of energy from http_standin.py over TLS 1.2, parsing each response with
+ * http_response.c and json_parser.c, in the three ways the firmware has talked to the gateway:
+ *
+ *   - per poll: connect, full handshake, log in, read both values, log out and close, as powerwall.c used to
+ *   - persistent: the connection, token and cookies are kept across refreshes; a 401 logs in again and a dropped
+ *     connection is reopened, resuming the saved TLS session
+ *   - dropped: as persistent, but the connection is closed after every refresh, as when the gateway times it out
+ *
+ * and reports full handshakes, resumed handshakes, logins and requests per refresh, the TCP bytes sent and received
+ * per refresh and the time per refresh.  Run the stand-in with the gateway's token lifetime and connection limit to
+ * see their cost, e.g. python3 http_standin.py -t 50 -k 20.
+ *
+ * With -j it instead measures the thermostat loop period with the refresh made inline in the loop, as
+ * powerwall_check() was, then from its own thread publishing to the WEB_GROUP_POWERWALL snapshot, as powerwall_task
+ * does, with the loop reading the snapshot through web_snapshot.c (client/shim) every time round.  The loop delay is
+ * scaled down to PS_LOOP_MS and a refresh is made every PS_POLL_LOOPS loops; slow the stand-in down to the pico's
+ * handshake and response times to see the difference, e.g. python3 http_standin.py -k 4 -H 0.8 -D 0.1.
+ * Exits with 1 if a refresh fails, a value is wrong, or the persistent session does not save handshakes and logins.
+ */
+
+#define PS_TOKEN_MAX            (256)
+#define PS_COOKIES_MAX          (1024)
+#define PS_REQUEST_MAX          (2048)
+#define PS_READ_MAX             (1460)
+#define PS_ATTEMPTS             (3)             // tries per value, as powerwall_get()
+#define PS_GRID_STATUS          "\"SystemGridConnected\""
+#define PS_PERCENTAGE           "84.03846153846153"
+#define PS_LOOP_MS              (100)           // stands in for THERMOSTAT_TASK_LOOP_DELAY
+#define PS_POLL_LOOPS           (10)            // loops between refreshes, stands in for POWERWALL_POLL_INTERVAL_MS
+#define PS_TASK_WAKE_MS         (10)            // stands in for POWERWALL_TASK_LOOP_DELAY
+#define PS_LOOPS_MAX            (10000)
+#define PS_GRID_DOWN            (0)             // GRID_STATUS_T
+#define PS_GRID_UP              (1)
+
+typedef enum
+{
+    PS_PER_POLL = 0,
+    PS_PERSISTENT,
+    PS_DROPPED,
+    PS_NUM_MODES
+} PS_MODE_T;
+
+typedef struct
+{
+    SSL_CTX *context;
+    SSL *ssl;
+    int socket;                         // -1 when there is no connection
+    SSL_SESSION *saved;                 // session of the last handshake, offered when reconnecting
+    const char *address;
+    int port;
+    char token[PS_TOKEN_MAX];           // empty when not logged in
+    char cookies[PS_COOKIES_MAX];
+    long handshakes;
+    long resumed;
+    long logins;
+    long requests;
+    unsigned long long wire_bytes;      // TCP payload both ways
+} PS_SESSION_T;
+
+// prototypes
+static void ps_usage(const char *program);
+static int ps_connect(PS_SESSION_T *session, bool resume);
+static void ps_disconnect(PS_SESSION_T *session);
+static int ps_request(PS_SESSION_T *session, const char *method, const char *url, const char *content, bool login,
+                      JSONP_FILTER_T *filters, int num_filters);
+static bool ps_login(PS_SESSION_T *session);
+static bool ps_refresh_per_poll(PS_SESSION_T *session, char *grid_status, char *percentage);
+static int ps_get(PS_SESSION_T *session, const char *url, JSONP_FILTER_T *filter);
+static bool ps_refresh_persistent(PS_SESSION_T *session, char *grid_status, char *percentage);
+static bool ps_publish(PS_SESSION_T *session);
+static void *ps_powerwall_task(void *arg);
+static long ps_jitter(PS_SESSION_T *session, bool task, int loops);
+static int ps_compare(const void *a, const void *b);
+static double ps_now_us(void);
+
+// the variables web_snapshot.c publishes
+WEB_VARIABLES_T web;
+
+// static variables
+static volatile bool ps_stop = false;
+static const char *ps_mode_names[PS_NUM_MODES] = {"per poll", "persistent", "dropped"};
+static const char *ps_login_body = "{\"username\":\"customer\",\"password\":\"ABCDE\"}";
+
+int main(int argc, char *argv[])
+{
+    PS_SESSION_T session;
+    char grid_status[64];
+    char percentage[32];
+    double handshakes[PS_NUM_MODES];
+    double logins[PS_NUM_MODES];
+    double resumed[PS_NUM_MODES];
+    double start;
+    double elapsed;
+    long failures = 0;
+    int refreshes = 200;
+    int jitter_loops = 0;
+    int option;
+    int mode;
+    int i;
+
+    memset(&session, 0, sizeof(session));
+    session.socket = -1;
+    session.address = "127.0.0.1";
+    session.port = 8443;
+
+    while ((option = getopt(argc, argv, "a:p:n:j:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'a':
+                session.address = optarg;
+                break;
+            case 'p':
+                session.port = atoi(optarg);
+                break;
+            case 'n':
+                refreshes = atoi(optarg);
+                break;
+            case 'j':
+                jitter_loops = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                ps_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((refreshes <= 0) || (jitter_loops < 0) || (jitter_loops > PS_LOOPS_MAX))
+    {
+        ps_usage(argv[0]);
+        return(1);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    session.context = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(session.context, TLS1_2_VERSION);
+    SSL_CTX_set_session_cache_mode(session.context, SSL_SESS_CACHE_CLIENT);
+
+    if (jitter_loops)
+    {
+        failures = ps_jitter(&session, false, jitter_loops) + ps_jitter(&session, true, jitter_loops);
+        printf("%s\n", failures ? "FAILED" : "passed");
+        return(failures ? 1 : 0);
+    }
+
+    for (mode=0; mode<PS_NUM_MODES; mode++)
+    {
+        session.token[0] = session.cookies[0] = 0;
+        session.handshakes = session.resumed = session.logins = session.requests = 0;
+        session.wire_bytes = 0;
+
+        start = ps_now_us();
+        for (i=0; i<refreshes; i++)
+        {
+            grid_status[0] = percentage[0] = 0;
+            if (!((mode == PS_PER_POLL) ? ps_refresh_per_poll(&session, grid_status, percentage) :
+                                          ps_refresh_persistent(&session, grid_status, percentage)) ||
+                strcmp(grid_status, PS_GRID_STATUS) || strcmp(percentage, PS_PERCENTAGE))
+            {
+                if (failures++ < 10)
+                {
+                    printf("%s refresh %d: grid status '%s' percentage '%s'\n", ps_mode_names[mode], i, grid_status, percentage);
+                }
+            }
+            if (mode == PS_DROPPED)
+            {
+                ps_disconnect(&session);
+            }
+        }
+        ps_disconnect(&session);
+        elapsed = ps_now_us() - start;
+
+        handshakes[mode] = (double)session.handshakes/refreshes;
+        resumed[mode] = (double)session.resumed/refreshes;
+        logins[mode] = (double)session.logins/refreshes;
+        printf("%-10s %d refreshes, per refresh: %.2f full handshakes %.2f resumed %.2f logins %.2f requests %6.0f bytes %7.2f ms\n",
+               ps_mode_names[mode], refreshes, handshakes[mode], resumed[mode], logins[mode],
+               (double)session.requests/refreshes, (double)session.wire_bytes/refreshes, elapsed/refreshes/1000);
+    }
+
+    // the persistent session must log in and shake hands less often than the per poll one, and resume every reconnect
+    if ((handshakes[PS_PERSISTENT] >= handshakes[PS_PER_POLL]) || (logins[PS_PERSISTENT] >= logins[PS_PER_POLL]) ||
+        (resumed[PS_DROPPED] < 1.0))
+    {
+        printf("the persistent session saved nothing\n");
+        failures++;
+    }
+
+    if (session.saved)
+    {
+        SSL_SESSION_free(session.saved);
+    }
+    SSL_CTX_free(session.context);
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return(failures ? 1 : 0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void ps_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-a address] [-p port] [-n refreshes | -j loops]\n"
+            "  -a address   address of http_standin.py (default 127.0.0.1)\n"
+            "  -p port      port of http_standin.py (default 8443)\n"
+            "  -n count     refreshes in each mode (default 200)\n"
+            "  -j count     measure this many thermostat loops with the refresh inline, then on its own thread\n",
+            program);
+}
+
+/*!
+ * \brief Open a TLS connection to the stand-in, the certificate is not checked
+ *
+ * \param[in]  session  session
+ * \param[in]  resume   offer the session of the last handshake
+ *
+ * \return 0 on success, -1 on error
+ */
+static int ps_connect(PS_SESSION_T *session, bool resume)
+{
+    struct sockaddr_in server;
+    int one = 1;
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(session->port);
+    if ((inet_pton(AF_INET, session->address, &server.sin_addr) != 1) ||
+        ((session->socket = socket(AF_INET, SOCK_STREAM, 0)) < 0))
+    {
+        return(-1);
+    }
+
+    setsockopt(session->socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(session->socket, (struct sockaddr *)&server, sizeof(server)))
+    {
+        printf("cannot reach the stand-in at %s:%d\n", session->address, session->port);
+        close(session->socket);
+        session->socket = -1;
+        return(-1);
+    }
+
+    session->ssl = SSL_new(session->context);
+    SSL_set_fd(session->ssl, session->socket);
+    if (resume && session->saved)
+    {
+        SSL_set_session(session->ssl, session->saved);
+    }
+    if (SSL_connect(session->ssl) != 1)
+    {
+        ps_disconnect(session);
+        return(-1);
+    }
+
+    if (SSL_session_reused(session->ssl))
+    {
+        session->resumed++;
+    }
+    else
+    {
+        session->handshakes++;
+    }
+
+    if (resume)
+    {
+        if (session->saved)
+        {
+            SSL_SESSION_free(session->saved);
+        }
+        session->saved = SSL_get1_session(session->ssl);
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Close the connection, if there is one, and count the bytes it carried
+ *
+ * \param[in]  session  session
+ *
+ * \return nothing
+ */
+static void ps_disconnect(PS_SESSION_T *session)
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+
+    if (session->socket < 0)
+    {
+        return;
+    }
+
+    SSL_shutdown(session->ssl);
+    if (!getsockopt(session->socket, IPPROTO_TCP, TCP_INFO, &info, &length))
+    {
+        session->wire_bytes += info.tcpi_bytes_acked + info.tcpi_bytes_received;
+    }
+    SSL_free(session->ssl);
+    close(session->socket);
+    session->socket = -1;
+}
+
+/*!
+ * \brief Send a request and parse the response as it arrives
+ *
+ * \param[in]  session      session
+ * \param[in]  method       GET or POST
+ * \param[in]  url          url
+ * \param[in]  content      json body, NULL for none
+ * \param[in]  login        login request: no token is sent and the cookies are collected
+ * \param[in]  filters      values wanted
+ * \param[in]  num_filters  number of filters
+ *
+ * \return http status, -1 if the connection dropped
+ */
+static int ps_request(PS_SESSION_T *session, const char *method, const char *url, const char *content, bool login,
+                      JSONP_FILTER_T *filters, int num_filters)
+{
+    char request[PS_REQUEST_MAX];
+    char data[PS_READ_MAX];
+    JSON_PARSER_CONTEXT_T json;
+    HTTP_RESPONSE_T response;
+    int length;
+
+    length = snprintf(request, sizeof(request), "%s %s HTTP/1.1\r\nHost: powerwall\r\nAccept: */*\r\n", method, url);
+    if (!login && session->cookies[0])
+    {
+        length += snprintf(request + length, sizeof(request) - length, "Cookie: %s\r\n", session->cookies);
+    }
+    if (!login && session->token[0])
+    {
+        length += snprintf(request + length, sizeof(request) - length, "Authorization: Bearer %s\r\n", session->token);
+    }
+    if (content)
+    {
+        length += snprintf(request + length, sizeof(request) - length, "Content-Type: application/json\r\nContent-Length: %d\r\n",
+                           (int)strlen(content));
+    }
+    length += snprintf(request + length, sizeof(request) - length, "\r\n%s", content ? content : "");
+
+    if (SSL_write(session->ssl, request, length) <= 0)
+    {
+        return(-1);
+    }
+
+    jsonp_begin(&json, filters, num_filters, NULL, NULL);
+    http_response_begin(&response, &json, login ? session->cookies : NULL, sizeof(session->cookies));
+    while (!http_response_finished(&response))
+    {
+        if ((length = SSL_read(session->ssl, data, sizeof(data))) <= 0)
+        {
+            http_response_close(&response);
+            break;
+        }
+        http_response_parse(&response, data, length);
+    }
+
+    if (response.state != HTTP_RESPONSE_DONE)
+    {
+        return(-1);
+    }
+    session->requests++;
+
+    return(response.status);
+}
+
+/*!
+ * \brief Log in, keeping the token and cookies
+ *
+ * \param[in]  session  session, connected
+ *
+ * \return true if logged in
+ */
+static bool ps_login(PS_SESSION_T *session)
+{
+    JSONP_FILTER_T filter[] = {{"root.\"token\"", session->token, sizeof(session->token), true, false, 0}};
+    int status;
+
+    session->cookies[0] = 0;
+    status = ps_request(session, "POST", "/api/login/Basic", ps_login_body, true, filter, 1);
+    session->logins++;
+
+    if ((status != 200) || !filter[0].found)
+    {
+        session->token[0] = 0;
+        return(false);
+    }
+
+    return(true);
+}
+
+/*!
+ * \brief Refresh as powerwall.c did before the session was kept: connect, log in, read, log out and close
+ *
+ * \param[in]   session      session
+ * \param[out]  grid_status  grid status text
+ * \param[out]  percentage   state of energy text
+ *
+ * \return true on success
+ */
+static bool ps_refresh_per_poll(PS_SESSION_T *session, char *grid_status, char *percentage)
+{
+    JSONP_FILTER_T grid_status_filter[] = {{"root.\"grid_status\"", grid_status, 64, false, false, 0}};
+    JSONP_FILTER_T percentage_filter[] = {{"root.\"percentage\"", percentage, 32, false, false, 0}};
+    bool success;
+
+    if (ps_connect(session, false))
+    {
+        return(false);
+    }
+
+    success = ps_login(session) &&
+              (ps_request(session, "GET", "/api/system_status/grid_status", NULL, false, grid_status_filter, 1) == 200) &&
+              (ps_request(session, "GET", "/api/system_status/soe", NULL, false, percentage_filter, 1) == 200);
+    ps_request(session, "GET", "/api/logout", NULL, false, NULL, 0);
+    session->token[0] = session->cookies[0] = 0;
+    ps_disconnect(session);
+
+    return(success);
+}
+
+/*!
+ * \brief Read a value as powerwall_get() does: connect and log in if needed, log in again after a 401 or 403, and
+ *        reconnect after the connection drops
+ *
+ * \param[in]  session  session
+ * \param[in]  url      url
+ * \param[in]  filter   value wanted
+ *
+ * \return http status of the last attempt, -1 if the connection dropped
+ */
+static int ps_get(PS_SESSION_T *session, const char *url, JSONP_FILTER_T *filter)
+{
+    int status = -1;
+    int attempt;
+
+    for (attempt=0; attempt<PS_ATTEMPTS; attempt++)
+    {
+        if ((session->socket < 0) && ps_connect(session, true))
+        {
+            continue;
+        }
+        if (!session->token[0] && !ps_login(session))
+        {
+            ps_disconnect(session);
+            continue;
+        }
+
+        status = ps_request(session, "GET", url, NULL, false, filter, 1);
+        if ((status == 401) || (status == 403))
+        {
+            session->token[0] = 0;
+        }
+        else if (status < 0)
+        {
+            ps_disconnect(session);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return(status);
+}
+
+/*!
+ * \brief Refresh over the persistent session
+ *
+ * \param[in]   session      session
+ * \param[out]  grid_status  grid status text
+ * \param[out]  percentage   state of energy text
+ *
+ * \return true on success
+ */
+static bool ps_refresh_persistent(PS_SESSION_T *session, char *grid_status, char *percentage)
+{
+    JSONP_FILTER_T grid_status_filter[] = {{"root.\"grid_status\"", grid_status, 64, false, false, 0}};
+    JSONP_FILTER_T percentage_filter[] = {{"root.\"percentage\"", percentage, 32, false, false, 0}};
+
+    return((ps_get(session, "/api/system_status/grid_status", grid_status_filter) == 200) &&
+           (ps_get(session, "/api/system_status/soe", percentage_filter) == 200));
+}
+
+/*!
+ * \brief Refresh over the persistent session and publish the result, as powerwall_poll() does
+ *
+ * \param[in]  session  session
+ *
+ * \return true on success
+ */
+static bool ps_publish(PS_SESSION_T *session)
+{
+    char grid_status[64] = "";
+    char percentage[32] = "";
+    bool success;
+
+    success = ps_refresh_persistent(session, grid_status, percentage);
+    if (success)
+    {
+        web_write_begin(WEB_GROUP_POWERWALL);
+        web.powerwall_grid_status = strstr(grid_status, "SystemGridConnected") ? PS_GRID_UP : PS_GRID_DOWN;
+        web.powerwall_battery_percentage = (int)(atof(percentage)*10);
+        web.powerwall_update_time_us = (uint64_t)ps_now_us();
+        web_write_end(WEB_GROUP_POWERWALL);
+    }
+
+    return(success);
+}
+
+/*!
+ * \brief Thread standing in for powerwall_task, refreshing every PS_POLL_LOOPS thermostat loops
+ *
+ * \param[in]  arg  PS_SESSION_T
+ *
+ * \return number of failed refreshes
+ */
+static void *ps_powerwall_task(void *arg)
+{
+    PS_SESSION_T *session = (PS_SESSION_T *)arg;
+    double last_poll = -1e12;
+    long failures = 0;
+
+    while (!ps_stop)
+    {
+        if (ps_now_us() - last_poll >= PS_POLL_LOOPS*PS_LOOP_MS*1000.0)
+        {
+            last_poll = ps_now_us();
+            failures += !ps_publish(session);
+        }
+        usleep(PS_TASK_WAKE_MS*1000);
+    }
+
+    return((void *)failures);
+}
+
+/*!
+ * \brief Run the thermostat loop and report its period
+ *
+ * \param[in]  session  session, used by one thread at a time
+ * \param[in]  task     refresh from a thread rather than inline
+ * \param[in]  loops    thermostat loops
+ *
+ * \return number of failures
+ */
+static long ps_jitter(PS_SESSION_T *session, bool task, int loops)
+{
+    static double period[PS_LOOPS_MAX];
+    WEB_POWERWALL_T powerwall;
+    pthread_t thread;
+    void *result = NULL;
+    double start;
+    double last = 0;
+    double mean = 0;
+    double squares = 0;
+    long failures = 0;
+    int i;
+
+    memset(&web, 0, sizeof(web));
+    ps_stop = false;
+    if (task && pthread_create(&thread, NULL, ps_powerwall_task, session))
+    {
+        return(1);
+    }
+
+    for (i=0; i<=loops; i++)
+    {
+        start = ps_now_us();
+        if (i)
+        {
+            period[i-1] = (start - last)/1000;
+        }
+        last = start;
+
+        if (!task && !(i%PS_POLL_LOOPS))
+        {
+            failures += !ps_publish(session);
+        }
+
+        // control_thermostat_relays() reads the snapshot, which must never wait for the gateway
+        web_snapshot_powerwall(&powerwall);
+        usleep(PS_LOOP_MS*1000);
+    }
+
+    ps_stop = true;
+    if (task)
+    {
+        pthread_join(thread, &result);
+        failures += (long)result;
+    }
+    ps_disconnect(session);
+    session->token[0] = 0;
+
+    if ((powerwall.grid_status != PS_GRID_UP) || (powerwall.battery_percentage != 840) || !powerwall.update_time_us)
+    {
+        printf("snapshot grid status %d battery %d updated at %llu\n", powerwall.grid_status, powerwall.battery_percentage,
+               (unsigned long long)powerwall.update_time_us);
+        failures++;
+    }
+
+    for (i=0; i<loops; i++)
+    {
+        mean += period[i]/loops;
+        squares += (period[i] - PS_LOOP_MS)*(period[i] - PS_LOOP_MS)/loops;
+    }
+    qsort(period, loops, sizeof(period[0]), ps_compare);
+    printf("%-6s %d loops of %d ms: period mean %.1f p50 %.1f p99 %.1f max %.1f ms, rms jitter %.1f ms\n",
+           task ? "task" : "inline", loops, PS_LOOP_MS, mean, period[loops/2], period[loops*99/100], period[loops-1], sqrt(squares));
+
+    return(failures);
+}
+
+/*!
+ * \brief qsort() comparison of doubles
+ *
+ * \param[in]  a  first
+ * \param[in]  b  second
+ *
+ * \return <0, 0 or >0
+ */
+static int ps_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return((x > y) - (x < y));
+}
+
+/*!
+ * \brief Monotonic clock
+ *
+ * \return microseconds
+ */
+static double ps_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
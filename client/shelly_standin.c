@@ -0,0 +1,364 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+ * Stand-in for shelly devices on a linux host
+ *
+ * Replays a file of recorded status frames so the home controller can be exercised without hardware.  Each line of
+ * the file is one of
+ *
+ *   coiot <device id> <json payload>   gen1 CoIoT status frame, sent to the CoIoT group (or -a address)
+ *   webhook <ip> <channel> <on>        gen2 webhook call, an http get of /shelly_event.cgi sent to -w address
+ *   sleep <ms>                         pause
+ *
+ * Blank lines and lines starting with # are ignored.  Frames are built the way the devices build them: a
+ * non-confirmable CoAP message with shelly's status code 30, the device id, validity and serial options, then the json.
+ */
+
+#define SS_COIOT_GROUP          "224.0.1.187"
+#define SS_COIOT_PORT           (5683)
+#define SS_COIOT_CODE_STATUS    (30)
+#define SS_OPTION_DEVICE_ID     (3332)
+#define SS_OPTION_VALIDITY      (3412)
+#define SS_OPTION_SERIAL        (3420)
+#define SS_FRAME_MAX            (1400)
+#define SS_LINE_MAX             (2048)
+
+// prototypes
+static void ss_usage(const char *program);
+static int ss_option(uint8_t *frame, int length, int *last, int number, const uint8_t *value, int value_length);
+static int ss_coiot(int socket_fd, const struct sockaddr_in *destination, const char *device_id, const char *payload);
+static int ss_webhook(const struct sockaddr_in *destination, const char *ip, int channel, int on);
+static int ss_address(const char *text, int default_port, struct sockaddr_in *address);
+
+// static variables
+static uint16_t ss_message_id = 1;
+static uint16_t ss_serial = 1;
+static uint32_t ss_frames = 0;
+static uint32_t ss_webhooks = 0;
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_in coiot;
+    struct sockaddr_in http;
+    struct timespec pause;
+    char line[SS_LINE_MAX];
+    char kind[16];
+    char device_id[64];
+    char ip[16];
+    const char *frames = NULL;
+    const char *coiot_address = SS_COIOT_GROUP;
+    const char *http_address = "127.0.0.1:80";
+    FILE *file;
+    int repeat = 1;
+    int socket_fd;
+    int consumed;
+    int channel;
+    int on;
+    int ms;
+    int option;
+    int ttl = 1;
+    unsigned char loop = 1;
+
+    while ((option = getopt(argc, argv, "f:a:w:r:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'f':
+                frames = optarg;
+                break;
+            case 'a':
+                coiot_address = optarg;
+                break;
+            case 'w':
+                http_address = optarg;
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                ss_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if (!frames || (repeat < 1) || ss_address(coiot_address, SS_COIOT_PORT, &coiot) || ss_address(http_address, 80, &http))
+    {
+        ss_usage(argv[0]);
+        return(1);
+    }
+
+    file = fopen(frames, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", frames, strerror(errno));
+        return(1);
+    }
+
+    socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+    {
+        perror("socket");
+        return(1);
+    }
+
+    // frames also reach a listener on this host
+    setsockopt(socket_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(socket_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    while (repeat-- > 0)
+    {
+        rewind(file);
+
+        while (fgets(line, sizeof(line), file))
+        {
+            line[strcspn(line, "\r\n")] = 0;
+
+            if ((line[0] == '#') || (sscanf(line, "%15s", kind) != 1))
+            {
+                continue;
+            }
+
+            if (!strcmp(kind, "coiot") && (sscanf(line, "%*s %63s %n", device_id, &consumed) == 1))
+            {
+                ss_coiot(socket_fd, &coiot, device_id, line + consumed);
+            }
+            else if (!strcmp(kind, "webhook") && (sscanf(line, "%*s %15s %d %d", ip, &channel, &on) == 3))
+            {
+                ss_webhook(&http, ip, channel, on);
+            }
+            else if (!strcmp(kind, "sleep") && (sscanf(line, "%*s %d", &ms) == 1))
+            {
+                pause.tv_sec = ms / 1000;
+                pause.tv_nsec = (ms % 1000) * 1000000L;
+                nanosleep(&pause, NULL);
+            }
+            else
+            {
+                fprintf(stderr, "ignored: %s\n", line);
+            }
+        }
+    }
+
+    fclose(file);
+    close(socket_fd);
+
+    printf("%u coiot frames, %u webhooks sent\n", ss_frames, ss_webhooks);
+
+    return(0);
+}
+
+/*!
+ * \brief Print usage
+ *
+ * \param[in]  program   argv[0]
+ *
+ * \return nothing
+ */
+static void ss_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s -f frames [options]\n"
+            "  -f file          recorded frames to replay\n"
+            "  -a address:port  where to send coiot frames (default %s:%d)\n"
+            "  -w address:port  home controller web server for webhooks (default 127.0.0.1:80)\n"
+            "  -r count         replay the file this many times (default 1)\n",
+            program, SS_COIOT_GROUP, SS_COIOT_PORT);
+}
+
+/*!
+ * \brief Append a CoAP option, options must be added in increasing order
+ *
+ * \param[in,out]  frame           frame being built
+ * \param[in]      length          bytes in frame
+ * \param[in,out]  last            number of the previous option
+ * \param[in]      number          option number
+ * \param[in]      value           option value
+ * \param[in]      value_length    bytes in value, less than 269
+ *
+ * \return new length of frame
+ */
+static int ss_option(uint8_t *frame, int length, int *last, int number, const uint8_t *value, int value_length)
+{
+    int delta = number - *last;
+    int header = length++;
+
+    // 13 and 14 mean one or two bytes of extended value follow
+    if (delta >= 269)
+    {
+        frame[header] = 14 << 4;
+        frame[length++] = (uint8_t)((delta - 269) >> 8);
+        frame[length++] = (uint8_t)(delta - 269);
+    }
+    else if (delta >= 13)
+    {
+        frame[header] = 13 << 4;
+        frame[length++] = (uint8_t)(delta - 13);
+    }
+    else
+    {
+        frame[header] = (uint8_t)(delta << 4);
+    }
+
+    if (value_length >= 13)
+    {
+        frame[header] |= 13;
+        frame[length++] = (uint8_t)(value_length - 13);
+    }
+    else
+    {
+        frame[header] |= (uint8_t)value_length;
+    }
+
+    memcpy(&frame[length], value, value_length);
+    *last = number;
+
+    return(length + value_length);
+}
+
+/*!
+ * \brief Send one CoIoT status frame
+ *
+ * \param[in]  socket_fd       udp socket
+ * \param[in]  destination     group or unicast address
+ * \param[in]  device_id       e.g. SHSW-25#A4CF12F45A77#2
+ * \param[in]  payload         json status
+ *
+ * \return 0 on success, -1 on error
+ */
+static int ss_coiot(int socket_fd, const struct sockaddr_in *destination, const char *device_id, const char *payload)
+{
+    uint8_t frame[SS_FRAME_MAX];
+    uint8_t value[2];
+    int payload_length = strlen(payload);
+    int device_id_length = strlen(device_id);
+    int length = 0;
+    int last = 0;
+
+    if ((device_id_length > 255) || (payload_length + device_id_length + 32 > (int)sizeof(frame)))
+    {
+        fprintf(stderr, "frame too long\n");
+        return(-1);
+    }
+
+    // version 1, non-confirmable, no token
+    frame[length++] = 0x50;
+    frame[length++] = SS_COIOT_CODE_STATUS;
+    frame[length++] = (uint8_t)(ss_message_id >> 8);
+    frame[length++] = (uint8_t)ss_message_id;
+    ss_message_id++;
+
+    length = ss_option(frame, length, &last, SS_OPTION_DEVICE_ID, (const uint8_t *)device_id, device_id_length);
+    value[0] = 0;
+    value[1] = 38;
+    length = ss_option(frame, length, &last, SS_OPTION_VALIDITY, value, 2);
+    value[0] = (uint8_t)(ss_serial >> 8);
+    value[1] = (uint8_t)ss_serial;
+    length = ss_option(frame, length, &last, SS_OPTION_SERIAL, value, 2);
+    ss_serial++;
+
+    frame[length++] = 0xff;
+    memcpy(&frame[length], payload, payload_length);
+    length += payload_length;
+
+    if (sendto(socket_fd, frame, length, 0, (const struct sockaddr *)destination, sizeof(*destination)) != length)
+    {
+        perror("sendto");
+        return(-1);
+    }
+
+    ss_frames++;
+
+    return(0);
+}
+
+/*!
+ * \brief Call the home controller the way a gen2 webhook does
+ *
+ * \param[in]  destination     home controller web server
+ * \param[in]  ip              address of the device raising the event
+ * \param[in]  channel         relay number
+ * \param[in]  on              new relay state
+ *
+ * \return 0 if the request was answered, -1 on error
+ */
+static int ss_webhook(const struct sockaddr_in *destination, const char *ip, int channel, int on)
+{
+    char request[256];
+    char response[256];
+    int socket_fd;
+    int length;
+    int err = -1;
+
+    length = snprintf(request, sizeof(request),
+                      "GET /shelly_event.cgi?ip=%s&ch=%d&on=%d HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n",
+                      ip, channel, on, inet_ntoa(destination->sin_addr));
+
+    socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+    {
+        perror("socket");
+        return(-1);
+    }
+
+    if (connect(socket_fd, (const struct sockaddr *)destination, sizeof(*destination)) < 0)
+    {
+        fprintf(stderr, "cannot connect to %s:%d: %s\n", inet_ntoa(destination->sin_addr), ntohs(destination->sin_port), strerror(errno));
+    }
+    else if ((send(socket_fd, request, length, 0) == length) && (recv(socket_fd, response, sizeof(response), 0) > 0))
+    {
+        ss_webhooks++;
+        err = 0;
+    }
+
+    close(socket_fd);
+
+    return(err);
+}
+
+/*!
+ * \brief Parse address or address:port
+ *
+ * \param[in]   text            address text
+ * \param[in]   default_port    port if none is given
+ * \param[out]  address         socket address
+ *
+ * \return 0 on success, -1 if the address is invalid
+ */
+static int ss_address(const char *text, int default_port, struct sockaddr_in *address)
+{
+    char host[32];
+    const char *colon = strchr(text, ':');
+    int length = colon ? colon - text : (int)strlen(text);
+
+    if (length >= (int)sizeof(host))
+    {
+        return(-1);
+    }
+    memcpy(host, text, length);
+    host[length] = 0;
+
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_port = htons(colon ? atoi(colon + 1) : default_port);
+
+    return((inet_pton(AF_INET, host, &address->sin_addr) == 1) ? 0 : -1);
+}
@@ -0,0 +1,549 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "lwip/udp.h"
+#include "shelly_status.h"
+
+/*
+ * Shelly status decoding test
+ *
+ * Links shelly_status.c unchanged against the udp pcb stand-in in client/shim and replays the recorded frames that
+ * shelly_standin sends (shelly_frames.txt by default).  CoIoT frames are built the way shelly_standin builds them and
+ * delivered to the CoIoT port, each device id from its own address starting at ST_ADDRESS, and webhooks are passed to
+ * shelly_status_webhook() with the parameters the gen2 devices send.
+ *
+ * Checks that:
+ *
+ *   - starting binds the CoIoT port and joins 224.0.1.187
+ *   - every frame is found to be a status frame, with the payload where it was put and the serial it carries
+ *   - malformed CoAP headers and webhooks are rejected
+ *   - each frame or webhook changes the table exactly when an output or input changes, as listed in ST_CHANGES
+ *   - the table after the replay holds the states in st_expected, which must follow shelly_frames.txt
+ *   - the first device's last frame split into a pbuf chain at every offset, each time after its first frame has
+ *     turned its relays off again, decodes to the same state
+ *   - every pbuf is freed
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#define ST_ADDRESS              (0xc0a80115u)       // 192.168.1.21, host order, the first coiot device
+#define ST_DEVICES_MAX          (8)
+#define ST_FRAME_MAX            (1400)
+#define ST_LINE_MAX             (2048)
+#define ST_OPTION_DEVICE_ID     (3332)
+#define ST_OPTION_VALIDITY      (3412)
+#define ST_OPTION_SERIAL        (3420)
+#define ST_CHANGES              "1110111"           // whether each frame or webhook in shelly_frames.txt changes the table
+
+typedef struct
+{
+    uint8_t data[ST_FRAME_MAX];
+    int length;
+    int payload_offset;
+    uint16_t serial;
+} ST_FRAME_T;
+
+// prototypes
+static void st_usage(const char *program);
+static bool st_replay(const char *frames);
+static bool st_table(void);
+static bool st_malformed(void);
+static bool st_chained(const ST_FRAME_T *first, const ST_FRAME_T *last, uint32_t ip);
+static bool st_coiot(const char *device_id, const char *payload, ST_FRAME_T *frame, uint32_t *ip);
+static int st_option(uint8_t *frame, int length, int *last, int number, const uint8_t *value, int value_length);
+static void st_deliver(const ST_FRAME_T *frame, uint32_t ip, int split);
+static bool st_same(const SHELLY_STATUS_T *status, const SHELLY_STATUS_T *expected);
+
+// static variables
+static const SHELLY_STATUS_T st_expected[] =
+{
+    // shelly 2.5: both relays on, input 0 toggled relay 0, meters from the last frame
+    {.ip = 0xc0a80115, .source = SHELLY_SOURCE_COIOT, .output = 3, .input = 1, .known = 3, .power_x10 = {213, 586}, .temperature_x10 = 427, .serial = 4},
+    // shelly 1 on v1 firmware: relay on, input off, no temperature
+    {.ip = 0xc0a80116, .source = SHELLY_SOURCE_COIOT, .output = 1, .input = 0, .known = 1, .power_x10 = {0, 0}, .temperature_x10 = SHELLY_TEMPERATURE_UNKNOWN, .serial = 5},
+    {.ip = 0xc0a8011f, .source = SHELLY_SOURCE_WEBHOOK, .output = 1, .input = 0, .known = 1, .power_x10 = {0, 0}, .temperature_x10 = SHELLY_TEMPERATURE_UNKNOWN, .serial = 0},
+    {.ip = 0xc0a80120, .source = SHELLY_SOURCE_WEBHOOK, .output = 0, .input = 0, .known = 2, .power_x10 = {0, 0}, .temperature_x10 = SHELLY_TEMPERATURE_UNKNOWN, .serial = 0},
+};
+static char st_device_ids[ST_DEVICES_MAX][64];
+static int st_devices = 0;
+static uint16_t st_serial = 1;
+
+int main(int argc, char *argv[])
+{
+    const char *frames = "shelly_frames.txt";
+    bool passed = true;
+    ip4_addr_t group;
+    int option;
+
+    while ((option = getopt(argc, argv, "f:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'f':
+                frames = optarg;
+                break;
+            default:
+                st_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    IP4_ADDR(&group, 224, 0, 1, 187);
+
+    if ((shelly_status_start() != 0) || (shelly_status_start() != 0))
+    {
+        printf("shelly_status_start() failed\n");
+        return(1);
+    }
+
+    passed &= (shim_udp_pcbs == 1) && (shim_igmp_groups == 1) && (shim_igmp_group.addr == group.addr);
+    printf("start: %s\n", passed ? "ok" : "wrong pcb or group");
+
+    passed &= st_malformed();
+    passed &= st_replay(frames);
+
+    printf("%ld pbuf bytes not freed\n", shim_pbuf_bytes);
+    passed &= (shim_pbuf_bytes == 0);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void st_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-f recorded frames]\n", program);
+}
+
+/*!
+ * \brief Replay the recorded frames and webhooks, then check the table
+ *
+ * \param[in]  frames   file of recorded frames, as read by shelly_standin
+ *
+ * \return true if every check passed
+ */
+static bool st_replay(const char *frames)
+{
+    ST_FRAME_T frame;
+    ST_FRAME_T first_frame = {0};
+    ST_FRAME_T last_frame = {0};
+    FILE *file;
+    char line[ST_LINE_MAX];
+    char changes[64] = "";
+    char kind[16];
+    char device_id[64];
+    char ip[16];
+    char channel[16];
+    char on[16];
+    char *params[] = {"ip", "ch", "on"};
+    char *values[] = {ip, channel, on};
+    uint32_t sequence;
+    uint32_t last_ip = 0;
+    uint32_t source;
+    bool passed = true;
+    int events = 0;
+    int offset;
+    int consumed;
+
+    file = fopen(frames, "r");
+    if (!file)
+    {
+        printf("cannot open %s: %s\n", frames, strerror(errno));
+        return(false);
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+
+        if ((line[0] == '#') || (sscanf(line, "%15s", kind) != 1) || !strcmp(kind, "sleep"))
+        {
+            continue;
+        }
+
+        sequence = shelly_status_sequence();
+
+        if (!strcmp(kind, "coiot") && (sscanf(line, "%*s %63s %n", device_id, &consumed) == 1))
+        {
+            if (!st_coiot(device_id, line + consumed, &frame, &source))
+            {
+                printf("too many devices or frame too long: %s\n", line);
+                passed = false;
+                continue;
+            }
+
+            if ((shelly_status_decode_coiot(frame.data, frame.length, &offset, &frame.serial) != 0) ||
+                (offset != frame.payload_offset) || (frame.serial != st_serial - 1))
+            {
+                printf("%s: not decoded as a status frame with serial %u\n", device_id, st_serial - 1);
+                passed = false;
+            }
+
+            st_deliver(&frame, source, frame.length);
+
+            if (source == ST_ADDRESS)
+            {
+                if (!last_ip)
+                {
+                    first_frame = frame;
+                }
+                last_frame = frame;
+                last_ip = source;
+            }
+        }
+        else if (!strcmp(kind, "webhook") && (sscanf(line, "%*s %15s %15s %15s", ip, channel, on) == 3))
+        {
+            if (shelly_status_webhook(3, params, values) != 0)
+            {
+                printf("webhook rejected: %s\n", line);
+                passed = false;
+            }
+        }
+        else
+        {
+            printf("ignored: %s\n", line);
+            continue;
+        }
+
+        if (events < (int)sizeof(changes) - 1)
+        {
+            changes[events++] = (shelly_status_sequence() != sequence) ? '1' : '0';
+            changes[events] = 0;
+        }
+    }
+
+    fclose(file);
+
+    printf("changes %s, expected %s: %s\n", changes, ST_CHANGES, strcmp(changes, ST_CHANGES) ? "FAILED" : "ok");
+    passed &= !strcmp(changes, ST_CHANGES);
+
+    passed &= st_table();
+
+    if (last_ip)
+    {
+        passed &= st_chained(&first_frame, &last_frame, last_ip);
+    }
+
+    return(passed);
+}
+
+/*!
+ * \brief Compare the table with the states expected after the replay
+ *
+ * \return true if every check passed
+ */
+static bool st_table(void)
+{
+    SHELLY_STATUS_T table[SHELLY_STATUS_DEVICES];
+    bool passed;
+    int found = 0;
+    int count;
+    int i;
+    int j;
+
+    count = shelly_status_snapshot(table, SHELLY_STATUS_DEVICES, NULL);
+    passed = (count == LWIP_ARRAYSIZE(st_expected));
+
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; (j < (int)LWIP_ARRAYSIZE(st_expected)) && (table[i].ip != st_expected[j].ip); j++);
+
+        if ((j < (int)LWIP_ARRAYSIZE(st_expected)) && st_same(&table[i], &st_expected[j]))
+        {
+            found++;
+            continue;
+        }
+
+        printf("0x%08x: source %u output %u input %u known %u power %d %d temperature %d serial %u is not expected\n",
+               table[i].ip, table[i].source, table[i].output, table[i].input, table[i].known,
+               table[i].power_x10[0], table[i].power_x10[1], table[i].temperature_x10, table[i].serial);
+        passed = false;
+    }
+
+    printf("%d of %d devices as expected: %s\n", found, (int)LWIP_ARRAYSIZE(st_expected), passed ? "ok" : "FAILED");
+
+    return(passed);
+}
+
+/*!
+ * \brief Check malformed CoAP headers and webhooks are rejected
+ *
+ * \return true if every check passed
+ */
+static bool st_malformed(void)
+{
+    static const struct
+    {
+        const char *name;
+        int length;
+        uint8_t header[16];
+    } headers[] =
+    {
+        {"version 2",                       5,  {0x90, 30, 0, 1, 0xff}},
+        {"coap content code",               5,  {0x50, 69, 0, 1, 0xff}},
+        {"token past the end",              5,  {0x58, 30, 0, 1, 0xff}},
+        {"no payload marker",               7,  {0x50, 30, 0, 1, 0x12, 0, 1}},
+        {"option past the end",             7,  {0x50, 30, 0, 1, 0x14, 0, 1}},
+        {"extended delta cut short",        6,  {0x50, 30, 0, 1, 0xe0, 0x0c}},
+        {"extended length cut short",       6,  {0x50, 30, 0, 1, 0x0d, 0xff}},
+        {"reserved delta",                  6,  {0x50, 30, 0, 1, 0xf0, 0xff}},
+        {"reserved length",                 6,  {0x50, 30, 0, 1, 0x0f, 0xff}},
+        {"header cut short",                3,  {0x50, 30, 0}},
+    };
+    static const struct
+    {
+        const char *name;
+        int count;
+        char *params[3];
+        char *values[3];
+    } webhooks[] =
+    {
+        {"no address",                      2,  {"ch", "on"},       {"0", "1"}},
+        {"bad address",                     3,  {"ip", "ch", "on"}, {"192.168.1.999", "0", "1"}},
+        {"channel past the last",           3,  {"ip", "ch", "on"}, {"192.168.1.40", "2", "1"}},
+        {"negative channel",                3,  {"ip", "ch", "on"}, {"192.168.1.40", "-1", "1"}},
+        {"no state",                        2,  {"ip", "ch"},       {"192.168.1.40", "0"}},
+    };
+    uint32_t sequence = shelly_status_sequence();
+    uint16_t serial;
+    bool passed = true;
+    int offset;
+    int i;
+
+    for (i = 0; i < (int)LWIP_ARRAYSIZE(headers); i++)
+    {
+        if (shelly_status_decode_coiot(headers[i].header, headers[i].length, &offset, &serial) != -1)
+        {
+            printf("header with %s accepted\n", headers[i].name);
+            passed = false;
+        }
+    }
+
+    for (i = 0; i < (int)LWIP_ARRAYSIZE(webhooks); i++)
+    {
+        if (shelly_status_webhook(webhooks[i].count, (char **)webhooks[i].params, (char **)webhooks[i].values) != -1)
+        {
+            printf("webhook with %s accepted\n", webhooks[i].name);
+            passed = false;
+        }
+    }
+
+    passed &= (shelly_status_sequence() == sequence);
+
+    printf("%d malformed headers and %d webhooks: %s\n", (int)LWIP_ARRAYSIZE(headers), (int)LWIP_ARRAYSIZE(webhooks),
+           passed ? "ok" : "FAILED");
+
+    return(passed);
+}
+
+/*!
+ * \brief Deliver a device's last frame again split into a pbuf chain at every offset, after its first frame each time
+ *
+ * \param[in]  first    first frame delivered from ip, with its relays in another state
+ * \param[in]  last     last frame delivered from ip
+ * \param[in]  ip       device address, host order
+ *
+ * \return true if every check passed
+ */
+static bool st_chained(const ST_FRAME_T *first, const ST_FRAME_T *last, uint32_t ip)
+{
+    SHELLY_STATUS_T table[SHELLY_STATUS_DEVICES];
+    uint32_t sequence = shelly_status_sequence();
+    bool passed = true;
+    int count;
+    int split;
+    int i;
+    int j;
+
+    for (split = 1; split < last->length; split++)
+    {
+        st_deliver(first, ip, first->length);
+        st_deliver(last, ip, split);
+
+        count = shelly_status_snapshot(table, SHELLY_STATUS_DEVICES, NULL);
+        for (i = 0; (i < count) && (table[i].ip != ip); i++);
+        for (j = 0; (j < (int)LWIP_ARRAYSIZE(st_expected)) && (st_expected[j].ip != ip); j++);
+
+        if ((i == count) || (j == (int)LWIP_ARRAYSIZE(st_expected)) || !st_same(&table[i], &st_expected[j]))
+        {
+            printf("frame split at %d decoded differently\n", split);
+            passed = false;
+            break;
+        }
+    }
+
+    passed &= (shelly_status_sequence() - sequence == 2*(uint32_t)(last->length - 1));
+
+    printf("frame split at each of %d offsets: %s\n", last->length - 1, passed ? "ok" : "FAILED");
+
+    return(passed);
+}
+
+/*!
+ * \brief Build a CoIoT status frame as shelly_standin does and pick the address of the device sending it
+ *
+ * \param[in]  device_id    e.g. SHSW-25#A4CF12F45A77#2
+ * \param[in]  payload      json status
+ * \param[out] frame        frame
+ * \param[out] ip           device address, host order
+ *
+ * \return false if there are too many devices or the frame is too long
+ */
+static bool st_coiot(const char *device_id, const char *payload, ST_FRAME_T *frame, uint32_t *ip)
+{
+    uint8_t value[2];
+    int payload_length = strlen(payload);
+    int device_id_length = strlen(device_id);
+    int last = 0;
+    int i;
+
+    for (i = 0; (i < st_devices) && strcmp(st_device_ids[i], device_id); i++);
+
+    if (i == st_devices)
+    {
+        if ((st_devices == ST_DEVICES_MAX) || (device_id_length >= (int)sizeof(st_device_ids[0])))
+        {
+            return(false);
+        }
+        strcpy(st_device_ids[st_devices++], device_id);
+    }
+    *ip = ST_ADDRESS + i;
+
+    if (payload_length + device_id_length + 32 > (int)sizeof(frame->data))
+    {
+        return(false);
+    }
+
+    // version 1, non-confirmable, no token
+    frame->length = 0;
+    frame->data[frame->length++] = 0x50;
+    frame->data[frame->length++] = 30;
+    frame->data[frame->length++] = 0;
+    frame->data[frame->length++] = 1;
+
+    frame->length = st_option(frame->data, frame->length, &last, ST_OPTION_DEVICE_ID, (const uint8_t *)device_id, device_id_length);
+    value[0] = 0;
+    value[1] = 38;
+    frame->length = st_option(frame->data, frame->length, &last, ST_OPTION_VALIDITY, value, 2);
+    value[0] = (uint8_t)(st_serial >> 8);
+    value[1] = (uint8_t)st_serial;
+    frame->length = st_option(frame->data, frame->length, &last, ST_OPTION_SERIAL, value, 2);
+    st_serial++;
+
+    frame->data[frame->length++] = 0xff;
+    frame->payload_offset = frame->length;
+    memcpy(&frame->data[frame->length], payload, payload_length);
+    frame->length += payload_length;
+
+    return(true);
+}
+
+/*!
+ * \brief Append a CoAP option, as shelly_standin does
+ *
+ * \param[out]    frame           frame
+ * \param[in]     length          current length of frame
+ * \param[in,out] last            number of the previous option
+ * \param[in]     number          option number, not less than last
+ * \param[in]     value           option value
+ * \param[in]     value_length    bytes of value, less than 269
+ *
+ * \return new length of frame
+ */
+static int st_option(uint8_t *frame, int length, int *last, int number, const uint8_t *value, int value_length)
+{
+    int delta = number - *last;
+    int header = length++;
+
+    if (delta >= 269)
+    {
+        frame[header] = 14 << 4;
+        frame[length++] = (uint8_t)((delta - 269) >> 8);
+        frame[length++] = (uint8_t)(delta - 269);
+    }
+    else if (delta >= 13)
+    {
+        frame[header] = 13 << 4;
+        frame[length++] = (uint8_t)(delta - 13);
+    }
+    else
+    {
+        frame[header] = (uint8_t)(delta << 4);
+    }
+
+    if (value_length >= 13)
+    {
+        frame[header] |= 13;
+        frame[length++] = (uint8_t)(value_length - 13);
+    }
+    else
+    {
+        frame[header] |= (uint8_t)value_length;
+    }
+
+    memcpy(&frame[length], value, value_length);
+    *last = number;
+
+    return(length + value_length);
+}
+
+/*!
+ * \brief Deliver a frame to the CoIoT port as the tcpip thread would
+ *
+ * \param[in]  frame    frame
+ * \param[in]  ip       address it comes from, host order
+ * \param[in]  split    bytes in the first pbuf, the rest follow in a second
+ *
+ * \return nothing
+ */
+static void st_deliver(const ST_FRAME_T *frame, uint32_t ip, int split)
+{
+    struct pbuf *p;
+    ip_addr_t from;
+
+    from.addr = htonl(ip);
+
+    p = pbuf_alloc(PBUF_TRANSPORT, split, PBUF_RAM);
+    pbuf_take(p, frame->data, split);
+    if (split < frame->length)
+    {
+        p->next = pbuf_alloc(PBUF_TRANSPORT, frame->length - split, PBUF_RAM);
+        pbuf_take(p->next, &frame->data[split], frame->length - split);
+        p->tot_len = frame->length;
+    }
+
+    shim_udp_input(p, &from, SHELLY_COIOT_PORT, SHELLY_COIOT_PORT);
+}
+
+/*!
+ * \brief Compare the reported fields of a device with those expected
+ *
+ * \param[in]  status       device from the table
+ * \param[in]  expected     expected state
+ *
+ * \return true if they match
+ */
+static bool st_same(const SHELLY_STATUS_T *status, const SHELLY_STATUS_T *expected)
+{
+    return((status->ip == expected->ip) && (status->source == expected->source) && (status->output == expected->output) &&
+           (status->input == expected->input) && (status->known == expected->known) &&
+           (status->power_x10[0] == expected->power_x10[0]) && (status->power_x10[1] == expected->power_x10[1]) &&
+           (status->temperature_x10 == expected->temperature_x10) && (status->serial == expected->serial));
+}
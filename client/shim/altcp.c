@@ -0,0 +1,1003 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#define _GNU_SOURCE                     // SOCK_NONBLOCK
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+
+#include "shim.h"
+
+/*
+ * Host stand-in for lwIP altcp connections, see shim.h
+ *
+ * Each pcb is a non-blocking socket.  A thread standing in for the tcpip thread polls them and, holding the lwIP core
+ * lock, runs the connected, recv, sent, poll and err callbacks as lwIP would: recv gets each read as a chain of pbufs
+ * of at most shim_pbuf_size bytes, or NULL once the server has closed, sent is called once everything written has
+ * gone to the socket, and err is called with the pcb already gone when the connection fails or is reset.  A pcb closed
+ * or aborted by the firmware gets no more callbacks and is freed by the thread.
+ *
+ * Tls connections are OpenSSL connections limited to TLS 1.2, without certificate checks, as the firmware's mbedtls
+ * client config has none.  The mbedtls session calls the firmware makes are mapped onto OpenSSL sessions, so offered
+ * sessions are resumed by servers that issue tickets or keep a session cache.
+ */
+
+#define SHIM_PCBS_MAX           (64)
+#define SHIM_READ_MAX           (1460)          // TCP_MSS
+#define SHIM_LOOP_MS            (2)             // longest wait before the poll timers are checked
+#define SHIM_POLL_MS            (500)           // lwip's poll interval unit
+
+struct SHIM_SOCKET
+{
+    int fd;
+    SSL *ssl;                           // tls connections, once the socket is connected
+    bool tls;
+    bool connecting;                    // waiting for the socket to connect
+    bool handshaking;                   // waiting for the tls handshake
+    bool dead;                          // closed, aborted or failed, freed by the thread
+    char *out;                          // written but not yet sent
+    int out_length;
+    int out_size;
+    int unacked;                        // sent, reported to the sent callback when out empties
+    int queued;                         // writes since the last sent callback
+    uint64_t next_poll_us;
+};
+
+// prototypes
+static struct altcp_pcb *shim_pcb_new(bool tls);
+static int shim_flush(struct altcp_pcb *pcb);
+static void shim_shut(struct altcp_pcb *pcb, bool graceful);
+static void shim_fail(struct altcp_pcb *pcb, err_t err);
+static void shim_connected(struct altcp_pcb *pcb);
+static void shim_handshake(struct altcp_pcb *pcb);
+static void shim_acknowledge(struct altcp_pcb *pcb);
+static void shim_readable(struct altcp_pcb *pcb);
+static struct pbuf *shim_pbuf_chain(const char *data, int length);
+static void shim_reap(void);
+static void *shim_altcp_thread(void *arg);
+
+// external variables
+int shim_pbuf_size = 512;
+int shim_sockets_max = 0;
+
+// static variables
+static struct altcp_pcb *shim_pcbs[SHIM_PCBS_MAX];
+static struct altcp_tls_config *shim_tls_config = NULL;
+static SSL_CTX *shim_ssl_context = NULL;
+static pthread_t shim_thread;
+static volatile bool shim_running = false;
+
+/*!
+ * \brief Start the thread standing in for the tcpip thread
+ *
+ * \return nothing
+ */
+void shim_altcp_start(void)
+{
+    if (!shim_ssl_context)
+    {
+        shim_ssl_context = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_max_proto_version(shim_ssl_context, TLS1_2_VERSION);
+        SSL_CTX_set_session_cache_mode(shim_ssl_context, SSL_SESS_CACHE_CLIENT);
+        SSL_CTX_set_options(shim_ssl_context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+    }
+
+    shim_running = true;
+    pthread_create(&shim_thread, NULL, shim_altcp_thread, NULL);
+}
+
+/*!
+ * \brief Stop the thread, connections still open get no more callbacks
+ *
+ * \return nothing
+ */
+void shim_altcp_stop(void)
+{
+    shim_running = false;
+    pthread_join(shim_thread, NULL);
+}
+
+/*!
+ * \brief New tcp connection
+ *
+ * \param[in]  ip_type  IPADDR_TYPE_V4
+ *
+ * \return pcb or NULL
+ */
+struct altcp_pcb *altcp_tcp_new_ip_type(__unused u8_t ip_type)
+{
+    return(shim_pcb_new(false));
+}
+
+/*!
+ * \brief Tls client config, no certificate checks as with a NULL ca
+ *
+ * \param[in]  ca       unused
+ * \param[in]  ca_len   unused
+ *
+ * \return config
+ */
+struct altcp_tls_config *altcp_tls_create_config_client(__unused const u8_t *ca, __unused size_t ca_len)
+{
+    static int config;
+
+    shim_tls_config = (struct altcp_tls_config *)&config;
+
+    return(shim_tls_config);
+}
+
+/*!
+ * \brief New tls connection
+ *
+ * \param[in]  config   from altcp_tls_create_config_client()
+ * \param[in]  ip_type  IPADDR_TYPE_V4
+ *
+ * \return pcb or NULL
+ */
+struct altcp_pcb *altcp_tls_new(struct altcp_tls_config *config, __unused u8_t ip_type)
+{
+    if (!config || (config != shim_tls_config))
+    {
+        return(NULL);
+    }
+
+    return(shim_pcb_new(true));
+}
+
+/*!
+ * \brief Set the argument passed to the callbacks
+ *
+ * \param[in]  pcb  connection
+ * \param[in]  arg  argument
+ *
+ * \return nothing
+ */
+void altcp_arg(struct altcp_pcb *pcb, void *arg)
+{
+    pcb->arg = arg;
+}
+
+/*!
+ * \brief Set the receive callback
+ *
+ * \param[in]  pcb      connection
+ * \param[in]  recv     callback
+ *
+ * \return nothing
+ */
+void altcp_recv(struct altcp_pcb *pcb, altcp_recv_fn recv)
+{
+    pcb->recv = recv;
+}
+
+/*!
+ * \brief Set the sent callback
+ *
+ * \param[in]  pcb      connection
+ * \param[in]  sent     callback
+ *
+ * \return nothing
+ */
+void altcp_sent(struct altcp_pcb *pcb, altcp_sent_fn sent)
+{
+    pcb->sent = sent;
+}
+
+/*!
+ * \brief Set the poll callback
+ *
+ * \param[in]  pcb          connection
+ * \param[in]  poll         callback
+ * \param[in]  interval     half seconds between calls
+ *
+ * \return nothing
+ */
+void altcp_poll(struct altcp_pcb *pcb, altcp_poll_fn poll, u8_t interval)
+{
+    pcb->poll = poll;
+    pcb->pollinterval = interval;
+    pcb->socket->next_poll_us = time_us_64() + (uint64_t)interval*SHIM_POLL_MS*1000;
+}
+
+/*!
+ * \brief Set the error callback
+ *
+ * \param[in]  pcb  connection
+ * \param[in]  err  callback
+ *
+ * \return nothing
+ */
+void altcp_err(struct altcp_pcb *pcb, altcp_err_fn err)
+{
+    pcb->err = err;
+}
+
+/*!
+ * \brief Start connecting, the connected callback runs once the socket (and handshake) are done
+ *
+ * \param[in]  pcb          connection
+ * \param[in]  ipaddr       server address
+ * \param[in]  port         server port
+ * \param[in]  connected    callback
+ *
+ * \return ERR_OK, or ERR_CONN if the connection cannot be started
+ */
+err_t altcp_connect(struct altcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port, altcp_connected_fn connected)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    struct sockaddr_in server;
+    int one = 1;
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    server.sin_addr.s_addr = ipaddr->addr;
+
+    if ((socket_state->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
+    {
+        return(ERR_CONN);
+    }
+    setsockopt(socket_state->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    pcb->connected = connected;
+    socket_state->connecting = true;
+    if (connect(socket_state->fd, (struct sockaddr *)&server, sizeof(server)) && (errno != EINPROGRESS))
+    {
+        return(ERR_CONN);
+    }
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Queue data to send, copied
+ *
+ * \param[in]  pcb      connection
+ * \param[in]  data     data
+ * \param[in]  len      length
+ * \param[in]  flags    TCP_WRITE_FLAG_COPY
+ *
+ * \return ERR_OK, ERR_MEM if there is no room or ERR_CONN if the connection is not open
+ */
+err_t altcp_write(struct altcp_pcb *pcb, const void *data, u16_t len, __unused u8_t flags)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    char *out;
+
+    if (socket_state->dead || socket_state->connecting || socket_state->handshaking)
+    {
+        return(ERR_CONN);
+    }
+    if ((len > altcp_sndbuf(pcb)) || (socket_state->queued >= TCP_SND_QUEUELEN))
+    {
+        return(ERR_MEM);
+    }
+
+    if (socket_state->out_length + len > socket_state->out_size)
+    {
+        if (!(out = realloc(socket_state->out, socket_state->out_length + len)))
+        {
+            return(ERR_MEM);
+        }
+        socket_state->out = out;
+        socket_state->out_size = socket_state->out_length + len;
+    }
+
+    memcpy(socket_state->out + socket_state->out_length, data, len);
+    socket_state->out_length += len;
+    socket_state->queued++;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Send what has been written
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return ERR_OK, or ERR_CONN if the socket failed
+ */
+err_t altcp_output(struct altcp_pcb *pcb)
+{
+    return(shim_flush(pcb) ? ERR_CONN : ERR_OK);
+}
+
+/*!
+ * \brief Room in the send buffer
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return bytes
+ */
+u16_t altcp_sndbuf(struct altcp_pcb *pcb)
+{
+    int room = TCP_SND_BUF - pcb->socket->out_length - pcb->socket->unacked;
+
+    return((room > 0) ? room : 0);
+}
+
+/*!
+ * \brief Writes queued in the send buffer
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return writes
+ */
+u16_t altcp_sndqueuelen(struct altcp_pcb *pcb)
+{
+    return(pcb->socket->queued);
+}
+
+/*!
+ * \brief Received data has been taken, the socket buffer needs no window update
+ *
+ * \param[in]  pcb  connection
+ * \param[in]  len  bytes
+ *
+ * \return nothing
+ */
+void altcp_recved(__unused struct altcp_pcb *pcb, __unused u16_t len)
+{
+}
+
+/*!
+ * \brief Close gracefully, the pcb gets no more callbacks
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return ERR_OK
+ */
+err_t altcp_close(struct altcp_pcb *pcb)
+{
+    if (pcb->socket->out_length)
+    {
+        shim_flush(pcb);
+    }
+    shim_shut(pcb, true);
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Reset the connection, the pcb gets no more callbacks
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return nothing
+ */
+void altcp_abort(struct altcp_pcb *pcb)
+{
+    shim_shut(pcb, false);
+}
+
+/*!
+ * \brief Resolve a name, only dotted addresses and localhost are known
+ *
+ * \param[in]   hostname    name
+ * \param[out]  addr        address
+ * \param[in]   found       unused, the answer is always immediate
+ * \param[in]   arg         unused
+ *
+ * \return ERR_OK, or ERR_ARG if the name is not known
+ */
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, __unused dns_found_callback found, __unused void *arg)
+{
+    struct in_addr address;
+
+    if (!strcmp(hostname, "localhost"))
+    {
+        hostname = "127.0.0.1";
+    }
+    if (!inet_aton(hostname, &address))
+    {
+        return(ERR_ARG);
+    }
+    addr->addr = address.s_addr;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Initialise a session
+ *
+ * \param[out]  session     session
+ *
+ * \return nothing
+ */
+void mbedtls_ssl_session_init(mbedtls_ssl_session *session)
+{
+    memset(session, 0, sizeof(*session));
+}
+
+/*!
+ * \brief Free a session
+ *
+ * \param[in]  session  session
+ *
+ * \return nothing
+ */
+void mbedtls_ssl_session_free(mbedtls_ssl_session *session)
+{
+    if (session->session)
+    {
+        SSL_SESSION_free((SSL_SESSION *)session->session);
+    }
+    memset(session, 0, sizeof(*session));
+}
+
+/*!
+ * \brief Copy the session of a connection whose handshake is complete
+ *
+ * \param[in]   ssl         connection
+ * \param[out]  session     session, with the master secret
+ *
+ * \return 0 on success, -1 if there is no session
+ */
+int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session)
+{
+    if (!ssl->ssl || !(session->session = SSL_get1_session((SSL *)ssl->ssl)))
+    {
+        return(-1);
+    }
+    SSL_SESSION_get_master_key((SSL_SESSION *)session->session, session->master, sizeof(session->master));
+
+    return(0);
+}
+
+/*!
+ * \brief Offer a session for resumption in the coming handshake
+ *
+ * \param[in]  ssl      connection, not yet connected
+ * \param[in]  session  session from mbedtls_ssl_get_session()
+ *
+ * \return 0 on success, -1 if there is no session
+ */
+int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session)
+{
+    if (!session->session)
+    {
+        return(-1);
+    }
+
+    SSL_SESSION_up_ref((SSL_SESSION *)session->session);
+    if (ssl->offer)
+    {
+        SSL_SESSION_free((SSL_SESSION *)ssl->offer);
+    }
+    ssl->offer = session->session;
+
+    return(0);
+}
+
+/*!
+ * \brief Set the server name sent in the handshake
+ *
+ * \param[in]  ssl          connection, not yet connected
+ * \param[in]  hostname     name
+ *
+ * \return 0 on success, -1 if the name is too long
+ */
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *hostname)
+{
+    if (strlen(hostname) >= sizeof(ssl->hostname))
+    {
+        return(-1);
+    }
+    strcpy(ssl->hostname, hostname);
+
+    return(0);
+}
+
+/*!
+ * \brief Allocate a pcb and its socket state
+ *
+ * \param[in]  tls  tls connection
+ *
+ * \return pcb, or NULL if there are too many
+ */
+static struct altcp_pcb *shim_pcb_new(bool tls)
+{
+    struct altcp_pcb *pcb;
+    int open = 0;
+    int slot = -1;
+    int i;
+
+    for (i=0; i<SHIM_PCBS_MAX; i++)
+    {
+        if (!shim_pcbs[i])
+        {
+            slot = (slot < 0) ? i : slot;
+        }
+        else if (!shim_pcbs[i]->socket->dead)
+        {
+            open++;
+        }
+    }
+
+    if ((slot < 0) || !(pcb = calloc(1, sizeof(*pcb))) || !(pcb->socket = calloc(1, sizeof(*pcb->socket))))
+    {
+        free((slot < 0) ? NULL : pcb);
+        return(NULL);
+    }
+
+    pcb->socket->fd = -1;
+    pcb->socket->tls = tls;
+    if (tls)
+    {
+        pcb->state = calloc(1, sizeof(altcp_mbedtls_state_t));
+    }
+
+    shim_pcbs[slot] = pcb;
+    if (open + 1 > shim_sockets_max)
+    {
+        shim_sockets_max = open + 1;
+    }
+
+    return(pcb);
+}
+
+/*!
+ * \brief Send as much of the written data as the socket takes
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return 0, or -1 if the socket failed
+ */
+static int shim_flush(struct altcp_pcb *pcb)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    int error;
+    int sent;
+
+    while (socket_state->out_length && !socket_state->dead)
+    {
+        if (socket_state->tls)
+        {
+            sent = SSL_write(socket_state->ssl, socket_state->out, socket_state->out_length);
+            error = (sent > 0) ? SSL_ERROR_NONE : SSL_get_error(socket_state->ssl, sent);
+            if ((error == SSL_ERROR_WANT_WRITE) || (error == SSL_ERROR_WANT_READ))
+            {
+                return(0);
+            }
+        }
+        else
+        {
+            sent = send(socket_state->fd, socket_state->out, socket_state->out_length, MSG_NOSIGNAL);
+            if ((sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+            {
+                return(0);
+            }
+        }
+
+        if (sent <= 0)
+        {
+            return(-1);
+        }
+
+        memmove(socket_state->out, socket_state->out + sent, socket_state->out_length - sent);
+        socket_state->out_length -= sent;
+        socket_state->unacked += sent;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Close the socket, the pcb is freed by the thread
+ *
+ * \param[in]  pcb          connection
+ * \param[in]  graceful     close rather than reset
+ *
+ * \return nothing
+ */
+static void shim_shut(struct altcp_pcb *pcb, bool graceful)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    struct linger linger = {1, 0};
+
+    if (socket_state->ssl)
+    {
+        if (graceful && !socket_state->handshaking && !socket_state->connecting)
+        {
+            SSL_shutdown(socket_state->ssl);
+        }
+        else if (!socket_state->handshaking && !socket_state->connecting)
+        {
+            // mbedtls keeps a session however the connection ended, openssl would no longer resume it
+            SSL_set_shutdown(socket_state->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        }
+        SSL_free(socket_state->ssl);
+        socket_state->ssl = NULL;
+        ((altcp_mbedtls_state_t *)pcb->state)->ssl_context.ssl = NULL;
+    }
+
+    if (socket_state->fd >= 0)
+    {
+        if (!graceful)
+        {
+            setsockopt(socket_state->fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+        }
+        close(socket_state->fd);
+        socket_state->fd = -1;
+    }
+
+    socket_state->dead = true;
+}
+
+/*!
+ * \brief The connection failed, lwip frees the pcb before calling err
+ *
+ * \param[in]  pcb  connection
+ * \param[in]  err  reason
+ *
+ * \return nothing
+ */
+static void shim_fail(struct altcp_pcb *pcb, err_t err)
+{
+    altcp_err_fn callback = pcb->err;
+    void *arg = pcb->arg;
+
+    shim_shut(pcb, false);
+    if (callback)
+    {
+        callback(arg, err);
+    }
+}
+
+/*!
+ * \brief The socket has connected, or failed to
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return nothing
+ */
+static void shim_connected(struct altcp_pcb *pcb)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    mbedtls_ssl_context *context;
+    socklen_t length = sizeof(int);
+    int error = 0;
+
+    getsockopt(socket_state->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error)
+    {
+        shim_fail(pcb, ERR_RST);
+        return;
+    }
+    socket_state->connecting = false;
+
+    if (!socket_state->tls)
+    {
+        if (pcb->connected)
+        {
+            pcb->connected(pcb->arg, pcb, ERR_OK);
+        }
+        return;
+    }
+
+    context = &((altcp_mbedtls_state_t *)pcb->state)->ssl_context;
+    socket_state->ssl = SSL_new(shim_ssl_context);
+    SSL_set_mode(socket_state->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    SSL_set_fd(socket_state->ssl, socket_state->fd);
+    SSL_set_connect_state(socket_state->ssl);
+    if (context->hostname[0])
+    {
+        SSL_set_tlsext_host_name(socket_state->ssl, context->hostname);
+    }
+    if (context->offer)
+    {
+        SSL_set_session(socket_state->ssl, (SSL_SESSION *)context->offer);
+    }
+    context->ssl = socket_state->ssl;
+
+    socket_state->handshaking = true;
+    shim_handshake(pcb);
+}
+
+/*!
+ * \brief Carry on with the tls handshake, the connected callback runs when it is complete
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return nothing
+ */
+static void shim_handshake(struct altcp_pcb *pcb)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    int result;
+
+    result = SSL_do_handshake(socket_state->ssl);
+    if (result == 1)
+    {
+        socket_state->handshaking = false;
+        if (pcb->connected)
+        {
+            pcb->connected(pcb->arg, pcb, ERR_OK);
+        }
+        return;
+    }
+
+    result = SSL_get_error(socket_state->ssl, result);
+    if ((result != SSL_ERROR_WANT_READ) && (result != SSL_ERROR_WANT_WRITE))
+    {
+        shim_fail(pcb, ERR_CLSD);
+    }
+}
+
+/*!
+ * \brief Everything handed to the socket counts as acknowledged, tell the sent callback
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return nothing
+ */
+static void shim_acknowledge(struct altcp_pcb *pcb)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    int length = socket_state->unacked;
+
+    if (length && !socket_state->out_length)
+    {
+        socket_state->unacked = 0;
+        socket_state->queued = 0;
+        if (pcb->sent)
+        {
+            pcb->sent(pcb->arg, pcb, length);
+        }
+    }
+}
+
+/*!
+ * \brief Pass whatever has arrived to the recv callback, then NULL if the server has closed
+ *
+ * \param[in]  pcb  connection
+ *
+ * \return nothing
+ */
+static void shim_readable(struct altcp_pcb *pcb)
+{
+    struct SHIM_SOCKET *socket_state = pcb->socket;
+    char data[SHIM_READ_MAX];
+    struct pbuf *p;
+    int length;
+    int error;
+
+    while (!socket_state->dead)
+    {
+        if (socket_state->tls)
+        {
+            length = SSL_read(socket_state->ssl, data, sizeof(data));
+            if (length <= 0)
+            {
+                error = SSL_get_error(socket_state->ssl, length);
+                if ((error == SSL_ERROR_WANT_READ) || (error == SSL_ERROR_WANT_WRITE))
+                {
+                    return;
+                }
+                if (error != SSL_ERROR_ZERO_RETURN)
+                {
+                    shim_fail(pcb, ERR_RST);
+                    return;
+                }
+                length = 0;
+            }
+        }
+        else
+        {
+            length = recv(socket_state->fd, data, sizeof(data), 0);
+            if (length < 0)
+            {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                {
+                    return;
+                }
+                shim_fail(pcb, ERR_RST);
+                return;
+            }
+        }
+
+        if (!length)
+        {
+            // closed by the server, lwip keeps passing NULL until the pcb is closed
+            if (pcb->recv)
+            {
+                pcb->recv(pcb->arg, pcb, NULL, ERR_OK);
+            }
+            else
+            {
+                altcp_close(pcb);
+            }
+            return;
+        }
+
+        p = shim_pbuf_chain(data, length);
+        if (!pcb->recv)
+        {
+            pbuf_free(p);
+        }
+        else if (pcb->recv(pcb->arg, pcb, p, ERR_OK) == ERR_ABRT)
+        {
+            return;
+        }
+    }
+}
+
+/*!
+ * \brief Copy received data into a chain of pbufs
+ *
+ * \param[in]  data     data
+ * \param[in]  length   bytes, at least 1
+ *
+ * \return chain
+ */
+static struct pbuf *shim_pbuf_chain(const char *data, int length)
+{
+    struct pbuf *first = NULL;
+    struct pbuf **last = &first;
+    struct pbuf *p;
+    long bytes;
+    int size;
+    int offset;
+
+    for (offset=0; offset<length; offset+=size)
+    {
+        size = length - offset;
+        size = ((shim_pbuf_size > 0) && (size > shim_pbuf_size)) ? shim_pbuf_size : size;
+
+        p = malloc(sizeof(*p) + size);
+        p->next = NULL;
+        p->payload = p + 1;
+        p->len = size;
+        p->tot_len = length - offset;
+        memcpy(p->payload, data + offset, size);
+
+        *last = p;
+        last = &p->next;
+    }
+
+    bytes = __atomic_add_fetch(&shim_pbuf_bytes, length, __ATOMIC_RELAXED);
+    if (bytes > shim_pbuf_bytes_max)
+    {
+        shim_pbuf_bytes_max = bytes;
+    }
+
+    return(first);
+}
+
+/*!
+ * \brief Free the pcbs that have been closed, aborted or have failed
+ *
+ * \return nothing
+ */
+static void shim_reap(void)
+{
+    mbedtls_ssl_context *context;
+    int i;
+
+    for (i=0; i<SHIM_PCBS_MAX; i++)
+    {
+        if (shim_pcbs[i] && shim_pcbs[i]->socket->dead)
+        {
+            if (shim_pcbs[i]->state)
+            {
+                context = &((altcp_mbedtls_state_t *)shim_pcbs[i]->state)->ssl_context;
+                if (context->offer)
+                {
+                    SSL_SESSION_free((SSL_SESSION *)context->offer);
+                }
+                free(shim_pcbs[i]->state);
+            }
+            free(shim_pcbs[i]->socket->out);
+            free(shim_pcbs[i]->socket);
+            free(shim_pcbs[i]);
+            shim_pcbs[i] = NULL;
+        }
+    }
+}
+
+/*!
+ * \brief Thread standing in for the tcpip thread
+ *
+ * \param[in]  arg  unused
+ *
+ * \return NULL
+ */
+static void *shim_altcp_thread(__unused void *arg)
+{
+    struct pollfd fds[SHIM_PCBS_MAX];
+    struct altcp_pcb *polled[SHIM_PCBS_MAX];
+    struct SHIM_SOCKET *socket_state;
+    struct altcp_pcb *pcb;
+    int count;
+    int i;
+
+    while (shim_running)
+    {
+        cyw43_arch_lwip_begin();
+        for (i=count=0; i<SHIM_PCBS_MAX; i++)
+        {
+            pcb = shim_pcbs[i];
+            if (pcb && !pcb->socket->dead && (pcb->socket->fd >= 0))
+            {
+                fds[count].fd = pcb->socket->fd;
+                fds[count].events = pcb->socket->connecting ? POLLOUT : (POLLIN | (pcb->socket->out_length ? POLLOUT : 0));
+                fds[count].revents = 0;
+                polled[count++] = pcb;
+            }
+        }
+        cyw43_arch_lwip_end();
+
+        poll(fds, count, SHIM_LOOP_MS);
+
+        // pcbs are only freed by this thread, so every polled pcb is still there, if perhaps closed
+        cyw43_arch_lwip_begin();
+        for (i=0; i<count; i++)
+        {
+            pcb = polled[i];
+            socket_state = pcb->socket;
+            if (socket_state->dead || !fds[i].revents)
+            {
+                continue;
+            }
+
+            if (socket_state->connecting)
+            {
+                shim_connected(pcb);
+            }
+            else if (socket_state->handshaking)
+            {
+                shim_handshake(pcb);
+            }
+            else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                // lwip handles the ack before the data that came with it
+                shim_acknowledge(pcb);
+                if (!socket_state->dead)
+                {
+                    shim_readable(pcb);
+                }
+            }
+
+            if (!socket_state->dead && socket_state->out_length && shim_flush(pcb))
+            {
+                shim_fail(pcb, ERR_RST);
+            }
+        }
+
+        // everything handed to the socket counts as acknowledged, then the poll timers
+        for (i=0; i<SHIM_PCBS_MAX; i++)
+        {
+            pcb = shim_pcbs[i];
+            if (!pcb || pcb->socket->dead)
+            {
+                continue;
+            }
+
+            socket_state = pcb->socket;
+            shim_acknowledge(pcb);
+
+            if (!socket_state->dead && pcb->poll && (time_us_64() >= socket_state->next_poll_us))
+            {
+                socket_state->next_poll_us = time_us_64() + (uint64_t)pcb->pollinterval*SHIM_POLL_MS*1000;
+                pcb->poll(pcb->arg, pcb);
+            }
+        }
+
+        shim_reap();
+        cyw43_arch_lwip_end();
+    }
+
+    return(NULL);
+}
@@ -0,0 +1,2 @@
+// host stand-in for altcp_tls_mbedtls_structs.h, see client/shim/shim.h
+#include "shim.h"
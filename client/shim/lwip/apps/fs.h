@@ -0,0 +1,41 @@
+// host stand-in for lwip/apps/fs.h, see client/shim/shim.h
+#ifndef SHIM_FS_H
+#define SHIM_FS_H
+
+#include "shim.h"
+
+#define FS_READ_EOF                         (-1)
+#define FS_READ_DELAYED                     (-2)
+
+#define FS_FILE_FLAGS_HEADER_INCLUDED       (0x01)
+#define FS_FILE_FLAGS_HEADER_PERSISTENT     (0x02)
+#define FS_FILE_FLAGS_HEADER_HTTPVER_1_1    (0x04)
+#define FS_FILE_FLAGS_SSI                   (0x08)
+
+struct fs_file
+{
+    const char *data;
+    int len;
+    int index;
+    void *pextension;
+    u8_t flags;
+    u8_t is_custom_file;
+};
+
+typedef void (*fs_wait_cb)(void *arg);
+
+err_t fs_open(struct fs_file *file, const char *name);
+void fs_close(struct fs_file *file);
+int fs_bytes_left(struct fs_file *file);
+
+// the custom file hooks httpd calls (LWIP_HTTPD_CUSTOM_FILES)
+int fs_open_custom(struct fs_file *file, const char *name);
+void fs_close_custom(struct fs_file *file);
+u8_t fs_canread_custom(struct fs_file *file);
+u8_t fs_wait_read_custom(struct fs_file *file, fs_wait_cb callback_fn, void *callback_arg);
+int fs_read_async_custom(struct fs_file *file, char *buffer, int count, fs_wait_cb callback_fn, void *callback_arg);
+
+// host only, pages served by fs_open() in place of htmldata.c
+void shim_fs_add(const char *name, const char *data, int length, u8_t flags);
+
+#endif
@@ -0,0 +1,2 @@
+// host stand-in for lwip/def.h, see client/shim/shim.h
+#include "shim.h"
@@ -0,0 +1,2 @@
+// host stand-in for lwip/prot/iana.h, see client/shim/shim.h
+#include "shim.h"
@@ -0,0 +1,3 @@
+// host stand-in for lwip/sockets.h, see client/shim/shim.h
+#include <netinet/in.h>
+#include "shim.h"
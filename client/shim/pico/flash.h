@@ -0,0 +1,2 @@
+// host stand-in for pico/flash.h, see client/shim/shim.h
+#include "shim.h"
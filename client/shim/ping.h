@@ -0,0 +1,2 @@
+// host stand-in for the lwIP contrib ping.h, see client/shim/shim.h
+#include "shim.h"
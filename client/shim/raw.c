@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "shim.h"
+
+/*
+ * Host stand-in for lwIP raw pcbs, see shim.h
+ *
+ * raw_sendto() passes each packet, without an ip header as lwIP takes it, to the network the test puts in
+ * shim_raw_output, holding the lwIP core lock as the firmware does.  The test hands every packet its network delivers
+ * to shim_raw_input(), starting with the ip header, and it is offered to each raw pcb in turn until one eats it, as
+ * lwIP's raw_input() does.  Packets no pcb eats are freed, lwIP would pass them on to icmp_input().
+ *
+ * Timeouts are never called, the raw ping sender's periodic pings are not needed on the host.
+ */
+
+#define SHIM_RAW_PCBS_MAX       (8)
+
+struct raw_pcb
+{
+    u8_t protocol;
+    raw_recv_fn recv;
+    void *recv_arg;
+};
+
+// external variables
+err_t (*shim_raw_output)(struct pbuf *p, const ip_addr_t *destination) = NULL;
+int shim_raw_pcbs = 0;
+
+// static variables
+static struct raw_pcb *shim_pcbs[SHIM_RAW_PCBS_MAX];
+
+/*!
+ * \brief Internet checksum
+ *
+ * \param[in]  data     data
+ * \param[in]  length   bytes
+ *
+ * \return checksum, ready to store in a header
+ */
+u16_t inet_chksum(const void *data, u16_t length)
+{
+    const u8_t *byte = (const u8_t *)data;
+    u32_t sum = 0;
+    int i;
+
+    for (i = 0; i + 1 < length; i += 2)
+    {
+        sum += (byte[i] << 8) | byte[i + 1];
+    }
+
+    if (length & 1)
+    {
+        sum += byte[length - 1] << 8;
+    }
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return(htons((u16_t)~sum));
+}
+
+/*!
+ * \brief New raw pcb
+ *
+ * \param[in]  protocol     ip protocol received, e.g. IP_PROTO_ICMP
+ *
+ * \return pcb or NULL
+ */
+struct raw_pcb *raw_new(u8_t protocol)
+{
+    struct raw_pcb *pcb;
+    int i;
+
+    for (i = 0; (i < SHIM_RAW_PCBS_MAX) && shim_pcbs[i]; i++);
+
+    if (i == SHIM_RAW_PCBS_MAX)
+    {
+        return(NULL);
+    }
+
+    pcb = calloc(1, sizeof(*pcb));
+    if (pcb)
+    {
+        pcb->protocol = protocol;
+        shim_pcbs[i] = pcb;
+        shim_raw_pcbs++;
+    }
+
+    return(pcb);
+}
+
+/*!
+ * \brief Set the function called for each packet received
+ *
+ * \param[in]  pcb      pcb
+ * \param[in]  recv     returns 1 if it ate the packet
+ * \param[in]  arg      passed to recv
+ *
+ * \return nothing
+ */
+void raw_recv(struct raw_pcb *pcb, raw_recv_fn recv, void *arg)
+{
+    pcb->recv = recv;
+    pcb->recv_arg = arg;
+}
+
+/*!
+ * \brief Bind to a local address, every pcb receives from every address on the host
+ *
+ * \param[in]  pcb      pcb
+ * \param[in]  addr     local address
+ *
+ * \return ERR_OK
+ */
+err_t raw_bind(__unused struct raw_pcb *pcb, __unused const ip_addr_t *addr)
+{
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Send a packet to the test's network
+ *
+ * \param[in]  pcb      pcb
+ * \param[in]  p        packet without ip header, still owned by the caller
+ * \param[in]  addr     destination
+ *
+ * \return what shim_raw_output returns, or ERR_RTE if there is no network
+ */
+err_t raw_sendto(__unused struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr)
+{
+    if (!shim_raw_output)
+    {
+        return(ERR_RTE);
+    }
+
+    return(shim_raw_output(p, addr));
+}
+
+/*!
+ * \brief Remove a pcb, it receives nothing more
+ *
+ * \param[in]  pcb      pcb
+ *
+ * \return nothing
+ */
+void raw_remove(struct raw_pcb *pcb)
+{
+    int i;
+
+    for (i = 0; i < SHIM_RAW_PCBS_MAX; i++)
+    {
+        if (shim_pcbs[i] == pcb)
+        {
+            shim_pcbs[i] = NULL;
+            shim_raw_pcbs--;
+            free(pcb);
+            return;
+        }
+    }
+}
+
+/*!
+ * \brief Offer a received packet to each raw pcb, as the tcpip thread
+ *
+ * \param[in]  p        packet starting with its ip header, owned by whichever pcb eats it
+ * \param[in]  source   address it came from
+ *
+ * \return 1 if a pcb ate it, 0 if it was freed
+ */
+u8_t shim_raw_input(struct pbuf *p, const ip_addr_t *source)
+{
+    u8_t protocol = 0;
+    u8_t eaten = 0;
+    int i;
+
+    pbuf_copy_partial(p, &protocol, 1, 9);
+
+    cyw43_arch_lwip_begin();
+    for (i = 0; (i < SHIM_RAW_PCBS_MAX) && !eaten; i++)
+    {
+        if (shim_pcbs[i] && shim_pcbs[i]->recv && (shim_pcbs[i]->protocol == protocol))
+        {
+            eaten = shim_pcbs[i]->recv(shim_pcbs[i]->recv_arg, shim_pcbs[i], p, source);
+        }
+    }
+    cyw43_arch_lwip_end();
+
+    if (!eaten)
+    {
+        pbuf_free(p);
+    }
+
+    return(eaten);
+}
+
+/*!
+ * \brief Milliseconds since the host started
+ *
+ * \return milliseconds
+ */
+u32_t sys_now(void)
+{
+    return((u32_t)(time_us_64()/1000));
+}
+
+/*!
+ * \brief Sleep the calling thread
+ *
+ * \param[in]  ms   milliseconds
+ *
+ * \return nothing
+ */
+void sys_msleep(u32_t ms)
+{
+    sleep_ms(ms);
+}
+
+/*!
+ * \brief Start a timeout, never called on the host
+ *
+ * \param[in]  ms       milliseconds
+ * \param[in]  handler  function to call
+ * \param[in]  arg      its argument
+ *
+ * \return nothing
+ */
+void sys_timeout(__unused u32_t ms, __unused sys_timeout_handler handler, __unused void *arg)
+{
+}
@@ -0,0 +1,937 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#define _GNU_SOURCE                     // recursive mutex initialiser
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "shim.h"
+#include "lwip/apps/fs.h"
+
+// see shim.h
+
+#define SHIM_TCPIP_QUEUE_SIZE   (256)
+#define SHIM_FS_FILES           (256)
+
+struct SHIM_SEMAPHORE
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int count;
+};
+
+typedef struct
+{
+    tcpip_callback_fn function;
+    void *ctx;
+} SHIM_CALLBACK_T;
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    int length;
+    u8_t flags;
+} SHIM_FS_FILE_T;
+
+struct SHIM_TASK
+{
+    void (*code)(void *);
+    void *parameters;
+    struct SHIM_SEMAPHORE notify;       // count is the notification value
+};
+
+// prototypes
+static void *shim_task_start(void *arg);
+static void shim_deadline(struct timespec *deadline, TickType_t ticks);
+static struct SHIM_TASK *shim_task_new(void (*code)(void *), void *parameters);
+
+// the custom file hooks of the firmware module under test, if it has them
+int fs_open_custom(struct fs_file *file, const char *name) __attribute__((weak));
+void fs_close_custom(struct fs_file *file) __attribute__((weak));
+
+// external variables
+long shim_mem_allocated = 0;
+int shim_tcpip_queue_max = SHIM_TCPIP_QUEUE_SIZE;
+TickType_t shim_ticks_skipped = 0;
+uint8_t shim_flash[PICO_FLASH_SIZE_BYTES];
+int shim_flash_errors = 0;
+long shim_pbuf_bytes = 0;
+long shim_pbuf_bytes_max = 0;
+const ip_addr_t shim_ip_addr_any = {0};
+
+// static variables
+static pthread_mutex_t shim_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t shim_lwip = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t shim_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static SHIM_CALLBACK_T shim_queue[SHIM_TCPIP_QUEUE_SIZE];
+static int shim_queue_head = 0;
+static int shim_queue_count = 0;
+static SHIM_FS_FILE_T shim_fs_files[SHIM_FS_FILES];
+static int shim_fs_num_files = 0;
+static __thread struct SHIM_TASK *shim_current_task = NULL;
+
+/*!
+ * \brief Enter a critical section (taskENTER_CRITICAL)
+ *
+ * \return nothing
+ */
+void shim_enter_critical(void)
+{
+    pthread_mutex_lock(&shim_critical);
+}
+
+/*!
+ * \brief Leave a critical section (taskEXIT_CRITICAL)
+ *
+ * \return nothing
+ */
+void shim_exit_critical(void)
+{
+    pthread_mutex_unlock(&shim_critical);
+}
+
+/*!
+ * \brief Let another thread run (taskYIELD)
+ *
+ * \return nothing
+ */
+void shim_yield(void)
+{
+    sched_yield();
+}
+
+/*!
+ * \brief Milliseconds, plus any a test has skipped
+ *
+ * \return tick count
+ */
+TickType_t xTaskGetTickCount(void)
+{
+    return((TickType_t)(time_us_64()/1000) + shim_ticks_skipped);
+}
+
+/*!
+ * \brief Sleep
+ *
+ * \param[in]  ticks    milliseconds
+ *
+ * \return nothing
+ */
+void vTaskDelay(TickType_t ticks)
+{
+    sleep_ms(ticks);
+}
+
+/*!
+ * \brief Identify the calling task, a thread not started by xTaskCreate() becomes a task on its first call
+ *
+ * \return handle
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!shim_current_task)
+    {
+        shim_current_task = shim_task_new(NULL, NULL);
+    }
+
+    return(shim_current_task);
+}
+
+/*!
+ * \brief Start a task as a detached thread
+ *
+ * \param[in]  code         task function
+ * \param[in]  name         unused
+ * \param[in]  stack_depth  unused
+ * \param[in]  parameters   passed to code
+ * \param[in]  priority     unused
+ * \param[out] created      handle of the new task, may be NULL
+ *
+ * \return pdPASS or pdFAIL
+ */
+BaseType_t xTaskCreate(void (*code)(void *), __unused const char *name, __unused uint32_t stack_depth, void *parameters,
+                       __unused UBaseType_t priority, TaskHandle_t *created)
+{
+    struct SHIM_TASK *task;
+    pthread_t thread;
+
+    task = shim_task_new(code, parameters);
+    if (!task)
+    {
+        return(pdFAIL);
+    }
+
+    // set before the task runs, as FreeRTOS does, and never freed so that late notifications are safe
+    if (created)
+    {
+        *created = task;
+    }
+
+    if (pthread_create(&thread, NULL, shim_task_start, task))
+    {
+        if (created)
+        {
+            *created = NULL;
+        }
+        free(task);
+        return(pdFAIL);
+    }
+    pthread_detach(thread);
+
+    return(pdPASS);
+}
+
+/*!
+ * \brief Notify a task (index 0 only)
+ *
+ * \param[in]  task     handle
+ * \param[in]  index    unused
+ *
+ * \return pdPASS
+ */
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, __unused UBaseType_t index)
+{
+    pthread_mutex_lock(&task->notify.mutex);
+    task->notify.count++;
+    pthread_cond_signal(&task->notify.cond);
+    pthread_mutex_unlock(&task->notify.mutex);
+
+    return(pdPASS);
+}
+
+/*!
+ * \brief Wait for the calling task to be notified
+ *
+ * \param[in]  index    unused
+ * \param[in]  clear    pdTRUE to clear the count, pdFALSE to decrement it
+ * \param[in]  ticks    milliseconds to wait, 0 to poll or portMAX_DELAY
+ *
+ * \return notification count before it was cleared or decremented, 0 on timeout
+ */
+uint32_t ulTaskNotifyTakeIndexed(__unused UBaseType_t index, BaseType_t clear, TickType_t ticks)
+{
+    struct SHIM_TASK *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    uint32_t count;
+    int error = 0;
+
+    shim_deadline(&deadline, ticks);
+
+    pthread_mutex_lock(&task->notify.mutex);
+    while (!task->notify.count && !error && ticks)
+    {
+        if (ticks == portMAX_DELAY)
+        {
+            pthread_cond_wait(&task->notify.cond, &task->notify.mutex);
+        }
+        else
+        {
+            error = pthread_cond_timedwait(&task->notify.cond, &task->notify.mutex, &deadline);
+        }
+    }
+    count = task->notify.count;
+    if (count)
+    {
+        task->notify.count = clear ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->notify.mutex);
+
+    return(count);
+}
+
+/*!
+ * \brief Create a mutex, given
+ *
+ * \return handle or NULL
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t semaphore;
+
+    semaphore = xSemaphoreCreateBinary();
+    if (semaphore)
+    {
+        semaphore->count = 1;
+    }
+
+    return(semaphore);
+}
+
+/*!
+ * \brief Create a binary semaphore, taken
+ *
+ * \return handle or NULL
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    SemaphoreHandle_t semaphore;
+
+    semaphore = calloc(1, sizeof(struct SHIM_SEMAPHORE));
+    if (semaphore)
+    {
+        pthread_mutex_init(&semaphore->mutex, NULL);
+        pthread_cond_init(&semaphore->cond, NULL);
+    }
+
+    return(semaphore);
+}
+
+/*!
+ * \brief Take a semaphore
+ *
+ * \param[in]  semaphore    handle
+ * \param[in]  ticks        milliseconds to wait, 0 to poll or portMAX_DELAY
+ *
+ * \return pdTRUE if taken, pdFALSE on timeout
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    struct timespec deadline;
+    int error = 0;
+
+    shim_deadline(&deadline, ticks);
+
+    pthread_mutex_lock(&semaphore->mutex);
+    while (!semaphore->count && !error)
+    {
+        if (ticks == 0)
+        {
+            error = ETIMEDOUT;
+        }
+        else if (ticks == portMAX_DELAY)
+        {
+            pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+        }
+        else
+        {
+            error = pthread_cond_timedwait(&semaphore->cond, &semaphore->mutex, &deadline);
+        }
+    }
+    if (semaphore->count)
+    {
+        semaphore->count = 0;
+        error = 0;
+    }
+    pthread_mutex_unlock(&semaphore->mutex);
+
+    return(error ? pdFALSE : pdTRUE);
+}
+
+/*!
+ * \brief Give a semaphore
+ *
+ * \param[in]  semaphore    handle
+ *
+ * \return pdTRUE, or pdFALSE if it was already given
+ */
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t given;
+
+    pthread_mutex_lock(&semaphore->mutex);
+    given = semaphore->count ? pdFALSE : pdTRUE;
+    semaphore->count = 1;
+    pthread_cond_signal(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->mutex);
+
+    return(given);
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+uint64_t time_us_64(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return((uint64_t)now.tv_sec*1000000 + now.tv_nsec/1000);
+}
+
+/*!
+ * \brief Monotonic time, wrapping
+ *
+ * \return microseconds
+ */
+uint32_t time_us_32(void)
+{
+    return((uint32_t)time_us_64());
+}
+
+/*!
+ * \brief Sleep
+ *
+ * \param[in]  ms   milliseconds
+ *
+ * \return nothing
+ */
+void sleep_ms(uint32_t ms)
+{
+    struct timespec delay;
+
+    delay.tv_sec = ms/1000;
+    delay.tv_nsec = (ms % 1000)*1000000L;
+    nanosleep(&delay, NULL);
+}
+
+/*!
+ * \brief Take the lwIP core lock
+ *
+ * \return nothing
+ */
+void cyw43_arch_lwip_begin(void)
+{
+    pthread_mutex_lock(&shim_lwip);
+}
+
+/*!
+ * \brief Release the lwIP core lock
+ *
+ * \return nothing
+ */
+void cyw43_arch_lwip_end(void)
+{
+    pthread_mutex_unlock(&shim_lwip);
+}
+
+/*!
+ * \brief Drive a gpio, the host has none
+ *
+ * \param[in]  gpio     gpio number
+ * \param[in]  value    level
+ *
+ * \return nothing
+ */
+void gpio_put(__unused unsigned int gpio, __unused bool value)
+{
+}
+
+/*!
+ * \brief Erase flash sectors
+ *
+ * \param[in]  flash_offs   offset from start of flash, sector aligned
+ * \param[in]  count        bytes, a multiple of the sector size
+ *
+ * \return nothing
+ */
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    if ((flash_offs % FLASH_SECTOR_SIZE) || (count % FLASH_SECTOR_SIZE) || (flash_offs + count > PICO_FLASH_SIZE_BYTES))
+    {
+        shim_flash_errors++;
+        return;
+    }
+
+    memset(&(shim_flash[flash_offs]), 0xFF, count);
+}
+
+/*!
+ * \brief Program flash pages -- like the chip, programming can only clear bits
+ *
+ * \param[in]  flash_offs   offset from start of flash, page aligned
+ * \param[in]  data         data
+ * \param[in]  count        bytes, a multiple of the page size
+ *
+ * \return nothing
+ */
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    size_t i;
+
+    if ((flash_offs % FLASH_PAGE_SIZE) || (count % FLASH_PAGE_SIZE) || (flash_offs + count > PICO_FLASH_SIZE_BYTES))
+    {
+        shim_flash_errors++;
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        shim_flash[flash_offs + i] &= data[i];
+        if (shim_flash[flash_offs + i] != data[i])
+        {
+            shim_flash_errors++;
+        }
+    }
+}
+
+/*!
+ * \brief Run a function that writes flash -- the host has no other core or xip cache to worry about
+ *
+ * \param[in]  func                    function
+ * \param[in]  param                   its argument
+ * \param[in]  enter_exit_timeout_ms   not used
+ *
+ * \return PICO_OK
+ */
+int flash_safe_execute(void (*func)(void *), void *param, __unused uint32_t enter_exit_timeout_ms)
+{
+    shim_enter_critical();
+    func(param);
+    shim_exit_critical();
+
+    return(PICO_OK);
+}
+
+/*!
+ * \brief Allocate from the lwIP heap
+ *
+ * \param[in]  size     bytes
+ *
+ * \return memory or NULL
+ */
+void *mem_malloc(size_t size)
+{
+    void *mem;
+
+    mem = malloc(size);
+    if (mem)
+    {
+        __atomic_add_fetch(&shim_mem_allocated, 1, __ATOMIC_RELAXED);
+    }
+
+    return(mem);
+}
+
+/*!
+ * \brief Free to the lwIP heap
+ *
+ * \param[in]  mem  memory from mem_malloc()
+ *
+ * \return nothing
+ */
+void mem_free(void *mem)
+{
+    if (mem)
+    {
+        __atomic_sub_fetch(&shim_mem_allocated, 1, __ATOMIC_RELAXED);
+        free(mem);
+    }
+}
+
+/*!
+ * \brief Free a pbuf chain
+ *
+ * \param[in]  p    chain
+ *
+ * \return nothing
+ */
+void pbuf_free(struct pbuf *p)
+{
+    struct pbuf *next;
+
+    while (p)
+    {
+        next = p->next;
+        __atomic_sub_fetch(&shim_pbuf_bytes, p->len, __ATOMIC_RELAXED);
+        free(p);
+        p = next;
+    }
+}
+
+/*!
+ * \brief Allocate a pbuf in one block
+ *
+ * \param[in]  layer    PBUF_IP or PBUF_TRANSPORT, no room is kept for headers
+ * \param[in]  length   bytes of payload
+ * \param[in]  type     PBUF_RAM
+ *
+ * \return pbuf or NULL
+ */
+struct pbuf *pbuf_alloc(__unused pbuf_layer layer, u16_t length, __unused pbuf_type type)
+{
+    struct pbuf *p;
+    long bytes;
+
+    p = calloc(1, sizeof(*p) + length);
+    if (!p)
+    {
+        return(NULL);
+    }
+
+    p->payload = p + 1;
+    p->len = length;
+    p->tot_len = length;
+
+    bytes = __atomic_add_fetch(&shim_pbuf_bytes, length, __ATOMIC_RELAXED);
+    if (bytes > shim_pbuf_bytes_max)
+    {
+        shim_pbuf_bytes_max = bytes;
+    }
+
+    return(p);
+}
+
+/*!
+ * \brief Copy part of a pbuf chain
+ *
+ * \param[in]  p        chain
+ * \param[out] data     destination
+ * \param[in]  length   bytes wanted
+ * \param[in]  offset   from the start of the chain
+ *
+ * \return bytes copied, fewer than length if the chain ends first
+ */
+u16_t pbuf_copy_partial(const struct pbuf *p, void *data, u16_t length, u16_t offset)
+{
+    u16_t copied = 0;
+    u16_t chunk;
+
+    for (; p && (copied < length); p = p->next)
+    {
+        if (offset >= p->len)
+        {
+            offset -= p->len;
+            continue;
+        }
+
+        chunk = p->len - offset;
+        if (chunk > length - copied)
+        {
+            chunk = length - copied;
+        }
+
+        memcpy((u8_t *)data + copied, (u8_t *)p->payload + offset, chunk);
+        copied += chunk;
+        offset = 0;
+    }
+
+    return(copied);
+}
+
+/*!
+ * \brief Move the payload past a header
+ *
+ * \param[in]  p        pbuf
+ * \param[in]  size     header bytes
+ *
+ * \return 0, or 1 if the pbuf is shorter than the header
+ */
+u8_t pbuf_remove_header(struct pbuf *p, size_t size)
+{
+    if (size > p->len)
+    {
+        return(1);
+    }
+
+    p->payload = (u8_t *)p->payload + size;
+    p->len -= size;
+    p->tot_len -= size;
+    __atomic_sub_fetch(&shim_pbuf_bytes, size, __ATOMIC_RELAXED);
+
+    return(0);
+}
+
+/*!
+ * \brief Move the payload back over a header removed earlier
+ *
+ * \param[in]  p        pbuf
+ * \param[in]  size     header bytes
+ *
+ * \return 0, or 1 if there is no room in front of the payload
+ */
+u8_t pbuf_add_header(struct pbuf *p, size_t size)
+{
+    if ((u8_t *)p->payload - size < (u8_t *)(p + 1))
+    {
+        return(1);
+    }
+
+    p->payload = (u8_t *)p->payload - size;
+    p->len += size;
+    p->tot_len += size;
+    __atomic_add_fetch(&shim_pbuf_bytes, size, __ATOMIC_RELAXED);
+
+    return(0);
+}
+
+/*!
+ * \brief Copy data into a pbuf chain
+ *
+ * \param[in]  p        chain
+ * \param[in]  data     data
+ * \param[in]  length   bytes, no more than the chain holds
+ *
+ * \return ERR_OK, or ERR_ARG if the chain is too short
+ */
+err_t pbuf_take(struct pbuf *p, const void *data, u16_t length)
+{
+    u16_t copied = 0;
+    u16_t chunk;
+
+    if (!p || (p->tot_len < length))
+    {
+        return(ERR_ARG);
+    }
+
+    for (; p && (copied < length); p = p->next)
+    {
+        chunk = (p->len < length - copied) ? p->len : length - copied;
+        memcpy(p->payload, (const u8_t *)data + copied, chunk);
+        copied += chunk;
+    }
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Convert a dotted decimal address
+ *
+ * \param[in]  cp       text, e.g. "192.168.1.20"
+ * \param[out] addr     address, network order
+ *
+ * \return 1 if the text is an address, 0 if not
+ */
+int ip4addr_aton(const char *cp, ip4_addr_t *addr)
+{
+    struct in_addr address;
+
+    if (!inet_aton(cp, &address))
+    {
+        return(0);
+    }
+
+    addr->addr = address.s_addr;
+
+    return(1);
+}
+
+/*!
+ * \brief Queue a function for the tcpip thread
+ *
+ * \param[in]  function     function to call
+ * \param[in]  ctx          its argument
+ *
+ * \return ERR_OK, or ERR_MEM if the queue is full
+ */
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx)
+{
+    return(tcpip_try_callback(function, ctx));
+}
+
+/*!
+ * \brief Queue a function for the tcpip thread without waiting for space
+ *
+ * \param[in]  function     function to call
+ * \param[in]  ctx          its argument
+ *
+ * \return ERR_OK, or ERR_MEM if the queue is full
+ */
+err_t tcpip_try_callback(tcpip_callback_fn function, void *ctx)
+{
+    err_t err = ERR_MEM;
+
+    pthread_mutex_lock(&shim_queue_lock);
+    if ((shim_queue_count < shim_tcpip_queue_max) && (shim_queue_count < SHIM_TCPIP_QUEUE_SIZE))
+    {
+        shim_queue[(shim_queue_head + shim_queue_count) % SHIM_TCPIP_QUEUE_SIZE].function = function;
+        shim_queue[(shim_queue_head + shim_queue_count) % SHIM_TCPIP_QUEUE_SIZE].ctx = ctx;
+        shim_queue_count++;
+        err = ERR_OK;
+    }
+    pthread_mutex_unlock(&shim_queue_lock);
+
+    return(err);
+}
+
+/*!
+ * \brief Run the queued tcpip callbacks, as the tcpip thread would, holding the lwIP core lock
+ *
+ * \return number of callbacks run
+ */
+int shim_tcpip_run(void)
+{
+    SHIM_CALLBACK_T callback;
+    int run = 0;
+
+    cyw43_arch_lwip_begin();
+    for (;;)
+    {
+        pthread_mutex_lock(&shim_queue_lock);
+        if (!shim_queue_count)
+        {
+            pthread_mutex_unlock(&shim_queue_lock);
+            break;
+        }
+        callback = shim_queue[shim_queue_head];
+        shim_queue_head = (shim_queue_head + 1) % SHIM_TCPIP_QUEUE_SIZE;
+        shim_queue_count--;
+        pthread_mutex_unlock(&shim_queue_lock);
+
+        callback.function(callback.ctx);
+        run++;
+    }
+    cyw43_arch_lwip_end();
+
+    return(run);
+}
+
+/*!
+ * \brief Register cgi handlers, tests call the handlers directly
+ *
+ * \param[in]  pCGIs           handlers
+ * \param[in]  iNumHandlers    number of handlers
+ *
+ * \return nothing
+ */
+void http_set_cgi_handlers(__unused const tCGI *pCGIs, __unused int iNumHandlers)
+{
+}
+
+/*!
+ * \brief Add a page for fs_open() to serve in place of htmldata.c
+ *
+ * \param[in]  name     uri
+ * \param[in]  data     http header and body, must outlive the test
+ * \param[in]  length   bytes of data
+ * \param[in]  flags    FS_FILE_FLAGS_*
+ *
+ * \return nothing
+ */
+void shim_fs_add(const char *name, const char *data, int length, u8_t flags)
+{
+    if (shim_fs_num_files < SHIM_FS_FILES)
+    {
+        shim_fs_files[shim_fs_num_files].name = name;
+        shim_fs_files[shim_fs_num_files].data = data;
+        shim_fs_files[shim_fs_num_files].length = length;
+        shim_fs_files[shim_fs_num_files].flags = flags;
+        shim_fs_num_files++;
+    }
+}
+
+/*!
+ * \brief Open a file as httpd does, custom files first
+ *
+ * \param[out] file     handle
+ * \param[in]  name     uri
+ *
+ * \return ERR_OK or ERR_VAL if there is no such file
+ */
+err_t fs_open(struct fs_file *file, const char *name)
+{
+    int i;
+
+    memset(file, 0, sizeof(struct fs_file));
+
+    if (fs_open_custom && fs_open_custom(file, name))
+    {
+        file->is_custom_file = 1;
+        return(ERR_OK);
+    }
+
+    for (i=0; i<shim_fs_num_files; i++)
+    {
+        if (!strcmp(shim_fs_files[i].name, name))
+        {
+            file->data = shim_fs_files[i].data;
+            file->len = shim_fs_files[i].length;
+            file->flags = shim_fs_files[i].flags;
+            return(ERR_OK);
+        }
+    }
+
+    return(ERR_VAL);
+}
+
+/*!
+ * \brief Close a file opened by fs_open()
+ *
+ * \param[in]  file     handle
+ *
+ * \return nothing
+ */
+void fs_close(struct fs_file *file)
+{
+    if (file->is_custom_file && fs_close_custom)
+    {
+        fs_close_custom(file);
+    }
+}
+
+/*!
+ * \brief Bytes of a file not yet read
+ *
+ * \param[in]  file     handle
+ *
+ * \return bytes
+ */
+int fs_bytes_left(struct fs_file *file)
+{
+    return(file->len - file->index);
+}
+
+/*!
+ * \brief Thread entry for xTaskCreate()
+ *
+ * \param[in]  arg  struct SHIM_TASK
+ *
+ * \return NULL
+ */
+static void *shim_task_start(void *arg)
+{
+    shim_current_task = (struct SHIM_TASK *)arg;
+    shim_current_task->code(shim_current_task->parameters);
+
+    return(NULL);
+}
+
+/*!
+ * \brief Allocate a task
+ *
+ * \param[in]  code         task function, NULL for a thread the test started
+ * \param[in]  parameters   passed to code
+ *
+ * \return task or NULL
+ */
+static struct SHIM_TASK *shim_task_new(void (*code)(void *), void *parameters)
+{
+    struct SHIM_TASK *task;
+
+    task = calloc(1, sizeof(struct SHIM_TASK));
+    if (task)
+    {
+        task->code = code;
+        task->parameters = parameters;
+        pthread_mutex_init(&task->notify.mutex, NULL);
+        pthread_cond_init(&task->notify.cond, NULL);
+    }
+
+    return(task);
+}
+
+/*!
+ * \brief Absolute time for pthread_cond_timedwait()
+ *
+ * \param[out] deadline     now plus ticks
+ * \param[in]  ticks        milliseconds
+ *
+ * \return nothing
+ */
+static void shim_deadline(struct timespec *deadline, TickType_t ticks)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+
+    if ((ticks != portMAX_DELAY) && ticks)
+    {
+        deadline->tv_sec += ticks/1000;
+        deadline->tv_nsec += (ticks % 1000)*1000000L;
+        if (deadline->tv_nsec >= 1000000000L)
+        {
+            deadline->tv_sec++;
+            deadline->tv_nsec -= 1000000000L;
+        }
+    }
+}
+
@@ -0,0 +1,349 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/*
+ * Host stand-ins for the parts of the pico sdk, FreeRTOS and lwIP used by firmware modules that the client Makefile
+ * builds for tests.  The headers under client/shim have the names the firmware includes and all lead here.
+ *
+ * Critical sections and the lwIP core lock are recursive pthread mutexes, so firmware code called from several
+ * threads of a test is serialised the way it is on the pico.  tcpip_callback() queues functions that the test runs
+ * with shim_tcpip_run(), standing in for the tcpip thread.  Memory allocated by mem_malloc() is counted so that tests
+ * can check for leaks.
+ *
+ * altcp connections are host sockets, with OpenSSL standing in for mbedtls on tls connections (shim/altcp.c, link
+ * with -lssl -lcrypto).  shim_altcp_start() starts a thread that waits on them and runs the altcp callbacks with the
+ * lwIP core lock held, as the tcpip thread does.
+ *
+ * Raw pcbs (shim/raw.c) send to a network the test supplies as shim_raw_output, and the test hands received packets,
+ * starting with their ip header, to shim_raw_input() which offers them to each raw pcb as lwIP's raw_input() does.
+ * Udp pcbs (shim/udp.c) work the same way through shim_udp_output and shim_udp_input(), with the udp payload only.
+ */
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+
+// ---- FreeRTOS ----
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef struct SHIM_TASK *TaskHandle_t;
+typedef struct SHIM_SEMAPHORE *SemaphoreHandle_t;
+
+#define pdTRUE                  (1)
+#define pdFALSE                 (0)
+#define pdPASS                  (1)
+#define pdFAIL                  (0)
+#define portMAX_DELAY           (0xffffffffUL)
+#define portTICK_PERIOD_MS      (1)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define configSTACK_DEPTH_TYPE  uint32_t
+#define tskIDLE_PRIORITY        (0)
+
+#define taskENTER_CRITICAL()    shim_enter_critical()
+#define taskEXIT_CRITICAL()     shim_exit_critical()
+#define taskYIELD()             shim_yield()
+
+void shim_enter_critical(void);
+void shim_exit_critical(void);
+void shim_yield(void);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskCreate(void (*code)(void *), const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created);
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+// ---- pico sdk ----
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_ms(uint32_t ms);
+void cyw43_arch_lwip_begin(void);
+void cyw43_arch_lwip_end(void);
+void gpio_put(unsigned int gpio, bool value);
+
+typedef struct
+{
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+} datetime_t;
+
+typedef struct SHIM_I2C i2c_inst_t;
+
+// flash is an array in ram, starting zeroed rather than erased
+#define PICO_FLASH_SIZE_BYTES   (2*1024*1024)
+#define FLASH_SECTOR_SIZE       (4096)
+#define FLASH_PAGE_SIZE         (256)
+#define XIP_BASE                ((uintptr_t)shim_flash)
+#define PICO_OK                 (0)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+// ---- lwIP ----
+typedef int8_t err_t;
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+
+#define ERR_OK                  (0)
+#define ERR_MEM                 (-1)
+#define ERR_BUF                 (-2)
+#define ERR_TIMEOUT             (-3)
+#define ERR_RTE                 (-4)
+#define ERR_INPROGRESS          (-5)
+#define ERR_VAL                 (-6)
+#define ERR_WOULDBLOCK          (-7)
+#define ERR_USE                 (-8)
+#define ERR_CONN                (-11)
+#define ERR_ABRT                (-13)
+#define ERR_RST                 (-14)
+#define ERR_CLSD                (-15)
+#define ERR_ARG                 (-16)
+
+#define LWIP_UNUSED_ARG(x)      (void)(x)
+#define LWIP_ARRAYSIZE(x)       (sizeof(x)/sizeof((x)[0]))
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+void *mem_malloc(size_t size);
+void mem_free(void *mem);
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx);
+err_t tcpip_try_callback(tcpip_callback_fn function, void *ctx);
+
+// httpd defaults, not changed by lwipopts.h
+#define LWIP_HTTPD_MAX_TAG_NAME_LEN     (8)
+#define LWIP_HTTPD_MAX_TAG_INSERT_LEN   (192)
+
+typedef const char *(*tCGIHandler)(int iIndex, int iNumParams, char *pcParam[], char *pcValue[]);
+
+typedef struct
+{
+    const char *pcCGIName;
+    tCGIHandler pfnCGIHandler;
+} tCGI;
+
+void http_set_cgi_handlers(const tCGI *pCGIs, int iNumHandlers);
+
+// ---- lwIP altcp, see shim/altcp.c ----
+#define LWIP_ALTCP              (1)             // as set by lwipopts.h
+#define LWIP_ALTCP_TLS          (1)
+#define TCP_SND_BUF             (8*1460)        // 8*TCP_MSS
+#define TCP_SND_QUEUELEN        ((4*TCP_SND_BUF + 1460 - 1)/1460)
+#define TCP_WRITE_FLAG_COPY     (0x01)
+#define IPADDR_TYPE_V4          (0)
+#define LWIP_IANA_PORT_HTTP     (80)
+#define LWIP_IANA_PORT_HTTPS    (443)
+
+typedef struct
+{
+    u32_t addr;                         // network order
+} ip_addr_t;
+
+struct pbuf
+{
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+struct altcp_pcb;
+struct altcp_tls_config;
+
+typedef err_t (*altcp_connected_fn)(void *arg, struct altcp_pcb *conn, err_t err);
+typedef err_t (*altcp_recv_fn)(void *arg, struct altcp_pcb *conn, struct pbuf *p, err_t err);
+typedef err_t (*altcp_sent_fn)(void *arg, struct altcp_pcb *conn, u16_t len);
+typedef err_t (*altcp_poll_fn)(void *arg, struct altcp_pcb *conn);
+typedef void (*altcp_err_fn)(void *arg, err_t err);
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *arg);
+
+struct altcp_pcb
+{
+    void *state;                        // altcp_mbedtls_state_t on tls connections
+    void *arg;
+    altcp_recv_fn recv;
+    altcp_sent_fn sent;
+    altcp_poll_fn poll;
+    altcp_err_fn err;
+    altcp_connected_fn connected;
+    u8_t pollinterval;
+    struct SHIM_SOCKET *socket;         // host side, see shim/altcp.c
+};
+
+void pbuf_free(struct pbuf *p);
+struct altcp_pcb *altcp_tcp_new_ip_type(u8_t ip_type);
+struct altcp_tls_config *altcp_tls_create_config_client(const u8_t *ca, size_t ca_len);
+struct altcp_pcb *altcp_tls_new(struct altcp_tls_config *config, u8_t ip_type);
+void altcp_arg(struct altcp_pcb *pcb, void *arg);
+void altcp_recv(struct altcp_pcb *pcb, altcp_recv_fn recv);
+void altcp_sent(struct altcp_pcb *pcb, altcp_sent_fn sent);
+void altcp_poll(struct altcp_pcb *pcb, altcp_poll_fn poll, u8_t interval);
+void altcp_err(struct altcp_pcb *pcb, altcp_err_fn err);
+err_t altcp_connect(struct altcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port, altcp_connected_fn connected);
+err_t altcp_write(struct altcp_pcb *pcb, const void *data, u16_t len, u8_t flags);
+err_t altcp_output(struct altcp_pcb *pcb);
+u16_t altcp_sndbuf(struct altcp_pcb *pcb);
+u16_t altcp_sndqueuelen(struct altcp_pcb *pcb);
+void altcp_recved(struct altcp_pcb *pcb, u16_t len);
+err_t altcp_close(struct altcp_pcb *pcb);
+void altcp_abort(struct altcp_pcb *pcb);
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *arg);
+
+// ---- lwIP raw api, see shim/raw.c ----
+#define LWIP_RAW                (1)             // as set by lwipopts.h
+#define LWIP_DBG_ON             (0x80)
+#define LWIP_DEBUGF(debug, message)
+#define LWIP_ASSERT(message, assertion) do { if (!(assertion)) { fprintf(stderr, "assertion failed: %s\n", message); abort(); } } while (0)
+#define U32_F                   "u"
+#define lwip_htons(x)           htons(x)
+#define lwip_ntohs(x)           ntohs(x)
+#define lwip_htonl(x)           htonl(x)
+#define lwip_ntohl(x)           ntohl(x)
+
+#define IP_IS_V4(ipaddr)                    (1)
+#define ip_2_ip4(ipaddr)                    (ipaddr)
+#define ip4_addr_get_u32(ipaddr)            ((ipaddr)->addr)
+#define ip_addr_set_ip4_u32(ipaddr, value)  ((ipaddr)->addr = (value))
+#define ip_addr_debug_print(debug, ipaddr)
+#define IP_ADDR_ANY                         (&shim_ip_addr_any)
+#define IP4_ADDR_ANY                        (&shim_ip_addr_any)
+#define IP4_ADDR_ANY4                       (&shim_ip_addr_any)
+#define IP4_ADDR(ipaddr, a, b, c, d)        ((ipaddr)->addr = htonl(((u32_t)(a) << 24) | ((u32_t)(b) << 16) | ((u32_t)(c) << 8) | (u32_t)(d)))
+#define IP_ADDR4(ipaddr, a, b, c, d)        IP4_ADDR(ipaddr, a, b, c, d)
+
+#define IP_PROTO_ICMP           (1)
+#define PBUF_IP_HLEN            (20)
+#define ICMP_ER                 (0)
+#define ICMP_DUR                (3)
+#define ICMP_ECHO               (8)
+#define ICMPH_TYPE(hdr)             ((hdr)->type)
+#define ICMPH_TYPE_SET(hdr, value)  ((hdr)->type = (value))
+#define ICMPH_CODE_SET(hdr, value)  ((hdr)->code = (value))
+
+typedef u16_t mem_size_t;
+typedef ip_addr_t ip4_addr_t;
+typedef enum { PBUF_TRANSPORT, PBUF_IP } pbuf_layer;
+typedef enum { PBUF_RAM } pbuf_type;
+
+struct icmp_echo_hdr
+{
+    u8_t type;
+    u8_t code;
+    u16_t chksum;
+    u16_t id;                           // network order
+    u16_t seqno;                        // network order
+};
+
+struct raw_pcb;
+typedef u8_t (*raw_recv_fn)(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr);
+typedef void (*sys_timeout_handler)(void *arg);
+
+extern const ip_addr_t shim_ip_addr_any;
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *data, u16_t length, u16_t offset);
+u8_t pbuf_remove_header(struct pbuf *p, size_t size);
+u8_t pbuf_add_header(struct pbuf *p, size_t size);
+err_t pbuf_take(struct pbuf *p, const void *data, u16_t length);
+int ip4addr_aton(const char *cp, ip4_addr_t *addr);
+u16_t inet_chksum(const void *data, u16_t length);
+struct raw_pcb *raw_new(u8_t protocol);
+void raw_recv(struct raw_pcb *pcb, raw_recv_fn recv, void *arg);
+err_t raw_bind(struct raw_pcb *pcb, const ip_addr_t *addr);
+err_t raw_sendto(struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr);
+void raw_remove(struct raw_pcb *pcb);
+u32_t sys_now(void);
+void sys_msleep(u32_t ms);
+void sys_timeout(u32_t ms, sys_timeout_handler handler, void *arg);
+
+// lwIP contrib ping.h, the ping sender built on the raw api
+void ping_init(const ip_addr_t *ping_addr);
+void ping_send_now(void);
+
+// ---- lwIP udp and igmp, see shim/udp.c ----
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb *udp_new_ip_type(u8_t type);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port);
+void udp_remove(struct udp_pcb *pcb);
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+err_t igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+
+// ---- mbedtls, the calls the firmware makes on an altcp tls connection ----
+typedef struct
+{
+    void *ssl;                          // OpenSSL connection, once the socket is connected
+    char hostname[64];
+    void *offer;                        // session offered for resumption
+} mbedtls_ssl_context;
+
+typedef struct
+{
+    unsigned char master[48];
+    void *session;                      // OpenSSL session
+} mbedtls_ssl_session;
+
+typedef struct
+{
+    mbedtls_ssl_context ssl_context;
+} altcp_mbedtls_state_t;
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session *session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session *session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session);
+int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *hostname);
+
+// ---- host ----
+int shim_tcpip_run(void);
+u8_t shim_raw_input(struct pbuf *p, const ip_addr_t *source);
+u8_t shim_udp_input(struct pbuf *p, const ip_addr_t *source, u16_t source_port, u16_t port);
+void shim_altcp_start(void);
+void shim_altcp_stop(void);
+extern long shim_mem_allocated;         // mem_malloc() blocks not yet freed
+extern int shim_tcpip_queue_max;        // tcpip_try_callback() fails once this many are queued
+extern TickType_t shim_ticks_skipped;   // added to xTaskGetTickCount(), lets a test jump past a long timeout
+extern int shim_pbuf_size;              // received data is passed on in chains of pbufs of at most this size
+extern long shim_pbuf_bytes;            // bytes in pbufs not yet freed
+extern long shim_pbuf_bytes_max;        // most bytes in pbufs at once
+extern int shim_sockets_max;            // most altcp connections open at once
+extern uint8_t shim_flash[PICO_FLASH_SIZE_BYTES];
+extern int shim_flash_errors;           // flash writes not aligned, or programming bits that were not erased
+extern err_t (*shim_raw_output)(struct pbuf *p, const ip_addr_t *destination);    // the network raw_sendto() sends to
+extern int shim_raw_pcbs;               // raw pcbs not yet removed
+extern err_t (*shim_udp_output)(struct pbuf *p, const ip_addr_t *destination, u16_t port);  // the network udp_sendto() sends to
+extern int shim_udp_pcbs;               // udp pcbs not yet removed
+extern int shim_igmp_groups;            // multicast groups joined and not yet left
+extern ip4_addr_t shim_igmp_group;      // last group joined
+
+#endif
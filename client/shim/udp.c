@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "shim.h"
+
+/*
+ * Host stand-in for lwIP udp pcbs and igmp, see shim.h
+ *
+ * udp_sendto() passes each datagram's payload to the network the test puts in shim_udp_output.  The test hands every
+ * datagram its network delivers to shim_udp_input(), which passes it to the pcb bound to its destination port with
+ * the lwIP core lock held, as lwIP's udp_input() does, or frees it if there is none.  Joining a multicast group only
+ * records it, every pcb receives whatever the test delivers.
+ */
+
+#define SHIM_UDP_PCBS_MAX       (8)
+
+struct udp_pcb
+{
+    u16_t local_port;
+    udp_recv_fn recv;
+    void *recv_arg;
+};
+
+// external variables
+err_t (*shim_udp_output)(struct pbuf *p, const ip_addr_t *destination, u16_t port) = NULL;
+int shim_udp_pcbs = 0;
+int shim_igmp_groups = 0;
+ip4_addr_t shim_igmp_group = {0};
+
+// static variables
+static struct udp_pcb *shim_pcbs[SHIM_UDP_PCBS_MAX];
+
+/*!
+ * \brief New udp pcb
+ *
+ * \param[in]  type     IPADDR_TYPE_V4
+ *
+ * \return pcb or NULL
+ */
+struct udp_pcb *udp_new_ip_type(__unused u8_t type)
+{
+    struct udp_pcb *pcb;
+    int i;
+
+    for (i = 0; (i < SHIM_UDP_PCBS_MAX) && shim_pcbs[i]; i++);
+
+    if (i == SHIM_UDP_PCBS_MAX)
+    {
+        return(NULL);
+    }
+
+    pcb = calloc(1, sizeof(*pcb));
+    if (pcb)
+    {
+        shim_pcbs[i] = pcb;
+        shim_udp_pcbs++;
+    }
+
+    return(pcb);
+}
+
+/*!
+ * \brief Bind to a local port
+ *
+ * \param[in]  pcb      pcb
+ * \param[in]  ipaddr   local address, every pcb receives for every address on the host
+ * \param[in]  port     local port
+ *
+ * \return ERR_OK, or ERR_USE if another pcb has the port
+ */
+err_t udp_bind(struct udp_pcb *pcb, __unused const ip_addr_t *ipaddr, u16_t port)
+{
+    int i;
+
+    for (i = 0; i < SHIM_UDP_PCBS_MAX; i++)
+    {
+        if (shim_pcbs[i] && (shim_pcbs[i] != pcb) && (shim_pcbs[i]->local_port == port))
+        {
+            return(ERR_USE);
+        }
+    }
+
+    pcb->local_port = port;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Set the function called for each datagram received
+ *
+ * \param[in]  pcb          pcb
+ * \param[in]  recv         takes ownership of the datagram
+ * \param[in]  recv_arg     passed to recv
+ *
+ * \return nothing
+ */
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg)
+{
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+/*!
+ * \brief Send a datagram to the test's network
+ *
+ * \param[in]  pcb          pcb
+ * \param[in]  p            payload, still owned by the caller
+ * \param[in]  dst_ip       destination
+ * \param[in]  dst_port     destination port
+ *
+ * \return what shim_udp_output returns, or ERR_RTE if there is no network
+ */
+err_t udp_sendto(__unused struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port)
+{
+    if (!shim_udp_output)
+    {
+        return(ERR_RTE);
+    }
+
+    return(shim_udp_output(p, dst_ip, dst_port));
+}
+
+/*!
+ * \brief Remove a pcb, it receives nothing more
+ *
+ * \param[in]  pcb      pcb
+ *
+ * \return nothing
+ */
+void udp_remove(struct udp_pcb *pcb)
+{
+    int i;
+
+    for (i = 0; i < SHIM_UDP_PCBS_MAX; i++)
+    {
+        if (shim_pcbs[i] == pcb)
+        {
+            shim_pcbs[i] = NULL;
+            shim_udp_pcbs--;
+            free(pcb);
+            return;
+        }
+    }
+}
+
+/*!
+ * \brief Join a multicast group
+ *
+ * \param[in]  ifaddr       interface, IP4_ADDR_ANY4 for all
+ * \param[in]  groupaddr    group
+ *
+ * \return ERR_OK
+ */
+err_t igmp_joingroup(__unused const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr)
+{
+    shim_igmp_group = *groupaddr;
+    shim_igmp_groups++;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Leave a multicast group
+ *
+ * \param[in]  ifaddr       interface, IP4_ADDR_ANY4 for all
+ * \param[in]  groupaddr    group
+ *
+ * \return ERR_OK, or ERR_VAL if no group is joined
+ */
+err_t igmp_leavegroup(__unused const ip4_addr_t *ifaddr, __unused const ip4_addr_t *groupaddr)
+{
+    if (shim_igmp_groups == 0)
+    {
+        return(ERR_VAL);
+    }
+
+    shim_igmp_groups--;
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Pass a received datagram to the pcb bound to its port, as the tcpip thread
+ *
+ * \param[in]  p                payload, owned by the pcb's recv function if there is one
+ * \param[in]  source           address it came from
+ * \param[in]  source_port      port it came from
+ * \param[in]  port             destination port
+ *
+ * \return 1 if a pcb took it, 0 if it was freed
+ */
+u8_t shim_udp_input(struct pbuf *p, const ip_addr_t *source, u16_t source_port, u16_t port)
+{
+    u8_t taken = 0;
+    int i;
+
+    cyw43_arch_lwip_begin();
+    for (i = 0; (i < SHIM_UDP_PCBS_MAX) && !taken; i++)
+    {
+        if (shim_pcbs[i] && shim_pcbs[i]->recv && (shim_pcbs[i]->local_port == port))
+        {
+            shim_pcbs[i]->recv(shim_pcbs[i]->recv_arg, shim_pcbs[i], p, source, source_port);
+            taken = 1;
+        }
+    }
+    cyw43_arch_lwip_end();
+
+    if (!taken)
+    {
+        pbuf_free(p);
+    }
+
+    return(taken);
+}
@@ -0,0 +1,417 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "weather.h"
+#include "web_snapshot.h"
+#include "ssi_cache.h"
+
+/*
+ * SSI value cache test
+ *
+ * Links ssi_cache.c, web_snapshot.c and seqlock.c against the host stand-ins in client/shim.  Readings are
+ * published through web_write_begin()/web_write_end() as the producer tasks do, and ssi_cache_get() is asked for
+ * them as ssi_handler() does.  The cache is filled lazily: nothing is formatted when a producer publishes, the
+ * first tag read after the group's epoch moves formats every value of that group, and later reads copy the text.
+ *
+ * Checks that:
+ *
+ *   - every value, in both unit systems, reads the same as the snprintf() ssi_handler() used before the cache,
+ *     for readings -120.0 to 120.0 (negative wind and rain now read "-0.5" rather than "0.-5")
+ *   - a read after a new sample returns the new reading, and a read before the next sample returns the cached one
+ *
+ * Then it times the cached tags of the pages given on the command line through the old snprintf() path and the
+ * cache, with a new sample every 10 page renders, and the cost of one read that hits and one that misses.
+ * Exits with 1 if any check fails.
+ */
+
+#define SC_TAGS_MAX             (256)
+#define SC_PAGE_MAX             (1 << 20)
+#define SC_RENDERS              (200000)
+#define SC_SAMPLE_EVERY         (10)            // page renders per new sample
+#define SC_TEXT_MAX             (64)
+
+typedef struct
+{
+    const char *tag;
+    SSI_VALUE_T value;
+} SC_TAG_T;
+
+// prototypes
+static void sc_usage(const char *program);
+static bool sc_check_values(void);
+static bool sc_check_epochs(void);
+static void sc_page(const char *name);
+static void sc_publish(int reading);
+static int sc_old(SSI_VALUE_T value, bool archaic_units, char *buffer, int length);
+static double sc_now_ns(void);
+
+// the variables web_snapshot.c publishes
+WEB_VARIABLES_T web;
+
+// static variables
+static const SC_TAG_T sc_tags[] =
+{
+    {"wind",    SSI_VALUE_ANEMOMETER_WIND},
+    {"temp",    SSI_VALUE_OUTSIDE_TEMPERATURE},
+    {"rain",    SSI_VALUE_RAIN_DAY},
+    {"rainwk",  SSI_VALUE_RAIN_WEEK},
+    {"lstsvn",  SSI_VALUE_RAIN_SEVEN_DAYS},
+    {"tct",     SSI_VALUE_THERMOSTAT_TEMPERATURE},
+    {"tcs",     SSI_VALUE_THERMOSTAT_SET_POINT},
+};
+
+static const int sc_num_tags = sizeof(sc_tags)/sizeof(sc_tags[0]);
+
+int main(int argc, char *argv[])
+{
+    char text[SC_TEXT_MAX];
+    double start;
+    double hit_ns;
+    double miss_ns;
+    bool passed = true;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "h")) != -1)
+    {
+        sc_usage(argv[0]);
+        return(option == 'h' ? 0 : 1);
+    }
+
+    passed &= sc_check_values();
+    passed &= sc_check_epochs();
+
+    // one read per sample formats the whole group, the rest copy
+    start = sc_now_ns();
+    for (i=0; i<SC_RENDERS; i++)
+    {
+        sc_publish(i % 1000);
+        ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, i & 1, text, sizeof(text));
+    }
+    miss_ns = (sc_now_ns() - start)/SC_RENDERS;
+
+    start = sc_now_ns();
+    for (i=0; i<SC_RENDERS; i++)
+    {
+        sc_publish(i % 1000);
+    }
+    miss_ns -= (sc_now_ns() - start)/SC_RENDERS;
+
+    start = sc_now_ns();
+    for (i=0; i<SC_RENDERS; i++)
+    {
+        ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, i & 1, text, sizeof(text));
+    }
+    hit_ns = (sc_now_ns() - start)/SC_RENDERS;
+
+    printf("read after a new sample (formats the weather group) %6.0f ns, cached read %4.0f ns\n", miss_ns, hit_ns);
+
+    for (i=optind; i<argc; i++)
+    {
+        sc_page(argv[i]);
+    }
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void sc_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [page...]\n"
+            "  page         .shtml files whose cached tags are timed\n",
+            program);
+}
+
+/*!
+ * \brief Compare every cached value with the old snprintf() output over a range of readings
+ *
+ * \return true if all match
+ */
+static bool sc_check_values(void)
+{
+    char expected[SC_TEXT_MAX];
+    char cached[SC_TEXT_MAX];
+    int mismatches = 0;
+    int compared = 0;
+    int reading;
+    int units;
+    int i;
+
+    for (reading=-1200; reading<=1200; reading++)
+    {
+        sc_publish(reading);
+
+        for (i=0; i<sc_num_tags; i++)
+        {
+            for (units=0; units<2; units++)
+            {
+                sc_old(sc_tags[i].value, units, expected, sizeof(expected));
+                ssi_cache_get(sc_tags[i].value, units, cached, sizeof(cached));
+                compared++;
+
+                if (strcmp(expected, cached))
+                {
+                    if (mismatches++ < 5)
+                    {
+                        printf("%-6s %6d %s: \"%s\" expected \"%s\"\n", sc_tags[i].tag, reading, units ? "archaic" : "metric", cached, expected);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%d values compared with the old output, %d differ  %s\n", compared, mismatches, mismatches ? "FAIL" : "ok");
+
+    return(mismatches == 0);
+}
+
+/*!
+ * \brief Check that the cache follows new samples and only new samples
+ *
+ * \return true if it does
+ */
+static bool sc_check_epochs(void)
+{
+    char text[SC_TEXT_MAX];
+    bool passed = true;
+
+    sc_publish(215);
+    ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, false, text, sizeof(text));
+    passed &= !strcmp(text, " 21.5");
+
+    // a store that bypasses the bracket is not a new sample so the cached text stands
+    web.outside_temperature = 300;
+    ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, false, text, sizeof(text));
+    passed &= !strcmp(text, " 21.5");
+
+    // a store to another group leaves this one cached
+    web_write_begin(WEB_GROUP_WIND);
+    web.anemometer_wind_speed = 77;
+    web_write_end(WEB_GROUP_WIND);
+    ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, false, text, sizeof(text));
+    passed &= !strcmp(text, " 21.5");
+    ssi_cache_get(SSI_VALUE_ANEMOMETER_WIND, false, text, sizeof(text));
+    passed &= !strcmp(text, "7.7");
+
+    sc_publish(-31);
+    ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, false, text, sizeof(text));
+    passed &= !strcmp(text, "-3.1");
+
+    // a short insert buffer is truncated and terminated
+    ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, false, text, 3);
+    passed &= !strcmp(text, "-3");
+
+    printf("cache follows each group's samples  %s\n", passed ? "ok" : "FAIL");
+
+    return(passed);
+}
+
+/*!
+ * \brief Time the cached tags of a page through the old snprintf() path and the cache
+ *
+ * \param[in]  name     page file
+ *
+ * \return nothing
+ */
+static void sc_page(const char *name)
+{
+    static char page[SC_PAGE_MAX];
+    SSI_VALUE_T values[SC_TAGS_MAX];
+    char text[SC_TEXT_MAX];
+    char tag[16];
+    FILE *file;
+    size_t length;
+    double start;
+    double old_ns;
+    double cache_ns;
+    char *next;
+    int num_values = 0;
+    int total = 0;
+    int render;
+    int i;
+
+    file = fopen(name, "r");
+    if (!file)
+    {
+        printf("cannot open %s: %s\n", name, strerror(errno));
+        return;
+    }
+    length = fread(page, 1, sizeof(page) - 1, file);
+    page[length] = 0;
+    fclose(file);
+
+    for (next=strstr(page, "<!--#"); next; next=strstr(next + 5, "<!--#"))
+    {
+        total++;
+        if (sscanf(next + 5, "%15[a-z0-9]", tag) != 1)
+        {
+            continue;
+        }
+        for (i=0; (i<sc_num_tags) && (num_values<SC_TAGS_MAX); i++)
+        {
+            if (!strcmp(tag, sc_tags[i].tag))
+            {
+                values[num_values++] = sc_tags[i].value;
+            }
+        }
+    }
+
+    if (!num_values)
+    {
+        return;
+    }
+
+    // publishing costs the same either way so it is taken out of the cache timing
+    start = sc_now_ns();
+    for (render=0; render<SC_RENDERS; render++)
+    {
+        for (i=0; i<num_values; i++)
+        {
+            sc_old(values[i], render & 1, text, sizeof(text));
+        }
+    }
+    old_ns = (sc_now_ns() - start)/SC_RENDERS;
+
+    start = sc_now_ns();
+    for (render=0; render<SC_RENDERS; render++)
+    {
+        if (!(render % SC_SAMPLE_EVERY))
+        {
+            sc_publish(render % 1000);
+        }
+        for (i=0; i<num_values; i++)
+        {
+            ssi_cache_get(values[i], render & 1, text, sizeof(text));
+        }
+    }
+    cache_ns = sc_now_ns() - start;
+
+    start = sc_now_ns();
+    for (render=0; render<SC_RENDERS; render+=SC_SAMPLE_EVERY)
+    {
+        sc_publish(render % 1000);
+    }
+    cache_ns = (cache_ns - (sc_now_ns() - start))/SC_RENDERS;
+
+    printf("%-45s %3d tags, %2d cached: snprintf %5.0f ns, cache %5.0f ns per page\n", name, total, num_values, old_ns, cache_ns);
+}
+
+/*!
+ * \brief Publish one reading into every cached field, as the producers do
+ *
+ * \param[in]  reading  tenths
+ *
+ * \return nothing
+ */
+static void sc_publish(int reading)
+{
+    web_write_begin(WEB_GROUP_WIND);
+    web.anemometer_wind_speed = reading;
+    web_write_end(WEB_GROUP_WIND);
+
+    web_write_begin(WEB_GROUP_WEATHER);
+    web.outside_temperature = reading;
+    web.daily_rain = reading;
+    web.weekly_rain = reading;
+    web.trailing_seven_days_rain = reading;
+    web_write_end(WEB_GROUP_WEATHER);
+
+    web_write_begin(WEB_GROUP_THERMOSTAT);
+    web.thermostat_temperature = reading;
+    web.thermostat_set_point = reading;
+    web_write_end(WEB_GROUP_THERMOSTAT);
+}
+
+/*!
+ * \brief Format a value as ssi_handler() did before the cache, with the sign of negative wind and rain fixed
+ *
+ * \param[in]   value             value to format
+ * \param[in]   archaic_units     true for imperial units
+ * \param[out]  buffer            destination
+ * \param[in]   length            size of destination
+ *
+ * \return characters printed
+ */
+static int sc_old(SSI_VALUE_T value, bool archaic_units, char *buffer, int length)
+{
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+    WEB_THERMOSTAT_T thermostat;
+    long temp;
+    int i;
+
+    switch(value)
+    {
+        case SSI_VALUE_ANEMOMETER_WIND:
+            web_snapshot_wind(&wind);
+            i = wind.wind_speed;
+            temp = archaic_units ? (i*3281 + 500)/1000 : i;
+            break;
+        case SSI_VALUE_STATION_WIND:
+            web_snapshot_weather(&weather);
+            i = weather.wind_speed;
+            temp = archaic_units ? (i*3281 + 500)/1000 : i;
+            break;
+        case SSI_VALUE_OUTSIDE_TEMPERATURE:
+            web_snapshot_weather(&weather);
+            temp = archaic_units ? (weather.outside_temperature*9)/5 + 320 : weather.outside_temperature;
+            return(snprintf(buffer, length, "%c%ld.%ld", temp<0?'-':' ', labs(temp)/10, labs(temp%10)));
+        case SSI_VALUE_RAIN_DAY:
+        case SSI_VALUE_RAIN_WEEK:
+        case SSI_VALUE_RAIN_SEVEN_DAYS:
+            web_snapshot_weather(&weather);
+            i = (value == SSI_VALUE_RAIN_DAY) ? weather.daily_rain : (value == SSI_VALUE_RAIN_WEEK) ? weather.weekly_rain : weather.trailing_seven_days_rain;
+            temp = archaic_units ? (10*i + 127)/254 : i;
+            break;
+        case SSI_VALUE_THERMOSTAT_TEMPERATURE:
+            web_snapshot_thermostat(&thermostat);
+            return(snprintf(buffer, length, "%c%d.%d", thermostat.temperature<0?'-':' ', abs(thermostat.temperature/10), abs(thermostat.temperature%10)));
+        case SSI_VALUE_THERMOSTAT_SET_POINT:
+        default:
+            web_snapshot_thermostat(&thermostat);
+            temp = thermostat.set_point;
+            return(snprintf(buffer, length, "%c%ld.%ld", temp<0?'-':' ', labs(temp)/10, labs(temp%10)));
+    }
+
+    // wind and rain printed "%ld.%ld" which gave "0.-5" for -0.5
+    if (temp < 0)
+    {
+        return(snprintf(buffer, length, "-%ld.%ld", -temp/10, -temp%10));
+    }
+
+    return(snprintf(buffer, length, "%ld.%ld", temp/10, temp%10));
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return nanoseconds
+ */
+static double sc_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e9 + now.tv_nsec);
+}
@@ -0,0 +1,797 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <getopt.h>
+
+#include "lwip/apps/fs.h"
+
+#include "seqlock.h"
+#include "config.h"
+#include "ssi.h"
+#include "custom_files.h"
+#include "ssi_render.h"
+
+/*
+ * SSI render test
+ *
+ * Links ssi_render.c and custom_files.c against the host stand-ins in client/shim, with a made up ssi_insert() in
+ * place of ssi.c, opens pages the way httpd does and checks that:
+ *
+ *   - a page is served as a custom stream without FS_FILE_FLAGS_SSI, so httpd does not scan the rendered text again
+ *   - the rendered text is what a plain expansion of the page gives whatever size of piece httpd reads, for awkward
+ *     tags and for any pages named on the command line
+ *   - ssi_render_lock_briefly() takes a free lock at once, waits for a lock released within SSI_RENDER_LOCK_WAIT_MS
+ *     and gives up on one that is not soon after that, counting both
+ *   - a page opened while every job is busy is answered at once with a 503 that loads the page again, or the home
+ *     page if the uri is not a plain path
+ *   - a tag that shows config strings is never torn while a stand-in cgi handler changes them inside
+ *     config_change_begin() and config_change_end(); the same run without the bracket shows that tearing happens
+ *   - every byte allocated with mem_malloc() is released once the pages are closed
+ *
+ * Then it compares how long the tcpip thread is held by a page of slow tags rendered inline, as httpd did, with the
+ * longest open or read of the same page rendered by the render task.  Hold times are the cpu time of the thread
+ * standing in for the tcpip thread, so the render task preempting it on a host with one core is not counted.
+ * Exits with 1 if any check fails.
+ */
+
+#define SR_PAGE_MAX             (1 << 18)
+#define SR_RESPONSE_MAX         (1 << 21)
+#define SR_SLOW_TAGS            (100)           // tags in the timed page
+#define SR_TAG_COST_US          (10)            // time each of them takes to render
+#define SR_CONFIG_TAGS          (20)            // config tags per page in the tearing run
+#define SR_CGI_GAP_NS           (20000)         // time between config changes
+#define SR_PAGES_MAX            (250)           // pages added to the stand-in htmldata.c, see SHIM_FS_FILES
+#define SR_HOLD_MS              (5)             // time a stand-in render task holds the lock
+
+typedef struct
+{
+    int length;                 // -1 if the page could not be opened as a custom stream
+    bool ssi;                   // httpd would scan it for tags
+    double hold_us;             // longest open or read, cpu time
+} SR_FETCH_T;
+
+// prototypes
+static int sr_check_pages(int files, char *names[]);
+static int sr_check_busy(void);
+static int sr_check_config(double seconds);
+static void sr_time_pages(void);
+static void sr_run_config(bool guarded, double seconds, long *pages, long *torn, long *changes);
+static void *sr_cgi(void *arg);
+static void *sr_hold(void *arg);
+static int sr_fetch(const char *name, int piece, char *response, int size, SR_FETCH_T *fetch);
+static void sr_wake(void *arg);
+static int sr_expand(const char *page, int length, char *out);
+static const char *sr_add_page(const char *text, int length);
+static double sr_now_us(void);
+static double sr_cpu_us(void);
+
+// static variables
+static char sr_response[SR_RESPONSE_MAX];
+static char sr_expected[SR_RESPONSE_MAX];
+static int sr_pages_added = 0;
+
+// config strings a tag shows, changed by sr_cgi() as a cgi handler would
+static char sr_config_a[16];
+static char sr_config_b[16];
+static SEQLOCK_T sr_config_lock;
+static volatile bool sr_guarded = true;
+static volatile bool sr_stop = false;
+static volatile bool sr_held = false;
+
+// awkward pages: tags split, unterminated, too long, unknown, empty and larger than the render buffer
+static const char *sr_cases[] =
+{
+    "",
+    "plain",
+    "<!--#a-->",
+    "x<!--#a-->y",
+    "<!--# a -->",
+    "<!--#toolongname-->",
+    "<!--#-->",
+    "<!--#a",
+    "<!--#a--",
+    "<<!--#b--><",
+    "<!--#zz-->",
+    "<!--#empty-->|",
+    "<!-- comment --><!--#c-->",
+    "<!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big-->"
+    "<!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big--><!--#big-->",
+};
+
+int main(int argc, char *argv[])
+{
+    double seconds = 1.0;
+    int failures = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "t:h")) != -1)
+    {
+        switch(option)
+        {
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [page.shtml ...]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    ssi_render_init();
+
+    failures += sr_check_pages(argc - optind, argv + optind);
+    failures += sr_check_config(seconds);
+    sr_time_pages();
+    failures += sr_check_busy();
+
+    if (shim_mem_allocated)
+    {
+        printf("%ld mem_malloc() blocks not freed\n", shim_mem_allocated);
+        failures++;
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return(failures ? 1 : 0);
+}
+
+/*!
+ * \brief Render the awkward pages and any named on the command line, comparing with sr_expand()
+ *
+ * \param[in]  files    number of page files
+ * \param[in]  names    their paths
+ *
+ * \return number of failures
+ */
+static int sr_check_pages(int files, char *names[])
+{
+    static char text[SR_PAGE_MAX];
+    const int pieces[] = {1, 7, 100, 1460, SSI_RENDER_WINDOW};
+    SR_FETCH_T fetch;
+    const char *name;
+    FILE *file;
+    int cases = (int)(sizeof(sr_cases)/sizeof(sr_cases[0]));
+    int failures = 0;
+    int expected;
+    int length;
+    int piece;
+    int i;
+
+    for (i=0; i<cases + files; i++)
+    {
+        if (i < cases)
+        {
+            length = strlen(sr_cases[i]);
+            name = sr_add_page(sr_cases[i], length);
+        }
+        else
+        {
+            file = fopen(names[i - cases], "rb");
+            if (!file)
+            {
+                perror(names[i - cases]);
+                failures++;
+                continue;
+            }
+            length = fread(text, 1, sizeof(text), file);
+            fclose(file);
+            name = sr_add_page(text, length);
+        }
+
+        if (!name)
+        {
+            failures++;
+            continue;
+        }
+
+        for (piece=0; piece<(int)(sizeof(pieces)/sizeof(pieces[0])); piece++)
+        {
+            sr_fetch(name, pieces[piece], sr_response, sizeof(sr_response), &fetch);
+            expected = sr_expand(i < cases ? sr_cases[i] : text, length, sr_expected);
+
+            if (fetch.ssi || (fetch.length != expected) || memcmp(sr_response, sr_expected, expected))
+            {
+                printf("page %d read in %d byte pieces: %d bytes%s, expected %d\n", i, pieces[piece], fetch.length,
+                       fetch.ssi ? " flagged for ssi" : "", expected);
+                failures++;
+            }
+        }
+    }
+
+    printf("%d pages rendered in %d piece sizes, %d differ from the plain expansion\n", cases + files,
+           (int)(sizeof(pieces)/sizeof(pieces[0])), failures);
+
+    return(failures);
+}
+
+/*!
+ * \brief Check that the tcpip thread waits only briefly for the render lock, and never for a job when every one is busy
+ *
+ * \return number of failures
+ */
+static int sr_check_busy(void)
+{
+    static char big[SR_PAGE_MAX];
+    struct fs_file files[SSI_RENDER_JOBS];
+    SSI_RENDER_STATS_T before;
+    SSI_RENDER_STATS_T after;
+    SR_FETCH_T fetch;
+    const char *name;
+    char expected[64];
+    double start;
+    double waited;
+    pthread_t holder;
+    bool locked;
+    bool again;
+    int failures = 0;
+    int length = 0;
+    int attempts;
+    int i;
+
+    ssi_render_get_stats(&before);
+    start = sr_now_us();
+    locked = ssi_render_lock_briefly();
+    waited = sr_now_us() - start;
+    printf("render lock: free lock taken %s in %.1f us\n", locked ? "yes" : "no", waited);
+    failures += (!locked || (waited > 1000));
+
+    // held by this thread as if by the render task, so it is never released
+    start = sr_now_us();
+    again = ssi_render_lock_briefly();
+    waited = sr_now_us() - start;
+    printf("render lock: busy lock taken %s after %.1f ms\n", again ? "yes" : "no", waited/1000);
+    failures += (again || (waited < SSI_RENDER_LOCK_WAIT_MS*1000*0.9) || (waited > SSI_RENDER_LOCK_WAIT_MS*1000*5));
+    ssi_render_unlock();
+
+    // released part way through the wait
+    sr_held = false;
+    pthread_create(&holder, NULL, sr_hold, NULL);
+    while (!sr_held)
+    {
+        sched_yield();
+    }
+    start = sr_now_us();
+    again = ssi_render_lock_briefly();
+    waited = sr_now_us() - start;
+    pthread_join(holder, NULL);
+    if (again)
+    {
+        ssi_render_unlock();
+    }
+    printf("render lock: lock released after %d ms taken %s after %.1f ms\n", SR_HOLD_MS, again ? "yes" : "no", waited/1000);
+    failures += !again;
+
+    ssi_render_get_stats(&after);
+    printf("render lock: %u tags waited, %u left empty\n", after.tags_waited - before.tags_waited, after.tags_empty - before.tags_empty);
+    failures += (after.tags_waited - before.tags_waited != 2) || (after.tags_empty - before.tags_empty != 1);
+
+    // pages larger than the render buffer stay busy until they are read
+    for (i=0; i<30; i++)
+    {
+        length += snprintf(big + length, sizeof(big) - length, "<!--#big-->");
+    }
+    name = sr_add_page(big, length);
+    if (!name)
+    {
+        return(failures + 1);
+    }
+
+    // the render task frees the jobs of pages closed earlier when it next runs, so a job may not be free at once
+    for (i=0, attempts=0; (i<SSI_RENDER_JOBS) && (attempts<1000); attempts++)
+    {
+        ssi_render_get_stats(&before);
+        fs_open(&files[i], name);
+        ssi_render_get_stats(&after);
+
+        if (after.declined == before.declined)
+        {
+            i++;
+        }
+        else
+        {
+            fs_close(&files[i]);
+            sleep_ms(1);
+        }
+    }
+
+    if (i < SSI_RENDER_JOBS)
+    {
+        printf("render jobs were never freed\n");
+        return(failures + 1);
+    }
+
+    ssi_render_get_stats(&before);
+
+    sr_fetch(name, 100, sr_response, sizeof(sr_response) - 1, &fetch);
+    sr_response[fetch.length > 0 ? fetch.length : 0] = 0;
+    printf("page opened while every job is busy: %d bytes, held the tcpip thread %.1f us at most\n", fetch.length, fetch.hold_us);
+    snprintf(expected, sizeof(expected), "url=%s\"", name);
+    failures += (strncmp(sr_response, "HTTP/1.0 503", 12) != 0) || !strstr(sr_response, expected);
+
+    // a uri that is not a plain path must not reach the page
+    sr_fetch("/a\"><b.shtml", 100, sr_response, sizeof(sr_response) - 1, &fetch);
+    sr_response[fetch.length > 0 ? fetch.length : 0] = 0;
+    failures += (strncmp(sr_response, "HTTP/1.0 503", 12) != 0) || !strstr(sr_response, "url=/\"") || strstr(sr_response, "\"><b");
+
+    for (i=0; i<SSI_RENDER_JOBS; i++)
+    {
+        fs_close(&files[i]);
+    }
+    shim_tcpip_run();
+
+    ssi_render_get_stats(&after);
+    printf("%u pages declined\n", after.declined - before.declined);
+    failures += (after.declined - before.declined != 2);
+
+    return(failures);
+}
+
+/*!
+ * \brief Render pages of config tags while a stand-in cgi handler changes config, without and with the bracket
+ *
+ * \param[in]  seconds  how long each run lasts
+ *
+ * \return number of failures
+ */
+static int sr_check_config(double seconds)
+{
+    long pages;
+    long torn;
+    long changes;
+
+    sr_run_config(false, seconds, &pages, &torn, &changes);
+    printf("config unbracketed: %6ld pages %5ld torn tags %8ld changes\n", pages, torn, changes);
+
+    sr_run_config(true, seconds, &pages, &torn, &changes);
+    printf("config bracketed:   %6ld pages %5ld torn tags %8ld changes\n", pages, torn, changes);
+
+    return((torn || !pages || !changes) ? 1 : 0);
+}
+
+/*!
+ * \brief Time a page of slow tags rendered inline and by the render task
+ *
+ * \return nothing
+ */
+static void sr_time_pages(void)
+{
+    static char page[SR_PAGE_MAX];
+    SR_FETCH_T fetch;
+    const char *name;
+    double start;
+    double inline_us;
+    int length = 0;
+    int i;
+
+    for (i=0; i<SR_SLOW_TAGS; i++)
+    {
+        length += snprintf(page + length, sizeof(page) - length, "<tr><td>%d</td><td><!--#slow--></td></tr>\n", i);
+    }
+    name = sr_add_page(page, length);
+    if (!name)
+    {
+        return;
+    }
+
+    start = sr_cpu_us();
+    sr_expand(page, length, sr_expected);
+    inline_us = sr_cpu_us() - start;
+
+    sr_fetch(name, SSI_RENDER_WINDOW, sr_response, sizeof(sr_response), &fetch);
+
+    printf("%d tags of %d us: tcpip thread held %.1f us rendering inline, at most %.1f us per open or read with the render task\n",
+           SR_SLOW_TAGS, SR_TAG_COST_US, inline_us, fetch.hold_us);
+}
+
+/*!
+ * \brief Render pages of config tags for a while and count the tags that mix two changes
+ *
+ * \param[in]   guarded   the stand-in handler brackets its changes
+ * \param[in]   seconds   how long to run
+ * \param[out]  pages     pages rendered
+ * \param[out]  torn      tags that mixed two changes
+ * \param[out]  changes   changes made
+ *
+ * \return nothing
+ */
+static void sr_run_config(bool guarded, double seconds, long *pages, long *torn, long *changes)
+{
+    static char page[SR_PAGE_MAX];
+    static const char *name = NULL;
+    SR_FETCH_T fetch;
+    pthread_t cgi;
+    double end;
+    char *line;
+    int length = 0;
+    int i;
+
+    if (!name)
+    {
+        for (i=0; i<SR_CONFIG_TAGS; i++)
+        {
+            length += snprintf(page + length, sizeof(page) - length, "<!--#cfg-->\n");
+        }
+        name = sr_add_page(page, length);
+    }
+
+    memset(sr_config_a, '0', sizeof(sr_config_a) - 1);
+    memset(sr_config_b, '0', sizeof(sr_config_b) - 1);
+    sr_guarded = guarded;
+    sr_stop = false;
+    *pages = 0;
+    *torn = 0;
+    *changes = 0;
+
+    pthread_create(&cgi, NULL, sr_cgi, changes);
+
+    end = sr_now_us() + seconds*1e6;
+    while (name && (sr_now_us() < end))
+    {
+        if (sr_fetch(name, SSI_RENDER_WINDOW, sr_response, sizeof(sr_response) - 1, &fetch) < 0)
+        {
+            (*torn)++;
+            break;
+        }
+        sr_response[fetch.length] = 0;
+        (*pages)++;
+
+        for (line = strtok(sr_response, "\n"); line; line = strtok(NULL, "\n"))
+        {
+            *torn += (strlen(line) != 2*sizeof(sr_config_a) - 1) || memcmp(line, line + sizeof(sr_config_a), sizeof(sr_config_a) - 1);
+        }
+    }
+
+    sr_stop = true;
+    pthread_join(cgi, NULL);
+}
+
+/*!
+ * \brief Change both config strings to the next count, as a cgi handler on the tcpip thread
+ *
+ * \param[out]  arg   long, changes made
+ *
+ * \return NULL
+ */
+static void *sr_cgi(void *arg)
+{
+    struct timespec gap = {0, SR_CGI_GAP_NS};
+    long *changes = (long *)arg;
+    char text[sizeof(sr_config_a)];
+    uint32_t count = 0;
+
+    while (!sr_stop)
+    {
+        snprintf(text, sizeof(text), "%015u", (unsigned)++count);
+
+        config_change_begin();
+        memcpy(sr_config_a, text, sizeof(sr_config_a));
+        memcpy(sr_config_b, text, sizeof(sr_config_b));
+        config_change_end();
+
+        (*changes)++;
+        nanosleep(&gap, NULL);
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Hold the render lock for SR_HOLD_MS, as the render task filling a buffer
+ *
+ * \param[in]   arg   unused
+ *
+ * \return NULL
+ */
+static void *sr_hold(void *arg)
+{
+    (void)arg;
+
+    ssi_render_lock_briefly();
+    sr_held = true;
+    sleep_ms(SR_HOLD_MS);
+    ssi_render_unlock();
+
+    return(NULL);
+}
+
+/*!
+ * \brief Open a page and read all of it, as httpd does on the tcpip thread
+ *
+ * \param[in]   name      uri
+ * \param[in]   piece     largest read
+ * \param[out]  response  text read
+ * \param[in]   size      size of response
+ * \param[out]  fetch     length, whether httpd would scan it and how long the tcpip thread was held
+ *
+ * \return length, or -1 if the page is not served as a custom stream or does not fit
+ */
+static int sr_fetch(const char *name, int piece, char *response, int size, SR_FETCH_T *fetch)
+{
+    struct fs_file file;
+    double start;
+    double held;
+    int read;
+
+    memset(fetch, 0, sizeof(SR_FETCH_T));
+
+    start = sr_cpu_us();
+    if (fs_open(&file, name) != ERR_OK)
+    {
+        fetch->length = -1;
+        return(-1);
+    }
+    fetch->hold_us = sr_cpu_us() - start;
+    fetch->ssi = (file.flags & FS_FILE_FLAGS_SSI) != 0;
+
+    if (!file.is_custom_file)
+    {
+        fs_close(&file);
+        fetch->length = -1;
+        return(-1);
+    }
+
+    while (true)
+    {
+        if (!fs_canread_custom(&file))
+        {
+            // the render task is catching up, its notification runs on the tcpip thread
+            shim_tcpip_run();
+            sched_yield();
+            continue;
+        }
+
+        if (size - fetch->length < piece)
+        {
+            fetch->length = -1;
+            break;
+        }
+
+        start = sr_cpu_us();
+        read = fs_read_async_custom(&file, response + fetch->length, piece, sr_wake, NULL);
+        held = sr_cpu_us() - start;
+        if (held > fetch->hold_us)
+        {
+            fetch->hold_us = held;
+        }
+
+        if (read == FS_READ_EOF)
+        {
+            break;
+        }
+
+        if (read > 0)
+        {
+            fetch->length += read;
+        }
+    }
+
+    fs_close(&file);
+    shim_tcpip_run();
+
+    return(fetch->length);
+}
+
+/*!
+ * \brief httpd continuation for a parked stream, sr_fetch() polls instead
+ *
+ * \param[in]  arg  unused
+ *
+ * \return nothing
+ */
+static void sr_wake(__unused void *arg)
+{
+}
+
+/*!
+ * \brief Expand the tags of a page the plain way, as httpd does inline
+ *
+ * \param[in]   page      page text
+ * \param[in]   length    bytes of page text
+ * \param[out]  out       expanded text
+ *
+ * \return bytes of expanded text
+ */
+static int sr_expand(const char *page, int length, char *out)
+{
+    char insert[LWIP_HTTPD_MAX_TAG_INSERT_LEN + 1];
+    char name[LWIP_HTTPD_MAX_TAG_NAME_LEN + 1];
+    int written = 0;
+    int printed;
+    int name_length;
+    int i = 0;
+    int j;
+
+    while (i < length)
+    {
+        if ((length - i >= 5) && !memcmp(page + i, "<!--#", 5))
+        {
+            j = i + 5;
+            name_length = 0;
+            while ((j < length) && isspace((unsigned char)page[j]))
+            {
+                j++;
+            }
+            while ((j < length) && !isspace((unsigned char)page[j]) && (page[j] != '-') && (name_length < LWIP_HTTPD_MAX_TAG_NAME_LEN))
+            {
+                name[name_length++] = page[j++];
+            }
+            name[name_length] = 0;
+            while ((j < length) && isspace((unsigned char)page[j]))
+            {
+                j++;
+            }
+
+            if (name_length && (length - j >= 3) && !memcmp(page + j, "-->", 3))
+            {
+                printed = ssi_insert(name, insert, LWIP_HTTPD_MAX_TAG_INSERT_LEN);
+                if (printed < 0)
+                {
+                    printed = sprintf(insert, "<b>***UNKNOWN TAG %s***</b>", name);
+                }
+                memcpy(out + written, insert, printed);
+                written += printed;
+                i = j + 3;
+                continue;
+            }
+        }
+
+        out[written++] = page[i++];
+    }
+
+    return(written);
+}
+
+/*!
+ * \brief Serve a page as htmldata.c would, flagged for ssi as makefsdata.py does
+ *
+ * \param[in]  text     page text, copied
+ * \param[in]  length   bytes of text
+ *
+ * \return uri, or NULL if there is no room for another page
+ */
+static const char *sr_add_page(const char *text, int length)
+{
+    char *name;
+    char *copy;
+
+    name = malloc(32);
+    copy = malloc(length + 1);
+    if (!name || !copy || (sr_pages_added >= SR_PAGES_MAX))
+    {
+        free(name);
+        free(copy);
+        return(NULL);
+    }
+
+    snprintf(name, 32, "/page%d.shtml", sr_pages_added++);
+    memcpy(copy, text, length);
+    shim_fs_add(name, copy, length, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_SSI);
+
+    return(name);
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+static double sr_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
+
+/*!
+ * \brief Cpu time of the calling thread
+ *
+ * \return microseconds
+ */
+static double sr_cpu_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
+
+// stand-in for ssi.c: tags that print their name, fill the insert, print nothing, are unknown, are slow or show config
+int ssi_insert(const char *tag_name, char *insert, int length)
+{
+    double end;
+
+    if (!strcmp(tag_name, "zz"))
+    {
+        return(-1);
+    }
+
+    if (!strcmp(tag_name, "big"))
+    {
+        memset(insert, 'B', length - 1);
+        insert[length - 1] = 0;
+        return(length - 1);
+    }
+
+    if (!strcmp(tag_name, "empty"))
+    {
+        insert[0] = 0;
+        return(0);
+    }
+
+    if (!strcmp(tag_name, "slow"))
+    {
+        end = sr_now_us() + SR_TAG_COST_US;
+        while (sr_now_us() < end);
+    }
+
+    if (!strcmp(tag_name, "cfg"))
+    {
+        return(snprintf(insert, length, "%.15s|%.15s", sr_config_a, sr_config_b));
+    }
+
+    return(snprintf(insert, length, "[%s]", tag_name));
+}
+
+// stand-ins for the config.c bracket, the same as the firmware's but for switching it off
+void config_change_begin(void)
+{
+    if (sr_guarded)
+    {
+        seqlock_write_begin(&sr_config_lock);
+    }
+}
+
+void config_change_end(void)
+{
+    if (sr_guarded)
+    {
+        seqlock_write_end(&sr_config_lock);
+    }
+}
+
+uint32_t config_read_begin(void)
+{
+    uint32_t start;
+
+    while ((start = sr_config_lock.sequence) & 1)
+    {
+        vTaskDelay(1);
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return(start);
+}
+
+bool config_read_retry(uint32_t start)
+{
+    return(seqlock_read_retry(&sr_config_lock, start));
+}
+
+// the other custom files are not under test
+void *api_wind_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_weather_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_status_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_thermostat_open(__unused const char *name, __unused int *length) { return(NULL); }
+int api_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+void api_close(__unused void *state) { }
+void *events_open(__unused const char *name, __unused int *length) { return(NULL); }
+int events_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool events_ready(__unused void *state) { return(false); }
+void events_close(__unused void *state) { }
+int copy_temperature_history(__unused uint32_t *unix_time, __unused int16_t *temperaturex10, __unused int max_points) { return(0); }
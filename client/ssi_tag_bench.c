@@ -0,0 +1,453 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sched.h>
+
+#include "lwip/apps/fs.h"
+
+#include "config.h"
+#include "ssi.h"
+#include "ssi_render.h"
+#include "ssi_tags.h"
+
+/*
+ * SSI tag lookup benchmark
+ *
+ * Collects the tags from web pages in the order httpd meets them and times resolving each one to its index in
+ * ssi_tags[] in two ways:
+ *
+ *   - linear, the strcmp loop httpd runs over the tag table when LWIP_HTTPD_SSI_RAW is off
+ *   - hashed, ssi_tag_index() from ssi_hash.c with the tables generated by makessihash.py
+ *
+ * Every tag is checked to resolve to the same index both ways before anything is timed.  ssi_tags.h is the SSI_TAGS
+ * list extracted from ssi.c by the Makefile so the benchmark always runs against the current table.
+ *
+ * Then the pages themselves are served through ssi_render.c and custom_files.c against the host stand-ins in
+ * client/shim, read the way httpd reads them, with a stand-in ssi_insert() that resolves each tag one of the two
+ * ways and prints its index in place of the value ssi_handler() would.  The rendered pages have to be the same both
+ * ways, and the time per page render gives the speedup a whole page sees rather than the lookup alone.
+ */
+
+#define SB_TAGS_MAX             (65536)
+#define SB_TAG_NAME_MAX         (32)
+#define SB_PAGE_MAX             (1 << 20)
+#define SB_PAGES_MAX            (250)           // pages added to the stand-in htmldata.c, see SHIM_FS_FILES
+#define SB_RESPONSE_MAX         (1 << 20)
+
+// the table ssi_tag_index() resolves against, built from the same x-macro as ssi.c
+const char *ssi_tags[] =
+{
+#define x(name) #name,
+SSI_TAGS
+#undef x
+};
+
+// prototypes
+static void sb_usage(const char *program);
+static int sb_load(const char *name);
+static int sb_linear(const char *tag_name);
+static double sb_time(int (*lookup)(const char *tag_name), int passes, int *checksum);
+static int sb_render(const char *name, char *response, int size);
+static double sb_time_renders(int (*lookup)(const char *tag_name), int passes);
+static void sb_wake(void *arg);
+static double sb_now_us(void);
+
+// static variables
+static char sb_tags[SB_TAGS_MAX][SB_TAG_NAME_MAX];
+static int sb_num_tags = 0;
+static int sb_num_pages = 0;
+static const int sb_table_size = sizeof(ssi_tags)/sizeof(ssi_tags[0]);
+static char sb_page_names[SB_PAGES_MAX][32];
+static int (*sb_lookup)(const char *tag_name) = ssi_tag_index;  // used by the stand-in ssi_insert()
+static char sb_linear_response[SB_RESPONSE_MAX];
+static char sb_hashed_response[SB_RESPONSE_MAX];
+
+int main(int argc, char *argv[])
+{
+    double linear_us;
+    double hashed_us;
+    int passes = 200;
+    int render_passes = 20;
+    int linear_length;
+    int hashed_length;
+    int linear_sum;
+    int hashed_sum;
+    int unknown = 0;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "p:r:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'p':
+                passes = atoi(optarg);
+                break;
+            case 'r':
+                render_passes = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                sb_usage(argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    if ((optind >= argc) || (passes <= 0) || (render_passes <= 0))
+    {
+        sb_usage(argv[0]);
+        return(1);
+    }
+
+    for (i=optind; i<argc; i++)
+    {
+        if (sb_load(argv[i]))
+        {
+            return(1);
+        }
+    }
+
+    // both lookups must agree before the timing means anything
+    for (i=0; i<sb_table_size; i++)
+    {
+        if (ssi_tag_index(ssi_tags[i]) != i)
+        {
+            printf("tag %s resolves to %d, expected %d\n", ssi_tags[i], ssi_tag_index(ssi_tags[i]), i);
+            return(1);
+        }
+    }
+    for (i=0; i<sb_num_tags; i++)
+    {
+        if (ssi_tag_index(sb_tags[i]) != sb_linear(sb_tags[i]))
+        {
+            printf("tag %s resolves to %d hashed and %d linear\n", sb_tags[i], ssi_tag_index(sb_tags[i]), sb_linear(sb_tags[i]));
+            return(1);
+        }
+        unknown += (sb_linear(sb_tags[i]) < 0);
+    }
+    if (ssi_tag_index("") != -1)
+    {
+        printf("empty tag name resolves to %d\n", ssi_tag_index(""));
+        return(1);
+    }
+
+    printf("%d tags in table, %d tags in %d pages (%d unknown), all resolve the same both ways\n",
+           sb_table_size, sb_num_tags, sb_num_pages, unknown);
+
+    linear_us = sb_time(sb_linear, passes, &linear_sum);
+    hashed_us = sb_time(ssi_tag_index, passes, &hashed_sum);
+
+    printf("linear: %8.1f ns per tag %12.0f tags/s\n", linear_us*1000/((double)passes*sb_num_tags), (double)passes*sb_num_tags/(linear_us/1e6));
+    printf("hashed: %8.1f ns per tag %12.0f tags/s\n", hashed_us*1000/((double)passes*sb_num_tags), (double)passes*sb_num_tags/(hashed_us/1e6));
+    printf("speedup %.1fx\n", linear_us/hashed_us);
+
+    if (linear_sum != hashed_sum)
+    {
+        return(1);
+    }
+
+    // whole pages, as the render task serves them
+    ssi_render_init();
+
+    for (i=0; i<sb_num_pages; i++)
+    {
+        sb_lookup = sb_linear;
+        linear_length = sb_render(sb_page_names[i], sb_linear_response, sizeof(sb_linear_response));
+        sb_lookup = ssi_tag_index;
+        hashed_length = sb_render(sb_page_names[i], sb_hashed_response, sizeof(sb_hashed_response));
+
+        if ((linear_length < 0) || (linear_length != hashed_length) || memcmp(sb_linear_response, sb_hashed_response, linear_length))
+        {
+            printf("page %s renders as %d bytes linear and %d bytes hashed, or differently\n", argv[optind + i], linear_length, hashed_length);
+            return(1);
+        }
+    }
+
+    linear_us = sb_time_renders(sb_linear, render_passes);
+    hashed_us = sb_time_renders(ssi_tag_index, render_passes);
+
+    printf("%d pages render the same both ways\n", sb_num_pages);
+    printf("linear: %8.1f us per page render\n", linear_us/((double)render_passes*sb_num_pages));
+    printf("hashed: %8.1f us per page render\n", hashed_us/((double)render_passes*sb_num_pages));
+    printf("page render speedup %.2fx\n", linear_us/hashed_us);
+
+    return(0);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void sb_usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [-p passes] [-r passes] page...\n"
+            "  -p count     look up every tag this many times (default 200)\n"
+            "  -r count     render every page this many times (default 20)\n"
+            "  page         .shtml files to take the tags from\n",
+            program);
+}
+
+/*!
+ * \brief Append the tags found in a page to sb_tags[]
+ *
+ * \param[in]  name     file name
+ *
+ * \return 0 on success, -1 if the file cannot be read
+ */
+static int sb_load(const char *name)
+{
+    FILE *file;
+    size_t length;
+    char *page;
+    char *tag;
+    char *end;
+
+    page = malloc(SB_PAGE_MAX);
+    if (!page || (sb_num_pages >= SB_PAGES_MAX))
+    {
+        fprintf(stderr, "too many pages\n");
+        free(page);
+        return(-1);
+    }
+
+    file = fopen(name, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", name, strerror(errno));
+        free(page);
+        return(-1);
+    }
+    length = fread(page, 1, SB_PAGE_MAX - 1, file);
+    page[length] = 0;
+    fclose(file);
+
+    // served as htmldata.c would, flagged for ssi as makefsdata.py does
+    snprintf(sb_page_names[sb_num_pages], sizeof(sb_page_names[0]), "/bench%d.shtml", sb_num_pages);
+    shim_fs_add(sb_page_names[sb_num_pages], page, length, FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_SSI);
+
+    for (tag=strstr(page, "<!--#"); tag && (sb_num_tags < SB_TAGS_MAX); tag=strstr(end, "<!--#"))
+    {
+        tag += 5;
+        end = tag + strcspn(tag, " \t\r\n-");
+        if ((end > tag) && (end - tag < SB_TAG_NAME_MAX))
+        {
+            memcpy(sb_tags[sb_num_tags], tag, end - tag);
+            sb_tags[sb_num_tags][end - tag] = 0;
+            sb_num_tags++;
+        }
+    }
+    sb_num_pages++;
+
+    return(0);
+}
+
+/*!
+ * \brief Find the index of a tag as httpd does without LWIP_HTTPD_SSI_RAW
+ *
+ * \param[in]  tag_name   tag found in page
+ *
+ * \return index into ssi_tags[] or -1 if not a known tag
+ */
+static int sb_linear(const char *tag_name)
+{
+    int index;
+
+    for (index=0; index<sb_table_size; index++)
+    {
+        if (strcmp(tag_name, ssi_tags[index]) == 0)
+        {
+            return(index);
+        }
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Time looking up every collected tag
+ *
+ * \param[in]  lookup     function to time
+ * \param[in]  passes     times to look up each tag
+ * \param[out] checksum   sum of the indices found, so the calls cannot be optimised away
+ *
+ * \return elapsed microseconds
+ */
+static double sb_time(int (*lookup)(const char *tag_name), int passes, int *checksum)
+{
+    double start;
+    int pass;
+    int i;
+
+    *checksum = 0;
+
+    start = sb_now_us();
+    for (pass=0; pass<passes; pass++)
+    {
+        for (i=0; i<sb_num_tags; i++)
+        {
+            *checksum += lookup(sb_tags[i]);
+        }
+    }
+
+    return(sb_now_us() - start);
+}
+
+/*!
+ * \brief Read a page through the custom file hooks as httpd does
+ *
+ * \param[in]   name       page name
+ * \param[out]  response   rendered page
+ * \param[in]   size       size of response
+ *
+ * \return bytes rendered, -1 if the page was not served by the render task
+ */
+static int sb_render(const char *name, char *response, int size)
+{
+    struct fs_file file;
+    int length = 0;
+    int read;
+
+    if (fs_open(&file, name) != ERR_OK)
+    {
+        return(-1);
+    }
+
+    if (!file.is_custom_file)
+    {
+        fs_close(&file);
+        return(-1);
+    }
+
+    while (length >= 0)
+    {
+        if (!fs_canread_custom(&file))
+        {
+            // the render task is catching up, its notification runs on the tcpip thread
+            shim_tcpip_run();
+            sched_yield();
+            continue;
+        }
+
+        if (size - length < SSI_RENDER_WINDOW)
+        {
+            length = -1;
+            break;
+        }
+
+        read = fs_read_async_custom(&file, response + length, SSI_RENDER_WINDOW, sb_wake, NULL);
+        if (read == FS_READ_EOF)
+        {
+            break;
+        }
+
+        if (read > 0)
+        {
+            length += read;
+        }
+    }
+
+    fs_close(&file);
+    shim_tcpip_run();
+
+    return(length);
+}
+
+/*!
+ * \brief Time rendering every page
+ *
+ * \param[in]  lookup   how the stand-in ssi_insert() resolves tags
+ * \param[in]  passes   times to render each page
+ *
+ * \return elapsed microseconds
+ */
+static double sb_time_renders(int (*lookup)(const char *tag_name), int passes)
+{
+    double start;
+    int pass;
+    int i;
+
+    sb_lookup = lookup;
+
+    start = sb_now_us();
+    for (pass=0; pass<passes; pass++)
+    {
+        for (i=0; i<sb_num_pages; i++)
+        {
+            sb_render(sb_page_names[i], sb_linear_response, sizeof(sb_linear_response));
+        }
+    }
+
+    return(sb_now_us() - start);
+}
+
+/*!
+ * \brief httpd continuation for a parked stream, sb_render() polls instead
+ *
+ * \param[in]  arg  unused
+ *
+ * \return nothing
+ */
+static void sb_wake(__unused void *arg)
+{
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+static double sb_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
+
+// stand-in for ssi.c: resolve the tag as chosen and show its index in place of the value
+int ssi_insert(const char *tag_name, char *insert, int length)
+{
+    int index;
+
+    index = sb_lookup(tag_name);
+    if (index < 0)
+    {
+        return(-1);
+    }
+
+    return(snprintf(insert, length, "%d", index));
+}
+
+// the config strings are not changed while the pages render
+void config_change_begin(void) { }
+void config_change_end(void) { }
+uint32_t config_read_begin(void) { return(0); }
+bool config_read_retry(__unused uint32_t start) { return(false); }
+
+// the other custom files are not under test
+void *api_wind_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_weather_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_status_open(__unused const char *name, __unused int *length) { return(NULL); }
+void *api_thermostat_open(__unused const char *name, __unused int *length) { return(NULL); }
+int api_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+void api_close(__unused void *state) { }
+void *events_open(__unused const char *name, __unused int *length) { return(NULL); }
+int events_read(__unused void *state, __unused char *buffer, __unused int count) { return(0); }
+bool events_ready(__unused void *state) { return(false); }
+void events_close(__unused void *state) { }
+int copy_temperature_history(__unused uint32_t *unix_time, __unused int16_t *temperaturex10, __unused int max_points) { return(0); }
@@ -0,0 +1,691 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/flash.h"
+#include "store_forward.h"
+
+/*
+ * Store and forward queue test
+ *
+ * Links store_forward.c against the host stand-ins in client/shim, with a stand-in peer that can be up, down, slow
+ * or fail after a delay.  Every message carries an id given in submission order and a filler that depends on it, and
+ * every message and gap marker the peer receives is logged.  The log has to read as the ids in order, each run of
+ * missing ids announced by gap markers adding up to it, with no id received twice or damaged.  Built a second time
+ * as store_forward_flash_test with STORE_FORWARD_FLASH_SECTORS set, so the flash spill path runs against the shim
+ * flash, where programming can only clear bits.
+ *
+ * Checks that:
+ *
+ *   - messages go straight to a peer that is up
+ *   - an outage fills and wraps the ram queue (and spills to flash), drops the oldest, and replay sends the gap
+ *     marker then the rest at no more than STORE_FORWARD_REPLAY_PER_SECOND, pausing while the peer is down again
+ *   - messages submitted during replay queue behind it rather than overtaking
+ *   - submit returns at once while another task is in a slow send, directly or from the replay, and the task that
+ *     sent directly passes on what queued behind it
+ *   - a message dropped to make room while it was being replayed is neither repeated nor counted as lost, and the
+ *     gap markers add up to the number dropped
+ *   - a direct send that fails goes back in front of messages queued while it was in flight
+ *   - with flash, unreplayed sectors are recovered after a reboot, and not again once replayed
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#define SF_LOG_MAX              (100000)
+#define SF_OUTAGE_MESSAGES      (2000)
+#define SF_SLOW_MS              (200)
+#define SF_SUBMIT_MAX_MS        (50)        // longest a submit may take while another task is in a slow send
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    bool up;
+    int delay_ms;               // each send takes this long
+    bool fail_after_delay;      // and then fails, as a send that times out does
+    int in_send;                // sends in progress, never more than one
+    int overlapped;             // sends that started while another was in progress
+    int damaged;                // messages that did not read back as sent
+    int64_t log[SF_LOG_MAX];    // ids received, gap markers as minus the number lost
+    int log_count;
+} SF_PEER_T;
+
+// prototypes
+static void sf_usage(const char *program);
+static void sf_reset(void);
+static int sf_send(const char *message, int length);
+static int sf_gap(uint32_t lost);
+static int sf_submit(void);
+static void sf_replay(int limit_s);
+static bool sf_check_log(const char *name, uint32_t first);
+static bool sf_check_direct(void);
+static bool sf_check_outage(void);
+static bool sf_check_slow_direct(void);
+static bool sf_check_slow_replay(void);
+static bool sf_check_requeue(void);
+#if STORE_FORWARD_FLASH_SECTORS
+static bool sf_check_reboot(void);
+#endif
+static void *sf_submit_thread(void *arg);
+static void *sf_service_thread(void *arg);
+static void sf_wait_in_send(void);
+static double sf_now_ms(void);
+
+// static variables
+static SF_PEER_T sf_peer = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+static uint32_t sf_next_id = 0;
+
+int main(int argc, char *argv[])
+{
+    bool passed = true;
+    int option;
+
+    while ((option = getopt(argc, argv, "h")) != -1)
+    {
+        sf_usage(argv[0]);
+        return(option == 'h' ? 0 : 1);
+    }
+
+    printf("store and forward with %d flash sectors\n", STORE_FORWARD_FLASH_SECTORS);
+
+    passed &= sf_check_direct();
+    passed &= sf_check_outage();
+    passed &= sf_check_slow_direct();
+    passed &= sf_check_slow_replay();
+    passed &= sf_check_requeue();
+#if STORE_FORWARD_FLASH_SECTORS
+    passed &= sf_check_reboot();
+#endif
+
+    if (sf_peer.overlapped || shim_flash_errors)
+    {
+        printf("%d sends overlapped, %d flash writes were misaligned or did not take\n", sf_peer.overlapped, shim_flash_errors);
+        passed = false;
+    }
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+
+    return(passed ? 0 : 1);
+}
+
+/*!
+ * \brief Print command line help
+ *
+ * \param[in]  program  name the program was run as
+ *
+ * \return nothing
+ */
+static void sf_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s\n", program);
+}
+
+/*!
+ * \brief Start a check with an empty queue, erased flash and a peer that is up
+ *
+ * \return nothing
+ */
+static void sf_reset(void)
+{
+    flash_range_erase(0, PICO_FLASH_SIZE_BYTES);
+
+    sf_peer.up = true;
+    sf_peer.delay_ms = 0;
+    sf_peer.fail_after_delay = false;
+    sf_peer.log_count = 0;
+    sf_next_id = 0;
+
+    store_forward_init(sf_send, sf_gap);
+}
+
+/*!
+ * \brief Stand-in peer receiving a message
+ *
+ * \param[in]  message   message
+ * \param[in]  length    length of message
+ *
+ * \return length, or -1 if the peer is down
+ */
+static int sf_send(const char *message, int length)
+{
+    unsigned int id;
+    int result = length;
+    int i;
+
+    pthread_mutex_lock(&sf_peer.mutex);
+    if (sf_peer.in_send++)
+    {
+        sf_peer.overlapped++;
+    }
+    pthread_mutex_unlock(&sf_peer.mutex);
+
+    if (sf_peer.delay_ms)
+    {
+        usleep(sf_peer.delay_ms*1000);
+    }
+
+    pthread_mutex_lock(&sf_peer.mutex);
+
+    if (!sf_peer.up || sf_peer.fail_after_delay)
+    {
+        result = -1;
+    }
+    else if ((sscanf(message, "%8x", &id) != 1) || (length != 8 + (int)(id*37 % 190)))
+    {
+        sf_peer.damaged++;
+    }
+    else
+    {
+        for (i = 8; i < length; i++)
+        {
+            if (message[i] != 'a' + (char)((id + i) % 26))
+            {
+                sf_peer.damaged++;
+                break;
+            }
+        }
+
+        if (sf_peer.log_count < SF_LOG_MAX)
+        {
+            sf_peer.log[sf_peer.log_count++] = id;
+        }
+    }
+
+    sf_peer.in_send--;
+    pthread_mutex_unlock(&sf_peer.mutex);
+
+    return(result);
+}
+
+/*!
+ * \brief Stand-in peer receiving a gap marker
+ *
+ * \param[in]  lost   messages discarded
+ *
+ * \return 0, or -1 if the peer is down
+ */
+static int sf_gap(uint32_t lost)
+{
+    int result = -1;
+
+    pthread_mutex_lock(&sf_peer.mutex);
+
+    if (sf_peer.up && !sf_peer.fail_after_delay)
+    {
+        if (sf_peer.log_count < SF_LOG_MAX)
+        {
+            sf_peer.log[sf_peer.log_count++] = -(int64_t)lost;
+        }
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&sf_peer.mutex);
+
+    return(result);
+}
+
+/*!
+ * \brief Submit the next message, 8 to 197 bytes long
+ *
+ * \return what store_forward_submit() returned
+ */
+static int sf_submit(void)
+{
+    char message[STORE_FORWARD_MESSAGE_MAX];
+    uint32_t id = sf_next_id++;
+    int length = 8 + id*37 % 190;
+    int i;
+
+    snprintf(message, sizeof(message), "%08x", id);
+    for (i = 8; i < length; i++)
+    {
+        message[i] = 'a' + (id + i) % 26;
+    }
+
+    return(store_forward_submit(message, length));
+}
+
+/*!
+ * \brief Run store_forward_service() once a simulated second until the queue is empty
+ *
+ * \param[in]  limit_s  give up after this many simulated seconds
+ *
+ * \return nothing
+ */
+static void sf_replay(int limit_s)
+{
+    STORE_FORWARD_STATS_T stats;
+
+    do
+    {
+        shim_ticks_skipped += 1000;
+        store_forward_service();
+        store_forward_get_stats(&stats);
+    } while (stats.queued && limit_s--);
+}
+
+/*!
+ * \brief Check the peer received every id from first to the last submitted, in order, with gap markers for the rest
+ *
+ * \param[in]  name     check name
+ * \param[in]  first    id expected first
+ *
+ * \return true if the log is right
+ */
+static bool sf_check_log(const char *name, uint32_t first)
+{
+    STORE_FORWARD_STATS_T stats;
+    int64_t expected = first;
+    int64_t announced = 0;
+    int64_t announced_total = 0;
+    int64_t received = 0;
+    bool passed = true;
+    int i;
+
+    for (i = 0; (i < sf_peer.log_count) && passed; i++)
+    {
+        if (sf_peer.log[i] < 0)
+        {
+            announced -= sf_peer.log[i];
+            announced_total -= sf_peer.log[i];
+        }
+        else if (sf_peer.log[i] - expected != announced)
+        {
+            printf("%s: received id %lld after id %lld with %lld announced lost\n", name, (long long)sf_peer.log[i],
+                   (long long)expected - 1, (long long)announced);
+            passed = false;
+        }
+        else
+        {
+            expected = sf_peer.log[i] + 1;
+            announced = 0;
+            received++;
+        }
+    }
+
+    store_forward_get_stats(&stats);
+
+    if (passed && (expected + announced != sf_next_id))
+    {
+        printf("%s: %u submitted but only up to id %lld received or announced\n", name, sf_next_id, (long long)(expected + announced - 1));
+        passed = false;
+    }
+
+    if (stats.queued || sf_peer.damaged)
+    {
+        printf("%s: %u still queued, %d damaged\n", name, stats.queued, sf_peer.damaged);
+        passed = false;
+    }
+
+    // a message sent and then discarded while it was in flight must not count as dropped
+    if (announced_total != stats.dropped)
+    {
+        printf("%s: gap markers announced %lld lost but %u were dropped\n", name, (long long)announced_total, stats.dropped);
+        passed = false;
+    }
+
+    printf("%-12s %6lld received, %6u dropped, %4u gap markers, %5u high water, %5u spilled  %s\n", name, (long long)received,
+           stats.dropped, stats.gaps, stats.high_water, stats.spilled, passed ? "ok" : "FAILED");
+
+    return(passed);
+}
+
+/*!
+ * \brief Messages to a peer that is up are sent at once
+ *
+ * \return true if passed
+ */
+static bool sf_check_direct(void)
+{
+    STORE_FORWARD_STATS_T stats;
+    bool passed = true;
+    int i;
+
+    sf_reset();
+
+    for (i = 0; i < 1000; i++)
+    {
+        if (sf_submit() <= 0)
+        {
+            passed = false;
+        }
+    }
+
+    store_forward_get_stats(&stats);
+    if (!passed || (stats.sent_direct != 1000) || (sf_peer.log_count != 1000))
+    {
+        printf("direct: %u of 1000 sent directly, %d received\n", stats.sent_direct, sf_peer.log_count);
+        passed = false;
+    }
+
+    return(sf_check_log("direct", 0) && passed);
+}
+
+/*!
+ * \brief An outage longer than the queue, then replay at the limited rate with the peer going down again part way
+ *
+ * \return true if passed
+ */
+static bool sf_check_outage(void)
+{
+    STORE_FORWARD_STATS_T stats;
+    uint32_t replayed;
+    TickType_t tick;
+    bool passed = true;
+    int seconds = 0;
+    int i;
+
+    sf_reset();
+    sf_peer.up = false;
+
+    for (i = 0; i < SF_OUTAGE_MESSAGES; i++)
+    {
+        sf_submit();
+    }
+
+    store_forward_get_stats(&stats);
+    if (!stats.dropped || (stats.queued_bytes > STORE_FORWARD_RAM_BYTES + STORE_FORWARD_FLASH_SECTORS*FLASH_SECTOR_SIZE) ||
+        (STORE_FORWARD_FLASH_SECTORS && !stats.spilled))
+    {
+        printf("outage: %u dropped, %u bytes queued, %u spilled\n", stats.dropped, stats.queued_bytes, stats.spilled);
+        passed = false;
+    }
+
+    sf_peer.up = true;
+
+    while (stats.queued && (seconds < 10000))
+    {
+        // down again for a while part way through
+        sf_peer.up = (seconds < 20) || (seconds > 25);
+
+        replayed = stats.replayed;
+        tick = xTaskGetTickCount();
+        shim_ticks_skipped += 1000;
+        store_forward_service();
+        store_forward_service();
+        store_forward_get_stats(&stats);
+
+        // messages submitted during replay have to wait their turn
+        if ((seconds % 7 == 0) && stats.queued && sf_peer.up)
+        {
+            if (sf_submit() != 0)
+            {
+                printf("outage: message submitted during replay was sent before the queue\n");
+                passed = false;
+            }
+            store_forward_get_stats(&stats);
+        }
+
+        if ((stats.replayed - replayed > STORE_FORWARD_REPLAY_PER_SECOND) && (xTaskGetTickCount() - tick < 2000))
+        {
+            printf("outage: %u replayed in one second\n", stats.replayed - replayed);
+            passed = false;
+        }
+
+        if (!sf_peer.up && (stats.replayed != replayed))
+        {
+            printf("outage: replayed to a peer that was down\n");
+            passed = false;
+        }
+
+        seconds++;
+    }
+
+    if (seconds < (SF_OUTAGE_MESSAGES - (int)stats.dropped)/STORE_FORWARD_REPLAY_PER_SECOND)
+    {
+        printf("outage: replay took only %d seconds\n", seconds);
+        passed = false;
+    }
+
+    return(sf_check_log("outage", 0) && passed);
+}
+
+/*!
+ * \brief Submit does not wait for another task's slow direct send, which passes on what queued behind it
+ *
+ * \return true if passed
+ */
+static bool sf_check_slow_direct(void)
+{
+    pthread_t thread;
+    double start;
+    double longest = 0;
+    bool passed = true;
+    int i;
+
+    sf_reset();
+    sf_peer.delay_ms = SF_SLOW_MS;
+
+    pthread_create(&thread, NULL, sf_submit_thread, NULL);
+    sf_wait_in_send();
+
+    for (i = 0; i < 20; i++)
+    {
+        start = sf_now_ms();
+        if (sf_submit() != 0)
+        {
+            printf("slow direct: sent while another task was sending\n");
+            passed = false;
+        }
+        if (sf_now_ms() - start > longest)
+        {
+            longest = sf_now_ms() - start;
+        }
+    }
+
+    // drains the backlog itself, no service needed
+    sf_peer.delay_ms = 0;
+    pthread_join(thread, NULL);
+
+    if (longest > SF_SUBMIT_MAX_MS)
+    {
+        printf("slow direct: submit took %.1f ms while another task was sending\n", longest);
+        passed = false;
+    }
+
+    return(sf_check_log("slow direct", 0) && passed);
+}
+
+/*!
+ * \brief Submit does not wait for a slow replay, and a message discarded while it is being replayed is not repeated
+ *
+ * \return true if passed
+ */
+static bool sf_check_slow_replay(void)
+{
+    STORE_FORWARD_STATS_T stats;
+    pthread_t thread;
+    uint32_t dropped;
+    double start;
+    double longest = 0;
+    bool passed = true;
+
+    sf_reset();
+    sf_peer.up = false;
+
+    // full, the gap marker goes quickly and the oldest message is sent next, slowly
+    do
+    {
+        sf_submit();
+        store_forward_get_stats(&stats);
+    } while (!stats.dropped);
+    dropped = stats.dropped;
+
+    sf_peer.up = true;
+    sf_peer.delay_ms = SF_SLOW_MS;
+    shim_ticks_skipped += 1000;
+
+    pthread_create(&thread, NULL, sf_service_thread, NULL);
+    sf_wait_in_send();
+
+    // overflow the queue while the oldest message is being sent
+    do
+    {
+        start = sf_now_ms();
+        sf_submit();
+        if (sf_now_ms() - start > longest)
+        {
+            longest = sf_now_ms() - start;
+        }
+        store_forward_get_stats(&stats);
+    } while (stats.dropped < dropped + 10);
+
+    sf_peer.delay_ms = 0;
+    pthread_join(thread, NULL);
+
+    sf_replay(10000);
+
+    if (longest > SF_SUBMIT_MAX_MS)
+    {
+        printf("slow replay: submit took %.1f ms during replay\n", longest);
+        passed = false;
+    }
+
+    return(sf_check_log("slow replay", 0) && passed);
+}
+
+/*!
+ * \brief A direct send that fails is replayed before messages queued while it was being sent
+ *
+ * \return true if passed
+ */
+static bool sf_check_requeue(void)
+{
+    pthread_t thread;
+    int i;
+
+    sf_reset();
+    sf_peer.delay_ms = SF_SLOW_MS;
+    sf_peer.fail_after_delay = true;
+
+    pthread_create(&thread, NULL, sf_submit_thread, NULL);
+    sf_wait_in_send();
+
+    for (i = 0; i < 5; i++)
+    {
+        sf_submit();
+    }
+
+    pthread_join(thread, NULL);
+
+    sf_peer.delay_ms = 0;
+    sf_peer.fail_after_delay = false;
+    sf_replay(100);
+
+    return(sf_check_log("requeue", 0));
+}
+
+#if STORE_FORWARD_FLASH_SECTORS
+/*!
+ * \brief Spilled sectors survive a reboot and are replayed once only
+ *
+ * \return true if passed
+ */
+static bool sf_check_reboot(void)
+{
+    STORE_FORWARD_STATS_T stats;
+    uint32_t recovered;
+    bool passed = true;
+    int i;
+
+    sf_reset();
+    sf_peer.up = false;
+
+    for (i = 0; i < SF_OUTAGE_MESSAGES; i++)
+    {
+        sf_submit();
+    }
+
+    // what was still in ram is lost with the reboot, the rest follows on from the oldest sector kept
+    store_forward_init(sf_send, sf_gap);
+    store_forward_get_stats(&stats);
+    recovered = stats.queued;
+
+    sf_peer.up = true;
+    sf_replay(10000);
+
+    if (!recovered || (sf_peer.log_count != (int)recovered) || (sf_peer.log[0] < 0))
+    {
+        printf("reboot: %u recovered, %d received\n", recovered, sf_peer.log_count);
+        passed = false;
+    }
+    else
+    {
+        // the ram part is gone so the log ends short of the last id submitted
+        sf_next_id = sf_peer.log[sf_peer.log_count - 1] + 1;
+        passed &= sf_check_log("reboot", sf_peer.log[0]);
+    }
+
+    store_forward_init(sf_send, sf_gap);
+    store_forward_get_stats(&stats);
+    if (stats.queued)
+    {
+        printf("reboot: %u recovered again after being replayed\n", stats.queued);
+        passed = false;
+    }
+
+    return(passed);
+}
+#endif
+
+/*!
+ * \brief Thread submitting one message
+ *
+ * \param[in]  arg  not used
+ *
+ * \return NULL
+ */
+static void *sf_submit_thread(__unused void *arg)
+{
+    sf_submit();
+
+    return(NULL);
+}
+
+/*!
+ * \brief Thread running one store_forward_service()
+ *
+ * \param[in]  arg  not used
+ *
+ * \return NULL
+ */
+static void *sf_service_thread(__unused void *arg)
+{
+    store_forward_service();
+
+    return(NULL);
+}
+
+/*!
+ * \brief Wait until the peer is in a send
+ *
+ * \return nothing
+ */
+static void sf_wait_in_send(void)
+{
+    while (!__atomic_load_n(&sf_peer.in_send, __ATOMIC_SEQ_CST))
+    {
+        usleep(100);
+    }
+}
+
+/*!
+ * \brief Wall clock for timing submits
+ *
+ * \return milliseconds
+ */
+static double sf_now_ms(void)
+{
+    return(time_us_64()/1000.0);
+}
@@ -0,0 +1,315 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <getopt.h>
+
+#include "weather.h"
+#include "web_snapshot.h"
+
+/*
+ * Web snapshot stress test
+ *
+ * Runs producers and readers of the wind and network groups of web on host threads against web_snapshot.c and
+ * seqlock.c, with taskENTER_CRITICAL() standing in as a mutex (client/shim).  Every producer writes one counter
+ * into all the fields of a group, the network strings included, so a reader can tell a snapshot that mixes two
+ * updates from a consistent one.
+ *
+ * Each run is made twice: once with readers copying web field by field as the SSI handlers used to, to show that
+ * torn reads do happen on this host, then with web_write_begin()/web_write_end() and web_snapshot_*(), which must
+ * never return a torn copy.  The uncontended cost of a snapshot is timed as well.
+ * Exits with 1 if a snapshot is ever torn.
+ *
+ * This runs the threads on however many cores the host has and cannot stand in for the RP2040's two cores.
+ */
+
+#define WS_WRITERS              (2)             // per group
+#define WS_READERS              (4)             // per group
+#define WS_SNAPSHOTS            (10000000)      // uncontended snapshots timed
+
+typedef struct
+{
+    WEB_GROUP_T group;
+    int id;
+    long reads;
+    long torn;
+    long updates;
+} WS_THREAD_T;
+
+// prototypes
+static void ws_run(bool locked, double seconds, long *reads, long *torn, long *updates);
+static void *ws_writer(void *arg);
+static void *ws_reader(void *arg);
+static bool ws_wind_torn(const WEB_WIND_T *wind);
+static bool ws_network_torn(const WEB_NETWORK_T *network);
+static double ws_now_us(void);
+
+// the variables web_snapshot.c publishes
+WEB_VARIABLES_T web;
+
+// static variables
+static volatile bool ws_locked = false;
+static volatile bool ws_stop = false;
+
+int main(int argc, char *argv[])
+{
+    WEB_WIND_T wind;
+    double seconds = 1.0;
+    double start;
+    long reads;
+    long torn;
+    long updates;
+    int option;
+    int i;
+
+    while ((option = getopt(argc, argv, "t:h")) != -1)
+    {
+        switch(option)
+        {
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'h':
+            default:
+                fprintf(stderr, "usage: %s [-t seconds]\n", argv[0]);
+                return(option == 'h' ? 0 : 1);
+        }
+    }
+
+    ws_run(false, seconds, &reads, &torn, &updates);
+    printf("field by field: %9ld reads %9ld torn (%4.1f%%) %9ld updates\n", reads, torn, reads ? 100.0*torn/reads : 0.0, updates);
+
+    ws_run(true, seconds, &reads, &torn, &updates);
+    printf("snapshots:      %9ld reads %9ld torn (%4.1f%%) %9ld updates\n", reads, torn, reads ? 100.0*torn/reads : 0.0, updates);
+
+    start = ws_now_us();
+    for (i=0; i<WS_SNAPSHOTS; i++)
+    {
+        web_snapshot_wind(&wind);
+        __asm__ volatile("" : : "r"(&wind) : "memory");
+    }
+    printf("uncontended wind snapshot %.1f ns\n", (ws_now_us() - start)*1000/WS_SNAPSHOTS);
+
+    printf("%s\n", (torn || !reads) ? "FAILED" : "passed");
+
+    return((torn || !reads) ? 1 : 0);
+}
+
+/*!
+ * \brief Run writers and readers of both groups for a while
+ *
+ * \param[in]  locked       use the web_snapshot.c brackets and snapshots
+ * \param[in]  seconds      how long to run
+ * \param[out] reads        copies taken
+ * \param[out] torn         copies that mixed two updates
+ * \param[out] updates      updates written
+ *
+ * \return nothing
+ */
+static void ws_run(bool locked, double seconds, long *reads, long *torn, long *updates)
+{
+    WS_THREAD_T threads[2*(WS_WRITERS + WS_READERS)];
+    pthread_t handles[2*(WS_WRITERS + WS_READERS)];
+    struct timespec delay;
+    int n = 0;
+    int group;
+    int i;
+
+    memset(&web, 0, sizeof(web));
+    memset(threads, 0, sizeof(threads));
+    ws_locked = locked;
+    ws_stop = false;
+
+    for (group=0; group<2; group++)
+    {
+        for (i=0; i<WS_WRITERS + WS_READERS; i++, n++)
+        {
+            threads[n].group = group ? WEB_GROUP_NETWORK : WEB_GROUP_WIND;
+            threads[n].id = i;
+            pthread_create(&handles[n], NULL, (i < WS_WRITERS) ? ws_writer : ws_reader, &threads[n]);
+        }
+    }
+
+    delay.tv_sec = (time_t)seconds;
+    delay.tv_nsec = (long)((seconds - delay.tv_sec)*1e9);
+    nanosleep(&delay, NULL);
+    ws_stop = true;
+
+    *reads = 0;
+    *torn = 0;
+    *updates = 0;
+    for (i=0; i<n; i++)
+    {
+        pthread_join(handles[i], NULL);
+        *reads += threads[i].reads;
+        *torn += threads[i].torn;
+        *updates += threads[i].updates;
+    }
+}
+
+/*!
+ * \brief Write a counter into every field of a group, as a producer task does
+ *
+ * \param[in]  arg  WS_THREAD_T
+ *
+ * \return NULL
+ */
+static void *ws_writer(void *arg)
+{
+    WS_THREAD_T *thread = (WS_THREAD_T *)arg;
+    uint32_t count = (uint32_t)thread->id << 28;
+    char text[50];
+
+    while (!ws_stop)
+    {
+        count++;
+
+        // strings are formatted before the bracket, as producers must
+        if (thread->group == WEB_GROUP_NETWORK)
+        {
+            snprintf(text, sizeof(text), "10.%u.%u", (unsigned)(count >> 16), (unsigned)(count & 0xffff));
+        }
+
+        if (ws_locked)
+        {
+            web_write_begin(thread->group);
+        }
+
+        if (thread->group == WEB_GROUP_WIND)
+        {
+            web.anemometer_wind_speed = count;
+            web.anemometer_adc_min = count;
+            web.anemometer_adc_max = count;
+            web.anemometer_sample_time_us = count;
+        }
+        else
+        {
+            web.access_point_mode = count;
+            strcpy(web.ip_address_string, text);
+            strcpy(web.network_mask_string, text);
+            strcpy(web.gateway_string, text);
+        }
+
+        if (ws_locked)
+        {
+            web_write_end(thread->group);
+        }
+
+        thread->updates++;
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Copy a group and check that all its fields come from one update
+ *
+ * \param[in]  arg  WS_THREAD_T
+ *
+ * \return NULL
+ */
+static void *ws_reader(void *arg)
+{
+    WS_THREAD_T *thread = (WS_THREAD_T *)arg;
+    WEB_WIND_T wind;
+    WEB_NETWORK_T network;
+    bool torn;
+
+    while (!ws_stop)
+    {
+        if (thread->group == WEB_GROUP_WIND)
+        {
+            if (ws_locked)
+            {
+                web_snapshot_wind(&wind);
+            }
+            else
+            {
+                wind.wind_speed = web.anemometer_wind_speed;
+                wind.adc_min = web.anemometer_adc_min;
+                wind.adc_max = web.anemometer_adc_max;
+                wind.sample_time_us = web.anemometer_sample_time_us;
+            }
+            torn = ws_wind_torn(&wind);
+        }
+        else
+        {
+            if (ws_locked)
+            {
+                web_snapshot_network(&network);
+            }
+            else
+            {
+                network.access_point_mode = web.access_point_mode;
+                memcpy(network.ip_address_string, web.ip_address_string, sizeof(network.ip_address_string));
+                memcpy(network.network_mask_string, web.network_mask_string, sizeof(network.network_mask_string));
+                memcpy(network.gateway_string, web.gateway_string, sizeof(network.gateway_string));
+            }
+            torn = ws_network_torn(&network);
+        }
+
+        thread->reads++;
+        thread->torn += torn;
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Check a wind copy
+ *
+ * \param[in]  wind     copy
+ *
+ * \return true if its fields come from different updates
+ */
+static bool ws_wind_torn(const WEB_WIND_T *wind)
+{
+    return((wind->adc_min != wind->wind_speed) || (wind->adc_max != wind->wind_speed) ||
+           (wind->sample_time_us != (uint32_t)wind->wind_speed));
+}
+
+/*!
+ * \brief Check a network copy
+ *
+ * \param[in]  network  copy
+ *
+ * \return true if its fields come from different updates, or a string is not terminated
+ */
+static bool ws_network_torn(const WEB_NETWORK_T *network)
+{
+    char expected[50];
+    uint32_t count = network->access_point_mode;
+
+    if (!count)
+    {
+        return(network->ip_address_string[0] || network->network_mask_string[0] || network->gateway_string[0]);
+    }
+
+    snprintf(expected, sizeof(expected), "10.%u.%u", (unsigned)(count >> 16), (unsigned)(count & 0xffff));
+
+    return(strncmp(network->ip_address_string, expected, sizeof(network->ip_address_string)) ||
+           strncmp(network->network_mask_string, expected, sizeof(network->network_mask_string)) ||
+           strncmp(network->gateway_string, expected, sizeof(network->gateway_string)));
+}
+
+/*!
+ * \brief Monotonic time
+ *
+ * \return microseconds
+ */
+static double ws_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return(now.tv_sec*1e6 + now.tv_nsec/1e3);
+}
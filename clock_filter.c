@@ -0,0 +1,299 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "clock_filter.h"
+
+// NB: this file must not depend on the pico sdk or FreeRTOS so that the estimator can be exercised on a linux host
+
+#define ABS64(x) (((x) < 0)?(-(x)):(x))
+
+// prototypes
+static int64_t clock_filter_median(int64_t *value, int count);
+static bool clock_filter_is_outlier(CLOCK_FILTER_T *filter, CLOCK_SAMPLE_T *candidate);
+static void clock_filter_step(CLOCK_FILTER_T *filter, CLOCK_SAMPLE_T *sample);
+
+/*!
+ * \brief Reset the clock filter to the unsynchronised state
+ *
+ * \param[in]  filter   filter state
+ *
+ * \return nothing
+ */
+void clock_filter_init(CLOCK_FILTER_T *filter)
+{
+    memset(filter, 0, sizeof(CLOCK_FILTER_T));
+}
+
+/*!
+ * \brief Add the timestamps from one request/confirm exchange to the filter (NTP on-wire algorithm)
+ *
+ * \param[in]  filter   filter state
+ * \param[in]  t1       local clock when request was sent
+ * \param[in]  t2       reference clock when request was received
+ * \param[in]  t3       reference clock when confirm was sent
+ * \param[in]  t4       local clock when confirm was received
+ *
+ * \return CLOCK_FILTER_RESULT_T indicating what was done with the sample
+ */
+CLOCK_FILTER_RESULT_T clock_filter_add_exchange(CLOCK_FILTER_T *filter, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4)
+{
+    CLOCK_SAMPLE_T sample;
+    CLOCK_SAMPLE_T *best = NULL;
+    int64_t residual;
+    int64_t span;
+    int64_t frequency_error;
+    int64_t frequency;
+    int i;
+
+    sample.delay_us = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+    sample.offset_us = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4))/2;
+    sample.local_us = t1 + (t4 - t1)/2;
+
+    if ((sample.delay_us < 0) || (sample.delay_us > CLOCK_FILTER_MAX_DELAY_US))
+    {
+        filter->rejected++;
+        return(CLOCK_FILTER_BAD_DELAY);
+    }
+
+    if (clock_filter_is_outlier(filter, &sample))
+    {
+        filter->rejected++;
+
+        // a long run of outliers means the reference clock really has moved
+        if (++filter->consecutive_outliers < CLOCK_FILTER_SAMPLES)
+        {
+            return(CLOCK_FILTER_OUTLIER);
+        }
+
+        clock_filter_step(filter, &sample);
+        return(CLOCK_FILTER_STEPPED);
+    }
+    filter->consecutive_outliers = 0;
+
+    // store sample in window
+    filter->sample[filter->sample_index] = sample;
+    filter->sample_index = (filter->sample_index + 1) % CLOCK_FILTER_SAMPLES;
+    if (filter->sample_population < CLOCK_FILTER_SAMPLES)
+    {
+        filter->sample_population++;
+    }
+
+    if (!filter->synchronised)
+    {
+        clock_filter_step(filter, &sample);
+        return(CLOCK_FILTER_STEPPED);
+    }
+
+    // the sample with the lowest delay suffered the least queuing so has the most trustworthy offset
+    for (i = 0; i < filter->sample_population; i++)
+    {
+        if (!best || (filter->sample[i].delay_us < best->delay_us))
+        {
+            best = &(filter->sample[i]);
+        }
+    }
+
+    // never use the same sample twice and never go backwards
+    if (best->local_us <= filter->last_used.local_us)
+    {
+        return(CLOCK_FILTER_STORED);
+    }
+
+    residual = best->offset_us - clock_filter_offset_at(filter, best->local_us);
+
+    if (ABS64(residual) > CLOCK_FILTER_STEP_THRESHOLD_US)
+    {
+        clock_filter_step(filter, best);
+        return(CLOCK_FILTER_STEPPED);
+    }
+
+    // frequency locked loop -- only measure over long spans so that jitter does not dominate
+    span = (int64_t)(best->local_us - filter->last_used.local_us);
+    if (span >= CLOCK_FILTER_MIN_FREQUENCY_SPAN_US)
+    {
+        frequency_error = (residual * 1000000000LL)/span;
+        frequency = filter->frequency_ppb + frequency_error/CLOCK_FILTER_FREQUENCY_GAIN;
+        if (frequency > CLOCK_FILTER_MAX_FREQUENCY_PPB) frequency = CLOCK_FILTER_MAX_FREQUENCY_PPB;
+        if (frequency < -CLOCK_FILTER_MAX_FREQUENCY_PPB) frequency = -CLOCK_FILTER_MAX_FREQUENCY_PPB;
+        filter->frequency_ppb = (int32_t)frequency;
+    }
+
+    // phase locked loop -- rebase model at the sample removing part of the error
+    filter->base_offset_us = clock_filter_offset_at(filter, best->local_us) + residual/CLOCK_FILTER_PHASE_GAIN;
+    filter->base_local_us = best->local_us;
+    filter->last_used = *best;
+    filter->last_residual_us = residual;
+    filter->accepted++;
+
+    return(CLOCK_FILTER_ACCEPTED);
+}
+
+/*!
+ * \brief Get the offset to add to the local clock to obtain the reference clock
+ *
+ * \param[in]  filter     filter state
+ * \param[in]  local_us   local clock
+ *
+ * \return offset in microseconds, zero if not synchronised
+ */
+int64_t clock_filter_offset_at(CLOCK_FILTER_T *filter, uint64_t local_us)
+{
+    int64_t offset = 0;
+
+    if (filter->synchronised)
+    {
+        offset = filter->base_offset_us + (((int64_t)(local_us - filter->base_local_us)) * filter->frequency_ppb)/1000000000LL;
+    }
+
+    return(offset);
+}
+
+/*!
+ * \brief Follow the model without going backwards
+ *
+ * When a correction puts the model behind time already handed out, the clock keeps running at a rate reduced by
+ * CLOCK_FILTER_SLEW_PPM until the model catches up, so timestamps keep increasing rather than stopping for the size
+ * of the step.  Forward corrections are taken at once.
+ *
+ * \param[in]  clock      state of the monotonic clock
+ * \param[in]  local_us   local clock now
+ * \param[in]  model_us   reference time the model gives for local_us
+ *
+ * \return time to hand out
+ */
+uint64_t clock_filter_monotonic(CLOCK_MONOTONIC_T *clock, uint64_t local_us, uint64_t model_us)
+{
+    uint64_t elapsed;
+    uint64_t slowest_us;
+    uint64_t shared_us = model_us;
+
+    if (clock->shared_us)
+    {
+        elapsed = local_us - clock->local_us;
+        slowest_us = clock->shared_us + elapsed - (elapsed*CLOCK_FILTER_SLEW_PPM)/1000000;
+        if (model_us < slowest_us)
+        {
+            shared_us = slowest_us;
+        }
+    }
+
+    clock->local_us = local_us;
+    clock->shared_us = shared_us;
+
+    return(shared_us);
+}
+
+/*!
+ * \brief Step the model to a sample and discard the history
+ *
+ * \param[in]  filter   filter state
+ * \param[in]  sample   sample to adopt
+ *
+ * \return nothing
+ */
+static void clock_filter_step(CLOCK_FILTER_T *filter, CLOCK_SAMPLE_T *sample)
+{
+    CLOCK_SAMPLE_T adopted;
+
+    adopted = *sample;
+
+    filter->sample[0] = adopted;
+    filter->sample_index = 1 % CLOCK_FILTER_SAMPLES;
+    filter->sample_population = 1;
+    filter->base_offset_us = adopted.offset_us;
+    filter->base_local_us = adopted.local_us;
+    filter->last_used = adopted;
+    filter->last_residual_us = 0;
+    filter->consecutive_outliers = 0;
+    filter->synchronised = true;
+    filter->steps++;
+}
+
+/*!
+ * \brief Check if sample is an outlier relative to the current window
+ *
+ * \param[in]  filter      filter state
+ * \param[in]  candidate   new sample
+ *
+ * \return true if the sample should be discarded
+ */
+static bool clock_filter_is_outlier(CLOCK_FILTER_T *filter, CLOCK_SAMPLE_T *candidate)
+{
+    int64_t residual[CLOCK_FILTER_SAMPLES];
+    int64_t deviation[CLOCK_FILTER_SAMPLES];
+    int64_t median;
+    int64_t mad;
+    int64_t threshold;
+    int64_t candidate_residual;
+    int i;
+
+    if (!filter->synchronised || (filter->sample_population < CLOCK_FILTER_MIN_POPULATION))
+    {
+        return(false);
+    }
+
+    // compare residuals against the model so that frequency drift across the window is not mistaken for noise
+    for (i = 0; i < filter->sample_population; i++)
+    {
+        residual[i] = filter->sample[i].offset_us - clock_filter_offset_at(filter, filter->sample[i].local_us);
+    }
+    median = clock_filter_median(residual, filter->sample_population);
+
+    for (i = 0; i < filter->sample_population; i++)
+    {
+        deviation[i] = ABS64(residual[i] - median);
+    }
+    mad = clock_filter_median(deviation, filter->sample_population);
+
+    threshold = mad * CLOCK_FILTER_OUTLIER_MAD_MULTIPLE;
+    if (threshold < CLOCK_FILTER_OUTLIER_FLOOR_US)
+    {
+        threshold = CLOCK_FILTER_OUTLIER_FLOOR_US;
+    }
+
+    // the true offset can be anywhere within half the round trip so allow for that too
+    threshold += candidate->delay_us/2;
+
+    candidate_residual = candidate->offset_us - clock_filter_offset_at(filter, candidate->local_us);
+
+    return(ABS64(candidate_residual - median) > threshold);
+}
+
+/*!
+ * \brief Find median of a small array (array is sorted in place)
+ *
+ * \param[in]  value   array of values
+ * \param[in]  count   number of values
+ *
+ * \return median
+ */
+static int64_t clock_filter_median(int64_t *value, int count)
+{
+    int64_t key;
+    int i;
+    int j;
+
+    // insertion sort is fine for a handful of samples
+    for (i = 1; i < count; i++)
+    {
+        key = value[i];
+        for (j = i - 1; (j >= 0) && (value[j] > key); j--)
+        {
+            value[j+1] = value[j];
+        }
+        value[j+1] = key;
+    }
+
+    if (count & 1)
+    {
+        return(value[count/2]);
+    }
+
+    return((value[count/2 - 1] + value[count/2])/2);
+}
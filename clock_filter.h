@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef CLOCK_FILTER_H
+#define CLOCK_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CLOCK_FILTER_SAMPLES                (8)             // size of the sample window
+#define CLOCK_FILTER_MIN_POPULATION         (4)             // samples needed before outlier rejection starts
+#define CLOCK_FILTER_MAX_DELAY_US           (1000000)       // round trips longer than this are useless
+#define CLOCK_FILTER_STEP_THRESHOLD_US      (128000)        // step rather than slew if error exceeds this (same as ntpd)
+#define CLOCK_FILTER_OUTLIER_MAD_MULTIPLE   (3)             // reject samples more than 3 x MAD from the median
+#define CLOCK_FILTER_OUTLIER_FLOOR_US       (500)           // never reject samples closer than this to the median
+#define CLOCK_FILTER_PHASE_GAIN             (2)             // remove 1/2 of the phase error per update
+#define CLOCK_FILTER_FREQUENCY_GAIN         (4)             // remove 1/4 of the frequency error per update
+#define CLOCK_FILTER_MIN_FREQUENCY_SPAN_US  (30000000)      // minimum time between frequency measurements
+#define CLOCK_FILTER_MAX_FREQUENCY_PPB      (500000)        // crystal should never be worse than 500 ppm
+#define CLOCK_FILTER_SLEW_PPM               (50000)         // a backward correction slows the clock by at most 5%
+
+typedef enum
+{
+    CLOCK_FILTER_ACCEPTED       = 0,    // sample stored and model updated
+    CLOCK_FILTER_STORED         = 1,    // sample stored but a lower delay sample still dominates
+    CLOCK_FILTER_STEPPED        = 2,    // model was stepped to the new sample
+    CLOCK_FILTER_BAD_DELAY      = 3,    // negative or excessive round trip delay
+    CLOCK_FILTER_OUTLIER        = 4,    // offset too far from the window median
+} CLOCK_FILTER_RESULT_T;
+
+typedef struct
+{
+    uint64_t local_us;                  // local clock at the midpoint of the exchange
+    int64_t offset_us;                  // reference clock minus local clock
+    int64_t delay_us;                   // round trip delay excluding remote processing time
+} CLOCK_SAMPLE_T;
+
+typedef struct
+{
+    CLOCK_SAMPLE_T sample[CLOCK_FILTER_SAMPLES];
+    int sample_index;
+    int sample_population;
+    bool synchronised;
+    uint64_t base_local_us;             // local time at which base_offset_us applies
+    int64_t base_offset_us;             // offset to add to local clock at base_local_us
+    int32_t frequency_ppb;              // rate at which offset grows, parts per billion
+    CLOCK_SAMPLE_T last_used;           // sample most recently used to update the model
+    int64_t last_residual_us;           // error of the model when last updated
+    int consecutive_outliers;           // a persistent run of outliers means the reference really moved
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t steps;
+} CLOCK_FILTER_T;
+
+// time handed out by a clock that must never go backwards
+typedef struct
+{
+    uint64_t local_us;                  // local clock when last read
+    uint64_t shared_us;                 // time returned then, 0 before the first read
+} CLOCK_MONOTONIC_T;
+
+void clock_filter_init(CLOCK_FILTER_T *filter);
+CLOCK_FILTER_RESULT_T clock_filter_add_exchange(CLOCK_FILTER_T *filter, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+int64_t clock_filter_offset_at(CLOCK_FILTER_T *filter, uint64_t local_us);
+uint64_t clock_filter_monotonic(CLOCK_MONOTONIC_T *clock, uint64_t local_us, uint64_t model_us);
+
+#endif
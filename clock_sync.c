@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "config.h"
+#include "pluto.h"
+#include "clock_filter.h"
+#include "clock_sync.h"
+
+/*
+ * Shared microsecond timebase
+ *
+ * Every node keeps a model of the offset between its free running time_us_64() counter and microseconds since the
+ * unix epoch.  The master (any node without a clock sync master configured) disciplines the model from SNTP.  Other
+ * nodes discipline it from TIME_SYNC request/confirm exchanges with the master (see message.c) so that sample
+ * timestamps taken on different nodes can be compared directly.
+ */
+
+// external variables
+extern NON_VOL_VARIABLES_T config;
+
+// static variables
+static CLOCK_FILTER_T clock_filter;
+static CLOCK_MONOTONIC_T shared_clock;
+
+/*!
+ * \brief Reset the shared timebase to unsynchronised
+ *
+ * \return nothing
+ */
+void clock_sync_init(void)
+{
+    taskENTER_CRITICAL();
+    clock_filter_init(&clock_filter);
+    taskEXIT_CRITICAL();
+}
+
+/*!
+ * \brief Check if this node is the clock master
+ *
+ * \return true if timebase is disciplined by SNTP, false if disciplined by a master node
+ */
+bool clock_sync_is_master(void)
+{
+    return(!(config.clock_sync_enable && config.clock_sync_master_ip[0]));
+}
+
+/*!
+ * \brief Check if the shared timebase has been set
+ *
+ * \return true if synchronised
+ */
+bool clock_sync_synchronised(void)
+{
+    return(clock_filter.synchronised);
+}
+
+/*!
+ * \brief Get current time in the shared timebase -- never goes backwards
+ *
+ * \return microseconds since unix epoch (or since boot if not yet synchronised)
+ */
+uint64_t clock_sync_get_time_us(void)
+{
+    uint64_t local_us;
+    uint64_t shared_us;
+
+    taskENTER_CRITICAL();
+    local_us = time_us_64();
+
+    // slew rather than let a correction take the clock backwards
+    shared_us = clock_filter_monotonic(&shared_clock, local_us, local_us + clock_filter_offset_at(&clock_filter, local_us));
+    taskEXIT_CRITICAL();
+
+    return(shared_us);
+}
+
+/*!
+ * \brief Get the time a recent time_us_64() value was on the shared clock returned by clock_sync_get_time_us()
+ *
+ * \param[in]  local_us   value read from time_us_64() shortly before
+ *
+ * \return microseconds since unix epoch (or since boot if not yet synchronised)
+ */
+uint64_t clock_sync_get_time_at_us(uint64_t local_us)
+{
+    uint64_t now_us;
+    uint64_t shared_us;
+
+    taskENTER_CRITICAL();
+    now_us = time_us_64();
+    shared_us = clock_filter_monotonic(&shared_clock, now_us, now_us + clock_filter_offset_at(&clock_filter, now_us));
+    taskEXIT_CRITICAL();
+
+    // the slew rate is too small to matter over the time since local_us
+    return(shared_us - (now_us - local_us));
+}
+
+/*!
+ * \brief Discipline the timebase from SNTP -- ignored unless this node is the master
+ *
+ * \param[in]  sec  seconds since unix epoch
+ * \param[in]  us   microseconds part
+ *
+ * \return nothing
+ */
+void clock_sync_reference_update(uint32_t sec, uint32_t us)
+{
+    uint64_t local_us;
+    uint64_t reference_us;
+
+    if (clock_sync_is_master())
+    {
+        reference_us = ((uint64_t)sec)*1000000ULL + us;
+
+        // treat as an exchange with zero round trip -- sntp has already removed the network delay
+        taskENTER_CRITICAL();
+        local_us = time_us_64();
+        clock_filter_add_exchange(&clock_filter, local_us, reference_us, reference_us, local_us);
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*!
+ * \brief Discipline the timebase from an exchange with the master node -- ignored if this node is the master
+ *
+ * \param[in]  t1       local time_us_64() when request was sent
+ * \param[in]  t2       master shared time when request was received
+ * \param[in]  t3       master shared time when confirm was sent
+ * \param[in]  t4       local time_us_64() when confirm was received
+ *
+ * \return CLOCK_FILTER_RESULT_T or -1 if this node is the master
+ */
+int clock_sync_add_exchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4)
+{
+    int result = -1;
+
+    if (!clock_sync_is_master())
+    {
+        taskENTER_CRITICAL();
+        result = clock_filter_add_exchange(&clock_filter, t1, t2, t3, t4);
+        taskEXIT_CRITICAL();
+
+        if (result == CLOCK_FILTER_STEPPED)
+        {
+            printf("Clock sync stepped to master, offset = %lld us\n", clock_filter.base_offset_us);
+        }
+    }
+
+    return(result);
+}
+
+/*!
+ * \brief Get interval between requests to the master node
+ *
+ * \return milliseconds
+ */
+int clock_sync_poll_interval(void)
+{
+    int interval = CLOCK_SYNC_POLL_SLOW_MS;
+
+    // poll fast while outliers suggest the master has moved, so the step is taken and slewed out sooner
+    if (!clock_filter.synchronised || (clock_filter.sample_population < CLOCK_FILTER_MIN_POPULATION) ||
+        clock_filter.consecutive_outliers)
+    {
+        interval = CLOCK_SYNC_POLL_FAST_MS;
+    }
+
+    return(interval);
+}
+
+/*!
+ * \brief Print human readable synchronisation status for web interface
+ *
+ * \param[out]  buffer  destination
+ * \param[in]   len     size of destination
+ *
+ * \return number of characters printed
+ */
+int clock_sync_status_string(char *buffer, int len)
+{
+    int printed = 0;
+    CLOCK_FILTER_T snapshot;
+
+    taskENTER_CRITICAL();
+    snapshot = clock_filter;
+    taskEXIT_CRITICAL();
+
+    if (!snapshot.synchronised)
+    {
+        printed = snprintf(buffer, len, "Unsynchronised");
+    }
+    else
+    {
+        printed = snprintf(buffer, len, "%s, error %lld us, delay %lld us, drift %c%d.%03d ppm, rejected %lu",
+                           clock_sync_is_master()?"SNTP":"Master",
+                           snapshot.last_residual_us,
+                           snapshot.last_used.delay_us,
+                           snapshot.frequency_ppb<0?'-':'+',
+                           abs(snapshot.frequency_ppb)/1000,
+                           abs(snapshot.frequency_ppb)%1000,
+                           snapshot.rejected);
+    }
+
+    return(printed);
+}
@@ -0,0 +1,22 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#define CLOCK_SYNC_POLL_FAST_MS     (4000)      // poll interval while acquiring lock
+#define CLOCK_SYNC_POLL_SLOW_MS     (16000)     // poll interval once locked
+
+void clock_sync_init(void);
+bool clock_sync_is_master(void);
+bool clock_sync_synchronised(void);
+uint64_t clock_sync_get_time_us(void);
+uint64_t clock_sync_get_time_at_us(uint64_t local_us);
+void clock_sync_reference_update(uint32_t sec, uint32_t us);
+int clock_sync_add_exchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+int clock_sync_poll_interval(void);
+int clock_sync_status_string(char *buffer, int len);
+
+#endif
@@ -20,6 +20,7 @@
 #include "utility.h"
 
 #include "flash.h"
+#include "seqlock.h"
 
 #define FLASH_TARGET_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
 //#define DISABLE_CONFIG_VALIDATION (1)
@@ -37,9 +38,13 @@ void config_v8_to_v9(void);
 void config_v9_to_v10(void);
 void config_v10_to_v11(void);
 void config_v11_to_v12(void);
+void config_v12_to_v13(void);
+void config_v13_to_v14(void);
+void config_v14_to_v15(void);
 
 NON_VOL_VARIABLES_T config;
 static int config_dirty_flag = 0;
+static SEQLOCK_T config_lock;           // odd while a cgi handler is changing config
 static NON_VOL_CONVERSION_T config_info[] =
 {
     {1,      offsetof(NON_VOL_VARIABLES_T_VERSION_1, version),   offsetof(NON_VOL_VARIABLES_T_VERSION_1, crc),   &config_blank_to_v1},
@@ -53,7 +58,10 @@ static NON_VOL_CONVERSION_T config_info[] =
     {9,      offsetof(NON_VOL_VARIABLES_T_VERSION_9, version),   offsetof(NON_VOL_VARIABLES_T_VERSION_9, crc),   &config_v8_to_v9},    
     {10,     offsetof(NON_VOL_VARIABLES_T_VERSION_10, version),  offsetof(NON_VOL_VARIABLES_T_VERSION_10, crc),  &config_v9_to_v10},   
     {11,     offsetof(NON_VOL_VARIABLES_T_VERSION_11, version),  offsetof(NON_VOL_VARIABLES_T_VERSION_11, crc),  &config_v10_to_v11}, 
-    {12,     offsetof(NON_VOL_VARIABLES_T, version),             offsetof(NON_VOL_VARIABLES_T, crc),             &config_v11_to_v12},                             
+    {12,     offsetof(NON_VOL_VARIABLES_T_VERSION_12, version),  offsetof(NON_VOL_VARIABLES_T_VERSION_12, crc),  &config_v11_to_v12},
+    {13,     offsetof(NON_VOL_VARIABLES_T_VERSION_13, version),  offsetof(NON_VOL_VARIABLES_T_VERSION_13, crc),  &config_v12_to_v13},
+    {14,     offsetof(NON_VOL_VARIABLES_T_VERSION_14, version),  offsetof(NON_VOL_VARIABLES_T_VERSION_14, crc),  &config_v13_to_v14},
+    {15,     offsetof(NON_VOL_VARIABLES_T, version),             offsetof(NON_VOL_VARIABLES_T, crc),             &config_v14_to_v15},
 };
 
 
@@ -406,6 +414,60 @@ void config_v11_to_v12(void)
     config.anemometer_remote_ip[0] = 0;
 }
 
+ /*!
+ * \brief Convert configuration from v12 to v13 and set default values for new parameters
+ * 
+ * \return 0 on success, -1 on error
+ */
+void config_v12_to_v13(void)
+{
+    int i;
+
+    printf("Converting configuration from version 12 to version 13\n"); 
+    config.version = 13;     
+
+    config.clock_sync_enable = 0;
+    config.clock_sync_master_ip[0] = 0;
+}
+ 
+ /*!
+ * \brief Convert configuration from v13 to v14 and set default values for new parameters
+ * 
+ * \return 0 on success, -1 on error
+ */
+void config_v13_to_v14(void)
+{
+    int i;
+
+    printf("Converting configuration from version 13 to version 14\n"); 
+    config.version = 14;     
+
+    for(i=0; i<NUM_ROWS(config.shelly_device_ip); i++)
+    {
+        config.shelly_device_ip[i] = 0;
+        config.shelly_device_type[i] = 0;
+    }
+}
+
+ /*!
+ * \brief Convert configuration from v14 to v15 and set default values for new parameters
+ * 
+ * \return 0 on success, -1 on error
+ */
+void config_v14_to_v15(void)
+{
+    int i;
+
+    printf("Converting configuration from version 14 to version 15\n"); 
+    config.version = 15;     
+
+    // the rules take over the space of the obsolete setpoint names
+    for(i=0; i<NUM_ROWS(config.hc_rules); i++)
+    {
+        config.hc_rules[i] = 0;
+    }
+}
+
 // ************************************************************************************************************************
 // ************************************************************************************************************************
 
@@ -441,6 +503,58 @@ bool config_dirty(bool clear_flag)
     return (dirty);
 }
 
+/*!
+ * \brief Start changing config on the tcpip thread, e.g. in a cgi handler
+ *
+ * \return nothing
+ */
+void config_change_begin(void)
+{
+    seqlock_write_begin(&config_lock);
+}
+
+/*!
+ * \brief Finish changing config
+ *
+ * \return nothing
+ */
+void config_change_end(void)
+{
+    seqlock_write_end(&config_lock);
+}
+
+/*!
+ * \brief Start reading config on a task other than the tcpip thread, waiting for any change in progress to finish
+ *
+ * \return sequence to pass to config_read_retry()
+ */
+uint32_t config_read_begin(void)
+{
+    uint32_t start;
+
+    // a cgi handler is not a critical section and may run for a while, so sleep rather than spin
+    while ((start = config_lock.sequence) & 1)
+    {
+        vTaskDelay(1);
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return(start);
+}
+
+/*!
+ * \brief Check whether config read since config_read_begin() may have been changed part way through
+ *
+ * \param[in]    start  value returned by config_read_begin()
+ *
+ * \return true if config must be read again
+ */
+bool config_read_retry(uint32_t start)
+{
+    return(seqlock_read_retry(&config_lock, start));
+}
+
 /*!
  * \brief Copy the configuation from flash into RAM.  Set default values if flash is corrupt.
  * 
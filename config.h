@@ -15,6 +15,12 @@ int config_timeserver_failsafe(void);
 int config_read(void);
 int config_write(void);
 
+// cgi handlers change config inside this bracket, tasks that render it read inside config_read_begin()/retry()
+void config_change_begin(void);
+void config_change_end(void);
+uint32_t config_read_begin(void);
+bool config_read_retry(uint32_t start);
+
 // device personality
 typedef enum
 {
@@ -135,7 +141,7 @@ typedef struct
     int thermostat_mode;   
     int max_cycles_per_hour;
     int setpoint_number;
-    char setpoint_name[16][32];     // obsolete
+    uint8_t hc_rules[512];          // compiled home controller rules, HC_RULES_CODE_SIZE, reuses the obsolete setpoint names
     int setpoint_temperaturex10[32];  
     int thermostat_hysteresis; 
     int setpoint_start_mow[32];  
@@ -164,6 +170,10 @@ typedef struct
     int setpoint_cooling_temperaturex10[32];    
     int anemometer_remote_enable;
     char anemometer_remote_ip[32];     
+    int clock_sync_enable;
+    char clock_sync_master_ip[32];
+    uint32_t shelly_device_ip[32];
+    uint8_t shelly_device_type[32];
     uint16_t crc;
 } NON_VOL_VARIABLES_T;
 
@@ -1123,4 +1133,331 @@ typedef struct
     uint16_t crc;
 } NON_VOL_VARIABLES_T_VERSION_11;
 
+typedef struct
+{
+    int version;
+    PERSONALITY_E personality;
+    char wifi_ssid[32];
+    char wifi_password[32];
+    char wifi_country[32];
+    char dhcp_enable;
+    char ip_address[32];
+    char network_mask[32];    
+    char gateway[32];      
+    char irrigation_enable;
+    char day_schedule_enable[7];
+    int day_start[7];
+    int day_duration[7];
+    int day_start_alternate[7];
+    int day_duration_alternate[7];    
+    char schedule_opportunity_start[32];
+    char schedule_opportunity_duration[32];
+    int timezone_offset;
+    char daylightsaving_enable;
+    char daylightsaving_start[32];
+    char daylightsaving_end[32];
+    char time_server[4][32];
+    int weather_station_enable;
+    char weather_station_ip[32];
+    int wind_threshold;
+    int rain_week_threshold;
+    int rain_day_threshold;
+    int relay_normally_open;
+    int gpio_number;
+    int led_pattern;
+    int led_speed;
+    int led_number;
+    int led_pin;
+    int led_rgbw;
+    int use_led_strip_to_indicate_irrigation_status;
+    int led_pattern_when_irrigation_active;
+    int led_pattern_when_irrigation_terminated;
+    int led_sustain_duration; 
+    int led_strip_remote_enable;  
+    char led_strip_remote_ip[6][32];  
+    char govee_light_ip[32]; 
+    int use_govee_to_indicate_irrigation_status;
+    int govee_irrigation_active_red;
+    int govee_irrigation_active_green; 
+    int govee_irrigation_active_blue;    
+    int govee_irrigation_usurped_red;
+    int govee_irrigation_usurped_green;
+    int govee_irrigation_usurped_blue;
+    int govee_sustain_duration;
+    int syslog_enable;
+    char syslog_server_ip[32];    
+    int use_archaic_units; 
+    int use_simplified_english;
+    int use_monday_as_week_start; 
+    int soil_moisture_threshold[16];
+    int zone_max;
+    int zone_gpio[16];
+    char zone_name[16][32];
+    char zone_enable[16];    
+    int zone_duration[16][7];
+    GPIO_DEFAULT_T gpio_default[29];
+    int thermostat_enable;
+    int heating_gpio;
+    int cooling_gpio;
+    int fan_gpio;
+    int heating_to_cooling_lockout_mins;
+    int minimum_heating_on_mins;
+    int minimum_cooling_on_mins;
+    int minimum_heating_off_mins;
+    int minimum_cooling_off_mins;
+    int thermostat_mode;   
+    int max_cycles_per_hour;
+    int setpoint_number;
+    char setpoint_name[16][32];     // obsolete
+    int setpoint_temperaturex10[32];  
+    int thermostat_hysteresis; 
+    int setpoint_start_mow[32];  
+    int setpoint_mode[32];  
+    char powerwall_ip[32];
+    char powerwall_hostname[32];  
+    char powerwall_password[32];
+    int grid_down_heating_setpoint_decrease;
+    int grid_down_cooling_setpoint_increase;
+    int grid_down_heating_disable_battery_level;
+    int grid_down_heating_enable_battery_level;
+    int grid_down_cooling_disable_battery_level;
+    int grid_down_cooling_enable_battery_level;    
+    char temperature_sensor_remote_ip[6][32]; 
+    int thermostat_mode_button_gpio;
+    int thermostat_increase_button_gpio;
+    int thermostat_decrease_button_gpio;
+    int thermostat_temperature_sensor_clock_gpio;
+    int thermostat_temperature_sensor_data_gpio;
+    int thermostat_seven_segment_display_clock_gpio;
+    int thermostat_seven_segment_display_data_gpio; 
+    int outside_temperature_threshold;
+    int thermostat_display_brightness;
+    int thermostat_display_num_digits;
+    int setpoint_heating_temperaturex10[32]; 
+    int setpoint_cooling_temperaturex10[32];    
+    int anemometer_remote_enable;
+    char anemometer_remote_ip[32];     
+    uint16_t crc;
+} NON_VOL_VARIABLES_T_VERSION_12;
+
+typedef struct
+{
+    int version;
+    PERSONALITY_E personality;
+    char wifi_ssid[32];
+    char wifi_password[32];
+    char wifi_country[32];
+    char dhcp_enable;
+    char ip_address[32];
+    char network_mask[32];    
+    char gateway[32];      
+    char irrigation_enable;
+    char day_schedule_enable[7];
+    int day_start[7];
+    int day_duration[7];
+    int day_start_alternate[7];
+    int day_duration_alternate[7];    
+    char schedule_opportunity_start[32];
+    char schedule_opportunity_duration[32];
+    int timezone_offset;
+    char daylightsaving_enable;
+    char daylightsaving_start[32];
+    char daylightsaving_end[32];
+    char time_server[4][32];
+    int weather_station_enable;
+    char weather_station_ip[32];
+    int wind_threshold;
+    int rain_week_threshold;
+    int rain_day_threshold;
+    int relay_normally_open;
+    int gpio_number;
+    int led_pattern;
+    int led_speed;
+    int led_number;
+    int led_pin;
+    int led_rgbw;
+    int use_led_strip_to_indicate_irrigation_status;
+    int led_pattern_when_irrigation_active;
+    int led_pattern_when_irrigation_terminated;
+    int led_sustain_duration; 
+    int led_strip_remote_enable;  
+    char led_strip_remote_ip[6][32];  
+    char govee_light_ip[32]; 
+    int use_govee_to_indicate_irrigation_status;
+    int govee_irrigation_active_red;
+    int govee_irrigation_active_green; 
+    int govee_irrigation_active_blue;    
+    int govee_irrigation_usurped_red;
+    int govee_irrigation_usurped_green;
+    int govee_irrigation_usurped_blue;
+    int govee_sustain_duration;
+    int syslog_enable;
+    char syslog_server_ip[32];    
+    int use_archaic_units; 
+    int use_simplified_english;
+    int use_monday_as_week_start; 
+    int soil_moisture_threshold[16];
+    int zone_max;
+    int zone_gpio[16];
+    char zone_name[16][32];
+    char zone_enable[16];    
+    int zone_duration[16][7];
+    GPIO_DEFAULT_T gpio_default[29];
+    int thermostat_enable;
+    int heating_gpio;
+    int cooling_gpio;
+    int fan_gpio;
+    int heating_to_cooling_lockout_mins;
+    int minimum_heating_on_mins;
+    int minimum_cooling_on_mins;
+    int minimum_heating_off_mins;
+    int minimum_cooling_off_mins;
+    int thermostat_mode;   
+    int max_cycles_per_hour;
+    int setpoint_number;
+    char setpoint_name[16][32];     // obsolete
+    int setpoint_temperaturex10[32];  
+    int thermostat_hysteresis; 
+    int setpoint_start_mow[32];  
+    int setpoint_mode[32];  
+    char powerwall_ip[32];
+    char powerwall_hostname[32];  
+    char powerwall_password[32];
+    int grid_down_heating_setpoint_decrease;
+    int grid_down_cooling_setpoint_increase;
+    int grid_down_heating_disable_battery_level;
+    int grid_down_heating_enable_battery_level;
+    int grid_down_cooling_disable_battery_level;
+    int grid_down_cooling_enable_battery_level;    
+    char temperature_sensor_remote_ip[6][32]; 
+    int thermostat_mode_button_gpio;
+    int thermostat_increase_button_gpio;
+    int thermostat_decrease_button_gpio;
+    int thermostat_temperature_sensor_clock_gpio;
+    int thermostat_temperature_sensor_data_gpio;
+    int thermostat_seven_segment_display_clock_gpio;
+    int thermostat_seven_segment_display_data_gpio; 
+    int outside_temperature_threshold;
+    int thermostat_display_brightness;
+    int thermostat_display_num_digits;
+    int setpoint_heating_temperaturex10[32]; 
+    int setpoint_cooling_temperaturex10[32];    
+    int anemometer_remote_enable;
+    char anemometer_remote_ip[32];     
+    int clock_sync_enable;
+    char clock_sync_master_ip[32];
+    uint16_t crc;
+} NON_VOL_VARIABLES_T_VERSION_13;
+
+typedef struct
+{
+    int version;
+    PERSONALITY_E personality;
+    char wifi_ssid[32];
+    char wifi_password[32];
+    char wifi_country[32];
+    char dhcp_enable;
+    char ip_address[32];
+    char network_mask[32];    
+    char gateway[32];      
+    char irrigation_enable;
+    char day_schedule_enable[7];
+    int day_start[7];
+    int day_duration[7];
+    int day_start_alternate[7];
+    int day_duration_alternate[7];    
+    char schedule_opportunity_start[32];
+    char schedule_opportunity_duration[32];
+    int timezone_offset;
+    char daylightsaving_enable;
+    char daylightsaving_start[32];
+    char daylightsaving_end[32];
+    char time_server[4][32];
+    int weather_station_enable;
+    char weather_station_ip[32];
+    int wind_threshold;
+    int rain_week_threshold;
+    int rain_day_threshold;
+    int relay_normally_open;
+    int gpio_number;
+    int led_pattern;
+    int led_speed;
+    int led_number;
+    int led_pin;
+    int led_rgbw;
+    int use_led_strip_to_indicate_irrigation_status;
+    int led_pattern_when_irrigation_active;
+    int led_pattern_when_irrigation_terminated;
+    int led_sustain_duration; 
+    int led_strip_remote_enable;  
+    char led_strip_remote_ip[6][32];  
+    char govee_light_ip[32]; 
+    int use_govee_to_indicate_irrigation_status;
+    int govee_irrigation_active_red;
+    int govee_irrigation_active_green; 
+    int govee_irrigation_active_blue;    
+    int govee_irrigation_usurped_red;
+    int govee_irrigation_usurped_green;
+    int govee_irrigation_usurped_blue;
+    int govee_sustain_duration;
+    int syslog_enable;
+    char syslog_server_ip[32];    
+    int use_archaic_units; 
+    int use_simplified_english;
+    int use_monday_as_week_start; 
+    int soil_moisture_threshold[16];
+    int zone_max;
+    int zone_gpio[16];
+    char zone_name[16][32];
+    char zone_enable[16];    
+    int zone_duration[16][7];
+    GPIO_DEFAULT_T gpio_default[29];
+    int thermostat_enable;
+    int heating_gpio;
+    int cooling_gpio;
+    int fan_gpio;
+    int heating_to_cooling_lockout_mins;
+    int minimum_heating_on_mins;
+    int minimum_cooling_on_mins;
+    int minimum_heating_off_mins;
+    int minimum_cooling_off_mins;
+    int thermostat_mode;   
+    int max_cycles_per_hour;
+    int setpoint_number;
+    char setpoint_name[16][32];     // obsolete
+    int setpoint_temperaturex10[32];  
+    int thermostat_hysteresis; 
+    int setpoint_start_mow[32];  
+    int setpoint_mode[32];  
+    char powerwall_ip[32];
+    char powerwall_hostname[32];  
+    char powerwall_password[32];
+    int grid_down_heating_setpoint_decrease;
+    int grid_down_cooling_setpoint_increase;
+    int grid_down_heating_disable_battery_level;
+    int grid_down_heating_enable_battery_level;
+    int grid_down_cooling_disable_battery_level;
+    int grid_down_cooling_enable_battery_level;    
+    char temperature_sensor_remote_ip[6][32]; 
+    int thermostat_mode_button_gpio;
+    int thermostat_increase_button_gpio;
+    int thermostat_decrease_button_gpio;
+    int thermostat_temperature_sensor_clock_gpio;
+    int thermostat_temperature_sensor_data_gpio;
+    int thermostat_seven_segment_display_clock_gpio;
+    int thermostat_seven_segment_display_data_gpio; 
+    int outside_temperature_threshold;
+    int thermostat_display_brightness;
+    int thermostat_display_num_digits;
+    int setpoint_heating_temperaturex10[32]; 
+    int setpoint_cooling_temperaturex10[32];    
+    int anemometer_remote_enable;
+    char anemometer_remote_ip[32];     
+    int clock_sync_enable;
+    char clock_sync_master_ip[32];
+    uint32_t shelly_device_ip[32];
+    uint8_t shelly_device_type[32];
+    uint16_t crc;
+} NON_VOL_VARIABLES_T_VERSION_14;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,563 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/mem.h"
+#include "lwip/tcpip.h"
+#include "lwip/apps/fs.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "config.h"
+#include "thermostat.h"
+#include "custom_files.h"
+#include "api.h"
+#include "events.h"
+#include "ssi_render.h"
+
+/*
+ * Generated responses for httpd (LWIP_HTTPD_CUSTOM_FILES)
+ *
+ * httpd asks fs_open_custom() for every uri before looking in htmldata.c.  A custom file computes its total length
+ * up front so that a Content-Length header can be sent, then httpd pulls the body through fs_read_async_custom() in
+ * pieces no larger than the free space in the tcp send buffer (LWIP_HTTPD_DYNAMIC_FILE_READ), so the response is
+ * never held in memory as a whole.
+ *
+ * A stream (window != 0) has no length and stays open until the client goes away.  httpd asks fs_canread_custom()
+ * before each read; while the stream has nothing to send httpd parks the connection and leaves a continuation in
+ * fs_wait_read_custom().  Producers call custom_files_notify() from any task to have the parked streams resumed on
+ * the tcpip thread (LWIP_HTTPD_FS_ASYNC_READ).  httpd also retries every HTTPD_POLL_INTERVAL so a lost notification
+ * only delays a stream.  A stream that has a natural end (e.g. an ssi page rendered by ssi_render.c) returns
+ * CUSTOM_FILE_EOF from read() once everything has been sent and httpd closes the connection.
+ */
+
+typedef struct CUSTOM_FILE_HANDLE
+{
+    const CUSTOM_FILE_T *file;
+    void *state;
+    struct CUSTOM_FILE_HANDLE *next;    // next open stream
+    fs_wait_cb wake;                    // httpd continuation while a stream is parked
+    void *wake_arg;
+} CUSTOM_FILE_HANDLE_T;
+
+#ifdef INCORPORATE_THERMOSTAT
+// temperature history as {"base":<unix time>,"points":[[<seconds after base>,<temperature x 10>],...]}
+typedef struct
+{
+    int count;
+    int next;                   // next item to format: header, prefix, one per sample, then trailer
+    int pending_length;         // formatted bytes of the current item
+    int pending_offset;         // bytes of the current item already sent
+    uint32_t base;
+    char pending[CUSTOM_FILE_HEADER_MAX];
+    uint32_t unix_time[SIZE_CLIMATE_HISTORY];
+    int16_t temperaturex10[SIZE_CLIMATE_HISTORY];
+} HISTORY_STREAM_T;
+
+#define HISTORY_ITEM_HEADER     (0)
+#define HISTORY_ITEM_PREFIX     (1)
+#define HISTORY_ITEM_SAMPLE     (2)
+#endif
+
+// prototypes
+static bool custom_file_match(const char *pattern, const char *name);
+static void custom_files_wake(__unused void *arg);
+#ifdef INCORPORATE_THERMOSTAT
+static void *history_open(const char *name, int *length);
+static int history_read(void *state, char *buffer, int count);
+static void history_close(void *state);
+static int history_format(HISTORY_STREAM_T *history, int item, int content_length);
+static int decimal_length(long value);
+#endif
+
+// open streams, only touched on the tcpip thread
+static CUSTOM_FILE_HANDLE_T *open_streams = NULL;
+
+// a wake up is queued on the tcpip thread
+static volatile bool notify_pending = false;
+
+// custom files, searched in order
+static const CUSTOM_FILE_T custom_files[] =
+{
+    {"/api/v1/wind", api_wind_open, api_read, api_close, NULL, 0},
+    {"/api/v1/weather", api_weather_open, api_read, api_close, NULL, 0},
+    {"/api/v1/status", api_status_open, api_read, api_close, NULL, 0},
+    {"/events", events_open, events_read, events_close, events_ready, EVENTS_WINDOW},
+#ifdef INCORPORATE_HOME_CONTROLLER
+    {"/api/v1/rules", api_rules_open, api_read, api_close, NULL, 0},
+#endif
+#ifdef INCORPORATE_THERMOSTAT
+    {"/api/v1/thermostat", api_thermostat_open, api_read, api_close, NULL, 0},
+    {"/history", history_open, history_read, history_close, NULL, 0},
+#endif
+    {"*.shtml", ssi_render_open, ssi_render_read, ssi_render_close, ssi_render_ready, SSI_RENDER_WINDOW},
+    {NULL, NULL, NULL, NULL, NULL, 0}
+};
+
+/*!
+ * \brief Open a generated file, called by httpd before searching htmldata.c
+ *
+ * \param[out]  file      httpd file handle to populate
+ * \param[in]   name      requested uri
+ *
+ * \return 1 if the uri is a custom file, 0 otherwise
+ */
+int fs_open_custom(struct fs_file *file, const char *name)
+{
+    const CUSTOM_FILE_T *custom;
+    CUSTOM_FILE_HANDLE_T *handle;
+    void *state;
+    int length = 0;
+
+    for (custom = custom_files; custom->name; custom++)
+    {
+        if (custom_file_match(custom->name, name))
+        {
+            break;
+        }
+    }
+
+    if (!custom->name)
+    {
+        return(0);
+    }
+
+    // a custom file may decline, e.g. ssi_render.c when it opens the page in htmldata.c itself
+    state = custom->open(name, &length);
+    if (!state)
+    {
+        return(0);
+    }
+
+    handle = (CUSTOM_FILE_HANDLE_T *)mem_malloc(sizeof(CUSTOM_FILE_HANDLE_T));
+    if (!handle)
+    {
+        custom->close(state);
+        return(0);
+    }
+
+    handle->file = custom;
+    handle->next = NULL;
+    handle->wake = NULL;
+    handle->wake_arg = NULL;
+    handle->state = state;
+
+    memset(file, 0, sizeof(struct fs_file));
+    file->data = NULL;
+    file->len = length;
+    file->index = 0;
+    file->pextension = handle;
+    file->flags = FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT;
+
+    if (custom->window)
+    {
+        // no Content-Length so the connection cannot be kept alive for another request
+        file->len = custom->window;
+        file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+
+        handle->next = open_streams;
+        open_streams = handle;
+    }
+
+    return(1);
+}
+
+/*!
+ * \brief Check whether a file can be read without waiting, called by httpd before every read
+ *
+ * \param[in]   file      httpd file handle, possibly not a custom file
+ *
+ * \return 1 if a read will return data, 0 if httpd should wait
+ */
+u8_t fs_canread_custom(struct fs_file *file)
+{
+    CUSTOM_FILE_HANDLE_T *handle = file->is_custom_file ? (CUSTOM_FILE_HANDLE_T *)file->pextension : NULL;
+
+    if (handle && handle->file->ready)
+    {
+        return(handle->file->ready(handle->state) ? 1 : 0);
+    }
+
+    return(1);
+}
+
+/*!
+ * \brief Park a stream until it has something to send
+ *
+ * \param[in]   file          httpd file handle
+ * \param[in]   callback_fn   httpd continuation
+ * \param[in]   callback_arg  httpd connection
+ *
+ * \return 1 if the continuation will be called, 0 otherwise
+ */
+u8_t fs_wait_read_custom(struct fs_file *file, fs_wait_cb callback_fn, void *callback_arg)
+{
+    CUSTOM_FILE_HANDLE_T *handle = file->is_custom_file ? (CUSTOM_FILE_HANDLE_T *)file->pextension : NULL;
+
+    if (!handle || !handle->file->window)
+    {
+        return(0);
+    }
+
+    handle->wake = callback_fn;
+    handle->wake_arg = callback_arg;
+
+    return(1);
+}
+
+/*!
+ * \brief Read the next part of a generated file
+ *
+ * \param[in]   file          httpd file handle
+ * \param[out]  buffer        destination, typically sized to the free tcp send buffer
+ * \param[in]   count         size of buffer
+ * \param[in]   callback_fn   httpd continuation if a stream has nothing to send
+ * \param[in]   callback_arg  httpd connection
+ *
+ * \return bytes read, FS_READ_DELAYED or FS_READ_EOF
+ */
+int fs_read_async_custom(struct fs_file *file, char *buffer, int count, fs_wait_cb callback_fn, void *callback_arg)
+{
+    CUSTOM_FILE_HANDLE_T *handle = (CUSTOM_FILE_HANDLE_T *)file->pextension;
+    int read = 0;
+
+    if (handle && (file->index < file->len))
+    {
+        if (count > file->len - file->index)
+        {
+            count = file->len - file->index;
+        }
+
+        read = handle->file->read(handle->state, buffer, count);
+    }
+
+    if (handle && handle->file->window)
+    {
+        if (read == CUSTOM_FILE_EOF)
+        {
+            return(FS_READ_EOF);
+        }
+
+        if (read <= 0)
+        {
+            handle->wake = callback_fn;
+            handle->wake_arg = callback_arg;
+            return(FS_READ_DELAYED);
+        }
+
+        // index is left at zero so that httpd always sees a full window still to come
+        return(read);
+    }
+
+    if (read <= 0)
+    {
+        return(FS_READ_EOF);
+    }
+
+    file->index += read;
+
+    return(read);
+}
+
+/*!
+ * \brief Release a generated file
+ *
+ * \param[in]   file      httpd file handle
+ *
+ * \return nothing
+ */
+void fs_close_custom(struct fs_file *file)
+{
+    CUSTOM_FILE_HANDLE_T *handle = (CUSTOM_FILE_HANDLE_T *)file->pextension;
+
+    CUSTOM_FILE_HANDLE_T **link;
+
+    if (handle)
+    {
+        for (link = &open_streams; *link; link = &(*link)->next)
+        {
+            if (*link == handle)
+            {
+                *link = handle->next;
+                break;
+            }
+        }
+
+        handle->file->close(handle->state);
+        mem_free(handle);
+        file->pextension = NULL;
+    }
+}
+
+/*!
+ * \brief Write the http header for a custom file
+ *
+ * \param[out]  buffer            destination
+ * \param[in]   length            size of destination
+ * \param[in]   content_type      mime type of the body
+ * \param[in]   content_length    length of the body or CUSTOM_FILE_NO_LENGTH
+ *
+ * \return length of header
+ */
+int custom_file_header(char *buffer, int length, const char *content_type, int content_length)
+{
+    if (content_length == CUSTOM_FILE_NO_LENGTH)
+    {
+        return(snprintf(buffer, length,
+                        "HTTP/1.0 200 OK\r\n"
+                        "Server: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\n"
+                        "Content-type: %s\r\n"
+                        "Cache-Control: no-store\r\n"
+                        "\r\n",
+                        content_type));
+    }
+
+    return(snprintf(buffer, length,
+                    "HTTP/1.0 200 OK\r\n"
+                    "Server: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\n"
+                    "Content-type: %s\r\n"
+                    "Content-Length: %d\r\n"
+                    "Cache-Control: no-store\r\n"
+                    "\r\n",
+                    content_type, content_length));
+}
+
+/*!
+ * \brief Tell parked streams that they may have something to send, callable from any task
+ *
+ * \return nothing
+ */
+void custom_files_notify(void)
+{
+    if (!notify_pending)
+    {
+        notify_pending = true;
+
+        if (tcpip_try_callback(custom_files_wake, NULL) != ERR_OK)
+        {
+            // tcpip mailbox is full, the httpd poll picks the streams up instead
+            notify_pending = false;
+        }
+    }
+}
+
+/*!
+ * \brief Check whether a uri is served by a custom file
+ *
+ * \param[in]   pattern   custom file name, a leading '*' matches any uri ending in the rest of the pattern
+ * \param[in]   name      requested uri
+ *
+ * \return true if the uri matches
+ */
+static bool custom_file_match(const char *pattern, const char *name)
+{
+    size_t pattern_length;
+    size_t name_length;
+
+    if (pattern[0] != '*')
+    {
+        return(strcmp(pattern, name) == 0);
+    }
+
+    pattern_length = strlen(pattern + 1);
+    name_length = strlen(name);
+
+    return((name_length >= pattern_length) && (strcmp(name + name_length - pattern_length, pattern + 1) == 0));
+}
+
+/*!
+ * \brief Resume parked streams that are ready, runs on the tcpip thread
+ *
+ * \param[in]   arg       unused
+ *
+ * \return nothing
+ */
+static void custom_files_wake(__unused void *arg)
+{
+    CUSTOM_FILE_HANDLE_T *handle;
+    CUSTOM_FILE_HANDLE_T *next;
+    fs_wait_cb wake;
+
+    notify_pending = false;
+
+    for (handle = open_streams; handle; handle = next)
+    {
+        // resuming may finish the connection and free the handle
+        next = handle->next;
+
+        if (handle->wake && handle->file->ready(handle->state))
+        {
+            wake = handle->wake;
+            handle->wake = NULL;
+            wake(handle->wake_arg);
+        }
+    }
+}
+
+#ifdef INCORPORATE_THERMOSTAT
+/*!
+ * \brief Snapshot the temperature history and size the response
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    total response length including header
+ *
+ * \return stream state or NULL if out of memory
+ */
+static void *history_open(__unused const char *name, int *length)
+{
+    HISTORY_STREAM_T *history;
+    int content_length = 0;
+    int sample;
+
+    history = (HISTORY_STREAM_T *)mem_malloc(sizeof(HISTORY_STREAM_T));
+    if (!history)
+    {
+        return(NULL);
+    }
+
+    history->count = copy_temperature_history(history->unix_time, history->temperaturex10, SIZE_CLIMATE_HISTORY);
+    history->base = history->count ? history->unix_time[0] : 0;
+
+    // size the body without formatting it, each sample is [offset,temperature] with a comma before all but the first
+    content_length = history_format(history, HISTORY_ITEM_PREFIX, 0) + history_format(history, HISTORY_ITEM_SAMPLE + history->count, 0);
+    for (sample = 0; sample < history->count; sample++)
+    {
+        content_length += (sample ? 4 : 3) + decimal_length(history->unix_time[sample] - history->base) + decimal_length(history->temperaturex10[sample]);
+    }
+
+    // header is sent first
+    history->next = HISTORY_ITEM_PREFIX;
+    history->pending_length = history_format(history, HISTORY_ITEM_HEADER, content_length);
+    history->pending_offset = 0;
+
+    *length = history->pending_length + content_length;
+
+    return(history);
+}
+
+/*!
+ * \brief Format the next part of the history into the tcp send buffer
+ *
+ * \param[in]   state     stream state
+ * \param[out]  buffer    destination
+ * \param[in]   count     size of destination
+ *
+ * \return bytes written
+ */
+static int history_read(void *state, char *buffer, int count)
+{
+    HISTORY_STREAM_T *history = (HISTORY_STREAM_T *)state;
+    int written = 0;
+    int chunk;
+
+    while (written < count)
+    {
+        if (history->pending_offset >= history->pending_length)
+        {
+            if (history->next > HISTORY_ITEM_SAMPLE + history->count)
+            {
+                break;
+            }
+
+            history->pending_length = history_format(history, history->next++, 0);
+            history->pending_offset = 0;
+        }
+
+        // items that do not fit are finished on the next read
+        chunk = history->pending_length - history->pending_offset;
+        if (chunk > count - written)
+        {
+            chunk = count - written;
+        }
+
+        memcpy(buffer + written, history->pending + history->pending_offset, chunk);
+        history->pending_offset += chunk;
+        written += chunk;
+    }
+
+    return(written);
+}
+
+/*!
+ * \brief Release history stream
+ *
+ * \param[in]   state     stream state
+ *
+ * \return nothing
+ */
+static void history_close(void *state)
+{
+    mem_free(state);
+}
+
+/*!
+ * \brief Format one item of the history response into the pending buffer
+ *
+ * \param[in]   history           stream state
+ * \param[in]   item              HISTORY_ITEM_HEADER, HISTORY_ITEM_PREFIX, sample number + HISTORY_ITEM_SAMPLE or trailer
+ * \param[in]   content_length    body length, only used for the header
+ *
+ * \return bytes formatted
+ */
+static int history_format(HISTORY_STREAM_T *history, int item, int content_length)
+{
+    int sample = item - HISTORY_ITEM_SAMPLE;
+    int printed;
+
+    if (item == HISTORY_ITEM_HEADER)
+    {
+        printed = custom_file_header(history->pending, sizeof(history->pending), "application/json", content_length);
+    }
+    else if (item == HISTORY_ITEM_PREFIX)
+    {
+        printed = snprintf(history->pending, sizeof(history->pending), "{\"base\":%lu,\"points\":[", (unsigned long)history->base);
+    }
+    else if (sample < history->count)
+    {
+        printed = snprintf(history->pending, sizeof(history->pending), "%s[%lu,%d]",
+                           sample ? "," : "",
+                           (unsigned long)(history->unix_time[sample] - history->base),
+                           history->temperaturex10[sample]);
+    }
+    else
+    {
+        printed = snprintf(history->pending, sizeof(history->pending), "]}");
+    }
+
+    return(printed);
+}
+/*!
+ * \brief Number of characters needed to print an integer
+ *
+ * \param[in]   value     integer to measure
+ *
+ * \return characters including any minus sign
+ */
+static int decimal_length(long value)
+{
+    int length = 1;
+
+    if (value < 0)
+    {
+        length++;
+        value = -value;
+    }
+
+    while (value >= 10)
+    {
+        value /= 10;
+        length++;
+    }
+
+    return(length);
+}
+#endif
@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef CUSTOM_FILES_H
+#define CUSTOM_FILES_H
+
+#include <stdbool.h>
+
+#define CUSTOM_FILE_HEADER_MAX      (160)       // longest http header written by a custom file
+#define CUSTOM_FILE_NO_LENGTH       (-1)        // content_length for streams, header omits Content-Length
+#define CUSTOM_FILE_EOF             (-1)        // returned by read() when a stream has sent everything
+
+// generated responses served by httpd alongside the pages in htmldata.c
+typedef struct
+{
+    const char *name;                                       // uri, e.g. "/history", or "*.shtml" for every uri ending in .shtml
+    void *(*open)(const char *name, int *length);           // returns private state and sets total response length, NULL to decline
+    int (*read)(void *state, char *buffer, int count);      // returns bytes written (> 0, 0 when a stream has nothing to send yet or CUSTOM_FILE_EOF)
+    void (*close)(void *state);
+    bool (*ready)(void *state);                             // streams only, true when read() has something to send
+    int window;                                             // streams only, how far ahead of the client httpd may read
+} CUSTOM_FILE_T;
+
+int custom_file_header(char *buffer, int length, const char *content_type, int content_length);
+void custom_files_notify(void);
+
+#endif
@@ -88,15 +88,39 @@ void discovery_task(__unused void *params)
 {
     SOCKADDR_IN sClientAddress;  
     int received_bytes = 0;         
+    TickType_t last_sweep = 0;
+    bool started = false;
     
     printf("discovery task started\n");
     while (true)
     {        
-        if ((config.personality == HOME_CONTROLLER))
+        if ((config.personality == HOME_CONTROLLER) && !started)
+        {
+            // sweep straight away only if no devices were known before the reboot
+            if (shelly_discovery_start() > 0)
+            {
+                last_sweep = xTaskGetTickCount();
+            }
+            else
+            {
+                last_sweep = xTaskGetTickCount() - pdMS_TO_TICKS(SHELLY_SWEEP_INTERVAL_MS);
+            }
+            started = true;
+        }
+
+        if ((config.personality == HOME_CONTROLLER) && (xTaskGetTickCount() - last_sweep >= pdMS_TO_TICKS(SHELLY_SWEEP_INTERVAL_MS)))
         {
             printf("Begin shelly device discovery\n");
             discover_shelly_devices();
             printf("End shelly shelly device discovery\n");
+
+            last_sweep = xTaskGetTickCount();
+        }
+        else if (config.personality == HOME_CONTROLLER)
+        {
+            // pick up new and changed devices from the arp table and mDNS announcements
+            shelly_discovery_poll();
+            SLEEP_MS(1000);
         }
         else
         {
@@ -0,0 +1,457 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ecowitt.h"
+
+/*
+ * Ecowitt gateway protocol
+ *
+ * Replies from the gateway's tcp api (port 45000) are reassembled from whatever pieces recv() returns, so a reply
+ * split across reads or several replies arriving in one read are both handled.  The stream looks for the 0xffff
+ * header, reads the size (2 bytes for the commands that reply with a large payload, else 1), waits for the rest of
+ * the frame and checks the checksum.  Bytes that do not start a good frame are skipped one at a time until one does.
+ *
+ * Live data and rain data replies are a list of items, each an id byte followed by a value whose length depends on
+ * the id.  Each reply type has a 256 entry table indexed by id that gives the value's length and where it is stored
+ * in the observation, so an item is decoded with one lookup.  An id missing from the table has an unknown length and
+ * ends decoding of that frame, keeping the items before it.
+ */
+
+// NB: this file must not depend on lwIP so that ecowitt_bench can replay, split and fuzz recorded gateway replies
+
+#define ECOWITT_HEADER          (0xff)
+
+typedef enum
+{
+    ECOWITT_KIND_SKIP = 0,      // known length, not kept
+    ECOWITT_KIND_U8,
+    ECOWITT_KIND_U16,
+    ECOWITT_KIND_S16,
+    ECOWITT_KIND_U32,
+    ECOWITT_KIND_BYTES,         // copied as sent
+} ECOWITT_KIND_T;
+
+typedef struct
+{
+    uint8_t length;             // bytes of value following the id, 0 if the id is unknown
+    uint8_t kind;               // ECOWITT_KIND_T
+    uint16_t offset;            // of the value in ECOWITT_OBSERVATION_T
+} ECOWITT_ITEM_T;
+
+#define ECOWITT_FIELD(field)        offsetof(ECOWITT_OBSERVATION_T, field)
+#define ECOWITT_SKIP(length)        {length, ECOWITT_KIND_SKIP, 0}
+#define ECOWITT_U8(field)           {1, ECOWITT_KIND_U8, ECOWITT_FIELD(field)}
+#define ECOWITT_U16(field)          {2, ECOWITT_KIND_U16, ECOWITT_FIELD(field)}
+#define ECOWITT_S16(field)          {2, ECOWITT_KIND_S16, ECOWITT_FIELD(field)}
+#define ECOWITT_U32(length, field)  {length, ECOWITT_KIND_U32, ECOWITT_FIELD(field)}
+#define ECOWITT_BYTES(field)        {sizeof(((ECOWITT_OBSERVATION_T *)0)->field), ECOWITT_KIND_BYTES, ECOWITT_FIELD(field)}
+
+_Static_assert(sizeof(ECOWITT_OBSERVATION_T) <= UINT16_MAX, "observation offsets must fit ECOWITT_ITEM_T.offset");
+
+// items sent in both live data and rain data replies
+#define ECOWITT_PIEZO_ITEMS                                                 \
+    [ITEM_Piezo_Rain_Rate]      = ECOWITT_U16(piezo_rain_rate),             \
+    [ITEM_Piezo_Event_Rain]     = ECOWITT_U16(piezo_rain_event),            \
+    [ITEM_Piezo_Hourly_Rain]    = ECOWITT_U16(piezo_rain_hour),             \
+    [ITEM_Piezo_Daily_Rain]     = ECOWITT_U32(4, piezo_rain_day),           \
+    [ITEM_Piezo_Weekly_Rain]    = ECOWITT_U32(4, piezo_rain_week),          \
+    [ITEM_Piezo_Monthly_Rain]   = ECOWITT_U32(4, piezo_rain_month),         \
+    [ITEM_Piezo_yearly_Rain]    = ECOWITT_U32(4, piezo_rain_year),          \
+    [ITEM_Piezo_Gain10]         = ECOWITT_BYTES(piezo_gain),                \
+    [ITEM_RST_RainTime]         = ECOWITT_BYTES(rain_reset_time),           \
+    [ITEM_UNKNOWN_6C]           = ECOWITT_SKIP(4),                          \
+    [ITEM_RAIN_PRIORITY]        = ECOWITT_U8(rain_priority),                \
+    [ITEM_RAD_COMPENSATION]     = ECOWITT_SKIP(1)
+
+// CMD_GW1000_LIVEDATA reply
+static const ECOWITT_ITEM_T ecowitt_live_items[256] =
+{
+    [ITEM_INTEMP]           = ECOWITT_S16(indoor_temperature),
+    [ITEM_OUTTEMP]          = ECOWITT_S16(outdoor_temperature),
+    [ITEM_DEWPOINT]         = ECOWITT_S16(dew_point),
+    [ITEM_WINDCHILL]        = ECOWITT_S16(wind_chill),
+    [ITEM_HEATINDEX]        = ECOWITT_S16(heat_index),
+    [ITEM_INHUMI]           = ECOWITT_U8(indoor_humidity),
+    [ITEM_OUTHUMI]          = ECOWITT_U8(outdoor_humidity),
+    [ITEM_ABSBARO]          = ECOWITT_U16(absolute_pressure),
+    [ITEM_RELBARO]          = ECOWITT_U16(relative_pressure),
+    [ITEM_WINDDIRECTION]    = ECOWITT_U16(wind_direction),
+    [ITEM_WINDSPEED]        = ECOWITT_U16(wind_speed),
+    [ITEM_GUSTSPEED]        = ECOWITT_U16(gust_speed),
+    [ITEM_RAINEVENT]        = ECOWITT_U16(rain_event),
+    [ITEM_RAINRATE]         = ECOWITT_U16(rain_rate),
+    [ITEM_RAINHOUR]         = ECOWITT_U16(rain_hour),
+    [ITEM_RAINDAY]          = ECOWITT_U32(2, rain_day),
+    [ITEM_RAINWEEK]         = ECOWITT_U32(2, rain_week),
+    [ITEM_RAINMONTH]        = ECOWITT_U32(4, rain_month),
+    [ITEM_RAINYEAR]         = ECOWITT_U32(4, rain_year),
+    [ITEM_RAINTOTALS]       = ECOWITT_U32(4, rain_total),
+    [ITEM_LIGHT]            = ECOWITT_U32(4, light),
+    [ITEM_UV]               = ECOWITT_U16(uv),
+    [ITEM_UVI]              = ECOWITT_U8(uvi),
+    [ITEM_TIME]             = ECOWITT_BYTES(time),
+    [ITEM_DAYLWINDMAX]      = ECOWITT_U16(day_max_wind),
+    [ITEM_TEMP1]            = ECOWITT_S16(temperature[0]),
+    [ITEM_TEMP2]            = ECOWITT_S16(temperature[1]),
+    [ITEM_TEMP3]            = ECOWITT_S16(temperature[2]),
+    [ITEM_TEMP4]            = ECOWITT_S16(temperature[3]),
+    [ITEM_TEMP5]            = ECOWITT_S16(temperature[4]),
+    [ITEM_TEMP6]            = ECOWITT_S16(temperature[5]),
+    [ITEM_TEMP7]            = ECOWITT_S16(temperature[6]),
+    [ITEM_TEMP8]            = ECOWITT_S16(temperature[7]),
+    [ITEM_HUMI1]            = ECOWITT_U8(humidity[0]),
+    [ITEM_HUMI2]            = ECOWITT_U8(humidity[1]),
+    [ITEM_HUMI3]            = ECOWITT_U8(humidity[2]),
+    [ITEM_HUMI4]            = ECOWITT_U8(humidity[3]),
+    [ITEM_HUMI5]            = ECOWITT_U8(humidity[4]),
+    [ITEM_HUMI6]            = ECOWITT_U8(humidity[5]),
+    [ITEM_HUMI7]            = ECOWITT_U8(humidity[6]),
+    [ITEM_HUMI8]            = ECOWITT_U8(humidity[7]),
+    [ITEM_PM25_CH1]         = ECOWITT_U16(pm25[0]),
+    [ITEM_PM25_CH2]         = ECOWITT_U16(pm25[1]),
+    [ITEM_PM25_CH3]         = ECOWITT_U16(pm25[2]),
+    [ITEM_SOILTEMP1]        = ECOWITT_S16(soil_temperature[0]),
+    [ITEM_SOILMOISTURE1]    = ECOWITT_U8(soil_moisture[0]),
+    [ITEM_SOILTEMP2]        = ECOWITT_S16(soil_temperature[1]),
+    [ITEM_SOILMOISTURE2]    = ECOWITT_U8(soil_moisture[1]),
+    [ITEM_SOILTEMP3]        = ECOWITT_S16(soil_temperature[2]),
+    [ITEM_SOILMOISTURE3]    = ECOWITT_U8(soil_moisture[2]),
+    [ITEM_SOILTEMP4]        = ECOWITT_S16(soil_temperature[3]),
+    [ITEM_SOILMOISTURE4]    = ECOWITT_U8(soil_moisture[3]),
+    [ITEM_SOILTEMP5]        = ECOWITT_S16(soil_temperature[4]),
+    [ITEM_SOILMOISTURE5]    = ECOWITT_U8(soil_moisture[4]),
+    [ITEM_SOILTEMP6]        = ECOWITT_S16(soil_temperature[5]),
+    [ITEM_SOILMOISTURE6]    = ECOWITT_U8(soil_moisture[5]),
+    [ITEM_SOILTEMP7]        = ECOWITT_S16(soil_temperature[6]),
+    [ITEM_SOILMOISTURE7]    = ECOWITT_U8(soil_moisture[6]),
+    [ITEM_SOILTEMP8]        = ECOWITT_S16(soil_temperature[7]),
+    [ITEM_SOILMOISTURE8]    = ECOWITT_U8(soil_moisture[7]),
+    [ITEM_SOILTEMP9]        = ECOWITT_S16(soil_temperature[8]),
+    [ITEM_SOILMOISTURE9]    = ECOWITT_U8(soil_moisture[8]),
+    [ITEM_SOILTEMP10]       = ECOWITT_S16(soil_temperature[9]),
+    [ITEM_SOILMOISTURE10]   = ECOWITT_U8(soil_moisture[9]),
+    [ITEM_SOILTEMP11]       = ECOWITT_S16(soil_temperature[10]),
+    [ITEM_SOILMOISTURE11]   = ECOWITT_U8(soil_moisture[10]),
+    [ITEM_SOILTEMP12]       = ECOWITT_S16(soil_temperature[11]),
+    [ITEM_SOILMOISTURE12]   = ECOWITT_U8(soil_moisture[11]),
+    [ITEM_SOILTEMP13]       = ECOWITT_S16(soil_temperature[12]),
+    [ITEM_SOILMOISTURE13]   = ECOWITT_U8(soil_moisture[12]),
+    [ITEM_SOILTEMP14]       = ECOWITT_S16(soil_temperature[13]),
+    [ITEM_SOILMOISTURE14]   = ECOWITT_U8(soil_moisture[13]),
+    [ITEM_SOILTEMP15]       = ECOWITT_S16(soil_temperature[14]),
+    [ITEM_SOILMOISTURE15]   = ECOWITT_U8(soil_moisture[14]),
+    [ITEM_SOILTEMP16]       = ECOWITT_S16(soil_temperature[15]),
+    [ITEM_SOILMOISTURE16]   = ECOWITT_U8(soil_moisture[15]),
+    [ITEM_LOWBATT]          = ECOWITT_BYTES(low_battery),
+    [ITEM_PM25_24HAVG1]     = ECOWITT_U16(pm25_24h[0]),
+    [ITEM_PM25_24HAVG2]     = ECOWITT_U16(pm25_24h[1]),
+    [ITEM_PM25_24HAVG3]     = ECOWITT_U16(pm25_24h[2]),
+    [ITEM_PM25_24HAVG4]     = ECOWITT_U16(pm25_24h[3]),
+    ECOWITT_PIEZO_ITEMS,
+};
+
+// CMD_READ_RAIN reply, where the tipping bucket day and week totals are 4 bytes
+static const ECOWITT_ITEM_T ecowitt_rain_items[256] =
+{
+    [ITEM_RAINEVENT]        = ECOWITT_U16(rain_event),
+    [ITEM_RAINRATE]         = ECOWITT_U16(rain_rate),
+    [ITEM_RAINHOUR]         = ECOWITT_U16(rain_hour),
+    [ITEM_RAINDAY]          = ECOWITT_U32(4, rain_day),
+    [ITEM_RAINWEEK]         = ECOWITT_U32(4, rain_week),
+    [ITEM_RAINMONTH]        = ECOWITT_U32(4, rain_month),
+    [ITEM_RAINYEAR]         = ECOWITT_U32(4, rain_year),
+    ECOWITT_PIEZO_ITEMS,
+};
+
+// prototypes
+static int ecowitt_size_bytes(uint8_t command);
+
+/*!
+ * \brief Empty a reassembly stream, e.g. after the connection to the gateway is (re)made
+ *
+ * \param[out] stream   stream
+ *
+ * \return nothing
+ */
+void ecowitt_stream_init(ECOWITT_STREAM_T *stream)
+{
+    memset(stream, 0, sizeof(ECOWITT_STREAM_T));
+}
+
+/*!
+ * \brief Get the free space at the end of the stream so that recv() can write straight into it
+ *
+ * Invalidates any frame returned by ecowitt_stream_next().
+ *
+ * \param[in,out] stream    stream
+ * \param[out]    space     bytes free
+ *
+ * \return where to write received bytes
+ */
+uint8_t *ecowitt_stream_space(ECOWITT_STREAM_T *stream, int *space)
+{
+    // drop the frames already returned
+    if (stream->consumed)
+    {
+        stream->length -= stream->consumed;
+        memmove(stream->buffer, stream->buffer + stream->consumed, stream->length);
+        stream->consumed = 0;
+    }
+
+    // cannot happen while frames are drained as ecowitt_stream_next() only waits for frames that fit the buffer
+    if (stream->length >= ECOWITT_FRAME_MAX)
+    {
+        stream->discarded += stream->length;
+        stream->length = 0;
+    }
+
+    *space = ECOWITT_FRAME_MAX - stream->length;
+
+    return(stream->buffer + stream->length);
+}
+
+/*!
+ * \brief Add bytes written to the space returned by ecowitt_stream_space()
+ *
+ * \param[in,out] stream    stream
+ * \param[in]     length    bytes written
+ *
+ * \return nothing
+ */
+void ecowitt_stream_received(ECOWITT_STREAM_T *stream, int length)
+{
+    if ((length > 0) && (length <= ECOWITT_FRAME_MAX - stream->length))
+    {
+        stream->length += length;
+    }
+}
+
+/*!
+ * \brief Get the next complete frame with a good checksum
+ *
+ * \param[in,out] stream        stream
+ * \param[out]    frame         frame from its 0xffff header to its checksum, valid until the stream is next changed
+ * \param[out]    frame_length  bytes in frame
+ *
+ * \return true if a frame was found, false if more bytes are needed
+ */
+bool ecowitt_stream_next(ECOWITT_STREAM_T *stream, const uint8_t **frame, int *frame_length)
+{
+    const uint8_t *start;
+    const uint8_t *header;
+    int available;
+    int width;
+    int size;
+    int checksum;
+    int i;
+
+    for (;;)
+    {
+        start = stream->buffer + stream->consumed;
+        available = stream->length - stream->consumed;
+
+        // skip to the next possible header
+        header = memchr(start, ECOWITT_HEADER, available);
+        if (!header)
+        {
+            stream->discarded += available;
+            stream->consumed = stream->length = 0;
+            break;
+        }
+        stream->discarded += header - start;
+        stream->consumed += header - start;
+        available -= header - start;
+
+        if (available < 3)
+        {
+            break;
+        }
+
+        width = ecowitt_size_bytes(header[2]);
+        if (header[1] != ECOWITT_HEADER)
+        {
+            size = 0;
+        }
+        else if (available < 3 + width)
+        {
+            break;
+        }
+        else
+        {
+            size = (width == 2) ? (header[3] << 8) | header[4] : header[3];
+        }
+
+        // size counts from the command to the checksum
+        if ((size < width + 2) || (size + 2 > ECOWITT_FRAME_MAX))
+        {
+            stream->discarded++;
+            stream->consumed++;
+            continue;
+        }
+
+        if (available < size + 2)
+        {
+            break;
+        }
+
+        checksum = 0;
+        for (i=2; i<size+1; i++)
+        {
+            checksum += header[i];
+        }
+
+        if ((checksum & 0xff) != header[size+1])
+        {
+            stream->checksum_errors++;
+            stream->discarded++;
+            stream->consumed++;
+            continue;
+        }
+
+        *frame = header;
+        *frame_length = size + 2;
+        stream->consumed += size + 2;
+        stream->frames++;
+
+        return(true);
+    }
+
+    return(false);
+}
+
+/*!
+ * \brief Decode the items of a live data or rain data reply into an observation
+ *
+ * Values already in the observation are kept unless the frame has a new value for them.
+ *
+ * \param[in]     frame         frame returned by ecowitt_stream_next()
+ * \param[in]     frame_length  bytes in frame
+ * \param[in,out] observation   receives the values
+ *
+ * \return ECOWITT_OK if every item was decoded, else why decoding stopped or did not start
+ */
+ECOWITT_RESULT_T ecowitt_decode(const uint8_t *frame, int frame_length, ECOWITT_OBSERVATION_T *observation)
+{
+    const ECOWITT_ITEM_T *items;
+    const ECOWITT_ITEM_T *item;
+    const uint8_t *value;
+    uint8_t *target;
+    uint32_t number;
+    int end;
+    int i;
+    int j;
+
+    if (frame_length < 5)
+    {
+        return(ECOWITT_NOT_DATA);
+    }
+
+    switch(frame[2])
+    {
+        case CMD_GW1000_LIVEDATA:
+            items = ecowitt_live_items;
+            break;
+        case CMD_READ_RAIN:
+            items = ecowitt_rain_items;
+            break;
+        default:
+            return(ECOWITT_NOT_DATA);
+    }
+
+    // items follow the 0xffff header, command and 2 byte size and end at the checksum
+    end = frame_length - 1;
+    for (i=5; i<end; i+=1+item->length)
+    {
+        item = &items[frame[i]];
+
+        if (!item->length)
+        {
+            observation->unknown_item = frame[i];
+            return(ECOWITT_UNKNOWN_ITEM);
+        }
+
+        if (i + 1 + item->length > end)
+        {
+            return(ECOWITT_TRUNCATED);
+        }
+
+        value = &frame[i+1];
+        target = (uint8_t *)observation + item->offset;
+
+        switch(item->kind)
+        {
+            case ECOWITT_KIND_U8:
+                *target = value[0];
+                break;
+            case ECOWITT_KIND_U16:
+                *(uint16_t *)target = (value[0] << 8) | value[1];
+                break;
+            case ECOWITT_KIND_S16:
+                *(int16_t *)target = (int16_t)((value[0] << 8) | value[1]);
+                break;
+            case ECOWITT_KIND_U32:
+                // 2 or 4 bytes
+                number = 0;
+                for (j=0; j<item->length; j++)
+                {
+                    number = (number << 8) | value[j];
+                }
+                *(uint32_t *)target = number;
+                break;
+            case ECOWITT_KIND_BYTES:
+                memcpy(target, value, item->length);
+                break;
+            default:
+                break;
+        }
+
+        observation->present[frame[i] >> 3] |= 1 << (frame[i] & 7);
+    }
+
+    return(ECOWITT_OK);
+}
+
+/*!
+ * \brief Check whether an item has been decoded into an observation
+ *
+ * \param[in]  observation  observation
+ * \param[in]  id           PARAM_LT item id
+ *
+ * \return true if the observation holds a value for the item
+ */
+bool ecowitt_present(const ECOWITT_OBSERVATION_T *observation, int id)
+{
+    return((id >= 0) && (id < 256) && (observation->present[id >> 3] & (1 << (id & 7))));
+}
+
+/*!
+ * \brief Width of the size field in replies to a command
+ *
+ * \param[in]  command  CMD_LT
+ *
+ * \return 2 for commands whose replies can exceed 255 bytes, else 1
+ */
+static int ecowitt_size_bytes(uint8_t command)
+{
+    int width = 1;
+
+    switch(command)
+    {
+        case CMD_BROADCAST:
+        case CMD_GW1000_LIVEDATA:
+        case CMD_READ_SENSOR_ID_NEW:
+        case CMD_READ_RAIN:
+            width = 2;
+            break;
+        default:
+            break;
+    }
+
+    return(width);
+}
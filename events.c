@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "weather.h"
+#include "config.h"
+#include "json_writer.h"
+#include "custom_files.h"
+#include "api.h"
+#include "events.h"
+
+/*
+ * Server-sent events on /events
+ *
+ * Producers bump a generation counter for their topic and nothing else, so publishing never blocks or allocates.
+ * Each client remembers the generation of every topic it was last sent.  When the client can take more data the
+ * newest state of each changed topic is written, using the same json as /api/v1, and any updates that arrived in
+ * between are simply never sent.  A slow client therefore costs one frame buffer however far behind it falls.
+ * httpd only reads from a stream once the previous frame has been handed to tcp, which is the backpressure.
+ *
+ * Connections live in a fixed table and are only touched on the tcpip thread (httpd callbacks).
+ */
+
+typedef void (*EVENTS_WRITER_T)(JSON_WRITER_T *writer);
+
+typedef struct
+{
+    const char *name;
+    EVENTS_WRITER_T writer;
+} EVENTS_TOPIC_T;
+
+typedef struct
+{
+    bool in_use;
+    bool header_sent;
+    int next_topic;                         // round robin so a busy topic cannot starve the others
+    uint32_t sent[NUM_EVENT_TOPICS];        // generation of each topic last sent
+    uint64_t us_last_send;
+    uint64_t us_last_status;
+    int frame_length;
+    int frame_offset;
+    char frame[EVENTS_FRAME_MAX];
+} EVENTS_CONNECTION_T;
+
+// prototypes
+static bool events_format(EVENTS_CONNECTION_T *connection);
+static int events_stale_topic(EVENTS_CONNECTION_T *connection);
+static bool events_keepalive_due(EVENTS_CONNECTION_T *connection);
+
+// topics in EVENT_TOPIC_T order
+static const EVENTS_TOPIC_T topics[NUM_EVENT_TOPICS] =
+{
+    {"wind", api_write_wind},
+    {"weather", api_write_weather},
+#ifdef INCORPORATE_THERMOSTAT
+    {"thermostat", api_write_thermostat},
+#else
+    {"thermostat", NULL},
+#endif
+    {"status", api_write_status},
+};
+
+static EVENTS_CONNECTION_T connections[EVENTS_MAX_CONNECTIONS];
+static volatile uint32_t generation[NUM_EVENT_TOPICS];
+static EVENTS_STATS_T stats;
+
+/*!
+ * \brief Tell connected clients that a topic has changed
+ *
+ * \param[in]   topic     topic that changed
+ *
+ * \return nothing
+ */
+void events_publish(EVENT_TOPIC_T topic)
+{
+    if ((unsigned)topic >= NUM_EVENT_TOPICS)
+    {
+        return;
+    }
+
+    generation[topic]++;
+
+    if (stats.connections)
+    {
+        custom_files_notify();
+    }
+}
+
+/*!
+ * \brief Get event stream statistics
+ *
+ * \param[out]  stats_out     statistics
+ *
+ * \return nothing
+ */
+void events_get_stats(EVENTS_STATS_T *stats_out)
+{
+    *stats_out = stats;
+}
+
+/*!
+ * \brief Accept an /events client
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    unused, streams have no length
+ *
+ * \return connection or NULL if every connection is in use
+ */
+void *events_open(__unused const char *name, int *length)
+{
+    EVENTS_CONNECTION_T *connection = NULL;
+    int i;
+
+    for (i = 0; i < EVENTS_MAX_CONNECTIONS; i++)
+    {
+        if (!connections[i].in_use)
+        {
+            connection = &connections[i];
+            break;
+        }
+    }
+
+    if (!connection)
+    {
+        stats.refused++;
+        return(NULL);
+    }
+
+    connection->in_use = true;
+    connection->header_sent = false;
+    connection->next_topic = 0;
+    connection->us_last_send = time_us_64();
+    connection->us_last_status = connection->us_last_send;
+    connection->frame_length = 0;
+    connection->frame_offset = 0;
+
+    // everything is stale so that a new client starts with the current state
+    for (i = 0; i < NUM_EVENT_TOPICS; i++)
+    {
+        connection->sent[i] = generation[i] - 1;
+    }
+
+    stats.connections++;
+    stats.accepted++;
+
+    *length = CUSTOM_FILE_NO_LENGTH;
+
+    return(connection);
+}
+
+/*!
+ * \brief Check whether a client has anything to be sent
+ *
+ * \param[in]   state     connection
+ *
+ * \return true if events_read() will write something
+ */
+bool events_ready(void *state)
+{
+    EVENTS_CONNECTION_T *connection = (EVENTS_CONNECTION_T *)state;
+
+    return((connection->frame_offset < connection->frame_length) ||
+           !connection->header_sent ||
+           (events_stale_topic(connection) >= 0) ||
+           events_keepalive_due(connection));
+}
+
+/*!
+ * \brief Write pending events into the tcp send buffer
+ *
+ * \param[in]   state     connection
+ * \param[out]  buffer    destination
+ * \param[in]   count     size of destination
+ *
+ * \return bytes written, 0 if there is nothing to send
+ */
+int events_read(void *state, char *buffer, int count)
+{
+    EVENTS_CONNECTION_T *connection = (EVENTS_CONNECTION_T *)state;
+    int written = 0;
+    int chunk;
+
+    while (written < count)
+    {
+        if (connection->frame_offset >= connection->frame_length)
+        {
+            if (!events_format(connection))
+            {
+                break;
+            }
+        }
+
+        // frames that do not fit are finished on the next read
+        chunk = connection->frame_length - connection->frame_offset;
+        if (chunk > count - written)
+        {
+            chunk = count - written;
+        }
+
+        memcpy(buffer + written, connection->frame + connection->frame_offset, chunk);
+        connection->frame_offset += chunk;
+        written += chunk;
+    }
+
+    return(written);
+}
+
+/*!
+ * \brief Release a client
+ *
+ * \param[in]   state     connection
+ *
+ * \return nothing
+ */
+void events_close(void *state)
+{
+    EVENTS_CONNECTION_T *connection = (EVENTS_CONNECTION_T *)state;
+
+    connection->in_use = false;
+    stats.connections--;
+}
+
+/*!
+ * \brief Format the next frame for a client: http header, newest state of a changed topic, or keepalive
+ *
+ * \param[in]   connection    client
+ *
+ * \return true if a frame was formatted
+ */
+static bool events_format(EVENTS_CONNECTION_T *connection)
+{
+    JSON_WRITER_T writer;
+    uint32_t latest;
+    int topic;
+    int prefix;
+    int length;
+
+    connection->frame_length = 0;
+    connection->frame_offset = 0;
+
+    if (!connection->header_sent)
+    {
+        length = custom_file_header(connection->frame, sizeof(connection->frame), "text/event-stream", CUSTOM_FILE_NO_LENGTH);
+        length += snprintf(connection->frame + length, sizeof(connection->frame) - length, "retry: %d\n\n", EVENTS_RETRY_MS);
+        connection->header_sent = true;
+    }
+    else if ((topic = events_stale_topic(connection)) >= 0)
+    {
+        // read the generation first so that an update made while writing is sent again
+        latest = generation[topic];
+        stats.coalesced += latest - connection->sent[topic] - 1;
+        connection->sent[topic] = latest;
+        connection->next_topic = (topic + 1) % NUM_EVENT_TOPICS;
+
+        if (topic == EVENT_STATUS)
+        {
+            connection->us_last_status = time_us_64();
+        }
+
+        // data line is a single line of json followed by the blank line that ends the event
+        prefix = snprintf(connection->frame, sizeof(connection->frame), "event: %s\ndata: ", topics[topic].name);
+        jsonw_init(&writer, connection->frame + prefix, sizeof(connection->frame) - prefix - 2);
+        topics[topic].writer(&writer);
+        length = jsonw_finish(&writer);
+
+        if (length < 0)
+        {
+            printf("events: %s does not fit in %d bytes\n", topics[topic].name, EVENTS_FRAME_MAX);
+            return(true);
+        }
+
+        memcpy(connection->frame + prefix + length, "\n\n", 2);
+        length += prefix + 2;
+        stats.sent++;
+    }
+    else if (events_keepalive_due(connection))
+    {
+        // comment line, ignored by EventSource but keeps httpd and any proxies from timing out
+        length = snprintf(connection->frame, sizeof(connection->frame), ":\n\n");
+    }
+    else
+    {
+        return(false);
+    }
+
+    connection->frame_length = length;
+    connection->us_last_send = time_us_64();
+
+    return(true);
+}
+
+/*!
+ * \brief Find a topic that changed since it was last sent to a client
+ *
+ * \param[in]   connection    client
+ *
+ * \return topic or -1 if the client is up to date
+ */
+static int events_stale_topic(EVENTS_CONNECTION_T *connection)
+{
+    int topic;
+    int i;
+
+    for (i = 0; i < NUM_EVENT_TOPICS; i++)
+    {
+        topic = (connection->next_topic + i) % NUM_EVENT_TOPICS;
+
+        if (!topics[topic].writer)
+        {
+            continue;
+        }
+
+        if (connection->sent[topic] != generation[topic])
+        {
+            return(topic);
+        }
+
+        if ((topic == EVENT_STATUS) && (time_us_64() - connection->us_last_status >= EVENTS_STATUS_MS*1000ULL))
+        {
+            // periodic resend counts as a fresh generation for this client only
+            connection->sent[topic]--;
+            return(topic);
+        }
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Check whether a client has been idle long enough to need a keepalive
+ *
+ * \param[in]   connection    client
+ *
+ * \return true if a keepalive should be sent
+ */
+static bool events_keepalive_due(EVENTS_CONNECTION_T *connection)
+{
+    return(time_us_64() - connection->us_last_send >= EVENTS_KEEPALIVE_MS*1000ULL);
+}
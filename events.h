@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENTS_MAX_CONNECTIONS  (3)         // concurrent /events clients, further requests are refused
+#define EVENTS_WINDOW           (256)       // bytes httpd reads ahead per client, also sizes its send buffer
+#define EVENTS_FRAME_MAX        (1024)      // longest event including the "event:" and "data:" lines
+#define EVENTS_KEEPALIVE_MS     (3000)      // must be well under the httpd idle timeout (HTTPD_MAX_RETRIES polls)
+#define EVENTS_STATUS_MS        (60000)     // status is also resent this often without being published
+#define EVENTS_RETRY_MS         (5000)      // browser reconnect delay
+
+typedef enum
+{
+    EVENT_WIND = 0,
+    EVENT_WEATHER,
+    EVENT_THERMOSTAT,
+    EVENT_STATUS,
+    NUM_EVENT_TOPICS
+} EVENT_TOPIC_T;
+
+typedef struct
+{
+    uint32_t connections;       // clients currently connected
+    uint32_t accepted;
+    uint32_t refused;           // turned away because every connection was in use
+    uint32_t sent;              // events sent to all clients
+    uint32_t coalesced;         // updates never sent because a newer one replaced them
+} EVENTS_STATS_T;
+
+// producers, callable from any task
+void events_publish(EVENT_TOPIC_T topic);
+void events_get_stats(EVENTS_STATS_T *stats);
+
+// custom file serving /events
+void *events_open(const char *name, int *length);
+int events_read(void *state, char *buffer, int count);
+bool events_ready(void *state);
+void events_close(void *state);
+
+#endif
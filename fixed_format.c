@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <string.h>
+
+#include "fixed_format.h"
+
+/*
+ * Fixed point number formatting
+ *
+ * Readings are kept as integers scaled by 10 or 100 and were printed with "%c%d.%d" style formats, which run the
+ * whole of newlib's printf (and its stack frame) to produce a handful of digits.  These formatters write digits two
+ * at a time from a lookup table, halving the divisions (done by the rp2040 hardware divider), into a small local
+ * buffer and then copy the result into the caller's buffer.  Nothing is allocated.
+ */
+
+// NB: this file must not depend on the pico sdk so that fixed_format_bench can check every formatter against snprintf()
+
+// prototypes
+static int ffmt_digits(char *end, uint32_t value, int min_digits);
+static int ffmt_put(char *buffer, int length, const char *text, int count);
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint32_t powers_of_ten[FFMT_DECIMALS_MAX + 1] =
+{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/*!
+ * \brief Format a signed integer
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   value     value to format
+ *
+ * \return length of the complete text
+ */
+int ffmt_int(char *buffer, int length, int32_t value)
+{
+    return(ffmt_fixed(buffer, length, value, 0, 0));
+}
+
+/*!
+ * \brief Format an unsigned integer
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   value     value to format
+ *
+ * \return length of the complete text
+ */
+int ffmt_uint(char *buffer, int length, uint32_t value)
+{
+    char text[FFMT_NUMBER_MAX];
+    int count;
+
+    count = ffmt_digits(text + sizeof(text), value, 1);
+
+    return(ffmt_put(buffer, length, text + sizeof(text) - count, count));
+}
+
+/*!
+ * \brief Format an unsigned 64 bit integer, e.g. a microsecond timestamp
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   value     value to format
+ *
+ * \return length of the complete text
+ */
+int ffmt_uint64(char *buffer, int length, uint64_t value)
+{
+    char text[FFMT_NUMBER_MAX];
+    char *end = text + sizeof(text);
+    int count = 0;
+
+    // 64 bit division is done in software so only use it to split off blocks of nine digits
+    while (value > UINT32_MAX)
+    {
+        count += ffmt_digits(end - count, value % 1000000000, 9);
+        value /= 1000000000;
+    }
+
+    count += ffmt_digits(end - count, (uint32_t)value, 1);
+
+    return(ffmt_put(buffer, length, end - count, count));
+}
+
+/*!
+ * \brief Format a fixed point number, e.g. value -215 with 1 decimal is written as -21.5
+ *
+ * \param[out]  buffer          destination
+ * \param[in]   length          size of destination including nul terminator
+ * \param[in]   value           value scaled by 10^decimals
+ * \param[in]   decimals        digits after the decimal point
+ * \param[in]   positive_sign   written in front of positive values and zero, e.g. ' ' to line up with negatives, or 0 for none
+ *
+ * \return length of the complete text
+ */
+int ffmt_fixed(char *buffer, int length, int32_t value, int decimals, char positive_sign)
+{
+    char text[FFMT_NUMBER_MAX];
+    char *end = text + sizeof(text);
+    uint32_t magnitude;
+    int count = 0;
+
+    if (decimals < 0)
+    {
+        decimals = 0;
+    }
+    else if (decimals > FFMT_DECIMALS_MAX)
+    {
+        decimals = FFMT_DECIMALS_MAX;
+    }
+
+    magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+    if (decimals > 0)
+    {
+        count += ffmt_digits(end - count, magnitude % powers_of_ten[decimals], decimals);
+        text[sizeof(text) - ++count] = '.';
+        magnitude /= powers_of_ten[decimals];
+    }
+
+    count += ffmt_digits(end - count, magnitude, 1);
+
+    if (value < 0)
+    {
+        text[sizeof(text) - ++count] = '-';
+    }
+    else if (positive_sign)
+    {
+        text[sizeof(text) - ++count] = positive_sign;
+    }
+
+    return(ffmt_put(buffer, length, end - count, count));
+}
+
+/*!
+ * \brief Format an ipv4 address in dotted decimal
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   address   address in host byte order, first octet in the most significant byte
+ *
+ * \return length of the complete text
+ */
+int ffmt_ipv4(char *buffer, int length, uint32_t address)
+{
+    char text[FFMT_NUMBER_MAX];
+    char *end = text + sizeof(text);
+    int count = 0;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (i)
+        {
+            text[sizeof(text) - ++count] = '.';
+        }
+        count += ffmt_digits(end - count, address & 0xFF, 1);
+        address >>= 8;
+    }
+
+    return(ffmt_put(buffer, length, end - count, count));
+}
+
+/*!
+ * \brief Format a date and time as YYYY-MM-DD?HH:MM:SS
+ *
+ * \param[out]  buffer      destination
+ * \param[in]   length      size of destination including nul terminator
+ * \param[in]   year        0 to 9999
+ * \param[in]   month       1 to 12
+ * \param[in]   day         1 to 31
+ * \param[in]   hour        0 to 23
+ * \param[in]   minute      0 to 59
+ * \param[in]   second      0 to 59
+ * \param[in]   separator   between date and time, 'T' for iso 8601 or ' '
+ *
+ * \return length of the complete text
+ */
+int ffmt_timestamp(char *buffer, int length, int year, int month, int day, int hour, int minute, int second, char separator)
+{
+    char text[FFMT_TIMESTAMP_MAX - 1];
+
+    if (((unsigned)year > 9999) || ((unsigned)month > 99) || ((unsigned)day > 99) ||
+        ((unsigned)hour > 99) || ((unsigned)minute > 99) || ((unsigned)second > 99))
+    {
+        // out of range field would index past the table
+        return(ffmt_put(buffer, length, "0000-00-00 00:00:00", sizeof(text)));
+    }
+
+    // every field is exactly two digits, copied straight from the table
+    memcpy(text, &digit_pairs[(year / 100)*2], 2);
+    memcpy(text + 2, &digit_pairs[(year % 100)*2], 2);
+    text[4] = '-';
+    memcpy(text + 5, &digit_pairs[month*2], 2);
+    text[7] = '-';
+    memcpy(text + 8, &digit_pairs[day*2], 2);
+    text[10] = separator;
+    memcpy(text + 11, &digit_pairs[hour*2], 2);
+    text[13] = ':';
+    memcpy(text + 14, &digit_pairs[minute*2], 2);
+    text[16] = ':';
+    memcpy(text + 17, &digit_pairs[second*2], 2);
+
+    return(ffmt_put(buffer, length, text, sizeof(text)));
+}
+
+/*!
+ * \brief Format a time zone offset as +HH:MM or -HH:MM
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   minutes   offset from utc in minutes
+ *
+ * \return length of the complete text
+ */
+int ffmt_utc_offset(char *buffer, int length, int minutes)
+{
+    char text[6];
+    int magnitude = (minutes < 0) ? -minutes : minutes;
+
+    text[0] = (minutes < 0) ? '-' : '+';
+    memcpy(text + 1, &digit_pairs[((magnitude / 60) % 100)*2], 2);
+    text[3] = ':';
+    memcpy(text + 4, &digit_pairs[(magnitude % 60)*2], 2);
+
+    return(ffmt_put(buffer, length, text, sizeof(text)));
+}
+
+/*!
+ * \brief Write the decimal digits of a value backwards, ending just before end
+ *
+ * \param[in]   end           one past the last digit
+ * \param[in]   value         value to write
+ * \param[in]   min_digits    pad with leading zeros to at least this many digits
+ *
+ * \return number of digits written
+ */
+static int ffmt_digits(char *end, uint32_t value, int min_digits)
+{
+    char *position = end;
+
+    while (value >= 100)
+    {
+        position -= 2;
+        memcpy(position, &digit_pairs[(value % 100)*2], 2);
+        value /= 100;
+    }
+
+    if (value >= 10)
+    {
+        position -= 2;
+        memcpy(position, &digit_pairs[value*2], 2);
+    }
+    else
+    {
+        *--position = '0' + value;
+    }
+
+    while (end - position < min_digits)
+    {
+        *--position = '0';
+    }
+
+    return(end - position);
+}
+
+/*!
+ * \brief Copy formatted text into the caller's buffer
+ *
+ * \param[out]  buffer    destination
+ * \param[in]   length    size of destination including nul terminator
+ * \param[in]   text      formatted text, not nul terminated
+ * \param[in]   count     length of text
+ *
+ * \return count, the length of the complete text even if it was truncated
+ */
+static int ffmt_put(char *buffer, int length, const char *text, int count)
+{
+    int copy = count;
+
+    if (length <= 0)
+    {
+        return(count);
+    }
+
+    if (copy >= length)
+    {
+        copy = length - 1;
+    }
+
+    memcpy(buffer, text, copy);
+    buffer[copy] = 0;
+
+    return(count);
+}
@@ -0,0 +1,24 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef FIXED_FORMAT_H
+#define FIXED_FORMAT_H
+
+#include <stdint.h>
+
+#define FFMT_NUMBER_MAX     (24)        // longest number any formatter writes, including sign, point and nul
+#define FFMT_TIMESTAMP_MAX  (20)        // "YYYY-MM-DD HH:MM:SS" including nul
+#define FFMT_DECIMALS_MAX   (9)         // further decimals are ignored
+
+// like snprintf: output is truncated to fit and always nul terminated, return value is the length of the complete text
+int ffmt_int(char *buffer, int length, int32_t value);
+int ffmt_uint(char *buffer, int length, uint32_t value);
+int ffmt_uint64(char *buffer, int length, uint64_t value);
+int ffmt_fixed(char *buffer, int length, int32_t value, int decimals, char positive_sign);
+int ffmt_ipv4(char *buffer, int length, uint32_t address);
+int ffmt_timestamp(char *buffer, int length, int year, int month, int day, int hour, int minute, int second, char separator);
+int ffmt_utc_offset(char *buffer, int length, int minutes);
+
+#endif
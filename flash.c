@@ -25,6 +25,9 @@
 
 extern NON_VOL_VARIABLES_T config;
 
+// the configuration is programmed in whole pages into the last sector, the store and forward sectors are below it
+_Static_assert(((sizeof(NON_VOL_VARIABLES_T)+255)/256)*256 <= FLASH_SECTOR_SIZE, "configuration does not fit in its flash sector");
+
 
 /*!
  * \brief Copy configuration from flash to RAM
@@ -0,0 +1,81 @@
+// generated by makessihash.py from the SSI_TAGS list in ssi.c -- do not edit
+#ifndef SSI_HASH_H
+#define SSI_HASH_H
+
+#define SSI_HASH_TAG_COUNT (606)
+#define SSI_HASH_BUCKETS   (152)
+
+static const uint16_t ssi_hash_displacement[SSI_HASH_BUCKETS] =
+{
+        1,    28,     6,   193,    25,    14,    32,    57,    29,    23,    11,    94,
+        3,    50,     7,     1,   117,    97,    17,   111,   211,     3,    10,     1,
+       12,     2,     5,     2,   128,   326,    41,   152,    14,    26,     2,     9,
+        5,    76,    11,     1,     4,     1,    44,     4,     6,    22,    27,    46,
+        0,     2,   179,     6,    83,    25,     5,    41,    29,    38,    20,    46,
+       33,   164,     2,    50,   183,     1,     1,     2,     4,     5,   325,   216,
+       20,     9,     0,   425,   256,   136,     2,     1,    51,   150,   114,     1,
+      430,    61,   686,     6,    69,   293,     1,   409,     4,   275,   367,    27,
+       28,    16,    22,     2,    17,     1,   527,    45,    77,   367,  1395,    58,
+       85,   946,   596,   118,     1,    18,   164,  1309,    25,    47,     5,     3,
+       14,    45,   807,    36,     1,    32,    78,    64,   708,     1,    10,    46,
+     1395,    24,   382,   820,   249,    53,     4,   236,    98,   240,   178,   178,
+        8,     1,  1062,   197,  2699,  1294,   134,  2619,
+};
+
+// slot to index into ssi_tags[]
+static const uint16_t ssi_hash_slot[SSI_HASH_TAG_COUNT] =
+{
+       73,   141,   210,   439,    68,   190,   490,   578,   118,   524,   329,   462,
+       51,   277,    42,    56,   206,   600,   411,   493,   271,   249,   304,   504,
+      169,    82,    76,   359,   494,   575,   370,   219,   562,   414,   426,   181,
+        1,   163,    90,   481,   229,   364,   565,   482,   283,   144,    29,   102,
+       61,   179,   419,    43,   314,   491,   598,   263,   387,   389,   409,   325,
+      514,   106,   429,   341,   352,    93,   368,   596,   559,   455,    53,    17,
+      273,   471,   145,   520,   542,   100,   186,   226,   297,   472,   384,   197,
+      191,   315,    75,   459,   452,   320,   526,   309,   548,   171,   299,   422,
+      342,   374,   136,   586,     8,     9,   569,   224,    72,   132,   365,   531,
+      233,    98,   413,    65,   404,   184,   318,    77,   509,   270,   305,   126,
+      572,    22,   195,   566,   580,    39,   553,   142,   372,   447,    40,   335,
+      196,   125,   332,   468,    80,   198,   202,    20,    99,   363,   541,   230,
+      245,    92,   137,   427,   152,   421,   322,   513,   416,   311,    71,   117,
+      282,   256,   124,   110,   437,   216,   334,   349,   441,   543,   475,   428,
+       44,   175,   590,   373,   235,   166,   394,    46,   353,   237,   200,   549,
+      284,    26,   187,   570,   156,   594,   508,   160,   234,   120,   259,   173,
+      290,   527,   140,   512,   546,   188,   350,   511,   492,   129,    57,   510,
+       37,    13,   379,   331,   296,   403,   293,    25,   474,    23,   135,   319,
+      397,   451,   254,   302,   536,   567,   199,   260,   289,   380,   487,   112,
+      604,   355,   516,   476,   382,    78,   149,   602,   203,   133,   585,   519,
+      306,   295,   434,   448,   356,   377,     6,   265,   507,   402,   503,   573,
+      407,    88,   119,   418,    35,   595,   591,   128,   278,   489,    83,     5,
+      445,   205,   257,   218,   275,   281,    70,    10,   298,   449,   147,   243,
+      529,   538,   555,   214,   366,   521,   262,   154,   155,   131,    67,   408,
+      157,   158,   378,   381,   344,   220,   354,   240,     0,   579,   207,   143,
+       36,   401,   477,   535,   348,    66,   227,    34,   287,   176,   123,   480,
+      576,   522,   268,   261,   399,    11,   316,     7,   185,   153,   454,   121,
+      564,   424,   588,   183,   228,   180,   539,   530,   213,   167,   339,   554,
+       33,   208,   333,   362,   450,   515,   236,   222,   286,   436,   528,   383,
+      182,   497,   369,   533,   470,    12,   107,   390,   587,   582,   225,   417,
+      264,    14,   532,   506,   324,   525,   605,   346,    16,   467,    91,   547,
+      479,   461,   276,   201,   358,   360,   589,   103,    81,   400,   307,   465,
+      552,   330,   432,   215,   244,    31,   577,   172,   488,   159,   321,    50,
+      340,   238,   597,   435,   108,     2,   114,   151,   440,    60,   345,   505,
+      371,   537,   313,   473,   122,   248,   280,   310,   312,     3,   266,   274,
+       48,   113,   518,    97,    52,   375,    38,    18,   458,    41,   327,   425,
+      217,   194,   343,     4,   540,   211,   431,    49,   485,    27,    74,   396,
+      376,   269,   601,    59,   584,   251,   443,   272,   483,   486,   291,    95,
+      460,    62,    87,   444,   557,   258,   500,   164,   517,   544,   209,   581,
+      138,   317,    28,   130,   212,   410,    19,   127,   288,   170,   192,    69,
+      545,    55,   464,   328,   395,   323,   303,   104,   438,   523,    32,   178,
+      398,   168,    84,   308,    15,   405,   558,    54,   415,    86,   111,   469,
+      292,   442,   392,   347,   423,   146,   148,   255,   247,   420,   430,   105,
+      242,   502,   301,   241,   560,   239,   463,   165,   534,   134,   592,    85,
+      189,   498,   174,   161,    21,   412,   300,   221,   367,    79,   357,   561,
+      571,   279,    58,   583,   267,   501,   599,   457,    64,   231,   393,   391,
+      388,   326,   456,    30,   162,   568,   385,   252,   495,    45,   223,   204,
+      484,    89,   563,   593,   246,   556,   253,   250,    63,    96,   574,   193,
+      603,   551,   139,   338,   285,   115,   478,   499,   109,   232,   466,   496,
+      351,    94,   150,   406,   116,   294,   337,    47,   361,   336,   177,   453,
+      550,   446,   433,   101,    24,   386,
+};
+
+#endif
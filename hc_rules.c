@@ -0,0 +1,1093 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "fixed_format.h"
+#include "hc_rules.h"
+
+/*
+ * Home controller rules
+ *
+ * Rules are written one per line (or separated by ';') as conditions and-ed together, an optional hold time and an
+ * action, with # starting a comment, e.g.
+ *
+ *   gust > 12.5 for 30 -> relay 192.168.1.20:0 off
+ *   grid == down and battery < 30 -> setpoint -2.0
+ *   relay 192.168.1.21:0 == on and power 192.168.1.21:0 > 1500 for 600 -> relay 192.168.1.21:0 off
+ *
+ * Inputs are wind, gust, anemometer (m/s), temperature (C), rain_day, rain_week (mm over seven days), grid (up or
+ * down), battery (%) and, followed by a shelly address:channel, relay and input (on or off) and power (W).  Comparisons
+ * are < <= > >= == !=, values have at most one decimal place, and "for" gives a hold time in seconds.  Actions are
+ * relay address:channel on|off and, in builds with the thermostat (INCORPORATE_THERMOSTAT), setpoint <offset> in the
+ * thermostat's units.  Grid and battery are read from the powerwall, which the home controller polls while a loaded
+ * rule tests them.
+ *
+ * hc_rules_compile() turns the text into a compact byte code that is kept in config, and hc_rules_load() decodes that
+ * into a table in ram with, for each input, a mask of the rules that test it.  Reporting a new value for an input
+ * with hc_rules_update() evaluates only the rules in its mask, and only if the value differs from the last one, so an
+ * unchanged reading costs a table lookup.  A rule acts once when its conditions become true (after its hold time,
+ * which hc_rules_tick() times out) and again only after they have been false.
+ *
+ * Byte code, one entry per rule and a zero length after the last:
+ *   length, hold seconds (2 bytes), action, action arguments, then the conditions: input, op, value (4 bytes) and
+ *   for shelly inputs the device address (4 bytes) and channel.  Multi-byte values are big endian.
+ */
+
+// NB: this file must not depend on the pico sdk or FreeRTOS so that rules can be tried against recorded inputs by hc_rules_sim
+
+#define HC_TOKEN_MAX            (24)
+#define HC_RULE_HEADER          (4)
+#define HC_RULE_CODE_MAX        (HC_RULE_HEADER + 6 + HC_RULE_CONDITIONS*11)
+#define HC_HOLD_MAX_S           (65535)
+
+typedef enum
+{
+    HC_TOKEN_END = 0,
+    HC_TOKEN_SEPARATOR,
+    HC_TOKEN_ARROW,
+    HC_TOKEN_OP,
+    HC_TOKEN_WORD
+} HC_TOKEN_T;
+
+typedef struct
+{
+    const char *name;
+    bool tenths;                // value has one decimal place, else an integer or state word
+    bool device;                // followed by a shelly address and channel
+    const char *states[2];      // words for 0 and 1, or NULL
+} HC_INPUT_INFO_T;
+
+typedef struct
+{
+    const char *name;
+    int32_t value;
+} HC_STATE_WORD_T;
+
+// prototypes
+static int hc_rules_parse(const char **text, HC_RULE_T *rule, char *error, int error_size);
+static HC_TOKEN_T hc_rules_token(const char **text, char *token);
+static int hc_rules_value(const char *token, bool tenths, int32_t *value);
+static int hc_rules_address(const char *token, uint32_t *device, uint8_t *channel);
+static int hc_rules_encode(const HC_RULE_T *rule, uint8_t *code, int code_size);
+static int hc_rules_decode(const uint8_t *code, int length, HC_RULE_T *rule);
+static uint32_t hc_rules_evaluate(HC_RULES_T *rules, int index, uint32_t now_ms);
+static bool hc_rules_compare(int32_t current, HC_OP_T op, int32_t threshold);
+static int hc_rules_put(char *text, int size, int used, const char *append);
+static int hc_rules_put_value(char *text, int size, int used, int32_t value, bool tenths);
+static int hc_rules_put_address(char *text, int size, int used, uint32_t device, int channel);
+static void hc_rules_put_be(uint8_t *code, uint32_t value, int bytes);
+static uint32_t hc_rules_get_be(const uint8_t *code, int bytes);
+
+// static variables
+static const HC_INPUT_INFO_T hc_inputs[NUM_HC_INPUTS] =
+{
+    [HC_INPUT_NONE]         = {"",              false,  false,  {NULL, NULL}},
+    [HC_INPUT_WIND]         = {"wind",          true,   false,  {NULL, NULL}},
+    [HC_INPUT_GUST]         = {"gust",          true,   false,  {NULL, NULL}},
+    [HC_INPUT_ANEMOMETER]   = {"anemometer",    true,   false,  {NULL, NULL}},
+    [HC_INPUT_TEMPERATURE]  = {"temperature",   true,   false,  {NULL, NULL}},
+    [HC_INPUT_RAIN_DAY]     = {"rain_day",      true,   false,  {NULL, NULL}},
+    [HC_INPUT_RAIN_WEEK]    = {"rain_week",     true,   false,  {NULL, NULL}},
+    [HC_INPUT_GRID]         = {"grid",          false,  false,  {"down", "up"}},
+    [HC_INPUT_BATTERY]      = {"battery",       false,  false,  {NULL, NULL}},
+    [HC_INPUT_RELAY]        = {"relay",         false,  true,   {"off", "on"}},
+    [HC_INPUT_SWITCH]       = {"input",         false,  true,   {"off", "on"}},
+    [HC_INPUT_POWER]        = {"power",         true,   true,   {NULL, NULL}},
+};
+
+static const char *hc_ops[NUM_HC_OPS] = {"<", "<=", ">", ">=", "==", "!="};
+
+static const HC_STATE_WORD_T hc_state_words[] = {{"on", 1}, {"off", 0}, {"up", 1}, {"down", 0}, {"true", 1}, {"false", 0}};
+
+
+/*!
+ * \brief Compile rules written as text into byte code
+ *
+ * \param[in]   text        rules, one per line or separated by ';'
+ * \param[out]  code        receives the byte code
+ * \param[in]   code_size   size of code, HC_RULES_CODE_SIZE for config
+ * \param[out]  error       receives a description of the first error
+ * \param[in]   error_size  size of error
+ *
+ * \return number of rules compiled, or -1 on error
+ */
+int hc_rules_compile(const char *text, uint8_t *code, int code_size, char *error, int error_size)
+{
+    HC_RULE_T rule;
+    int used = 0;
+    int num_rules = 0;
+    int length;
+    int parsed;
+
+    error[0] = 0;
+
+    while ((parsed = hc_rules_parse(&text, &rule, error, error_size)) > 0)
+    {
+        if (num_rules >= HC_RULES_MAX)
+        {
+            snprintf(error, error_size, "more than %d rules", HC_RULES_MAX);
+            return(-1);
+        }
+
+        // keep room for the terminator
+        length = hc_rules_encode(&rule, code + used, code_size - used - 1);
+        if (length < 0)
+        {
+            snprintf(error, error_size, "rule %d does not fit in %d bytes", num_rules + 1, code_size);
+            return(-1);
+        }
+
+        used += length;
+        num_rules++;
+    }
+
+    if (parsed < 0)
+    {
+        return(-1);
+    }
+
+    if (code_size > used)
+    {
+        memset(code + used, 0, code_size - used);
+    }
+
+    return(num_rules);
+}
+
+/*!
+ * \brief Replace, add or delete one rule in compiled code
+ *
+ * \param[in,out]  code        byte code from hc_rules_compile
+ * \param[in]      code_size   size of code
+ * \param[in]      index       rule to replace, the number of rules to add one
+ * \param[in]      text        the rule, empty to delete it
+ * \param[out]     error       receives a description of an error
+ * \param[in]      error_size  size of error
+ *
+ * \return number of rules now in code, or -1 on error (code is unchanged)
+ */
+int hc_rules_edit(uint8_t *code, int code_size, int index, const char *text, char *error, int error_size)
+{
+    uint8_t rule[HC_RULE_CODE_MAX + 1];
+    int num_rules = 0;
+    int offset = 0;
+    int used;
+    int old_length = 0;
+    int new_length = 0;
+    int compiled;
+
+    compiled = hc_rules_compile(text, rule, sizeof(rule), error, error_size);
+    if (compiled < 0)
+    {
+        return(-1);
+    }
+    if (compiled > 1)
+    {
+        snprintf(error, error_size, "one rule at a time");
+        return(-1);
+    }
+    if (compiled)
+    {
+        new_length = rule[0];
+    }
+
+    // find the rule and the end of the code
+    for(used=0; (used < code_size) && code[used]; used += code[used])
+    {
+        if (num_rules++ == index)
+        {
+            offset = used;
+            old_length = code[used];
+        }
+    }
+    if ((index < 0) || (index > num_rules) || (used >= code_size))
+    {
+        snprintf(error, error_size, "no rule %d", index);
+        return(-1);
+    }
+    if (index == num_rules)
+    {
+        offset = used;
+    }
+    else
+    {
+        num_rules--;
+    }
+
+    // keep room for the terminator
+    if (used - old_length + new_length >= code_size)
+    {
+        snprintf(error, error_size, "rules do not fit in %d bytes", code_size);
+        return(-1);
+    }
+
+    memmove(code + offset + new_length, code + offset + old_length, used - offset - old_length);
+    memcpy(code + offset, rule, new_length);
+    used += new_length - old_length;
+    memset(code + used, 0, code_size - used);
+
+    return(num_rules + compiled);
+}
+
+/*!
+ * \brief Decode one rule without loading them all
+ *
+ * \param[in]   code        byte code from hc_rules_compile
+ * \param[in]   code_size   size of code
+ * \param[in]   index       rule wanted
+ * \param[out]  rule        decoded rule with its state reset
+ *
+ * \return 0 on success, -1 if there is no such rule or it is malformed
+ */
+int hc_rules_get(const uint8_t *code, int code_size, int index, HC_RULE_T *rule)
+{
+    int offset = 0;
+
+    while ((offset < code_size) && code[offset] && (offset + code[offset] <= code_size))
+    {
+        if (!index--)
+        {
+            return(hc_rules_decode(code + offset, code[offset], rule));
+        }
+        offset += code[offset];
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Decode the byte code and reset the state of every rule
+ *
+ * \param[out]  rules       rule table
+ * \param[in]   code        byte code from hc_rules_compile
+ * \param[in]   code_size   size of code
+ *
+ * \return number of rules loaded, or -1 if the code is malformed (no rules are loaded)
+ */
+int hc_rules_load(HC_RULES_T *rules, const uint8_t *code, int code_size)
+{
+    HC_RULE_T *rule;
+    int offset = 0;
+    int i;
+
+    memset(rules, 0, sizeof(*rules));
+
+    while ((offset < code_size) && code[offset])
+    {
+        if ((rules->num_rules >= HC_RULES_MAX) || (offset + code[offset] > code_size) ||
+            hc_rules_decode(code + offset, code[offset], &rules->rule[rules->num_rules]))
+        {
+            memset(rules, 0, sizeof(*rules));
+            return(-1);
+        }
+
+        offset += code[offset];
+        rules->num_rules++;
+    }
+
+    for(i=0; i<rules->num_rules; i++)
+    {
+        rule = &rules->rule[i];
+        for(int c=0; c<rule->num_conditions; c++)
+        {
+            rules->depends[rule->condition[c].input] |= 1UL << i;
+        }
+    }
+
+    return(rules->num_rules);
+}
+
+/*!
+ * \brief Write a rule out as text, the form hc_rules_compile accepts
+ *
+ * \param[in]   rule    rule
+ * \param[out]  text    receives the rule
+ * \param[in]   size    size of text, HC_RULES_TEXT_MAX is always enough
+ *
+ * \return length of the text
+ */
+int hc_rules_format(const HC_RULE_T *rule, char *text, int size)
+{
+    const HC_CONDITION_T *condition;
+    const HC_INPUT_INFO_T *info;
+    char number[12];
+    int used = 0;
+    int c;
+
+    text[0] = 0;
+
+    for(c=0; c<rule->num_conditions; c++)
+    {
+        condition = &rule->condition[c];
+        info = &hc_inputs[condition->input];
+
+        if (c)
+        {
+            used = hc_rules_put(text, size, used, " and ");
+        }
+        used = hc_rules_put(text, size, used, info->name);
+        if (info->device)
+        {
+            used = hc_rules_put(text, size, used, " ");
+            used = hc_rules_put_address(text, size, used, condition->device, condition->channel);
+        }
+        used = hc_rules_put(text, size, used, " ");
+        used = hc_rules_put(text, size, used, hc_ops[condition->op]);
+        used = hc_rules_put(text, size, used, " ");
+        if (info->states[0] && ((condition->value == 0) || (condition->value == 1)))
+        {
+            used = hc_rules_put(text, size, used, info->states[condition->value]);
+        }
+        else
+        {
+            used = hc_rules_put_value(text, size, used, condition->value, info->tenths);
+        }
+    }
+
+    if (rule->hold_ms)
+    {
+        ffmt_uint(number, sizeof(number), rule->hold_ms / 1000);
+        used = hc_rules_put(text, size, used, " for ");
+        used = hc_rules_put(text, size, used, number);
+    }
+
+    switch(rule->action)
+    {
+    case HC_ACTION_RELAY:
+        used = hc_rules_put(text, size, used, " -> relay ");
+        used = hc_rules_put_address(text, size, used, rule->device, rule->channel);
+        used = hc_rules_put(text, size, used, rule->value ? " on" : " off");
+        break;
+    case HC_ACTION_SETPOINT:
+        used = hc_rules_put(text, size, used, " -> setpoint ");
+        used = hc_rules_put_value(text, size, used, rule->value, true);
+        break;
+    }
+
+    return(used);
+}
+
+/*!
+ * \brief Report the value of an input and evaluate the rules that test it
+ *
+ * \param[in,out]  rules       rule table
+ * \param[in]      input       input that was read
+ * \param[in]      device      shelly address for device inputs, host byte order, else 0
+ * \param[in]      channel     shelly channel for device inputs, else 0
+ * \param[in]      value       current value
+ * \param[in]      now_ms      millisecond clock, may wrap
+ *
+ * \return mask of rules whose action should be taken now
+ */
+uint32_t hc_rules_update(HC_RULES_T *rules, HC_INPUT_T input, uint32_t device, int channel, int32_t value, uint32_t now_ms)
+{
+    HC_RULE_T *rule;
+    HC_CONDITION_T *condition;
+    uint32_t candidates;
+    uint32_t changed = 0;
+    uint32_t fired = 0;
+    int i;
+    int c;
+
+    if ((input <= HC_INPUT_NONE) || (input >= NUM_HC_INPUTS))
+    {
+        return(0);
+    }
+
+    // only the rules that test this input
+    for(candidates = rules->depends[input]; candidates; candidates &= candidates - 1)
+    {
+        i = __builtin_ctz(candidates);
+        rule = &rules->rule[i];
+
+        for(c=0; c<rule->num_conditions; c++)
+        {
+            condition = &rule->condition[c];
+            if ((condition->input == input) && (condition->device == device) && (condition->channel == channel) &&
+                (!(rule->known & (1 << c)) || (rule->current[c] != value)))
+            {
+                rule->current[c] = value;
+                rule->known |= 1 << c;
+                changed |= 1UL << i;
+            }
+        }
+    }
+
+    for(; changed; changed &= changed - 1)
+    {
+        fired |= hc_rules_evaluate(rules, __builtin_ctz(changed), now_ms);
+    }
+
+    return(fired);
+}
+
+/*!
+ * \brief Act on rules whose hold time has run out
+ *
+ * \param[in,out]  rules       rule table
+ * \param[in]      now_ms      millisecond clock, may wrap
+ * \param[out]     wait_ms     time until the next hold runs out, UINT32_MAX if none, may be NULL
+ *
+ * \return mask of rules whose action should be taken now
+ */
+uint32_t hc_rules_tick(HC_RULES_T *rules, uint32_t now_ms, uint32_t *wait_ms)
+{
+    HC_RULE_T *rule;
+    uint32_t holding;
+    uint32_t fired = 0;
+    uint32_t wait = UINT32_MAX;
+    uint32_t elapsed;
+    int i;
+
+    for(holding = rules->holding; holding; holding &= holding - 1)
+    {
+        i = __builtin_ctz(holding);
+        rule = &rules->rule[i];
+        elapsed = now_ms - rule->since_ms;
+
+        if (elapsed >= rule->hold_ms)
+        {
+            rules->holding &= ~(1UL << i);
+            rules->fired |= 1UL << i;
+            fired |= 1UL << i;
+        }
+        else if (rule->hold_ms - elapsed < wait)
+        {
+            wait = rule->hold_ms - elapsed;
+        }
+    }
+
+    if (wait_ms)
+    {
+        *wait_ms = wait;
+    }
+
+    return(fired);
+}
+
+/*!
+ * \brief Name of an input as written in rules
+ *
+ * \param[in]  input   input
+ *
+ * \return name, empty if the input is not valid
+ */
+const char *hc_rules_input_name(HC_INPUT_T input)
+{
+    if ((input <= HC_INPUT_NONE) || (input >= NUM_HC_INPUTS))
+    {
+        input = HC_INPUT_NONE;
+    }
+
+    return(hc_inputs[input].name);
+}
+
+/*!
+ * \brief Parse the next rule
+ *
+ * \param[in,out]  text        rules, advanced past the rule
+ * \param[out]     rule        parsed rule
+ * \param[out]     error       receives a description of an error
+ * \param[in]      error_size  size of error
+ *
+ * \return 1 if a rule was parsed, 0 at the end of the text, -1 on error
+ */
+static int hc_rules_parse(const char **text, HC_RULE_T *rule, char *error, int error_size)
+{
+    HC_CONDITION_T *condition;
+    HC_TOKEN_T type;
+    char token[HC_TOKEN_MAX];
+    int32_t value;
+    int input;
+    int op;
+
+    memset(rule, 0, sizeof(*rule));
+
+    // skip empty lines
+    while ((type = hc_rules_token(text, token)) == HC_TOKEN_SEPARATOR)
+    {
+    }
+    if (type == HC_TOKEN_END)
+    {
+        return(0);
+    }
+
+    // conditions
+    for (;;)
+    {
+        for(input=HC_INPUT_NONE+1; (input<NUM_HC_INPUTS) && strcasecmp(token, hc_inputs[input].name); input++)
+        {
+        }
+        if ((type != HC_TOKEN_WORD) || (input == NUM_HC_INPUTS))
+        {
+            snprintf(error, error_size, "unknown input '%s'", token);
+            return(-1);
+        }
+        if (rule->num_conditions >= HC_RULE_CONDITIONS)
+        {
+            snprintf(error, error_size, "more than %d conditions", HC_RULE_CONDITIONS);
+            return(-1);
+        }
+        condition = &rule->condition[rule->num_conditions++];
+        condition->input = (uint8_t)input;
+
+        if (hc_inputs[input].device &&
+            ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_address(token, &condition->device, &condition->channel)))
+        {
+            snprintf(error, error_size, "%s needs address:channel, not '%s'", hc_inputs[input].name, token);
+            return(-1);
+        }
+
+        type = hc_rules_token(text, token);
+        for(op=0; (op<NUM_HC_OPS) && strcmp(token, hc_ops[op]); op++)
+        {
+        }
+        if ((type != HC_TOKEN_OP) || (op == NUM_HC_OPS))
+        {
+            snprintf(error, error_size, "unknown comparison '%s'", token);
+            return(-1);
+        }
+        condition->op = (uint8_t)op;
+
+        if ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_value(token, hc_inputs[input].tenths, &condition->value))
+        {
+            snprintf(error, error_size, "bad value '%s' for %s", token, hc_inputs[input].name);
+            return(-1);
+        }
+
+        type = hc_rules_token(text, token);
+        if ((type != HC_TOKEN_WORD) || strcasecmp(token, "and"))
+        {
+            break;
+        }
+        type = hc_rules_token(text, token);
+    }
+
+    // hold time
+    if ((type == HC_TOKEN_WORD) && !strcasecmp(token, "for"))
+    {
+        if ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_value(token, false, &value) || (value < 0) || (value > HC_HOLD_MAX_S))
+        {
+            snprintf(error, error_size, "bad hold time '%s'", token);
+            return(-1);
+        }
+        rule->hold_ms = (uint32_t)value * 1000;
+        type = hc_rules_token(text, token);
+    }
+
+    // action
+    if (type != HC_TOKEN_ARROW)
+    {
+        snprintf(error, error_size, "expected '->' not '%s'", token);
+        return(-1);
+    }
+
+    type = hc_rules_token(text, token);
+    if ((type == HC_TOKEN_WORD) && !strcasecmp(token, "relay"))
+    {
+        rule->action = HC_ACTION_RELAY;
+        if ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_address(token, &rule->device, &rule->channel))
+        {
+            snprintf(error, error_size, "relay needs address:channel, not '%s'", token);
+            return(-1);
+        }
+        if ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_value(token, false, &rule->value) || (rule->value & ~1))
+        {
+            snprintf(error, error_size, "relay needs on or off, not '%s'", token);
+            return(-1);
+        }
+    }
+    else if ((type == HC_TOKEN_WORD) && !strcasecmp(token, "setpoint"))
+    {
+#ifdef INCORPORATE_THERMOSTAT
+        rule->action = HC_ACTION_SETPOINT;
+        if ((hc_rules_token(text, token) != HC_TOKEN_WORD) || hc_rules_value(token, true, &rule->value) ||
+            (rule->value < INT16_MIN) || (rule->value > INT16_MAX))
+        {
+            snprintf(error, error_size, "bad setpoint offset '%s'", token);
+            return(-1);
+        }
+#else
+        // there is no thermostat to act on it
+        snprintf(error, error_size, "setpoint needs the thermostat");
+        return(-1);
+#endif
+    }
+    else
+    {
+        snprintf(error, error_size, "unknown action '%s'", token);
+        return(-1);
+    }
+
+    type = hc_rules_token(text, token);
+    if ((type != HC_TOKEN_SEPARATOR) && (type != HC_TOKEN_END))
+    {
+        snprintf(error, error_size, "unexpected '%s' after action", token);
+        return(-1);
+    }
+
+    return(1);
+}
+
+/*!
+ * \brief Read the next token
+ *
+ * \param[in,out]  text    advanced past the token
+ * \param[out]     token   receives the token text, truncated to HC_TOKEN_MAX
+ *
+ * \return type of token
+ */
+static HC_TOKEN_T hc_rules_token(const char **text, char *token)
+{
+    const char *p = *text;
+    HC_TOKEN_T type;
+    int length = 0;
+
+    while ((*p == ' ') || (*p == '\t') || (*p == '\r'))
+    {
+        p++;
+    }
+
+    // comment to the end of the line
+    if (*p == '#')
+    {
+        p += strcspn(p, "\n");
+    }
+
+    if (!*p)
+    {
+        type = HC_TOKEN_END;
+    }
+    else if ((*p == '\n') || (*p == ';'))
+    {
+        token[length++] = *p++;
+        type = HC_TOKEN_SEPARATOR;
+    }
+    else if ((p[0] == '-') && (p[1] == '>'))
+    {
+        token[length++] = *p++;
+        token[length++] = *p++;
+        type = HC_TOKEN_ARROW;
+    }
+    else if (strchr("<>=!", *p))
+    {
+        while (*p && strchr("<>=!", *p))
+        {
+            if (length < HC_TOKEN_MAX - 1)
+            {
+                token[length++] = *p;
+            }
+            p++;
+        }
+        type = HC_TOKEN_OP;
+    }
+    else
+    {
+        while (*p && !strchr(" \t\r\n;<>=!", *p) && !((p[0] == '-') && (p[1] == '>')))
+        {
+            if (length < HC_TOKEN_MAX - 1)
+            {
+                token[length++] = *p;
+            }
+            p++;
+        }
+        type = HC_TOKEN_WORD;
+    }
+
+    token[length] = 0;
+    *text = p;
+
+    return(type);
+}
+
+/*!
+ * \brief Convert a number or state word
+ *
+ * \param[in]   token   e.g. "12.5", "-2", "on" or "down"
+ * \param[in]   tenths  number has up to one decimal place and is returned x 10
+ * \param[out]  value   converted value
+ *
+ * \return 0 on success, -1 if the token is not a valid value
+ */
+static int hc_rules_value(const char *token, bool tenths, int32_t *value)
+{
+    const char *p = token;
+    int64_t number = 0;
+    bool negative = false;
+    int i;
+
+    for(i=0; i<(int)(sizeof(hc_state_words)/sizeof(hc_state_words[0])); i++)
+    {
+        if (!tenths && !strcasecmp(token, hc_state_words[i].name))
+        {
+            *value = hc_state_words[i].value;
+            return(0);
+        }
+    }
+
+    if (*p == '-')
+    {
+        negative = true;
+        p++;
+    }
+
+    if ((*p < '0') || (*p > '9'))
+    {
+        return(-1);
+    }
+
+    while ((*p >= '0') && (*p <= '9') && (number < INT32_MAX))
+    {
+        number = number*10 + (*p++ - '0');
+    }
+
+    if (tenths)
+    {
+        number *= 10;
+        if (*p == '.')
+        {
+            p++;
+            if ((*p >= '0') && (*p <= '9'))
+            {
+                number += *p++ - '0';
+            }
+        }
+    }
+
+    if (*p || (number > INT32_MAX))
+    {
+        return(-1);
+    }
+
+    *value = (int32_t)(negative ? -number : number);
+
+    return(0);
+}
+
+/*!
+ * \brief Convert a shelly address and channel, e.g. 192.168.1.20:0
+ *
+ * \param[in]   token   address text
+ * \param[out]  device  address, host byte order
+ * \param[out]  channel channel
+ *
+ * \return 0 on success, -1 if the address is invalid
+ */
+static int hc_rules_address(const char *token, uint32_t *device, uint8_t *channel)
+{
+    unsigned int octet[4];
+    unsigned int number;
+    int consumed = 0;
+
+    if ((sscanf(token, "%u.%u.%u.%u:%u%n", &octet[0], &octet[1], &octet[2], &octet[3], &number, &consumed) != 5) ||
+        token[consumed] || (octet[0] > 255) || (octet[1] > 255) || (octet[2] > 255) || (octet[3] > 255) || (number > 7))
+    {
+        return(-1);
+    }
+
+    *device = (octet[0] << 24) | (octet[1] << 16) | (octet[2] << 8) | octet[3];
+    *channel = (uint8_t)number;
+
+    return(0);
+}
+
+/*!
+ * \brief Write a rule as byte code
+ *
+ * \param[in]   rule        rule
+ * \param[out]  code        receives the byte code
+ * \param[in]   code_size   space available
+ *
+ * \return bytes written, or -1 if the rule does not fit
+ */
+static int hc_rules_encode(const HC_RULE_T *rule, uint8_t *code, int code_size)
+{
+    uint8_t buffer[HC_RULE_CODE_MAX];
+    const HC_CONDITION_T *condition;
+    int length = HC_RULE_HEADER;
+    int c;
+
+    hc_rules_put_be(&buffer[1], rule->hold_ms / 1000, 2);
+    buffer[3] = rule->action;
+
+    switch(rule->action)
+    {
+    case HC_ACTION_RELAY:
+        hc_rules_put_be(&buffer[length], rule->device, 4);
+        buffer[length + 4] = rule->channel;
+        buffer[length + 5] = (uint8_t)rule->value;
+        length += 6;
+        break;
+    case HC_ACTION_SETPOINT:
+        hc_rules_put_be(&buffer[length], (uint32_t)rule->value, 2);
+        length += 2;
+        break;
+    }
+
+    for(c=0; c<rule->num_conditions; c++)
+    {
+        condition = &rule->condition[c];
+        buffer[length++] = condition->input;
+        buffer[length++] = condition->op;
+        hc_rules_put_be(&buffer[length], (uint32_t)condition->value, 4);
+        length += 4;
+        if (hc_inputs[condition->input].device)
+        {
+            hc_rules_put_be(&buffer[length], condition->device, 4);
+            buffer[length + 4] = condition->channel;
+            length += 5;
+        }
+    }
+    buffer[0] = (uint8_t)length;
+
+    if (length > code_size)
+    {
+        return(-1);
+    }
+    memcpy(code, buffer, length);
+
+    return(length);
+}
+
+/*!
+ * \brief Read one rule of byte code
+ *
+ * \param[in]   code    start of the rule
+ * \param[in]   length  length of the rule
+ * \param[out]  rule    decoded rule with its state reset
+ *
+ * \return 0 on success, -1 if the rule is malformed
+ */
+static int hc_rules_decode(const uint8_t *code, int length, HC_RULE_T *rule)
+{
+    HC_CONDITION_T *condition;
+    int offset = HC_RULE_HEADER;
+
+    memset(rule, 0, sizeof(*rule));
+
+    if (length < HC_RULE_HEADER)
+    {
+        return(-1);
+    }
+
+    rule->hold_ms = hc_rules_get_be(&code[1], 2) * 1000;
+    rule->action = code[3];
+
+    switch(rule->action)
+    {
+    case HC_ACTION_RELAY:
+        if (offset + 6 > length)
+        {
+            return(-1);
+        }
+        rule->device = hc_rules_get_be(&code[offset], 4);
+        rule->channel = code[offset + 4];
+        rule->value = code[offset + 5];
+        offset += 6;
+        break;
+    case HC_ACTION_SETPOINT:
+        if (offset + 2 > length)
+        {
+            return(-1);
+        }
+        rule->value = (int16_t)hc_rules_get_be(&code[offset], 2);
+        offset += 2;
+        break;
+    default:
+        return(-1);
+    }
+
+    while (offset < length)
+    {
+        if ((rule->num_conditions >= HC_RULE_CONDITIONS) || (offset + 6 > length) ||
+            (code[offset] <= HC_INPUT_NONE) || (code[offset] >= NUM_HC_INPUTS) || (code[offset + 1] >= NUM_HC_OPS))
+        {
+            return(-1);
+        }
+
+        condition = &rule->condition[rule->num_conditions++];
+        condition->input = code[offset];
+        condition->op = code[offset + 1];
+        condition->value = (int32_t)hc_rules_get_be(&code[offset + 2], 4);
+        offset += 6;
+
+        if (hc_inputs[condition->input].device)
+        {
+            if (offset + 5 > length)
+            {
+                return(-1);
+            }
+            condition->device = hc_rules_get_be(&code[offset], 4);
+            condition->channel = code[offset + 4];
+            offset += 5;
+        }
+    }
+
+    return(rule->num_conditions ? 0 : -1);
+}
+
+/*!
+ * \brief Evaluate a rule after one of its inputs changed
+ *
+ * \param[in,out]  rules       rule table
+ * \param[in]      index       rule to evaluate
+ * \param[in]      now_ms      millisecond clock
+ *
+ * \return mask with the rule's bit set if its action should be taken now
+ */
+static uint32_t hc_rules_evaluate(HC_RULES_T *rules, int index, uint32_t now_ms)
+{
+    HC_RULE_T *rule = &rules->rule[index];
+    uint32_t bit = 1UL << index;
+    bool satisfied;
+    int c;
+
+    rules->evaluations++;
+
+    satisfied = (rule->known == (1 << rule->num_conditions) - 1);
+    for(c=0; (c<rule->num_conditions) && satisfied; c++)
+    {
+        satisfied = hc_rules_compare(rule->current[c], (HC_OP_T)rule->condition[c].op, rule->condition[c].value);
+    }
+
+    if (!satisfied)
+    {
+        // re-arm
+        rules->holding &= ~bit;
+        rules->fired &= ~bit;
+        return(0);
+    }
+
+    if ((rules->fired | rules->holding) & bit)
+    {
+        return(0);
+    }
+
+    if (rule->hold_ms)
+    {
+        rule->since_ms = now_ms;
+        rules->holding |= bit;
+        return(0);
+    }
+
+    rules->fired |= bit;
+
+    return(bit);
+}
+
+/*!
+ * \brief Compare an input with a threshold
+ *
+ * \return true if the comparison holds
+ */
+static bool hc_rules_compare(int32_t current, HC_OP_T op, int32_t threshold)
+{
+    switch(op)
+    {
+    case HC_OP_LT:
+        return(current < threshold);
+    case HC_OP_LE:
+        return(current <= threshold);
+    case HC_OP_GT:
+        return(current > threshold);
+    case HC_OP_GE:
+        return(current >= threshold);
+    case HC_OP_EQ:
+        return(current == threshold);
+    case HC_OP_NE:
+        return(current != threshold);
+    default:
+        return(false);
+    }
+}
+
+/*!
+ * \brief Append text, truncating to fit
+ *
+ * \return new length
+ */
+static int hc_rules_put(char *text, int size, int used, const char *append)
+{
+    while (*append && (used < size - 1))
+    {
+        text[used++] = *append++;
+    }
+    text[used] = 0;
+
+    return(used);
+}
+
+/*!
+ * \brief Append a value, in tenths or as an integer
+ *
+ * \return new length
+ */
+static int hc_rules_put_value(char *text, int size, int used, int32_t value, bool tenths)
+{
+    char number[16];
+
+    if (tenths)
+    {
+        ffmt_fixed(number, sizeof(number), value, 1, 0);
+    }
+    else
+    {
+        ffmt_int(number, sizeof(number), value);
+    }
+
+    return(hc_rules_put(text, size, used, number));
+}
+
+/*!
+ * \brief Append address:channel
+ *
+ * \return new length
+ */
+static int hc_rules_put_address(char *text, int size, int used, uint32_t device, int channel)
+{
+    char address[24];
+    int length;
+
+    length = ffmt_ipv4(address, sizeof(address) - 4, device);
+    address[length++] = ':';
+    ffmt_int(address + length, sizeof(address) - length, channel);
+
+    return(hc_rules_put(text, size, used, address));
+}
+
+/*!
+ * \brief Store a big endian value
+ *
+ * \return nothing
+ */
+static void hc_rules_put_be(uint8_t *code, uint32_t value, int bytes)
+{
+    while (bytes--)
+    {
+        code[bytes] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+/*!
+ * \brief Load a big endian value
+ *
+ * \return value
+ */
+static uint32_t hc_rules_get_be(const uint8_t *code, int bytes)
+{
+    uint32_t value = 0;
+
+    while (bytes--)
+    {
+        value = (value << 8) | *code++;
+    }
+
+    return(value);
+}
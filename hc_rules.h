@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef HC_RULES_H
+#define HC_RULES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HC_RULES_CODE_SIZE      (512)       // bytes of compiled rules kept in config
+#define HC_RULES_MAX            (32)        // rules loaded, one bit each in the masks below
+#define HC_RULE_CONDITIONS      (4)         // conditions and-ed together in one rule
+#define HC_RULES_TEXT_MAX       (256)       // longest rule when written out by hc_rules_format
+#define HC_RULES_ERROR_MAX      (64)
+
+// values a rule can test
+typedef enum
+{
+    HC_INPUT_NONE = 0,
+    HC_INPUT_WIND,              // weather station wind speed, m/s x 10
+    HC_INPUT_GUST,              // weather station gust speed, m/s x 10
+    HC_INPUT_ANEMOMETER,        // local or remote anemometer, m/s x 10
+    HC_INPUT_TEMPERATURE,       // outside temperature, C x 10
+    HC_INPUT_RAIN_DAY,          // mm x 10
+    HC_INPUT_RAIN_WEEK,         // trailing seven days, mm x 10
+    HC_INPUT_GRID,              // 1 up, 0 down
+    HC_INPUT_BATTERY,           // powerwall %
+    HC_INPUT_RELAY,             // shelly relay, 1 on, 0 off
+    HC_INPUT_SWITCH,            // shelly input, 1 on, 0 off
+    HC_INPUT_POWER,             // shelly meter, W x 10
+    NUM_HC_INPUTS
+} HC_INPUT_T;
+
+typedef enum
+{
+    HC_OP_LT = 0,
+    HC_OP_LE,
+    HC_OP_GT,
+    HC_OP_GE,
+    HC_OP_EQ,
+    HC_OP_NE,
+    NUM_HC_OPS
+} HC_OP_T;
+
+// what a rule does when its conditions have held long enough
+typedef enum
+{
+    HC_ACTION_NONE = 0,
+    HC_ACTION_RELAY,            // switch a shelly relay on or off
+    HC_ACTION_SETPOINT,         // offset the thermostat setpoint, degrees x 10 in the thermostat's units
+    NUM_HC_ACTIONS
+} HC_ACTION_T;
+
+typedef struct
+{
+    uint32_t device;            // shelly address for device inputs, host byte order, else 0
+    int32_t value;              // threshold
+    uint8_t input;              // HC_INPUT_T
+    uint8_t op;                 // HC_OP_T
+    uint8_t channel;
+} HC_CONDITION_T;
+
+// a rule decoded from config with its evaluation state
+typedef struct
+{
+    HC_CONDITION_T condition[HC_RULE_CONDITIONS];
+    int32_t current[HC_RULE_CONDITIONS];        // latest value of each condition's input
+    uint8_t num_conditions;
+    uint8_t known;                              // bit per condition whose input has been reported
+    uint8_t action;                             // HC_ACTION_T
+    uint8_t channel;
+    uint32_t device;
+    int32_t value;                              // relay state or setpoint offset
+    uint32_t hold_ms;                           // conditions must hold this long before the action is taken
+    uint32_t since_ms;                          // when the conditions last became true
+} HC_RULE_T;
+
+typedef struct
+{
+    HC_RULE_T rule[HC_RULES_MAX];
+    int num_rules;
+    uint32_t depends[NUM_HC_INPUTS];            // rules testing each input
+    uint32_t holding;                           // rules true and waiting out their hold time
+    uint32_t fired;                             // rules that have acted and are still true
+    uint32_t evaluations;                       // rules evaluated, for measuring
+} HC_RULES_T;
+
+int hc_rules_compile(const char *text, uint8_t *code, int code_size, char *error, int error_size);
+int hc_rules_edit(uint8_t *code, int code_size, int index, const char *text, char *error, int error_size);
+int hc_rules_get(const uint8_t *code, int code_size, int index, HC_RULE_T *rule);
+int hc_rules_load(HC_RULES_T *rules, const uint8_t *code, int code_size);
+int hc_rules_format(const HC_RULE_T *rule, char *text, int size);
+uint32_t hc_rules_update(HC_RULES_T *rules, HC_INPUT_T input, uint32_t device, int channel, int32_t value, uint32_t now_ms);
+uint32_t hc_rules_tick(HC_RULES_T *rules, uint32_t now_ms, uint32_t *wait_ms);
+const char *hc_rules_input_name(HC_INPUT_T input);
+
+#endif
@@ -55,26 +55,60 @@
 #include "message.h"
 #include "message_defs.h"
 #include "powerwall.h"
+#include "thermostat.h"
 #include "shelly.h"
+#include "shelly_status.h"
+#include "web_snapshot.h"
+#include "hc_rules.h"
 #include "hc_task.h"
 
 
+/*
+ * Home controller
+ *
+ * Rules compiled into config.hc_rules (see hc_rules.c) are evaluated whenever one of their inputs changes.  The task
+ * sleeps until web_write_end() reports new weather, anemometer or powerwall readings or a shelly device reports a
+ * change, feeds the new values to the rules and takes the actions of any rule that fired, in rule order so a later
+ * rule wins.  Shelly power is not pushed as a change so it is read on every pass while a rule tests it, and the
+ * powerwall is only polled (by powerwall_task) while a rule tests grid or battery.  The time
+ * taken to read the inputs and evaluate the rules is measured on every pass and the worst case kept for the api.
+ */
+
 //#define DEBUG_UDP_MESSAGES
 
 #define FLASH_TARGET_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define HC_WAIT_MS              (1000)          // longest sleep, keeps the watchdog fed
+#define HC_WEATHER_MAX_AGE_US   (600000000)     // weather readings older than this are not fed to the rules
+#define HC_WEB_GROUPS           ((1UL << WEB_GROUP_WIND) | (1UL << WEB_GROUP_WEATHER) | (1UL << WEB_GROUP_POWERWALL))
 
+_Static_assert(sizeof(((NON_VOL_VARIABLES_T *)0)->hc_rules) == HC_RULES_CODE_SIZE, "config.hc_rules must hold HC_RULES_CODE_SIZE bytes");
 
 
 
 
-//prototypes
 
 
+//prototypes
+static void hc_load_rules(void);
+static uint32_t hc_web_changes(uint32_t now_ms);
+static uint32_t hc_shelly_changes(uint32_t now_ms);
+static void hc_take_actions(uint32_t fired);
+
 // external variables
 extern NON_VOL_VARIABLES_T config;
 extern WEB_VARIABLES_T web;
 
 //static variables
+static SHELLY_STATUS_T hc_shelly[SHELLY_STATUS_DEVICES];        // state last acted on
+static int hc_num_shelly = 0;
+static uint32_t hc_shelly_sequence = 0;
+static HC_RULES_T hc_rules;
+static uint8_t hc_rules_code[HC_RULES_CODE_SIZE];              // copy of config.hc_rules being loaded
+static uint32_t hc_epoch[NUM_WEB_GROUPS];                       // web groups as last fed to the rules
+static HC_TASK_RULES_STATUS_T hc_status;
+static volatile bool hc_rules_changed = true;
+static volatile bool hc_powerwall_wanted = false;                // a loaded rule tests grid or battery
+static TaskHandle_t hc_task_handle = NULL;
 
 
 /*!
@@ -88,6 +122,13 @@ void hc_task(__unused void *params)
 {
     SOCKADDR_IN sClientAddress;  
     int received_bytes = 0;    
+    bool shelly_status_started = false;
+    uint32_t wait_ms = HC_WAIT_MS;
+    uint32_t now_ms;
+    uint32_t start_us;
+    uint32_t elapsed_us;
+    uint32_t evaluations;
+    uint32_t fired;
     
     if (strcasecmp(APP_NAME, "Home_Controller") == 0)
     {
@@ -100,12 +141,54 @@ void hc_task(__unused void *params)
     {        
         if ((config.personality == HOME_CONTROLLER))
         {
-            //TEST TEST TEST
-            // printf("Begin shelly test\n");
-            // discover_shelly_devices();
-            // printf("End shelly test\n");
-            printf("Home Controller\n");
-            SLEEP_MS(60000);
+            if (!hc_task_handle)
+            {
+                hc_task_handle = xTaskGetCurrentTaskHandle();
+                shelly_status_listen(hc_task_handle);
+                web_snapshot_listen(hc_task_handle, HC_WEB_GROUPS);
+            }
+            if (!shelly_status_started)
+            {
+                shelly_status_started = (shelly_status_start() == 0);
+            }
+            if (hc_rules_changed)
+            {
+                hc_load_rules();
+            }
+
+            // woken as soon as an input changes, the timeout runs out holds and keeps the watchdog fed
+            ulTaskNotifyTakeIndexed(0, pdTRUE, pdMS_TO_TICKS(wait_ms));
+
+            start_us = time_us_32();
+            now_ms = (uint32_t)(time_us_64() / 1000);
+            evaluations = hc_rules.evaluations;
+
+            fired = hc_web_changes(now_ms);
+            if ((shelly_status_sequence() != hc_shelly_sequence) || hc_rules.depends[HC_INPUT_POWER])
+            {
+                fired |= hc_shelly_changes(now_ms);
+            }
+            fired |= hc_rules_tick(&hc_rules, now_ms, &wait_ms);
+
+            elapsed_us = time_us_32() - start_us;
+            if ((hc_rules.evaluations != evaluations) || fired)
+            {
+                taskENTER_CRITICAL();
+                hc_status.passes++;
+                hc_status.last_us = elapsed_us;
+                if (elapsed_us > hc_status.worst_us)
+                {
+                    hc_status.worst_us = elapsed_us;
+                }
+                taskEXIT_CRITICAL();
+            }
+
+            hc_take_actions(fired);
+
+            if (wait_ms > HC_WAIT_MS)
+            {
+                wait_ms = HC_WAIT_MS;
+            }
         }
         else
         {
@@ -116,3 +199,249 @@ void hc_task(__unused void *params)
         watchdog_pulse((int *)params);  
     } 
 }
+
+/*!
+ * \brief Replace, add or delete a rule in config, the task picks it up straight away
+ *
+ * \param[in]  index   rule number, the number of rules to add one
+ * \param[in]  text    rule as text, empty to delete the rule
+ *
+ * \return number of rules, or -1 if the rule was rejected (the reason is in the rules status)
+ */
+int hc_task_rule_edit(int index, const char *text)
+{
+    static uint8_t code[HC_RULES_CODE_SIZE];
+    char error[HC_RULES_ERROR_MAX];
+    int num_rules;
+
+    memcpy(code, config.hc_rules, sizeof(code));
+    num_rules = hc_rules_edit(code, sizeof(code), index, text, error, sizeof(error));
+
+    taskENTER_CRITICAL();
+    if (num_rules >= 0)
+    {
+        memcpy(config.hc_rules, code, sizeof(code));
+        hc_rules_changed = true;
+    }
+    memcpy(hc_status.error, error, sizeof(hc_status.error));
+    taskEXIT_CRITICAL();
+
+    if (num_rules >= 0)
+    {
+        config_changed();
+        if (hc_task_handle)
+        {
+            xTaskNotifyGiveIndexed(hc_task_handle, 0);
+        }
+    }
+
+    return(num_rules);
+}
+
+/*!
+ * \brief Copy the rule engine state and measurements
+ *
+ * \param[out]  status  receives the state
+ *
+ * \return nothing
+ */
+void hc_task_rules_status(HC_TASK_RULES_STATUS_T *status)
+{
+    taskENTER_CRITICAL();
+    *status = hc_status;
+    status->num_rules = hc_rules.num_rules;
+    status->holding = hc_rules.holding;
+    status->fired = hc_rules.fired;
+    status->evaluations = hc_rules.evaluations;
+    taskEXIT_CRITICAL();
+}
+
+/*!
+ * \brief Check if the loaded rules need the powerwall polled
+ *
+ * \return true if a rule tests grid or battery
+ */
+bool hc_task_powerwall_wanted(void)
+{
+    return(hc_powerwall_wanted);
+}
+
+/*!
+ * \brief Load the rules from config and feed them every input again
+ *
+ * \return nothing
+ */
+static void hc_load_rules(void)
+{
+    int num_rules;
+    int i;
+
+    taskENTER_CRITICAL();
+    memcpy(hc_rules_code, config.hc_rules, sizeof(hc_rules_code));
+    hc_rules_changed = false;
+    taskEXIT_CRITICAL();
+
+    num_rules = hc_rules_load(&hc_rules, hc_rules_code, sizeof(hc_rules_code));
+    if (num_rules < 0)
+    {
+        printf("home controller rules in config are corrupt\n");
+    }
+    else
+    {
+        printf("home controller loaded %d rules\n", num_rules);
+    }
+    hc_powerwall_wanted = (hc_rules.depends[HC_INPUT_GRID] | hc_rules.depends[HC_INPUT_BATTERY]) != 0;
+
+    // rules start out not knowing any input
+    for(i=0; i<NUM_ROWS(hc_epoch); i++)
+    {
+        hc_epoch[i] = web_epoch(i) - 1;
+    }
+    hc_num_shelly = 0;
+    hc_shelly_sequence = shelly_status_sequence() - 1;
+}
+
+/*!
+ * \brief Feed the rules weather, anemometer and powerwall readings that changed since last time
+ *
+ * \param[in]  now_ms      millisecond clock
+ *
+ * \return mask of rules whose action should be taken now
+ */
+static uint32_t hc_web_changes(uint32_t now_ms)
+{
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+    WEB_POWERWALL_T powerwall;
+    uint32_t fired = 0;
+
+    if (web_epoch(WEB_GROUP_WIND) != hc_epoch[WEB_GROUP_WIND])
+    {
+        hc_epoch[WEB_GROUP_WIND] = web_snapshot_wind(&wind);
+        if (wind.sample_time_us)
+        {
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_ANEMOMETER, 0, 0, wind.wind_speed, now_ms);
+        }
+    }
+
+    if (web_epoch(WEB_GROUP_WEATHER) != hc_epoch[WEB_GROUP_WEATHER])
+    {
+        hc_epoch[WEB_GROUP_WEATHER] = web_snapshot_weather(&weather);
+
+        // readings are zeroed when the weather station stops answering, rules keep the last real values
+        if (weather.us_last_rx_packet && (time_us_32() - weather.us_last_rx_packet < HC_WEATHER_MAX_AGE_US))
+        {
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_WIND, 0, 0, weather.wind_speed, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_GUST, 0, 0, weather.wind_gust, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_TEMPERATURE, 0, 0, weather.outside_temperature, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_RAIN_DAY, 0, 0, weather.daily_rain, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_RAIN_WEEK, 0, 0, weather.trailing_seven_days_rain, now_ms);
+        }
+    }
+
+    if (web_epoch(WEB_GROUP_POWERWALL) != hc_epoch[WEB_GROUP_POWERWALL])
+    {
+        hc_epoch[WEB_GROUP_POWERWALL] = web_snapshot_powerwall(&powerwall);
+        if (powerwall.grid_status != (int)GRID_UNKNOWN)
+        {
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_GRID, 0, 0, powerwall.grid_status == GRID_UP, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_BATTERY, 0, 0, powerwall.battery_percentage, now_ms);
+        }
+    }
+
+    return(fired);
+}
+
+/*!
+ * \brief Take the actions of rules that fired
+ *
+ * \param[in]  fired   mask of rules
+ *
+ * \return nothing
+ */
+static void hc_take_actions(uint32_t fired)
+{
+    static char text[HC_RULES_TEXT_MAX];
+    HC_RULE_T *rule;
+    int err;
+    int i;
+
+    for(; fired; fired &= fired - 1)
+    {
+        i = __builtin_ctz(fired);
+        rule = &hc_rules.rule[i];
+        err = -1;
+
+        switch(rule->action)
+        {
+        case HC_ACTION_RELAY:
+            err = shelly_set_output(rule->device, rule->channel, rule->value);
+            break;
+        case HC_ACTION_SETPOINT:
+#ifdef INCORPORATE_THERMOSTAT
+            err = display_set_setpoint_offset(rule->value);
+#endif
+            break;
+        }
+
+        hc_rules_format(rule, text, sizeof(text));
+        printf("home controller rule %d %s: %s\n", i, err ? "failed" : "acted", text);
+
+        taskENTER_CRITICAL();
+        hc_status.actions++;
+        if (err)
+        {
+            hc_status.failures++;
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*!
+ * \brief Feed the rules the state of shelly devices, logging outputs or inputs that changed since last time
+ *
+ * \param[in]  now_ms      millisecond clock
+ *
+ * \return mask of rules whose action should be taken now
+ */
+static uint32_t hc_shelly_changes(uint32_t now_ms)
+{
+    static SHELLY_STATUS_T status[SHELLY_STATUS_DEVICES];
+    uint32_t fired = 0;
+    int num_status;
+    int channel;
+    int i;
+    int j;
+
+    num_status = shelly_status_snapshot(status, NUM_ROWS(status), &hc_shelly_sequence);
+
+    for(i=0; i<num_status; i++)
+    {
+        for(j=0; (j<hc_num_shelly) && (hc_shelly[j].ip != status[i].ip); j++)
+        {
+        }
+
+        if ((j == hc_num_shelly) || (hc_shelly[j].output != status[i].output) || (hc_shelly[j].input != status[i].input))
+        {
+            printf("shelly %d.%d.%d.%d output %02x input %02x power %d.%d W source %d\n",
+                   (status[i].ip >> 24) & 0xff, (status[i].ip >> 16) & 0xff, (status[i].ip >> 8) & 0xff, status[i].ip & 0xff,
+                   status[i].output, status[i].input, status[i].power_x10[0] / 10, abs(status[i].power_x10[0] % 10), status[i].source);
+        }
+
+        // unchanged values cost the rules a lookup
+        for(channel=0; channel<SHELLY_STATUS_CHANNELS; channel++)
+        {
+            if (status[i].known & (1 << channel))
+            {
+                fired |= hc_rules_update(&hc_rules, HC_INPUT_RELAY, status[i].ip, channel, (status[i].output >> channel) & 1, now_ms);
+            }
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_SWITCH, status[i].ip, channel, (status[i].input >> channel) & 1, now_ms);
+            fired |= hc_rules_update(&hc_rules, HC_INPUT_POWER, status[i].ip, channel, status[i].power_x10[channel], now_ms);
+        }
+    }
+
+    memcpy(hc_shelly, status, num_status * sizeof(SHELLY_STATUS_T));
+    hc_num_shelly = num_status;
+
+    return(fired);
+}
@@ -2,9 +2,31 @@
 #ifndef HC_TASK_H
 #define HC_TASK_H
 
+#include "hc_rules.h"
+
 //#define SOCKADDR_LEN sizeof(struct sockaddr)
 
+#define HC_RULE_CGI     "/hc_rule.cgi"      // ?n=<rule number>&rule=<rule text>, an empty rule deletes it
+
+// rule engine state and measurements, see /api/v1/rules
+typedef struct
+{
+    int num_rules;
+    uint32_t holding;                       // rules waiting out their hold time
+    uint32_t fired;                         // rules that have acted and are still true
+    uint32_t evaluations;                   // rules evaluated
+    uint32_t actions;                       // actions taken
+    uint32_t failures;                      // actions the device or thermostat did not accept
+    uint32_t passes;                        // wake ups that evaluated a rule
+    uint32_t last_us;                       // time to read the inputs and evaluate the rules on the latest pass
+    uint32_t worst_us;                      // longest pass
+    char error[HC_RULES_ERROR_MAX];         // why the last edit was rejected, empty if it was accepted
+} HC_TASK_RULES_STATUS_T;
+
 void hc_task(__unused void *params);
+int hc_task_rule_edit(int index, const char *text);
+void hc_task_rules_status(HC_TASK_RULES_STATUS_T *status);
+bool hc_task_powerwall_wanted(void);
 
 
 #endif
\ No newline at end of file
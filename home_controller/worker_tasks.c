@@ -21,6 +21,7 @@
 #include "thermostat.h"
 #include "hc_task.h"
 #include "discovery_task.h"
+#include "powerwall.h"
 
 // worker tasks to launch and monitor
 WORKER_TASK_T worker_tasks[] =
@@ -29,6 +30,7 @@ WORKER_TASK_T worker_tasks[] =
 #ifdef INCORPORATE_HOME_CONTROLLER    
     {   hc_task,        "Home Controller Task", 8096,   6},      
     {   discovery_task, "Discovery Task",       8096,   7},          
+    {   powerwall_task, "Powerwall Task",       2048,   2},
 #endif
 
     // end of table
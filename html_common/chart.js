@@ -0,0 +1,348 @@
+// Minimal self-hosted line chart for the device web pages
+//
+// Implements the subset of the Chart.js API used by the history pages so that charts work without internet access:
+//   new Chart(ctx, { type: 'line', data: { labels, datasets }, options })
+// datasets: label, data (numbers against labels, or {x, y} points), borderColor, backgroundColor, fill
+// options:  responsive, maintainAspectRatio, plugins.title, scales.x.type 'time', scales.x.time.unit,
+//           scales.{x,y}.title, scales.y.beginAtZero
+
+(function () {
+  'use strict';
+
+  var PAD = 8;
+  var FONT = '12px sans-serif';
+  var TITLE_FONT = 'bold 14px sans-serif';
+
+  function pad2(n) {
+    return (n < 10 ? '0' : '') + n;
+  }
+
+  function formatTime(ms, unit) {
+    var d = new Date(ms);
+    var hm = pad2(d.getHours()) + ':' + pad2(d.getMinutes());
+
+    if (unit === 'day') {
+      return (d.getMonth() + 1) + '/' + d.getDate();
+    }
+    if (unit === 'second') {
+      return hm + ':' + pad2(d.getSeconds());
+    }
+    return hm;
+  }
+
+  // round a range to 'nice' tick steps of 1, 2 or 5 times a power of ten
+  function niceTicks(min, max, count) {
+    var span = (max - min) || Math.abs(max) || 1;
+    var step = Math.pow(10, Math.floor(Math.log10(span / count)));
+    var ticks = [];
+    var v;
+
+    if (span / step > count * 5) {
+      step *= 10;
+    } else if (span / step > count * 2) {
+      step *= 5;
+    } else if (span / step > count) {
+      step *= 2;
+    }
+
+    for (v = Math.floor(min / step) * step; v <= max + step / 2; v += step) {
+      ticks.push(Math.round(v / step) * step);
+    }
+    return ticks;
+  }
+
+  // tick steps for time axes, aligned to whole minutes and hours in local time
+  function timeTicks(min, max, count) {
+    var MINUTE = 60000;
+    var steps = [1, 5, 15, 30, 60, 120, 180, 360, 720, 1440].map(function (m) { return m * MINUTE; });
+    var step = steps[steps.length - 1];
+    var offset = new Date(min).getTimezoneOffset() * MINUTE;
+    var ticks = [];
+    var i, v;
+
+    for (i = 0; i < steps.length; i++) {
+      if ((max - min) / steps[i] <= count) {
+        step = steps[i];
+        break;
+      }
+    }
+
+    for (v = Math.ceil((min - offset) / step) * step + offset; v <= max; v += step) {
+      ticks.push(v);
+    }
+    return ticks;
+  }
+
+  function Chart(ctx, config) {
+    this.ctx = ctx.getContext ? ctx.getContext('2d') : ctx;
+    this.canvas = this.ctx.canvas;
+    this.config = config;
+    this.options = config.options || {};
+    this.points = [];
+
+    // block layout so a parent sized by the canvas does not grow on every redraw
+    this.canvas.style.display = 'block';
+
+    if (this.options.responsive !== false) {
+      var self = this;
+      window.addEventListener('resize', function () { self.draw(); });
+    }
+    this.canvas.addEventListener('mousemove', this.hover.bind(this));
+    this.canvas.addEventListener('mouseleave', this.draw.bind(this));
+    this.draw();
+  }
+
+  Chart.prototype.resize = function () {
+    var canvas = this.canvas;
+    var parent = canvas.parentNode;
+    var ratio = window.devicePixelRatio || 1;
+    var width = canvas.width / (canvas._ratio || 1);
+    var height = canvas.height / (canvas._ratio || 1);
+
+    if (this.options.responsive !== false && parent && parent.clientWidth) {
+      width = parent.clientWidth;
+      if (this.options.maintainAspectRatio === false && parent.clientHeight) {
+        height = parent.clientHeight;
+      } else {
+        height = width / (this.aspect || (this.aspect = (canvas.width / canvas.height) || 2));
+      }
+    }
+
+    canvas.style.width = width + 'px';
+    canvas.style.height = height + 'px';
+    canvas.width = Math.round(width * ratio);
+    canvas.height = Math.round(height * ratio);
+    canvas._ratio = ratio;
+    this.ctx.setTransform(ratio, 0, 0, ratio, 0, 0);
+    this.width = width;
+    this.height = height;
+  };
+
+  // convert every dataset to [x, y] pairs in data units
+  Chart.prototype.series = function () {
+    var data = this.config.data || {};
+    var xScale = (this.options.scales || {}).x || {};
+    var isTime = xScale.type === 'time';
+
+    return (data.datasets || []).map(function (set) {
+      return (set.data || []).map(function (p, i) {
+        if (p !== null && typeof p === 'object') {
+          return [isTime ? new Date(p.x).getTime() : +p.x, +p.y];
+        }
+        return [i, +p];
+      }).filter(function (p) {
+        return isFinite(p[0]) && isFinite(p[1]);
+      });
+    });
+  };
+
+  Chart.prototype.draw = function () {
+    var ctx = this.ctx;
+    var options = this.options;
+    var scales = options.scales || {};
+    var xOpt = scales.x || {};
+    var yOpt = scales.y || {};
+    var titleOpt = (options.plugins || {}).title || {};
+    var datasets = (this.config.data || {}).datasets || [];
+    var labels = (this.config.data || {}).labels || [];
+    var series = this.series();
+    var xs = [], ys = [];
+    var top = PAD, bottom, left, right;
+    var xMin, xMax, yTicks, yMin, yMax, xTicks, i;
+    var self = this;
+
+    this.resize();
+    ctx.clearRect(0, 0, this.width, this.height);
+    ctx.font = FONT;
+    ctx.textBaseline = 'middle';
+
+    series.forEach(function (s) {
+      s.forEach(function (p) { xs.push(p[0]); ys.push(p[1]); });
+    });
+    if (!xs.length) {
+      xs = [0, 1];
+      ys = [0, 1];
+    }
+
+    // title and legend
+    if (titleOpt.display) {
+      ctx.font = TITLE_FONT;
+      ctx.textAlign = 'center';
+      ctx.fillStyle = '#333';
+      ctx.fillText(titleOpt.text, this.width / 2, top + 8);
+      ctx.font = FONT;
+      top += 22;
+    }
+    ctx.textAlign = 'left';
+    var legendX = PAD;
+    datasets.forEach(function (set) {
+      if (!set.label) {
+        return;
+      }
+      ctx.fillStyle = set.borderColor || '#36a2eb';
+      ctx.fillRect(legendX, top + 3, 24, 8);
+      ctx.fillStyle = '#333';
+      ctx.fillText(set.label, legendX + 30, top + 7);
+      legendX += 40 + ctx.measureText(set.label).width;
+    });
+    top += 22;
+
+    // y axis range
+    yMin = Math.min.apply(null, ys);
+    yMax = Math.max.apply(null, ys);
+    if (yOpt.beginAtZero) {
+      yMin = Math.min(0, yMin);
+      yMax = Math.max(0, yMax);
+    }
+    yTicks = niceTicks(yMin, yMax, 6);
+    yMin = yTicks[0];
+    yMax = yTicks[yTicks.length - 1];
+    if (yMin === yMax) {
+      yMax = yMin + 1;
+    }
+
+    // plot area
+    left = PAD + (yOpt.title && yOpt.title.display ? 18 : 0) +
+           Math.max.apply(null, yTicks.map(function (t) { return ctx.measureText(String(t)).width; })) + 6;
+    right = this.width - PAD;
+    bottom = this.height - PAD - 18 - (xOpt.title && xOpt.title.display ? 18 : 0);
+
+    xMin = Math.min.apply(null, xs);
+    xMax = Math.max.apply(null, xs);
+    if (xMin === xMax) {
+      xMax = xMin + 1;
+    }
+
+    this.xPixel = function (x) { return left + (x - xMin) * (right - left) / (xMax - xMin); };
+    this.yPixel = function (y) { return bottom - (y - yMin) * (bottom - top) / (yMax - yMin); };
+
+    // grid and tick labels
+    ctx.strokeStyle = '#e0e0e0';
+    ctx.fillStyle = '#666';
+    ctx.lineWidth = 1;
+    ctx.textAlign = 'right';
+    yTicks.forEach(function (t) {
+      var y = Math.round(self.yPixel(t)) + 0.5;
+      ctx.beginPath();
+      ctx.moveTo(left, y);
+      ctx.lineTo(right, y);
+      ctx.stroke();
+      ctx.fillText(String(t), left - 4, y);
+    });
+
+    ctx.textAlign = 'center';
+    if (xOpt.type === 'time') {
+      xTicks = timeTicks(xMin, xMax, Math.max(2, Math.floor((right - left) / 80)));
+    } else {
+      xTicks = [];
+      var every = Math.max(1, Math.ceil(labels.length * 60 / (right - left)));
+      for (i = 0; i < labels.length; i += every) {
+        xTicks.push(i);
+      }
+    }
+    xTicks.forEach(function (t) {
+      if (t < xMin || t > xMax) {
+        return;
+      }
+      var x = Math.round(self.xPixel(t)) + 0.5;
+      ctx.beginPath();
+      ctx.moveTo(x, top);
+      ctx.lineTo(x, bottom);
+      ctx.stroke();
+      ctx.fillText(xOpt.type === 'time' ? formatTime(t, (xOpt.time || {}).unit) : String(labels[t]), x, bottom + 10);
+    });
+
+    // axis titles
+    ctx.fillStyle = '#333';
+    if (xOpt.title && xOpt.title.display) {
+      ctx.fillText(xOpt.title.text, (left + right) / 2, this.height - PAD - 6);
+    }
+    if (yOpt.title && yOpt.title.display) {
+      ctx.save();
+      ctx.translate(PAD + 6, (top + bottom) / 2);
+      ctx.rotate(-Math.PI / 2);
+      ctx.fillText(yOpt.title.text, 0, 0);
+      ctx.restore();
+    }
+
+    // data
+    this.points = [];
+    series.forEach(function (s, n) {
+      var set = datasets[n];
+      if (!s.length) {
+        return;
+      }
+      ctx.beginPath();
+      s.forEach(function (p, j) {
+        var x = self.xPixel(p[0]);
+        var y = self.yPixel(p[1]);
+        if (j) {
+          ctx.lineTo(x, y);
+        } else {
+          ctx.moveTo(x, y);
+        }
+        self.points.push({ x: x, y: y, value: p, set: set });
+      });
+      if (set.fill) {
+        ctx.save();
+        ctx.lineTo(self.xPixel(s[s.length - 1][0]), bottom);
+        ctx.lineTo(self.xPixel(s[0][0]), bottom);
+        ctx.closePath();
+        ctx.fillStyle = set.backgroundColor || 'rgba(54, 162, 235, 0.2)';
+        ctx.fill();
+        ctx.restore();
+      }
+      ctx.strokeStyle = set.borderColor || '#36a2eb';
+      ctx.lineWidth = 2;
+      ctx.stroke();
+    });
+
+    this.labels = labels;
+  };
+
+  // tooltip for the point nearest the mouse
+  Chart.prototype.hover = function (event) {
+    var rect = this.canvas.getBoundingClientRect();
+    var mx = event.clientX - rect.left;
+    var my = event.clientY - rect.top;
+    var xOpt = (this.options.scales || {}).x || {};
+    var best = null;
+    var bestDistance = 400;
+    var ctx = this.ctx;
+    var text, width;
+
+    this.draw();
+    this.points.forEach(function (p) {
+      var d = (p.x - mx) * (p.x - mx) + (p.y - my) * (p.y - my);
+      if (d < bestDistance) {
+        bestDistance = d;
+        best = p;
+      }
+    });
+    if (!best) {
+      return;
+    }
+
+    if (xOpt.type === 'time') {
+      var d = new Date(best.value[0]);
+      text = (d.getMonth() + 1) + '/' + d.getDate() + ' ' + formatTime(best.value[0], 'minute');
+    } else {
+      text = String(this.labels[best.value[0]]);
+    }
+    text += '  ' + (best.set.label ? best.set.label + ': ' : '') + best.value[1];
+
+    ctx.font = FONT;
+    width = ctx.measureText(text).width + 12;
+    ctx.fillStyle = 'rgba(0, 0, 0, 0.8)';
+    ctx.fillRect(Math.min(best.x + 6, this.width - width), best.y - 26, width, 20);
+    ctx.fillStyle = '#fff';
+    ctx.textAlign = 'left';
+    ctx.fillText(text, Math.min(best.x + 6, this.width - width) + 6, best.y - 16);
+    ctx.beginPath();
+    ctx.arc(best.x, best.y, 4, 0, 2 * Math.PI);
+    ctx.fillStyle = best.set.borderColor || '#36a2eb';
+    ctx.fill();
+  };
+
+  window.Chart = Chart;
+})();
@@ -0,0 +1,1019 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/altcp.h"
+#include "lwip/altcp_tcp.h"
+#include "lwip/dns.h"
+#include "lwip/tcp.h"
+#include "lwip/prot/iana.h"
+#if LWIP_ALTCP_TLS
+#include "lwip/altcp_tls.h"
+#include "altcp_tls_mbedtls_structs.h"
+#include "mbedtls/ssl.h"
+#endif
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "http_client.h"
+
+/*
+ * HTTP/1.1 client with a connection pool
+ *
+ * A request is queued on the pooled connection to its server, which is opened if there is none, and is written as
+ * soon as the connection is up, so several requests to one server are pipelined on one connection.  Responses are
+ * parsed straight from the pbufs in the recv callback by http_response.c and json_parser.c: values matching the
+ * request's filters are copied out, the body goes to the request's callback and nothing is buffered.  Requests are
+ * built one at a time in a single shared buffer and copied into the tcp (or tls) send buffer, so the client uses the
+ * same fixed memory however many requests are outstanding.
+ *
+ * Connections stay open after a response unless the server says otherwise.  They are closed once unused for
+ * HTTP_CLIENT_IDLE_TIMEOUT_MS, or sooner when their slot is wanted for another server.  Requests pipelined behind a
+ * response that closes the connection were never handled and go on a new connection.  A server closing a kept alive
+ * connection without warning just as a request goes out is normal too, so a request that got no part of its response
+ * on a connection that had already answered is resent once.  A tls slot keeps the session of its last
+ * connection so that the next connection to the same server can resume it rather than do a full handshake.
+ *
+ * The pool is only touched with the lwip lock held: the callbacks run on the tcpip thread and http_client_submit()
+ * takes the lock.  The task that submitted a request is notified (index 0) when it is done.
+ */
+
+typedef enum
+{
+    HTTP_CONNECTION_FREE = 0,
+    HTTP_CONNECTION_RESOLVING,
+    HTTP_CONNECTION_CONNECTING,
+    HTTP_CONNECTION_OPEN
+} HTTP_CONNECTION_STATE_T;
+
+typedef struct
+{
+    uint8_t state;
+    bool tls;
+    bool closing;                                           // the server closes after the response being read
+    bool started;                                           // part of the response to queue[0] has arrived
+    uint8_t queued;                                         // requests in queue
+    uint8_t written;                                        // requests in queue that have been sent
+    uint16_t port;
+    uint16_t responses;                                     // responses received on this connection
+    TickType_t last_activity;
+    struct altcp_pcb *pcb;
+    ip_addr_t ipaddr;
+    char address[HTTP_CLIENT_ADDRESS_MAX];
+    HTTP_CLIENT_REQUEST_T *queue[HTTP_CLIENT_PIPELINE_DEPTH];   // oldest first, queue[0] is being answered
+    HTTP_RESPONSE_T response;                               // parsing the response to queue[0]
+    JSON_PARSER_CONTEXT_T json;
+#if LWIP_ALTCP_TLS
+    bool tls_session_valid;
+    mbedtls_ssl_session tls_session;                        // from the last connection to address, zeroed is initialised
+#endif
+} HTTP_CONNECTION_T;
+
+// prototypes
+static int http_client_queue(HTTP_CLIENT_REQUEST_T *request);
+static int http_client_build(HTTP_CLIENT_REQUEST_T *request, char *buffer, int size);
+static HTTP_CONNECTION_T *http_client_find(HTTP_CLIENT_REQUEST_T *request, uint16_t port);
+static HTTP_CONNECTION_T *http_client_allocate(HTTP_CLIENT_REQUEST_T *request, uint16_t port);
+static void http_client_open(HTTP_CONNECTION_T *conn);
+static void http_client_connect(HTTP_CONNECTION_T *conn);
+static void http_client_send(HTTP_CONNECTION_T *conn);
+static void http_client_expect(HTTP_CONNECTION_T *conn);
+static void http_client_answered(HTTP_CONNECTION_T *conn);
+static void http_client_complete(HTTP_CLIENT_REQUEST_T *request, int status);
+static bool http_client_drop(HTTP_CONNECTION_T *conn, bool abort, bool retry);
+static void http_client_cancel(HTTP_CLIENT_REQUEST_T *request);
+static int http_client_open_count(void);
+static void http_client_resolved(const char *name, const ip_addr_t *ipaddr, void *arg);
+static err_t http_client_connected(void *arg, struct altcp_pcb *pcb, err_t err);
+static err_t http_client_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err);
+static err_t http_client_sent(void *arg, struct altcp_pcb *pcb, u16_t len);
+static err_t http_client_poll(void *arg, struct altcp_pcb *pcb);
+static void http_client_err(void *arg, err_t err);
+#if LWIP_ALTCP_TLS
+static struct altcp_pcb *http_client_new_tls(HTTP_CONNECTION_T *conn);
+static void http_client_save_session(HTTP_CONNECTION_T *conn, struct altcp_pcb *pcb);
+#endif
+
+static HTTP_CONNECTION_T connections[HTTP_CLIENT_CONNECTIONS];
+static char request_buffer[HTTP_CLIENT_REQUEST_MAX];
+static HTTP_CLIENT_STATS_T stats;
+#if LWIP_ALTCP_TLS
+static struct altcp_tls_config *tls_config = NULL;         // shared by every tls connection, never freed
+#endif
+
+/*!
+ * \brief Queue a request, the caller's task is notified when it is done
+ *
+ * \param[in,out]   request     request, must stay in scope until done is set
+ *
+ * \return 0 if queued, -1 if the request is too long or every connection is busy
+ */
+int http_client_submit(HTTP_CLIENT_REQUEST_T *request)
+{
+    int err;
+
+    if (!request || !request->address || !request->url)
+    {
+        return(-1);
+    }
+
+    request->done = false;
+    request->status = -1;
+    request->retried = false;
+    request->task = xTaskGetCurrentTaskHandle();
+
+    cyw43_arch_lwip_begin();
+    err = http_client_queue(request);
+    cyw43_arch_lwip_end();
+
+    return(err);
+}
+
+/*!
+ * \brief Wait for a queued request to finish, giving up on it after a timeout
+ *
+ * \param[in,out]   request     request passed to http_client_submit()
+ * \param[in]       timeout_ms  longest wait
+ *
+ * \return http status, or -1 if there was no complete response
+ */
+int http_client_wait(HTTP_CLIENT_REQUEST_T *request, int timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    TickType_t elapsed;
+
+    while (!request->done)
+    {
+        elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+        {
+            cyw43_arch_lwip_begin();
+            if (!request->done)
+            {
+                http_client_cancel(request);
+            }
+            cyw43_arch_lwip_end();
+            break;
+        }
+
+        ulTaskNotifyTakeIndexed(0, pdTRUE, timeout - elapsed);
+    }
+
+    // results are read after done was seen
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return(request->status);
+}
+
+/*!
+ * \brief Send a request and wait for the response
+ *
+ * \param[in,out]   request     request
+ *
+ * \return http status, or -1 if there was no complete response
+ */
+int http_client_fetch(HTTP_CLIENT_REQUEST_T *request)
+{
+    if (http_client_submit(request) < 0)
+    {
+        return(-1);
+    }
+
+    // time to connect plus time to answer
+    return(http_client_wait(request, 2*HTTP_CLIENT_TIMEOUT_MS));
+}
+
+/*!
+ * \brief Get client statistics
+ *
+ * \param[out]  stats_out     statistics
+ *
+ * \return nothing
+ */
+void http_client_get_stats(HTTP_CLIENT_STATS_T *stats_out)
+{
+    cyw43_arch_lwip_begin();
+    *stats_out = stats;
+    cyw43_arch_lwip_end();
+}
+
+/*!
+ * \brief Put a request on a connection to its server, opening one if needed, lwip lock held
+ *
+ * \param[in]   request     request
+ *
+ * \return 0 if queued, -1 if not
+ */
+static int http_client_queue(HTTP_CLIENT_REQUEST_T *request)
+{
+    HTTP_CONNECTION_T *conn;
+    uint16_t port;
+    int length;
+
+    length = http_client_build(request, request_buffer, sizeof(request_buffer));
+    if ((length < 0) || (strlen(request->address) >= HTTP_CLIENT_ADDRESS_MAX))
+    {
+        return(-1);
+    }
+
+    if ((uint32_t)length > stats.request_max)
+    {
+        stats.request_max = length;
+    }
+
+    port = request->port ? request->port : (request->tls ? LWIP_IANA_PORT_HTTPS : LWIP_IANA_PORT_HTTP);
+
+    conn = http_client_find(request, port);
+    if (conn)
+    {
+        conn->queue[conn->queued++] = request;
+        if (conn->queued == 1)
+        {
+            http_client_expect(conn);
+        }
+        if (conn->state == HTTP_CONNECTION_OPEN)
+        {
+            http_client_send(conn);
+        }
+        return(0);
+    }
+
+    conn = http_client_allocate(request, port);
+    if (!conn)
+    {
+        return(-1);
+    }
+
+    conn->queue[0] = request;
+    conn->queued = 1;
+    http_client_expect(conn);
+    http_client_open(conn);
+
+    return(0);
+}
+
+/*!
+ * \brief Write a request into a buffer
+ *
+ * \param[in]   request     request
+ * \param[out]  buffer      receives the request
+ * \param[in]   size        size of buffer
+ *
+ * \return length of the request, or -1 if it does not fit
+ */
+static int http_client_build(HTTP_CLIENT_REQUEST_T *request, char *buffer, int size)
+{
+    int length;
+
+    length = snprintf(buffer, size, "%s %s HTTP/1.1\r\nHost: %s\r\nAccept: */*\r\n%s",
+                      (request->type == HTTP_POST) ? "POST" : "GET",
+                      request->url,
+                      request->host ? request->host : request->address,
+                      request->headers ? request->headers : "");
+
+    if ((length >= 0) && (length < size))
+    {
+        if (request->content)
+        {
+            length += snprintf(buffer + length, size - length, "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                               (int)strlen(request->content), request->content);
+        }
+        else
+        {
+            length += snprintf(buffer + length, size - length, "\r\n");
+        }
+    }
+
+    if ((length < 0) || (length >= size))
+    {
+        return(-1);
+    }
+
+    return(length);
+}
+
+/*!
+ * \brief Find a connection to the request's server with room for another request
+ *
+ * \param[in]   request     request
+ * \param[in]   port        server port
+ *
+ * \return connection, or NULL if there is none
+ */
+static HTTP_CONNECTION_T *http_client_find(HTTP_CLIENT_REQUEST_T *request, uint16_t port)
+{
+    HTTP_CONNECTION_T *conn;
+    int i;
+
+    for (i = 0; i < HTTP_CLIENT_CONNECTIONS; i++)
+    {
+        conn = &connections[i];
+
+        if ((conn->state != HTTP_CONNECTION_FREE) &&
+            !conn->closing &&
+            (conn->queued < HTTP_CLIENT_PIPELINE_DEPTH) &&
+            (conn->port == port) &&
+            (conn->tls == request->tls) &&
+            (strcasecmp(conn->address, request->address) == 0))
+        {
+            return(conn);
+        }
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Get a free connection slot, closing the longest unused connection if every slot is taken
+ *
+ * \param[in]   request     request the slot is for
+ * \param[in]   port        server port
+ *
+ * \return connection slot, or NULL if every connection is busy
+ */
+static HTTP_CONNECTION_T *http_client_allocate(HTTP_CLIENT_REQUEST_T *request, uint16_t port)
+{
+    HTTP_CONNECTION_T *conn = NULL;
+    HTTP_CONNECTION_T *idle = NULL;
+    int i;
+
+    for (i = 0; i < HTTP_CLIENT_CONNECTIONS; i++)
+    {
+        if (connections[i].state == HTTP_CONNECTION_FREE)
+        {
+            // prefer the slot last used for this server, it may hold a tls session to resume
+            if (!conn || ((connections[i].port == port) && (strcasecmp(connections[i].address, request->address) == 0)))
+            {
+                conn = &connections[i];
+            }
+        }
+        else if ((connections[i].state == HTTP_CONNECTION_OPEN) && (connections[i].queued == 0))
+        {
+            if (!idle || ((int32_t)(connections[i].last_activity - idle->last_activity) < 0))
+            {
+                idle = &connections[i];
+            }
+        }
+    }
+
+    if (!conn && idle)
+    {
+        http_client_drop(idle, false, false);
+        conn = idle;
+    }
+
+    if (conn)
+    {
+#if LWIP_ALTCP_TLS
+        if ((conn->port != port) || (strcasecmp(conn->address, request->address) != 0))
+        {
+            mbedtls_ssl_session_free(&conn->tls_session);
+            conn->tls_session_valid = false;
+        }
+#endif
+        strcpy(conn->address, request->address);
+        conn->port = port;
+        conn->tls = request->tls;
+        conn->closing = false;
+        conn->started = false;
+        conn->queued = 0;
+        conn->written = 0;
+        conn->responses = 0;
+        conn->last_activity = xTaskGetTickCount();
+    }
+
+    return(conn);
+}
+
+/*!
+ * \brief Resolve the server address then connect
+ *
+ * \param[in]   conn        connection
+ *
+ * \return nothing
+ */
+static void http_client_open(HTTP_CONNECTION_T *conn)
+{
+    err_t err;
+
+    conn->state = HTTP_CONNECTION_RESOLVING;
+
+    err = dns_gethostbyname(conn->address, &conn->ipaddr, http_client_resolved, conn);
+
+    if (err == ERR_OK)
+    {
+        http_client_connect(conn);
+    }
+    else if (err != ERR_INPROGRESS)
+    {
+        printf("http client: cannot resolve %s\n", conn->address);
+        http_client_drop(conn, false, false);
+    }
+}
+
+/*!
+ * \brief Open a tcp or tls connection to the resolved server
+ *
+ * \param[in]   conn        connection
+ *
+ * \return nothing
+ */
+static void http_client_connect(HTTP_CONNECTION_T *conn)
+{
+    struct altcp_pcb *pcb = NULL;
+    int open;
+
+    if (!conn->tls)
+    {
+        pcb = altcp_tcp_new_ip_type(IPADDR_TYPE_V4);
+    }
+#if LWIP_ALTCP_TLS
+    else
+    {
+        pcb = http_client_new_tls(conn);
+    }
+#endif
+
+    if (!pcb)
+    {
+        printf("http client: no connection to %s\n", conn->address);
+        http_client_drop(conn, false, false);
+        return;
+    }
+
+    conn->pcb = pcb;
+    conn->state = HTTP_CONNECTION_CONNECTING;
+    conn->last_activity = xTaskGetTickCount();
+
+    altcp_arg(pcb, conn);
+    altcp_recv(pcb, http_client_recv);
+    altcp_sent(pcb, http_client_sent);
+    altcp_err(pcb, http_client_err);
+    altcp_poll(pcb, http_client_poll, HTTP_CLIENT_POLL_INTERVAL);
+
+    stats.connections++;
+    open = http_client_open_count();
+    if ((uint32_t)open > stats.connections_max)
+    {
+        stats.connections_max = open;
+    }
+
+    if (altcp_connect(pcb, &conn->ipaddr, conn->port, http_client_connected) != ERR_OK)
+    {
+        printf("http client: cannot connect to %s\n", conn->address);
+        http_client_drop(conn, true, false);
+    }
+}
+
+#if LWIP_ALTCP_TLS
+/*!
+ * \brief Create a tls connection, offering the session of the last connection to the same server
+ *
+ * \param[in]   conn        connection
+ *
+ * \return connection pcb, or NULL on failure
+ */
+static struct altcp_pcb *http_client_new_tls(HTTP_CONNECTION_T *conn)
+{
+    struct altcp_pcb *pcb;
+    mbedtls_ssl_context *ssl;
+    const char *host = conn->queue[0]->host ? conn->queue[0]->host : conn->address;
+
+    if (!tls_config)
+    {
+        tls_config = altcp_tls_create_config_client(NULL, 0);
+        if (!tls_config)
+        {
+            return(NULL);
+        }
+    }
+
+    pcb = altcp_tls_new(tls_config, IPADDR_TYPE_V4);
+    if (!pcb)
+    {
+        return(NULL);
+    }
+
+    // the lwip port has no call for the server name or session, so set them on the mbedtls context directly
+    ssl = &(((altcp_mbedtls_state_t *)pcb->state)->ssl_context);
+
+    if (mbedtls_ssl_set_hostname(ssl, host) != 0)
+    {
+        altcp_abort(pcb);
+        return(NULL);
+    }
+
+    if (conn->tls_session_valid)
+    {
+        mbedtls_ssl_set_session(ssl, &conn->tls_session);
+    }
+
+    return(pcb);
+}
+
+/*!
+ * \brief Keep the session of a new tls connection for the next connection to the same server
+ *
+ * \param[in]   conn        connection
+ * \param[in]   pcb         connection pcb, handshake complete
+ *
+ * \return nothing
+ */
+static void http_client_save_session(HTTP_CONNECTION_T *conn, struct altcp_pcb *pcb)
+{
+    mbedtls_ssl_session session;
+
+    mbedtls_ssl_session_init(&session);
+
+    if (mbedtls_ssl_get_session(&(((altcp_mbedtls_state_t *)pcb->state)->ssl_context), &session) != 0)
+    {
+        mbedtls_ssl_session_free(&session);
+        stats.handshakes++;
+        return;
+    }
+
+    // the master secret only stays the same when the server resumed the session offered
+    if (conn->tls_session_valid && (memcmp(session.master, conn->tls_session.master, sizeof(session.master)) == 0))
+    {
+        stats.resumed++;
+    }
+    else
+    {
+        stats.handshakes++;
+    }
+
+    mbedtls_ssl_session_free(&conn->tls_session);
+    conn->tls_session = session;            // takes ownership of the ticket
+    conn->tls_session_valid = true;
+}
+#endif
+
+/*!
+ * \brief Write every queued request that has not been sent, as far as the send buffer allows
+ *
+ * \param[in]   conn        open connection
+ *
+ * \return nothing
+ */
+static void http_client_send(HTTP_CONNECTION_T *conn)
+{
+    HTTP_CLIENT_REQUEST_T *request;
+    int length;
+    bool wrote = false;
+
+    while ((conn->state == HTTP_CONNECTION_OPEN) && (conn->written < conn->queued))
+    {
+        request = conn->queue[conn->written];
+
+        // checked when queued so always fits
+        length = http_client_build(request, request_buffer, sizeof(request_buffer));
+
+        if ((altcp_sndbuf(conn->pcb) < length) || (altcp_sndqueuelen(conn->pcb) >= TCP_SND_QUEUELEN - 2))
+        {
+            // the rest is written from the sent callback
+            break;
+        }
+
+        if (altcp_write(conn->pcb, request_buffer, length, TCP_WRITE_FLAG_COPY) != ERR_OK)
+        {
+            break;
+        }
+
+        stats.bytes_sent += length;
+        if (conn->responses)
+        {
+            stats.reused++;
+        }
+        if (conn->written)
+        {
+            stats.pipelined++;
+        }
+
+        conn->written++;
+        wrote = true;
+    }
+
+    if (wrote)
+    {
+        altcp_output(conn->pcb);
+    }
+}
+
+/*!
+ * \brief Get ready to parse the response to the request at the head of the queue
+ *
+ * \param[in]   conn        connection
+ *
+ * \return nothing
+ */
+static void http_client_expect(HTTP_CONNECTION_T *conn)
+{
+    HTTP_CLIENT_REQUEST_T *request = conn->queue[0];
+
+    jsonp_begin(&conn->json, request->filters, request->num_filters, request->value_callback, request->callback_arg);
+    http_response_begin(&conn->response, &conn->json, request->cookies, request->cookies_size);
+    http_response_set_body_callback(&conn->response, request->body, request->callback_arg);
+    conn->started = false;
+}
+
+/*!
+ * \brief The response to the request at the head of the queue has been parsed
+ *
+ * \param[in]   conn        connection
+ *
+ * \return nothing
+ */
+static void http_client_answered(HTTP_CONNECTION_T *conn)
+{
+    HTTP_CLIENT_REQUEST_T *request = conn->queue[0];
+    int status = (conn->response.state == HTTP_RESPONSE_DONE) ? conn->response.status : -1;
+
+    if (conn->response.close)
+    {
+        conn->closing = true;
+    }
+
+    conn->queued--;
+    conn->written--;
+    memmove(&conn->queue[0], &conn->queue[1], conn->queued * sizeof(conn->queue[0]));
+    conn->responses++;
+    stats.requests++;
+
+    http_client_complete(request, status);
+
+    if (conn->queued)
+    {
+        http_client_expect(conn);
+    }
+}
+
+/*!
+ * \brief Finish a request and wake the task waiting for it
+ *
+ * \param[in]   request     request
+ * \param[in]   status      http status, or -1
+ *
+ * \return nothing
+ */
+static void http_client_complete(HTTP_CLIENT_REQUEST_T *request, int status)
+{
+    request->status = status;
+    if (status < 0)
+    {
+        stats.failed++;
+    }
+
+    // results are written before done is seen
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    request->done = true;
+
+    if (request->task)
+    {
+        xTaskNotifyGiveIndexed((TaskHandle_t)request->task, 0);
+    }
+}
+
+/*!
+ * \brief Close a connection and free its slot, resending or failing the requests still queued on it
+ *
+ * \param[in]   conn        connection
+ * \param[in]   abort       reset the connection rather than close it
+ * \param[in]   retry       resend requests that got no part of a response if the connection had already answered
+ *
+ * \return true if the pcb was aborted, a callback for it must then return ERR_ABRT
+ */
+static bool http_client_drop(HTTP_CONNECTION_T *conn, bool abort, bool retry)
+{
+    HTTP_CLIENT_REQUEST_T *queue[HTTP_CLIENT_PIPELINE_DEPTH];
+    HTTP_CLIENT_REQUEST_T *request;
+    struct altcp_pcb *pcb = conn->pcb;
+    int queued = conn->queued;
+    int written = conn->written;
+    bool started = conn->started;
+    bool announced = conn->closing;
+    bool aborted = false;
+    int i;
+
+    memcpy(queue, conn->queue, sizeof(queue));
+    retry = retry && (conn->responses > 0);
+
+    conn->state = HTTP_CONNECTION_FREE;
+    conn->pcb = NULL;
+    conn->queued = 0;
+    conn->written = 0;
+    conn->closing = false;
+
+    if (pcb)
+    {
+        altcp_arg(pcb, NULL);
+        altcp_recv(pcb, NULL);
+        altcp_sent(pcb, NULL);
+        altcp_err(pcb, NULL);
+        altcp_poll(pcb, NULL, 0);
+
+        if (abort || (altcp_close(pcb) != ERR_OK))
+        {
+            altcp_abort(pcb);
+            aborted = true;
+        }
+    }
+
+    for (i = 0; i < queued; i++)
+    {
+        request = queue[i];
+
+        if (((i == 0) && started) || !retry)
+        {
+            http_client_complete(request, -1);
+            continue;
+        }
+
+        // requests behind a response saying the connection closes were not handled, others may have been
+        if ((i < written) && !announced)
+        {
+            if (request->retried)
+            {
+                http_client_complete(request, -1);
+                continue;
+            }
+            request->retried = true;
+            stats.retried++;
+        }
+
+        if (http_client_queue(request) < 0)
+        {
+            http_client_complete(request, -1);
+        }
+    }
+
+    return(aborted);
+}
+
+/*!
+ * \brief Give up on a request, the caller no longer waits for it
+ *
+ * \param[in]   request     request
+ *
+ * \return nothing
+ */
+static void http_client_cancel(HTTP_CLIENT_REQUEST_T *request)
+{
+    HTTP_CONNECTION_T *conn;
+    int i;
+    int j;
+
+    for (i = 0; i < HTTP_CLIENT_CONNECTIONS; i++)
+    {
+        conn = &connections[i];
+
+        for (j = 0; j < conn->queued; j++)
+        {
+            if (conn->queue[j] != request)
+            {
+                continue;
+            }
+
+            if (j < conn->written)
+            {
+                // responses come back in order, so the connection cannot carry on without this one
+                http_client_drop(conn, true, false);
+            }
+            else
+            {
+                conn->queued--;
+                memmove(&conn->queue[j], &conn->queue[j + 1], (conn->queued - j) * sizeof(conn->queue[0]));
+                http_client_complete(request, -1);
+            }
+            return;
+        }
+    }
+}
+
+/*!
+ * \brief Count the connections that are open or opening
+ *
+ * \return number of connections
+ */
+static int http_client_open_count(void)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < HTTP_CLIENT_CONNECTIONS; i++)
+    {
+        if (connections[i].pcb)
+        {
+            count++;
+        }
+    }
+
+    return(count);
+}
+
+/*!
+ * \brief DNS callback, connect to the resolved address
+ *
+ * \param[in]   name        name that was looked up
+ * \param[in]   ipaddr      address, NULL if the lookup failed
+ * \param[in]   arg         connection
+ *
+ * \return nothing
+ */
+static void http_client_resolved(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+
+    // the slot may have been given up and reused while the lookup was in progress
+    if ((conn->state != HTTP_CONNECTION_RESOLVING) || (strcasecmp(name, conn->address) != 0))
+    {
+        return;
+    }
+
+    if (!ipaddr)
+    {
+        printf("http client: cannot resolve %s\n", name);
+        http_client_drop(conn, false, false);
+        return;
+    }
+
+    conn->ipaddr = *ipaddr;
+    http_client_connect(conn);
+}
+
+/*!
+ * \brief Connected callback, for tls once the handshake is complete
+ *
+ * \param[in]   arg         connection
+ * \param[in]   pcb         connection pcb
+ * \param[in]   err         always ERR_OK
+ *
+ * \return ERR_OK
+ */
+static err_t http_client_connected(void *arg, struct altcp_pcb *pcb, err_t err)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+
+#if LWIP_ALTCP_TLS
+    if (conn->tls)
+    {
+        http_client_save_session(conn, pcb);
+    }
+#endif
+
+    conn->state = HTTP_CONNECTION_OPEN;
+    conn->last_activity = xTaskGetTickCount();
+    http_client_send(conn);
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Receive callback, parse each segment of the chain in place
+ *
+ * \param[in]   arg         connection
+ * \param[in]   pcb         connection pcb
+ * \param[in]   p           received data, NULL when the server has closed the connection
+ * \param[in]   err         ERR_OK
+ *
+ * \return ERR_OK, or ERR_ABRT if the connection was aborted
+ */
+static err_t http_client_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+    struct pbuf *q;
+    int offset;
+    int used;
+
+    if (!p)
+    {
+        // closed by the server, which ends a body sent without a length
+        if (conn->queued && conn->started)
+        {
+            http_response_close(&conn->response);
+            http_client_answered(conn);
+        }
+        return(http_client_drop(conn, false, true) ? ERR_ABRT : ERR_OK);
+    }
+
+    conn->last_activity = xTaskGetTickCount();
+    stats.bytes_received += p->tot_len;
+
+    for (q = p; q && !conn->closing; q = q->next)
+    {
+        offset = 0;
+        while ((offset < q->len) && !conn->closing)
+        {
+            if (!conn->queued)
+            {
+                // more than was asked for
+                pbuf_free(p);
+                http_client_drop(conn, true, false);
+                return(ERR_ABRT);
+            }
+
+            conn->started = true;
+            used = http_response_parse(&conn->response, (const char *)q->payload + offset, q->len - offset);
+            if (used < 0)
+            {
+                printf("http client: bad response from %s\n", conn->address);
+                pbuf_free(p);
+                http_client_drop(conn, true, false);
+                return(ERR_ABRT);
+            }
+
+            offset += used;
+            if (http_response_finished(&conn->response))
+            {
+                http_client_answered(conn);
+            }
+        }
+    }
+
+    altcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    if (conn->closing)
+    {
+        // requests behind the last response go on a new connection
+        return(http_client_drop(conn, false, true) ? ERR_ABRT : ERR_OK);
+    }
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Sent callback, write any requests still waiting for send buffer space
+ *
+ * \param[in]   arg         connection
+ * \param[in]   pcb         connection pcb
+ * \param[in]   len         bytes acknowledged
+ *
+ * \return ERR_OK
+ */
+static err_t http_client_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+
+    conn->last_activity = xTaskGetTickCount();
+    http_client_send(conn);
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Poll callback, time out silent servers and close unused connections
+ *
+ * \param[in]   arg         connection
+ * \param[in]   pcb         connection pcb
+ *
+ * \return ERR_OK, or ERR_ABRT if the connection was aborted
+ */
+static err_t http_client_poll(void *arg, struct altcp_pcb *pcb)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+    TickType_t idle = xTaskGetTickCount() - conn->last_activity;
+
+    if (conn->queued && (idle > pdMS_TO_TICKS(HTTP_CLIENT_TIMEOUT_MS)))
+    {
+        printf("http client: %s timed out\n", conn->address);
+        http_client_drop(conn, true, false);
+        return(ERR_ABRT);
+    }
+
+    if (!conn->queued && (idle > pdMS_TO_TICKS(HTTP_CLIENT_IDLE_TIMEOUT_MS)))
+    {
+        return(http_client_drop(conn, false, false) ? ERR_ABRT : ERR_OK);
+    }
+
+    return(ERR_OK);
+}
+
+/*!
+ * \brief Error callback, lwip has already freed the pcb
+ *
+ * \param[in]   arg         connection
+ * \param[in]   err         reason
+ *
+ * \return nothing
+ */
+static void http_client_err(void *arg, err_t err)
+{
+    HTTP_CONNECTION_T *conn = (HTTP_CONNECTION_T *)arg;
+
+    if (conn)
+    {
+        conn->pcb = NULL;
+        http_client_drop(conn, false, true);
+    }
+}
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "json_parser.h"
+#include "http_response.h"
+
+#define HTTP_CLIENT_CONNECTIONS         (4)         // pooled connections, at most one per host
+#define HTTP_CLIENT_PIPELINE_DEPTH      (4)         // requests outstanding on one connection
+#define HTTP_CLIENT_REQUEST_MAX         (1536)      // longest request, headers and content, shared by all connections
+#define HTTP_CLIENT_ADDRESS_MAX         (64)        // longest address or host name
+#define HTTP_CLIENT_TIMEOUT_MS          (10000)     // connection or response silent for longer than this fails
+#define HTTP_CLIENT_IDLE_TIMEOUT_MS     (60000)     // unused connections are closed after this
+#define HTTP_CLIENT_POLL_INTERVAL       (2)         // half seconds between timeout checks
+
+typedef enum
+{
+    HTTP_GET,
+    HTTP_POST
+} HTTP_REQUEST_TYPE_T;
+
+// a request, owned by the caller until done is set
+typedef struct
+{
+    // filled in by the caller
+    HTTP_REQUEST_TYPE_T type;
+    const char *address;                    // ip address or dns name of the server
+    uint16_t port;                          // 0 for the default port
+    bool tls;                               // https
+    const char *host;                       // Host header and tls server name, NULL to use address
+    const char *url;
+    const char *headers;                    // extra header lines, each ending "\r\n", may be NULL
+    const char *content;                    // json to post, may be NULL
+    JSONP_FILTER_T *filters;                // json values wanted from the response, may be NULL
+    int num_filters;
+    JSONP_CALLBACK_T value_callback;        // called for every json value in the response, may be NULL
+    HTTP_BODY_CALLBACK_T body;              // receives the body as it arrives, may be NULL
+    void *callback_arg;                     // passed to value_callback and body
+    char *cookies;                          // receives the Set-Cookie values, may be NULL
+    int cookies_size;
+
+    // filled in by the client
+    volatile bool done;
+    int status;                             // http status, or -1 if there was no complete response
+    void *task;                             // woken when done
+    bool retried;                           // already resent once after a pooled connection closed
+} HTTP_CLIENT_REQUEST_T;
+
+typedef struct
+{
+    uint32_t connections;       // connections opened
+    uint32_t handshakes;        // full tls handshakes
+    uint32_t resumed;           // tls connections that resumed an earlier session
+    uint32_t requests;          // responses received
+    uint32_t reused;            // requests sent on a connection that had already answered one
+    uint32_t pipelined;         // requests sent while an earlier one was still unanswered
+    uint32_t retried;           // requests resent after a pooled connection closed under them
+    uint32_t failed;            // requests that ended without a response
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    uint32_t request_max;       // longest request built
+    uint32_t connections_max;   // most connections open at once
+} HTTP_CLIENT_STATS_T;
+
+int http_client_submit(HTTP_CLIENT_REQUEST_T *request);
+int http_client_wait(HTTP_CLIENT_REQUEST_T *request, int timeout_ms);
+int http_client_fetch(HTTP_CLIENT_REQUEST_T *request);
+void http_client_get_stats(HTTP_CLIENT_STATS_T *stats);
+
+#endif
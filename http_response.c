@@ -0,0 +1,511 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <string.h>
+#include <strings.h>
+
+#include "http_response.h"
+
+/*
+ * Incremental http response parser
+ *
+ * Consumes a response in whatever pieces it arrives (e.g. each pbuf of a chain in turn, straight from the recv
+ * callback) without copying it.  The status line and headers are read a character at a time, keeping only the
+ * start of the current header; Set-Cookie values are copied out as they go past and Content-Length or
+ * Transfer-Encoding: chunked decide where the body ends.  Body bytes are handed to the json parser and the body
+ * callback in runs, so a document split across segments is parsed as it arrives.  Parsing stops at the end of the
+ * response, so the bytes of a pipelined response that follows in the same segment are left for the next parser.
+ */
+
+// NB: this file must not depend on lwIP so that http_response_test can split recorded gateway responses at every offset
+
+// prototypes
+static void http_response_character(HTTP_RESPONSE_T *response, char c);
+static void http_response_header(HTTP_RESPONSE_T *response);
+static void http_response_body_start(HTTP_RESPONSE_T *response);
+static void http_response_cookie(HTTP_RESPONSE_T *response, char c);
+static void http_response_body(HTTP_RESPONSE_T *response, const char *data, int length);
+static int http_response_hex(char c);
+
+
+/*!
+ * \brief Prepare for a response
+ *
+ * \param[out]  response        parser state
+ * \param[in]   json            json parser receiving the body, already begun, may be NULL
+ * \param[out]  cookies         receives the Set-Cookie values, may be NULL
+ * \param[in]   cookies_size    size of cookies
+ *
+ * \return nothing
+ */
+void http_response_begin(HTTP_RESPONSE_T *response, JSON_PARSER_CONTEXT_T *json, char *cookies, int cookies_size)
+{
+    memset(response, 0, sizeof(HTTP_RESPONSE_T));
+
+    response->state = HTTP_RESPONSE_STATUS_VERSION;
+    response->content_length = -1;
+    response->json = json;
+
+    if (cookies && (cookies_size > 0))
+    {
+        response->cookies = cookies;
+        response->cookies_size = cookies_size;
+        cookies[0] = 0;
+    }
+}
+
+/*!
+ * \brief Also pass the body to a callback
+ *
+ * \param[in]   response    parser state, already begun
+ * \param[in]   body        receives body bytes
+ * \param[in]   body_arg    passed to body
+ *
+ * \return nothing
+ */
+void http_response_set_body_callback(HTTP_RESPONSE_T *response, HTTP_BODY_CALLBACK_T body, void *body_arg)
+{
+    response->body = body;
+    response->body_arg = body_arg;
+}
+
+/*!
+ * \brief Parse the next piece of a response
+ *
+ * \param[in]   response    parser state
+ * \param[in]   data        received bytes
+ * \param[in]   length      number of bytes
+ *
+ * \return bytes used, less than length if the response ended part way through, or -1 if the response is malformed
+ */
+int http_response_parse(HTTP_RESPONSE_T *response, const char *data, int length)
+{
+    int count;
+    int i = 0;
+
+    while ((i < length) && (response->state < HTTP_RESPONSE_DONE))
+    {
+        switch(response->state)
+        {
+            case HTTP_RESPONSE_BODY:
+            case HTTP_RESPONSE_CHUNK_DATA:
+                // hand over as much of the body as this piece holds
+                count = length - i;
+                if ((uint32_t)count > response->remaining)
+                {
+                    count = response->remaining;
+                }
+                http_response_body(response, data + i, count);
+                response->remaining -= count;
+                i += count;
+
+                if (response->remaining == 0)
+                {
+                    response->state = (response->state == HTTP_RESPONSE_BODY) ? HTTP_RESPONSE_DONE : HTTP_RESPONSE_CHUNK_END;
+                }
+                break;
+            case HTTP_RESPONSE_BODY_UNTIL_CLOSE:
+                http_response_body(response, data + i, length - i);
+                i = length;
+                break;
+            default:
+                http_response_character(response, data[i++]);
+                break;
+        }
+    }
+
+    return((response->state == HTTP_RESPONSE_ERROR) ? -1 : i);
+}
+
+/*!
+ * \brief The connection has closed, which ends a body without a length
+ *
+ * \param[in]   response    parser state
+ *
+ * \return nothing
+ */
+void http_response_close(HTTP_RESPONSE_T *response)
+{
+    if (response->state == HTTP_RESPONSE_BODY_UNTIL_CLOSE)
+    {
+        response->state = HTTP_RESPONSE_DONE;
+    }
+    else if (response->state != HTTP_RESPONSE_DONE)
+    {
+        response->state = HTTP_RESPONSE_ERROR;
+    }
+}
+
+/*!
+ * \brief Check whether the whole response has been parsed, or parsing has given up
+ *
+ * \param[in]   response    parser state
+ *
+ * \return true if no more data is expected
+ */
+bool http_response_finished(HTTP_RESPONSE_T *response)
+{
+    return(response->state >= HTTP_RESPONSE_DONE);
+}
+
+/*!
+ * \brief Advance the status line, header or chunk framing state machine by one character
+ *
+ * \param[in]   response    parser state
+ * \param[in]   c           character
+ *
+ * \return nothing
+ */
+static void http_response_character(HTTP_RESPONSE_T *response, char c)
+{
+    int digit;
+
+    switch(response->state)
+    {
+        case HTTP_RESPONSE_STATUS_VERSION:
+            // "HTTP/1.1 "
+            if ((c == ' ') && (response->name_length == 5))
+            {
+                response->state = HTTP_RESPONSE_STATUS_CODE;
+            }
+            else if ((c == ' ') && (response->name_length > 5))
+            {
+                // HTTP/1.0 closes after each response unless the server says otherwise
+                response->close = (response->name_length == 8) && (response->name[7] == '0');
+                response->state = HTTP_RESPONSE_STATUS_CODE;
+            }
+            else if (response->name_length < 5)
+            {
+                if (c != "HTTP/"[response->name_length++])
+                {
+                    response->state = HTTP_RESPONSE_ERROR;
+                }
+            }
+            else if (c == '\n')
+            {
+                response->state = HTTP_RESPONSE_ERROR;
+            }
+            else if (response->name_length < HTTP_RESPONSE_NAME_MAX - 1)
+            {
+                response->name[response->name_length++] = c;
+            }
+            break;
+        case HTTP_RESPONSE_STATUS_CODE:
+            if ((c >= '0') && (c <= '9'))
+            {
+                response->status = response->status * 10 + (c - '0');
+            }
+            else if (c == '\n')
+            {
+                response->state = HTTP_RESPONSE_HEADER_NAME;
+                response->line_start = true;
+                response->name_length = 0;
+            }
+            else
+            {
+                response->state = HTTP_RESPONSE_STATUS_REASON;
+            }
+            break;
+        case HTTP_RESPONSE_STATUS_REASON:
+            if (c == '\n')
+            {
+                response->state = HTTP_RESPONSE_HEADER_NAME;
+                response->line_start = true;
+                response->name_length = 0;
+            }
+            break;
+        case HTTP_RESPONSE_HEADER_NAME:
+            if (c == '\r')
+            {
+                if (response->line_start)
+                {
+                    response->state = HTTP_RESPONSE_HEADERS_END;
+                }
+            }
+            else if (c == '\n')
+            {
+                if (response->line_start)
+                {
+                    // headers ended by a bare line feed
+                    http_response_body_start(response);
+                }
+                else
+                {
+                    // a line without a colon
+                    response->line_start = true;
+                    response->name_length = 0;
+                }
+            }
+            else if (c == ':')
+            {
+                response->name[response->name_length] = 0;
+                response->value_length = 0;
+                response->cookie_open = false;
+                if (strcmp(response->name, "set-cookie") == 0)
+                {
+                    response->cookie_open = true;
+                    if (response->cookies && (response->cookies_length > 0))
+                    {
+                        http_response_cookie(response, ';');
+                        http_response_cookie(response, ' ');
+                    }
+                }
+                response->state = HTTP_RESPONSE_HEADER_VALUE;
+            }
+            else
+            {
+                response->line_start = false;
+                if (response->name_length < HTTP_RESPONSE_NAME_MAX - 1)
+                {
+                    response->name[response->name_length++] = ((c >= 'A') && (c <= 'Z')) ? c + 'a' - 'A' : c;
+                }
+            }
+            break;
+        case HTTP_RESPONSE_HEADER_VALUE:
+            if (c == '\n')
+            {
+                response->value[response->value_length] = 0;
+                http_response_header(response);
+                response->state = HTTP_RESPONSE_HEADER_NAME;
+                response->line_start = true;
+                response->name_length = 0;
+            }
+            else if ((c == '\r') || (((c == ' ') || (c == '\t')) && (response->value_length == 0)))
+            {
+                // line ending and leading space are not part of the value
+            }
+            else
+            {
+                if (response->value_length < HTTP_RESPONSE_VALUE_MAX - 1)
+                {
+                    response->value[response->value_length++] = c;
+                }
+                if (response->cookie_open)
+                {
+                    if (c == ';')
+                    {
+                        // only name=value is sent back, not the attributes
+                        response->cookie_open = false;
+                    }
+                    else
+                    {
+                        http_response_cookie(response, c);
+                    }
+                }
+            }
+            break;
+        case HTTP_RESPONSE_HEADERS_END:
+            if (c == '\n')
+            {
+                http_response_body_start(response);
+            }
+            else
+            {
+                response->state = HTTP_RESPONSE_ERROR;
+            }
+            break;
+        case HTTP_RESPONSE_CHUNK_SIZE:
+            digit = http_response_hex(c);
+            if (digit >= 0)
+            {
+                if (response->remaining > 0x0FFFFFFF)
+                {
+                    response->state = HTTP_RESPONSE_ERROR;
+                    break;
+                }
+                response->remaining = (response->remaining << 4) | digit;
+            }
+            else if ((c == ';') || (c == ' ') || (c == '\t'))
+            {
+                response->state = HTTP_RESPONSE_CHUNK_EXTENSION;
+            }
+            else if (c == '\n')
+            {
+                response->line_start = true;
+                response->state = response->remaining ? HTTP_RESPONSE_CHUNK_DATA : HTTP_RESPONSE_TRAILER;
+            }
+            else if (c != '\r')
+            {
+                response->state = HTTP_RESPONSE_ERROR;
+            }
+            break;
+        case HTTP_RESPONSE_CHUNK_EXTENSION:
+            if (c == '\n')
+            {
+                response->line_start = true;
+                response->state = response->remaining ? HTTP_RESPONSE_CHUNK_DATA : HTTP_RESPONSE_TRAILER;
+            }
+            break;
+        case HTTP_RESPONSE_CHUNK_END:
+            if (c == '\n')
+            {
+                response->remaining = 0;
+                response->state = HTTP_RESPONSE_CHUNK_SIZE;
+            }
+            else if (c != '\r')
+            {
+                response->state = HTTP_RESPONSE_ERROR;
+            }
+            break;
+        case HTTP_RESPONSE_TRAILER:
+            // trailer lines are ignored, an empty line ends the response
+            if (c == '\n')
+            {
+                if (response->line_start)
+                {
+                    response->state = HTTP_RESPONSE_DONE;
+                }
+                response->line_start = true;
+            }
+            else if (c != '\r')
+            {
+                response->line_start = false;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+ * \brief Act on a complete header line
+ *
+ * \param[in]   response    parser state
+ *
+ * \return nothing
+ */
+static void http_response_header(HTTP_RESPONSE_T *response)
+{
+    int i;
+
+    if (strcmp(response->name, "content-length") == 0)
+    {
+        response->content_length = 0;
+        for (i = 0; (response->value[i] >= '0') && (response->value[i] <= '9') && (response->content_length < 0x0CCCCCCC); i++)
+        {
+            response->content_length = response->content_length * 10 + (response->value[i] - '0');
+        }
+    }
+    else if (strcmp(response->name, "transfer-encoding") == 0)
+    {
+        // chunked is always the last coding listed
+        i = response->value_length - 7;
+        response->chunked = (i >= 0) && (strcasecmp(response->value + i, "chunked") == 0);
+    }
+    else if (strcmp(response->name, "connection") == 0)
+    {
+        if (strcasecmp(response->value, "close") == 0)
+        {
+            response->close = true;
+        }
+        else if (strcasecmp(response->value, "keep-alive") == 0)
+        {
+            response->close = false;
+        }
+    }
+}
+
+/*!
+ * \brief Work out how the body is delimited once the headers have ended
+ *
+ * \param[in]   response    parser state
+ *
+ * \return nothing
+ */
+static void http_response_body_start(HTTP_RESPONSE_T *response)
+{
+    if ((response->status >= 100) && (response->status < 200))
+    {
+        // interim response, the real one follows
+        response->status = 0;
+        response->name_length = 0;
+        response->content_length = -1;
+        response->chunked = false;
+        response->state = HTTP_RESPONSE_STATUS_VERSION;
+    }
+    else if ((response->status == 204) || (response->status == 304) || (response->content_length == 0))
+    {
+        response->state = HTTP_RESPONSE_DONE;
+    }
+    else if (response->chunked)
+    {
+        response->remaining = 0;
+        response->state = HTTP_RESPONSE_CHUNK_SIZE;
+    }
+    else if (response->content_length > 0)
+    {
+        response->remaining = response->content_length;
+        response->state = HTTP_RESPONSE_BODY;
+    }
+    else
+    {
+        response->close = true;
+        response->state = HTTP_RESPONSE_BODY_UNTIL_CLOSE;
+    }
+}
+
+/*!
+ * \brief Append a character to the cookies, dropping what does not fit
+ *
+ * \param[in]   response    parser state
+ * \param[in]   c           character
+ *
+ * \return nothing
+ */
+static void http_response_cookie(HTTP_RESPONSE_T *response, char c)
+{
+    if (response->cookies && (response->cookies_length < response->cookies_size - 1))
+    {
+        response->cookies[response->cookies_length++] = c;
+        response->cookies[response->cookies_length] = 0;
+    }
+}
+
+/*!
+ * \brief Pass body bytes to the json parser and the body callback
+ *
+ * \param[in]   response    parser state
+ * \param[in]   data        body bytes
+ * \param[in]   length      number of bytes
+ *
+ * \return nothing
+ */
+static void http_response_body(HTTP_RESPONSE_T *response, const char *data, int length)
+{
+    if (response->json)
+    {
+        jsonp_parse_buffer(response->json, data, length);
+    }
+
+    if (response->body)
+    {
+        response->body(response->body_arg, data, length);
+    }
+}
+
+/*!
+ * \brief Value of a hexadecimal digit
+ *
+ * \param[in]   c           character
+ *
+ * \return 0 to 15, or -1 if c is not a hex digit
+ */
+static int http_response_hex(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return(c - '0');
+    }
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return(c - 'a' + 10);
+    }
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return(c - 'A' + 10);
+    }
+
+    return(-1);
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "json_parser.h"
+
+#define HTTP_RESPONSE_NAME_MAX      (20)        // longest header name recognised, including nul
+#define HTTP_RESPONSE_VALUE_MAX     (24)        // start of a header value kept for inspection, including nul
+
+typedef enum
+{
+    HTTP_RESPONSE_STATUS_VERSION = 0,
+    HTTP_RESPONSE_STATUS_CODE,
+    HTTP_RESPONSE_STATUS_REASON,
+    HTTP_RESPONSE_HEADER_NAME,
+    HTTP_RESPONSE_HEADER_VALUE,
+    HTTP_RESPONSE_HEADERS_END,
+    HTTP_RESPONSE_BODY,
+    HTTP_RESPONSE_BODY_UNTIL_CLOSE,
+    HTTP_RESPONSE_CHUNK_SIZE,
+    HTTP_RESPONSE_CHUNK_EXTENSION,
+    HTTP_RESPONSE_CHUNK_DATA,
+    HTTP_RESPONSE_CHUNK_END,
+    HTTP_RESPONSE_TRAILER,
+    HTTP_RESPONSE_DONE,
+    HTTP_RESPONSE_ERROR
+} HTTP_RESPONSE_STATE_T;
+
+// receives body bytes, after any chunked encoding is removed, as they arrive
+typedef void (*HTTP_BODY_CALLBACK_T)(void *arg, const char *data, int length);
+
+typedef struct
+{
+    uint8_t state;
+    bool line_start;                        // nothing but the line ending seen on this line yet
+    bool cookie_open;                       // copying the value of a Set-Cookie header
+    bool chunked;                           // Transfer-Encoding: chunked
+    bool close;                             // server closes the connection after this response
+    int status;                             // status code, e.g. 200
+    int32_t content_length;                 // -1 if not sent
+    uint32_t remaining;                     // body or chunk bytes still to come
+    uint8_t name_length;
+    uint8_t value_length;
+    char name[HTTP_RESPONSE_NAME_MAX];      // header name in lower case, truncated
+    char value[HTTP_RESPONSE_VALUE_MAX];    // start of the header value
+    char *cookies;                          // Set-Cookie values, "name=value; name=value", may be NULL
+    int cookies_size;
+    int cookies_length;
+    JSON_PARSER_CONTEXT_T *json;            // receives the body, may be NULL
+    HTTP_BODY_CALLBACK_T body;              // also receives the body, may be NULL
+    void *body_arg;
+} HTTP_RESPONSE_T;
+
+void http_response_begin(HTTP_RESPONSE_T *response, JSON_PARSER_CONTEXT_T *json, char *cookies, int cookies_size);
+int http_response_parse(HTTP_RESPONSE_T *response, const char *data, int length);
+void http_response_set_body_callback(HTTP_RESPONSE_T *response, HTTP_BODY_CALLBACK_T body, void *body_arg);
+void http_response_close(HTTP_RESPONSE_T *response);
+bool http_response_finished(HTTP_RESPONSE_T *response);
+
+#endif
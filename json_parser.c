@@ -1,665 +1,614 @@
-#include <pico/cyw43_arch.h>
-#include <pico/stdlib.h>
-#include <pico/util/datetime.h>
-//#include "hardware/rtc.h"
-#include <hardware/watchdog.h>
-#include <hardware/flash.h>
-
-#include <lwip/netif.h>
-#include <lwip/ip4_addr.h>
-#include <lwip/apps/lwiperf.h>
-#include <lwip/opt.h>
-#include <lwip/sockets.h>
-#include <lwip/netdb.h>
-#include <lwip/sys.h>
-#include <lwip/dns.h>
-
-#include <FreeRTOS.h>
-#include <FreeRTOSConfig.h>
-#include <task.h>
-
-
-#include <stdarg.h>
-
-#include <weather.h>
-#include <flash.h>
-#include <calendar.h>
-#include <utility.h>
-#include <config.h>
-#include <watchdog.h>
-#include <pluto.h>
-#include "powerwall.h"
-#include <shelly.h>
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "fixed_format.h"
 #include "json_parser.h"
 
+/*
+ * Streaming json parser
+ *
+ * The response is read one character at a time by a state machine that keeps only the path of the value being parsed
+ * and a small stack of the objects and arrays it is inside, so a buffer can be parsed in pieces as it is received and
+ * nothing of the document is cached.  Paths are written as before, e.g. root."sys"."mac" or root."emeters".index0."power",
+ * and values are the text as sent, quotes and escapes included.
+ *
+ * The caller registers the paths it wants as filters and each matching value is copied straight into the filter's
+ * buffer.  A callback can be given as well to see every value (e.g. jsonp_print_value to dump a response).
+ * A filter matches one full path, ignoring case; to see a whole object use the callback.  Filter paths are hashed
+ * once per document and the hash of the current path is updated as each character is appended to it (and restored
+ * from the level stack when it is cut back), so finding the filter for a value compares integers rather than
+ * strings.
+ */
 
-extern WEB_VARIABLES_T web;
+// NB: this file must not depend on lwIP so that json_parser_test can feed it recorded Shelly and Powerwall responses in pieces
 
+#define JSONP_PATH_OVERFLOW     (255)
+#define JSONP_HASH_BASIS        (0x811C9DC5)
 
 // prototypes
-int jsonp_initialize_all_keys(JSON_PARSER_CONTEXT_T *context, u8_t key_value);
-int jsonp_initialize_all_values(JSON_PARSER_CONTEXT_T *context, char *value_string);
-int jsonp_initialize_all_tokens(JSON_PARSER_CONTEXT_T *context);
-int jsonp_insert_token_string(JSON_PARSER_CONTEXT_T *context, char *token_string);
-int jsonp_insert_token_value(JSON_PARSER_CONTEXT_T *context, int token, char *token_value);
-int jsonp_get_free_kvp_row(JSON_PARSER_CONTEXT_T *context);
-int jsonp_append_token_to_key_heirarchy(JSON_PARSER_CONTEXT_T *context, int kvp_index, u8_t key_token);
-int jsonp_insert_value(JSON_PARSER_CONTEXT_T *context, int kvp_index, char *value);
-int jsonp_initialize_row_key(JSON_PARSER_CONTEXT_T *context, int key_index, u8_t key_value);
-int jsonp_append_string_to_key_heirarchy(JSON_PARSER_CONTEXT_T *context, int kvp_index, char *key_string);
-int jsonp_query_status(char *ipstring);
-
-
+static void jsonp_character(JSON_PARSER_CONTEXT_T *context, char c);
+static void jsonp_value(JSON_PARSER_CONTEXT_T *context, char c);
+static void jsonp_next(JSON_PARSER_CONTEXT_T *context, char c);
+static void jsonp_push(JSON_PARSER_CONTEXT_T *context, bool array);
+static void jsonp_pop(JSON_PARSER_CONTEXT_T *context, char c);
+static void jsonp_element_path(JSON_PARSER_CONTEXT_T *context);
+static void jsonp_scalar_start(JSON_PARSER_CONTEXT_T *context);
+static void jsonp_scalar_character(JSON_PARSER_CONTEXT_T *context, char c, bool quote);
+static void jsonp_scalar_end(JSON_PARSER_CONTEXT_T *context);
+static void jsonp_path_append(JSON_PARSER_CONTEXT_T *context, const char *text, int length);
+static void jsonp_path_to_level(JSON_PARSER_CONTEXT_T *context);
+static uint32_t jsonp_hash(uint32_t hash, const char *text, int length);
+static bool jsonp_is_space(char c);
+static bool jsonp_is_literal(char c);
 
 
 /*!
- * \brief initialize json parser context
+ * \brief Start parsing a json document
  *
- * \param[in]   num_spaces  
- * 
- * \return 0
+ * \param[out]  context         parser state
+ * \param[in]   filters         values wanted, their found flags are cleared
+ * \param[in]   num_filters     number of filters
+ * \param[in]   callback        called for every value, may be NULL
+ * \param[in]   callback_arg    passed to the callback
+ *
+ * \return nothing
  */
-int jsonp_initialize_context(JSON_PARSER_CONTEXT_T *context)
+void jsonp_begin(JSON_PARSER_CONTEXT_T *context, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *callback_arg)
 {
     int i;
 
-    context->depth = 0;
-    context->comma_instance = 0;
-    context->i = 0;
-    context->j = 0;
-    context->k = 0;
-    context->l = 0;
-    context->consolidate_closing_delimiters = false;
-    context->last_entity[0] = 0;
-    context->quotation = false;
-    context->character_processed = false;
-    context->kvp_index = 0; 
-
-    memset(&(context->instance_delimiter), '{', NUM_ROWS(context->instance_delimiter));
-    memset(&(context->instance), 0, NUM_ROWS(context->instance));
-    memset(&(context->entity), 0, sizeof(context->entity));
-    memset(&(context->processing_value), false, NUM_ROWS(context->processing_value));
-    memset(&(context->key), 0, NUM_ROWS(context->key));
-    memset(&(context->value), 0, NUM_ROWS(context->value));
-    memset(&(context->indexstring), 0, NUM_ROWS(context->indexstring));
-
-    // TODO -- not needed here as we have specific cache init function
-    // memset(&(context->jsonp_token), 0, sizeof(context->jsonp_token));
-    // memset(&(context->jsonp_key), 0, sizeof(context->jsonp_key));
-    // memset(&(context->jsonp_value), 0, sizeof(context->jsonp_value));
-
-    for(i=0; i<8; i++)
-    {
-        sprintf(context->entity[i], "empty%d", i);
-    } 
+    memset(context, 0, sizeof(JSON_PARSER_CONTEXT_T));
 
-    sprintf(context->entity[0], "root");
-    sprintf(context->last_entity, "god"); 
+    context->filters = filters;
+    context->num_filters = num_filters;
+    context->callback = callback;
+    context->callback_arg = callback_arg;
+    context->state = JSONP_STATE_VALUE;
+    context->path_hash = JSONP_HASH_BASIS;
+    jsonp_path_append(context, "root", 4);
 
-    return(0);
+    for (i = 0; i < num_filters; i++)
+    {
+        filters[i].hash = jsonp_hash(JSONP_HASH_BASIS, filters[i].path, strlen(filters[i].path));
+        filters[i].found = false;
+        if (filters[i].value_length > 0)
+        {
+            filters[i].value[0] = 0;
+        }
+    }
 }
 
-
 /*!
- * \brief extract key value pairs from buffer containing json
+ * \brief Parse the next piece of a json document
  *
- * \param[in]   num_spaces  
- * 
- * \return 0
+ * \param[in]   context     parser state
+ * \param[in]   buffer      json text, need not be nul terminated or end on a token boundary
+ * \param[in]   length      number of characters in buffer
+ *
+ * \return 0 on success, -1 if the document is malformed
  */
-int jsonp_parse_buffer(JSON_PARSER_CONTEXT_T *context, char *buffer, bool continuation)
+int jsonp_parse_buffer(JSON_PARSER_CONTEXT_T *context, const char *buffer, int length)
 {
-    // reset parser unless buffer continues from the previous buffer
-    if (!continuation)
+    int i;
+
+    for (i = 0; (i < length) && (context->state < JSONP_STATE_DONE); i++)
     {
-        jsonp_initialize_context(context); 
-        jsonp_initialize_cache(context);       
+        jsonp_character(context, buffer[i]);
     }
 
-    context->j = strlen(context->entity[0]);
-    context->kvp_index = jsonp_get_free_kvp_row(context);
-    context->i = 0;
+    return((context->state == JSONP_STATE_ERROR) ? -1 : 0);
+}
 
-    while (buffer[context->i] != 0)
+/*!
+ * \brief Finish parsing a json document
+ *
+ * \param[in]   context     parser state
+ *
+ * \return 0 if a complete document was parsed, -1 otherwise
+ */
+int jsonp_end(JSON_PARSER_CONTEXT_T *context)
+{
+    if ((context->state == JSONP_STATE_LITERAL) && (context->depth == 0))
     {
-        context->character_processed = false;
-
-        // track quotes
-        if (buffer[context->i] == '"')
-        {
-            context->quotation = !context->quotation;
-        }
-
-        // process delimiters
-        if (!context->quotation)
-        {
-            context->character_processed = true;
+        // a document that is a single number or literal ends with the text
+        jsonp_scalar_end(context);
+        context->state = JSONP_STATE_DONE;
+    }
 
-            switch (buffer[context->i])
-            {
+    return((context->state == JSONP_STATE_DONE) ? 0 : -1);
+}
 
-            case '{':
-            case '[':        
-                context->depth++;       
-                if (context->depth >= NUM_ROWS(context->instance))
-                {
-                    printf("Parser ABORT -- maximum nesting depth exceeded\n");
-                    break;
-                }         
-                context->instance[context->depth] = 0;    
-                context->instance_delimiter[context->depth] = buffer[context->i];                          
-                context->processing_value[context->depth] = false;
-                if (context->consolidate_closing_delimiters)
-                {
-                    //printf("\n");
-                    context->consolidate_closing_delimiters = false;
-                }
-                context->j = 0;
-                context->entity[context->depth][0] = 0;
-                break;
-            case '}':
-            case ']':  
-            case ',':                  
-                //printf("[depth = %d][instance = %d]", depth, instance[depth]);
-                context->key[0] = 0;
-                jsonp_initialize_row_key(context, context->kvp_index, 255);
-                
-                for (context->k=0; context->k<context->depth; context->k++)
-                {
-                    if(context->entity[context->k][0])
-                    {
-                        //printf("%s", entity[k]);
-                        STRAPPEND(context->key, context->entity[context->k]);
-                        jsonp_append_string_to_key_heirarchy(context, context->kvp_index, context->entity[context->k]);
-                    }
-                    else
-                    {
-                        for(context->l=context->depth-1; context->l>0; context->l--)
-                        {
-                            if (context->instance_delimiter[context->l] == '[') break;
-                        }
-                        //printf("index%d", instance[l]);
-                        sprintf(context->indexstring, "index%d", context->instance[context->l]);
-                        STRAPPEND(context->key, context->indexstring);
-                        jsonp_append_string_to_key_heirarchy(context, context->kvp_index, context->indexstring);                       
-                    }
-                    //printf(".");
-                    STRAPPEND(context->key, ".");
-                }        
-                if (context->processing_value[context->depth])
-                {
-                    //printf("%s (value)", last_entity);
-                    STRAPPEND(context->key, context->last_entity);
-                    jsonp_append_string_to_key_heirarchy(context, context->kvp_index, context->last_entity);
-
-                    //printf("\nKEY: %s\n", key);
-                    context->entity[context->depth][context->j] = 0;  
-                    //printf("VALUE: %s\n", entity[depth]); 
-                    jsonp_insert_value(context, context->kvp_index, context->entity[context->depth]);  
-                    context->kvp_index = jsonp_get_free_kvp_row(context);                                     
-                    context->processing_value[context->depth] = false;
-                }
-                else
-                {
-                   //printf("*Single token or no token before ] or } or , -- check if array value*\n");
-                    if ((context->instance_delimiter[context->depth] == '[') && (!context->consolidate_closing_delimiters))
-                    {
-                        //printf("instance delimiter is [ so treat as list of values\n");
-                        //printf("index%d.", instance[depth]);
-                        sprintf(context->indexstring, "index%d", context->instance[context->depth]);
-                        STRAPPEND(context->key, context->indexstring);  
-                        jsonp_append_string_to_key_heirarchy(context, context->kvp_index, context->indexstring); 
-
-                        STRAPPEND(context->key, ".");
-
-                        //printf("%s (value)", entity[k]);
-                        //printf("\nKEY: %s\n", key);
-                        context->entity[context->depth][context->j] = 0;  
-                        //printf("VALUE: %s\n", entity[depth]);
-                        jsonp_insert_value(context, context->kvp_index, context->entity[context->depth]);  
-                        context->kvp_index = jsonp_get_free_kvp_row(context);                                                 
-                    }                    
-                }
+/*!
+ * \brief Parse a nul terminated json document
+ *
+ * \param[in]   json            json text
+ * \param[in]   filters         values wanted
+ * \param[in]   num_filters     number of filters
+ * \param[in]   callback        called for every value, may be NULL
+ * \param[in]   callback_arg    passed to the callback
+ *
+ * \return number of filters found
+ */
+int jsonp_parse_string(const char *json, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *callback_arg)
+{
+    JSON_PARSER_CONTEXT_T context;
+    int found = 0;
+    int i;
 
-                if ((buffer[context->i] == ']') || (buffer[context->i] == '}'))
-                {        
-                    context->depth--;                
-                    context->consolidate_closing_delimiters = true;
-                    context->processing_value[context->depth] = false; 
-                } else if (buffer[context->i] == ',')
-                {
-                    //printf("\n");             
-                    context->entity[context->depth][context->j] = 0; 
-                            
-                    context->instance[context->depth]++;
-                    context->entity[context->depth][0] = 0;
-                    context->j = 0;                     
-                }
-                break;
-            case ':':
-                //printf("[depth = %d][instance = %d]", depth, instance[depth]);
-                for (context->k=0; context->k<context->depth; context->k++)
-                {
-                    if(context->entity[context->k][0])
-                    {
-                        //printf("%s", entity[k]);
-                    }
-                    else
-                    {
-                        for(context->l=context->depth-1; context->l>0; context->l--)
-                        {
-                            if (context->instance_delimiter[context->l] == '[') break;
-                        }
-                        //printf("index%d", instance[l]);
-                    }
-                    //printf(".");
-                }
-                context->entity[context->depth][context->j] = 0; 
-                strcpy(context->last_entity, context->entity[context->depth]); 
-                context->j = 0;
+    jsonp_begin(&context, filters, num_filters, callback, callback_arg);
+    jsonp_parse_buffer(&context, json, strlen(json));
 
-                if (context->processing_value[context->depth])
-                {
-                    printf("*MISSING VALUE* before :");
-                    context->processing_value[context->depth] = false;
-                }
-                else
-                {
-                    //printf("%s (Parameter)", last_entity); 
-                }  
-    
-                context->processing_value[context->depth] = true;            
-                
-                //printf("\n");                               
-                break;                        
-            default:
-            context->character_processed = false;
-                break;                                
-            }
-            
-        }
+    if (jsonp_end(&context))
+    {
+        printf("json parser stopped at %s\n", (context.path_length == JSONP_PATH_OVERFLOW) ? "(long path)" : context.path);
+    }
 
-        // process standard characters
-        if (!context->character_processed)
+    for (i = 0; i < num_filters; i++)
+    {
+        if (filters[i].found)
         {
-            if (context->consolidate_closing_delimiters)
-            {
-                //printf("\n");
-                context->consolidate_closing_delimiters = false;
-            }   
-            if (isprint(buffer[context->i]))
-            {            
-                //printf("%c", shelly_json_string[i]);
-                context->entity[context->depth][context->j++] = buffer[context->i];
-            }
+            found++;
         }
-
-        context->i++;
     }
 
-    return(0);
+    return(found);
 }
 
+/*!
+ * \brief Callback printing each value, used to dump a response
+ *
+ * \param[in]   arg         not used
+ * \param[in]   path        path of the value
+ * \param[in]   value       value text
+ *
+ * \return nothing
+ */
+void jsonp_print_value(void *arg, const char *path, const char *value)
+{
+    (void)arg;
 
+    printf("%s = %s\n", path, value);
+}
 
 /*!
- * \brief set all keys 
+ * \brief Advance the state machine by one character
  *
- * \param[in]   key_value value to assign to each key  
- * 
- * \return 0 on success
+ * \param[in]   context     parser state
+ * \param[in]   c           character
+ *
+ * \return nothing
  */
-int jsonp_initialize_all_keys(JSON_PARSER_CONTEXT_T *context, u8_t key_value)
+static void jsonp_character(JSON_PARSER_CONTEXT_T *context, char c)
 {
-    int key_index;
-    int key_heirarchy;
-
-    for(key_index = 0; key_index < NUM_ROWS(context->jsonp_key); key_index++)
+    switch(context->state)
     {
-        for(key_heirarchy = 0; key_heirarchy < NUM_ROWS(context->jsonp_key[0]); key_heirarchy++)
-        {
-            context->jsonp_key[key_index][key_heirarchy] = key_value;
-        }    
+        case JSONP_STATE_VALUE:
+            jsonp_value(context, c);
+            break;
+        case JSONP_STATE_ARRAY_START:
+            if (c == ']')
+            {
+                jsonp_pop(context, c);
+            }
+            else if (!jsonp_is_space(c))
+            {
+                jsonp_value(context, c);
+            }
+            break;
+        case JSONP_STATE_OBJECT_START:
+        case JSONP_STATE_KEY:
+            if ((c == '}') && (context->state == JSONP_STATE_OBJECT_START))
+            {
+                jsonp_pop(context, c);
+            }
+            else if (c == '"')
+            {
+                jsonp_path_to_level(context);
+                jsonp_path_append(context, ".\"", 2);
+                context->state = JSONP_STATE_KEY_STRING;
+            }
+            else if (!jsonp_is_space(c))
+            {
+                context->state = JSONP_STATE_ERROR;
+            }
+            break;
+        case JSONP_STATE_KEY_STRING:
+            jsonp_path_append(context, &c, 1);
+            if (context->escape)
+            {
+                context->escape = false;
+            }
+            else if (c == '\\')
+            {
+                context->escape = true;
+            }
+            else if (c == '"')
+            {
+                context->state = JSONP_STATE_COLON;
+            }
+            break;
+        case JSONP_STATE_COLON:
+            if (c == ':')
+            {
+                context->state = JSONP_STATE_VALUE;
+            }
+            else if (!jsonp_is_space(c))
+            {
+                context->state = JSONP_STATE_ERROR;
+            }
+            break;
+        case JSONP_STATE_STRING:
+            if (context->escape)
+            {
+                context->escape = false;
+            }
+            else if (c == '\\')
+            {
+                context->escape = true;
+            }
+            else if (c == '"')
+            {
+                jsonp_scalar_character(context, c, true);
+                jsonp_scalar_end(context);
+                context->state = context->depth ? JSONP_STATE_NEXT : JSONP_STATE_DONE;
+                break;
+            }
+            jsonp_scalar_character(context, c, false);
+            break;
+        case JSONP_STATE_LITERAL:
+            if (jsonp_is_literal(c))
+            {
+                jsonp_scalar_character(context, c, false);
+            }
+            else
+            {
+                jsonp_scalar_end(context);
+                if (context->depth)
+                {
+                    // the character ending a number is the comma or closing bracket that follows it
+                    jsonp_next(context, c);
+                }
+                else
+                {
+                    context->state = JSONP_STATE_DONE;
+                }
+            }
+            break;
+        case JSONP_STATE_NEXT:
+            jsonp_next(context, c);
+            break;
+        default:
+            break;
     }
-
-    return(0);
 }
 
 /*!
- * \brief set all keys 
+ * \brief Handle the first character of a value
  *
- * \param[in]   key_value value to assign to each key  
- * 
- * \return 0 on success, -1 on error
+ * \param[in]   context     parser state
+ * \param[in]   c           character
+ *
+ * \return nothing
  */
-int jsonp_initialize_row_key(JSON_PARSER_CONTEXT_T *context, int key_index, u8_t key_value)
+static void jsonp_value(JSON_PARSER_CONTEXT_T *context, char c)
 {
-    int err = 0;
-    int key_heirarchy;
-
-    if ((key_index >0) && (key_index < NUM_ROWS(context->jsonp_key)))
+    if (c == '{')
     {
-        for(key_heirarchy = 0; key_heirarchy < NUM_ROWS(context->jsonp_key[0]); key_heirarchy++)
-        {
-            context->jsonp_key[key_index][key_heirarchy] = key_value;
-        }    
+        jsonp_push(context, false);
     }
-    else
+    else if (c == '[')
     {
-        err = -1;
+        jsonp_push(context, true);
+    }
+    else if (c == '"')
+    {
+        jsonp_scalar_start(context);
+        jsonp_scalar_character(context, c, true);
+        context->state = JSONP_STATE_STRING;
+    }
+    else if (jsonp_is_literal(c))
+    {
+        jsonp_scalar_start(context);
+        jsonp_scalar_character(context, c, false);
+        context->state = JSONP_STATE_LITERAL;
+    }
+    else if (!jsonp_is_space(c))
+    {
+        context->state = JSONP_STATE_ERROR;
     }
-
-    return(err);
 }
 
 /*!
- * \brief extract info from shelly json response
+ * \brief Handle the character after a value inside an object or array
+ *
+ * \param[in]   context     parser state
+ * \param[in]   c           character
  *
- * \param[in]   value_string value to assign to each value   
- * 
- * \return 0 on success
+ * \return nothing
  */
-int jsonp_initialize_all_values(JSON_PARSER_CONTEXT_T *context, char *value_string)
+static void jsonp_next(JSON_PARSER_CONTEXT_T *context, char c)
 {
-    int value_index;
-
-    for(value_index = 0; value_index < NUM_ROWS(context->jsonp_value); value_index++)
+    if (c == ',')
     {
-        if (value_string && (value_string[0] != 0))
+        if (context->level_array & (1 << context->depth))
         {
-            STRNCPY(context->jsonp_value[value_index], value_string, sizeof(context->jsonp_value[0]));
+            context->level_index[context->depth]++;
+            jsonp_element_path(context);
+            context->state = JSONP_STATE_VALUE;
         }
         else
         {
-           context->jsonp_value[value_index][0] = 0; 
+            context->state = JSONP_STATE_KEY;
         }
     }
-
-    return(0);
+    else if ((c == '}') || (c == ']'))
+    {
+        jsonp_pop(context, c);
+    }
+    else if (jsonp_is_space(c))
+    {
+        context->state = JSONP_STATE_NEXT;
+    }
+    else
+    {
+        context->state = JSONP_STATE_ERROR;
+    }
 }
 
 /*!
- * \brief set all tokens to empty string 
- * 
- * \return 0 on success
+ * \brief Enter an object or array
+ *
+ * \param[in]   context     parser state
+ * \param[in]   array       true for an array
+ *
+ * \return nothing
  */
-int jsonp_initialize_all_tokens(JSON_PARSER_CONTEXT_T *context)
+static void jsonp_push(JSON_PARSER_CONTEXT_T *context, bool array)
 {
-    int token_index;
-
-    for(token_index = 0; token_index < NUM_ROWS(context->jsonp_token); token_index++)
+    if (context->depth >= JSONP_MAX_DEPTH)
     {
-        context->jsonp_token[token_index][0] = 0; 
+        context->state = JSONP_STATE_ERROR;
+        return;
     }
 
-    return(0);
+    context->depth++;
+    context->level_path[context->depth] = context->path_length;
+    context->level_hash[context->depth] = context->path_hash;
+    context->level_index[context->depth] = 0;
+
+    if (array)
+    {
+        context->level_array |= (1 << context->depth);
+        jsonp_element_path(context);
+        context->state = JSONP_STATE_ARRAY_START;
+    }
+    else
+    {
+        context->level_array &= ~(1 << context->depth);
+        context->state = JSONP_STATE_OBJECT_START;
+    }
 }
 
 /*!
- * \brief add string to token cache and return token
+ * \brief Leave an object or array
  *
- * \param[in]   token_string string to tokenize  
- * 
- * \return token or -1 on error
+ * \param[in]   context     parser state
+ * \param[in]   c           closing bracket, must match the opening one
+ *
+ * \return nothing
  */
-int jsonp_insert_token_string(JSON_PARSER_CONTEXT_T *context, char *token_string)
+static void jsonp_pop(JSON_PARSER_CONTEXT_T *context, char c)
 {
-    int token_index;
+    bool array = (context->level_array & (1 << context->depth)) != 0;
 
-    for(token_index = 0; token_index < NUM_ROWS(context->jsonp_token); token_index++)
+    if (array != (c == ']'))
     {
-        if (strcasecmp(token_string, context->jsonp_token[token_index]) == 0)
-        {
-            // found existing entry
-            break;
-        }
-        else if (context->jsonp_token[token_index][0] == 0)
-        {
-            // found unused token so assign
-            STRNCPY(context->jsonp_token[token_index], token_string, sizeof(context->jsonp_token[0]));
-            break;
-        }
-    }
-
-    if (token_index >= NUM_ROWS(context->jsonp_token))
-    {
-        // out of space in token table
-        token_index = -1;
-        printf("***********************************************OUT OF TOKENS!");
+        context->state = JSONP_STATE_ERROR;
+        return;
     }
 
-    return(token_index);
+    jsonp_path_to_level(context);
+    context->depth--;
+    context->state = context->depth ? JSONP_STATE_NEXT : JSONP_STATE_DONE;
 }
 
+/*!
+ * \brief Set the path to the current element of the innermost array
+ *
+ * \param[in]   context     parser state
+ *
+ * \return nothing
+ */
+static void jsonp_element_path(JSON_PARSER_CONTEXT_T *context)
+{
+    char index[FFMT_NUMBER_MAX];
+    int length;
+
+    jsonp_path_to_level(context);
+    jsonp_path_append(context, ".index", 6);
+    length = ffmt_uint(index, sizeof(index), context->level_index[context->depth]);
+    jsonp_path_append(context, index, length);
+}
 
 /*!
- * \brief get an index to an empty kvp cache row
- * 
- * \return key-value-pair index on success, -1 on error
+ * \brief Start a string, number or literal value and find the filter that wants it
+ *
+ * \param[in]   context     parser state
+ *
+ * \return nothing
  */
-int jsonp_get_free_kvp_row(JSON_PARSER_CONTEXT_T *context)
+static void jsonp_scalar_start(JSON_PARSER_CONTEXT_T *context)
 {
-    int kvp_index = 0;
-    
-    for(kvp_index = 0; kvp_index < NUM_ROWS(context->jsonp_key); kvp_index++)
+    int i;
+
+    context->capture = NULL;
+    context->captured = 0;
+    context->value_length = 0;
+
+    if (context->path_length == JSONP_PATH_OVERFLOW)
     {
-        if (context->jsonp_key[kvp_index][0] == 255)
-        {
-            // found a free row
-            break;
-        } 
+        return;
     }
 
-    if (kvp_index >= NUM_ROWS(context->jsonp_key))
+    for (i = 0; i < context->num_filters; i++)
     {
-        kvp_index = -1;
+        if ((context->filters[i].hash == context->path_hash) && (context->filters[i].value_length > 0) &&
+            (strcasecmp(context->filters[i].path, context->path) == 0))
+        {
+            context->capture = &context->filters[i];
+            break;
+        }
     }
-
-    return(kvp_index);
 }
 
 /*!
- * \brief add token to heirarchy for given kvp cache row
- * 
- * \return 0 on success, -1 on error
+ * \brief Copy one character of a value to the filter that wants it and the callback text
+ *
+ * \param[in]   context     parser state
+ * \param[in]   c           character
+ * \param[in]   quote       c is the opening or closing quote of a string
+ *
+ * \return nothing
  */
-int jsonp_append_token_to_key_heirarchy(JSON_PARSER_CONTEXT_T *context, int kvp_index, u8_t key_token)
+static void jsonp_scalar_character(JSON_PARSER_CONTEXT_T *context, char c, bool quote)
 {
-    int err = -1;
-    int key_heirarchy = 0;
-    
-    if ((kvp_index >=0) && (kvp_index < NUM_ROWS(context->jsonp_key)))
-    {
+    JSONP_FILTER_T *filter = context->capture;
 
-        for(key_heirarchy = 0; key_heirarchy < NUM_ROWS(context->jsonp_key[0]); key_heirarchy++)
-        {
-            if (context->jsonp_key[kvp_index][key_heirarchy] == 255)
-            {
-                // found space to append to key heirarchy in this row
-                context->jsonp_key[kvp_index][key_heirarchy] = key_token;
-                err = 0;
-                break;
-            }
-        }           
-        
+    if (filter && !(quote && filter->strip_quotes) && (context->captured < filter->value_length - 1))
+    {
+        filter->value[context->captured++] = c;
     }
 
-    return(err);
+    if (context->callback && (context->value_length < JSONP_VALUE_MAX - 1))
+    {
+        context->value[context->value_length++] = c;
+    }
 }
 
 /*!
- * \brief add token to heirarchy for given kvp cache row
- * 
- * \return 0 on success, -1 on error
+ * \brief Finish a string, number or literal value
+ *
+ * \param[in]   context     parser state
+ *
+ * \return nothing
  */
-int jsonp_append_string_to_key_heirarchy(JSON_PARSER_CONTEXT_T *context, int kvp_index, char *key_string)
+static void jsonp_scalar_end(JSON_PARSER_CONTEXT_T *context)
 {
-    int err = -1;
-    int key_heirarchy = 0;
-    int token = 0;
-
-   
-    if ((kvp_index >=0) && (kvp_index < NUM_ROWS(context->jsonp_key)))
+    if (context->capture)
     {
-        // tokenize and append
-        token = jsonp_insert_token_string(context, key_string);
-        err = jsonp_append_token_to_key_heirarchy(context, kvp_index, token);             
+        context->capture->value[context->captured] = 0;
+        context->capture->found = true;
+        context->capture = NULL;
     }
 
-    return(err);
+    if (context->callback)
+    {
+        context->value[context->value_length] = 0;
+        context->callback(context->callback_arg, (context->path_length == JSONP_PATH_OVERFLOW) ? "(long path)" : context->path, context->value);
+    }
 }
 
-
-
 /*!
- * \brief add value to cache
+ * \brief Append text to the path, a path that does not fit is marked as overflowed until it is cut back
+ *
+ * \param[in]   context     parser state
+ * \param[in]   text        text to append
+ * \param[in]   length      length of text
  *
- * \param[in]   kvp_index key-value-pair index 
- * 
- * \return 0 on success, -1 on error
+ * \return nothing
  */
-int jsonp_insert_value(JSON_PARSER_CONTEXT_T *context, int kvp_index, char *value)
+static void jsonp_path_append(JSON_PARSER_CONTEXT_T *context, const char *text, int length)
 {
-    int err = 0;
+    if (context->path_length == JSONP_PATH_OVERFLOW)
+    {
+        return;
+    }
 
-    if ((kvp_index >= 0) && (kvp_index < NUM_ROWS(context->jsonp_value)))
+    if (context->path_length + length >= JSONP_PATH_MAX)
     {
-        STRNCPY(context->jsonp_value[kvp_index], value, sizeof(context->jsonp_value[0]));
+        context->path_length = JSONP_PATH_OVERFLOW;
+        return;
     }
 
-    return(err);
+    memcpy(context->path + context->path_length, text, length);
+    context->path_length += length;
+    context->path[context->path_length] = 0;
+    context->path_hash = jsonp_hash(context->path_hash, text, length);
 }
 
 /*!
- * \brief clear cache used to store shelly device responses
- * 
- * \return 0 on success, -1 on error
+ * \brief Cut the path back to the path of the innermost object or array
+ *
+ * \param[in]   context     parser state
+ *
+ * \return nothing
  */
-int jsonp_initialize_cache(JSON_PARSER_CONTEXT_T *context)
+static void jsonp_path_to_level(JSON_PARSER_CONTEXT_T *context)
 {
-    jsonp_initialize_all_keys(context, 255);
-    jsonp_initialize_all_values(context, "");
-    jsonp_initialize_all_tokens(context);    
+    context->path_length = context->level_path[context->depth];
+    context->path_hash = context->level_hash[context->depth];
 
-    return(0);
+    if (context->path_length != JSONP_PATH_OVERFLOW)
+    {
+        context->path[context->path_length] = 0;
+    }
 }
 
 /*!
- * \brief print cached key value pairs
- * 
- * \return 0 on success, -1 on error
+ * \brief Continue a case insensitive FNV-1a hash over more text
+ *
+ * \param[in]   hash        hash so far, JSONP_HASH_BASIS to start
+ * \param[in]   text        text to add
+ * \param[in]   length      length of text
+ *
+ * \return hash
  */
-int jsonp_dump_key_value_pairs(JSON_PARSER_CONTEXT_T *context)
+static uint32_t jsonp_hash(uint32_t hash, const char *text, int length)
 {
-    int key_index;
-    int key_heirarchy;
+    char c;
+    int i;
 
-    for(key_index = 0; key_index < NUM_ROWS(context->jsonp_key); key_index++)
+    for (i = 0; i < length; i++)
     {
-        if (context->jsonp_key[key_index][0] != 255)
+        c = text[i];
+        if ((c >= 'A') && (c <= 'Z'))
         {
-            printf("KEY_%03d = ", key_index);
-            for(key_heirarchy = 0; key_heirarchy < NUM_ROWS(context->jsonp_key[0]); key_heirarchy++)
-            {
-                if (context->jsonp_key[key_index][key_heirarchy] != 255)
-                {
-                    if (key_heirarchy > 0)
-                    {
-                        printf(".%s", context->jsonp_token[context->jsonp_key[key_index][key_heirarchy]]);
-                    }
-                    else
-                    {
-                        printf("%s", context->jsonp_token[context->jsonp_key[key_index][key_heirarchy]]);
-                    }
-                }
-            } 
-
-            printf(" VALUE =");
-            printf("%s\n", context->jsonp_value[key_index]);
+            c += 'a' - 'A';
         }
+        hash ^= (uint8_t)c;
+        hash *= 0x01000193;
     }
 
-    return(0);
+    return(hash);
 }
 
 /*!
- * \brief clear cache used to store shelly device responses
- * 
- * \return 0 on success, -1 on error
+ * \brief Check for json whitespace
+ *
+ * \param[in]   c           character
+ *
+ * \return true if c is whitespace
  */
-int jsonp_dump_tokens(JSON_PARSER_CONTEXT_T *context)
+static bool jsonp_is_space(char c)
 {
-    int token_index;
-
-    for(token_index = 0; token_index < NUM_ROWS(context->jsonp_token); token_index++)
-    {
-        if (context->jsonp_token[token_index][0] != 0)
-        {
-            printf("TOKEN_%03d = %s\n", token_index, context->jsonp_token[token_index]);
-
-        } 
-    }
-
-    return(0);
+    return((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'));
 }
 
-
 /*!
- * \brief Retrieve the value matching a given key from the json cache
- * 
- * \param[in]   key             key to find
- * 
- * \param[out]  value           value found
- * 
- * \param[in]   value_length    max length of value
- * 
- * \param[in]   strip_quotes    remove outer quotes from value (if present)
- *     
- * \return 0 on success, -1 on error
+ * \brief Check for a character of a number, true, false or null
+ *
+ * \param[in]   c           character
+ *
+ * \return true if c can be part of a literal
  */
-int jsonp_get_value(JSON_PARSER_CONTEXT_T *context, const char *key, char *value, int value_length, bool strip_quotes)
+static bool jsonp_is_literal(char c)
 {
-    int key_index;
-    int key_heirarchy;
-    char search_key[256];
-    int err = 1;
-
-    for(key_index = 0; key_index < NUM_ROWS(context->jsonp_key); key_index++)
-    {
-        if (context->jsonp_key[key_index][0] != 255)
-        {
-            // begin constructing new search key
-            search_key[0] = 0;
-
-            //printf("KEY_%03d = ", key_index);
-            for(key_heirarchy = 0; key_heirarchy < NUM_ROWS(context->jsonp_key[0]); key_heirarchy++)
-            {
-                if (context->jsonp_key[key_index][key_heirarchy] != 255)
-                {
-                    if (key_heirarchy > 0)
-                    {                        
-                        STRAPPEND(search_key, ".");
-                        //printf(".%s", shelly_token[shelly_key[key_index][key_heirarchy]]);
-                    }
-                    else
-                    {
-                        //printf("%s", shelly_token[shelly_key[key_index][key_heirarchy]]);
-                    }
-                    STRAPPEND(search_key, context->jsonp_token[context->jsonp_key[key_index][key_heirarchy]]);
-                }
-            } 
-
-            //printf(" VALUE =");
-            //printf("%s\n", shelly_value[key_index]);
-
-            if (!strncasecmp(search_key, key, strlen(key)))
-            {
-                //printf("***MATCH****\n");
-                STRNCPY(value, context->jsonp_value[key_index], value_length);  //TODO copy with outer quote removal
-                err = 0;
-            }
-        }
-    }
-
-    return(err);
-}
\ No newline at end of file
+    return(((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+           (c == '-') || (c == '+') || (c == '.'));
+}
@@ -1,37 +1,73 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
 #ifndef JSON_PARSER_H
 #define JSON_PARSER_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JSONP_MAX_DEPTH         (12)        // nesting deeper than this is a parse error
+#define JSONP_PATH_MAX          (128)       // longer paths are not matched, must be less than 255
+#define JSONP_VALUE_MAX         (64)        // value text passed to the callback, longer values are truncated
+
+// a value the caller wants, the path must match in full (ignoring case), e.g. {"root.\"grid_status\"", grid_status, sizeof(grid_status), false}
+typedef struct
+{
+    const char *path;           // "root" then ."key" for each object member and .indexN for each array element
+    char *value;                // receives the value text as sent, truncated to fit and nul terminated
+    int value_length;           // size of value
+    bool strip_quotes;          // leave out the quotes around a string value
+    bool found;                 // set by the parser
+    uint32_t hash;              // hash of path, worked out by jsonp_begin
+} JSONP_FILTER_T;
+
+// called for every scalar value with its path
+typedef void (*JSONP_CALLBACK_T)(void *arg, const char *path, const char *value);
+
+typedef enum
+{
+    JSONP_STATE_VALUE = 0,
+    JSONP_STATE_ARRAY_START,
+    JSONP_STATE_OBJECT_START,
+    JSONP_STATE_KEY,
+    JSONP_STATE_KEY_STRING,
+    JSONP_STATE_COLON,
+    JSONP_STATE_STRING,
+    JSONP_STATE_LITERAL,
+    JSONP_STATE_NEXT,
+    JSONP_STATE_DONE,
+    JSONP_STATE_ERROR
+} JSONP_STATE_T;
+
 typedef struct
 {
-    int depth;
-    int comma_instance;
-    int i;
-    int j;
-    int k;
-    int l;
-    bool consolidate_closing_delimiters;
-    char instance_delimiter[16];
-    int instance[16]; 
-    char entity[8][32];  // TEMP TESTING
-    char last_entity[32];
-    bool processing_value[8];
-    bool quotation;
-    bool character_processed;
-    char key[64];
-    char value[64];
-    char indexstring[16];
-    int kvp_index;
-    char jsonp_token[128][32];
-    u8_t jsonp_key[255][8];
-    char jsonp_value[255][128];
+    JSONP_FILTER_T *filters;
+    int num_filters;
+    JSONP_CALLBACK_T callback;
+    void *callback_arg;
+    JSONP_FILTER_T *capture;                // filter receiving the value being parsed
+    int captured;                           // characters written to the filter value
+    int value_length;                       // characters written to value
+    uint8_t state;
+    bool escape;                            // previous string character was a backslash
+    uint8_t depth;                          // open objects and arrays
+    uint8_t path_length;                    // JSONP_PATH_OVERFLOW once the path no longer fits
+    uint32_t path_hash;                     // hash of path, kept up to date as it is built
+    uint8_t level_path[JSONP_MAX_DEPTH+1];  // path length of each open object or array
+    uint32_t level_hash[JSONP_MAX_DEPTH+1]; // path hash of each open object or array
+    uint16_t level_index[JSONP_MAX_DEPTH+1];// element number in each open array
+    uint16_t level_array;                   // bit per depth, set for arrays
+    char path[JSONP_PATH_MAX];
+    char value[JSONP_VALUE_MAX];            // only filled in when there is a callback
 } JSON_PARSER_CONTEXT_T;
 
-int jsonp_initialize_context(JSON_PARSER_CONTEXT_T *context);
-int jsonp_initialize_cache(JSON_PARSER_CONTEXT_T *context);
-int jsonp_parse_buffer(JSON_PARSER_CONTEXT_T *context, char *buffer, bool continuation);
-int jsonp_dump_key_value_pairs(JSON_PARSER_CONTEXT_T *context);
-int jsonp_dump_tokens(JSON_PARSER_CONTEXT_T *context);
-int jsonp_discover_shelly_devices(void);
-int jsonp_get_value(JSON_PARSER_CONTEXT_T *context, const char *key, char *value, int value_length, bool strip_quotes);
+void jsonp_begin(JSON_PARSER_CONTEXT_T *context, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *callback_arg);
+int jsonp_parse_buffer(JSON_PARSER_CONTEXT_T *context, const char *buffer, int length);
+int jsonp_end(JSON_PARSER_CONTEXT_T *context);
+int jsonp_parse_string(const char *json, JSONP_FILTER_T *filters, int num_filters, JSONP_CALLBACK_T callback, void *callback_arg);
+void jsonp_print_value(void *arg, const char *path, const char *value);
 
 #endif
@@ -0,0 +1,371 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <string.h>
+
+#include "json_writer.h"
+#include "fixed_format.h"
+
+/*
+ * Bounded json writer
+ *
+ * Builds a json document directly in a fixed buffer, inserting commas and escaping strings.  Once the buffer is full
+ * every further call is ignored and jsonw_finish() reports the failure, so callers need only check once at the end.
+ */
+
+// NB: this file must not depend on lwIP or the pico sdk so that api_bench can check the responses it builds against the schema
+
+// prototypes
+static void jsonw_put(JSON_WRITER_T *writer, const char *text, int length);
+static void jsonw_member(JSON_WRITER_T *writer, const char *key);
+static void jsonw_quoted(JSON_WRITER_T *writer, const char *text);
+static void jsonw_open(JSON_WRITER_T *writer, const char *key, char bracket);
+static void jsonw_close(JSON_WRITER_T *writer, char bracket);
+
+/*!
+ * \brief Start a json document
+ *
+ * \param[out]  writer    writer state
+ * \param[in]   buffer    destination
+ * \param[in]   size      size of destination including nul terminator
+ *
+ * \return nothing
+ */
+void jsonw_init(JSON_WRITER_T *writer, char *buffer, int size)
+{
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->depth = 0;
+    writer->overflow = (size < 1);
+    writer->first[0] = true;
+
+    if (size > 0)
+    {
+        buffer[0] = 0;
+    }
+}
+
+/*!
+ * \brief Finish a json document
+ *
+ * \param[in]   writer    writer state
+ *
+ * \return length of document or -1 if it did not fit or is unbalanced
+ */
+int jsonw_finish(JSON_WRITER_T *writer)
+{
+    if (writer->overflow || writer->depth)
+    {
+        return(-1);
+    }
+
+    return(writer->length);
+}
+
+/*!
+ * \brief Start an object
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ *
+ * \return nothing
+ */
+void jsonw_object_begin(JSON_WRITER_T *writer, const char *key)
+{
+    jsonw_open(writer, key, '{');
+}
+
+/*!
+ * \brief End an object
+ *
+ * \param[in]   writer    writer state
+ *
+ * \return nothing
+ */
+void jsonw_object_end(JSON_WRITER_T *writer)
+{
+    jsonw_close(writer, '}');
+}
+
+/*!
+ * \brief Start an array
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ *
+ * \return nothing
+ */
+void jsonw_array_begin(JSON_WRITER_T *writer, const char *key)
+{
+    jsonw_open(writer, key, '[');
+}
+
+/*!
+ * \brief End an array
+ *
+ * \param[in]   writer    writer state
+ *
+ * \return nothing
+ */
+void jsonw_array_end(JSON_WRITER_T *writer)
+{
+    jsonw_close(writer, ']');
+}
+
+/*!
+ * \brief Write an integer
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   value     value to write
+ *
+ * \return nothing
+ */
+void jsonw_int(JSON_WRITER_T *writer, const char *key, int32_t value)
+{
+    jsonw_fixed(writer, key, value, 0);
+}
+
+/*!
+ * \brief Write an unsigned 64 bit integer, e.g. a microsecond timestamp
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   value     value to write
+ *
+ * \return nothing
+ */
+void jsonw_uint64(JSON_WRITER_T *writer, const char *key, uint64_t value)
+{
+    char text[FFMT_NUMBER_MAX];
+    int length;
+
+    jsonw_member(writer, key);
+    length = ffmt_uint64(text, sizeof(text), value);
+    jsonw_put(writer, text, length);
+}
+
+/*!
+ * \brief Write a fixed point number, e.g. value 215 with 1 decimal is written as 21.5
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   value     value scaled by 10^decimals
+ * \param[in]   decimals  digits after the decimal point
+ *
+ * \return nothing
+ */
+void jsonw_fixed(JSON_WRITER_T *writer, const char *key, int32_t value, int decimals)
+{
+    char text[FFMT_NUMBER_MAX];
+    int length;
+
+    jsonw_member(writer, key);
+    length = ffmt_fixed(text, sizeof(text), value, decimals, 0);
+    jsonw_put(writer, text, length);
+}
+
+/*!
+ * \brief Write true or false
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   value     value to write
+ *
+ * \return nothing
+ */
+void jsonw_bool(JSON_WRITER_T *writer, const char *key, bool value)
+{
+    jsonw_member(writer, key);
+
+    if (value)
+    {
+        jsonw_put(writer, "true", 4);
+    }
+    else
+    {
+        jsonw_put(writer, "false", 5);
+    }
+}
+
+/*!
+ * \brief Write null
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ *
+ * \return nothing
+ */
+void jsonw_null(JSON_WRITER_T *writer, const char *key)
+{
+    jsonw_member(writer, key);
+    jsonw_put(writer, "null", 4);
+}
+
+/*!
+ * \brief Write a string, escaping as required
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   value     nul terminated string
+ *
+ * \return nothing
+ */
+void jsonw_string(JSON_WRITER_T *writer, const char *key, const char *value)
+{
+    jsonw_member(writer, key);
+    jsonw_quoted(writer, value);
+}
+
+/*!
+ * \brief Append raw text
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   text      text to append
+ * \param[in]   length    length of text
+ *
+ * \return nothing
+ */
+static void jsonw_put(JSON_WRITER_T *writer, const char *text, int length)
+{
+    if (writer->overflow)
+    {
+        return;
+    }
+
+    // keep room for the nul terminator
+    if (writer->length + length >= writer->size)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+    writer->buffer[writer->length] = 0;
+}
+
+/*!
+ * \brief Write the separator and name that precede a value
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ *
+ * \return nothing
+ */
+static void jsonw_member(JSON_WRITER_T *writer, const char *key)
+{
+    if (!writer->first[writer->depth])
+    {
+        jsonw_put(writer, ",", 1);
+    }
+    writer->first[writer->depth] = false;
+
+    if (key)
+    {
+        jsonw_quoted(writer, key);
+        jsonw_put(writer, ":", 1);
+    }
+}
+
+/*!
+ * \brief Write a quoted string
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   text      nul terminated string
+ *
+ * \return nothing
+ */
+static void jsonw_quoted(JSON_WRITER_T *writer, const char *text)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *run = text;
+    char escape[6];
+
+    jsonw_put(writer, "\"", 1);
+
+    // copy runs of plain characters in one go
+    for (; *text; text++)
+    {
+        if ((*text == '"') || (*text == '\\') || ((unsigned char)*text < 0x20))
+        {
+            jsonw_put(writer, run, text - run);
+            run = text + 1;
+
+            escape[0] = '\\';
+            switch(*text)
+            {
+                case '"':
+                case '\\':
+                    escape[1] = *text;
+                    jsonw_put(writer, escape, 2);
+                    break;
+                case '\n':
+                    jsonw_put(writer, "\\n", 2);
+                    break;
+                case '\r':
+                    jsonw_put(writer, "\\r", 2);
+                    break;
+                case '\t':
+                    jsonw_put(writer, "\\t", 2);
+                    break;
+                default:
+                    escape[1] = 'u';
+                    escape[2] = '0';
+                    escape[3] = '0';
+                    escape[4] = hex[(*text >> 4) & 0xF];
+                    escape[5] = hex[*text & 0xF];
+                    jsonw_put(writer, escape, 6);
+                    break;
+            }
+        }
+    }
+
+    jsonw_put(writer, run, text - run);
+    jsonw_put(writer, "\"", 1);
+}
+
+/*!
+ * \brief Open an object or array
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   key       member name or NULL
+ * \param[in]   bracket   opening character
+ *
+ * \return nothing
+ */
+static void jsonw_open(JSON_WRITER_T *writer, const char *key, char bracket)
+{
+    jsonw_member(writer, key);
+    jsonw_put(writer, &bracket, 1);
+
+    if (writer->depth >= JSONW_MAX_DEPTH)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    writer->depth++;
+    writer->first[writer->depth] = true;
+}
+
+/*!
+ * \brief Close an object or array
+ *
+ * \param[in]   writer    writer state
+ * \param[in]   bracket   closing character
+ *
+ * \return nothing
+ */
+static void jsonw_close(JSON_WRITER_T *writer, char bracket)
+{
+    if (writer->depth > 0)
+    {
+        writer->depth--;
+    }
+
+    jsonw_put(writer, &bracket, 1);
+}
@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JSONW_MAX_DEPTH     (8)
+
+// writes json into a caller supplied buffer, no allocation -- output is always nul terminated
+typedef struct
+{
+    char *buffer;
+    int size;
+    int length;
+    int depth;
+    bool overflow;                      // buffer too small or nesting too deep, output is unusable
+    bool first[JSONW_MAX_DEPTH + 1];    // no member written yet at this depth
+} JSON_WRITER_T;
+
+void jsonw_init(JSON_WRITER_T *writer, char *buffer, int size);
+int jsonw_finish(JSON_WRITER_T *writer);
+
+// key is NULL for the root value and for array elements
+void jsonw_object_begin(JSON_WRITER_T *writer, const char *key);
+void jsonw_object_end(JSON_WRITER_T *writer);
+void jsonw_array_begin(JSON_WRITER_T *writer, const char *key);
+void jsonw_array_end(JSON_WRITER_T *writer);
+void jsonw_int(JSON_WRITER_T *writer, const char *key, int32_t value);
+void jsonw_uint64(JSON_WRITER_T *writer, const char *key, uint64_t value);
+void jsonw_fixed(JSON_WRITER_T *writer, const char *key, int32_t value, int decimals);
+void jsonw_bool(JSON_WRITER_T *writer, const char *key, bool value);
+void jsonw_null(JSON_WRITER_T *writer, const char *key);
+void jsonw_string(JSON_WRITER_T *writer, const char *key, const char *value);
+
+#endif
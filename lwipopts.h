@@ -16,12 +16,19 @@
 #define SNTP_UPDATE_DELAY           (3600000)
 void setTimeSec(uint32_t sec);
 #define SNTP_SET_SYSTEM_TIME(sec)   setTimeSec(sec)
+void setTimeUs(uint32_t sec, uint32_t us);
+#define SNTP_SET_SYSTEM_TIME_US(sec, us)   setTimeUs(sec, us)   // sub-second resolution for clock_sync.c
 #define MEMP_NUM_SYS_TIMEOUT        (LWIP_NUM_SYS_TIMEOUT_INTERNAL+1)
 #define LWIP_DHCP_MAX_NTP_SERVERS   (4)
 //#define HTTPD_FSDATA_FILE           "htmldata.c"
 #define LWIP_HTTPD_SSI_INCLUDE_TAG  (0)
 #define LWIP_HTTPD_SSI              (1)
+#define LWIP_HTTPD_SSI_RAW          (1)      // tag names passed to ssi_raw_handler() which looks them up by perfect hash
+#define LWIP_HTTPD_SSI_BY_FILE_EXTENSION (0) // only htmldata.c files flagged FS_FILE_FLAGS_SSI are scanned, not pages ssi_render.c has rendered
 #define LWIP_HTTPD_CGI              (1)
+#define LWIP_HTTPD_CUSTOM_FILES     (1)      // generated responses in custom_files.c
+#define LWIP_HTTPD_DYNAMIC_FILE_READ (1)     // custom files are read piecewise into the tcp send buffer
+#define LWIP_HTTPD_FS_ASYNC_READ    (1)      // streams such as /events wait for data without closing the connection
 #define DNS_TABLE_SIZE              (16)   // newman added
 
 // generic
@@ -3,24 +3,402 @@
 # This script is by @rspeir on GitHub: 
 # https://github.com/krzmaz/pico-w-webservlser-example/pull/1/files/4b3e78351dd236f213da9bebbb20df690d470476#diff-e675c4a367e382db6f9ba61833a58c62029d8c71c3156a9f238b612b69de279d
 # Renamed output to avoid linking incorrect file
+#
+# Pages are taken from ../html_common overlaid by ./html_files (a personality's own copy of a file wins).  HTML, CSS
+# and JS are minified with SSI tags left untouched, <style> and <script> blocks repeated across pages are moved into
+# shared files and static .css/.js/.ico/.svg files are renamed with a content hash so that browsers can cache them forever.
+# Only the renamed files are gzipped (see below).  Minifiers leave string literals and attribute values as written, and
+# every minified page is checked against its source so the build stops if anything other than whitespace and comments
+# changed.
 
 import os
+import re
+import gzip
+import hashlib
 import binascii
+import sys
+
+# files flagged FS_FILE_FLAGS_SSI for httpd to parse for tags -- content is dynamic so cannot be compressed or cached
+ssi_extensions = ('.shtml', '.shtm', '.ssi', '.xml', '.json')
+
+# static files are only served gzipped if that saves at least this fraction
+min_compression_saving = 0.1
+
+# static files that pages refer to, renamed with a content hash and served gzipped under that name
+fingerprinted_extensions = ('.css', '.js', '.ico', '.svg')
+
+# pages common to every personality
+common_dir = '../html_common'
+
+# inline <style>/<script> blocks found in at least this many pages are moved into a shared file
+min_shared_pages = 2
+
+# static files with a content hash in their name, e.g. pluto.3f2a9c1d.css, never change so may be cached forever
+immutable_pattern = re.compile(r'\.[0-9a-f]{8,}\.[a-z]+$')
+
+ssi_tag_pattern = re.compile(r'<!--#.*?-->', re.S)
+ssi_placeholder_pattern = re.compile(r'\x00\d+\x00')
+html_comment_pattern = re.compile(r'<!--(?!#).*?-->', re.S)
+html_verbatim_pattern = re.compile(r'(<script\b[^>]*>.*?</script>|<style\b[^>]*>.*?</style>|<pre\b.*?</pre>|<textarea\b.*?</textarea>)', re.S | re.I)
+html_tag_pattern = re.compile(r'(<[a-zA-Z/!](?:"[^"]*"|\'[^\']*\'|[^\'">])*>)')
+html_quoted_pattern = re.compile(r'("[^"]*"|\'[^\']*\')')
+inline_block_pattern = re.compile(r'<(style|script)>(.*?)</\1>', re.S)
+
+# css is split into strings, comments and everything else so that the whitespace rules never reach inside a string
+css_token_pattern = re.compile(r'("(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\'|/\*.*?\*/)', re.S)
+
+# a / after one of these (or after nothing) starts a regular expression rather than a division
+js_regex_after = set('(,=:[!&|?{};+-*%<>~^')
+js_regex_after_words = ('return', 'typeof', 'case', 'do', 'else', 'in', 'of', 'new', 'delete', 'void', 'throw', 'instanceof', 'yield', 'await')
+
+# removing the space between these would make a different token, e.g. a - -b or a / /x/
+js_space_pairs = ('++', '--', '+-', '-+', '//', '/*')
+
+def protect_ssi_tags(text):
+    # swap SSI tags for placeholders that no minifier rule will touch
+    tags = ssi_tag_pattern.findall(text)
+    for i, tag in enumerate(tags):
+        text = text.replace(tag, '\x00{}\x00'.format(i), 1)
+    return text, tags
+
+def restore_ssi_tags(text, tags):
+    for i, tag in enumerate(tags):
+        text = text.replace('\x00{}\x00'.format(i), tag, 1)
+    return text
+
+def collapse_space(text):
+    return re.sub(r'\s+', lambda m: '\n' if '\n' in m.group() else ' ', text)
+
+def css_tokens(css):
+    # (kind, text) pairs where kind is 'string', 'comment' or 'other'
+    tokens = list()
+    for i, piece in enumerate(css_token_pattern.split(css)):
+        if i % 2 == 0:
+            tokens.append(('other', piece))
+        elif piece.startswith('/*'):
+            tokens.append(('comment', piece))
+        else:
+            tokens.append(('string', piece))
+    return tokens
+
+def minify_css(css):
+    css, tags = protect_ssi_tags(css)
+
+    # comments become a space and neighbouring text is joined up so that the rules below see it as one piece
+    pieces = ['']
+    for kind, text in css_tokens(css):
+        if kind == 'string':
+            pieces.extend([text, ''])
+        else:
+            pieces[-1] += ' ' if kind == 'comment' else text
+
+    for i in range(0, len(pieces), 2):
+        text = re.sub(r'\s+', ' ', pieces[i])
+        text = re.sub(r'\s*([{};,>])\s*', r'\1', text)
+        text = re.sub(r':\s+', ':', text)
+        pieces[i] = text.replace(';}', '}')
+
+    return restore_ssi_tags(''.join(pieces).strip(), tags)
+
+def js_scan_quoted(js, i):
+    # index just past the string starting at js[i], a line break ends an unterminated string
+    quote = js[i]
+    i += 1
+    while i < len(js) and js[i] != quote and js[i] != '\n':
+        i += 2 if js[i] == '\\' else 1
+    return min(i + 1, len(js))
+
+def js_scan_template(js, i):
+    # index just past the template literal starting at js[i], including any ${...} it contains
+    i += 1
+    while i < len(js) and js[i] != '`':
+        if js[i] == '\\':
+            i += 2
+        elif js.startswith('${', i):
+            depth = 0
+            i += 1
+            while i < len(js):
+                if js[i] in '"\'':
+                    i = js_scan_quoted(js, i)
+                    continue
+                if js[i] == '`':
+                    i = js_scan_template(js, i)
+                    continue
+                depth += {'{': 1, '}': -1}.get(js[i], 0)
+                i += 1
+                if depth == 0:
+                    break
+        else:
+            i += 1
+    return min(i + 1, len(js))
+
+def js_scan_regex(js, i):
+    # index just past the regular expression literal (and its flags) starting at js[i]
+    in_class = False
+    i += 1
+    while i < len(js) and js[i] != '\n':
+        if js[i] == '\\':
+            i += 1
+        elif js[i] == '[':
+            in_class = True
+        elif js[i] == ']':
+            in_class = False
+        elif js[i] == '/' and not in_class:
+            i += 1
+            break
+        i += 1
+    while i < len(js) and (js[i].isalnum() or js[i] == '_'):
+        i += 1
+    return i
+
+def js_tokens(js):
+    # (kind, text) pairs where kind is 'string', 'comment', 'space', 'word' or 'punct'
+    tokens = list()
+    previous = ''
+    i = 0
+    while i < len(js):
+        c = js[i]
+        if c in '"\'':
+            end, kind = js_scan_quoted(js, i), 'string'
+        elif c == '`':
+            end, kind = js_scan_template(js, i), 'string'
+        elif js.startswith('//', i):
+            end, kind = js.find('\n', i), 'comment'
+            end = len(js) if end < 0 else end
+        elif js.startswith('/*', i):
+            end, kind = js.find('*/', i + 2), 'comment'
+            end = len(js) if end < 0 else end + 2
+        elif c == '/' and (not previous or previous in js_regex_after or previous in js_regex_after_words):
+            end, kind = js_scan_regex(js, i), 'string'
+        elif c.isspace():
+            end, kind = i + 1, 'space'
+            while end < len(js) and js[end].isspace():
+                end += 1
+        elif c == '\x00':
+            end, kind = js.find('\x00', i + 1) + 1, 'word'
+        elif c.isalnum() or c in '_$':
+            end, kind = i + 1, 'word'
+            while end < len(js) and (js[end].isalnum() or js[end] in '_$' or (js[end] == '.' and js[i].isdigit())):
+                end += 1
+        else:
+            end, kind = i + 1, 'punct'
+        tokens.append((kind, js[i:end]))
+        if kind in ('word', 'punct'):
+            previous = js[i:end]
+        elif kind == 'string':
+            previous = 'string'
+        i = end
+    return tokens
+
+def minify_js(js):
+    # comments are dropped and whitespace collapsed outside strings, template literals and regular expressions.  Line
+    # breaks are kept so that automatic semicolon insertion still sees the same statements.
+    js, tags = protect_ssi_tags(js)
+
+    output = list()
+    pending = ''
+    for kind, text in js_tokens(js):
+        if kind in ('space', 'comment'):
+            if '\n' in text:
+                pending = '\n'
+            elif not pending:
+                pending = ' '
+            continue
+        if pending and output:
+            before = output[-1]
+            if pending == '\n':
+                output.append('\n')
+            elif (before[-1].isalnum() or before[-1] in '_$\x00') and (text[0].isalnum() or text[0] in '_$\x00'):
+                output.append(' ')
+            elif (before[-1] + text[0]) in js_space_pairs or (before[0].isdigit() and text[0] == '.'):
+                output.append(' ')
+        pending = ''
+        output.append(text)
+
+    return restore_ssi_tags(''.join(output), tags)
+
+def minify_markup(markup):
+    # drop comments and collapse whitespace runs in text and tags, leaving quoted attribute values as written
+    pieces = html_tag_pattern.split(html_comment_pattern.sub('', markup))
+    for i, piece in enumerate(pieces):
+        if i % 2:
+            piece = ''.join(value if value[:1] in '"\'' else collapse_space(value) for value in html_quoted_pattern.split(piece))
+        else:
+            piece = collapse_space(piece)
+        pieces[i] = piece
+    return ''.join(pieces)
+
+def minify_html(page):
+    page, tags = protect_ssi_tags(page)
+    pieces = html_verbatim_pattern.split(page)
+    for i, piece in enumerate(pieces):
+        if i % 2 == 0:
+            piece = minify_markup(piece)
+        elif piece[:7].lower() == '<script':
+            open_tag, body = piece[:-9].split('>', 1)
+            piece = minify_markup(open_tag + '>') + minify_js(body) + '</script>'
+        elif piece[:6].lower() == '<style':
+            open_tag, body = piece[:-8].split('>', 1)
+            piece = minify_markup(open_tag + '>') + minify_css(body) + '</style>'
+        pieces[i] = piece
+    return restore_ssi_tags(''.join(pieces).strip(), tags)
+
+def significant_tokens(tokens):
+    # tokens that carry meaning, each with a flag saying whether a line break came before it
+    result = list()
+    newline = False
+    for kind, text in tokens:
+        if kind in ('space', 'comment'):
+            newline = newline or ('\n' in text)
+        else:
+            result.append((text, newline and bool(result)))
+            newline = False
+    return result
+
+def without_comments(page):
+    # the page with html, script and style comments removed, and everything else as written
+    page, tags = protect_ssi_tags(page)
+    pieces = html_verbatim_pattern.split(page)
+    for i, piece in enumerate(pieces):
+        if i % 2 == 0:
+            piece = html_comment_pattern.sub('', piece)
+        elif piece[:7].lower() == '<script':
+            open_tag, body = piece[:-9].split('>', 1)
+            piece = open_tag + '>' + ''.join(text for kind, text in js_tokens(body) if kind != 'comment') + '</script>'
+        elif piece[:6].lower() == '<style':
+            open_tag, body = piece[:-8].split('>', 1)
+            piece = open_tag + '>' + ''.join(text for kind, text in css_tokens(body) if kind != 'comment') + '</style>'
+        pieces[i] = piece
+    return restore_ssi_tags(''.join(pieces), tags)
+
+def check_minified(name, original, minified):
+    # the minified page must hold the same SSI tags (other than those in comments), attribute values, text, script
+    # tokens (and line breaks between them) and style strings as the source, and minifying it again must change nothing
+    problems = list()
+    if ssi_tag_pattern.findall(without_comments(original)) != ssi_tag_pattern.findall(minified):
+        problems.append('SSI tags differ')
+    if minify_html(minified) != minified:
+        problems.append('minifying twice changes the page')
+
+    before = html_verbatim_pattern.split(protect_ssi_tags(original)[0])
+    after = html_verbatim_pattern.split(protect_ssi_tags(minified)[0])
+    if len(before) != len(after):
+        problems.append('<script>, <style>, <pre> or <textarea> blocks differ')
+        before = after = list()
+    for i, (a, b) in enumerate(zip(before, after)):
+        if i % 2 == 0:
+            a = html_comment_pattern.sub('', a)
+            a_tags = html_tag_pattern.split(a)[1::2]
+            b_tags = html_tag_pattern.split(b)[1::2]
+            if [html_quoted_pattern.findall(t) for t in a_tags] != [html_quoted_pattern.findall(t) for t in b_tags]:
+                problems.append('attribute values differ')
+            if re.sub(r'\s+', '', a) != re.sub(r'\s+', '', b):
+                problems.append('markup differs')
+        elif a[:7].lower() == '<script':
+            if significant_tokens(js_tokens(a[:-9].split('>', 1)[1])) != significant_tokens(js_tokens(b[:-9].split('>', 1)[1])):
+                problems.append('script differs: ' + a[:40])
+        elif a[:6].lower() == '<style':
+            a_strings = [t for k, t in css_tokens(a) if k == 'string']
+            b_strings = [t for k, t in css_tokens(b) if k == 'string']
+            if a_strings != b_strings:
+                problems.append('style strings differ: ' + a[:40])
+        elif a != b:
+            problems.append('<pre> or <textarea> differs')
+
+    if problems:
+        sys.exit('makefsdata.py: minified {} does not match its source: {}'.format(name, ', '.join(sorted(set(problems)))))
+
+def fingerprint(file, content):
+    base, extension = os.path.splitext(file)
+    return '{}.{}{}'.format(base, hashlib.sha1(content).hexdigest()[:8], extension)
 
 #Create file to write output into
 output = open('htmldata.c', 'w') 
 
-#Traverse directory, generate list of files
-files = list()
-os.chdir('./html_files')
-for(dirpath, dirnames, filenames) in os.walk('.'):
-    files += [os.path.join(dirpath, file) for file in filenames]
+#Traverse directories, personality files override common files of the same name
+sources = dict()
+for directory in (common_dir, './html_files'):
+    for(dirpath, dirnames, names) in os.walk(directory):
+        for name in names:
+            path = os.path.join(dirpath, name)
+            sources['.' + path[len(directory):].replace('\\', '/')] = path
+
+pages = dict()
+assets = dict()
+renamed = dict()
+total_source = 0
+for file in sorted(sources):
+    with open(sources[file], 'rb') as f:
+        content = f.read()
+    total_source += len(content)
+
+    if file.endswith(('.shtml', '.shtm', '.ssi', '.html', '.htm')):
+        pages[file] = minify_html(content.decode('utf-8'))
+        check_minified(file, content.decode('utf-8'), pages[file])
+    elif file.endswith('.css'):
+        renamed[file] = fingerprint(file, content)
+        assets[renamed[file]] = minify_css(content.decode('utf-8')).encode('utf-8')
+    elif file.endswith('.js'):
+        renamed[file] = fingerprint(file, content)
+        assets[renamed[file]] = minify_js(content.decode('utf-8')).encode('utf-8')
+    elif file.endswith(fingerprinted_extensions):
+        renamed[file] = fingerprint(file, content)
+        assets[renamed[file]] = content
+    else:
+        assets[file] = content
+
+#Move repeated inline blocks into shared files
+usage = dict()
+for page in pages.values():
+    for block in set(inline_block_pattern.findall(page)):
+        if '<!--#' not in block[1]:
+            usage[block] = usage.get(block, 0) + 1
+
+for (kind, body), count in usage.items():
+    if count < min_shared_pages:
+        continue
+    if kind == 'style':
+        shared = fingerprint('./style.css', body.encode('utf-8'))
+        reference = '<link rel="stylesheet" href="{}">'.format(shared[1:])
+    else:
+        shared = fingerprint('./script.js', body.encode('utf-8'))
+        reference = '<script src="{}"></script>'.format(shared[1:])
+    assets[shared] = body.encode('utf-8')
+    for file in pages:
+        pages[file] = pages[file].replace('<{0}>{1}</{0}>'.format(kind, body), reference)
+
+#Point pages at the fingerprinted names, dropping assets no page of this personality uses.  httpd only passes the uri
+#to fs_open() so the request's Accept-Encoding cannot be checked: gzip is only sent for fingerprinted names, which a
+#client can only have learnt from a page rendered by a browser, and the original name keeps an uncompressed copy for
+#scripts and other clients that fetch it directly.
+uncompressed = dict()
+for original, fingerprinted in renamed.items():
+    used = False
+    for file in pages:
+        for quote in ('"', "'"):
+            if quote + original[1:] + quote in pages[file]:
+                pages[file] = pages[file].replace(quote + original[1:] + quote, quote + fingerprinted[1:] + quote)
+                used = True
+    if used:
+        uncompressed[original] = assets[fingerprinted]
+    else:
+        del assets[fingerprinted]
+
+files = dict(assets)
+files.update(uncompressed)
+for file, page in pages.items():
+    files[file] = page.encode('utf-8')
 
 filenames = list()
 varnames  = list()
+persistent = list()
+total_raw = 0
+total_wire = 0
+total_blob = 0
+total_gzip_saving = 0
 
 #Generate appropriate HTTP headers
-for file in files:
+for file in sorted(files):
 
     if '404' in file:
         header = "HTTP/1.0 404 File not found\r\n"
@@ -47,10 +425,40 @@ for file in files:
        header += "Content-type: text/css\r\n"
     elif '.svg' in file:
        header += "Content-type: image/svg+xml\r\n"
+    elif '.ico' in file:
+       header += "Content-type: image/x-icon\r\n"
     else:
         header += "Content-type: text/plain\r\n"
 
+    content = files[file]
+    total_raw += len(content)
+
+    if file.endswith(ssi_extensions):
+        # length unknown until tags are expanded
+        header += "Cache-Control: no-store\r\n"
+        is_persistent = False
+    else:
+        compressed = gzip.compress(content, 9, mtime=0)
+        if immutable_pattern.search(file) and (len(compressed) <= len(content) * (1 - min_compression_saving)):
+            total_gzip_saving += len(content) - len(compressed)
+            content = compressed
+            header += "Content-Encoding: gzip\r\n"
+
+        header += "Content-Length: {}\r\n".format(len(content))
+        header += "ETag: \"{}\"\r\n".format(hashlib.sha1(content).hexdigest()[:16])
+
+        if '404' in file:
+            header += "Cache-Control: no-cache\r\n"
+        elif immutable_pattern.search(file):
+            header += "Cache-Control: public, max-age=31536000, immutable\r\n"
+        else:
+            header += "Cache-Control: max-age=86400\r\n"
+        is_persistent = True
+
     header += "\r\n"
+    if file not in uncompressed:
+        total_wire += len(header) + len(content)
+    total_blob += len(file) + len(header) + len(content)
 
     fvar = file[1:]                 #remove leading dot in filename
     fvar = fvar.replace('/', '_')   #replace *nix path separator with underscore
@@ -77,20 +485,19 @@ for file in files:
             count = 0
     output.write("\n\t")
 
-    #finally, dump raw hex data from files
-    with open(file, 'rb') as f:
-        count = 0
-        while(byte := f.read(1)):
-            byte = binascii.hexlify(byte)
-            output.write("0x{}, ".format(byte.decode()))
-            count = count + 1
-            if(count == 10):
-                output.write("\n\t")
-                count = 0
-        output.write("};\n\n")
+    #finally, dump file contents (compressed if that was worthwhile)
+    count = 0
+    for byte in binascii.hexlify(content, b' ', 1).split():
+        output.write("0x{}, ".format(byte.decode()))
+        count = count + 1
+        if(count == 10):
+            output.write("\n\t")
+            count = 0
+    output.write("};\n\n")
 
     filenames.append(file[1:])
     varnames.append(fvar)
+    persistent.append(is_persistent)
 
 for i in range(len(filenames)):
     prevfile = "NULL"
@@ -100,7 +507,17 @@ for i in range(len(filenames)):
     output.write("const struct fsdata_file file{0}[] = {{{{ {1}, data{2}, ".format(varnames[i], prevfile, varnames[i]))
     output.write("data{} + {}, ".format(varnames[i], len(filenames[i]) + 1))
     output.write("sizeof(data{}) - {}, ".format(varnames[i], len(filenames[i]) + 1))
-    output.write("FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT}};\n")
+    flags = "FS_FILE_FLAGS_HEADER_INCLUDED"
+    if persistent[i]:
+        flags += " | FS_FILE_FLAGS_HEADER_PERSISTENT"
+    if filenames[i].endswith(ssi_extensions):
+        #httpd only scans flagged files for tags (LWIP_HTTPD_SSI_BY_FILE_EXTENSION is 0)
+        flags += " | FS_FILE_FLAGS_SSI"
+    output.write(flags + "}};\n")
 
 output.write("\n#define FS_ROOT file{}\n".format(varnames[-1])) 
-output.write("#define FS_NUMFILES {}\n".format(len(filenames)))
\ No newline at end of file
+output.write("#define FS_NUMFILES {}\n".format(len(filenames)))
+
+print("makefsdata.py: {} source files, {} bytes before minification".format(len(sources), total_source))
+print("makefsdata.py: {} files, {} bytes of content, {} bytes on the wire to a browser including headers, blob {} bytes".format(len(filenames), total_raw, total_wire, total_blob))
+print("makefsdata.py: gzip saves {} bytes, {} uncompressed copies for direct requests take {} bytes".format(total_gzip_saving, len(uncompressed), sum(len(c) for c in uncompressed.values())))
@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+
+# Generate a minimal perfect hash over the SSI tag names defined by the SSI_TAGS x-macro in ssi.c
+#
+# Uses hash and displace: each tag is hashed once (FNV-1a, the same function as ssi_tag_index() in ssi_hash.c), the hash
+# picks a bucket and the bucket's displacement is mixed with the hash to pick a slot.  Displacements are chosen so
+# that every tag lands in its own slot and there are exactly as many slots as tags.
+#
+# Output: generated/ssi_hash.h
+
+import os
+import re
+import sys
+
+MASK = 0xFFFFFFFF
+
+def fnv1a(name):
+    h = 0x811C9DC5
+    for c in name.encode('ascii'):
+        h ^= c
+        h = (h * 0x01000193) & MASK
+    return h
+
+def mix(h, displacement):
+    # murmur3 finaliser, must match ssi_tag_index() in ssi_hash.c
+    h = (h ^ ((displacement * 0x9E3779B1) & MASK)) & MASK
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+def read_tags(filename):
+    tags = list()
+    in_macro = False
+    with open(filename) as source:
+        for line in source:
+            if line.startswith('#define SSI_TAGS'):
+                in_macro = True
+                continue
+            if in_macro:
+                match = re.match(r'\s*x\((\w+)\)\s*(\\?)', line)
+                if not match:
+                    break
+                tags.append(match.group(1))
+                if not match.group(2):
+                    break
+    return tags
+
+def build(tags):
+    count = len(tags)
+    buckets = max(1, (count + 3) // 4)
+    hashes = [fnv1a(tag) for tag in tags]
+
+    if len(set(hashes)) != count:
+        sys.exit('makessihash.py: FNV-1a collision between tag names, change a tag name')
+
+    members = [list() for b in range(buckets)]
+    for index, h in enumerate(hashes):
+        members[h % buckets].append(index)
+
+    displacement = [0] * buckets
+    slot_owner = [-1] * count
+
+    # place the most crowded buckets first while there is still plenty of room
+    for bucket in sorted(range(buckets), key=lambda b: -len(members[b])):
+        if not members[bucket]:
+            continue
+        for d in range(1, 65536):
+            slots = [mix(hashes[i], d) % count for i in members[bucket]]
+            if len(set(slots)) == len(slots) and all(slot_owner[s] < 0 for s in slots):
+                displacement[bucket] = d
+                for i, s in zip(members[bucket], slots):
+                    slot_owner[s] = i
+                break
+        else:
+            sys.exit('makessihash.py: no displacement found for bucket %d' % bucket)
+
+    return buckets, displacement, slot_owner
+
+def main():
+    root = os.path.dirname(os.path.abspath(__file__))
+    tags = read_tags(os.path.join(root, 'ssi.c'))
+
+    if not tags:
+        sys.exit('makessihash.py: SSI_TAGS not found in ssi.c')
+
+    buckets, displacement, slot_owner = build(tags)
+
+    output = open(os.path.join(root, 'generated', 'ssi_hash.h'), 'w')
+    output.write('// generated by makessihash.py from the SSI_TAGS list in ssi.c -- do not edit\n')
+    output.write('#ifndef SSI_HASH_H\n#define SSI_HASH_H\n\n')
+    output.write('#define SSI_HASH_TAG_COUNT (%d)\n' % len(tags))
+    output.write('#define SSI_HASH_BUCKETS   (%d)\n\n' % buckets)
+
+    output.write('static const uint16_t ssi_hash_displacement[SSI_HASH_BUCKETS] =\n{\n')
+    for i in range(0, buckets, 12):
+        output.write('    ' + ' '.join('%5d,' % d for d in displacement[i:i+12]) + '\n')
+    output.write('};\n\n')
+
+    output.write('// slot to index into ssi_tags[]\n')
+    output.write('static const uint16_t ssi_hash_slot[SSI_HASH_TAG_COUNT] =\n{\n')
+    for i in range(0, len(slot_owner), 12):
+        output.write('    ' + ' '.join('%5d,' % s for s in slot_owner[i:i+12]) + '\n')
+    output.write('};\n\n#endif\n')
+    output.close()
+
+    print('makessihash.py: %d tags, %d buckets' % (len(tags), buckets))
+
+main()
@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#include "lwip/pbuf.h"
+
+#include "mdns_watch.h"
+
+/*
+ * Passive mDNS listener
+ *
+ * Joins the mDNS multicast group and reports the source address of every response that names one of the watched
+ * services.  Devices announce themselves when they join the network and answer queries from phones and other hubs,
+ * so hosts are found without sending anything.  mdns_watch_query() asks once for every watched service when an
+ * answer is wanted now.  This is not a responder, nothing is announced for this device.
+ */
+
+#define MDNS_TYPE_PTR       (12)
+#define MDNS_CLASS_IN       (1)
+#define MDNS_FLAG_RESPONSE  (0x8000)
+#define MDNS_HEADER_SIZE    (12)
+
+// prototypes
+static void mdns_watch_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+static int mdns_watch_read_name(const u8_t *msg, int len, int offset, char *name, int name_size);
+static bool mdns_watch_match(const char *name);
+
+// static variables
+static struct udp_pcb *mdns_pcb = NULL;
+static const MDNS_WATCH_T *mdns_watch = NULL;
+static int mdns_num_watch = 0;
+static MDNS_WATCH_CALLBACK_T mdns_callback = NULL;
+static void *mdns_callback_arg = NULL;
+static u8_t mdns_buffer[MDNS_WATCH_BUFFER_SIZE];        // only used on the tcpip thread
+
+
+/*!
+ * \brief Join the mDNS group and start reporting hosts that announce the watched services
+ *
+ * \param[in]   watch       services to watch for, must stay valid until mdns_watch_stop()
+ * \param[in]   num_watch   number of services
+ * \param[in]   callback    called on the tcpip thread for each matching response
+ * \param[in]   arg         passed to callback
+ *
+ * \return 0 on success, -1 on error
+ */
+int mdns_watch_start(const MDNS_WATCH_T *watch, int num_watch, MDNS_WATCH_CALLBACK_T callback, void *arg)
+{
+    ip4_addr_t group;
+    int err = 0;
+
+    if (mdns_pcb)
+    {
+        return(0);
+    }
+
+    IP4_ADDR(&group, 224, 0, 0, 251);
+
+    cyw43_arch_lwip_begin();
+    mdns_watch = watch;
+    mdns_num_watch = num_watch;
+    mdns_callback = callback;
+    mdns_callback_arg = arg;
+
+    mdns_pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (!mdns_pcb)
+    {
+        err = -1;
+    }
+    else if ((udp_bind(mdns_pcb, IP4_ADDR_ANY, MDNS_WATCH_PORT) != ERR_OK) || (igmp_joingroup(IP4_ADDR_ANY4, &group) != ERR_OK))
+    {
+        udp_remove(mdns_pcb);
+        mdns_pcb = NULL;
+        err = -1;
+    }
+    else
+    {
+        udp_recv(mdns_pcb, mdns_watch_recv, NULL);
+    }
+    cyw43_arch_lwip_end();
+
+    return(err);
+}
+
+/*!
+ * \brief Leave the mDNS group
+ *
+ * \return nothing
+ */
+void mdns_watch_stop(void)
+{
+    ip4_addr_t group;
+
+    IP4_ADDR(&group, 224, 0, 0, 251);
+
+    cyw43_arch_lwip_begin();
+    if (mdns_pcb)
+    {
+        igmp_leavegroup(IP4_ADDR_ANY4, &group);
+        udp_remove(mdns_pcb);
+        mdns_pcb = NULL;
+    }
+    cyw43_arch_lwip_end();
+}
+
+/*!
+ * \brief Multicast one query asking for every instance of the watched services
+ *
+ * \return 0 on success, -1 on error
+ */
+int mdns_watch_query(void)
+{
+    u8_t query[256];
+    const char *label;
+    const char *dot;
+    int len = MDNS_HEADER_SIZE;
+    int i;
+    int err = -1;
+    struct pbuf *p;
+    ip_addr_t group;
+
+    // header with only the question count set
+    memset(query, 0, MDNS_HEADER_SIZE);
+    query[5] = (u8_t)mdns_num_watch;
+
+    for(i=0; i<mdns_num_watch; i++)
+    {
+        // "_shelly._tcp" becomes 7 _shelly 4 _tcp 5 local 0
+        for(label = mdns_watch[i].service; *label; label = *dot ? dot + 1 : dot)
+        {
+            dot = strchr(label, '.');
+            if (!dot)
+            {
+                dot = label + strlen(label);
+            }
+            if ((dot - label > 63) || (len + (dot - label) + 1 + 12 > sizeof(query)))
+            {
+                return(-1);
+            }
+            query[len++] = (u8_t)(dot - label);
+            memcpy(&query[len], label, dot - label);
+            len += dot - label;
+        }
+        memcpy(&query[len], "\x05local\x00", 7);
+        len += 7;
+        query[len++] = 0;
+        query[len++] = MDNS_TYPE_PTR;
+        query[len++] = 0;
+        query[len++] = MDNS_CLASS_IN;
+    }
+
+    IP_ADDR4(&group, 224, 0, 0, 251);
+
+    cyw43_arch_lwip_begin();
+    if (mdns_pcb)
+    {
+        p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)len, PBUF_RAM);
+        if (p)
+        {
+            pbuf_take(p, query, (u16_t)len);
+            if (udp_sendto(mdns_pcb, p, &group, MDNS_WATCH_PORT) == ERR_OK)
+            {
+                err = 0;
+            }
+            pbuf_free(p);
+        }
+    }
+    cyw43_arch_lwip_end();
+
+    return(err);
+}
+
+/*!
+ * \brief Check the records of each mDNS response for a watched service
+ *
+ * \return nothing
+ */
+static void mdns_watch_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    char name[MDNS_WATCH_NAME_MAX];
+    int len;
+    int offset;
+    int records;
+    int questions;
+    int type;
+    int rdlen;
+    bool found = false;
+
+    len = pbuf_copy_partial(p, mdns_buffer, sizeof(mdns_buffer), 0);
+    pbuf_free(p);
+
+    if ((len < MDNS_HEADER_SIZE) || !IP_IS_V4(addr) || !(((mdns_buffer[2] << 8) | mdns_buffer[3]) & MDNS_FLAG_RESPONSE))
+    {
+        return;
+    }
+
+    questions = (mdns_buffer[4] << 8) | mdns_buffer[5];
+    records = ((mdns_buffer[6] << 8) | mdns_buffer[7]) + ((mdns_buffer[8] << 8) | mdns_buffer[9]) + ((mdns_buffer[10] << 8) | mdns_buffer[11]);
+    offset = MDNS_HEADER_SIZE;
+
+    // responses rarely repeat the question, skip it if they do
+    while ((questions-- > 0) && (offset >= 0))
+    {
+        offset = mdns_watch_read_name(mdns_buffer, len, offset, name, sizeof(name));
+        offset = ((offset >= 0) && (offset + 4 <= len)) ? offset + 4 : -1;
+    }
+
+    // answer, authority and additional records alike
+    while ((records-- > 0) && (offset >= 0) && !found)
+    {
+        offset = mdns_watch_read_name(mdns_buffer, len, offset, name, sizeof(name));
+        if ((offset < 0) || (offset + 10 > len))
+        {
+            break;
+        }
+
+        type = (mdns_buffer[offset] << 8) | mdns_buffer[offset + 1];
+        rdlen = (mdns_buffer[offset + 8] << 8) | mdns_buffer[offset + 9];
+        offset += 10;
+
+        found = mdns_watch_match(name);
+
+        if (!found && (type == MDNS_TYPE_PTR) && (mdns_watch_read_name(mdns_buffer, len, offset, name, sizeof(name)) >= 0))
+        {
+            found = mdns_watch_match(name);
+        }
+
+        offset += rdlen;
+    }
+
+    if (found && mdns_callback)
+    {
+        mdns_callback(mdns_callback_arg, lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(addr))));
+    }
+}
+
+/*!
+ * \brief Decode a possibly compressed dns name into lower case dotted form
+ *
+ * \param[in]   msg         dns message
+ * \param[in]   len         message length
+ * \param[in]   offset      start of the name
+ * \param[out]  name        dotted name, truncated to fit
+ * \param[in]   name_size   size of name
+ *
+ * \return offset of the byte following the name, or -1 if the name is malformed
+ */
+static int mdns_watch_read_name(const u8_t *msg, int len, int offset, char *name, int name_size)
+{
+    int next = -1;
+    int jumps = 0;
+    int used = 0;
+    int label;
+    int i;
+
+    while (offset < len)
+    {
+        label = msg[offset];
+
+        if (label == 0)
+        {
+            name[used] = 0;
+            return((next >= 0) ? next : offset + 1);
+        }
+
+        if ((label & 0xc0) == 0xc0)
+        {
+            // compression pointer, the name continues earlier in the message
+            if ((offset + 1 >= len) || (++jumps > 8))
+            {
+                break;
+            }
+            if (next < 0)
+            {
+                next = offset + 2;
+            }
+            offset = ((label & 0x3f) << 8) | msg[offset + 1];
+            continue;
+        }
+
+        if ((label & 0xc0) || (offset + 1 + label > len))
+        {
+            break;
+        }
+
+        if (used && (used < name_size - 1))
+        {
+            name[used++] = '.';
+        }
+        for(i=0; i<label; i++)
+        {
+            if (used < name_size - 1)
+            {
+                name[used++] = (char)tolower(msg[offset + 1 + i]);
+            }
+        }
+        offset += label + 1;
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Check if a name is a watched service or an instance of one
+ *
+ * \param[in]   name    lower case dotted name
+ *
+ * \return true if the name matches a watched service
+ */
+static bool mdns_watch_match(const char *name)
+{
+    char suffix[MDNS_WATCH_NAME_MAX];
+    int name_len = strlen(name);
+    int suffix_len;
+    int i;
+
+    for(i=0; i<mdns_num_watch; i++)
+    {
+        suffix_len = snprintf(suffix, sizeof(suffix), "%s.local", mdns_watch[i].service);
+
+        if ((suffix_len >= sizeof(suffix)) || (name_len < suffix_len) || strcasecmp(name + name_len - suffix_len, suffix))
+        {
+            continue;
+        }
+
+        if (name_len == suffix_len)
+        {
+            // the service itself, instances are in the ptr target
+            if (!mdns_watch[i].instance_prefix)
+            {
+                return(true);
+            }
+        }
+        else if ((name[name_len - suffix_len - 1] == '.') &&
+                 (!mdns_watch[i].instance_prefix || !strncasecmp(name, mdns_watch[i].instance_prefix, strlen(mdns_watch[i].instance_prefix))))
+        {
+            return(true);
+        }
+    }
+
+    return(false);
+}
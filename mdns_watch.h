@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef MDNS_WATCH_H
+#define MDNS_WATCH_H
+
+#include "lwip/ip_addr.h"
+
+#define MDNS_WATCH_PORT             (5353)
+#define MDNS_WATCH_BUFFER_SIZE      (768)       // larger announcements are parsed as far as they fit
+#define MDNS_WATCH_NAME_MAX         (128)       // longest name compared, longer names are truncated
+
+// services to watch for
+typedef struct
+{
+    const char *service;                // e.g. "_shelly._tcp", matched in the name or ptr target of any record
+    const char *instance_prefix;        // instance name must start with this, NULL to accept any instance
+} MDNS_WATCH_T;
+
+// called on the tcpip thread with the address of a host announcing a watched service, host byte order
+typedef void (*MDNS_WATCH_CALLBACK_T)(void *arg, u32_t ip);
+
+int mdns_watch_start(const MDNS_WATCH_T *watch, int num_watch, MDNS_WATCH_CALLBACK_T callback, void *arg);
+int mdns_watch_query(void);
+void mdns_watch_stop(void);
+
+#endif
@@ -54,6 +54,10 @@
 #include "udp.h"
 #include "message.h"
 #include "message_defs.h"
+#include "message_codec.h"
+#include "clock_sync.h"
+#include "events.h"
+#include "web_snapshot.h"
 
 
 //#define DEBUG_UDP_MESSAGES
@@ -84,6 +88,16 @@ typedef struct ANEMOMETER_REMOTE_STATE_STRUCT
     int wind_speed;
 } ANEMOMETER_REMOTE_STATE_T;
 
+typedef struct CLOCK_MASTER_STATE_STRUCT
+{
+    SOCKADDR_IN resolved_address;
+    TickType_t resolved_at_tick;
+    TickType_t requested_at_tick;
+    u_int32_t latest_transaction;
+    u_int32_t latest_sequence;
+    uint64_t originate_local_us;
+} CLOCK_MASTER_STATE_T;
+
 
 //prototypes
 int receive_led_strip_request(tsLED_STRIP_RQST *psMsg, SOCKADDR_IN sDest);
@@ -98,6 +112,12 @@ int send_wind_speed_confirm(int iError, SOCKADDR_IN sDest, u_int32_t transaction
 void poll_remote_anemometer(void);
 int receive_wind_speed_request(tsWIND_SPEED_RQST *psMsg, SOCKADDR_IN sDest);
 int receive_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, SOCKADDR_IN sDest);
+void initialize_clock_master(void);
+void poll_clock_master(void);
+int send_time_sync_request(SOCKADDR_IN sDest);
+int send_time_sync_confirm(int iError, SOCKADDR_IN sDest, u_int32_t transaction, u_int32_t sequence, tsTIME_SYNC_RQST *psRqst);
+int receive_time_sync_request(tsTIME_SYNC_RQST *psMsg, SOCKADDR_IN sDest);
+int receive_time_sync_confirm(tsTIME_SYNC_CNFM *psMsg, SOCKADDR_IN sDest);
 
 // external variables
 extern NON_VOL_VARIABLES_T config;
@@ -106,11 +126,13 @@ extern WEB_VARIABLES_T web;
 //static variables
 static LED_REMOTE_STATE_T remote_led_strip_state[6];
 static ANEMOMETER_REMOTE_STATE_T remote_anemometer_state;
+static CLOCK_MASTER_STATE_T clock_master_state;
 static SOCKET message_socket = 0;
 static char message_buffer[128];
 static int message_receive_timeout = 5000000;                             // five seconds
 static DOUBLE_BUF_INT remote_pattern;
 static DOUBLE_BUF_INT remote_speed;
+static uint64_t message_rx_local_us = 0;                                  // time_us_64() when last message arrived
 
 /*!
  * \brief process messages sent to port 6969, format defined in message_defs.h
@@ -128,6 +150,7 @@ void message_task(__unused void *params)
 
     initialize_remote_led_strips();
     initialize_remote_anemometer();
+    initialize_clock_master();
 
     message_socket = upd_establish_socket(6969);
 
@@ -138,6 +161,15 @@ void message_task(__unused void *params)
              // process messages
             received_bytes = udp_receive(message_socket, message_buffer, sizeof(message_buffer), &sClientAddress, message_receive_timeout);
 
+            // timestamp arrival as early as possible for clock synchronisation
+            message_rx_local_us = time_us_64();
+
+            // fields appended to a message in later releases read as zero when sent by an older peer
+            if ((received_bytes > 0) && (received_bytes < sizeof(message_buffer)))
+            {
+                memset(message_buffer + received_bytes, 0, sizeof(message_buffer) - received_bytes);
+            }
+
             if (received_bytes >= sizeof(tsMSG_HDR))
             {
                 if (check_received_header((tsMSG_HDR *)&message_buffer, sClientAddress) == 0)
@@ -157,6 +189,12 @@ void message_task(__unused void *params)
                     case WIND_SPEED_CNFM:
                          receive_wind_speed_confirm((tsWIND_SPEED_CNFM *)&message_buffer, sClientAddress);
                         break;                                                
+                    case TIME_SYNC_RQST:
+                        receive_time_sync_request((tsTIME_SYNC_RQST *)&message_buffer, sClientAddress);
+                        break;
+                    case TIME_SYNC_CNFM:
+                        receive_time_sync_confirm((tsTIME_SYNC_CNFM *)&message_buffer, sClientAddress);
+                        break;
                     default:
                         printf("unrecognized Rx message ID (%lu)\n", htonl(((tsMSG_HDR *)&message_buffer)->message));
                         break;
@@ -190,6 +228,7 @@ void message_task(__unused void *params)
 
             control_remote_led_strips();
             poll_remote_anemometer();
+            poll_clock_master();
 
             // tell watchdog task that we are still alive
             watchdog_pulse((int *)params);    
@@ -236,6 +275,10 @@ int check_received_header(tsMSG_HDR *psMsg, SOCKADDR_IN sDest)
             STRNCPY(web.led_last_request_ip, address, sizeof(web.led_last_request_ip));
             break;
 
+        case TIME_SYNC_RQST:
+        case TIME_SYNC_CNFM:
+            break;
+
         default:
             printf("Message header contains unrecognised MsgId %lu recieved from %s\n", htonl(psMsg->message), address);
             iStatus = -1;
@@ -328,14 +371,9 @@ int send_led_strip_confirm(int iError, SOCKADDR_IN sDest, u_int32_t transaction,
     tsLED_STRIP_CNFM sCnfm;
     int iNumBytes;
 
-    sCnfm.sHeader.version = htonl(1);
-    sCnfm.sHeader.message = htonl(LED_STRIP_CNFM);
-    sCnfm.sHeader.transaction = htonl(transaction);
-    sCnfm.sHeader.sequence = htonl(sequence);
+    iNumBytes = message_encode_led_strip_confirm(&sCnfm, transaction, sequence, 0);
 
-    sCnfm.iError = htonl(0);
-
-    iNumBytes = udp_transmit (message_socket, (char *)&sCnfm, sizeof(tsLED_STRIP_CNFM), sDest);
+    iNumBytes = udp_transmit (message_socket, (char *)&sCnfm, iNumBytes, sDest);
 
     return(iNumBytes);
 }
@@ -359,14 +397,9 @@ int send_led_strip_request(int strip, int pattern, int speed, SOCKADDR_IN sDest)
 
     transaction = get_rand_32();
 
-    sRqst.sHeader.version = htonl(1);
-    sRqst.sHeader.message = htonl(LED_STRIP_RQST);
-    sRqst.sHeader.transaction = htonl(transaction); 
-    sRqst.sHeader.sequence = htonl(sequence);  
-    sRqst.pattern = htonl(pattern);
-    sRqst.speed = htonl(speed);  
+    iNumBytes = message_encode_led_strip_request(&sRqst, transaction, sequence, pattern, speed);
 
-    iNumBytes = udp_transmit (message_socket, (char *)&sRqst, sizeof(tsLED_STRIP_RQST), sDest);    
+    iNumBytes = udp_transmit (message_socket, (char *)&sRqst, iNumBytes, sDest);    
 
     if (iNumBytes < 0)
     {
@@ -655,12 +688,9 @@ int send_wind_speed_request(SOCKADDR_IN sDest)
 
     transaction = get_rand_32();
 
-    sRqst.sHeader.version = htonl(1);
-    sRqst.sHeader.message = htonl(WIND_SPEED_RQST);
-    sRqst.sHeader.transaction = htonl(transaction); 
-    sRqst.sHeader.sequence = htonl(sequence);  
+    iNumBytes = message_encode_wind_speed_request(&sRqst, transaction, sequence);
 
-    iNumBytes = udp_transmit (message_socket, (char *)&sRqst, sizeof(tsWIND_SPEED_RQST), sDest);    
+    iNumBytes = udp_transmit (message_socket, (char *)&sRqst, iNumBytes, sDest);    
 
     if (iNumBytes < 0)
     {
@@ -712,6 +742,10 @@ int receive_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, SOCKADDR_IN sDest)
 {
     //int iError = 0;
     int strip;
+    MESSAGE_FIELDS_T fields;
+
+    // the sample time is missing from older peers and reads as zero
+    message_decode(psMsg, sizeof(tsWIND_SPEED_CNFM), &fields);
 
     // compatibility check
     if (htonl(psMsg->sHeader.version) == 1)
@@ -731,7 +765,11 @@ int receive_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, SOCKADDR_IN sDest)
             //TODO: consider checking IP here
             remote_anemometer_state.wind_speed = htonl(psMsg->wind_speed);
             //CLIP(remote_anemometer_state.wind_speed, 0, 320);  //TODO archaic units
+            web_write_begin(WEB_GROUP_WIND);
             web.anemometer_wind_speed = remote_anemometer_state.wind_speed;
+            web.anemometer_sample_time_us = fields.sample_time_us;
+            web_write_end(WEB_GROUP_WIND);
+            events_publish(EVENT_WIND);
         }              
 
         
@@ -752,18 +790,210 @@ int receive_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, SOCKADDR_IN sDest)
 int send_wind_speed_confirm(int iError, SOCKADDR_IN sDest, u_int32_t transaction, u_int32_t sequence)
 {
     tsWIND_SPEED_CNFM sCnfm;
+    WEB_WIND_T wind;
+    int iNumBytes;
+
+    // speed and sample time must come from the same reading
+    web_snapshot_wind(&wind);
+
+    iNumBytes = message_encode_wind_speed_confirm(&sCnfm, transaction, sequence, 0, wind.wind_speed, wind.sample_time_us);
+    printf("sending wind speed = %d\n",  wind.wind_speed);
+
+    iNumBytes = udp_transmit (message_socket, (char *)&sCnfm, iNumBytes, sDest);
+
+    return(iNumBytes);
+}
+
+/*!
+ * \brief Initialize clock master state variables
+ *
+ * \param none
+ * 
+ * \return nothing
+ */
+void initialize_clock_master(void)
+{
+    TickType_t tick_now;
+
+    tick_now = xTaskGetTickCount();
+
+    memset(&(clock_master_state.resolved_address), 0, sizeof(struct sockaddr_in)); 
+    clock_master_state.resolved_at_tick = tick_now;
+    clock_master_state.requested_at_tick = tick_now;
+    clock_master_state.latest_transaction = 0;
+    clock_master_state.latest_sequence = 0;
+    clock_master_state.originate_local_us = 0;
+
+    if (!clock_sync_is_master())
+    {
+        construct_address(config.clock_sync_master_ip, 6969, &(clock_master_state.resolved_address));
+    }
+}
+
+/*!
+ * \brief Poll clock master to discipline the shared timebase
+ *
+ * \param none
+ * 
+ * \return nothing
+ */
+void poll_clock_master(void)
+{
+    TickType_t tick_now;
+
+    if (!clock_sync_is_master())
+    {
+        tick_now = xTaskGetTickCount();
+
+        // check time since last resolved the master address
+        if (((tick_now - clock_master_state.resolved_at_tick) > 60000) || (clock_master_state.resolved_address.sin_addr.s_addr == 0))
+        {
+            // attempt to resolve ip address
+            if (!construct_address(config.clock_sync_master_ip, 6969, &(clock_master_state.resolved_address)))
+            {
+                clock_master_state.resolved_at_tick = xTaskGetTickCount();
+            }
+        }
+
+        if ((tick_now - clock_master_state.requested_at_tick) > clock_sync_poll_interval())
+        {
+            if (!send_time_sync_request(clock_master_state.resolved_address))
+            {
+                clock_master_state.requested_at_tick = tick_now;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief send request for master timestamps
+ *
+ * \param[in]  sDest   address of clock master
+ * 
+ * \return 0 on success
+ */
+int send_time_sync_request(SOCKADDR_IN sDest)
+{
+    tsTIME_SYNC_RQST sRqst;
+    int iNumBytes;
+    int iError = 0;
+    static int sequence = 0;
+    int transaction;
+    uint64_t originate_local_us;
+
+    transaction = get_rand_32();
+
+    // timestamp as late as possible -- the master echoes this back so we need not trust it to remember
+    originate_local_us = time_us_64();
+    iNumBytes = message_encode_time_sync_request(&sRqst, transaction, sequence, originate_local_us);
+
+    iNumBytes = udp_transmit (message_socket, (char *)&sRqst, iNumBytes, sDest);    
+
+    if (iNumBytes < 0)
+    {
+        printf("Failed to send Time Sync request\n");
+        iError = 1;
+    }
+    else
+    {
+        clock_master_state.latest_transaction = transaction;
+        clock_master_state.latest_sequence = sequence;
+        clock_master_state.originate_local_us = originate_local_us;
+
+        sequence++;     
+    }
+
+    return (iError);
+}
+
+/*!
+ * \brief answer request for master timestamps
+ *
+ * \param[in]  psMsg   pointer message
+ * \param[in]  sDest   address of sender
+ * 
+ * \return 0 on success
+ */
+int receive_time_sync_request(tsTIME_SYNC_RQST *psMsg, SOCKADDR_IN sDest)
+{
+    int iError = 0;
+
+    // compatibility check
+    if (htonl(psMsg->sHeader.version) == 1)
+    {   
+        if (!clock_sync_synchronised())
+        {
+            iError = 1;
+        }
+
+        send_time_sync_confirm(iError, sDest, htonl(psMsg->sHeader.transaction), htonl(psMsg->sHeader.sequence), psMsg);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * \brief feed master timestamps into the clock filter
+ *
+ * \param[in]  psMsg   pointer message
+ * \param[in]  sDest   address of sender
+ * 
+ * \return 0 on success
+ */
+int receive_time_sync_confirm(tsTIME_SYNC_CNFM *psMsg, SOCKADDR_IN sDest)
+{
+    MESSAGE_FIELDS_T fields;
+
+    // compatibility check
+    if (message_decode(psMsg, sizeof(tsTIME_SYNC_CNFM), &fields) == 0)
+    {
+        // only the reply to the outstanding request is useful -- late replies have unknown queuing delay
+        if ((clock_master_state.latest_transaction == fields.sHeader.transaction) &&
+            (clock_master_state.latest_sequence == fields.sHeader.sequence) &&
+            (fields.iError == 0))
+        {
+            if (fields.originate_us == clock_master_state.originate_local_us)
+            {
+                clock_sync_add_exchange(fields.originate_us, fields.receive_us, fields.transmit_us, message_rx_local_us);
+            }
+
+            // prevent a duplicate being used twice
+            clock_master_state.latest_transaction = 0;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * \brief send confirm message with master timestamps
+ *
+ * \param[in]  iError       0 = timebase valid, 1 = not synchronised
+ * \param[in]  sDest        address of requestor
+ * \param[in]  transaction  transaction from request
+ * \param[in]  sequence     sequence from request
+ * \param[in]  psRqst       request being answered
+ * 
+ * \return number of bytes sent
+ */
+int send_time_sync_confirm(int iError, SOCKADDR_IN sDest, u_int32_t transaction, u_int32_t sequence, tsTIME_SYNC_RQST *psRqst)
+{
+    tsTIME_SYNC_CNFM sCnfm;
+    MESSAGE_FIELDS_T fields;
     int iNumBytes;
+    uint64_t receive_us;
+    uint64_t transmit_us;
 
-    sCnfm.sHeader.version = htonl(1);
-    sCnfm.sHeader.message = htonl(WIND_SPEED_CNFM);
-    sCnfm.sHeader.transaction = htonl(transaction);
-    sCnfm.sHeader.sequence = htonl(sequence);
+    message_decode(psRqst, sizeof(tsTIME_SYNC_RQST), &fields);
 
-    sCnfm.iError = htonl(0);
-    sCnfm.wind_speed = htonl(web.anemometer_wind_speed);
-    printf("sending wind speed = %d\n",  htonl(sCnfm.wind_speed));
+    // the same slewed clock as this node's sample timestamps, so peers agree with them while a step is slewed out
+    receive_us = clock_sync_get_time_at_us(message_rx_local_us);
 
-    iNumBytes = udp_transmit (message_socket, (char *)&sCnfm, sizeof(tsWIND_SPEED_CNFM), sDest);
+    // timestamp as late as possible
+    transmit_us = clock_sync_get_time_us();
+    iNumBytes = message_encode_time_sync_confirm(&sCnfm, transaction, sequence, iError, fields.originate_us, receive_us, transmit_us);
+
+    iNumBytes = udp_transmit (message_socket, (char *)&sCnfm, iNumBytes, sDest);
 
     return(iNumBytes);
-}
\ No newline at end of file
+}
@@ -0,0 +1,336 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "message_codec.h"
+
+// NB: this file must not depend on the pico sdk, lwip or FreeRTOS so that the same encoders can be built into the linux client
+
+// prototypes
+static uint32_t message_to_network(uint32_t value);
+static uint32_t message_from_network(uint32_t value);
+static void message_encode_header(tsMSG_HDR *psHdr, teMSG_ID message, uint32_t transaction, uint32_t sequence);
+static void message_encode_u64(uint32_t *hi, uint32_t *lo, uint64_t value);
+static uint64_t message_decode_u64(uint32_t hi, uint32_t lo);
+
+/*!
+ * \brief Get the current length of a message
+ *
+ * \param[in]  message   message identifier
+ *
+ * \return length in bytes or -1 if message is not recognised
+ */
+int message_length(teMSG_ID message)
+{
+    int length = -1;
+
+    switch(message)
+    {
+        case LED_STRIP_RQST:
+            length = sizeof(tsLED_STRIP_RQST);
+            break;
+        case LED_STRIP_CNFM:
+            length = sizeof(tsLED_STRIP_CNFM);
+            break;
+        case WIND_SPEED_RQST:
+            length = sizeof(tsWIND_SPEED_RQST);
+            break;
+        case WIND_SPEED_CNFM:
+            length = sizeof(tsWIND_SPEED_CNFM);
+            break;
+        case TIME_SYNC_RQST:
+            length = sizeof(tsTIME_SYNC_RQST);
+            break;
+        case TIME_SYNC_CNFM:
+            length = sizeof(tsTIME_SYNC_CNFM);
+            break;
+        default:
+            break;
+    }
+
+    return(length);
+}
+
+/*!
+ * \brief Encode request to set led pattern
+ *
+ * \param[out] psMsg         message in network byte order
+ * \param[in]  transaction   transaction identifier
+ * \param[in]  sequence      sequence number
+ * \param[in]  pattern       led pattern
+ * \param[in]  speed         led speed
+ *
+ * \return number of bytes to send
+ */
+int message_encode_led_strip_request(tsLED_STRIP_RQST *psMsg, uint32_t transaction, uint32_t sequence, int pattern, int speed)
+{
+    message_encode_header(&(psMsg->sHeader), LED_STRIP_RQST, transaction, sequence);
+    psMsg->pattern = message_to_network(pattern);
+    psMsg->speed = message_to_network(speed);
+
+    return(sizeof(tsLED_STRIP_RQST));
+}
+
+/*!
+ * \brief Encode confirm of led pattern
+ *
+ * \param[out] psMsg         message in network byte order
+ * \param[in]  transaction   transaction identifier from request
+ * \param[in]  sequence      sequence number from request
+ * \param[in]  iError        0 = no error, 1 = error
+ *
+ * \return number of bytes to send
+ */
+int message_encode_led_strip_confirm(tsLED_STRIP_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError)
+{
+    message_encode_header(&(psMsg->sHeader), LED_STRIP_CNFM, transaction, sequence);
+    psMsg->iError = message_to_network(iError);
+
+    return(sizeof(tsLED_STRIP_CNFM));
+}
+
+/*!
+ * \brief Encode request for wind speed
+ *
+ * \param[out] psMsg         message in network byte order
+ * \param[in]  transaction   transaction identifier
+ * \param[in]  sequence      sequence number
+ *
+ * \return number of bytes to send
+ */
+int message_encode_wind_speed_request(tsWIND_SPEED_RQST *psMsg, uint32_t transaction, uint32_t sequence)
+{
+    message_encode_header(&(psMsg->sHeader), WIND_SPEED_RQST, transaction, sequence);
+
+    return(sizeof(tsWIND_SPEED_RQST));
+}
+
+/*!
+ * \brief Encode confirm with wind speed
+ *
+ * \param[out] psMsg            message in network byte order
+ * \param[in]  transaction      transaction identifier from request
+ * \param[in]  sequence         sequence number from request
+ * \param[in]  iError           0 = no error, 1 = error
+ * \param[in]  wind_speed       wind speed
+ * \param[in]  sample_time_us   shared timebase when sampled, zero if unknown
+ *
+ * \return number of bytes to send
+ */
+int message_encode_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError, int wind_speed, uint64_t sample_time_us)
+{
+    message_encode_header(&(psMsg->sHeader), WIND_SPEED_CNFM, transaction, sequence);
+    psMsg->iError = message_to_network(iError);
+    psMsg->wind_speed = message_to_network(wind_speed);
+    message_encode_u64(&(psMsg->sample_time_hi), &(psMsg->sample_time_lo), sample_time_us);
+
+    return(sizeof(tsWIND_SPEED_CNFM));
+}
+
+/*!
+ * \brief Encode request for master timestamps
+ *
+ * \param[out] psMsg          message in network byte order
+ * \param[in]  transaction    transaction identifier
+ * \param[in]  sequence       sequence number
+ * \param[in]  originate_us   local clock when request sent (t1)
+ *
+ * \return number of bytes to send
+ */
+int message_encode_time_sync_request(tsTIME_SYNC_RQST *psMsg, uint32_t transaction, uint32_t sequence, uint64_t originate_us)
+{
+    message_encode_header(&(psMsg->sHeader), TIME_SYNC_RQST, transaction, sequence);
+    message_encode_u64(&(psMsg->originate_hi), &(psMsg->originate_lo), originate_us);
+
+    return(sizeof(tsTIME_SYNC_RQST));
+}
+
+/*!
+ * \brief Encode confirm with master timestamps
+ *
+ * \param[out] psMsg          message in network byte order
+ * \param[in]  transaction    transaction identifier from request
+ * \param[in]  sequence       sequence number from request
+ * \param[in]  iError         0 = no error, 1 = timebase not synchronised
+ * \param[in]  originate_us   copied from request (t1)
+ * \param[in]  receive_us     shared timebase when request received (t2)
+ * \param[in]  transmit_us    shared timebase when confirm sent (t3)
+ *
+ * \return number of bytes to send
+ */
+int message_encode_time_sync_confirm(tsTIME_SYNC_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError, uint64_t originate_us, uint64_t receive_us, uint64_t transmit_us)
+{
+    message_encode_header(&(psMsg->sHeader), TIME_SYNC_CNFM, transaction, sequence);
+    psMsg->iError = message_to_network(iError);
+    message_encode_u64(&(psMsg->originate_hi), &(psMsg->originate_lo), originate_us);
+    message_encode_u64(&(psMsg->receive_hi), &(psMsg->receive_lo), receive_us);
+    message_encode_u64(&(psMsg->transmit_hi), &(psMsg->transmit_lo), transmit_us);
+
+    return(sizeof(tsTIME_SYNC_CNFM));
+}
+
+/*!
+ * \brief Decode any message into host byte order
+ *
+ * Messages from peers running older firmware may be shorter than the current definition, fields
+ * beyond the received length are returned as zero.
+ *
+ * \param[in]  buffer     received message
+ * \param[in]  length     number of bytes received
+ * \param[out] psFields   decoded fields
+ *
+ * \return 0 on success, -1 if the message is truncated, has an unknown version or unknown identifier
+ */
+int message_decode(const void *buffer, int length, MESSAGE_FIELDS_T *psFields)
+{
+    uint8_t message[MESSAGE_MAX_LENGTH];
+    tsMSG_HDR *psHdr;
+    int expected;
+
+    memset(psFields, 0, sizeof(MESSAGE_FIELDS_T));
+
+    if ((length < (int)sizeof(tsMSG_HDR)) || (length > MESSAGE_MAX_LENGTH))
+    {
+        return(-1);
+    }
+
+    // copy to an aligned, zero padded buffer
+    memset(message, 0, sizeof(message));
+    memcpy(message, buffer, length);
+
+    psHdr = (tsMSG_HDR *)message;
+    psFields->sHeader.version = message_from_network(psHdr->version);
+    psFields->sHeader.message = (teMSG_ID)message_from_network(psHdr->message);
+    psFields->sHeader.transaction = message_from_network(psHdr->transaction);
+    psFields->sHeader.sequence = message_from_network(psHdr->sequence);
+
+    expected = message_length(psFields->sHeader.message);
+
+    if ((psFields->sHeader.version != MESSAGE_PROTOCOL_VERSION) || (expected < 0))
+    {
+        return(-1);
+    }
+
+    switch(psFields->sHeader.message)
+    {
+        case LED_STRIP_RQST:
+            psFields->pattern = message_from_network(((tsLED_STRIP_RQST *)message)->pattern);
+            psFields->speed = message_from_network(((tsLED_STRIP_RQST *)message)->speed);
+            break;
+        case LED_STRIP_CNFM:
+            psFields->iError = message_from_network(((tsLED_STRIP_CNFM *)message)->iError);
+            break;
+        case WIND_SPEED_RQST:
+            break;
+        case WIND_SPEED_CNFM:
+            psFields->iError = message_from_network(((tsWIND_SPEED_CNFM *)message)->iError);
+            psFields->wind_speed = message_from_network(((tsWIND_SPEED_CNFM *)message)->wind_speed);
+            psFields->sample_time_us = message_decode_u64(((tsWIND_SPEED_CNFM *)message)->sample_time_hi,
+                                                          ((tsWIND_SPEED_CNFM *)message)->sample_time_lo);
+            break;
+        case TIME_SYNC_RQST:
+            psFields->originate_us = message_decode_u64(((tsTIME_SYNC_RQST *)message)->originate_hi,
+                                                        ((tsTIME_SYNC_RQST *)message)->originate_lo);
+            break;
+        case TIME_SYNC_CNFM:
+            psFields->iError = message_from_network(((tsTIME_SYNC_CNFM *)message)->iError);
+            psFields->originate_us = message_decode_u64(((tsTIME_SYNC_CNFM *)message)->originate_hi,
+                                                        ((tsTIME_SYNC_CNFM *)message)->originate_lo);
+            psFields->receive_us = message_decode_u64(((tsTIME_SYNC_CNFM *)message)->receive_hi,
+                                                      ((tsTIME_SYNC_CNFM *)message)->receive_lo);
+            psFields->transmit_us = message_decode_u64(((tsTIME_SYNC_CNFM *)message)->transmit_hi,
+                                                       ((tsTIME_SYNC_CNFM *)message)->transmit_lo);
+            break;
+        default:
+            break;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Fill in message header
+ *
+ * \param[out] psHdr         header in network byte order
+ * \param[in]  message       message identifier
+ * \param[in]  transaction   transaction identifier
+ * \param[in]  sequence      sequence number
+ *
+ * \return nothing
+ */
+static void message_encode_header(tsMSG_HDR *psHdr, teMSG_ID message, uint32_t transaction, uint32_t sequence)
+{
+    psHdr->version = message_to_network(MESSAGE_PROTOCOL_VERSION);
+    psHdr->message = (teMSG_ID)message_to_network(message);
+    psHdr->transaction = message_to_network(transaction);
+    psHdr->sequence = message_to_network(sequence);
+}
+
+/*!
+ * \brief Split 64 bit value into two 32 bit words in network byte order, most significant first
+ *
+ * \param[out] hi      most significant word
+ * \param[out] lo      least significant word
+ * \param[in]  value   value to encode
+ *
+ * \return nothing
+ */
+static void message_encode_u64(uint32_t *hi, uint32_t *lo, uint64_t value)
+{
+    *hi = message_to_network((uint32_t)(value >> 32));
+    *lo = message_to_network((uint32_t)value);
+}
+
+/*!
+ * \brief Join two 32 bit words in network byte order into a 64 bit value
+ *
+ * \param[in]  hi      most significant word
+ * \param[in]  lo      least significant word
+ *
+ * \return decoded value
+ */
+static uint64_t message_decode_u64(uint32_t hi, uint32_t lo)
+{
+    return(((uint64_t)message_from_network(hi) << 32) | message_from_network(lo));
+}
+
+/*!
+ * \brief Convert host to network byte order without relying on a socket library
+ *
+ * \param[in]  value   host byte order
+ *
+ * \return network byte order
+ */
+static uint32_t message_to_network(uint32_t value)
+{
+    uint8_t bytes[4];
+    uint32_t result;
+
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+    memcpy(&result, bytes, sizeof(result));
+
+    return(result);
+}
+
+/*!
+ * \brief Convert network to host byte order without relying on a socket library
+ *
+ * \param[in]  value   network byte order
+ *
+ * \return host byte order
+ */
+static uint32_t message_from_network(uint32_t value)
+{
+    uint8_t bytes[4];
+
+    memcpy(bytes, &value, sizeof(bytes));
+
+    return(((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3]);
+}
@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef MESSAGE_CODEC_H
+#define MESSAGE_CODEC_H
+
+#include <stdint.h>
+
+#include "message_defs.h"
+
+#define MESSAGE_PROTOCOL_VERSION    (1)
+#define MESSAGE_PORT                (6969)
+#define MESSAGE_MAX_LENGTH          (128)
+
+// every field of every message in host byte order
+typedef struct
+{
+    tsMSG_HDR sHeader;
+    int iError;
+    int pattern;
+    int speed;
+    int wind_speed;
+    uint64_t sample_time_us;
+    uint64_t originate_us;
+    uint64_t receive_us;
+    uint64_t transmit_us;
+} MESSAGE_FIELDS_T;
+
+int message_length(teMSG_ID message);
+int message_encode_led_strip_request(tsLED_STRIP_RQST *psMsg, uint32_t transaction, uint32_t sequence, int pattern, int speed);
+int message_encode_led_strip_confirm(tsLED_STRIP_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError);
+int message_encode_wind_speed_request(tsWIND_SPEED_RQST *psMsg, uint32_t transaction, uint32_t sequence);
+int message_encode_wind_speed_confirm(tsWIND_SPEED_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError, int wind_speed, uint64_t sample_time_us);
+int message_encode_time_sync_request(tsTIME_SYNC_RQST *psMsg, uint32_t transaction, uint32_t sequence, uint64_t originate_us);
+int message_encode_time_sync_confirm(tsTIME_SYNC_CNFM *psMsg, uint32_t transaction, uint32_t sequence, int iError, uint64_t originate_us, uint64_t receive_us, uint64_t transmit_us);
+int message_decode(const void *buffer, int length, MESSAGE_FIELDS_T *psFields);
+
+#endif
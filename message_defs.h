@@ -10,6 +10,8 @@ typedef enum
     LED_STRIP_CNFM             =   1,  // server to client
     WIND_SPEED_RQST            =   2,  // client to server
     WIND_SPEED_CNFM            =   3,  // server to client    
+    TIME_SYNC_RQST             =   4,  // client to server
+    TIME_SYNC_CNFM             =   5,  // server to client
     
     NO_MSG                     =  4294967295,   //INT_MAX not sufficient 
 } teMSG_ID;
@@ -46,7 +48,29 @@ typedef struct
     tsMSG_HDR sHeader;
     int iError;
     int wind_speed;
+    uint32_t sample_time_hi;    // shared timebase (us since epoch) when wind speed was sampled, zero if unknown
+    uint32_t sample_time_lo;
 } tsWIND_SPEED_CNFM;
 
+// 64 bit timestamps are sent as two 32 bit words in network byte order, most significant word first
+typedef struct
+{
+    tsMSG_HDR sHeader;
+    uint32_t originate_hi;      // client local clock when request sent (t1)
+    uint32_t originate_lo;
+} tsTIME_SYNC_RQST;
+
+typedef struct
+{
+    tsMSG_HDR sHeader;
+    int iError;                 // 0 = no error, 1 = server timebase not synchronised
+    uint32_t originate_hi;      // copied from request (t1)
+    uint32_t originate_lo;
+    uint32_t receive_hi;        // server shared timebase when request received (t2)
+    uint32_t receive_lo;
+    uint32_t transmit_hi;       // server shared timebase when confirm sent (t3)
+    uint32_t transmit_lo;
+} tsTIME_SYNC_CNFM;
+
 #endif
 
@@ -53,6 +53,9 @@
 #include "lwip/inet_chksum.h"
 #include "lwip/prot/ip4.h"
 
+#include "pico/cyw43_arch.h"
+#include "usurper_ping.h"
+
 #if PING_USE_SOCKETS
 #include "lwip/sockets.h"
 #include "lwip/inet.h"
@@ -92,6 +95,11 @@
 #define PING_RESULT(ping_ok)
 #endif
 
+/** sweep identifier, the low bits count sweeps so late replies to an earlier one are ignored */
+#ifndef PING_SWEEP_ID
+#define PING_SWEEP_ID  0xB000
+#endif
+
 /* ping variables */
 static const ip_addr_t* ping_target;
 static u16_t ping_seq_num;
@@ -102,9 +110,19 @@ static u32_t ping_time;
 static struct raw_pcb *ping_pcb;
 #endif /* PING_USE_SOCKETS */
 
-/** Prepare a echo ICMP request */
+/* sweep state, shared with the receive callback on the tcpip thread */
+static struct ping_sweep {
+  u32_t first;                                  /* first address, host order */
+  u16_t count;                                  /* addresses swept */
+  u16_t id;                                     /* echo identifier of this sweep */
+  u32_t replied[PING_SWEEP_MAX_HOSTS / 32];     /* set by ping_sweep_recv() */
+  u32_t reported[PING_SWEEP_MAX_HOSTS / 32];    /* passed to the caller */
+} ping_sweep_state;
+
+
+/** Fill in an echo ICMP request */
 static void
-ping_prepare_echo( struct icmp_echo_hdr *iecho, u16_t len)
+ping_fill_echo( struct icmp_echo_hdr *iecho, u16_t len, u16_t id, u16_t seqno)
 {
   size_t i;
   size_t data_len = len - sizeof(struct icmp_echo_hdr);
@@ -112,8 +130,8 @@ ping_prepare_echo( struct icmp_echo_hdr *iecho, u16_t len)
   ICMPH_TYPE_SET(iecho, ICMP_ECHO);
   ICMPH_CODE_SET(iecho, 0);
   iecho->chksum = 0;
-  iecho->id     = PING_ID;
-  iecho->seqno  = lwip_htons(++ping_seq_num);
+  iecho->id     = id;
+  iecho->seqno  = lwip_htons(seqno);
 
   /* fill the additional data buffer with some data */
   for(i = 0; i < data_len; i++) {
@@ -123,6 +141,13 @@ ping_prepare_echo( struct icmp_echo_hdr *iecho, u16_t len)
   iecho->chksum = inet_chksum(iecho, len);
 }
 
+/** Prepare a echo ICMP request */
+static void
+ping_prepare_echo( struct icmp_echo_hdr *iecho, u16_t len)
+{
+  ping_fill_echo(iecho, len, PING_ID, ++ping_seq_num);
+}
+
 #if PING_USE_SOCKETS
 
 /* Ping using the socket ip */
@@ -471,4 +496,162 @@ ping_init(const ip_addr_t* ping_addr)
 #endif /* PING_USE_SOCKETS */
 }
 
+/* Note a reply to the sweep, called on the tcpip thread for every ICMP packet received */
+static u8_t
+ping_sweep_recv(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr)
+{
+  struct ping_sweep *sweep = (struct ping_sweep *)arg;
+  struct icmp_echo_hdr iecho;
+  u8_t hl;
+  u16_t index;
+  LWIP_UNUSED_ARG(pcb);
+
+  /* p starts with the ip header */
+  if ((pbuf_copy_partial(p, &hl, 1, 0) != 1) ||
+      (pbuf_copy_partial(p, &iecho, sizeof(iecho), (u16_t)((hl & 0x0f) * 4)) != sizeof(iecho)) ||
+      (ICMPH_TYPE(&iecho) != ICMP_ER) || (iecho.id != lwip_htons(sweep->id))) {
+    return 0; /* not ours, don't eat the packet */
+  }
+
+  /* the sequence number is the offset of the address in the sweep, anything else is passed on to the stack */
+  index = lwip_ntohs(iecho.seqno);
+  if ((index >= sweep->count) || !IP_IS_V4(addr) ||
+      (lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(addr))) != sweep->first + index)) {
+    return 0; /* not a reply to this sweep, don't eat the packet */
+  }
+
+  sweep->replied[index / 32] |= (u32_t)1 << (index % 32);
+
+  pbuf_free(p);
+  return 1; /* eat the packet */
+}
+
+/* Send one echo request of the sweep */
+static void
+ping_sweep_send(struct raw_pcb *pcb, struct ping_sweep *sweep, u16_t index)
+{
+  struct pbuf *p;
+  ip_addr_t addr;
+  size_t ping_size = sizeof(struct icmp_echo_hdr) + PING_DATA_SIZE;
+
+  p = pbuf_alloc(PBUF_IP, (u16_t)ping_size, PBUF_RAM);
+  if (!p) {
+    return;
+  }
+  if ((p->len == p->tot_len) && (p->next == NULL)) {
+    ping_fill_echo((struct icmp_echo_hdr *)p->payload, (u16_t)ping_size, lwip_htons(sweep->id), index);
+    ip_addr_set_ip4_u32(&addr, lwip_htonl(sweep->first + index));
+    raw_sendto(pcb, p, &addr);
+  }
+  pbuf_free(p);
+}
+
+/* Pass addresses that have replied since the last call to the caller, returns the number passed */
+static int
+ping_sweep_report(struct ping_sweep *sweep, ping_sweep_fn found, void *arg)
+{
+  u32_t fresh[PING_SWEEP_MAX_HOSTS / 32];
+  int i, bit, reported = 0;
+
+  cyw43_arch_lwip_begin();
+  for (i = 0; i < (int)LWIP_ARRAYSIZE(fresh); i++) {
+    fresh[i] = sweep->replied[i] & ~sweep->reported[i];
+    sweep->reported[i] |= fresh[i];
+  }
+  cyw43_arch_lwip_end();
+
+  /* the callback may block, so it is called without the lock */
+  for (i = 0; i < (int)LWIP_ARRAYSIZE(fresh); i++) {
+    for (bit = 0; fresh[i]; bit++) {
+      if (fresh[i] & ((u32_t)1 << bit)) {
+        fresh[i] &= ~((u32_t)1 << bit);
+        found(arg, sweep->first + i * 32 + bit);
+        reported++;
+      }
+    }
+  }
+
+  return reported;
+}
+
+/**
+ * Ping a range of IPv4 addresses, keeping many echo requests outstanding.
+ * Requests go out in bursts of PING_SWEEP_BURST paced to rate per second. Replies are
+ * matched by identifier and sequence number in one raw receive callback, and
+ * addresses that have not replied are pinged again on each of the following attempts.
+ * found() is called from the calling task for each address that replies, as soon as
+ * possible after the reply, so slow work such as probing the host overlaps the sweep.
+ *
+ * @param first first address, host byte order
+ * @param count number of addresses, at most PING_SWEEP_MAX_HOSTS
+ * @param rate most echo requests sent per second
+ * @param attempts echo requests sent to an address that does not reply
+ * @param timeout_ms wait for replies after the last request of each attempt
+ * @param found called for each address that replies
+ * @param arg passed to found
+ * @return number of addresses that replied, or -1 on error
+ */
+int
+ping_sweep(u32_t first, u32_t count, u32_t rate, int attempts, u32_t timeout_ms, ping_sweep_fn found, void *arg)
+{
+  static u16_t generation;
+  struct raw_pcb *pcb;
+  struct ping_sweep *sweep = &ping_sweep_state;
+  u32_t index, waited;
+  int attempt, burst = 0, replies = 0;
+
+  if ((count == 0) || (count > PING_SWEEP_MAX_HOSTS) || (rate == 0) || (found == NULL)) {
+    return -1;
+  }
+
+  memset(sweep, 0, sizeof(*sweep));
+  sweep->first = first;
+  sweep->count = (u16_t)count;
+  sweep->id = (u16_t)(PING_SWEEP_ID | (++generation & 0x0fff));
+
+  cyw43_arch_lwip_begin();
+  pcb = raw_new(IP_PROTO_ICMP);
+  if (pcb) {
+    raw_recv(pcb, ping_sweep_recv, sweep);
+    raw_bind(pcb, IP_ADDR_ANY);
+  }
+  cyw43_arch_lwip_end();
+  if (!pcb) {
+    return -1;
+  }
+
+  for (attempt = 0; attempt < attempts; attempt++) {
+    for (index = 0; index < count; index++) {
+      if (sweep->replied[index / 32] & ((u32_t)1 << (index % 32))) {
+        continue;
+      }
+
+      cyw43_arch_lwip_begin();
+      ping_sweep_send(pcb, sweep, (u16_t)index);
+      cyw43_arch_lwip_end();
+
+      if (++burst >= PING_SWEEP_BURST) {
+        burst = 0;
+        replies += ping_sweep_report(sweep, found, arg);
+        sys_msleep((PING_SWEEP_BURST * 1000 + rate - 1) / rate);
+      }
+    }
+
+    /* wait for the last replies, stopping early once every address has replied */
+    for (waited = 0; (waited < timeout_ms) && (replies < (int)count); waited += 100) {
+      sys_msleep(100);
+      replies += ping_sweep_report(sweep, found, arg);
+    }
+    if (replies >= (int)count) {
+      break;
+    }
+  }
+
+  cyw43_arch_lwip_begin();
+  raw_remove(pcb);
+  cyw43_arch_lwip_end();
+
+  return replies + ping_sweep_report(sweep, found, arg);
+}
+
 #endif /* LWIP_RAW */
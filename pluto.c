@@ -36,10 +36,14 @@
 #include "worker_tasks.h"
 #include "wifi.h"
 #include "calendar.h"
+#include "clock_sync.h"
+#include "store_forward.h"
 // #include "powerwall.h"
 // #include "shelly.h"
 // #include  "usurper_ping.h"
 #include "pluto.h"
+#include "web_snapshot.h"
+#include "seqlock_stress.h"
 
 #include "ssi.h"
 #ifdef USE_GIT_HASH_AS_VERSION
@@ -198,6 +202,9 @@ void boss_task(__unused void *params)
 
     // get configuration from flash
     config_read(); 
+
+    // queue syslog messages while the server is unreachable
+    store_forward_init(syslog_transmit, syslog_transmit_gap);
     
     // default gpio settings  -- primarily for unused hardware connected to gpios
     set_gpio_defaults();
@@ -275,6 +282,11 @@ void boss_task(__unused void *params)
         SLEEP_MS(1000);
     }    
 
+#ifdef SEQLOCK_STRESS
+    // debug builds check the sequence locks with a writer and reader on different cores
+    seqlock_stress_start();
+#endif
+
     // flash the led for attention while doing no actual work (like a boss!)
     while(true) 
     {
@@ -306,6 +318,9 @@ void boss_task(__unused void *params)
         // report watchdog reboot to syslog server
         check_watchdog_reboot();         
 
+        // replay syslog messages queued during an outage
+        store_forward_service();
+
         SLEEP_MS(1000);
 
         // request reboot if no sntp updates received for 24 hours
@@ -372,7 +387,9 @@ int ap_mode(void)
     dhcp_server_t dhcp_server;
     dns_server_t dns_server;    
 
+    web_write_begin(WEB_GROUP_NETWORK);
     web.access_point_mode = true;
+    web_write_end(WEB_GROUP_NETWORK);
 
     printf("Initializing AP mode\n");
     cyw43_arch_enable_ap_mode("pluto", "",	CYW43_AUTH_OPEN); 
@@ -420,7 +437,9 @@ int ap_mode(void)
         {
             cyw43_arch_disable_ap_mode();
             cyw43_arch_deinit();
+            web_write_begin(WEB_GROUP_NETWORK);
             web.access_point_mode = false;
+            web_write_end(WEB_GROUP_NETWORK);
             watchdog_enable(1, 0);
         }
         else
@@ -439,7 +458,9 @@ int ap_mode(void)
             cyw43_arch_disable_ap_mode();
             cyw43_arch_deinit();
 
+            web_write_begin(WEB_GROUP_NETWORK);
             web.access_point_mode = false;
+            web_write_end(WEB_GROUP_NETWORK);
             SLEEP_MS(100);
             
             watchdog_enable(1, 0);
@@ -460,10 +481,21 @@ int ap_mode(void)
  */
 int set_web_ip_network_info(void)
 {
+    char ip_address[IPADDR_STRLEN_MAX];
+    char network_mask[IPADDR_STRLEN_MAX];
+    char gateway[IPADDR_STRLEN_MAX];
+
+    // format outside the critical section, ipaddr_ntoa() shares one static buffer with every other caller
+    ipaddr_ntoa_r(netif_ip4_addr(&cyw43_state.netif[0]), ip_address, sizeof(ip_address));
+    ipaddr_ntoa_r(netif_ip4_netmask(&cyw43_state.netif[0]), network_mask, sizeof(network_mask));
+    ipaddr_ntoa_r(netif_ip4_gw(&cyw43_state.netif[0]), gateway, sizeof(gateway));
+
     // copy ip, netmask and gateway assigned by DHCP into web interface variables
-    STRNCPY(web.ip_address_string, ipaddr_ntoa(netif_ip4_addr(&cyw43_state.netif[0])), sizeof(web.ip_address_string));   
-    STRNCPY(web.network_mask_string, ipaddr_ntoa(netif_ip4_netmask(&cyw43_state.netif[0])), sizeof(web.network_mask_string)); 
-    STRNCPY(web.gateway_string, ipaddr_ntoa(netif_ip4_gw(&cyw43_state.netif[0])), sizeof(web.gateway_string)); 
+    web_write_begin(WEB_GROUP_NETWORK);
+    STRNCPY(web.ip_address_string, ip_address, sizeof(web.ip_address_string));
+    STRNCPY(web.network_mask_string, network_mask, sizeof(web.network_mask_string));
+    STRNCPY(web.gateway_string, gateway, sizeof(web.gateway_string));
+    web_write_end(WEB_GROUP_NETWORK);
 
     if (config.dhcp_enable)
     {
@@ -495,6 +527,7 @@ int set_realtime_clock(void)
     rtc_init();
     #endif
     setTimeSec(0);  //1970
+    clock_sync_init();
 
     // sntp timeservers
     config_timeserver_failsafe();
@@ -48,29 +48,33 @@
 
 // Pico HTTPS request example
 #include "json_parser.h"
+#include "http_client.h"
 #include "powerwall.h"              // Options, macros, forward declarations
 #include "weather.h"
 #include "config.h"
 #include "pluto.h"
+#include "watchdog.h"
+#include "web_snapshot.h"
+#ifdef INCORPORATE_HOME_CONTROLLER
+#include "hc_task.h"
+#endif
 
 
 #define GET_REQUEST "GET / HTTP/1.0\r\n\r\n"
 
 // prototypes
-int wait_for_packet(TickType_t ticks);
 void powerwall_poll(void);
+static void powerwall_publish(int grid_status, int battery_percentage, uint64_t update_time_us);
+static int powerwall_get(char *url, JSONP_FILTER_T *filters, int num_filters);
+static bool powerwall_open_session(void);
+static int powerwall_request(HTTP_REQUEST_TYPE_T type, char *url, char *content, JSONP_FILTER_T *filters, int num_filters, bool login);
+static bool powerwall_wanted(void);
 
 // external variables
 extern NON_VOL_VARIABLES_T config;
 extern WEB_VARIABLES_T web;
-extern char jsonp_value[255][128];
 extern NON_VOL_VARIABLES_T config;
 
-// global variables
-char copy_buffer[2048];
-int copy_ready = 0;
-JSON_PARSER_CONTEXT_T powerwall_parser_context;
-
 //char request_buffer[512];
 
 //#define USE_RTOS_MBEDTLS_INTERFACE
@@ -78,1039 +82,284 @@ JSON_PARSER_CONTEXT_T powerwall_parser_context;
 int bilbo(void);
 #endif
 
-typedef enum
+// login session with the gateway, the connection itself is pooled by the http client
+typedef struct
 {
-    PW_INITIATE,
-    PW_CONNECT,
-    PW_LOGIN,
-    PW_CONFIRM_LOGIN,
-    PW_GET_GRID_STATUS,
-    PW_CONFIRM_GRID_STATUS,
-    PW_GET_BATTERY,
-    PW_CONFIRM_BATTERY,
-    PW_LOGOUT,
-    PW_CONFIRM_LOGOUT,
-    PW_TEAR_DOWN
-} PW_STATE_T;
-
-
-void tear_down(struct altcp_pcb* pcb);
+    char token[256];                    // authorization token, empty when not logged in
+    char cookies[1024];
+    TickType_t login_time;
+    POWERWALL_STATS_T stats;
+} POWERWALL_SESSION_T;
+
+POWERWALL_SESSION_T powerwall_session;
 
 /* Main ***********************************************************************/
 
-int strip_first_last_quotes(char *token, int length)
+void powerwall_poll(void)
 {
-    int i;
+    TickType_t start = xTaskGetTickCount();
+    int grid;
+    char grid_status[64];
+    char battery_percentage[32];    
+    JSONP_FILTER_T grid_status_filter[] = {{"root.\"grid_status\"", grid_status, sizeof(grid_status), false, false}};
+    JSONP_FILTER_T battery_filter[] = {{"root.\"percentage\"", battery_percentage, sizeof(battery_percentage), false, false}};
 
-    if (token && (length > 2)) 
+    //TODO: -- sanity check on config, prevent multiple login failures
+
+    if ((powerwall_get("/api/system_status/grid_status", grid_status_filter, NUM_ROWS(grid_status_filter)) != 200) ||
+        !grid_status_filter[0].found)
     {
-        if (token[0] == '"')
+        printf("FAILED TO GET powerwall GRID STATUS\n");
+        if (web.powerwall_grid_status == GRID_UP)
         {
-            //printf("start quote strip length = %d\n", length);
-            for (i=0; i < length-2; i++)
-            {
-                //printf("checking: %d[%c][%c]\n", i, token[i+1], token[i+2]);
-                if (((token[i+1] == '"') && (token[i+2] == 0)) ||
-                     (token[i+1] == 0))
-                {
-                    //printf("terminated quote strip\n");
-                    token[i] = 0;
-                    break;
-                }
-                else
-                {
-                    token[i] = token[i+1];
-                    //printf("copied: %c\n", token[i]);
-                }
-            }
-            //printf("ended quote strip\n");
+            // only move to unknown if grid was up, if grid was down continue to assume it is down unitl a response is received
+            powerwall_publish(GRID_UNKNOWN, web.powerwall_battery_percentage, web.powerwall_update_time_us);
         }
+        return;
     }
 
-    return(0);
-}
-
-
-void powerwall_poll(void)
-{
-    static PW_STATE_T powerwall_connection_state = PW_INITIATE;
-    static int retry = 0;
-    const int max_retries = 2;
-    struct altcp_pcb* pcb = NULL;
-    char *start_of_json = NULL;
-    char *start_of_cookie = NULL;
-    int i;
-    char cookie[1024];
-    char grid_status[256];
-    char battery_percentage[256];    
-    char authorization_token[256];
-
-    //TODO: -- sanity check on config, prevent multiple login failures
-
-    // check if retry limit reached
-    if (retry >= max_retries)
+    printf("Powerwall Grid Status is = %s\n", grid_status);
+    
+    if (strcasestr(grid_status, "SystemGridConnected"))
+    {
+        grid = GRID_UP;
+    }
+    else
     {
-        powerwall_connection_state = PW_TEAR_DOWN;
-        retry = 0;
+        grid = GRID_DOWN;
     }
 
-    switch(powerwall_connection_state)
+    if ((powerwall_get("/api/system_status/soe", battery_filter, NUM_ROWS(battery_filter)) != 200) ||
+        !battery_filter[0].found)
     {
-        default:
-        case PW_INITIATE:
-            // resolve server hostname
-            ip_addr_t ipaddr;
-            char* char_ipaddr;
-            //printf("Resolving %s\n", PICOHTTPS_HOSTNAME);
-            if(!resolve_hostname(&ipaddr))
-            {
-                printf("Failed to resolve powerwall host = %s\n", config.powerwall_ip);
-                break;
-            } 
-            else
-            {
-                cyw43_arch_lwip_begin();
-                char_ipaddr = ipaddr_ntoa(&ipaddr);
-                cyw43_arch_lwip_end();
-                //printf("Resolved %s (%s)\n", PICOHTTPS_HOSTNAME, char_ipaddr);
-
-                powerwall_connection_state = PW_CONNECT;
-            } 
-            // deliberate fall through
-
-        case PW_CONNECT:
-            // connect to powerwall
-            pcb = NULL;
-            printf("Connecting to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-            if(!connect_to_host(&ipaddr, &pcb))
-            {
-                printf("Failed to connect to powerwall at https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                retry++;
-                break;
-            }
-            else
-            {
-                //printf("Connected to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                retry = 0;
-                powerwall_connection_state = PW_LOGIN;
-            }
-
-            // deliberate fall through
-
-        case PW_LOGIN:
-            // send login request to powerwall
-            //printf("Sending login request\n");
-            if(!powerwall_login(pcb))
-            {        
-                printf("Failed to send powerwall login request\n");
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;
-                break;
-            }
-            else
-            {
-                //printf("Sent login request to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                //retry = 0;
-                powerwall_connection_state = PW_CONFIRM_LOGIN;                
-            }
-
-            // deliberate fall through
-
-        case PW_CONFIRM_LOGIN:            
-            // Await HTTP response
-            //printf("Awaiting login confirmation\n");
-            //sleep_ms(5000);
-            wait_for_packet(5000);
-            //printf("Awaited response\n");
-
-            http_extract_cookies(copy_buffer, cookie, sizeof(cookie));
-
-            //printf("parse json\n");
-            start_of_json = strcasestr(copy_buffer, "\r\n{");
-            if (start_of_json)
-            {
-                start_of_json += 2; // point to opening brace
-
-                jsonp_parse_buffer(&powerwall_parser_context, start_of_json, false);
-                //jsonp_parse_buffer(start_of_json);
-            }
-            //jsonp_dump_key_value_pairs();
-            //jsonp+dump_tokens(); 
-
-            if (jsonp_get_value(&powerwall_parser_context, "root.\"token\"", authorization_token, sizeof(authorization_token), false))
-            {
-                printf("Powerwall login failed.\n");
-
-                jsonp_dump_key_value_pairs(&powerwall_parser_context);
-                //jsonp_dump_tokens(&powerwall_parser_context);
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;
-                break;
-            } 
-            else            
-            {
-                strip_first_last_quotes(authorization_token, sizeof(authorization_token));
-                //printf("Login successful.  Authorization token is = %s\n", authorization_token);
-                retry = 0;
-                powerwall_connection_state = PW_GET_GRID_STATUS; 
-            } 
-           
-            // deliberate fallthrough
-
-        case PW_GET_GRID_STATUS:
-            // send status request to powerwall
-            //printf("Sending grid status request to powerwall\n");
-            if(!powerwall_get_grid_status(pcb, authorization_token, cookie))
-            {        
-                printf("Failed to send powewall grid status request\n");
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;
-                break;
-            }
-            else
-            {
-                //printf("Sent status request in to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                //retry = 0;
-                powerwall_connection_state = PW_CONFIRM_GRID_STATUS;                
-            }
-
-            // deliberate fallthrough
-
-        case PW_CONFIRM_GRID_STATUS:  
-            // Await status response
-            //printf("Awaiting grid status response\n");
-            //sleep_ms(5000);
-            wait_for_packet(5000);
-            //printf("Awaited response\n");
-
-            //printf("parse json\n");
-            start_of_json = strcasestr(copy_buffer, "\r\n{");
-            if (start_of_json)
-            {
-                start_of_json += 2; // point to opening brace
-
-                jsonp_parse_buffer(&powerwall_parser_context, start_of_json, false);
-                //jsonp_parse_buffer(start_of_json);
-            }
-
-            if (jsonp_get_value(&powerwall_parser_context, "root.\"grid_status\"", grid_status, sizeof(grid_status), false))
-            {
-                printf("FAILED TO GET powerwall GRID STATUS\n");
-                if (web.powerwall_grid_status == GRID_UP)
-                {
-                    // only move to unknown if grid was up, if grid was down continue to assume it is down unitl a response is received
-                    web.powerwall_grid_status = GRID_UNKNOWN;  
-                }
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;             
-                break;
-            }
-            else
-            {
-                printf("Powerwall Grid Status is = %s\n", grid_status);
-                
-                if (strcasestr(grid_status, "SystemGridConnected"))
-                {
-                    web.powerwall_grid_status = GRID_UP;
-                }
-                else
-                {
-                    web.powerwall_grid_status = GRID_DOWN;
-                }
-                
-                //printf("==> %d\n", web.powerwall_grid_up);
-
-                retry = 0;
-                //powerwall_connection_state = PW_LOGOUT;
-            }
-
-            // deliberate fallthrough
-
-        case PW_GET_BATTERY:
-            // send battery request to powerwall
-            //printf("Sending battery request to powerwall\n");
-            if(!powerwall_get_battery_percentage(pcb, authorization_token, cookie))
-            {        
-                printf("Failed to send powerwall battery status request\n");
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;
-                break;
-            }
-            else
-            {
-                //printf("Sent status request in to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                //retry = 0;
-                powerwall_connection_state = PW_CONFIRM_GRID_STATUS;                
-            }
-
-            // deliberate fallthrough
-
-        case PW_CONFIRM_BATTERY:  
-            // Await status response
-            //printf("Awaiting battery response\n");
-            //sleep_ms(5000);
-            wait_for_packet(5000);
-            //printf("Awaited battery response\n");
-
-            //printf("parse json\n");
-            start_of_json = strcasestr(copy_buffer, "\r\n{");
-            if (start_of_json)
-            {
-                start_of_json += 2; // point to opening brace
-
-                jsonp_parse_buffer(&powerwall_parser_context, start_of_json, false);
-                //jsonp_parse_buffer(start_of_json);
-            }
-
-            if (jsonp_get_value(&powerwall_parser_context, "root.\"percentage\"", battery_percentage, sizeof(battery_percentage), false))
-            {
-                printf("FAILED TO GET powerwall BATTERY PERCENTAGE\n");
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;            
-                break;
-            }
-            else
-            {
-                printf("Powerwall Battery Percentage is = %s\n", battery_percentage);
-
-                // original -- value without tenths
-                //sscanf(battery_percentage, "%d.", &(web.powerwall_battery_percentage));
-
-                // new -- value with tenths as all the thresholds are in this format
-                web.powerwall_battery_percentage = get_int_with_tenths_from_string(battery_percentage); 
-
-                //printf("==> %d\n", web.powerwall_battery_percentage);
-
-                retry = 0;
-                //powerwall_connection_state = PW_LOGOUT;
-            }
-            
-            //deleberate fallthrough
-
-        case PW_LOGOUT:
-            // send logout request to powerwall
-            //printf("Sending logout request\n");
-            if(!powerwall_logout(pcb, authorization_token, cookie))
-            {        
-                printf("Failed to send powerwall logout request\n");
-
-                // tear down connection
-                tear_down(pcb);
-                pcb = NULL;
-
-                powerwall_connection_state = PW_INITIATE;                
-                break;
-            }
-            else
-            {
-                //printf("Sent login request to https://%s:%d\n", char_ipaddr, LWIP_IANA_PORT_HTTPS);
-                //retry = 0;
-                powerwall_connection_state = PW_CONFIRM_LOGIN;                
-            }
-            
-            // deliberate fallthrough
-            
-        case PW_CONFIRM_LOGOUT:  
-            // Await status response
-            //printf("Awaiting logout response\n");
-            //sleep_ms(5000);
-            wait_for_packet(5000);
-            //printf("Awaited response\n");
-
-            // Response: HTTP/2 204  date: Thu, 03 Oct 2019 13:48:10 GMT
-            //printf("Checking response\n");
-            if (strcasestr(copy_buffer, "date"))
-            {
-                //printf("LOGOUT OK\n");
-            }
-            else
-            {
-                printf("LOGOUT FAILED\n");
-            }
-
-            // deliberate fallthrough
- 
-        case PW_TEAR_DOWN:
-            tear_down(pcb);
-            pcb = NULL;
-
-            retry = 0;  
-            powerwall_connection_state = PW_INITIATE;      
-            break;
+        printf("FAILED TO GET powerwall BATTERY PERCENTAGE\n");
+        powerwall_publish(grid, web.powerwall_battery_percentage, web.powerwall_update_time_us);
+        return;
     }
 
-    // TEST TEST TEST
-    jsonp_initialize_context(&powerwall_parser_context);
-    jsonp_initialize_cache(&powerwall_parser_context);
-    sprintf(grid_status, "UNKNOWN");
-    sprintf(battery_percentage, "UNKNOWN");
-    sprintf(copy_buffer, "XXXXXXXXXXXXXXXXXXXXXXXXX");
+    printf("Powerwall Battery Percentage is = %s\n", battery_percentage);
+
+    // value with tenths as all the thresholds are in this format
+    powerwall_publish(grid, get_int_with_tenths_from_string(battery_percentage), time_us_64());
+
+    powerwall_session.stats.refresh_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
 
     return;
 }
 
-
-void powerwall_check(void)
+/*!
+ * \brief Publish the powerwall status for the thermostat and web pages
+ *
+ * \param[in]   grid_status         GRID_UP, GRID_DOWN or GRID_UNKNOWN
+ * \param[in]   battery_percentage  percentage in tenths
+ * \param[in]   update_time_us      when both were last read from the gateway
+ *
+ * \return nothing
+ */
+static void powerwall_publish(int grid_status, int battery_percentage, uint64_t update_time_us)
 {
-    static bool first_poll = true; 
-    static TickType_t last_poll= 0;
-    TickType_t now = 0;
+    web_write_begin(WEB_GROUP_POWERWALL);
+    web.powerwall_grid_status = grid_status;
+    web.powerwall_battery_percentage = battery_percentage;
+    web.powerwall_update_time_us = update_time_us;
+    web_write_end(WEB_GROUP_POWERWALL);
+}
 
-    now = xTaskGetTickCount();
+/*!
+ * \brief Get a status page over the open session, logging in again if needed
+ *
+ * \param[in]   url             page to get
+ * \param[in]   filters         json values wanted from the response
+ * \param[in]   num_filters     number of filters
+ *
+ * \return http status, or -1 if no response was received
+ */
+static int powerwall_get(char *url, JSONP_FILTER_T *filters, int num_filters)
+{
+    int status = -1;
+    int attempt;
 
-    if (((now - last_poll) > 1000*60*15) || first_poll)
+    // a token expiring and the connection dropping can both happen on the same poll
+    for (attempt = 0; attempt < 3; attempt++)
     {
-        powerwall_poll();
-
-        last_poll = now;
-        first_poll = false;
-    }
-}
+        if (!powerwall_open_session())
+        {
+            continue;
+        }
 
+        status = powerwall_request(HTTP_GET, url, NULL, filters, num_filters, false);
 
-void tear_down(struct altcp_pcb* pcb)
-{
-    if(pcb)
-    {
-        
-        if (((struct altcp_callback_arg*)(pcb->arg))->config)
+        if ((status == 401) || (status == 403))
         {
-            // free connection configuration
-            altcp_free_config(((struct altcp_callback_arg*)(pcb->arg))->config);    
+            // token expired, log in again
+            powerwall_session.token[0] = 0;
         }
-        
-        if ((struct altcp_callback_arg*)(pcb->arg))
+        else if (status >= 0)
         {
-            // free connection callback argument
-            altcp_free_arg((struct altcp_callback_arg*)(pcb->arg));                 
+            break;
         }
 
-        // free connection PCB
-        altcp_free_pcb(pcb);                                                    
-        
-        pcb = NULL;
-    }
-}
-
-
-// Resolve hostname
-bool resolve_hostname(ip_addr_t* ipaddr){
-
-    // Zero address
-    ipaddr->addr = IPADDR_ANY;
-
-    // Attempt resolution
-    cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = dns_gethostbyname(
-        /*PICOHTTPS_HOSTNAME,*/
-        config.powerwall_ip,
-        ipaddr,
-        callback_gethostbyname,
-        ipaddr
-    );
-    cyw43_arch_lwip_end();
-    if(lwip_err == ERR_INPROGRESS){
-
-        // Await resolution
-        //
-        //  IP address will be made available shortly (by callback) upon DNS
-        //  query response.
-        //
-        while(ipaddr->addr == IPADDR_ANY)
-            sleep_ms(PICOHTTPS_RESOLVE_POLL_INTERVAL);
-        if(ipaddr->addr != IPADDR_NONE)
-            lwip_err = ERR_OK;
-
+        // a dropped connection is reopened by the next request, resuming the tls session
     }
 
-    // Return
-    return !((bool)lwip_err);
-
-}
-
-// Free TCP + TLS protocol control block
-void altcp_free_pcb(struct altcp_pcb* pcb){
-    cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = altcp_close(pcb);         // Frees PCB
-    cyw43_arch_lwip_end();
-    while(lwip_err != ERR_OK)
-        sleep_ms(PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL);
-        cyw43_arch_lwip_begin();
-        lwip_err = altcp_close(pcb);                // Frees PCB
-        cyw43_arch_lwip_end();
-}
-
-// Free TCP + TLS connection configuration
-void altcp_free_config(struct altcp_tls_config* config){
-    cyw43_arch_lwip_begin();
-    altcp_tls_free_config(config);
-    cyw43_arch_lwip_end();
-}
-
-// Free TCP + TLS connection callback argument
-void altcp_free_arg(struct altcp_callback_arg* arg){
-    if(arg){
-        free(arg);
-    }
+    return(status);
 }
 
-// Establish TCP + TLS connection with server
-bool connect_to_host(ip_addr_t* ipaddr, struct altcp_pcb** pcb){
-
-    // Instantiate connection configuration
-    u8_t ca_cert[] = PICOHTTPS_CA_ROOT_CERT;
-    cyw43_arch_lwip_begin();
-    struct altcp_tls_config* config = altcp_tls_create_config_client(
-        /*ca_cert,
-        LEN(ca_cert)*/ NULL, 0
-    );
-    cyw43_arch_lwip_end();
-    if(!config) return false;
-
-    // Instantiate connection PCB
-    
-    //  Can also do this more generically using;
-    
-    //    altcp_allocator_t allocator = {
-    //      altcp_tls_alloc,       // Allocator function
-    //      config                 // Allocator function argument (state)
-    //    };
-    //    altcp_new(&allocator);
-    
-    //  No benefit in doing this though; altcp_tls_alloc calls altcp_tls_new
-    //  under the hood anyway.
-    
-    cyw43_arch_lwip_begin();
-    *pcb = altcp_tls_new(config, IPADDR_TYPE_V4);
-    cyw43_arch_lwip_end();
-    if(!(*pcb)){
-        altcp_free_config(config);
-        return false;
-    }
-
-    // Configure hostname for Server Name Indication extension
-    //
-    //  Many servers nowadays require clients to support the [Server Name
-    //  Indication[wiki-sni] (SNI) TLS extension. In this extension, the
-    //  hostname is included in the in the ClientHello section of the TLS
-    //  handshake.
-    //
-    //  Mbed TLS provides client-side support for SNI extension
-    //  (`MBEDTLS_SSL_SERVER_NAME_INDICATION` option), but requires the
-    //  hostname in order to do so. Unfortunately, the Mbed TLS port supplied
-    //  with lwIP (ALTCP TLS) does not currently provide an interface to pass
-    //  the hostname to Mbed TLS. This is a [known issue in lwIP][gh-lwip-pr].
-    //
-    //  As a workaround, the hostname can instead be set using the underlying
-    //  Mbed TLS interface (viz. `mbedtls_ssl_set_hostname` function). This is
-    //  somewhat inelegant as it tightly couples our application code to the
-    //  underlying TLS library (viz. Mbed TLS). Given that the Pico SDK already
-    //  tightly couples us to lwIP though, and that any fix is unlikely to be
-    //  backported to the lwIP version in the Pico SDK, this doesn't feel like
-    //  too much of a crime…
-    //
-    //  [wiki-sni]: https://en.wikipedia.org/wiki/Server_Name_Indication
-    //  [gh-lwip-pr]: https://github.com/lwip-tcpip/lwip/pull/47/commits/c53c9d02036be24a461d2998053a52991e65b78e
-    //
-    cyw43_arch_lwip_begin();
-    mbedtls_err_t mbedtls_err = mbedtls_ssl_set_hostname(
-        &(
-            (
-                (altcp_mbedtls_state_t*)((*pcb)->state)
-            )->ssl_context
-        ),
-        PICOHTTPS_HOSTNAME
-    );
-    cyw43_arch_lwip_end();
-    if(mbedtls_err){
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        return false;
-    }
-
-    // Configure common argument for connection callbacks
-    //
-    //  N.b. callback argument must be in scope in callbacks. As callbacks may
-    //  fire after current function returns, cannot declare argument locally,
-    //  but rather should allocate on the heap. Must then ensure allocated
-    //  memory is subsequently freed.
-    //
-    struct altcp_callback_arg* arg = malloc(sizeof(*arg));
-    if(!arg){
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        return false;
-    }
-    arg->config = config;
-    arg->connected = false;
-    cyw43_arch_lwip_begin();
-    altcp_arg(*pcb, (void*)arg);
-    cyw43_arch_lwip_end();
-
-    // Configure connection fatal error callback
-    cyw43_arch_lwip_begin();
-    altcp_err(*pcb, callback_altcp_err);
-    cyw43_arch_lwip_end();
-
-    // Configure idle connection callback (and interval)
-    cyw43_arch_lwip_begin();
-    altcp_poll(
-        *pcb,
-        callback_altcp_poll,
-        PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL
-    );
-
-    //TODO newman found this on internet for non-tls connection
-    //pcb->keep_intvl = 1000; // send "keep-alive" every 1000ms
-
-    cyw43_arch_lwip_end();
-
-    // Configure data acknowledge callback
-    cyw43_arch_lwip_begin();
-    altcp_sent(*pcb, callback_altcp_sent);
-    cyw43_arch_lwip_end();
-
-    // Configure data reception callback
-    cyw43_arch_lwip_begin();
-    altcp_recv(*pcb, callback_altcp_recv);
-    cyw43_arch_lwip_end();
-
-    // Send connection request (SYN)
-    cyw43_arch_lwip_begin();
-    lwip_err_t lwip_err = altcp_connect(
-        *pcb,
-        ipaddr,
-        LWIP_IANA_PORT_HTTPS,
-        callback_altcp_connect
-    );
-    cyw43_arch_lwip_end();
-
-    // Connection request sent
-    if(lwip_err == ERR_OK){
-
-        // Await connection
-        //
-        //  Sucessful connection will be confirmed shortly in
-        //  callback_altcp_connect.
-        //
-        while(!(arg->connected))
-            sleep_ms(PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL);
-
-    } else {
-
-        // Free allocated resources
-        altcp_free_pcb(*pcb);
-        altcp_free_config(config);
-        altcp_free_arg(arg);
+/*!
+ * \brief Make sure there is a current authorization token
+ *
+ * \return true if requests can be sent
+ */
+static bool powerwall_open_session(void)
+{
+    char content[256];
+    JSONP_FILTER_T token_filter[] = {{"root.\"token\"", powerwall_session.token, sizeof(powerwall_session.token), true, false}};
+    int status;
 
+    if (powerwall_session.token[0] &&
+        ((xTaskGetTickCount() - powerwall_session.login_time) * portTICK_PERIOD_MS < POWERWALL_TOKEN_LIFETIME_MS))
+    {
+        return(true);
     }
 
-    //Return
-    return !((bool)lwip_err);
-
-}
-
-// DNS response callback
-void callback_gethostbyname(
-    const char* name,
-    const ip_addr_t* resolved,
-    void* ipaddr
-){
-    if(resolved) *((ip_addr_t*)ipaddr) = *resolved;         // Successful resolution
-    else ((ip_addr_t*)ipaddr)->addr = IPADDR_NONE;          // Failed resolution
-}
-
-// TCP + TLS connection error callback
-void callback_altcp_err(void* arg, lwip_err_t err){
-
-    // Print error code
-    printf("Connection error [lwip_err_t err == %d]\n", err);
-
-    // Free ALTCP TLS config
-    if( ((struct altcp_callback_arg*)arg)->config )
-        altcp_free_config( ((struct altcp_callback_arg*)arg)->config );
-
-    // Free ALTCP callback argument
-    altcp_free_arg((struct altcp_callback_arg*)arg);
-
-}
-
-// TCP + TLS connection idle callback
-lwip_err_t callback_altcp_poll(void* arg, struct altcp_pcb* pcb){
-    // Callback not currently used
-    return ERR_OK;
-}
-
-// TCP + TLS data acknowledgement callback
-lwip_err_t callback_altcp_sent(void* arg, struct altcp_pcb* pcb, u16_t len){
-    ((struct altcp_callback_arg*)arg)->acknowledged = len;
-    return ERR_OK;
-}
+    sprintf(content, "{\"username\":\"customer\",\"password\":\"%s\"}", config.powerwall_password);
 
-// TCP + TLS data reception callback
-lwip_err_t callback_altcp_recv(
-    void* arg,
-    struct altcp_pcb* pcb,
-    struct pbuf* buf,
-    lwip_err_t err
-){
-
-    // Store packet buffer at head of chain
-    //
-    //  Required to free entire packet buffer chain after processing.
-    //
-    struct pbuf* head = buf;
-
-    switch(err){
-
-        // No error receiving
-        case ERR_OK:
-
-            // Handle packet buffer chain
-            //
-            //  * buf->tot_len == buf->len — Last buf in chain
-            //    * && buf->next == NULL — last buf in chain, no packets in queue
-            //    * && buf->next != NULL — last buf in chain, more packets in queue
-            //
-
-            if(buf){
-
-                // Print packet buffer
-                u16_t i;
-                int copy_index = 0;
-                while(buf->len != buf->tot_len)
-                {
-                    for(i = 0; i < buf->len; i++)
-                    {
-                        //putchar(((char*)buf->payload)[i]);
-                        if (copy_index < sizeof(copy_buffer)) copy_buffer[copy_index++] = ((char*)buf->payload)[i];
-                    } 
-                    buf = buf->next;
-                }
-                for(i = 0; i < buf->len; i++)
-                {
-                    //putchar(((char*)buf->payload)[i]);
-                    if (copy_index < sizeof(copy_buffer)) copy_buffer[copy_index++] = ((char*)buf->payload)[i];
-                } 
-                copy_buffer[copy_index] = 0; // ensure zero termination
-                copy_ready++;
-                assert(buf->next == NULL);
-
-                // Advertise data reception
-                altcp_recved(pcb, head->tot_len);
-
-            }
-
-            // …fall-through…
-
-        case ERR_ABRT:
-
-            // Free buf
-            pbuf_free(head);        // Free entire pbuf chain
-
-            // Reset error
-            err = ERR_OK;           // Only return ERR_ABRT when calling tcp_abort()
+    status = powerwall_request(HTTP_POST, "/api/login/Basic", content, token_filter, NUM_ROWS(token_filter), true);
 
+    if ((status != 200) || !token_filter[0].found)
+    {
+        printf("Powerwall login failed. HTTP status = %d\n", status);
+        powerwall_session.token[0] = 0;
+        return(false);
     }
 
-    //printf("\nRCV CALLBACK COMPLETED err = %d\n", err);
-    // Return error
-    return err;
-
-}
-
-// TCP + TLS connection establishment callback
-lwip_err_t callback_altcp_connect(
-    void* arg,
-    struct altcp_pcb* pcb,
-    lwip_err_t err
-){
-    ((struct altcp_callback_arg*)arg)->connected = true;
-    return ERR_OK;
-}
-
-
-int powerwall_init(void)
-{
-    jsonp_initialize_context(&powerwall_parser_context);
-    jsonp_initialize_cache(&powerwall_parser_context);
-    // test_http(1);
-    // jsonp_dump_key_value_pairs(); 
+    powerwall_session.login_time = xTaskGetTickCount();
+    powerwall_session.stats.logins++;
 
-    return(0); 
+    return(true);
 }
 
-
-// Send HTTP request
-bool http_request(struct altcp_pcb* pcb, HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content, char *auth_token, char *cookies)
+/*!
+ * \brief Send a request to the gateway and parse the response as it arrives
+ *
+ * \param[in]   type            get or post
+ * \param[in]   url             page
+ * \param[in]   content         body to post, may be NULL
+ * \param[in]   filters         json values wanted from the response
+ * \param[in]   num_filters     number of filters
+ * \param[in]   login           send no credentials and keep the cookies from the response
+ *
+ * \return http status, or -1 if no response was received
+ */
+static int powerwall_request(HTTP_REQUEST_TYPE_T type, char *url, char *content, JSONP_FILTER_T *filters, int num_filters, bool login)
 {
-    bool err = false;
-    char request[2048];
-    int length = 0;
-    char length_string[8];
-    lwip_err_t lwip_err = -1;
-   
-
-    // type
-    switch(type)
-    {
-        case HTTP_GET:
-            sprintf(request, "GET ");
-            break;
-        case HTTP_POST:
-            sprintf(request, "POST ");
-            break;
-        default:
-            request[0] = 0;
-            err = true;
-    }
-
-    // url
-    STRAPPEND(request, url);
-    STRAPPEND(request, " HTTP/1.1\r\n");
-
-    // host
-    STRAPPEND(request, "Host: ");
-    STRAPPEND(request, host);
-    STRAPPEND(request, "\r\n");
-
-    // accept
-    STRAPPEND(request, "Accept: */*\r\n");
-
-    // cookies
-    if (cookies)
-    {
-        STRAPPEND(request, "Cookie: ");
-        STRAPPEND(request, cookies);
-        STRAPPEND(request, "\r\n");        
-    }
-
-    // authorization token
-    if (auth_token)
+    HTTP_CLIENT_REQUEST_T request;
+    char headers[sizeof(powerwall_session.cookies) + sizeof(powerwall_session.token) + 40];
+    int status;
+
+    memset(&request, 0, sizeof(request));
+    request.type = type;
+    request.address = config.powerwall_ip;
+    request.tls = true;
+    request.host = config.powerwall_hostname;
+    request.url = url;
+    request.content = content;
+    request.filters = filters;
+    request.num_filters = num_filters;
+
+    if (login)
     {
-        STRAPPEND(request, "Authorization: Bearer ");
-        STRAPPEND(request, auth_token);
-        STRAPPEND(request, "\r\n");
+        request.cookies = powerwall_session.cookies;
+        request.cookies_size = sizeof(powerwall_session.cookies);
     }
-
-    // content
-    if (content)
+    else
     {
-        sprintf(length_string, "%d", strlen(content));
-
-        STRAPPEND(request, "Content-Type: application/json\r\n");
-        STRAPPEND(request, "Content-Length: ");
-        STRAPPEND(request, length_string);
-        STRAPPEND(request, "\r\n\r\n");
-        STRAPPEND(request, content);
+        snprintf(headers, sizeof(headers), "Cookie: %s\r\nAuthorization: Bearer %s\r\n", powerwall_session.cookies, powerwall_session.token);
+        request.headers = headers;
     }
-    STRAPPEND(request, "\r\n");
 
-    // request length 
-    length = strlen(request) + 1; // TODO figure out WTF the original code is doing by transmitting one less
+    status = http_client_fetch(&request);
 
-    if(!err)
+    if (status >= 0)
     {
-        //printf("SEND [%d bytes]\n%s\n", length, request); 
-        
-        // Check send buffer and queue length
-        //
-        //  Docs state that altcp_write() returns ERR_MEM on send buffer too small
-        //  _or_ send queue too long. Could either check both before calling
-        //  altcp_write, or just handle returned ERR_MEM — which is preferable?
-        //
-        if(
-        altcp_sndbuf(pcb) < (length - 1)
-        || altcp_sndqueuelen(pcb) > TCP_SND_QUEUELEN
-        ) return -1;
-
-        // Write to send buffer
-        cyw43_arch_lwip_begin();
-        lwip_err = altcp_write(pcb, request, length -1, 0);
-        cyw43_arch_lwip_end();
-
-        // Written to send buffer
-        if(lwip_err == ERR_OK){
-
-            // Output send buffer
-            ((struct altcp_callback_arg*)(pcb->arg))->acknowledged = 0;
-            cyw43_arch_lwip_begin();
-            lwip_err = altcp_output(pcb);
-            cyw43_arch_lwip_end();
-
-            // Send buffer output
-            if(lwip_err == ERR_OK){
-
-                // Await acknowledgement
-                while(
-                    !((struct altcp_callback_arg*)(pcb->arg))->acknowledged
-                ) sleep_ms(PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL);
-                if(
-                    ((struct altcp_callback_arg*)(pcb->arg))->acknowledged
-                    != (length - 1)
-                ) lwip_err = -1;
-
-            }
-
-        }
+        powerwall_session.stats.requests++;
     }
-    // Return
-    return !((bool)lwip_err);
 
+    return(status);
 }
 
-
-int powerwall_login(struct altcp_pcb* pcb)
+/*!
+ * \brief Get the session statistics
+ *
+ * \param[out]  stats       copy of the statistics
+ *
+ * \return nothing
+ */
+void powerwall_get_stats(POWERWALL_STATS_T *stats)
 {
-    int err = 0;
-    char content[256];
-
-    sprintf(content, "{\"username\":\"customer\",\"password\":\"%s\"}", config.powerwall_password);
-
-    err = http_request(pcb, HTTP_POST, "/api/login/Basic", config.powerwall_hostname, content, NULL, NULL);
-
-    return(err);
+    *stats = powerwall_session.stats;
 }
 
 
-
-int powerwall_get_grid_status(struct altcp_pcb* pcb, char *auth_token, char *cookies)
+/*!
+ * \brief Check if anything uses the powerwall status
+ *
+ * \return true for the thermostat, or the home controller while a rule tests grid or battery
+ */
+static bool powerwall_wanted(void)
 {
-    int err = 0;   
+#ifdef INCORPORATE_HOME_CONTROLLER
+    if (config.personality == HOME_CONTROLLER)
+    {
+        return(hc_task_powerwall_wanted());
+    }
+#endif
 
-    err = http_request(pcb, HTTP_GET, "/api/system_status/grid_status", config.powerwall_hostname, NULL, auth_token, cookies);
-    
-    return(err);
+    return(config.personality == HVAC_THERMOSTAT);
 }
 
-int powerwall_get_battery_percentage(struct altcp_pcb* pcb, char *auth_token, char *cookies)
+/*!
+ * \brief Poll the powerwall gateway and publish its status, kept off the thermostat task so a slow gateway never delays it
+ *
+ * \param params watchdog alive indicator
+ * 
+ * \return nothing
+ */
+void powerwall_task(void *params)
 {
-    int err = 0;   
+    bool first_poll = true; 
+    TickType_t last_poll = 0;
 
-    err = http_request(pcb, HTTP_GET, "/api/system_status/soe", config.powerwall_hostname, NULL, auth_token, cookies);
-    
-    return(err);
-}
+    powerwall_init();
+    powerwall_publish(GRID_UNKNOWN, 0, 0);
 
-int powerwall_logout(struct altcp_pcb* pcb, char *auth_token, char *cookies)
-{
-    int err = 0;   
+    while (true)
+    {
+        if (powerwall_wanted() &&
+            (first_poll || ((xTaskGetTickCount() - last_poll) * portTICK_PERIOD_MS >= POWERWALL_POLL_INTERVAL_MS)))
+        {
+            last_poll = xTaskGetTickCount();
+            first_poll = false;
 
-    err = http_request(pcb, HTTP_GET, "/api/logout", config.powerwall_hostname, NULL, auth_token, cookies);
-    
-    return(err);
-}
+            powerwall_poll();
+        }
 
-int http_extract_cookies(const char *http_packet, char *cookies, int length)
-{
-    int err = 0;
-    char *source = NULL;
-    int i = 0;
-    int j = 0;
+        SLEEP_MS(POWERWALL_TASK_LOOP_DELAY);
 
-    // check paramters are sane
-    if (!http_packet || !cookies || (length < 1))
-    {
-        err = 1;
+        // tell watchdog task that we are still alive
+        watchdog_pulse((int *)params);
     }
-    else
-    {
-        // source pointer to walk through packet
-        source = (char *)http_packet;
-
-        // concatenate cookies found in http header
-        do
-        {
-            source = strcasestr(source, "Set-Cookie: ");
-            if (source)
-            {
-                //printf("GOT COOKIE: ");
-
-                // inject a space between cookies
-                if (j > 0)
-                {
-                    cookies[j++] = ' ';
-                    cookies[j] = 0;
-                }
-
-                // copy cookie
-                source += strlen("Set-Cookie: ");
-                for (i=0; source[i] && (j < (length - 1)); i++, j++)
-                {
-                    //printf("%c", source[i]);
-                    cookies[j] = source[i];
-
-                    if (source[i] == ';')
-                    {
-                        // terminate string after semi-colon
-                        cookies[++j] = 0;
-                        break;
-                    } 
-                }
-
-                //printf("\n"); 
-                
-                // move source pointer past copied cookie
-                source += i;
-            }        
-        } while (source && (j < (length - 1)));
-    
-        // remove final semi-colon
-        if (j > 0)
-        {
-            cookies[j-1] = 0;
-        } 
-    }
-
-    return(err);
 }
 
 
-int wait_for_packet(TickType_t ticks)
+int powerwall_init(void)
 {
-    int err = 0;   
-    TickType_t wait_time = 0;
-    static int last_copy_ready = 0;
-
-    do 
-    {
-        if (last_copy_ready != copy_ready)
-        {
-            last_copy_ready = copy_ready;
-            break;
-        }
+    // test_http(1);
 
-        SLEEP_MS(50);
-        wait_time += 50;
-    } while(wait_time < ticks);
-    
-    return(err);
+    return(0); 
 }
 
+
 #ifdef USE_RTOS_MBEDTLS_INTERFACE
 // apparently the standard mbedtls code does not support lwip sockets, so would have to create that to use the interface below
 
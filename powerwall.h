@@ -11,6 +11,7 @@
 #define PICOHTTPS_H
 
 #include "altcp_tls_mbedtls_structs.h"
+#include "http_client.h"
 
 typedef enum
 {
@@ -20,23 +21,19 @@ typedef enum
 } GRID_STATUS_T;
 
 
-typedef enum
+// session statistics, see powerwall_get_stats(), connection and tls statistics are kept by http_client_get_stats()
+typedef struct
 {
-    HTTP_GET,
-    HTTP_POST
-} HTTP_REQUEST_TYPE_T;
+    uint32_t logins;
+    uint32_t requests;          // responses received
+    uint32_t refresh_ms;        // time taken by the last status refresh
+} POWERWALL_STATS_T;
 
 
 // HTTP server hostname
 //#define PICOHTTPS_HOSTNAME                          "example.edu"
 #define PICOHTTPS_HOSTNAME                          "powerwall.badnet"
 
-// DNS response polling interval
-//
-//  Interval with which to poll for responses to DNS queries.
-//
-#define PICOHTTPS_RESOLVE_POLL_INTERVAL             100             // ms
-
 // Certificate authority root certificate
 //
 //  CA certificate used to sign the HTTP server's certificate. DER or PEM
@@ -250,31 +247,19 @@ typedef enum
 // "emyPxgcYxn/eR44/KJ4EBs+lVDR3veyJm+kXQ99b21/+jh5Xos1AnX5iItreGCc=/\n" \
 // "-----END CERTIFICATE-----\n"
 
-// TCP + TLS connection establishment polling interval
+// Powerwall status polling
 //
-//  Interval with which to poll for establishment of TCP + TLS connection
+//  The gateway is read every POWERWALL_POLL_INTERVAL_MS, the task wakes every
+//  POWERWALL_TASK_LOOP_DELAY to check and to pulse the watchdog
 //
-#define PICOHTTPS_ALTCP_CONNECT_POLL_INTERVAL       100             // ms
+#define POWERWALL_POLL_INTERVAL_MS                  (15*60*1000)    // ms
+#define POWERWALL_TASK_LOOP_DELAY                   (10000)         // ms
 
-// TCP + TLS idle connection polling interval
-//
-//  Interval with which to poll application (i.e. call registered polling
-//  callback function) when TCP + TLS connection is idle.
-//
-//  The callback function should be registered with altcp_poll(). The polling
-//  interval is given in units of 'coarse grain timer shots'; one shot
-//  corresponds to approximately 500 ms.
+// Powerwall authorization token lifetime
 //
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
+//  The token is reused until this expires or the gateway answers 401
 //
-#define PICOHTTPS_ALTCP_IDLE_POLL_INTERVAL          2               // shots
-
-
-// HTTP response polling interval
-//
-//  Interval with which to poll for HTTP response from server.
-//
-#define PICOHTTPS_HTTP_RESPONSE_POLL_INTERVAL       100             // ms
+#define POWERWALL_TOKEN_LIFETIME_MS                 (60*60*1000)    // ms
 
 // Mbed TLS debug levels
 //
@@ -306,51 +291,6 @@ typedef err_t lwip_err_t;
 //
 typedef int mbedtls_err_t;
 
-// TCP connection callback argument
-//
-//  All callbacks associated with lwIP TCP (+ TLS) connections can be passed a
-//  common argument. This is intended to allow application state to be accessed
-//  from within the callback context. The argument should be registered with
-//  altcp_arg().
-//
-//  The following structure is used for this argument in order to supply all
-//  the relevant application state required by the various callbacks.
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-struct altcp_callback_arg{
-
-// TCP + TLS connection configurtaion
-//
-//  Memory allocated to the connection configuration structure needs to be
-//  freed (with altcp_tls_free_config) in the connection error callback
-//  (callback_altcp_err).
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp__tls.html
-//
-struct altcp_tls_config* config;
-
-// TCP + TLS connection state
-//
-//  Successful establishment of a connection needs to be signaled to the
-//  application from the connection connect callback
-//  (callback_altcp_connect).
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-bool connected;
-
-// Data reception acknowledgement
-//
-//  The amount of data acknowledged as received by the server needs to be
-//  communicated to the application from the connection sent callback
-//  (callback_altcp_sent) for validatation of successful transmission.
-//
-u16_t acknowledged;
-
-};
-
 
 
 /* Functions ******************************************************************/
@@ -373,151 +313,9 @@ bool init_cyw43(void);
 //
 bool connect_to_network(void);
 
-// Resolve hostname
-//
-//  @param ipaddr   Pointer to an `ip_addr_t` where the resolved IP address
-//                  should be stored.
-//
-//  @return         `true` on success
-//
-bool resolve_hostname(ip_addr_t* ipaddr);
-
-// Free TCP + TLS protocol control block
-//
-//  Memory allocated for a protocol control block (with altcp_tls_new) needs to
-//  be freed (with altcp_close).
-//
-//  @param pcb      Pointer to a `altcp_pcb` structure to be freed
-//
-void altcp_free_pcb(struct altcp_pcb* pcb);
-
-// Free TCP + TLS connection configuration
-//
-//  Memory allocated for TCP + TLS connection configuration (with
-//  altcp_tls_create_config_client) needs to be freed (with
-//  altcp_tls_free_config).
-//
-//  @param config   Pointer to a `altcp_tls_config` structure to be freed
-//
-void altcp_free_config(struct altcp_tls_config* config);
-
-// Free TCP + TLS connection callback argument
-//
-//  The common argument passed to lwIP connection callbacks must remain in
-//  scope for the duration of all callback contexts (i.e. connection lifetime).
-//  As such, it cannot be declared with function scope when registering the
-//  callback, but rather should be allocated on the heap. This implies the
-//  allocated memory must be freed on connection close.
-//
-//  @param arg      Pointer to a `altcp_callback_arg` structure to be freed
-//
-void altcp_free_arg(struct altcp_callback_arg* arg);
-
-// Establish TCP + TLS connection with server
-//
-//  @param ipaddr   Pointer to an `ip_addr_t` containing the server's IP
-//                  address
-//  @param pcb      Double pointer to a `altcp_pcb` structure where the
-//                  protocol control block for the established connection
-//                  should be stored.
-//
-//  @return         `true` on success
-//
-bool connect_to_host(ip_addr_t* ipaddr, struct altcp_pcb** pcb);
-
-// Send HTTP request
-//
-//  @param pcb      Pointer to a `altcp_pcb` structure containing the TCP + TLS
-//                  connection PCB to the server.
-//
-//  @return         `true` on success
-//
-bool send_request(struct altcp_pcb* pcb);
-bool send_grid_status_request(struct altcp_pcb* pcb, char *cookie, char *cookie2);
-bool http_request(struct altcp_pcb* pcb, HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content, char *auth_token, char *cookies);
-int powerwall_login(struct altcp_pcb* pcb);
-int powerwall_get_grid_status(struct altcp_pcb* pcb, char *auth_token, char *cookies);
-int powerwall_get_battery_percentage(struct altcp_pcb* pcb, char *auth_token, char *cookies);
-int http_extract_cookies(const char *http_packet, char *cookies, int length);
-int powerwall_logout(struct altcp_pcb* pcb, char *auth_token, char *cookies);
-
-// DNS response callback
-//
-//  Callback function fired on DNS query response.
-//
-//  Registered with dns_gethostbyname().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__dns.html
-//
-void callback_gethostbyname(
-    const char* name,
-    const ip_addr_t* resolved,
-    void* ipaddr
-);
-
-// TCP + TLS connection error callback
-//
-//  Callback function fired on TCP + TLS connection fatal error.
-//
-//  Registered with altcp_err().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-void callback_altcp_err(void* arg, lwip_err_t err);
-
-// TCP + TLS connection idle callback
-//
-//  Callback function fired on idle TCP + TLS connection.
-//
-//  Registered with altcp_err().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-lwip_err_t callback_altcp_poll(void* arg, struct altcp_pcb* pcb);
-
-// TCP + TLS data acknowledgement callback
-//
-//  Callback function fired on acknowledgement of data reception by server over
-//  a TCP + TLS connection.
-//
-//  Registered with altcp_sent().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-lwip_err_t callback_altcp_sent(void* arg, struct altcp_pcb* pcb, u16_t len);
-
-// TCP + TLS data reception callback
-//
-//  Callback function fired on reception of data from server over a TCP +
-//  TLS connection.
-//
-//  Registered with altcp_recv().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-lwip_err_t callback_altcp_recv(
-    void* arg,
-    struct altcp_pcb* pcb,
-    struct pbuf* buf,
-    lwip_err_t err
-);
-
-// TCP + TLS connection establishment callback
-//
-//  Callback function fired on successful establishment of TCP + TLS connection.
-//
-//  Registered with altcp_connect().
-//
-//  https://www.nongnu.org/lwip/2_1_x/group__altcp.html
-//
-lwip_err_t callback_altcp_connect(
-    void* arg,
-    struct altcp_pcb* pcb,
-    lwip_err_t err
-);
-
-void powerwall_check(void);
+void powerwall_task(void *params);
 int powerwall_init(void);
+void powerwall_get_stats(POWERWALL_STATS_T *stats);
 
 
 
@@ -34,6 +34,7 @@
 #include "utility.h"
 #include "config.h"
 #include "calendar.h"
+#include "clock_sync.h"
 
 
 /*!
@@ -74,3 +75,18 @@ void setTimeSec(uint32_t sec)
 	rtc_set_datetime (&date);
 	#endif
 }
+
+/*!
+ * \brief Used by lwip sntp application to set the rtc and discipline the shared microsecond timebase
+ *
+ * \param sec time in seconds since epoch (1970)
+ * \param us  microseconds part of the time
+ *
+ * \return nothing
+ */
+void setTimeUs(uint32_t sec, uint32_t us)
+{
+    setTimeSec(sec);
+
+    clock_sync_reference_update(sec, us);
+}
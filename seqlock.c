@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "seqlock.h"
+
+/*
+ * Sequence lock
+ *
+ * A writer makes the sequence odd, updates the protected data and makes it even again.  A reader notes an even
+ * sequence, copies the data and then checks that the sequence has not moved, copying again if it has.  Readers never
+ * write shared memory so any number of them on either core cost the writer nothing.  The fences order the data
+ * accesses against the sequence on both the compiler and the cpu (dmb on the rp2040).
+ */
+
+// NB: this file must not depend on FreeRTOS so that web_snapshot_stress can run writers and readers on host threads
+
+/*!
+ * \brief Start an update
+ *
+ * \param[in]   lock      sequence lock
+ *
+ * \return nothing
+ */
+void seqlock_write_begin(SEQLOCK_T *lock)
+{
+    lock->sequence++;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*!
+ * \brief Finish an update
+ *
+ * \param[in]   lock      sequence lock
+ *
+ * \return nothing
+ */
+void seqlock_write_end(SEQLOCK_T *lock)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    lock->sequence++;
+}
+
+/*!
+ * \brief Start reading, waiting for any update in progress to finish
+ *
+ * \param[in]   lock      sequence lock
+ *
+ * \return sequence to pass to seqlock_read_retry()
+ */
+uint32_t seqlock_read_begin(const SEQLOCK_T *lock)
+{
+    uint32_t start;
+
+    while ((start = lock->sequence) & 1)
+    {
+        // writer holds a critical section on the other core, only a few copies long
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return(start);
+}
+
+/*!
+ * \brief Check whether data read since seqlock_read_begin() may be torn
+ *
+ * \param[in]   lock      sequence lock
+ * \param[in]   start     value returned by seqlock_read_begin()
+ *
+ * \return true if the data must be read again
+ */
+bool seqlock_read_retry(const SEQLOCK_T *lock, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return(lock->sequence != start);
+}
@@ -0,0 +1,24 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// sequence is odd while a writer is part way through an update
+typedef struct
+{
+    volatile uint32_t sequence;
+} SEQLOCK_T;
+
+// writers must already be serialised with one another, readers never block writers
+void seqlock_write_begin(SEQLOCK_T *lock);
+void seqlock_write_end(SEQLOCK_T *lock);
+uint32_t seqlock_read_begin(const SEQLOCK_T *lock);
+bool seqlock_read_retry(const SEQLOCK_T *lock, uint32_t start);
+
+#endif
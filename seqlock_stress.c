@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "seqlock.h"
+#include "seqlock_stress.h"
+
+/*
+ * Two core sequence lock stress
+ *
+ * Built into debug builds (SEQLOCK_STRESS, see CMakeLists.txt) and run once at boot.  A writer task pinned to core 0
+ * fills every field of a block with the same count, and a reader task pinned to core 1 copies the block and counts
+ * copies whose fields differ.  For the first SEQLOCK_STRESS_SECONDS the fields are copied one by one, which should
+ * tear and shows the check can see it.  For the next the writer brackets its stores as web_write_begin() and
+ * web_write_end() do (critical section and seqlock_write_begin()) and the reader copies with seqlock_read_begin()
+ * and seqlock_read_retry(), which must never tear.  The host test web_snapshot_stress cannot show this because host
+ * threads do not have the rp2040's memory ordering.  Results are on the debug page.
+ */
+
+typedef enum
+{
+    SEQLOCK_STRESS_PLAIN = 0,
+    SEQLOCK_STRESS_LOCKED,
+    SEQLOCK_STRESS_DONE
+} SEQLOCK_STRESS_PHASE_ID_T;
+
+// prototypes
+static void seqlock_stress_writer(void *params);
+static void seqlock_stress_reader(void *params);
+
+// static variables
+static SEQLOCK_STRESS_STATS_T stress = {.writer_core = -1, .reader_core = -1};
+static volatile uint32_t stress_block[SEQLOCK_STRESS_FIELDS];
+static SEQLOCK_T stress_lock;
+static volatile int stress_phase = SEQLOCK_STRESS_PLAIN;
+static volatile bool stress_reader_done = false;
+
+/*!
+ * \brief Start the writer and reader tasks, one on each core
+ *
+ * \return nothing
+ */
+void seqlock_stress_start(void)
+{
+#if ( configNUMBER_OF_CORES == 2 ) && configUSE_CORE_AFFINITY
+    TaskHandle_t writer;
+    TaskHandle_t reader;
+
+    if (stress.started)
+    {
+        return;
+    }
+
+    // pinned from creation so that neither runs on the other's core
+    if ((xTaskCreateAffinitySet(seqlock_stress_writer, "Seqlock Writer", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, (1 << 0), &writer) != pdPASS) ||
+        (xTaskCreateAffinitySet(seqlock_stress_reader, "Seqlock Reader", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, (1 << 1), &reader) != pdPASS))
+    {
+        printf("Seqlock stress tasks could not be started\n");
+        return;
+    }
+
+    stress.started = true;
+#endif
+}
+
+/*!
+ * \brief Print the results for the debug page
+ *
+ * \param[out]  buffer  destination
+ * \param[in]   len     size of destination
+ *
+ * \return number of characters printed
+ */
+int seqlock_stress_status_string(char *buffer, int len)
+{
+    if (!stress.started)
+    {
+        return(snprintf(buffer, len, "not run"));
+    }
+
+    return(snprintf(buffer, len, "%s, writer core %d, reader core %d, unlocked %lu of %lu reads torn, seqlock %lu of %lu reads torn",
+                    stress.finished ? "finished" : "running",
+                    stress.writer_core, stress.reader_core,
+                    (unsigned long)stress.plain.torn, (unsigned long)stress.plain.reads,
+                    (unsigned long)stress.locked.torn, (unsigned long)stress.locked.reads));
+}
+
+/*!
+ * \brief Write the block as fast as possible, unlocked then locked
+ *
+ * \param params unused
+ *
+ * \return nothing
+ */
+static void seqlock_stress_writer(__unused void *params)
+{
+    TickType_t phase_end;
+    uint32_t count = 0;
+    int burst;
+    int i;
+
+    stress.writer_core = portGET_CORE_ID();
+
+    printf("Seqlock stress writer starting on core %d\n", stress.writer_core);
+
+    phase_end = xTaskGetTickCount() + pdMS_TO_TICKS(SEQLOCK_STRESS_SECONDS*1000);
+    while ((int32_t)(xTaskGetTickCount() - phase_end) < 0)
+    {
+        for (burst = 0; burst < SEQLOCK_STRESS_BURST; burst++)
+        {
+            count++;
+            for (i = 0; i < SEQLOCK_STRESS_FIELDS; i++)
+            {
+                stress_block[i] = count;
+            }
+        }
+        stress.plain.writes += SEQLOCK_STRESS_BURST;
+        vTaskDelay(1);
+    }
+
+    // every plain store is complete before the reader can see the locked phase
+    __atomic_store_n(&stress_phase, SEQLOCK_STRESS_LOCKED, __ATOMIC_SEQ_CST);
+
+    phase_end = xTaskGetTickCount() + pdMS_TO_TICKS(SEQLOCK_STRESS_SECONDS*1000);
+    while ((int32_t)(xTaskGetTickCount() - phase_end) < 0)
+    {
+        for (burst = 0; burst < SEQLOCK_STRESS_BURST; burst++)
+        {
+            count++;
+
+            taskENTER_CRITICAL();
+            seqlock_write_begin(&stress_lock);
+            for (i = 0; i < SEQLOCK_STRESS_FIELDS; i++)
+            {
+                stress_block[i] = count;
+            }
+            seqlock_write_end(&stress_lock);
+            taskEXIT_CRITICAL();
+        }
+        stress.locked.writes += SEQLOCK_STRESS_BURST;
+        vTaskDelay(1);
+    }
+
+    __atomic_store_n(&stress_phase, SEQLOCK_STRESS_DONE, __ATOMIC_SEQ_CST);
+
+    while (!stress_reader_done)
+    {
+        vTaskDelay(1);
+    }
+
+    stress.finished = true;
+
+    printf("Seqlock stress: unlocked %lu of %lu reads torn, seqlock %lu of %lu reads torn\n",
+           (unsigned long)stress.plain.torn, (unsigned long)stress.plain.reads,
+           (unsigned long)stress.locked.torn, (unsigned long)stress.locked.reads);
+
+    vTaskDelete(NULL);
+}
+
+/*!
+ * \brief Copy the block as fast as possible and count copies that mix writes
+ *
+ * \param params unused
+ *
+ * \return nothing
+ */
+static void seqlock_stress_reader(__unused void *params)
+{
+    uint32_t copy[SEQLOCK_STRESS_FIELDS];
+    SEQLOCK_STRESS_PHASE_T *result;
+    uint32_t start;
+    int phase;
+    int burst;
+    int i;
+
+    stress.reader_core = portGET_CORE_ID();
+
+    printf("Seqlock stress reader starting on core %d\n", stress.reader_core);
+
+    while ((phase = __atomic_load_n(&stress_phase, __ATOMIC_SEQ_CST)) != SEQLOCK_STRESS_DONE)
+    {
+        result = (phase == SEQLOCK_STRESS_PLAIN) ? &stress.plain : &stress.locked;
+
+        for (burst = 0; burst < SEQLOCK_STRESS_BURST; burst++)
+        {
+            if (phase == SEQLOCK_STRESS_PLAIN)
+            {
+                for (i = 0; i < SEQLOCK_STRESS_FIELDS; i++)
+                {
+                    copy[i] = stress_block[i];
+                }
+            }
+            else
+            {
+                do
+                {
+                    start = seqlock_read_begin(&stress_lock);
+                    for (i = 0; i < SEQLOCK_STRESS_FIELDS; i++)
+                    {
+                        copy[i] = stress_block[i];
+                    }
+                } while (seqlock_read_retry(&stress_lock, start));
+            }
+
+            for (i = 1; i < SEQLOCK_STRESS_FIELDS; i++)
+            {
+                if (copy[i] != copy[0])
+                {
+                    result->torn++;
+                    break;
+                }
+            }
+        }
+        result->reads += SEQLOCK_STRESS_BURST;
+        vTaskDelay(1);
+    }
+
+    stress_reader_done = true;
+
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SEQLOCK_STRESS_H
+#define SEQLOCK_STRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SEQLOCK_STRESS_SECONDS      (30)        // length of each phase, run once at boot
+#define SEQLOCK_STRESS_FIELDS       (16)        // words written together
+#define SEQLOCK_STRESS_BURST        (1000)      // copies between yields so that other tasks on the core still run
+
+typedef struct
+{
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t torn;              // copies whose fields came from different writes
+} SEQLOCK_STRESS_PHASE_T;
+
+typedef struct
+{
+    bool started;
+    bool finished;
+    int writer_core;            // cores the tasks were found running on, -1 until they start
+    int reader_core;
+    SEQLOCK_STRESS_PHASE_T plain;       // fields copied one by one, shows that tearing is detected
+    SEQLOCK_STRESS_PHASE_T locked;      // copies through seqlock.c, as web_snapshot.c does
+} SEQLOCK_STRESS_STATS_T;
+
+void seqlock_stress_start(void);
+int seqlock_stress_status_string(char *buffer, int len);
+
+#endif
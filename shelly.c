@@ -30,11 +30,17 @@
 #include "utility.h"
 #include "config.h"
 #include "watchdog.h"
-#include "powerwall.h"
+#include "http_client.h"
 #include "shelly.h"
 #include "json_parser.h"
 #include "pluto.h"
 #include "usurper_ping.h"
+#include "web_snapshot.h"
+#include "fixed_format.h"
+#include "mdns_watch.h"
+#include "shelly_status.h"
+#include "json_writer.h"
+#include "lwip/etharp.h"
 
 #define GET_REQUEST "GET / HTTP/1.0\r\n\r\n"
 
@@ -51,29 +57,91 @@ typedef struct
 {
     u32_t ip;
     SHELLY_DEVICE_TYPE_T type;
+    u8_t mac[6];                // from the arp table, zero until seen there
+    TickType_t last_seen;       // last answered a probe, appeared in the arp table or announced itself
+    bool subscribed;            // pushes its state to us, webhooks installed on gen2 devices
+    TickType_t subscribe_time;  // last attempt to subscribe
+    int failures;               // probes in a row it has not answered
 } DISCOVERED_SHELLY_T;
 
+// host that was probed and is not a shelly device
+typedef struct
+{
+    u32_t ip;
+    u8_t mac[6];
+    TickType_t checked;
+} SHELLY_CHECKED_HOST_T;
+
+// http request to a host that replied to the sweep
+typedef struct
+{
+    bool busy;
+    u32_t ip;
+    char ipstring[16];
+    char device_type[32];
+    char device_id[32];
+    JSONP_FILTER_T filters[2];
+    HTTP_CLIENT_REQUEST_T request;
+} SHELLY_PROBE_T;
+
+typedef struct
+{
+    u32_t own_ip;
+    int found;
+    SHELLY_PROBE_T probe[SHELLY_PROBE_CONCURRENCY];
+} SHELLY_SWEEP_T;
+
+// looking for our own webhook in the list held by a gen2 device
+typedef struct
+{
+    const char *url;            // url our webhooks start with
+    bool found;
+} SHELLY_WEBHOOK_SEARCH_T;
+
 // external variables
 extern WEB_VARIABLES_T web;
 
+extern NON_VOL_VARIABLES_T config;
+
 // global variables
-JSON_PARSER_CONTEXT_T shelly_parser_context;
-unsigned char rx_buffer[2048]; 
 DISCOVERED_SHELLY_T discovered_shelly[32];
 int num_discovered_shelly_devices = 0;
 
+// static variables
+static SHELLY_SWEEP_T shelly_sweep;                                 // probes in flight, shared by sweeps and incremental discovery
+static SHELLY_CHECKED_HOST_T shelly_checked[SHELLY_CHECKED_HOSTS];
+static u32_t shelly_candidate[SHELLY_CANDIDATES];                   // announced hosts, filled on the tcpip thread
+static int shelly_candidate_head = 0;
+static int shelly_candidate_tail = 0;
+static bool shelly_mdns_started = false;
+static TickType_t shelly_mdns_query_time = 0;
+static const MDNS_WATCH_T shelly_mdns_watch[] = {{"_shelly._tcp", NULL},            // gen2 and later
+                                                 {"_http._tcp", "shelly"}};         // gen1 only announce their web server
+
 // prototypes
 int query_status(char *ipstring);
-int shelly_parse_header(char *buffer);
-char *find_next_space_on_line(char *buffer);
 int shelly_add_discovered_device(u32_t ip, SHELLY_DEVICE_TYPE_T type);
+int shelly_remove_discovered_device(u32_t ip);
+int shelly_find_discovered_device(u32_t ip);
+int shelly_save_discovered_devices(void);
 int shelly_dump_discovered_devices(void);
+int shelly_local_network(u32_t *ip, u32_t *mask);
+void shelly_probe_start(void *arg, u32_t ip);
+void shelly_probe_finish(SHELLY_SWEEP_T *sweep, SHELLY_PROBE_T *probe);
+void shelly_probe_reap(SHELLY_SWEEP_T *sweep);
+bool shelly_probe_pending(SHELLY_SWEEP_T *sweep, u32_t ip);
+void shelly_check_host(u32_t ip, const u8_t *mac, TickType_t now);
+void shelly_mdns_announced(void *arg, u32_t ip);
+int shelly_subscribe(DISCOVERED_SHELLY_T *device, u32_t own_ip);
+void shelly_webhook_listed(void *arg, const char *path, const char *value);
+int shelly_webhook_create(const char *ipstring, const char *component, int channel, bool on, const char *url);
+int shelly_seed_status(const char *ipstring, const char *component, u32_t ip, int channel);
 
 
 /*!
- * \brief clear cache used to store shelly device responses
- * 
- * \return 0 on success, -1 on error
+ * \brief Find shelly devices on the local subnet
+ *
+ * \return number of shelly devices found, or -1 on error
  */
 int discover_shelly_devices(void)
 {
@@ -81,321 +149,794 @@ int discover_shelly_devices(void)
     u32_t mask;
     u32_t search_start;
     u32_t search_end;
-    u32_t ip_to_query;
-    int values[4] = {0,0,0,0};
-    u8_t byte = 0;
+    int live;
+    int found;
     int i;
-    char ipstring[32];
-    int number_of_shelly_devices = 0;
-    char device_type[32];
-    char device_id[32];
-    ip_addr_t ping_addr;
-    int ping_err = -1;
-
-    printf("address = %s\n", web.ip_address_string);  
-    printf("netmask = %s\n", web.network_mask_string);
 
-    sscanf(web.ip_address_string, "%d.%d.%d.%d", &values[0], &values[1], &values[2], &values[3]);
-    printf("%d.%d.%d.%d\n", values[0], values[1], values[2], values[3]);
-    ip   = 0x00000000;
-    for(i=0; i<4; i++)
+    if (shelly_local_network(&ip, &mask))
     {
-        byte = (u8_t)values[i];
-        ip = ip<<8 | byte;
+        return(-1);
     }
-    printf("ip = %08x\n", ip);
-
-    sscanf(web.network_mask_string, "%d.%d.%d.%d", &values[0], &values[1], &values[2], &values[3]);    
-    printf("%d.%d.%d.%d\n", values[0], values[1], values[2], values[3]);
 
-    mask   = 0x00000000;
-    for(i=0; i<4; i++)
+    // sweep the block around our own address if the subnet is too big
+    if ((0xffffffff ^ mask) >= PING_SWEEP_MAX_HOSTS)
     {
-        byte = (u8_t)values[i];
-        mask = mask<<8 | byte;
+        mask = ~(u32_t)(PING_SWEEP_MAX_HOSTS - 1);
     }
-    printf("mask = %08x\n", mask); 
 
     search_start = ip & mask;
     search_end = search_start | (0xffffffff ^ mask);
 
-
-    //TEST TEST TEST
-    //search_start = 0xc0a821a1;
+    if (search_end - search_start < 2)
+    {
+        return(-1);
+    }
 
     printf("search range: %08x to %08x\n", search_start, search_end);
 
-    for(ip_to_query=search_start+1; ip_to_query<search_end; ip_to_query++)
-    {
-        //byte = *((u8_t *)&ip_to_query);
-        //printf("byte = %0x\n", byte);
-        sprintf(ipstring, "%d.%d.%d.%d", ((u8_t *)&ip_to_query)[3], ((u8_t *)&ip_to_query)[2], ((u8_t *)&ip_to_query)[1], ((u8_t *)&ip_to_query)[0]);
+    // ping everything except the network and broadcast addresses, probing each host that replies
+    shelly_sweep.own_ip = ip;
+    shelly_sweep.found = 0;
+    live = ping_sweep(search_start + 1, search_end - search_start - 1, SHELLY_SWEEP_RATE, SHELLY_SWEEP_ATTEMPTS,
+                      SHELLY_SWEEP_TIMEOUT_MS, shelly_probe_start, &shelly_sweep);
 
-        printf("querying %s\n", ipstring);
+    // collect the probes still running
+    for(i=0; i<NUM_ROWS(shelly_sweep.probe); i++)
+    {
+        if (shelly_sweep.probe[i].busy)
+        {
+            http_client_wait(&shelly_sweep.probe[i].request, HTTP_CLIENT_TIMEOUT_MS);
+            shelly_probe_finish(&shelly_sweep, &shelly_sweep.probe[i]);
+        }
+    }
+    found = shelly_sweep.found;
 
-        printf("ping %s\n", ipstring);
+    printf("%d hosts replied to ping, %d shelly devices discovered\n", live, found);
+    shelly_dump_discovered_devices();
 
-        //ipaddr_aton(PING_ADDR, &ping_addr);
-        ping_addr.addr = htonl(ip_to_query);
+    return(found);
+}
 
-        ping_err = ping_device(&ping_addr, 3); 
-        printf("ping returned error = %d\n", ping_err);
+/*!
+ * \brief Load the devices found before the last reboot and start listening for announcements
+ *
+ * \return number of known devices
+ */
+int shelly_discovery_start(void)
+{
+    int i;
+    TickType_t now = xTaskGetTickCount();
 
-        if (ping_err == 0)
+    num_discovered_shelly_devices = 0;
+    for(i=0; (i<NUM_ROWS(config.shelly_device_ip)) && (num_discovered_shelly_devices<NUM_ROWS(discovered_shelly)); i++)
+    {
+        if (config.shelly_device_ip[i] && (config.shelly_device_type[i] <= SHELLY_TYPE_UNKNOWN))
         {
-            printf("http request %s\n", ipstring);
-
-            //query_status(ipstring);
-            if (shelly_http_request(HTTP_GET, "/shelly", ipstring, NULL) == 200)
-            {
-                // get device type
-                if (jsonp_get_value(&shelly_parser_context, "root.\"type\"", device_type, sizeof(device_type), false))
-                {
-                    STRNCPY(device_type, "UNKNOWN", sizeof(device_type));
-                }
-
-                // get device id
-                if (jsonp_get_value(&shelly_parser_context, "root.\"id\"", device_id, sizeof(device_id), false))
-                {
-                    STRNCPY(device_id, "UNKNOWN", sizeof(device_id));
-                }
-
-                if (strcasecmp(device_type, "\"SHSW-25\"") == 0)
-                {
-                    shelly_add_discovered_device(ip_to_query, SHELLY_TYPE_SHSW_25);
-                }
-                else if (strncasecmp(device_id, "\"shellypluswdus", 15) == 0)
-                {
-                    shelly_add_discovered_device(ip_to_query, SHELLY_TYPE_PLUSWDUS);
-                }      
-                else if (strncasecmp(device_id, "\"shellyplus1", 12) == 0)
-                {
-                    shelly_add_discovered_device(ip_to_query, SHELLY_TYPE_PLUS1);
-                }  
-                else if (strncasecmp(device_id, "\"shellyplus2pm", 14) == 0)
-                {
-                    shelly_add_discovered_device(ip_to_query, SHELLY_TYPE_PLUS2PM);
-                }                                            
-                else
-                {
-                    shelly_add_discovered_device(ip_to_query, SHELLY_TYPE_UNKNOWN);
-                }
-
-                printf("IP = %s SHELLY_DEVICE_TYPE = %s SHELLY_DEVICE_ID = %s\n", ipstring, device_type, device_id);
-                shelly_dump_discovered_devices();
-                
-                number_of_shelly_devices++;
-                printf("number of shelly devices discovered = %d\n", number_of_shelly_devices);
-            }
+            memset(&discovered_shelly[num_discovered_shelly_devices], 0, sizeof(DISCOVERED_SHELLY_T));
+            discovered_shelly[num_discovered_shelly_devices].ip = config.shelly_device_ip[i];
+            discovered_shelly[num_discovered_shelly_devices].type = (SHELLY_DEVICE_TYPE_T)config.shelly_device_type[i];
+            discovered_shelly[num_discovered_shelly_devices].last_seen = now;
+            discovered_shelly[num_discovered_shelly_devices].subscribe_time = now - pdMS_TO_TICKS(SHELLY_PROBE_HOLDOFF_MS);
+            num_discovered_shelly_devices++;
         }
-        sleep_ms(1000);
     }
 
-    printf("number of shelly devices discovered = %d\n", number_of_shelly_devices);
+    printf("%d shelly devices known from flash\n", num_discovered_shelly_devices);
     shelly_dump_discovered_devices();
 
-    return(0);
+    return(num_discovered_shelly_devices);
 }
 
-
-// Send HTTP request
-int shelly_http_request(HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content)
+/*!
+ * \brief Probe hosts that are new, have changed or have been silent too long
+ * 
+ * Candidates come from the arp table, which holds every host we have exchanged traffic with, and from mDNS
+ * announcements.  Hosts already known are not probed again, so once the network is settled discovery sends
+ * nothing but an occasional mDNS query.
+ *
+ * \return number of probes still running
+ */
+int shelly_discovery_poll(void)
 {
-    int socket = -1;
-    int err = 0;
-    char request[2048];
-    int length = 0;
-    char length_string[8];
-    lwip_err_t lwip_err = -1;
-    int sent_bytes = 0;
-    int received_bytes = 0;
-    int retry;
-    int ret;
-    fd_set readset;
-    struct timeval tv;  
-    char *start_of_json = NULL;
-    int http_error = 0;
-        
-
-    // type
-    switch(type)
+    static SHELLY_STATUS_T status[SHELLY_STATUS_DEVICES];
+    TickType_t now = xTaskGetTickCount();
+    ip4_addr_t *ipaddr;
+    struct netif *netif;
+    struct eth_addr *eth;
+    u32_t mask;
+    u32_t ip;
+    u8_t mac[6];
+    int valid;
+    int num_status;
+    int running = 0;
+    int i;
+
+    if (shelly_local_network(&shelly_sweep.own_ip, &mask))
+    {
+        return(0);
+    }
+
+    shelly_probe_reap(&shelly_sweep);
+
+    // listen for announcements, asking for them now and then in case none are made
+    if (!shelly_mdns_started)
+    {
+        shelly_mdns_started = (mdns_watch_start(shelly_mdns_watch, NUM_ROWS(shelly_mdns_watch), shelly_mdns_announced, NULL) == 0);
+        shelly_mdns_query_time = now - pdMS_TO_TICKS(SHELLY_MDNS_QUERY_INTERVAL_MS);
+    }
+    if (shelly_mdns_started && (now - shelly_mdns_query_time >= pdMS_TO_TICKS(SHELLY_MDNS_QUERY_INTERVAL_MS)))
+    {
+        mdns_watch_query();
+        shelly_mdns_query_time = now;
+    }
+
+    // hosts we have exchanged traffic with recently
+    for(i=0; i<ARP_TABLE_SIZE; i++)
+    {
+        cyw43_arch_lwip_begin();
+        valid = etharp_get_entry(i, &ipaddr, &netif, &eth);
+        if (valid)
+        {
+            ip = lwip_ntohl(ip4_addr_get_u32(ipaddr));
+            memcpy(mac, eth->addr, sizeof(mac));
+        }
+        cyw43_arch_lwip_end();
+
+        if (valid && !shelly_probe_pending(&shelly_sweep, ip))
+        {
+            shelly_check_host(ip, mac, now);
+        }
+    }
+
+    // hosts that announced a shelly service
+    for (;;)
     {
-        case HTTP_GET:
-            sprintf(request, "GET ");
+        cyw43_arch_lwip_begin();
+        valid = (shelly_candidate_tail != shelly_candidate_head);
+        if (valid)
+        {
+            ip = shelly_candidate[shelly_candidate_tail];
+            shelly_candidate_tail = (shelly_candidate_tail + 1) % NUM_ROWS(shelly_candidate);
+        }
+        cyw43_arch_lwip_end();
+
+        if (!valid)
+        {
             break;
-        case HTTP_POST:
-            sprintf(request, "POST ");
+        }
+
+        if (((ip & mask) == (shelly_sweep.own_ip & mask)) && !shelly_probe_pending(&shelly_sweep, ip))
+        {
+            shelly_check_host(ip, NULL, now);
+        }
+    }
+
+    // devices pushing status frames that discovery has not met yet
+    num_status = shelly_status_snapshot(status, NUM_ROWS(status), NULL);
+    for(i=0; i<num_status; i++)
+    {
+        if ((status[i].source == SHELLY_SOURCE_COIOT) && ((status[i].ip & mask) == (shelly_sweep.own_ip & mask)) &&
+            !shelly_probe_pending(&shelly_sweep, status[i].ip))
+        {
+            shelly_check_host(status[i].ip, NULL, now);
+        }
+    }
+
+    // ask one device per poll to push its state, the requests block
+    for(i=0; i<num_discovered_shelly_devices; i++)
+    {
+        if (!discovered_shelly[i].subscribed && (now - discovered_shelly[i].subscribe_time >= pdMS_TO_TICKS(SHELLY_PROBE_HOLDOFF_MS)))
+        {
+            discovered_shelly[i].subscribe_time = now;
+            discovered_shelly[i].subscribed = (shelly_subscribe(&discovered_shelly[i], shelly_sweep.own_ip) == 0);
             break;
-        default:
-            request[0] = 0;
-            err = true;
+        }
+    }
+
+    // confirm devices that have been silent too long are still there, one that misses SHELLY_PROBE_FAILURES probes in a row is forgotten
+    for(i=0; i<num_discovered_shelly_devices; i++)
+    {
+        if ((now - discovered_shelly[i].last_seen >= pdMS_TO_TICKS(SHELLY_DEVICE_AGE_MS)) &&
+            !shelly_probe_pending(&shelly_sweep, discovered_shelly[i].ip))
+        {
+            printf("confirming silent shelly device %08x\n", discovered_shelly[i].ip);
+            discovered_shelly[i].last_seen = now;
+            shelly_probe_start(&shelly_sweep, discovered_shelly[i].ip);
+        }
     }
 
-    // url
-    STRAPPEND(request, url);
-    STRAPPEND(request, " HTTP/1.1\r\n");
+    for(i=0; i<NUM_ROWS(shelly_sweep.probe); i++)
+    {
+        running += shelly_sweep.probe[i].busy;
+    }
 
-    // host
-    STRAPPEND(request, "Host: ");
-    STRAPPEND(request, host);
-    STRAPPEND(request, "\r\n");
+    return(running);
+}
 
-    // accept
-    STRAPPEND(request, "Accept: */*\r\n");
+/*!
+ * \brief Probe a host seen passively if it is new or has changed
+ *
+ * \param[in]  ip      host address, host byte order
+ * \param[in]  mac     hardware address from the arp table, NULL if not known
+ * \param[in]  now     current tick count
+ *
+ * \return nothing
+ */
+void shelly_check_host(u32_t ip, const u8_t *mac, TickType_t now)
+{
+    static const u8_t no_mac[6] = {0};
+    SHELLY_CHECKED_HOST_T *checked = NULL;
+    SHELLY_CHECKED_HOST_T *oldest = &shelly_checked[0];
+    int device;
+    int i;
 
-    // content
-    if (content)
+    // a known device is refreshed, and probed again only if another host has taken its address
+    device = shelly_find_discovered_device(ip);
+    if (device >= 0)
     {
-        sprintf(length_string, "%d", strlen(content));
+        discovered_shelly[device].last_seen = now;
+        discovered_shelly[device].failures = 0;
 
-        // STRAPPEND(request, "Content-Type: application/json\r\n");
-        // STRAPPEND(request, "Content-Length: ");
-        // STRAPPEND(request, length_string);
-        // STRAPPEND(request, "\r\n\r\n");
-        STRAPPEND(request, content);
+        if (mac && memcmp(discovered_shelly[device].mac, mac, sizeof(discovered_shelly[device].mac)))
+        {
+            if (memcmp(discovered_shelly[device].mac, no_mac, sizeof(no_mac)))
+            {
+                printf("shelly device %08x changed hardware address\n", ip);
+                shelly_probe_start(&shelly_sweep, ip);
+            }
+            memcpy(discovered_shelly[device].mac, mac, sizeof(discovered_shelly[device].mac));
+        }
+        return;
     }
-    STRAPPEND(request, "\r\n");
 
-    // request length 
-    length = strlen(request) + 1; // TODO figure out WTF the original code is doing by transmitting one less
+    for(i=0; i<NUM_ROWS(shelly_checked); i++)
+    {
+        if (shelly_checked[i].ip == ip)
+        {
+            checked = &shelly_checked[i];
+            break;
+        }
+        if ((now - shelly_checked[i].checked) > (now - oldest->checked))
+        {
+            oldest = &shelly_checked[i];
+        }
+    }
 
+    if (checked)
+    {
+        // an announcement is worth a probe once the last one is a little stale, an arp entry only once a day
+        if (!mac)
+        {
+            if (now - checked->checked < pdMS_TO_TICKS(SHELLY_PROBE_HOLDOFF_MS))
+            {
+                return;
+            }
+        }
+        else if (!memcmp(checked->mac, no_mac, sizeof(no_mac)))
+        {
+            memcpy(checked->mac, mac, sizeof(checked->mac));
+            return;
+        }
+        else if (!memcmp(checked->mac, mac, sizeof(checked->mac)) && (now - checked->checked < pdMS_TO_TICKS(SHELLY_RECHECK_MS)))
+        {
+            return;
+        }
+    }
+    else
+    {
+        // forget the host checked longest ago
+        checked = oldest;
+        memset(checked, 0, sizeof(*checked));
+        checked->ip = ip;
+    }
 
-    if (socket < 0) socket = establish_socket(host, 80, SOCK_STREAM);
+    if (mac)
+    {
+        memcpy(checked->mac, mac, sizeof(checked->mac));
+    }
+    checked->checked = now;
+
+    shelly_probe_start(&shelly_sweep, ip);
+}
+
+/*!
+ * \brief Queue the address of a host announcing a shelly service, called on the tcpip thread
+ *
+ * \param[in]  arg     not used
+ * \param[in]  ip      host address, host byte order
+ *
+ * \return nothing
+ */
+void shelly_mdns_announced(void *arg, u32_t ip)
+{
+    int next = (shelly_candidate_head + 1) % NUM_ROWS(shelly_candidate);
 
-    if(socket>= 0)
+    // drop the announcement if the queue is full, the host will answer a later query
+    if (next != shelly_candidate_tail)
     {
-        printf("SEND [%d bytes]\n%s\n", length, request); 
-        
-        if (socket >= 0)
-        {
-            sent_bytes = send(socket, request, strlen(request), 0);              
+        shelly_candidate[shelly_candidate_head] = ip;
+        shelly_candidate_head = next;
+    }
+}
+
+/*!
+ * \brief Get our address and netmask from the current dhcp lease
+ *
+ * \param[out] ip      our address, host byte order
+ * \param[out] mask    netmask, host byte order
+ *
+ * \return 0 on success, -1 if there is no address
+ */
+int shelly_local_network(u32_t *ip, u32_t *mask)
+{
+    int values[4] = {0,0,0,0};
+    u8_t byte = 0;
+    int i;
+    WEB_NETWORK_T network;
+
+    // address and mask must be from the same dhcp lease
+    web_snapshot_network(&network);
+
+    if (sscanf(network.ip_address_string, "%d.%d.%d.%d", &values[0], &values[1], &values[2], &values[3]) != 4)
+    {
+        return(-1);
+    }
+    *ip   = 0x00000000;
+    for(i=0; i<4; i++)
+    {
+        byte = (u8_t)values[i];
+        *ip = *ip<<8 | byte;
+    }
+
+    if (sscanf(network.network_mask_string, "%d.%d.%d.%d", &values[0], &values[1], &values[2], &values[3]) != 4)
+    {
+        return(-1);
+    }
+    *mask   = 0x00000000;
+    for(i=0; i<4; i++)
+    {
+        byte = (u8_t)values[i];
+        *mask = *mask<<8 | byte;
+    }
+
+    return((*ip && *mask) ? 0 : -1);
+}
+
+/*!
+ * \brief Ask a host that replied to the sweep if it is a shelly device, without waiting for the answer
+ *
+ * \param[in,out]  arg     sweep
+ * \param[in]      ip      host address, host byte order
+ *
+ * \return nothing
+ */
+void shelly_probe_start(void *arg, u32_t ip)
+{
+    SHELLY_SWEEP_T *sweep = (SHELLY_SWEEP_T *)arg;
+    SHELLY_PROBE_T *probe = NULL;
+    TickType_t start = xTaskGetTickCount();
+    int i;
 
-            if (sent_bytes)
+    if ((ip == sweep->own_ip) || shelly_probe_pending(sweep, ip))
+    {
+        return;
+    }
+
+    while (xTaskGetTickCount() - start < pdMS_TO_TICKS(HTTP_CLIENT_TIMEOUT_MS))
+    {
+        // reap finished probes and take a free slot
+        shelly_probe_reap(sweep);
+        for(i=0; (i<NUM_ROWS(sweep->probe)) && !probe; i++)
+        {
+            if (!sweep->probe[i].busy)
             {
-                printf("sent_bytes = %d\n", sent_bytes);
-
-                printf("waiting to receive response...\n");                    
-                for (retry=0; retry<5; retry++)
-                {
-                    FD_ZERO(&readset);
-                    FD_SET(socket, &readset);
-                    tv.tv_sec = 2;
-                    tv.tv_usec = 500;
-    
-                    ret = select(socket + 1, &readset, NULL, NULL, &tv);
-    
-                    if ((ret > 0) && FD_ISSET(socket, &readset))
-                    {
-                        received_bytes = recv(socket, rx_buffer, sizeof(rx_buffer), 0);
-
-                        CLIP(received_bytes, 0, sizeof(rx_buffer) - 1);
-
-                        // zero terminate
-                        if (received_bytes < sizeof(rx_buffer)-1)
-                        {
-                            rx_buffer[received_bytes] = 0;
-                        }
-                        else
-                        {
-                            rx_buffer[sizeof(rx_buffer)-1] = 0;
-                        }
-    
-                        if (received_bytes > 0)
-                        {
-                            hex_dump(rx_buffer, received_bytes);
-
-                            print_printable_text(rx_buffer);
-
-                            printf("parse header\n");
-                            http_error = shelly_parse_header(rx_buffer);
-                            printf("http error code = %d\n", http_error);
-
-                            printf("parse json\n");
-                            start_of_json = strcasestr(rx_buffer, "\r\n{");
-                            if (start_of_json)
-                            {
-                                //start_of_json += 2; // point to opening brace
-
-                                jsonp_parse_buffer(&shelly_parser_context, start_of_json, false);
-                                jsonp_dump_key_value_pairs(&shelly_parser_context);
-                            }
-
-                            err = http_error;
-                            break;
-                        }
-                        else
-                        {
-                            err = -2;
-                        }
-                    }
-                    else
-                    {
-                        err = -3;
-                    }         
-                }        
+                probe = &sweep->probe[i];
             }
-            else
+        }
+
+        if (probe)
+        {
+            memset(probe, 0, sizeof(*probe));
+            probe->ip = ip;
+            ffmt_ipv4(probe->ipstring, sizeof(probe->ipstring), ip);
+            STRNCPY(probe->device_type, "UNKNOWN", sizeof(probe->device_type));
+            STRNCPY(probe->device_id, "UNKNOWN", sizeof(probe->device_id));
+            probe->filters[0] = (JSONP_FILTER_T){"root.\"type\"", probe->device_type, sizeof(probe->device_type), false, false};
+            probe->filters[1] = (JSONP_FILTER_T){"root.\"id\"", probe->device_id, sizeof(probe->device_id), false, false};
+            probe->request.type = HTTP_GET;
+            probe->request.address = probe->ipstring;
+            probe->request.url = "/shelly";
+            probe->request.filters = probe->filters;
+            probe->request.num_filters = NUM_ROWS(probe->filters);
+
+            if (http_client_submit(&probe->request) == 0)
             {
-             
-                err = -5;
-                printf("error sending packet\n");
+                probe->busy = true;
+                return;
             }
-        } 
 
-        close(socket);
-        socket = -1;
+            // every pooled connection is in use, try again once one is released
+            probe = NULL;
+        }
+
+        ulTaskNotifyTakeIndexed(0, pdTRUE, pdMS_TO_TICKS(100));
     }
 
-    return (err);
+    printf("shelly probe of %08x dropped, no connection available\n", ip);
 }
 
-// Send HTTP request
-int shelly_parse_header(char *buffer)
+/*!
+ * \brief Record the device that answered a probe, or count a miss against a known device that did not
+ *
+ * \param[in,out]  sweep   sweep
+ * \param[in,out]  probe   finished probe, released on return
+ *
+ * \return nothing
+ */
+void shelly_probe_finish(SHELLY_SWEEP_T *sweep, SHELLY_PROBE_T *probe)
 {
-    char *keyword = NULL;
-    int http_error = -1;
+    int device;
 
-    keyword = strcasestr(rx_buffer, "HTTP/");
+    // results are read after done was seen
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (probe->request.status == 200)
+    {
+        if (strcasecmp(probe->device_type, "\"SHSW-25\"") == 0)
+        {
+            shelly_add_discovered_device(probe->ip, SHELLY_TYPE_SHSW_25);
+        }
+        else if (strncasecmp(probe->device_id, "\"shellypluswdus", 15) == 0)
+        {
+            shelly_add_discovered_device(probe->ip, SHELLY_TYPE_PLUSWDUS);
+        }      
+        else if (strncasecmp(probe->device_id, "\"shellyplus1", 12) == 0)
+        {
+            shelly_add_discovered_device(probe->ip, SHELLY_TYPE_PLUS1);
+        }  
+        else if (strncasecmp(probe->device_id, "\"shellyplus2pm", 14) == 0)
+        {
+            shelly_add_discovered_device(probe->ip, SHELLY_TYPE_PLUS2PM);
+        }                                            
+        else
+        {
+            shelly_add_discovered_device(probe->ip, SHELLY_TYPE_UNKNOWN);
+        }
 
-    if (keyword)
+        printf("IP = %s SHELLY_DEVICE_TYPE = %s SHELLY_DEVICE_ID = %s\n", probe->ipstring, probe->device_type, probe->device_id);
+        sweep->found++;
+    }
+    else if ((device = shelly_find_discovered_device(probe->ip)) >= 0)
     {
-        keyword += strlen("HTTP/");
+        // one missed probe may be the device rebooting or a busy network, so it is asked again a little later
+        if (++discovered_shelly[device].failures < SHELLY_PROBE_FAILURES)
+        {
+            printf("shelly device %s did not answer, %d of %d\n", probe->ipstring, discovered_shelly[device].failures, SHELLY_PROBE_FAILURES);
+            discovered_shelly[device].last_seen = xTaskGetTickCount() - pdMS_TO_TICKS(SHELLY_DEVICE_AGE_MS) + pdMS_TO_TICKS(SHELLY_PROBE_HOLDOFF_MS);
+        }
+        else if (shelly_remove_discovered_device(probe->ip) == 0)
+        {
+            printf("shelly device %s no longer answers, forgotten\n", probe->ipstring);
+        }
+    }
+
+    probe->busy = false;
+}
 
-        keyword = find_next_space_on_line(keyword);
+/*!
+ * \brief Record the result of every probe that has finished
+ *
+ * \param[in,out]  sweep   probes
+ *
+ * \return nothing
+ */
+void shelly_probe_reap(SHELLY_SWEEP_T *sweep)
+{
+    int i;
 
-        if (keyword)
+    for(i=0; i<NUM_ROWS(sweep->probe); i++)
+    {
+        if (sweep->probe[i].busy && sweep->probe[i].request.done)
         {
-            keyword++;
+            shelly_probe_finish(sweep, &sweep->probe[i]);
+        }
+    }
+}
+
+/*!
+ * \brief Check if a host is being probed
+ *
+ * \param[in]  sweep   probes
+ * \param[in]  ip      host address, host byte order
+ *
+ * \return true if a probe of the host has not finished
+ */
+bool shelly_probe_pending(SHELLY_SWEEP_T *sweep, u32_t ip)
+{
+    int i;
 
-            sscanf(keyword, "%d", &http_error);            
+    for(i=0; i<NUM_ROWS(sweep->probe); i++)
+    {
+        if (sweep->probe[i].busy && (sweep->probe[i].ip == ip))
+        {
+            return(true);
         }
     }
 
-    return(http_error);
+    return(false);
 }
 
-// find next space on line
-char *find_next_space_on_line(char *buffer)
+/*!
+ * \brief Have a device push its state to us rather than wait to be polled
+ *
+ * Gen1 devices multicast CoIoT frames unasked.  Gen2 devices are given a webhook for each relay turning on and
+ * off, unless they already have ours, and their present state is read once since nothing is pushed until it changes.
+ *
+ * \param[in,out]  device  discovered device
+ * \param[in]      own_ip  our address, host byte order
+ *
+ * \return 0 on success, -1 to try again later
+ */
+int shelly_subscribe(DISCOVERED_SHELLY_T *device, u32_t own_ip)
 {
-    char *found = NULL;
+    HTTP_CLIENT_REQUEST_T request;
+    SHELLY_WEBHOOK_SEARCH_T search;
+    const char *component;
+    char ipstring[16];
+    char own_ipstring[16];
+    char url[96];
+    int channels = 1;
+    int channel;
+
+    switch(device->type)
+    {
+    case SHELLY_TYPE_PLUSWDUS:
+        component = "light";
+        break;
+    case SHELLY_TYPE_PLUS2PM:
+        channels = 2;
+        component = "switch";
+        break;
+    case SHELLY_TYPE_PLUS1:
+        component = "switch";
+        break;
+    default:
+        // gen1 sends coiot frames, unknown devices are not controlled
+        return(0);
+    }
 
-    if (buffer)
+    ffmt_ipv4(ipstring, sizeof(ipstring), device->ip);
+    ffmt_ipv4(own_ipstring, sizeof(own_ipstring), own_ip);
+    snprintf(url, sizeof(url), "http://%s" SHELLY_EVENT_CGI "?ip=%s", own_ipstring, ipstring);
+
+    // webhooks survive a reboot of either end, only install them once
+    search.url = url;
+    search.found = false;
+    memset(&request, 0, sizeof(request));
+    request.type = HTTP_GET;
+    request.address = ipstring;
+    request.url = "/rpc/Webhook.List";
+    request.value_callback = shelly_webhook_listed;
+    request.callback_arg = &search;
+
+    if (http_client_fetch(&request) != 200)
     {
-        while(*buffer != '\r' && *buffer != '\n' && *buffer != 0)
-        {
-            if (*buffer == ' ')
-            {
-                found = buffer;
-                break;
-            }
+        return(-1);
+    }
 
-            buffer++;
+    for(channel=0; channel<channels; channel++)
+    {
+        if (!search.found &&
+            (shelly_webhook_create(ipstring, component, channel, true, url) || shelly_webhook_create(ipstring, component, channel, false, url)))
+        {
+            return(-1);
         }
+
+        shelly_seed_status(ipstring, component, device->ip, channel);
     }
 
-    return(buffer);
+    printf("shelly device %s pushes its state to %s\n", ipstring, url);
+
+    return(0);
 }
 
+/*!
+ * \brief Check each url in a Webhook.List response for ours
+ *
+ * \param[in,out]  arg     SHELLY_WEBHOOK_SEARCH_T
+ * \param[in]      path    json path, root."hooks".indexN."urls".indexM for a url
+ * \param[in]      value   quoted url
+ *
+ * \return nothing
+ */
+void shelly_webhook_listed(void *arg, const char *path, const char *value)
+{
+    SHELLY_WEBHOOK_SEARCH_T *search = (SHELLY_WEBHOOK_SEARCH_T *)arg;
+
+    if ((value[0] == '"') && !strncmp(value + 1, search->url, strlen(search->url)) && strstr(path, ".\"urls\"."))
+    {
+        search->found = true;
+    }
+}
+
+/*!
+ * \brief Install a webhook that reports a relay turning on or off
+ *
+ * \param[in]  ipstring    device address
+ * \param[in]  component   "switch" or "light"
+ * \param[in]  channel     relay number
+ * \param[in]  on          report turning on rather than off
+ * \param[in]  url         our event url for this device, the channel and state are appended
+ *
+ * \return 0 on success, -1 on error
+ */
+int shelly_webhook_create(const char *ipstring, const char *component, int channel, bool on, const char *url)
+{
+    HTTP_CLIENT_REQUEST_T request;
+    JSON_WRITER_T writer;
+    char content[256];
+    char text[128];
+
+    jsonw_init(&writer, content, sizeof(content));
+    jsonw_object_begin(&writer, NULL);
+    jsonw_int(&writer, "id", 1);
+    jsonw_string(&writer, "method", "Webhook.Create");
+    jsonw_object_begin(&writer, "params");
+    jsonw_int(&writer, "cid", channel);
+    jsonw_bool(&writer, "enable", true);
+    snprintf(text, sizeof(text), "%s.%s", component, on ? "on" : "off");
+    jsonw_string(&writer, "event", text);
+    snprintf(text, sizeof(text), "hc_%s_%d", on ? "on" : "off", channel);
+    jsonw_string(&writer, "name", text);
+    jsonw_array_begin(&writer, "urls");
+    snprintf(text, sizeof(text), "%s&ch=%d&on=%d", url, channel, on ? 1 : 0);
+    jsonw_string(&writer, NULL, text);
+    jsonw_array_end(&writer);
+    jsonw_object_end(&writer);
+    jsonw_object_end(&writer);
+
+    if (jsonw_finish(&writer) < 0)
+    {
+        return(-1);
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.type = HTTP_POST;
+    request.address = ipstring;
+    request.url = "/rpc";
+    request.content = content;
+
+    return((http_client_fetch(&request) == 200) ? 0 : -1);
+}
+
+/*!
+ * \brief Read the state of a gen2 relay into the status table
+ *
+ * \param[in]  ipstring    device address
+ * \param[in]  component   "switch" or "light"
+ * \param[in]  ip          device address, host byte order
+ * \param[in]  channel     relay number
+ *
+ * \return 0 on success, -1 on error
+ */
+int shelly_seed_status(const char *ipstring, const char *component, u32_t ip, int channel)
+{
+    HTTP_CLIENT_REQUEST_T request;
+    SHELLY_STATUS_REPORT_T report;
+    char url[48];
+    char output[8] = "";
+    char power[16] = "";
+    JSONP_FILTER_T filters[] = {{"root.\"output\"", output, sizeof(output), false, false},
+                                {"root.\"apower\"", power, sizeof(power), false, false}};
+
+    snprintf(url, sizeof(url), "/rpc/%s.GetStatus?id=%d", strcmp(component, "light") ? "Switch" : "Light", channel);
+
+    memset(&request, 0, sizeof(request));
+    request.type = HTTP_GET;
+    request.address = ipstring;
+    request.url = url;
+    request.filters = filters;
+    request.num_filters = NUM_ROWS(filters);
+
+    if ((http_client_fetch(&request) != 200) || !filters[0].found)
+    {
+        return(-1);
+    }
+
+    memset(&report, 0, sizeof(report));
+    report.output_valid = 1 << channel;
+    report.output = strcasecmp(output, "true") ? 0 : 1 << channel;
+    if (filters[1].found)
+    {
+        report.power_valid = 1 << channel;
+        report.power_x10[channel] = shelly_status_tenths(power);
+    }
+    shelly_status_report(ip, SHELLY_SOURCE_POLL, &report);
+
+    return(0);
+}
+
+/*!
+ * \brief Switch a relay on or off
+ *
+ * \param[in]  ip          device address, host byte order
+ * \param[in]  channel     relay number
+ * \param[in]  on          new state
+ *
+ * \return 0 on success, -1 if the device is unknown or did not accept the request
+ */
+int shelly_set_output(u32_t ip, int channel, bool on)
+{
+    HTTP_CLIENT_REQUEST_T request;
+    SHELLY_DEVICE_TYPE_T type;
+    char ipstring[16];
+    char url[48];
+    int i;
+
+    i = shelly_find_discovered_device(ip);
+    if (i < 0)
+    {
+        return(-1);
+    }
+    type = discovered_shelly[i].type;
+
+    switch(type)
+    {
+    case SHELLY_TYPE_SHSW_25:
+        snprintf(url, sizeof(url), "/relay/%d?turn=%s", channel, on ? "on" : "off");
+        break;
+    case SHELLY_TYPE_PLUSWDUS:
+        snprintf(url, sizeof(url), "/rpc/Light.Set?id=%d&on=%s", channel, on ? "true" : "false");
+        break;
+    case SHELLY_TYPE_PLUS1:
+    case SHELLY_TYPE_PLUS2PM:
+        snprintf(url, sizeof(url), "/rpc/Switch.Set?id=%d&on=%s", channel, on ? "true" : "false");
+        break;
+    default:
+        return(-1);
+    }
+
+    ffmt_ipv4(ipstring, sizeof(ipstring), ip);
+
+    memset(&request, 0, sizeof(request));
+    request.type = HTTP_GET;
+    request.address = ipstring;
+    request.url = url;
+
+    return((http_client_fetch(&request) == 200) ? 0 : -1);
+}
+
+/*!
+ * \brief Send a request to a shelly device and print the json values in the response
+ *
+ * \param[in]   type            get or post
+ * \param[in]   url             page
+ * \param[in]   host            device address
+ * \param[in]   content         json to post, may be NULL
+ * \param[in]   filters         json values wanted from the response
+ * \param[in]   num_filters     number of filters
+ *
+ * \return http status, or -1 if no response was received
+ */
+int shelly_http_request(HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content, JSONP_FILTER_T *filters, int num_filters)
+{
+    HTTP_CLIENT_REQUEST_T request;
+    int status;
+
+    memset(&request, 0, sizeof(request));
+    request.type = type;
+    request.address = host;
+    request.url = url;
+    request.content = content;
+    request.filters = filters;
+    request.num_filters = num_filters;
+    request.value_callback = jsonp_print_value;
+
+    status = http_client_fetch(&request);
+    printf("http status = %d\n", status);
+
+    return(status);
+}
 
 // "type":"SHSW-25"/
 
@@ -403,13 +944,33 @@ char *find_next_space_on_line(char *buffer)
 int shelly_add_discovered_device(u32_t ip, SHELLY_DEVICE_TYPE_T type)
 {
     int err = 0;
+    int i;
+
+    // a device found again by a later sweep may have changed type
+    i = shelly_find_discovered_device(ip);
+    if (i >= 0)
+    {
+        discovered_shelly[i].last_seen = xTaskGetTickCount();
+        discovered_shelly[i].failures = 0;
+        if (discovered_shelly[i].type != type)
+        {
+            discovered_shelly[i].type = type;
+            discovered_shelly[i].subscribed = false;
+            shelly_save_discovered_devices();
+        }
+        return(err);
+    }
 
     if (num_discovered_shelly_devices < NUM_ROWS(discovered_shelly))
     {
+        memset(&discovered_shelly[num_discovered_shelly_devices], 0, sizeof(DISCOVERED_SHELLY_T));
         discovered_shelly[num_discovered_shelly_devices].ip = ip;
         discovered_shelly[num_discovered_shelly_devices].type = type;
+        discovered_shelly[num_discovered_shelly_devices].last_seen = xTaskGetTickCount();
+        discovered_shelly[num_discovered_shelly_devices].subscribe_time = discovered_shelly[num_discovered_shelly_devices].last_seen - pdMS_TO_TICKS(SHELLY_PROBE_HOLDOFF_MS);
 
         num_discovered_shelly_devices++;
+        shelly_save_discovered_devices();
     }
     else
     {
@@ -419,6 +980,63 @@ int shelly_add_discovered_device(u32_t ip, SHELLY_DEVICE_TYPE_T type)
     return(err);
 }
 
+// forget discovered device
+int shelly_remove_discovered_device(u32_t ip)
+{
+    int i;
+
+    i = shelly_find_discovered_device(ip);
+    if (i < 0)
+    {
+        return(1);
+    }
+
+    num_discovered_shelly_devices--;
+    discovered_shelly[i] = discovered_shelly[num_discovered_shelly_devices];
+    shelly_save_discovered_devices();
+
+    return(0);
+}
+
+// find discovered device
+int shelly_find_discovered_device(u32_t ip)
+{
+    int i;
+
+    for(i=0; i<num_discovered_shelly_devices; i++)
+    {
+        if (discovered_shelly[i].ip == ip)
+        {
+            return(i);
+        }
+    }
+
+    return(-1);
+}
+
+// copy discovered devices into config so they are known after a reboot
+int shelly_save_discovered_devices(void)
+{
+    int i;
+
+    for(i=0; i<NUM_ROWS(config.shelly_device_ip); i++)
+    {
+        if (i < num_discovered_shelly_devices)
+        {
+            config.shelly_device_ip[i] = discovered_shelly[i].ip;
+            config.shelly_device_type[i] = discovered_shelly[i].type;
+        }
+        else
+        {
+            config.shelly_device_ip[i] = 0;
+            config.shelly_device_type[i] = 0;
+        }
+    }
+    config_changed();
+
+    return(0);
+}
+
 // store discovered device
 int shelly_dump_discovered_devices(void)
 {
@@ -1,9 +1,40 @@
 #ifndef SHELLY_H
 #define SHELLY_H
 
-#include "powerwall.h"
+#include "http_client.h"
+#include "json_parser.h"
+
+#ifndef SHELLY_SWEEP_RATE
+#define SHELLY_SWEEP_RATE           (50)        // most pings sent per second while searching for devices
+#endif
+#ifndef SHELLY_SWEEP_ATTEMPTS
+#define SHELLY_SWEEP_ATTEMPTS       (2)         // pings sent to an address that does not reply
+#endif
+#ifndef SHELLY_SWEEP_TIMEOUT_MS
+#define SHELLY_SWEEP_TIMEOUT_MS     (1000)      // wait for replies after each round of pings
+#endif
+#ifndef SHELLY_SWEEP_INTERVAL_MS
+#define SHELLY_SWEEP_INTERVAL_MS    (86400000)  // time between full sweeps, devices are normally found passively
+#endif
+#ifndef SHELLY_MDNS_QUERY_INTERVAL_MS
+#define SHELLY_MDNS_QUERY_INTERVAL_MS (3600000) // time between mDNS queries for shelly services
+#endif
+#ifndef SHELLY_DEVICE_AGE_MS
+#define SHELLY_DEVICE_AGE_MS        (10800000)  // a device silent for longer is probed, and forgotten if it keeps not answering
+#endif
+#ifndef SHELLY_RECHECK_MS
+#define SHELLY_RECHECK_MS           (86400000)  // a host found not to be a shelly device is not probed again for this long
+#endif
+#define SHELLY_PROBE_HOLDOFF_MS     (60000)     // least time between probes of a host that keeps announcing itself
+#define SHELLY_PROBE_FAILURES       (3)         // probes in a row a known device must miss to be forgotten
+#define SHELLY_CHECKED_HOSTS        (32)        // hosts remembered as not being shelly devices
+#define SHELLY_CANDIDATES           (16)        // announced hosts waiting to be checked
+#define SHELLY_PROBE_CONCURRENCY    (HTTP_CLIENT_CONNECTIONS - 1)   // http probes at once, leaves a pooled connection for other tasks
 
 int discover_shelly_devices(void);
-int shelly_http_request(HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content);
+int shelly_discovery_start(void);
+int shelly_discovery_poll(void);
+int shelly_set_output(u32_t ip, int channel, bool on);
+int shelly_http_request(HTTP_REQUEST_TYPE_T type, char *url, char *host, char *content, JSONP_FILTER_T *filters, int num_filters);
 
 #endif
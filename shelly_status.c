@@ -0,0 +1,575 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#include "lwip/pbuf.h"
+#include "lwip/inet.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "json_parser.h"
+#include "shelly_status.h"
+
+/*
+ * Shelly device state pushed by the devices
+ *
+ * Gen1 devices multicast a CoIoT (CoAP) status frame to 224.0.1.187:5683 whenever a relay, input or meter changes
+ * and every few seconds otherwise.  The payload is json holding "G":[[channel, id, value],...] triples, decoded here
+ * with the table of ids below.  Gen2 devices have no CoIoT so shelly.c installs webhooks on them that call
+ * SHELLY_EVENT_CGI on this device when a relay turns on or off.
+ *
+ * Either way the result lands in a small table of per device state and the listening task is notified when an
+ * output or input changes, so it reacts within a scheduling tick of the frame arriving instead of polling each device.
+ * Reports may arrive on the tcpip thread or from any task, the table is guarded by a critical section.
+ */
+
+#define SHELLY_COIOT_CODE_STATUS    (30)            // shelly's own coap code for a status frame
+#define SHELLY_COIOT_OPTION_SERIAL  (3420)
+#define SHELLY_COIOT_PAYLOAD_MARKER (0xff)
+
+typedef enum
+{
+    SHELLY_FIELD_OUTPUT = 0,
+    SHELLY_FIELD_INPUT,
+    SHELLY_FIELD_POWER,
+    SHELLY_FIELD_TEMPERATURE
+} SHELLY_FIELD_T;
+
+// coiot sensor id and the field it reports
+typedef struct
+{
+    uint16_t id;
+    uint8_t field;
+    uint8_t channel;
+} SHELLY_COIOT_ID_T;
+
+// state of the payload being decoded
+typedef struct
+{
+    SHELLY_STATUS_REPORT_T report;
+    int id;                                     // id of the triple being parsed, -1 if not one we want
+} SHELLY_COIOT_DECODE_T;
+
+// prototypes
+static void shelly_status_coiot_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+static void shelly_status_coiot_value(void *arg, const char *path, const char *value);
+static int shelly_status_find(uint32_t ip);
+
+// static variables
+static SHELLY_STATUS_T shelly_status_table[SHELLY_STATUS_DEVICES];
+static uint32_t shelly_status_changes = 0;
+static TaskHandle_t shelly_status_listener = NULL;
+static struct udp_pcb *shelly_coiot_pcb = NULL;
+static uint8_t shelly_coiot_header[SHELLY_COIOT_HEADER_MAX];   // only used on the tcpip thread
+static JSON_PARSER_CONTEXT_T shelly_coiot_parser;               // only used on the tcpip thread
+
+// coiot v2 ids (firmware 1.8 onwards) followed by the v1 ids of older firmware
+static const SHELLY_COIOT_ID_T shelly_coiot_ids[] =
+{
+    {1101, SHELLY_FIELD_OUTPUT,      0},
+    {1201, SHELLY_FIELD_OUTPUT,      1},
+    {2101, SHELLY_FIELD_INPUT,       0},
+    {2201, SHELLY_FIELD_INPUT,       1},
+    {4101, SHELLY_FIELD_POWER,       0},
+    {4201, SHELLY_FIELD_POWER,       1},
+    {3104, SHELLY_FIELD_TEMPERATURE, 0},
+    {112,  SHELLY_FIELD_OUTPUT,      0},
+    {122,  SHELLY_FIELD_OUTPUT,      1},
+    {118,  SHELLY_FIELD_INPUT,       0},
+    {128,  SHELLY_FIELD_INPUT,       1},
+    {111,  SHELLY_FIELD_POWER,       0},
+    {121,  SHELLY_FIELD_POWER,       1},
+};
+
+
+/*!
+ * \brief Join the CoIoT group and start decoding status frames
+ *
+ * \return 0 on success, -1 on error
+ */
+int shelly_status_start(void)
+{
+    ip4_addr_t group;
+    int err = 0;
+    int i;
+
+    if (shelly_coiot_pcb)
+    {
+        return(0);
+    }
+
+    taskENTER_CRITICAL();
+    for(i=0; i<SHELLY_STATUS_DEVICES; i++)
+    {
+        shelly_status_table[i].ip = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    IP4_ADDR(&group, 224, 0, 1, 187);
+
+    cyw43_arch_lwip_begin();
+    shelly_coiot_pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (!shelly_coiot_pcb)
+    {
+        err = -1;
+    }
+    else if ((udp_bind(shelly_coiot_pcb, IP4_ADDR_ANY, SHELLY_COIOT_PORT) != ERR_OK) || (igmp_joingroup(IP4_ADDR_ANY4, &group) != ERR_OK))
+    {
+        udp_remove(shelly_coiot_pcb);
+        shelly_coiot_pcb = NULL;
+        err = -1;
+    }
+    else
+    {
+        udp_recv(shelly_coiot_pcb, shelly_status_coiot_recv, NULL);
+    }
+    cyw43_arch_lwip_end();
+
+    return(err);
+}
+
+/*!
+ * \brief Set the task to notify (index 0) when an output or input changes
+ *
+ * \param[in]   task    TaskHandle_t of the listener, NULL to stop notifying
+ *
+ * \return nothing
+ */
+void shelly_status_listen(void *task)
+{
+    shelly_status_listener = (TaskHandle_t)task;
+}
+
+/*!
+ * \brief Merge a report into the state table
+ *
+ * \param[in]   ip          device address, host byte order
+ * \param[in]   source      where the report came from
+ * \param[in]   report      values reported, only those marked valid are used
+ *
+ * \return 1 if an output or input changed, 0 if not
+ */
+int shelly_status_report(uint32_t ip, SHELLY_SOURCE_T source, const SHELLY_STATUS_REPORT_T *report)
+{
+    SHELLY_STATUS_T *status;
+    TickType_t now = xTaskGetTickCount();
+    uint8_t output;
+    uint8_t input;
+    int changed = 0;
+    int i;
+
+    if (!ip)
+    {
+        return(0);
+    }
+
+    taskENTER_CRITICAL();
+    i = shelly_status_find(ip);
+    status = &shelly_status_table[i];
+    if (status->ip != ip)
+    {
+        // new device, or the least recently heard from is forgotten
+        memset(status, 0, sizeof(*status));
+        status->ip = ip;
+        status->temperature_x10 = SHELLY_TEMPERATURE_UNKNOWN;
+        changed = 1;
+    }
+
+    output = (status->output & ~report->output_valid) | (report->output & report->output_valid);
+    input = (status->input & ~report->input_valid) | (report->input & report->input_valid);
+    if ((output != status->output) || (input != status->input) || (report->output_valid & ~status->known))
+    {
+        changed = 1;
+    }
+    status->output = output;
+    status->input = input;
+    status->known |= report->output_valid;
+
+    for(i=0; i<SHELLY_STATUS_CHANNELS; i++)
+    {
+        if (report->power_valid & (1 << i))
+        {
+            status->power_x10[i] = report->power_x10[i];
+        }
+    }
+    if (report->temperature_valid)
+    {
+        status->temperature_x10 = report->temperature_x10;
+    }
+
+    status->source = source;
+    status->serial = report->serial;
+    status->updated = now;
+    if (changed)
+    {
+        status->changed = now;
+        shelly_status_changes++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (changed && shelly_status_listener)
+    {
+        xTaskNotifyGiveIndexed(shelly_status_listener, 0);
+    }
+
+    return(changed);
+}
+
+/*!
+ * \brief Count of output and input changes so far
+ *
+ * \return sequence number, changes whenever the table does
+ */
+uint32_t shelly_status_sequence(void)
+{
+    return(shelly_status_changes);
+}
+
+/*!
+ * \brief Copy the devices in the state table
+ *
+ * \param[out]  table       receives the devices heard from
+ * \param[in]   size        entries in table
+ * \param[out]  sequence    sequence number of the copy, may be NULL
+ *
+ * \return number of devices copied
+ */
+int shelly_status_snapshot(SHELLY_STATUS_T *table, int size, uint32_t *sequence)
+{
+    int count = 0;
+    int i;
+
+    taskENTER_CRITICAL();
+    for(i=0; (i<SHELLY_STATUS_DEVICES) && (count<size); i++)
+    {
+        if (shelly_status_table[i].ip)
+        {
+            table[count++] = shelly_status_table[i];
+        }
+    }
+    if (sequence)
+    {
+        *sequence = shelly_status_changes;
+    }
+    taskEXIT_CRITICAL();
+
+    return(count);
+}
+
+/*!
+ * \brief Handle an event pushed by a gen2 webhook, e.g. /shelly_event.cgi?ip=192.168.1.20&ch=0&on=1
+ *
+ * \param[in]   iNumParams  number of parameters
+ * \param[in]   pcParam     parameter names
+ * \param[in]   pcValue     parameter values
+ *
+ * \return 0 on success, -1 if the event is malformed
+ */
+int shelly_status_webhook(int iNumParams, char *pcParam[], char *pcValue[])
+{
+    SHELLY_STATUS_REPORT_T report;
+    ip4_addr_t device;
+    uint32_t ip = 0;
+    int channel = 0;
+    int i;
+
+    memset(&report, 0, sizeof(report));
+
+    for(i=0; i<iNumParams; i++)
+    {
+        if (!strcasecmp(pcParam[i], "ip") && ip4addr_aton(pcValue[i], &device))
+        {
+            ip = lwip_ntohl(ip4_addr_get_u32(&device));
+        }
+        else if (!strcasecmp(pcParam[i], "ch"))
+        {
+            channel = atoi(pcValue[i]);
+        }
+        else if (!strcasecmp(pcParam[i], "on"))
+        {
+            report.output_valid = 1;
+            report.output = atoi(pcValue[i]) ? 1 : 0;
+        }
+        else if (!strcasecmp(pcParam[i], "in"))
+        {
+            report.input_valid = 1;
+            report.input = atoi(pcValue[i]) ? 1 : 0;
+        }
+    }
+
+    if (!ip || (channel < 0) || (channel >= SHELLY_STATUS_CHANNELS) || !(report.output_valid | report.input_valid))
+    {
+        return(-1);
+    }
+
+    report.output <<= channel;
+    report.output_valid <<= channel;
+    report.input <<= channel;
+    report.input_valid <<= channel;
+
+    shelly_status_report(ip, SHELLY_SOURCE_WEBHOOK, &report);
+
+    return(0);
+}
+
+/*!
+ * \brief Find the payload of a CoIoT status frame
+ *
+ * \param[in]   header          start of the frame, at least the header and options
+ * \param[in]   header_length   bytes in header
+ * \param[out]  payload_offset  offset of the json payload in the frame
+ * \param[out]  serial          serial number option, changes when the device state does
+ *
+ * \return 0 for a status frame, -1 for anything else
+ */
+int shelly_status_decode_coiot(const uint8_t *header, int header_length, int *payload_offset, uint16_t *serial)
+{
+    int offset;
+    int option = 0;
+    int delta;
+    int length;
+
+    *serial = 0;
+
+    // version 1, shelly status code, then the token
+    if ((header_length < 4) || ((header[0] >> 6) != 1) || (header[1] != SHELLY_COIOT_CODE_STATUS))
+    {
+        return(-1);
+    }
+    offset = 4 + (header[0] & 0x0f);
+
+    while (offset < header_length)
+    {
+        if (header[offset] == SHELLY_COIOT_PAYLOAD_MARKER)
+        {
+            *payload_offset = offset + 1;
+            return(0);
+        }
+
+        delta = header[offset] >> 4;
+        length = header[offset] & 0x0f;
+        offset++;
+
+        // 13 and 14 are followed by one or two bytes of extended value
+        if (delta == 13)
+        {
+            delta = (offset < header_length) ? header[offset++] + 13 : -1;
+        }
+        else if (delta == 14)
+        {
+            delta = (offset + 1 < header_length) ? ((header[offset] << 8) | header[offset + 1]) + 269 : -1;
+            offset += 2;
+        }
+        if (length == 13)
+        {
+            length = (offset < header_length) ? header[offset++] + 13 : -1;
+        }
+        else if (length == 14)
+        {
+            length = (offset + 1 < header_length) ? ((header[offset] << 8) | header[offset + 1]) + 269 : -1;
+            offset += 2;
+        }
+        if ((delta < 0) || (delta == 15) || (length < 0) || (length == 15) || (offset + length > header_length))
+        {
+            break;
+        }
+
+        option += delta;
+        if ((option == SHELLY_COIOT_OPTION_SERIAL) && (length == 2))
+        {
+            *serial = (header[offset] << 8) | header[offset + 1];
+        }
+        offset += length;
+    }
+
+    return(-1);
+}
+
+/*!
+ * \brief Convert a decimal value to tenths, e.g. "23.46" to 234
+ *
+ * \param[in]   value   number as sent, may be negative
+ *
+ * \return value x 10, limited to the range of int16_t
+ */
+int shelly_status_tenths(const char *value)
+{
+    int tenths = 0;
+    bool negative = false;
+
+    if (*value == '-')
+    {
+        negative = true;
+        value++;
+    }
+
+    while ((*value >= '0') && (*value <= '9') && (tenths < 100000))
+    {
+        tenths = tenths * 10 + (*value++ - '0');
+    }
+    tenths *= 10;
+
+    if ((value[0] == '.') && (value[1] >= '0') && (value[1] <= '9'))
+    {
+        tenths += value[1] - '0';
+    }
+
+    if (tenths > INT16_MAX)
+    {
+        tenths = INT16_MAX;
+    }
+
+    return(negative ? -tenths : tenths);
+}
+
+/*!
+ * \brief Decode a CoIoT frame and merge the values it carries into the table
+ *
+ * \return nothing
+ */
+static void shelly_status_coiot_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    SHELLY_COIOT_DECODE_T decode;
+    struct pbuf *q;
+    int length;
+    int offset;
+    uint16_t serial;
+
+    length = pbuf_copy_partial(p, shelly_coiot_header, sizeof(shelly_coiot_header), 0);
+
+    if (!IP_IS_V4(addr) || shelly_status_decode_coiot(shelly_coiot_header, length, &offset, &serial))
+    {
+        pbuf_free(p);
+        return;
+    }
+
+    memset(&decode, 0, sizeof(decode));
+    decode.id = -1;
+    decode.report.serial = serial;
+
+    // parse the payload in place, a frame can span several pbufs
+    jsonp_begin(&shelly_coiot_parser, NULL, 0, shelly_status_coiot_value, &decode);
+    for(q = p; q; q = q->next)
+    {
+        if (offset < q->len)
+        {
+            jsonp_parse_buffer(&shelly_coiot_parser, (const char *)q->payload + offset, q->len - offset);
+            offset = 0;
+        }
+        else
+        {
+            offset -= q->len;
+        }
+    }
+    pbuf_free(p);
+
+    if (!jsonp_end(&shelly_coiot_parser))
+    {
+        shelly_status_report(lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(addr))), SHELLY_SOURCE_COIOT, &decode.report);
+    }
+}
+
+/*!
+ * \brief Pick the wanted values out of the "G" triples, root."G".indexN.index1 is the id and .index2 the value
+ *
+ * \return nothing
+ */
+static void shelly_status_coiot_value(void *arg, const char *path, const char *value)
+{
+    SHELLY_COIOT_DECODE_T *decode = (SHELLY_COIOT_DECODE_T *)arg;
+    const SHELLY_COIOT_ID_T *entry;
+    const char *element;
+    int id;
+    int i;
+
+    if (strncasecmp(path, "root.\"G\".index", 14) || !(element = strrchr(path, '.')) || (element == path + 8))
+    {
+        return;
+    }
+
+    if (!strcmp(element, ".index1"))
+    {
+        id = atoi(value);
+        decode->id = -1;
+        for(i=0; i<sizeof(shelly_coiot_ids)/sizeof(shelly_coiot_ids[0]); i++)
+        {
+            if (shelly_coiot_ids[i].id == id)
+            {
+                decode->id = i;
+                break;
+            }
+        }
+    }
+    else if (!strcmp(element, ".index2") && (decode->id >= 0))
+    {
+        entry = &shelly_coiot_ids[decode->id];
+        decode->id = -1;
+
+        switch(entry->field)
+        {
+        case SHELLY_FIELD_OUTPUT:
+            decode->report.output_valid |= 1 << entry->channel;
+            decode->report.output |= (atoi(value) ? 1 : 0) << entry->channel;
+            break;
+        case SHELLY_FIELD_INPUT:
+            decode->report.input_valid |= 1 << entry->channel;
+            decode->report.input |= (atoi(value) ? 1 : 0) << entry->channel;
+            break;
+        case SHELLY_FIELD_POWER:
+            decode->report.power_valid |= 1 << entry->channel;
+            decode->report.power_x10[entry->channel] = shelly_status_tenths(value);
+            break;
+        case SHELLY_FIELD_TEMPERATURE:
+            decode->report.temperature_valid = true;
+            decode->report.temperature_x10 = shelly_status_tenths(value);
+            break;
+        }
+    }
+}
+
+/*!
+ * \brief Find the table entry for a device, or the one to reuse for it
+ *
+ * \param[in]   ip      device address
+ *
+ * \return index of the device, else a free entry, else the least recently updated
+ */
+static int shelly_status_find(uint32_t ip)
+{
+    int free = -1;
+    int oldest = 0;
+    int i;
+
+    for(i=0; i<SHELLY_STATUS_DEVICES; i++)
+    {
+        if (shelly_status_table[i].ip == ip)
+        {
+            return(i);
+        }
+        if (!shelly_status_table[i].ip)
+        {
+            if (free < 0)
+            {
+                free = i;
+            }
+        }
+        else if ((int32_t)(shelly_status_table[i].updated - shelly_status_table[oldest].updated) < 0)
+        {
+            oldest = i;
+        }
+    }
+
+    return((free >= 0) ? free : oldest);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2025 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SHELLY_STATUS_H
+#define SHELLY_STATUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SHELLY_STATUS_DEVICES       (32)        // devices tracked, the least recently updated is replaced when full
+#define SHELLY_STATUS_CHANNELS      (2)         // relays, inputs and meters per device
+#define SHELLY_COIOT_PORT           (5683)
+#define SHELLY_COIOT_HEADER_MAX     (256)       // coap header and options, frames with more are ignored
+#define SHELLY_EVENT_CGI            "/shelly_event.cgi"
+#define SHELLY_TEMPERATURE_UNKNOWN  (INT16_MIN)
+
+typedef enum
+{
+    SHELLY_SOURCE_NONE = 0,
+    SHELLY_SOURCE_COIOT,                // gen1 multicast status frame
+    SHELLY_SOURCE_WEBHOOK,              // gen2 pushed an event to SHELLY_EVENT_CGI
+    SHELLY_SOURCE_POLL                  // answer to a status request
+} SHELLY_SOURCE_T;
+
+// last known state of a device
+typedef struct
+{
+    uint32_t ip;                                    // host byte order, 0 for an unused entry
+    uint8_t source;                                 // SHELLY_SOURCE_T of the last update
+    uint8_t output;                                 // bit per relay
+    uint8_t input;                                  // bit per input
+    uint8_t known;                                  // bit per relay whose output has been reported
+    int16_t power_x10[SHELLY_STATUS_CHANNELS];      // watts x 10
+    int16_t temperature_x10;                        // device temperature, SHELLY_TEMPERATURE_UNKNOWN if never reported
+    uint16_t serial;                                // coiot serial of the last frame
+    uint32_t updated;                               // tick count of the last report
+    uint32_t changed;                               // tick count of the last change of an output or input
+} SHELLY_STATUS_T;
+
+// values carried by one status frame, webhook or poll
+typedef struct
+{
+    uint8_t output;                                 // bit per relay
+    uint8_t output_valid;                           // bit per relay reported
+    uint8_t input;
+    uint8_t input_valid;
+    uint8_t power_valid;                            // bit per meter reported
+    bool temperature_valid;
+    int16_t power_x10[SHELLY_STATUS_CHANNELS];
+    int16_t temperature_x10;
+    uint16_t serial;                                // coiot serial, 0 for other sources
+} SHELLY_STATUS_REPORT_T;
+
+int shelly_status_start(void);
+void shelly_status_listen(void *task);
+int shelly_status_report(uint32_t ip, SHELLY_SOURCE_T source, const SHELLY_STATUS_REPORT_T *report);
+uint32_t shelly_status_sequence(void);
+int shelly_status_snapshot(SHELLY_STATUS_T *table, int size, uint32_t *sequence);
+int shelly_status_webhook(int iNumParams, char *pcParam[], char *pcValue[]);
+int shelly_status_decode_coiot(const uint8_t *header, int header_length, int *payload_offset, uint16_t *serial);
+int shelly_status_tenths(const char *value);
+
+#endif
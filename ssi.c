@@ -26,10 +26,18 @@
 #include "powerwall.h"
 #endif
 #include "led_strip.h"
+#include "clock_sync.h"
+#include "store_forward.h"
+#include "web_snapshot.h"
+#include "seqlock_stress.h"
+#include "ssi_cache.h"
+#include "ssi_render.h"
+#include "fixed_format.h"
 
 #ifdef USE_GIT_HASH_AS_VERSION
 #include "githash.h"
 #endif
+#include "generated/ssi_hash.h"
 
 
 
@@ -567,106 +575,6 @@ extern NON_VOL_VARIABLES_T config;
     x(sp31mde) \
     x(sp32mde) \
     x(hvachys)\
-    x(this1) \
-    x(this2) \
-    x(this3) \
-    x(this4) \
-    x(this5) \
-    x(this6) \
-    x(this7) \
-    x(this8) \
-    x(this9) \
-    x(this10) \
-    x(this11) \
-    x(this12) \
-    x(this13) \
-    x(this14) \
-    x(this15) \
-    x(this16) \
-    x(this17) \
-    x(this18) \
-    x(this19) \
-    x(this20) \
-    x(this21) \
-    x(this22) \
-    x(this23) \
-    x(this24) \
-    x(this25) \
-    x(this26) \
-    x(this27) \
-    x(this28) \
-    x(this29) \
-    x(this30) \
-    x(this31) \
-    x(this32) \
-    x(this33) \
-    x(this34) \
-    x(this35) \
-    x(this36) \
-    x(this37) \
-    x(this38) \
-    x(this39) \
-    x(this40) \
-    x(this41) \
-    x(this42) \
-    x(this43) \
-    x(this44) \
-    x(this45) \
-    x(this46) \
-    x(this47) \
-    x(this48) \
-    x(this49) \
-    x(this50) \
-    x(this51) \
-    x(this52) \
-    x(this53) \
-    x(this54) \
-    x(this55) \
-    x(this56) \
-    x(this57) \
-    x(this58) \
-    x(this59) \
-    x(this60) \
-    x(this61) \
-    x(this62) \
-    x(this63) \
-    x(this64) \
-    x(this65) \
-    x(this66) \
-    x(this67) \
-    x(this68) \
-    x(this69) \
-    x(this70) \
-    x(this71) \
-    x(this72) \
-    x(this73) \
-    x(this74) \
-    x(this75) \
-    x(this76) \
-    x(this77) \
-    x(this78) \
-    x(this79) \
-    x(this80) \
-    x(this81) \
-    x(this82) \
-    x(this83) \
-    x(this84) \
-    x(this85) \
-    x(this86) \
-    x(this87) \
-    x(this88) \
-    x(this89) \
-    x(this90) \
-    x(this91) \
-    x(this92) \
-    x(this93) \
-    x(this94) \
-    x(this95) \
-    x(this96) \
-    x(this97) \
-    x(this98) \
-    x(this99) \
-    x(this100) \
     x(cmplte)   \
     x(c1d1d)     \
     x(c1d2d)     \
@@ -740,7 +648,16 @@ extern NON_VOL_VARIABLES_T config;
     x(anip)      \
     x(anen)      \
     x(adcmin)    \
-    x(adcmax)    
+    x(adcmax)    \
+    x(csen)      \
+    x(csip)      \
+    x(csstat)    \
+    x(sfqd)      \
+    x(sfdrop)    \
+    x(sfrply)    \
+    x(sfspil)    \
+    x(slstrs)    \
+    x(srlock)    
 
   
 //enum used to index array of pointers to SSI string constants  e.g. index 0 is SSI_usurped
@@ -759,6 +676,9 @@ SSI_TAGS
 #undef x
 };
 
+// regenerate with makessihash.py (run by cmake) whenever SSI_TAGS changes
+_Static_assert(LWIP_ARRAYSIZE(ssi_tags) == SSI_HASH_TAG_COUNT, "generated/ssi_hash.h is out of date -- run makessihash.py");
+
 
 u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
 {
@@ -774,6 +694,11 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
     int grid_y = 0;
     bool first_item_printed = false;
     char gpio_list[192];
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+    WEB_THERMOSTAT_T thermostat;
+    WEB_NETWORK_T network;
+    WEB_POWERWALL_T powerwall;
 
     switch(iIndex) {
         case SSI_usurped:  // usurped
@@ -798,58 +723,33 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;        
         case SSI_temp: // temp
         {
-            if (!config.use_archaic_units)
-            {
-                printed = snprintf(pcInsert, iInsertLen, "%c%d.%d", web.outside_temperature<0?'-':' ', abs(web.outside_temperature/10), abs(web.outside_temperature%10)); 
-            }
-            else
-            {
-                temp = (web.outside_temperature*9)/5 + 320;
-                printed = snprintf(pcInsert, iInsertLen, "%c%ld.%ld", temp<0?'-':' ', abs(temp)/10, abs(temp%10));
-            }              
+            printed = ssi_cache_get(SSI_VALUE_OUTSIDE_TEMPERATURE, config.use_archaic_units, pcInsert, iInsertLen);
         }
         break;
         case SSI_wind: // wind
         {
             if ((config.anemometer_remote_enable) || (config.personality == ANEMOMETER))
             {
-                i = web.anemometer_wind_speed;
+                printed = ssi_cache_get(SSI_VALUE_ANEMOMETER_WIND, config.use_archaic_units, pcInsert, iInsertLen);
             }         
             else
             {
-                i = web.wind_speed;
+                printed = ssi_cache_get(SSI_VALUE_STATION_WIND, config.use_archaic_units, pcInsert, iInsertLen);
             }
-
-            if (!config.use_archaic_units)
-            {
-                printed = snprintf(pcInsert, iInsertLen, "%d.%d", i/10, i%10); 
-            }
-            else
-            {
-                temp = (i*3281 + 500)/1000;
-                printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", temp/10, temp%10);
-            }              
         } 
         break;  
         case SSI_rain: // rain
         {
-            if (!config.use_archaic_units)
-            {
-                printed = snprintf(pcInsert, iInsertLen, "%d.%d", web.daily_rain/10, web.daily_rain%10); 
-            }
-            else
-            {
-                temp = (10*web.daily_rain + 127)/254;
-                printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", temp/10, temp%10);
-            }            
+            printed = ssi_cache_get(SSI_VALUE_RAIN_DAY, config.use_archaic_units, pcInsert, iInsertLen);
         }  
         break;
         case SSI_lstpck: // lstpck
         {
-            if (web.us_last_rx_packet)
+            web_snapshot_weather(&weather);
+            if (weather.us_last_rx_packet)
             {
                 us_now = time_us_32();
-                printed = snprintf(pcInsert, iInsertLen, "%lu s", (us_now - web.us_last_rx_packet)/1000000);   
+                printed = snprintf(pcInsert, iInsertLen, "%lu s", (us_now - weather.us_last_rx_packet)/1000000);   
             }
             else
             {
@@ -864,15 +764,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;   
         case SSI_rainwk: // rainwk
         {          
-            if (!config.use_archaic_units)
-            {
-                printed = snprintf(pcInsert, iInsertLen, "%d.%d", web.weekly_rain/10, web.weekly_rain%10); 
-            }
-            else
-            {
-                temp = (10*web.weekly_rain + 127)/254;
-                printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", temp/10, temp%10);
-            }             
+            printed = ssi_cache_get(SSI_VALUE_RAIN_WEEK, config.use_archaic_units, pcInsert, iInsertLen);
         }  
         break;   
         case SSI_status: // status
@@ -945,7 +837,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (config.day_schedule_enable[iIndex-SSI_dur1])
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.day_duration[iIndex-SSI_dur1]);    
+                printed = ffmt_int(pcInsert, iInsertLen, config.day_duration[iIndex-SSI_dur1]);    
             }
             else
             {                 
@@ -981,7 +873,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
                 if (config.timezone_offset%60 == 0)
                 {
                     // normal time zone with whole number of hours
-                    printed = snprintf(pcInsert, iInsertLen, "%d", config.timezone_offset/60);                 
+                    printed = ffmt_int(pcInsert, iInsertLen, config.timezone_offset/60);                 
                 }
                 else
                 {   // unusual time zone with hours and minutes
@@ -1020,17 +912,17 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_wkrn: //wkrn
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", config.rain_week_threshold/10, config.rain_week_threshold%10);   
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.rain_week_threshold, 1, 0);   
         }               
         break;        
         case SSI_dyrn: //dyrn
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", config.rain_day_threshold/10, config.rain_day_threshold%10);
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.rain_day_threshold, 1, 0);
         }               
         break; 
         case SSI_wndt: //wndt
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", config.wind_threshold/10, config.wind_threshold%10);
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.wind_threshold, 1, 0);
         }               
         break;
         case SSI_ssid: //ssid
@@ -1051,14 +943,18 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;    
         case SSI_ipad: //ipad
         {
+            web_snapshot_network(&network);
             if (!config.dhcp_enable)
             {
                 if (strncasecmp(config.ip_address, "automatic+via+DHCP", sizeof(config.ip_address))==0)
                 {
-                    //config.ip_address[0] = 0;
-                    STRNCPY(config.ip_address, web.ip_address_string, sizeof(config.ip_address));   
+                    // show what dhcp gave, config is only changed by cgi handlers
+                    printed = snprintf(pcInsert, iInsertLen, "%s", network.ip_address_string);
+                }
+                else
+                {
+                    printed = snprintf(pcInsert, iInsertLen, "%s", config.ip_address);
                 }
-                printed = snprintf(pcInsert, iInsertLen, "%s", config.ip_address);
             }
             else
             {
@@ -1068,14 +964,18 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;    
         case SSI_nmsk: //nmsk
         {
+            web_snapshot_network(&network);
             if (!config.dhcp_enable)
             {
                 if (strncasecmp(config.network_mask, "automatic+via+DHCP", sizeof(config.network_mask))==0)
                 {
-                    //config.network_mask[0] = 0;
-                    STRNCPY(config.network_mask, web.network_mask_string, sizeof(config.network_mask));  
-                }                
-                printed = snprintf(pcInsert, iInsertLen, "%s", config.network_mask);
+                    // show what dhcp gave, config is only changed by cgi handlers
+                    printed = snprintf(pcInsert, iInsertLen, "%s", network.network_mask_string);
+                }
+                else
+                {
+                    printed = snprintf(pcInsert, iInsertLen, "%s", config.network_mask);
+                }
             }
             else
             {
@@ -1095,7 +995,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_gpio: //gpio
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.gpio_number);
+            printed = ffmt_int(pcInsert, iInsertLen, config.gpio_number);
         }               
         break;   
         case SSI_lpat: //lpat
@@ -1105,22 +1005,22 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_lspd: //lspd
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.led_speed);
+            printed = ffmt_int(pcInsert, iInsertLen, config.led_speed);
         }               
         break;     
         case SSI_lpin: //lpin
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.led_pin);
+            printed = ffmt_int(pcInsert, iInsertLen, config.led_pin);
         }               
         break;                                      
         case SSI_lrgbw: //lrgbw
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.led_rgbw);
+            printed = ffmt_int(pcInsert, iInsertLen, config.led_rgbw);
         }               
         break;  
         case SSI_lnum: //lnum
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.led_number);
+            printed = ffmt_int(pcInsert, iInsertLen, config.led_number);
         }               
         break;  
         case SSI_slog: //slog
@@ -1166,7 +1066,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_gves: //gves
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.govee_sustain_duration);
+            printed = ffmt_int(pcInsert, iInsertLen, config.govee_sustain_duration);
         }
         break;                        
         case SSI_lie: //lie
@@ -1186,7 +1086,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_lis: //lis
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.led_sustain_duration);
+            printed = ffmt_int(pcInsert, iInsertLen, config.led_sustain_duration);
         }
         break; 
         case SSI_ghsh: //ghsh
@@ -1200,16 +1100,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_lstsvn: //lstsvn
         {
-            if (!config.use_archaic_units)
-            {
-                printed = snprintf(pcInsert, iInsertLen, "%d.%d", web.trailing_seven_days_rain/10, web.trailing_seven_days_rain%10); 
-            }
-            else
-            {
-                temp = (10*web.trailing_seven_days_rain + 127)/254;
-                printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", temp/10, temp%10);
-            }                
-            
+            printed = ssi_cache_get(SSI_VALUE_RAIN_SEVEN_DAYS, config.use_archaic_units, pcInsert, iInsertLen);
         }                        
         break;    
         case SSI_dstu: //dstu
@@ -1239,24 +1130,30 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_ipaddr: //ipaddr
         {
-            printed = snprintf(pcInsert, iInsertLen, "%s", web.ip_address_string);
+            web_snapshot_network(&network);
+            printed = snprintf(pcInsert, iInsertLen, "%s", network.ip_address_string);
         }               
         break;   
         case SSI_netmsk: //netmsk
         {
-            printed = snprintf(pcInsert, iInsertLen, "%s", web.network_mask_string);
+            web_snapshot_network(&network);
+            printed = snprintf(pcInsert, iInsertLen, "%s", network.network_mask_string);
         }               
         break;   
         case SSI_gatewy: //gatewy
         {
+            web_snapshot_network(&network);
             if (!config.dhcp_enable)
             {
                 if (strncasecmp(config.gateway, "automatic+via+DHCP", sizeof(config.gateway))==0)
                 {
-                    //config.gateway[0] = 0;
-                    STRNCPY(config.gateway, web.gateway_string, sizeof(config.gateway));                  
-                }                
-                printed = snprintf(pcInsert, iInsertLen, "%s", config.gateway);
+                    // show what dhcp gave, config is only changed by cgi handlers
+                    printed = snprintf(pcInsert, iInsertLen, "%s", network.gateway_string);
+                }
+                else
+                {
+                    printed = snprintf(pcInsert, iInsertLen, "%s", config.gateway);
+                }
             }
             else
             {
@@ -1266,32 +1163,32 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_msck: //msck
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.socket_max);
+            printed = ffmt_int(pcInsert, iInsertLen, web.socket_max);
         }               
         break;  
         case SSI_bfail: //bfail
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.bind_failures);
+            printed = ffmt_int(pcInsert, iInsertLen, web.bind_failures);
         }               
         break;  
         case SSI_cfail: //cfail
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.connect_failures);
+            printed = ffmt_int(pcInsert, iInsertLen, web.connect_failures);
         }               
         break;  
         case SSI_sfail: //sfail
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.syslog_transmit_failures);
+            printed = ffmt_int(pcInsert, iInsertLen, web.syslog_transmit_failures);
         }               
         break;  
         case SSI_wfail: //wfail
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.weather_station_transmit_failures);
+            printed = ffmt_int(pcInsert, iInsertLen, web.weather_station_transmit_failures);
         }               
         break;  
         case SSI_gfail: //gfail
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.govee_transmit_failures);
+            printed = ffmt_int(pcInsert, iInsertLen, web.govee_transmit_failures);
         }               
         break;   
         case SSI_simpe: //simpe
@@ -1318,7 +1215,8 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_calpge: //calpge
         {
-            if (web.access_point_mode)
+            web_snapshot_network(&network);
+            if (network.access_point_mode)
             {
                 printed = snprintf(pcInsert, iInsertLen, "/network.shtml");
             }
@@ -1379,7 +1277,8 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_porpge: //porpge
         {
-            if (web.access_point_mode)
+            web_snapshot_network(&network);
+            if (network.access_point_mode)
             {
                 printed = snprintf(pcInsert, iInsertLen, "/network.shtml");
             }
@@ -1473,7 +1372,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_pertyp: //pertyp
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.personality);
+            printed = ffmt_int(pcInsert, iInsertLen, config.personality);
         } 
         break; 
         case SSI_wific: //wific
@@ -1483,17 +1382,19 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;  
         case SSI_gway: //gway
         {
-            printed = snprintf(pcInsert, iInsertLen, "%s", web.gateway_string);
+            web_snapshot_network(&network);
+            printed = snprintf(pcInsert, iInsertLen, "%s", network.gateway_string);
         }                       
         break;
         case SSI_soilm1: //soilm1
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.soil_moisture[0]);
+            web_snapshot_weather(&weather);
+            printed = ffmt_int(pcInsert, iInsertLen, weather.soil_moisture[0]);
         }                       
         break;    
         case SSI_soilt1: //soilt1
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.soil_moisture_threshold[0]);
+            printed = ffmt_int(pcInsert, iInsertLen, config.soil_moisture_threshold[0]);
         }                       
         break;   
         case SSI_z1d1d:
@@ -1555,7 +1456,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {  
             if (config.day_schedule_enable[(iIndex-SSI_z1d1d)%7])
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.zone_duration[(iIndex-SSI_z1d1d)/7][(iIndex-SSI_z1d1d)%7]);
+                printed = ffmt_int(pcInsert, iInsertLen, config.zone_duration[(iIndex-SSI_z1d1d)/7][(iIndex-SSI_z1d1d)%7]);
             }
             else
             {
@@ -1640,12 +1541,12 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;        
         case SSI_clpat: //clpat
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.led_current_pattern);
+            printed = ffmt_int(pcInsert, iInsertLen, web.led_current_pattern);
         } 
         break;
         case SSI_cltran: //cltran
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.led_current_transition_delay);
+            printed = ffmt_int(pcInsert, iInsertLen, web.led_current_transition_delay);
         } 
         break;  
         case SSI_clreq: //clreq
@@ -1662,7 +1563,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         case SSI_z7gpio:
         case SSI_z8gpio:
         {     
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.zone_gpio[(iIndex-SSI_z1gpio)%8]);             
+            printed = ffmt_int(pcInsert, iInsertLen, config.zone_gpio[(iIndex-SSI_z1gpio)%8]);             
         }
         break;
         case SSI_z1viz:
@@ -1686,7 +1587,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_zmax: //zmax
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.zone_max);
+            printed = ffmt_int(pcInsert, iInsertLen, config.zone_max);
         }   
         break;     
         case SSI_rpage: //rpage
@@ -2132,32 +2033,32 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_pwgdhd:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_heating_setpoint_decrease/10, config.grid_down_heating_setpoint_decrease%10);
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_heating_setpoint_decrease, 1, 0);
         }
         break;        
         case SSI_pwgdci:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_cooling_setpoint_increase/10, config.grid_down_cooling_setpoint_increase%10);            
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_cooling_setpoint_increase, 1, 0);            
         }
         break;
         case SSI_pwblhd:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_heating_disable_battery_level/10, config.grid_down_heating_disable_battery_level%10);            
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_heating_disable_battery_level, 1, 0);            
         }
         break;        
         case SSI_pwblhe:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_heating_enable_battery_level/10, config.grid_down_heating_enable_battery_level%10);            
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_heating_enable_battery_level, 1, 0);            
         }
         break;
         case SSI_pwblcd:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_cooling_disable_battery_level/10, config.grid_down_cooling_disable_battery_level%10);            
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_cooling_disable_battery_level, 1, 0);            
         }
         break;   
         case SSI_pwblce:
         {
-            printed = snprintf(pcInsert, iInsertLen, "%ld.%ld", config.grid_down_cooling_enable_battery_level/10, config.grid_down_cooling_enable_battery_level%10);            
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.grid_down_cooling_enable_battery_level, 1, 0);            
         }
         break; 
         case SSI_tday:
@@ -2178,7 +2079,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
 
             if (config.setpoint_temperaturex10[web.thermostat_period_row] > SETPOINT_TEMP_UNDEFINED)
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.setpoint_temperaturex10[web.thermostat_period_row]/10); 
+                printed = ffmt_int(pcInsert, iInsertLen, config.setpoint_temperaturex10[web.thermostat_period_row]/10); 
             }
             else
             {
@@ -2192,7 +2093,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
 
             if (config.setpoint_heating_temperaturex10[web.thermostat_period_row] > SETPOINT_TEMP_UNDEFINED)
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.setpoint_heating_temperaturex10[web.thermostat_period_row]/10); 
+                printed = ffmt_int(pcInsert, iInsertLen, config.setpoint_heating_temperaturex10[web.thermostat_period_row]/10); 
             }
             else
             {
@@ -2206,7 +2107,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
 
             if (config.setpoint_cooling_temperaturex10[web.thermostat_period_row] > SETPOINT_TEMP_UNDEFINED)
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.setpoint_cooling_temperaturex10[web.thermostat_period_row]/10); 
+                printed = ffmt_int(pcInsert, iInsertLen, config.setpoint_cooling_temperaturex10[web.thermostat_period_row]/10); 
             }
             else
             {
@@ -2352,7 +2253,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_tct:  // thermostat current temperature
         {
-            printed = snprintf(pcInsert, iInsertLen, "%c%d.%d", web.thermostat_temperature<0?'-':' ', abs(web.thermostat_temperature/10), abs(web.thermostat_temperature%10)); 
+            printed = ssi_cache_get(SSI_VALUE_THERMOSTAT_TEMPERATURE, config.use_archaic_units, pcInsert, iInsertLen);
             // if (!config.use_archaic_units)
             // {
             //     printed = snprintf(pcInsert, iInsertLen, "%c%d.%d", web.thermostat_temperature<0?'-':' ', abs(web.thermostat_temperature/10), abs(web.thermostat_temperature%10)); 
@@ -2368,9 +2269,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         case SSI_tcs:  // thermostat current setpoint
         {
             //temp = update_current_setpoints();
-            temp = web.thermostat_set_point;
-
-            printed = snprintf(pcInsert, iInsertLen, "%c%ld.%ld", temp<0?'-':' ', abs(temp)/10, abs(temp%10));                           
+            printed = ssi_cache_get(SSI_VALUE_THERMOSTAT_SET_POINT, config.use_archaic_units, pcInsert, iInsertLen);
         }
         break;
 #endif
@@ -2378,7 +2277,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.heating_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.heating_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.heating_gpio);
             }
             else
             {
@@ -2390,7 +2289,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.cooling_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.cooling_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.cooling_gpio);
             }
             else
             {
@@ -2402,7 +2301,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.fan_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.fan_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.fan_gpio);
             }
             else
             {
@@ -2462,27 +2361,29 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;      
         case SSI_tempth: //SSI_tempth
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", config.outside_temperature_threshold/10, config.outside_temperature_threshold%10);   
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.outside_temperature_threshold, 1, 0);   
         }               
         break;          
 #ifdef INCORPORATE_THERMOSTAT  
         case SSI_tint:  // thermostat indoor temperature
         {
-            lower = web.thermostat_temperature;
-            upper = web.thermostat_heating_set_point + config.thermostat_hysteresis;
+            web_snapshot_thermostat(&thermostat);
+            lower = thermostat.temperature;
+            upper = thermostat.heating_set_point + config.thermostat_hysteresis;
 
-            printed = snprintf(pcInsert, iInsertLen, "%c%ld.%ld", lower<0?'-':' ', abs(lower)/10, abs(lower%10));
+            printed = ffmt_fixed(pcInsert, iInsertLen, lower, 1, ' ');
         }
         break;            
         case SSI_tchs:  // thermostat current heating thresholds
         {
-            switch (web.thermostat_effective_mode)
+            web_snapshot_thermostat(&thermostat);
+            switch (thermostat.effective_mode)
             {
             case HVAC_AUTO:
             case HVAC_HEATING_ONLY:
             case HVAC_HEAT_AND_COOL:
-                lower = web.thermostat_heating_set_point - config.thermostat_hysteresis;
-                upper = web.thermostat_heating_set_point + config.thermostat_hysteresis;
+                lower = thermostat.heating_set_point - config.thermostat_hysteresis;
+                upper = thermostat.heating_set_point + config.thermostat_hysteresis;
 
                 printed = snprintf(pcInsert, iInsertLen, "%c%ld.%ld to %c%ld.%ld %s%s", lower<0?'-':' ', abs(lower)/10, abs(lower%10), upper<0?'-':' ', abs(upper)/10, abs(upper%10), "&deg;", config.use_archaic_units?"F":"C");
                 break;
@@ -2497,13 +2398,14 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;
         case SSI_tccs:  // thermostat current cooling thresholds
         {
-            switch (web.thermostat_effective_mode)
+            web_snapshot_thermostat(&thermostat);
+            switch (thermostat.effective_mode)
             {
             case HVAC_AUTO:
             case HVAC_COOLING_ONLY:
             case HVAC_HEAT_AND_COOL:
-                lower = web.thermostat_cooling_set_point - config.thermostat_hysteresis;
-                upper = web.thermostat_cooling_set_point + config.thermostat_hysteresis;
+                lower = thermostat.cooling_set_point - config.thermostat_hysteresis;
+                upper = thermostat.cooling_set_point + config.thermostat_hysteresis;
 
                 printed = snprintf(pcInsert, iInsertLen, "%c%ld.%ld to %c%ld.%ld %s%s", lower<0?'-':' ', abs(lower)/10, abs(lower%10), upper<0?'-':' ', abs(upper)/10, abs(upper%10), "&deg;", config.use_archaic_units?"F":"C");
                 break;
@@ -2518,7 +2420,8 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;   
         case SSI_grids:  // grid status
         {
-            switch(web.powerwall_grid_status)
+            web_snapshot_powerwall(&powerwall);
+            switch(powerwall.grid_status)
             {
                 case GRID_DOWN:
                 printed = snprintf(pcInsert, iInsertLen, "DOWN");
@@ -2537,14 +2440,15 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;  
         case SSI_batp:  // battery percentage
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", web.powerwall_battery_percentage/10, web.powerwall_battery_percentage%10);                           
+            web_snapshot_powerwall(&powerwall);
+            printed = ffmt_fixed(pcInsert, iInsertLen, powerwall.battery_percentage, 1, 0);                           
         }
         break;         
         case SSI_tacgpio:  // temperature sensor clock
         {
             if (gpio_valid(config.thermostat_temperature_sensor_clock_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_temperature_sensor_clock_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_temperature_sensor_clock_gpio);
             }
             else
             {
@@ -2556,7 +2460,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_temperature_sensor_data_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_temperature_sensor_data_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_temperature_sensor_data_gpio);
             }
             else
             {
@@ -2568,7 +2472,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_seven_segment_display_clock_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_seven_segment_display_clock_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_seven_segment_display_clock_gpio);
             }
             else
             {
@@ -2580,7 +2484,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_seven_segment_display_data_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_seven_segment_display_data_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_seven_segment_display_data_gpio);
             }
             else
             {
@@ -2592,7 +2496,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_increase_button_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_increase_button_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_increase_button_gpio);
             }
             else
             {
@@ -2604,7 +2508,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_decrease_button_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_decrease_button_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_decrease_button_gpio);
             }
             else
             {
@@ -2616,7 +2520,7 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         {
             if (gpio_valid(config.thermostat_mode_button_gpio))
             {
-                printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_mode_button_gpio);
+                printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_mode_button_gpio);
             }
             else
             {
@@ -2626,162 +2530,60 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break; 
         case SSI_htclm:  // heating to cooling lockuout
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.heating_to_cooling_lockout_mins);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.heating_to_cooling_lockout_mins);                           
         }
         break;
         case SSI_mhonm:  // minimum heating on time
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.minimum_heating_on_mins);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.minimum_heating_on_mins);                           
         }
         break;
         case SSI_mconm:  // minimum cooling on time
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.minimum_cooling_on_mins);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.minimum_cooling_on_mins);                           
         }
         break;
         case SSI_mhoffm:  // minimum heating off time
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.minimum_heating_off_mins);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.minimum_heating_off_mins);                           
         }
         break;
         case SSI_mcoffm:  // minimum cooling off time
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.minimum_cooling_off_mins);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.minimum_cooling_off_mins);                           
         }
         break;              
         case SSI_hvachys:  // hysteresis
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d.%d", config.thermostat_hysteresis/10, config.thermostat_hysteresis%10);                    
+            printed = ffmt_fixed(pcInsert, iInsertLen, config.thermostat_hysteresis, 1, 0);                    
         }
         break;
-        case SSI_this1:
-        case SSI_this2:
-        case SSI_this3:
-        case SSI_this4:
-        case SSI_this5:
-        case SSI_this6:
-        case SSI_this7:
-        case SSI_this8:
-        case SSI_this9:
-        case SSI_this10:
-        case SSI_this11:
-        case SSI_this12:
-        case SSI_this13:
-        case SSI_this14:
-        case SSI_this15:
-        case SSI_this16:
-        case SSI_this17:
-        case SSI_this18:
-        case SSI_this19:
-        case SSI_this20: 
-        case SSI_this21:
-        case SSI_this22:
-        case SSI_this23:
-        case SSI_this24:
-        case SSI_this25:
-        case SSI_this26:
-        case SSI_this27:
-        case SSI_this28:
-        case SSI_this29:
-        case SSI_this30:
-        case SSI_this31:
-        case SSI_this32:
-        case SSI_this33:
-        case SSI_this34:
-        case SSI_this35:
-        case SSI_this36:
-        case SSI_this37:
-        case SSI_this38:
-        case SSI_this39:
-        case SSI_this40:
-        case SSI_this41:
-        case SSI_this42:
-        case SSI_this43:
-        case SSI_this44:
-        case SSI_this45:
-        case SSI_this46:
-        case SSI_this47:
-        case SSI_this48:
-        case SSI_this49:
-        case SSI_this50:
-        case SSI_this51:
-        case SSI_this52:
-        case SSI_this53:
-        case SSI_this54:
-        case SSI_this55:
-        case SSI_this56:
-        case SSI_this57:
-        case SSI_this58:
-        case SSI_this59:
-        case SSI_this60:
-        case SSI_this61:
-        case SSI_this62:
-        case SSI_this63:
-        case SSI_this64:
-        case SSI_this65:
-        case SSI_this66:
-        case SSI_this67:
-        case SSI_this68:
-        case SSI_this69:
-        case SSI_this70:
-        case SSI_this71:
-        case SSI_this72:
-        case SSI_this73:
-        case SSI_this74:
-        case SSI_this75:
-        case SSI_this76:
-        case SSI_this77:
-        case SSI_this78:
-        case SSI_this79:
-        case SSI_this80:
-        case SSI_this81:
-        case SSI_this82:
-        case SSI_this83:
-        case SSI_this84:
-        case SSI_this85:
-        case SSI_this86:
-        case SSI_this87:
-        case SSI_this88:
-        case SSI_this89:
-        case SSI_this90:
-        case SSI_this91:
-        case SSI_this92:
-        case SSI_this93:
-        case SSI_this94:
-        case SSI_this95:
-        case SSI_this96:
-        case SSI_this97:
-        case SSI_this98:
-        case SSI_this99:
-        case SSI_this100:                                       
-        // temperature history
-        {
-            printed = print_temperature_history(pcInsert, iInsertLen, (iIndex-SSI_this1)*4, 4);                                   
-        }         
-        break;   
         case SSI_disbri: // display brightness
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_display_brightness);
+            printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_display_brightness);
         }
         break;
         case SSI_ttma:  // thermostat temperature moving average
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.thermostat_temperature_moving_average);                           
+            web_snapshot_thermostat(&thermostat);
+            printed = ffmt_int(pcInsert, iInsertLen, thermostat.moving_average);                           
         }
         break;
         case SSI_ttgrd:  // thermostat temperature gradient
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.thermostat_temperature_gradient);                           
+            web_snapshot_thermostat(&thermostat);
+            printed = ffmt_int(pcInsert, iInsertLen, thermostat.gradient);                           
         }
         break;
         case SSI_ttpred:  // thermostat temperature prediction (samples until target reached)
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.thermostat_temperature_prediction);                           
+            web_snapshot_thermostat(&thermostat);
+            printed = ffmt_int(pcInsert, iInsertLen, thermostat.prediction);                           
         }
         break;    
         case SSI_disdig:  // display number of digits
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", config.thermostat_display_num_digits);                           
+            printed = ffmt_int(pcInsert, iInsertLen, config.thermostat_display_num_digits);                           
         }
         break;           
         
@@ -2798,12 +2600,74 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
         break;   
         case SSI_adcmin: // adc minimum value           
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.anemometer_adc_min); 
+            web_snapshot_wind(&wind);
+            printed = ffmt_int(pcInsert, iInsertLen, wind.adc_min); 
         }
         break;
         case SSI_adcmax: // adc maximum value           
         {
-            printed = snprintf(pcInsert, iInsertLen, "%d", web.anemometer_adc_max); 
+            web_snapshot_wind(&wind);
+            printed = ffmt_int(pcInsert, iInsertLen, wind.adc_max); 
+        }
+        break;
+        case SSI_csen: // clock sync enable
+        {
+            printed = snprintf(pcInsert, iInsertLen, "%s", config.clock_sync_enable?"checked":""); 
+        }
+        break;
+        case SSI_csip: // clock sync master ip address
+        {
+            printed = snprintf(pcInsert, iInsertLen, "%s", config.clock_sync_master_ip); 
+        }
+        break;
+        case SSI_csstat: // clock sync status
+        {
+            printed = clock_sync_status_string(pcInsert, iInsertLen); 
+        }
+        break;
+        case SSI_sfqd: // syslog queue depth
+        {
+            STORE_FORWARD_STATS_T stats;
+
+            store_forward_get_stats(&stats);
+            printed = snprintf(pcInsert, iInsertLen, "%lu messages, %lu bytes (high water %lu)", stats.queued, stats.queued_bytes, stats.high_water); 
+        }
+        break;
+        case SSI_sfdrop: // syslog messages dropped
+        {
+            STORE_FORWARD_STATS_T stats;
+
+            store_forward_get_stats(&stats);
+            printed = snprintf(pcInsert, iInsertLen, "%lu messages in %lu gaps", stats.dropped, stats.gaps); 
+        }
+        break;
+        case SSI_sfrply: // syslog messages replayed
+        {
+            STORE_FORWARD_STATS_T stats;
+
+            store_forward_get_stats(&stats);
+            printed = snprintf(pcInsert, iInsertLen, "%lu messages, %lu per second", stats.replayed, stats.replay_rate); 
+        }
+        break;
+        case SSI_sfspil: // syslog messages spilled to flash
+        {
+            STORE_FORWARD_STATS_T stats;
+
+            store_forward_get_stats(&stats);
+            printed = snprintf(pcInsert, iInsertLen, "%lu", stats.spilled); 
+        }
+        break;
+        case SSI_slstrs: // two core seqlock stress results (debug builds)
+        {
+            printed = seqlock_stress_status_string(pcInsert, iInsertLen); 
+        }
+        break;
+        case SSI_srlock: // tags httpd rendered while the render task held the lock
+        {
+            SSI_RENDER_STATS_T stats;
+
+            ssi_render_get_stats(&stats);
+            printed = snprintf(pcInsert, iInsertLen, "%lu waited, %lu left empty", (unsigned long)stats.tags_waited, (unsigned long)stats.tags_empty); 
         }
         break;                                                   
         default:
@@ -2817,10 +2681,84 @@ u16_t ssi_handler(int iIndex, char *pcInsert, int iInsertLen)
     return ((u16_t)printed);
 }
 
+/*!
+ * \brief Write the text that replaces a tag, the caller must hold the ssi render lock
+ *
+ * \param[in]  tag_name   tag found in page
+ * \param[out] insert     text to insert in place of tag
+ * \param[in]  length     size of insert
+ *
+ * \return number of characters inserted or -1 if the tag is unknown
+ */
+int ssi_insert(const char *tag_name, char *insert, int length)
+{
+    int index;
+    int printed;
+
+    index = ssi_tag_index(tag_name);
+
+    if (index < 0)
+    {
+        return(-1);
+    }
+
+    printed = ssi_handler(index, insert, length);
+
+    // handlers return what snprintf would have printed
+    if (printed >= length)
+    {
+        printed = length - 1;
+    }
+
+    return(printed);
+}
+
+/*!
+ * \brief SSI handler called by httpd with the tag name (LWIP_HTTPD_SSI_RAW) -- avoids a linear search of ssi_tags[]
+ *
+ * Pages are normally rendered by ssi_render.c, httpd only calls this for pages it serves from htmldata.c itself, which
+ * happens when the render task could not be started or memory ran out.  If the render task holds the render lock the
+ * tcpip thread waits up to SSI_RENDER_LOCK_WAIT_MS for it and leaves the tag empty after that.
+ *
+ * \param[in]  ssi_tag_name   tag found in page
+ * \param[out] pcInsert       text to insert in place of tag
+ * \param[in]  iInsertLen     size of pcInsert
+ *
+ * \return number of characters inserted or HTTPD_SSI_TAG_UNKNOWN
+ */
+#if LWIP_HTTPD_SSI_RAW
+u16_t ssi_raw_handler(const char *ssi_tag_name, char *pcInsert, int iInsertLen)
+{
+    int printed;
+
+    if (!ssi_render_lock_briefly())
+    {
+        return(0);
+    }
+
+    printed = ssi_insert(ssi_tag_name, pcInsert, iInsertLen);
+    ssi_render_unlock();
+
+    if (printed < 0)
+    {
+        return(HTTPD_SSI_TAG_UNKNOWN);
+    }
+
+    return(printed);
+}
+#endif
+
 void ssi_init(void)
 {
+    // start the task that renders pages off the tcpip thread
+    ssi_render_init();
+
     // configure SSI handler
+#if LWIP_HTTPD_SSI_RAW
+    http_set_ssi_handler(ssi_raw_handler, NULL, 0);
+#else
     http_set_ssi_handler(ssi_handler, ssi_tags, LWIP_ARRAYSIZE(ssi_tags));
+#endif
 }
 
 
@@ -6,6 +6,10 @@
 #ifndef SSI_H
 #define SSI_H
 
+extern const char *ssi_tags[];
+
 void ssi_init(void);
+int ssi_tag_index(const char *tag_name);
+int ssi_insert(const char *tag_name, char *insert, int length);
 
 #endif // SSI_H
\ No newline at end of file
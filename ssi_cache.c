@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "weather.h"
+#include "web_snapshot.h"
+#include "ssi_cache.h"
+#include "fixed_format.h"
+
+/*
+ * Formatted value cache for ssi
+ *
+ * The same few readings appear on most pages and every refresh used to repeat their unit conversion and printf.
+ * Here each value is formatted in both unit systems the first time it is asked for after its web variable group
+ * changes (tracked by the group's seqlock epoch) and later tags just copy the text.  A value is never formatted for
+ * a sample that no page shows, so producers pay nothing.  Output is identical to what ssi_handler() used to print,
+ * except that negative wind and rain now read e.g. "-0.5" rather than "0.-5".
+ *
+ * Only called from ssi_handler(), which is serialised by the ssi render lock, so the cache itself needs no locking.
+ */
+
+typedef struct
+{
+    char text[2][SSI_CACHE_TEXT_MAX];     // indexed by archaic units
+    int length[2];
+} SSI_CACHE_ENTRY_T;
+
+typedef struct
+{
+    bool valid;
+    uint32_t epoch;
+} SSI_CACHE_GROUP_T;
+
+// prototypes
+static void ssi_cache_refresh(WEB_GROUP_T group);
+static void ssi_cache_format_temperature(SSI_VALUE_T value, int temperature, bool convert);
+static void ssi_cache_format_wind(SSI_VALUE_T value, int speed);
+static void ssi_cache_format_rain(SSI_VALUE_T value, int rain);
+
+// group that each value is taken from
+static const WEB_GROUP_T value_group[NUM_SSI_VALUES] =
+{
+    WEB_GROUP_WIND,         // SSI_VALUE_ANEMOMETER_WIND
+    WEB_GROUP_WEATHER,      // SSI_VALUE_STATION_WIND
+    WEB_GROUP_WEATHER,      // SSI_VALUE_OUTSIDE_TEMPERATURE
+    WEB_GROUP_WEATHER,      // SSI_VALUE_RAIN_DAY
+    WEB_GROUP_WEATHER,      // SSI_VALUE_RAIN_WEEK
+    WEB_GROUP_WEATHER,      // SSI_VALUE_RAIN_SEVEN_DAYS
+    WEB_GROUP_THERMOSTAT,   // SSI_VALUE_THERMOSTAT_TEMPERATURE
+    WEB_GROUP_THERMOSTAT,   // SSI_VALUE_THERMOSTAT_SET_POINT
+};
+
+static SSI_CACHE_ENTRY_T entries[NUM_SSI_VALUES];
+static SSI_CACHE_GROUP_T groups[NUM_WEB_GROUPS];
+
+/*!
+ * \brief Copy a formatted value into an ssi insert buffer
+ *
+ * \param[in]   value             value to insert
+ * \param[in]   archaic_units     true for imperial units
+ * \param[out]  buffer            ssi insert buffer
+ * \param[in]   length            size of buffer
+ *
+ * \return characters inserted
+ */
+int ssi_cache_get(SSI_VALUE_T value, bool archaic_units, char *buffer, int length)
+{
+    WEB_GROUP_T group = value_group[value];
+    SSI_CACHE_ENTRY_T *entry = &entries[value];
+    int units = archaic_units ? 1 : 0;
+    int copy;
+
+    if (!groups[group].valid || (groups[group].epoch != web_epoch(group)))
+    {
+        ssi_cache_refresh(group);
+    }
+
+    copy = entry->length[units];
+    if (copy >= length)
+    {
+        copy = length - 1;
+    }
+
+    memcpy(buffer, entry->text[units], copy);
+    buffer[copy] = 0;
+
+    return(copy);
+}
+
+/*!
+ * \brief Format every value of a group from a fresh snapshot
+ *
+ * \param[in]   group     group that changed
+ *
+ * \return nothing
+ */
+static void ssi_cache_refresh(WEB_GROUP_T group)
+{
+    WEB_WIND_T wind;
+    WEB_WEATHER_T weather;
+    WEB_THERMOSTAT_T thermostat;
+
+    switch(group)
+    {
+        case WEB_GROUP_WIND:
+            groups[group].epoch = web_snapshot_wind(&wind);
+            ssi_cache_format_wind(SSI_VALUE_ANEMOMETER_WIND, wind.wind_speed);
+            break;
+        case WEB_GROUP_WEATHER:
+            groups[group].epoch = web_snapshot_weather(&weather);
+            ssi_cache_format_wind(SSI_VALUE_STATION_WIND, weather.wind_speed);
+            ssi_cache_format_temperature(SSI_VALUE_OUTSIDE_TEMPERATURE, weather.outside_temperature, true);
+            ssi_cache_format_rain(SSI_VALUE_RAIN_DAY, weather.daily_rain);
+            ssi_cache_format_rain(SSI_VALUE_RAIN_WEEK, weather.weekly_rain);
+            ssi_cache_format_rain(SSI_VALUE_RAIN_SEVEN_DAYS, weather.trailing_seven_days_rain);
+            break;
+        case WEB_GROUP_THERMOSTAT:
+            // thermostat already works in the configured units
+            groups[group].epoch = web_snapshot_thermostat(&thermostat);
+            ssi_cache_format_temperature(SSI_VALUE_THERMOSTAT_TEMPERATURE, thermostat.temperature, false);
+            ssi_cache_format_temperature(SSI_VALUE_THERMOSTAT_SET_POINT, thermostat.set_point, false);
+            break;
+        default:
+            return;
+    }
+
+    groups[group].valid = true;
+}
+
+/*!
+ * \brief Format a temperature in tenths, e.g. " 21.5" or "-3.0"
+ *
+ * \param[in]   value         cache entry
+ * \param[in]   temperature   tenths of a degree celsius, or of the configured units if not converting
+ * \param[in]   convert       true to convert to fahrenheit for archaic units
+ *
+ * \return nothing
+ */
+static void ssi_cache_format_temperature(SSI_VALUE_T value, int temperature, bool convert)
+{
+    SSI_CACHE_ENTRY_T *entry = &entries[value];
+    long fahrenheit = convert ? (temperature*9)/5 + 320 : temperature;
+
+    entry->length[0] = ffmt_fixed(entry->text[0], SSI_CACHE_TEXT_MAX, temperature, 1, ' ');
+    entry->length[1] = ffmt_fixed(entry->text[1], SSI_CACHE_TEXT_MAX, fahrenheit, 1, ' ');
+}
+
+/*!
+ * \brief Format a wind speed in tenths of m/s as m/s or ft/s
+ *
+ * \param[in]   value     cache entry
+ * \param[in]   speed     tenths of m/s
+ *
+ * \return nothing
+ */
+static void ssi_cache_format_wind(SSI_VALUE_T value, int speed)
+{
+    SSI_CACHE_ENTRY_T *entry = &entries[value];
+    long feet = (speed*3281 + 500)/1000;
+
+    entry->length[0] = ffmt_fixed(entry->text[0], SSI_CACHE_TEXT_MAX, speed, 1, 0);
+    entry->length[1] = ffmt_fixed(entry->text[1], SSI_CACHE_TEXT_MAX, feet, 1, 0);
+}
+
+/*!
+ * \brief Format rain in tenths of mm as mm or inches
+ *
+ * \param[in]   value     cache entry
+ * \param[in]   rain      tenths of mm
+ *
+ * \return nothing
+ */
+static void ssi_cache_format_rain(SSI_VALUE_T value, int rain)
+{
+    SSI_CACHE_ENTRY_T *entry = &entries[value];
+    long inches = (10*rain + 127)/254;
+
+    entry->length[0] = ffmt_fixed(entry->text[0], SSI_CACHE_TEXT_MAX, rain, 1, 0);
+    entry->length[1] = ffmt_fixed(entry->text[1], SSI_CACHE_TEXT_MAX, inches, 1, 0);
+}
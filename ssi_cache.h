@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SSI_CACHE_H
+#define SSI_CACHE_H
+
+#include <stdbool.h>
+
+#define SSI_CACHE_TEXT_MAX      (16)        // longest formatted value including nul terminator
+
+// values shown on many pages, formatted once per sample
+typedef enum
+{
+    SSI_VALUE_ANEMOMETER_WIND = 0,
+    SSI_VALUE_STATION_WIND,
+    SSI_VALUE_OUTSIDE_TEMPERATURE,
+    SSI_VALUE_RAIN_DAY,
+    SSI_VALUE_RAIN_WEEK,
+    SSI_VALUE_RAIN_SEVEN_DAYS,
+    SSI_VALUE_THERMOSTAT_TEMPERATURE,
+    SSI_VALUE_THERMOSTAT_SET_POINT,
+    NUM_SSI_VALUES
+} SSI_VALUE_T;
+
+int ssi_cache_get(SSI_VALUE_T value, bool archaic_units, char *buffer, int length);
+
+#endif
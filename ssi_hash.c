@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ssi.h"
+#include "generated/ssi_hash.h"
+
+// NB: this file must not depend on lwIP or the pico sdk so that tag lookup can be benchmarked on a linux host
+
+/*!
+ * \brief Find the index of an SSI tag using the minimal perfect hash generated by makessihash.py
+ *
+ * \param[in]  tag_name   tag found in page
+ *
+ * \return index into ssi_tags[] or -1 if not a known tag
+ */
+int ssi_tag_index(const char *tag_name)
+{
+    const char *c;
+    uint32_t h = 0x811C9DC5;
+    uint32_t slot;
+    int index;
+
+    // FNV-1a -- must match makessihash.py
+    for (c = tag_name; *c; c++)
+    {
+        h ^= (uint8_t)*c;
+        h *= 0x01000193;
+    }
+
+    // murmur3 finaliser of hash and bucket displacement -- must match makessihash.py
+    slot = h ^ (ssi_hash_displacement[h % SSI_HASH_BUCKETS] * 0x9E3779B1);
+    slot ^= slot >> 16;
+    slot *= 0x85EBCA6B;
+    slot ^= slot >> 13;
+    slot *= 0xC2B2AE35;
+    slot ^= slot >> 16;
+
+    index = ssi_hash_slot[slot % SSI_HASH_TAG_COUNT];
+
+    // every name hashes to some slot so confirm it is the right one
+    if (strcmp(tag_name, ssi_tags[index]))
+    {
+        index = -1;
+    }
+
+    return(index);
+}
@@ -0,0 +1,666 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/apps/httpd.h"
+#include "lwip/apps/fs.h"
+#include "lwip/mem.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "config.h"
+#include "ssi.h"
+#include "custom_files.h"
+#include "ssi_render.h"
+
+/*
+ * Rendering ssi pages off the tcpip thread
+ *
+ * httpd calls the ssi handler for every tag of a page on the tcpip thread, so a page with a hundred tags held up
+ * every other tcp and udp packet until it was done.  Every .shtml uri is now served as a custom file stream instead:
+ * opening it looks the page up in htmldata.c and hands it to the render task, which copies the page text and the text
+ * of each tag into the job's ring buffer and calls custom_files_notify().  The tcpip thread only copies rendered text
+ * into the tcp send buffer.  The render task stops when a buffer is full and carries on when httpd has taken some of
+ * it, so a slow client costs one buffer however large the page is.  httpd only scans files flagged FS_FILE_FLAGS_SSI
+ * for tags (LWIP_HTTPD_SSI_BY_FILE_EXTENSION is 0) and custom files never are, so the rendered text is sent as it is.
+ *
+ * Tags are parsed the way httpd parses them and produce the same text, including the unknown tag message.  When
+ * every job is busy the page is answered with a 503 that has the browser load it again a second later, so the tcpip
+ * thread never renders a page or waits for the render task.  httpd renders pages itself only if the render task
+ * could not be started or memory ran out.  ssi_handler() and ssi_cache.c are not reentrant so both paths hold the
+ * render lock while tags are being written.  The render task holds it for one buffer's worth of a page at most, so
+ * ssi_raw_handler() waits up to SSI_RENDER_LOCK_WAIT_MS for it and only leaves a tag empty if that runs out; both
+ * are counted on the debug page.
+ *
+ * Tags read strings from config, which cgi handlers change on the tcpip thread inside config_change_begin() and
+ * config_change_end().  Each tag is rendered inside config_read_begin() and config_read_retry() and rendered again
+ * if a handler ran meanwhile, so a page never shows a half written setting.
+ *
+ * The tcpip thread allocates a job (in_use) and is the only writer of read and closed.  The render task is the only
+ * writer of written and finished and is the one that frees the job once httpd has closed it.
+ */
+
+#define TAG_LEAD_IN_LENGTH      (sizeof(tag_lead_in) - 1)
+#define TAG_LEAD_OUT_LENGTH     (sizeof(tag_lead_out) - 1)
+#define BUSY_RESPONSE_MAX       (400)
+#define BUSY_URI_MAX            (64)
+
+typedef struct
+{
+    volatile bool in_use;                                   // set by the tcpip thread, cleared by the render task
+    volatile bool closed;                                   // httpd has finished with the page
+    volatile bool finished;                                 // the whole page has been rendered
+    volatile uint32_t written;                              // bytes rendered into the buffer so far
+    volatile uint32_t read;                                 // bytes taken from the buffer by httpd so far
+    struct fs_file page;                                    // page in htmldata.c
+    const char *position;                                   // next part of the page to render
+    int left;                                               // bytes of the page not yet rendered
+    const char *pending;                                    // page text or tag text waiting for space in the buffer
+    int pending_length;
+    uint32_t us_render;                                     // time spent rendering, excluding waits for the client
+    char insert[LWIP_HTTPD_MAX_TAG_INSERT_LEN + 1];
+    char buffer[SSI_RENDER_BUFFER];
+} SSI_RENDER_JOB_T;
+
+// 503 sent in place of a page while every job is busy
+typedef struct
+{
+    int length;
+    int sent;
+    char text[BUSY_RESPONSE_MAX];
+} SSI_RENDER_BUSY_T;
+
+// prototypes
+static void *ssi_render_busy(const char *name);
+static bool ssi_render_is_busy(void *state);
+static void ssi_render_task(void *params);
+static bool ssi_render_fill(SSI_RENDER_JOB_T *job);
+static void ssi_render_next(SSI_RENDER_JOB_T *job);
+static const char *ssi_render_find_tag(const char *text, int length);
+static int ssi_render_parse_tag(const char *text, int length, char *name);
+
+_Static_assert((SSI_RENDER_BUFFER & (SSI_RENDER_BUFFER - 1)) == 0, "SSI_RENDER_BUFFER must be a power of two");
+
+static const char tag_lead_in[] = "<!--#";
+static const char tag_lead_out[] = "-->";
+
+static SSI_RENDER_JOB_T jobs[SSI_RENDER_JOBS];
+static TaskHandle_t render_task = NULL;
+static SemaphoreHandle_t render_lock = NULL;
+static SSI_RENDER_STATS_T stats;
+
+// ssi_render_open() is looking the page up in htmldata.c itself, tcpip thread only
+static bool opening = false;
+
+/*!
+ * \brief Start the render task
+ *
+ * \return nothing
+ */
+void ssi_render_init(void)
+{
+    if (render_task)
+    {
+        return;
+    }
+
+    render_lock = xSemaphoreCreateMutex();
+
+    if (!render_lock ||
+        (xTaskCreate(ssi_render_task, "SSI Render Task", SSI_RENDER_TASK_STACK, NULL, SSI_RENDER_TASK_PRIORITY, &render_task) != pdPASS))
+    {
+        // httpd renders every page itself
+        printf("SSI render task could not be started\n");
+        render_task = NULL;
+    }
+}
+
+/*!
+ * \brief Take the lock that serialises ssi_handler(), for the tcpip thread which may only wait briefly
+ *
+ * \return true if the lock was taken, call ssi_render_unlock() when done
+ */
+bool ssi_render_lock_briefly(void)
+{
+    if (!render_lock)
+    {
+        return(true);
+    }
+
+    if (xSemaphoreTake(render_lock, 0) == pdTRUE)
+    {
+        return(true);
+    }
+
+    stats.tags_waited++;
+
+    if (xSemaphoreTake(render_lock, pdMS_TO_TICKS(SSI_RENDER_LOCK_WAIT_MS)) == pdTRUE)
+    {
+        return(true);
+    }
+
+    stats.tags_empty++;
+
+    return(false);
+}
+
+/*!
+ * \brief Release the lock that serialises ssi_handler()
+ *
+ * \return nothing
+ */
+void ssi_render_unlock(void)
+{
+    if (render_lock)
+    {
+        xSemaphoreGive(render_lock);
+    }
+}
+
+/*!
+ * \brief Get page rendering statistics
+ *
+ * \param[out]  stats_out     statistics
+ *
+ * \return nothing
+ */
+void ssi_render_get_stats(SSI_RENDER_STATS_T *stats_out)
+{
+    *stats_out = stats;
+}
+
+/*!
+ * \brief Start rendering a page, called by httpd on the tcpip thread
+ *
+ * \param[in]   name      requested uri
+ * \param[out]  length    unused, the rendered length is not known in advance
+ *
+ * \return job, 503 response or NULL to leave the page to httpd
+ */
+void *ssi_render_open(const char *name, int *length)
+{
+    SSI_RENDER_JOB_T *job = NULL;
+    err_t err;
+    int i;
+
+    if (opening || !render_task)
+    {
+        return(NULL);
+    }
+
+    for (i = 0; i < SSI_RENDER_JOBS; i++)
+    {
+        if (!jobs[i].in_use)
+        {
+            job = &jobs[i];
+            break;
+        }
+    }
+
+    if (!job)
+    {
+        *length = CUSTOM_FILE_NO_LENGTH;
+        return(ssi_render_busy(name));
+    }
+
+    // this lands back in ssi_render_open() which declines, so fs_open() finds the page in htmldata.c
+    opening = true;
+    err = fs_open(&job->page, name);
+    opening = false;
+
+    if (err != ERR_OK)
+    {
+        // httpd will not find it either and sends its 404 page
+        return(NULL);
+    }
+
+    job->closed = false;
+    job->finished = false;
+    job->written = 0;
+    job->read = 0;
+    job->position = job->page.data;
+    job->left = job->page.len;
+    job->pending = NULL;
+    job->pending_length = 0;
+    job->us_render = 0;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    job->in_use = true;
+
+    stats.deferred++;
+
+    xTaskNotifyGiveIndexed(render_task, 0);
+
+    *length = CUSTOM_FILE_NO_LENGTH;
+
+    return(job);
+}
+
+/*!
+ * \brief Check whether a page has rendered text to send, or has been sent completely
+ *
+ * \param[in]   state     job
+ *
+ * \return true if ssi_render_read() will return data or CUSTOM_FILE_EOF
+ */
+bool ssi_render_ready(void *state)
+{
+    SSI_RENDER_JOB_T *job = (SSI_RENDER_JOB_T *)state;
+
+    if (ssi_render_is_busy(state))
+    {
+        return(true);
+    }
+
+    return(job->finished || (job->written != job->read));
+}
+
+/*!
+ * \brief Copy rendered text into the tcp send buffer
+ *
+ * \param[in]   state     job
+ * \param[out]  buffer    destination
+ * \param[in]   count     size of destination
+ *
+ * \return bytes copied, 0 if nothing has been rendered yet or CUSTOM_FILE_EOF at the end of the page
+ */
+int ssi_render_read(void *state, char *buffer, int count)
+{
+    SSI_RENDER_JOB_T *job = (SSI_RENDER_JOB_T *)state;
+    SSI_RENDER_BUSY_T *busy = (SSI_RENDER_BUSY_T *)state;
+    bool finished;
+    uint32_t available;
+    int offset;
+    int chunk;
+
+    if (ssi_render_is_busy(state))
+    {
+        if (busy->sent == busy->length)
+        {
+            return(CUSTOM_FILE_EOF);
+        }
+
+        if (count > busy->length - busy->sent)
+        {
+            count = busy->length - busy->sent;
+        }
+
+        memcpy(buffer, busy->text + busy->sent, count);
+        busy->sent += count;
+
+        return(count);
+    }
+
+    finished = job->finished;
+
+    // finished is read first so that nothing written before it was set can be missed
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    available = job->written - job->read;
+
+    if (!available)
+    {
+        return(finished ? CUSTOM_FILE_EOF : 0);
+    }
+
+    if ((uint32_t)count > available)
+    {
+        count = available;
+    }
+
+    offset = job->read % SSI_RENDER_BUFFER;
+    chunk = count;
+    if (chunk > SSI_RENDER_BUFFER - offset)
+    {
+        chunk = SSI_RENDER_BUFFER - offset;
+    }
+
+    memcpy(buffer, job->buffer + offset, chunk);
+    memcpy(buffer + chunk, job->buffer, count - chunk);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    job->read += count;
+
+    if (!finished)
+    {
+        // there is room for more
+        xTaskNotifyGiveIndexed(render_task, 0);
+    }
+
+    return(count);
+}
+
+/*!
+ * \brief Finish with a page, the render task frees the job
+ *
+ * \param[in]   state     job
+ *
+ * \return nothing
+ */
+void ssi_render_close(void *state)
+{
+    SSI_RENDER_JOB_T *job = (SSI_RENDER_JOB_T *)state;
+
+    if (ssi_render_is_busy(state))
+    {
+        mem_free(state);
+        return;
+    }
+
+    fs_close(&job->page);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    job->closed = true;
+
+    xTaskNotifyGiveIndexed(render_task, 0);
+}
+
+/*!
+ * \brief Make the 503 response sent in place of a page while every job is busy
+ *
+ * \param[in]   name      requested uri, which the browser loads again a second later
+ *
+ * \return response, or NULL if there is no memory for it
+ */
+static void *ssi_render_busy(const char *name)
+{
+    SSI_RENDER_BUSY_T *busy;
+    const char *c;
+
+    busy = (SSI_RENDER_BUSY_T *)mem_malloc(sizeof(SSI_RENDER_BUSY_T));
+    if (!busy)
+    {
+        return(NULL);
+    }
+
+    // the uri goes into the page, anything that is not a plain path sends the browser to the home page instead
+    for (c = name; *c && (isalnum((unsigned char)*c) || strchr("/._-", *c)); c++);
+    if (*c || (c - name > BUSY_URI_MAX) || (name[0] != '/'))
+    {
+        name = "/";
+    }
+
+    busy->sent = 0;
+    busy->length = snprintf(busy->text, sizeof(busy->text),
+                            "HTTP/1.0 503 Service Unavailable\r\n"
+                            "Server: lwIP/pre-0.6 (http://www.sics.se/~adam/lwip/)\r\n"
+                            "Content-type: text/html\r\n"
+                            "Cache-Control: no-store\r\n"
+                            "Retry-After: 1\r\n"
+                            "\r\n"
+                            "<html><head><meta http-equiv=\"refresh\" content=\"1; url=%s\"></head><body>Busy, retrying</body></html>",
+                            name);
+
+    stats.declined++;
+
+    return(busy);
+}
+
+/*!
+ * \brief Tell a 503 response from a job
+ *
+ * \param[in]   state     job or 503 response
+ *
+ * \return true if state is a 503 response
+ */
+static bool ssi_render_is_busy(void *state)
+{
+    return(((uintptr_t)state < (uintptr_t)&jobs[0]) || ((uintptr_t)state > (uintptr_t)&jobs[SSI_RENDER_JOBS - 1]));
+}
+
+/*!
+ * \brief Render pages while their buffers have room, sleep until httpd opens, reads or closes a page
+ *
+ * \param[in]   params    unused
+ *
+ * \return nothing
+ */
+static void ssi_render_task(__unused void *params)
+{
+    SSI_RENDER_JOB_T *job;
+    bool progress;
+    int i;
+
+    while (true)
+    {
+        progress = false;
+
+        for (i = 0; i < SSI_RENDER_JOBS; i++)
+        {
+            job = &jobs[i];
+
+            if (!job->in_use)
+            {
+                continue;
+            }
+
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+            if (job->closed)
+            {
+                job->in_use = false;
+            }
+            else if (!job->finished && ssi_render_fill(job))
+            {
+                progress = true;
+            }
+        }
+
+        if (progress)
+        {
+            custom_files_notify();
+        }
+        else
+        {
+            // every notification given since the last wait is counted, so none can be lost
+            ulTaskNotifyTakeIndexed(0, pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+
+/*!
+ * \brief Render as much of a page as fits in its buffer
+ *
+ * \param[in]   job       page being rendered
+ *
+ * \return true if anything was rendered or the page was finished
+ */
+static bool ssi_render_fill(SSI_RENDER_JOB_T *job)
+{
+    uint64_t us_start = time_us_64();
+    uint32_t written = job->written;
+    uint32_t space;
+    bool progress = false;
+    int offset;
+    int chunk;
+
+    xSemaphoreTake(render_lock, portMAX_DELAY);
+
+    while ((space = SSI_RENDER_BUFFER - (written - job->read)) > 0)
+    {
+        if (!job->pending_length)
+        {
+            if (!job->left)
+            {
+                break;
+            }
+
+            ssi_render_next(job);
+            continue;
+        }
+
+        chunk = job->pending_length;
+        if ((uint32_t)chunk > space)
+        {
+            chunk = space;
+        }
+
+        offset = written % SSI_RENDER_BUFFER;
+        if (chunk > SSI_RENDER_BUFFER - offset)
+        {
+            chunk = SSI_RENDER_BUFFER - offset;
+        }
+
+        memcpy(job->buffer + offset, job->pending, chunk);
+        job->pending += chunk;
+        job->pending_length -= chunk;
+        written += chunk;
+    }
+
+    ssi_render_unlock();
+
+    job->us_render += time_us_64() - us_start;
+
+    if (written != job->written)
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        job->written = written;
+        progress = true;
+    }
+
+    if (!job->left && !job->pending_length)
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        job->finished = true;
+        progress = true;
+
+        if (job->us_render > stats.render_max_us)
+        {
+            stats.render_max_us = job->us_render;
+        }
+    }
+
+    return(progress);
+}
+
+/*!
+ * \brief Make the next part of the page pending: the text up to the next tag, or the text that replaces a tag
+ *
+ * \param[in]   job       page being rendered, with nothing pending
+ *
+ * \return nothing
+ */
+static void ssi_render_next(SSI_RENDER_JOB_T *job)
+{
+    char name[LWIP_HTTPD_MAX_TAG_NAME_LEN + 1];
+    const char *tag;
+    uint32_t start;
+    int tag_length;
+    int printed;
+
+    tag_length = ssi_render_parse_tag(job->position, job->left, name);
+
+    if (tag_length)
+    {
+        do
+        {
+            start = config_read_begin();
+            printed = ssi_insert(name, job->insert, LWIP_HTTPD_MAX_TAG_INSERT_LEN);
+        } while (config_read_retry(start));
+
+        if (printed < 0)
+        {
+            // same as httpd
+            printed = snprintf(job->insert, sizeof(job->insert), "<b>***UNKNOWN TAG %s***</b>", name);
+            if (printed >= (int)sizeof(job->insert))
+            {
+                printed = sizeof(job->insert) - 1;
+            }
+        }
+
+        job->pending = job->insert;
+        job->pending_length = printed;
+        job->position += tag_length;
+        job->left -= tag_length;
+        return;
+    }
+
+    // anything that only looks like a tag is sent as it is
+    tag = ssi_render_find_tag(job->position + 1, job->left - 1);
+
+    job->pending = job->position;
+    job->pending_length = tag ? tag - job->position : job->left;
+    job->position += job->pending_length;
+    job->left -= job->pending_length;
+}
+
+/*!
+ * \brief Find the start of the next tag
+ *
+ * \param[in]   text      page text
+ * \param[in]   length    bytes of text
+ *
+ * \return start of the tag lead in or NULL if there is none
+ */
+static const char *ssi_render_find_tag(const char *text, int length)
+{
+    const char *end = text + length;
+    const char *candidate;
+
+    while ((text < end) && (candidate = memchr(text, '<', end - text)))
+    {
+        if (((size_t)(end - candidate) >= TAG_LEAD_IN_LENGTH) && (memcmp(candidate, tag_lead_in, TAG_LEAD_IN_LENGTH) == 0))
+        {
+            return(candidate);
+        }
+
+        text = candidate + 1;
+    }
+
+    return(NULL);
+}
+
+/*!
+ * \brief Parse a tag such as <!--#temp-->, with optional whitespace around the name
+ *
+ * \param[in]   text      page text, starting with the tag if there is one
+ * \param[in]   length    bytes of text
+ * \param[out]  name      tag name, LWIP_HTTPD_MAX_TAG_NAME_LEN + 1 bytes
+ *
+ * \return length of the tag or 0 if text does not start with a complete tag
+ */
+static int ssi_render_parse_tag(const char *text, int length, char *name)
+{
+    const char *position = text + TAG_LEAD_IN_LENGTH;
+    const char *end = text + length;
+    int name_length = 0;
+
+    if (((size_t)length < TAG_LEAD_IN_LENGTH) || (memcmp(text, tag_lead_in, TAG_LEAD_IN_LENGTH) != 0))
+    {
+        return(0);
+    }
+
+    while ((position < end) && isspace((unsigned char)*position))
+    {
+        position++;
+    }
+
+    while ((position < end) && !isspace((unsigned char)*position) && (*position != '-') && (name_length < LWIP_HTTPD_MAX_TAG_NAME_LEN))
+    {
+        name[name_length++] = *position++;
+    }
+
+    name[name_length] = 0;
+
+    while ((position < end) && isspace((unsigned char)*position))
+    {
+        position++;
+    }
+
+    if (!name_length || ((size_t)(end - position) < TAG_LEAD_OUT_LENGTH) || (memcmp(position, tag_lead_out, TAG_LEAD_OUT_LENGTH) != 0))
+    {
+        return(0);
+    }
+
+    return(position + TAG_LEAD_OUT_LENGTH - text);
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SSI_RENDER_H
+#define SSI_RENDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SSI_RENDER_JOBS             (3)         // pages rendered at once, further pages are declined with a 503
+#define SSI_RENDER_BUFFER           (2048)      // rendered text held per page, a power of two
+#define SSI_RENDER_WINDOW           (1024)      // bytes httpd reads per send, also sizes its send buffer
+#define SSI_RENDER_TASK_STACK       (2048)      // words
+#define SSI_RENDER_TASK_PRIORITY    (tskIDLE_PRIORITY + 1UL)
+#define SSI_RENDER_LOCK_WAIT_MS     (20)        // longest the tcpip thread waits for the render task to finish a fill
+
+typedef struct
+{
+    uint32_t deferred;          // pages rendered by the render task
+    uint32_t declined;          // pages answered with a 503 because every job was busy
+    uint32_t render_max_us;     // longest time spent rendering one page, excluding waits for the client
+    uint32_t tags_waited;       // tags httpd rendered itself that waited for the render task to release the lock
+    uint32_t tags_empty;        // tags httpd rendered itself that were left empty because the lock stayed busy
+} SSI_RENDER_STATS_T;
+
+void ssi_render_init(void);
+bool ssi_render_lock_briefly(void);
+void ssi_render_unlock(void);
+void ssi_render_get_stats(SSI_RENDER_STATS_T *stats);
+
+// custom file serving every .shtml page
+void *ssi_render_open(const char *name, int *length);
+int ssi_render_read(void *state, char *buffer, int count);
+bool ssi_render_ready(void *state);
+void ssi_render_close(void *state);
+
+#endif
@@ -0,0 +1,840 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include <hardware/flash.h>
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "store_forward.h"
+
+/*
+ * Store and forward queue for outgoing messages
+ *
+ * Messages are sent immediately while the peer is reachable.  Once a send fails, that message and every later one
+ * is queued so that ordering is preserved, and store_forward_service() replays the queue at a limited rate once the
+ * peer is reachable again.  When the queue is full the oldest messages are discarded and a gap marker is sent in
+ * their place during replay.  Optionally the oldest messages are spilled from ram to a ring of flash sectors, which
+ * also survive a reboot.
+ *
+ * The mutex only guards the queue.  Sending can block for a long time (syslog_transmit() may look up the server
+ * name) so one task at a time owns the link and sends with the mutex released, while other tasks submitting
+ * meanwhile queue their messages behind it and return at once.  A direct send that fails is put back in front of
+ * anything queued while it was in flight, and whoever owns the link after a direct send passes on what was queued
+ * behind it.
+ */
+
+#define STORE_FORWARD_LENGTH_BYTES      (2)         // each queued message is preceded by its length
+
+#if STORE_FORWARD_FLASH_SECTORS
+#define STORE_FORWARD_FLASH_OFFSET      (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE*(1 + STORE_FORWARD_FLASH_SECTORS))
+#define STORE_FORWARD_FLASH_MAGIC       (0x31574653)    // "SFW1"
+#define STORE_FORWARD_FLASH_PENDING     (0xFFFFFFFF)    // erased value, sector not yet replayed
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;          // increments with every sector written so that order survives a reboot
+    uint32_t records;
+    uint32_t bytes;             // bytes of records following this header
+    uint32_t replayed;          // programmed to zero once replayed -- no erase needed
+} STORE_FORWARD_SECTOR_T;
+
+typedef struct
+{
+    uint32_t offset;
+    const uint8_t *data;
+    uint32_t length;
+    bool erase;
+} STORE_FORWARD_FLASH_OP_T;
+#endif
+
+typedef struct
+{
+    SemaphoreHandle_t mutex;
+    STORE_FORWARD_SEND_T send;
+    STORE_FORWARD_GAP_T gap;
+
+    uint8_t ram[STORE_FORWARD_RAM_BYTES];
+    int ram_head;                               // offset of oldest message
+    int ram_used;                               // bytes in use
+    uint32_t ram_records;
+
+#if STORE_FORWARD_FLASH_SECTORS
+    int flash_head;                             // sector holding oldest message
+    int flash_count;                            // sectors holding messages
+    uint32_t flash_read_offset;                 // offset of oldest message within head sector
+    uint32_t flash_head_remaining;              // messages not yet replayed from head sector
+    uint32_t flash_records;
+    uint32_t flash_bytes;
+    uint32_t flash_sequence;
+#endif
+
+    uint32_t lost;                              // messages discarded immediately before the oldest queued message
+    uint32_t removed;                           // messages popped or discarded from the front, ever
+    bool sending;                               // a task owns the link and is sending with the mutex released
+    char replay[STORE_FORWARD_MESSAGE_MAX];     // copy of the oldest message, only used by the task owning the link
+    TickType_t rate_tick;
+    uint32_t rate_count;
+    STORE_FORWARD_STATS_T stats;
+} STORE_FORWARD_T;
+
+// prototypes
+static bool store_forward_empty(void);
+static int store_forward_enqueue(const char *message, int length);
+static void store_forward_requeue(const char *message, int length);
+static int store_forward_send_oldest(void);
+static uint32_t store_forward_backlog(void);
+static int store_forward_peek(char *message);
+static void store_forward_pop(void);
+static void store_forward_discard_oldest(void);
+static void store_forward_ram_copy_in(int offset, const uint8_t *data, int length);
+static void store_forward_ram_copy_out(int offset, uint8_t *data, int length);
+static int store_forward_ram_length(int offset);
+#if STORE_FORWARD_FLASH_SECTORS
+static void store_forward_flash_recover(void);
+static int store_forward_flash_spill(void);
+static void store_forward_flash_retire_head(void);
+static void store_forward_flash_load_head(void);
+static const uint8_t *store_forward_flash_sector(int sector);
+static void store_forward_flash_shim(void *ptr);
+#endif
+
+// static variables
+static STORE_FORWARD_T sf;
+#if STORE_FORWARD_FLASH_SECTORS
+static uint8_t sf_staging[FLASH_SECTOR_SIZE];
+#endif
+
+/*!
+ * \brief Initialise the queue -- must be called before tasks that submit messages are started
+ *
+ * \param[in]  send   transmits one message
+ * \param[in]  gap    transmits a gap marker
+ *
+ * \return nothing
+ */
+void store_forward_init(STORE_FORWARD_SEND_T send, STORE_FORWARD_GAP_T gap)
+{
+    memset(&sf, 0, sizeof(sf));
+
+    sf.send = send;
+    sf.gap = gap;
+    sf.rate_tick = xTaskGetTickCount();
+
+#if STORE_FORWARD_FLASH_SECTORS
+    store_forward_flash_recover();
+#endif
+
+    sf.mutex = xSemaphoreCreateMutex();
+}
+
+/*!
+ * \brief Send a message now or queue it if the peer is unreachable or earlier messages are still queued
+ *
+ * \param[in]  message   message to send
+ * \param[in]  length    length of message, truncated to STORE_FORWARD_MESSAGE_MAX
+ *
+ * \return bytes sent, 0 if queued, -1 if not initialised
+ */
+int store_forward_submit(const char *message, int length)
+{
+    int sent = -1;
+    uint32_t backlog;
+
+    if (length > STORE_FORWARD_MESSAGE_MAX)
+    {
+        length = STORE_FORWARD_MESSAGE_MAX;
+    }
+
+    if (!sf.mutex)
+    {
+        return(-1);
+    }
+
+    xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+    sf.stats.submitted++;
+
+    // never overtake queued messages or one being sent
+    if (store_forward_empty() && !sf.sending)
+    {
+        sf.sending = true;
+        xSemaphoreGive(sf.mutex);
+
+        sent = sf.send(message, length);
+
+        xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+        if (sent >= 0)
+        {
+            sf.stats.sent_direct++;
+
+            // pass on what other tasks queued while the link was busy, but not more than that
+            backlog = store_forward_backlog();
+            while (backlog-- && !store_forward_empty())
+            {
+                if (store_forward_send_oldest() < 0)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            store_forward_requeue(message, length);
+            sent = 0;
+        }
+
+        sf.sending = false;
+    }
+    else
+    {
+        store_forward_enqueue(message, length);
+        sent = 0;
+    }
+
+    xSemaphoreGive(sf.mutex);
+
+    return(sent);
+}
+
+/*!
+ * \brief Replay queued messages at a limited rate -- call about once per second
+ *
+ * \return nothing
+ */
+void store_forward_service(void)
+{
+    TickType_t tick_now;
+
+    if (!sf.mutex)
+    {
+        return;
+    }
+
+    xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+    tick_now = xTaskGetTickCount();
+    if ((tick_now - sf.rate_tick) >= pdMS_TO_TICKS(1000))
+    {
+        sf.stats.replay_rate = sf.rate_count;
+        sf.rate_count = 0;
+        sf.rate_tick = tick_now;
+    }
+
+    // a task sending directly passes on the queue itself
+    if (!sf.sending)
+    {
+        sf.sending = true;
+
+        while (!store_forward_empty() && (sf.rate_count < STORE_FORWARD_REPLAY_PER_SECOND))
+        {
+            if (store_forward_send_oldest() < 0)
+            {
+                break;
+            }
+
+            sf.rate_count++;
+        }
+
+        sf.sending = false;
+    }
+
+    xSemaphoreGive(sf.mutex);
+}
+
+/*!
+ * \brief Get queue statistics
+ *
+ * \param[out] stats   statistics
+ *
+ * \return nothing
+ */
+void store_forward_get_stats(STORE_FORWARD_STATS_T *stats)
+{
+    if (!sf.mutex)
+    {
+        memset(stats, 0, sizeof(STORE_FORWARD_STATS_T));
+        return;
+    }
+
+    xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+    *stats = sf.stats;
+    stats->queued = sf.ram_records;
+    stats->queued_bytes = sf.ram_used;
+#if STORE_FORWARD_FLASH_SECTORS
+    stats->queued += sf.flash_records;
+    stats->queued_bytes += sf.flash_bytes;
+#endif
+
+    xSemaphoreGive(sf.mutex);
+}
+
+/*!
+ * \brief Check if anything is waiting to be replayed
+ *
+ * \return true if nothing queued
+ */
+static bool store_forward_empty(void)
+{
+    bool empty;
+
+    empty = (sf.ram_records == 0) && (sf.lost == 0);
+#if STORE_FORWARD_FLASH_SECTORS
+    empty = empty && (sf.flash_records == 0);
+#endif
+
+    return(empty);
+}
+
+/*!
+ * \brief Send the gap marker or oldest message with the mutex released -- mutex held and link owned by the caller
+ *
+ * \return 0 if sent and removed from the queue, -1 if the link or peer is down
+ */
+static int store_forward_send_oldest(void)
+{
+    uint32_t lost;
+    uint32_t removed;
+    int length;
+    int result;
+
+    if (sf.lost)
+    {
+        lost = sf.lost;
+
+        xSemaphoreGive(sf.mutex);
+        result = sf.gap(lost);
+        xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+        if (result < 0)
+        {
+            return(-1);
+        }
+
+        // more may have been discarded meanwhile, they follow the marker just sent
+        sf.lost -= lost;
+        sf.stats.gaps++;
+
+        return(0);
+    }
+
+    length = store_forward_peek(sf.replay);
+    removed = sf.removed;
+
+    xSemaphoreGive(sf.mutex);
+    result = sf.send(sf.replay, length);
+    xSemaphoreTake(sf.mutex, portMAX_DELAY);
+
+    if (result < 0)
+    {
+        return(-1);
+    }
+
+    if (sf.removed == removed)
+    {
+        store_forward_pop();
+    }
+    else
+    {
+        // discarded to make room while it was being sent, so it is the first of the lost messages and was not lost
+        sf.lost--;
+        sf.stats.dropped--;
+    }
+    sf.stats.replayed++;
+
+    return(0);
+}
+
+/*!
+ * \brief Count the messages and gap marker waiting to be sent
+ *
+ * \return number of sends needed to empty the queue
+ */
+static uint32_t store_forward_backlog(void)
+{
+    uint32_t backlog;
+
+    backlog = sf.ram_records + (sf.lost ? 1 : 0);
+#if STORE_FORWARD_FLASH_SECTORS
+    backlog += sf.flash_records;
+#endif
+
+    return(backlog);
+}
+
+/*!
+ * \brief Add message to the ram queue, making room by spilling or discarding the oldest messages
+ *
+ * \param[in]  message   message
+ * \param[in]  length    length of message
+ *
+ * \return 0 on success
+ */
+static int store_forward_enqueue(const char *message, int length)
+{
+    uint8_t header[STORE_FORWARD_LENGTH_BYTES];
+    uint32_t queued;
+
+    while (sf.ram_used + STORE_FORWARD_LENGTH_BYTES + length > STORE_FORWARD_RAM_BYTES)
+    {
+#if STORE_FORWARD_FLASH_SECTORS
+        if (store_forward_flash_spill() == 0)
+        {
+            continue;
+        }
+#endif
+        store_forward_discard_oldest();
+    }
+
+    header[0] = (uint8_t)length;
+    header[1] = (uint8_t)(length >> 8);
+
+    store_forward_ram_copy_in(sf.ram_head + sf.ram_used, header, STORE_FORWARD_LENGTH_BYTES);
+    store_forward_ram_copy_in(sf.ram_head + sf.ram_used + STORE_FORWARD_LENGTH_BYTES, (const uint8_t *)message, length);
+    sf.ram_used += STORE_FORWARD_LENGTH_BYTES + length;
+    sf.ram_records++;
+
+    queued = sf.ram_records;
+#if STORE_FORWARD_FLASH_SECTORS
+    queued += sf.flash_records;
+#endif
+    if (queued > sf.stats.high_water)
+    {
+        sf.stats.high_water = queued;
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Put a message whose direct send failed in front of any queued while it was being sent
+ *
+ * \param[in]  message   message
+ * \param[in]  length    length of message
+ *
+ * \return nothing
+ */
+static void store_forward_requeue(const char *message, int length)
+{
+    uint8_t header[STORE_FORWARD_LENGTH_BYTES];
+    bool room;
+
+    if (store_forward_empty())
+    {
+        store_forward_enqueue(message, length);
+        return;
+    }
+
+    // only the ram queue can be added to at the front
+    room = (sf.lost == 0) && (sf.ram_used + STORE_FORWARD_LENGTH_BYTES + length <= STORE_FORWARD_RAM_BYTES);
+#if STORE_FORWARD_FLASH_SECTORS
+    room = room && (sf.flash_records == 0);
+#endif
+
+    if (!room)
+    {
+        // it is older than anything queued so it is lost ahead of the queue
+        sf.lost++;
+        sf.stats.dropped++;
+        return;
+    }
+
+    header[0] = (uint8_t)length;
+    header[1] = (uint8_t)(length >> 8);
+
+    sf.ram_head = (sf.ram_head + STORE_FORWARD_RAM_BYTES - STORE_FORWARD_LENGTH_BYTES - length) % STORE_FORWARD_RAM_BYTES;
+    store_forward_ram_copy_in(sf.ram_head, header, STORE_FORWARD_LENGTH_BYTES);
+    store_forward_ram_copy_in(sf.ram_head + STORE_FORWARD_LENGTH_BYTES, (const uint8_t *)message, length);
+    sf.ram_used += STORE_FORWARD_LENGTH_BYTES + length;
+    sf.ram_records++;
+}
+
+/*!
+ * \brief Copy oldest queued message
+ *
+ * \param[out] message   buffer of at least STORE_FORWARD_MESSAGE_MAX bytes
+ *
+ * \return length of message
+ */
+static int store_forward_peek(char *message)
+{
+    int length;
+
+#if STORE_FORWARD_FLASH_SECTORS
+    const uint8_t *record;
+
+    if (sf.flash_records)
+    {
+        record = store_forward_flash_sector(sf.flash_head) + sf.flash_read_offset;
+        length = record[0] | (record[1] << 8);
+        memcpy(message, record + STORE_FORWARD_LENGTH_BYTES, length);
+
+        return(length);
+    }
+#endif
+
+    length = store_forward_ram_length(sf.ram_head);
+    store_forward_ram_copy_out(sf.ram_head + STORE_FORWARD_LENGTH_BYTES, (uint8_t *)message, length);
+
+    return(length);
+}
+
+/*!
+ * \brief Remove oldest queued message
+ *
+ * \return nothing
+ */
+static void store_forward_pop(void)
+{
+    int length;
+
+#if STORE_FORWARD_FLASH_SECTORS
+    const uint8_t *record;
+
+    if (sf.flash_records)
+    {
+        record = store_forward_flash_sector(sf.flash_head) + sf.flash_read_offset;
+        length = record[0] | (record[1] << 8);
+
+        sf.flash_read_offset += STORE_FORWARD_LENGTH_BYTES + length;
+        sf.flash_bytes -= STORE_FORWARD_LENGTH_BYTES + length;
+        sf.flash_records--;
+        sf.removed++;
+
+        if (--sf.flash_head_remaining == 0)
+        {
+            store_forward_flash_retire_head();
+        }
+        return;
+    }
+#endif
+
+    length = store_forward_ram_length(sf.ram_head);
+    sf.ram_head = (sf.ram_head + STORE_FORWARD_LENGTH_BYTES + length) % STORE_FORWARD_RAM_BYTES;
+    sf.ram_used -= STORE_FORWARD_LENGTH_BYTES + length;
+    sf.ram_records--;
+    sf.removed++;
+}
+
+/*!
+ * \brief Discard the oldest queued messages to make room, a gap marker will be sent in their place
+ *
+ * \return nothing
+ */
+static void store_forward_discard_oldest(void)
+{
+#if STORE_FORWARD_FLASH_SECTORS
+    const STORE_FORWARD_SECTOR_T *header;
+    uint32_t discarded;
+
+    if (sf.flash_records)
+    {
+        // a whole sector at a time
+        header = (const STORE_FORWARD_SECTOR_T *)store_forward_flash_sector(sf.flash_head);
+        discarded = sf.flash_head_remaining;
+        sf.flash_records -= discarded;
+        sf.flash_bytes -= sizeof(STORE_FORWARD_SECTOR_T) + header->bytes - sf.flash_read_offset;
+        store_forward_flash_retire_head();
+
+        sf.removed += discarded;
+        sf.lost += discarded;
+        sf.stats.dropped += discarded;
+        return;
+    }
+#endif
+
+    if (sf.ram_records)
+    {
+        store_forward_pop();
+        sf.lost++;
+        sf.stats.dropped++;
+    }
+}
+
+/*!
+ * \brief Copy into ram queue handling wrap around
+ *
+ * \param[in]  offset   position in queue, may exceed queue size
+ * \param[in]  data     data to copy
+ * \param[in]  length   number of bytes
+ *
+ * \return nothing
+ */
+static void store_forward_ram_copy_in(int offset, const uint8_t *data, int length)
+{
+    int first;
+
+    offset %= STORE_FORWARD_RAM_BYTES;
+    first = STORE_FORWARD_RAM_BYTES - offset;
+    if (first > length) first = length;
+
+    memcpy(&(sf.ram[offset]), data, first);
+    memcpy(sf.ram, data + first, length - first);
+}
+
+/*!
+ * \brief Copy out of ram queue handling wrap around
+ *
+ * \param[in]  offset   position in queue, may exceed queue size
+ * \param[out] data     destination
+ * \param[in]  length   number of bytes
+ *
+ * \return nothing
+ */
+static void store_forward_ram_copy_out(int offset, uint8_t *data, int length)
+{
+    int first;
+
+    offset %= STORE_FORWARD_RAM_BYTES;
+    first = STORE_FORWARD_RAM_BYTES - offset;
+    if (first > length) first = length;
+
+    memcpy(data, &(sf.ram[offset]), first);
+    memcpy(data + first, sf.ram, length - first);
+}
+
+/*!
+ * \brief Get length of message stored in ram queue
+ *
+ * \param[in]  offset   position of message length in queue
+ *
+ * \return length of message excluding length bytes
+ */
+static int store_forward_ram_length(int offset)
+{
+    uint8_t header[STORE_FORWARD_LENGTH_BYTES];
+
+    store_forward_ram_copy_out(offset, header, STORE_FORWARD_LENGTH_BYTES);
+
+    return(header[0] | (header[1] << 8));
+}
+
+#if STORE_FORWARD_FLASH_SECTORS
+/*!
+ * \brief Find sectors left unreplayed before a reboot
+ *
+ * \return nothing
+ */
+static void store_forward_flash_recover(void)
+{
+    const STORE_FORWARD_SECTOR_T *header;
+    uint32_t oldest = UINT32_MAX;
+    int sector;
+    int i;
+
+    sf.flash_head = 0;
+    sf.flash_count = 0;
+
+    // find the oldest pending sector
+    for (sector = 0; sector < STORE_FORWARD_FLASH_SECTORS; sector++)
+    {
+        header = (const STORE_FORWARD_SECTOR_T *)store_forward_flash_sector(sector);
+
+        if (header->magic == STORE_FORWARD_FLASH_MAGIC)
+        {
+            if (header->sequence >= sf.flash_sequence)
+            {
+                sf.flash_sequence = header->sequence + 1;
+            }
+
+            if ((header->replayed == STORE_FORWARD_FLASH_PENDING) && (header->sequence < oldest))
+            {
+                oldest = header->sequence;
+                sf.flash_head = sector;
+            }
+        }
+    }
+
+    if (oldest == UINT32_MAX)
+    {
+        return;
+    }
+
+    // sectors are written in ring order so pending ones follow the oldest
+    for (i = 0; i < STORE_FORWARD_FLASH_SECTORS; i++)
+    {
+        header = (const STORE_FORWARD_SECTOR_T *)store_forward_flash_sector((sf.flash_head + i) % STORE_FORWARD_FLASH_SECTORS);
+
+        if ((header->magic != STORE_FORWARD_FLASH_MAGIC) || (header->replayed != STORE_FORWARD_FLASH_PENDING) ||
+            (header->sequence != oldest + i) || (header->bytes > FLASH_SECTOR_SIZE - sizeof(STORE_FORWARD_SECTOR_T)))
+        {
+            break;
+        }
+
+        sf.flash_count++;
+        sf.flash_records += header->records;
+        sf.flash_bytes += header->bytes;
+    }
+
+    store_forward_flash_load_head();
+
+    printf("store and forward recovered %lu messages from flash\n", (unsigned long)sf.flash_records);
+}
+
+/*!
+ * \brief Move the oldest ram messages into the next flash sector
+ *
+ * \return 0 on success, -1 if nothing could be moved
+ */
+static int store_forward_flash_spill(void)
+{
+    STORE_FORWARD_SECTOR_T *header;
+    STORE_FORWARD_FLASH_OP_T op;
+    int offset;
+    int length;
+    uint32_t records = 0;
+    uint32_t bytes = 0;
+    int sector;
+
+    // the ring is full so the oldest sector has to go
+    if (sf.flash_count == STORE_FORWARD_FLASH_SECTORS)
+    {
+        store_forward_discard_oldest();
+    }
+
+    memset(sf_staging, 0xFF, sizeof(sf_staging));
+
+    // pack as many whole messages as fit without removing them from ram until the write succeeds
+    offset = sf.ram_head;
+    while (records < sf.ram_records)
+    {
+        length = STORE_FORWARD_LENGTH_BYTES + store_forward_ram_length(offset);
+
+        if (sizeof(STORE_FORWARD_SECTOR_T) + bytes + length > FLASH_SECTOR_SIZE)
+        {
+            break;
+        }
+
+        store_forward_ram_copy_out(offset, sf_staging + sizeof(STORE_FORWARD_SECTOR_T) + bytes, length);
+        offset = (offset + length) % STORE_FORWARD_RAM_BYTES;
+        bytes += length;
+        records++;
+    }
+
+    if (records == 0)
+    {
+        return(-1);
+    }
+
+    header = (STORE_FORWARD_SECTOR_T *)sf_staging;
+    header->magic = STORE_FORWARD_FLASH_MAGIC;
+    header->sequence = sf.flash_sequence;
+    header->records = records;
+    header->bytes = bytes;
+    header->replayed = STORE_FORWARD_FLASH_PENDING;
+
+    sector = (sf.flash_head + sf.flash_count) % STORE_FORWARD_FLASH_SECTORS;
+
+    op.offset = STORE_FORWARD_FLASH_OFFSET + sector*FLASH_SECTOR_SIZE;
+    op.data = sf_staging;
+    op.length = ((sizeof(STORE_FORWARD_SECTOR_T) + bytes + FLASH_PAGE_SIZE - 1)/FLASH_PAGE_SIZE)*FLASH_PAGE_SIZE;
+    op.erase = true;
+
+    if (flash_safe_execute(store_forward_flash_shim, &op, 500))
+    {
+        return(-1);
+    }
+
+    // now safe to release the ram
+    sf.ram_head = offset;
+    sf.ram_used -= bytes;
+    sf.ram_records -= records;
+
+    sf.flash_sequence++;
+    sf.flash_count++;
+    sf.flash_records += records;
+    sf.flash_bytes += bytes;
+    sf.stats.spilled += records;
+
+    if (sf.flash_count == 1)
+    {
+        store_forward_flash_load_head();
+    }
+
+    return(0);
+}
+
+/*!
+ * \brief Mark head sector as replayed and move on to the next
+ *
+ * \return nothing
+ */
+static void store_forward_flash_retire_head(void)
+{
+    uint8_t page[FLASH_PAGE_SIZE];
+    STORE_FORWARD_FLASH_OP_T op;
+
+    // clearing bits does not need an erase so reprogram the first page with the replayed flag cleared
+    memcpy(page, store_forward_flash_sector(sf.flash_head), FLASH_PAGE_SIZE);
+    ((STORE_FORWARD_SECTOR_T *)page)->replayed = 0;
+
+    op.offset = STORE_FORWARD_FLASH_OFFSET + sf.flash_head*FLASH_SECTOR_SIZE;
+    op.data = page;
+    op.length = FLASH_PAGE_SIZE;
+    op.erase = false;
+
+    flash_safe_execute(store_forward_flash_shim, &op, 500);
+
+    sf.flash_head = (sf.flash_head + 1) % STORE_FORWARD_FLASH_SECTORS;
+    sf.flash_count--;
+
+    store_forward_flash_load_head();
+}
+
+/*!
+ * \brief Set up read position for the head sector
+ *
+ * \return nothing
+ */
+static void store_forward_flash_load_head(void)
+{
+    sf.flash_read_offset = sizeof(STORE_FORWARD_SECTOR_T);
+    sf.flash_head_remaining = 0;
+
+    if (sf.flash_count)
+    {
+        sf.flash_head_remaining = ((const STORE_FORWARD_SECTOR_T *)store_forward_flash_sector(sf.flash_head))->records;
+    }
+}
+
+/*!
+ * \brief Get memory mapped address of a spill sector
+ *
+ * \param[in]  sector   sector index
+ *
+ * \return pointer into XIP flash
+ */
+static const uint8_t *store_forward_flash_sector(int sector)
+{
+    return((const uint8_t *)(XIP_BASE + STORE_FORWARD_FLASH_OFFSET + sector*FLASH_SECTOR_SIZE));
+}
+
+/*!
+ * \brief Shim for writing flash with interrupts disabled
+ *
+ * \param[in]   ptr  STORE_FORWARD_FLASH_OP_T describing the write -- for compatibility with flash_safe_execute()
+ */
+static void store_forward_flash_shim(void *ptr)
+{
+    STORE_FORWARD_FLASH_OP_T *op = (STORE_FORWARD_FLASH_OP_T *)ptr;
+
+    if (op->erase)
+    {
+        flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+    }
+
+    flash_range_program(op->offset, op->data, op->length);
+}
+#endif
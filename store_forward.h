@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef STORE_FORWARD_H
+#define STORE_FORWARD_H
+
+#define STORE_FORWARD_RAM_BYTES         (8192)      // ram queue size, each message costs its length plus 2 bytes
+#define STORE_FORWARD_MESSAGE_MAX       (200)       // longest message accepted (same as syslog buffer)
+#define STORE_FORWARD_REPLAY_PER_SECOND (10)        // catch up rate once the peer is reachable again
+#ifndef STORE_FORWARD_FLASH_SECTORS
+#define STORE_FORWARD_FLASH_SECTORS     (0)         // set non-zero to spill to flash sectors below the configuration sector
+#endif
+
+// returns bytes sent, or negative if the link or peer is down
+typedef int (*STORE_FORWARD_SEND_T)(const char *message, int length);
+
+// sends a marker in place of messages that were discarded, returns negative if the link or peer is down
+typedef int (*STORE_FORWARD_GAP_T)(uint32_t lost);
+
+typedef struct
+{
+    uint32_t queued;            // messages currently held (ram and flash)
+    uint32_t queued_bytes;
+    uint32_t high_water;        // most messages ever held at once
+    uint32_t submitted;
+    uint32_t sent_direct;       // sent immediately without queueing
+    uint32_t replayed;          // sent from the queue after an outage
+    uint32_t dropped;           // discarded because the queue was full
+    uint32_t gaps;              // gap markers sent
+    uint32_t spilled;           // messages moved from ram to flash
+    uint32_t replay_rate;       // messages replayed during the last second
+} STORE_FORWARD_STATS_T;
+
+void store_forward_init(STORE_FORWARD_SEND_T send, STORE_FORWARD_GAP_T gap);
+int store_forward_submit(const char *message, int length);
+void store_forward_service(void);
+void store_forward_get_stats(STORE_FORWARD_STATS_T *stats);
+
+#endif
@@ -22,6 +22,7 @@
 #define SETPOINT_TEMP_DEFAULT_F          (700)
 #define DISPLAY_MAX_BRIGHTNESS           (7)
 #define TEMPERATURE_INVALID              (2000)
+#define SIZE_CLIMATE_HISTORY             (100)      // samples kept for the history graph
 
 typedef enum
 {
@@ -81,7 +82,7 @@ void mark_hvac_off(CLIMATE_LAG_T lag_type, long int temperaturex10);
 void track_hvac_extrema(CLIMATE_LAG_T lag_type, long int temperaturex10);
 void set_hvac_lag(CLIMATE_LAG_T lag_type);
 void log_climate_change(int temperaturex10, int humidityx10);
-int print_temperature_history(char *buffer, int length, int start_position, int num_data_points);
+int copy_temperature_history(uint32_t *unix_time, int16_t *temperaturex10, int max_points);
 int predicted_time_to_temperature(long int target_temperature);
 int filter_temperature_noise(long int temperaturex10);
 
@@ -21,6 +21,7 @@
 #include "thermostat.h"
 #include "hc_task.h"
 #include "discovery_task.h"
+#include "powerwall.h"
 
 // worker tasks to launch and monitor
 WORKER_TASK_T worker_tasks[] =
@@ -28,6 +29,7 @@ WORKER_TASK_T worker_tasks[] =
     //  function        name                    stack   priority        
 #ifdef INCORPORATE_THERMOSTAT    
     {   thermostat_task,"Thermostat Task",      8096,   5},       
+    {   powerwall_task, "Powerwall Task",       2048,   2},
 #endif
 
     // end of table
@@ -42,6 +42,7 @@
 #include "powerwall.h"
 #include "pluto.h"
 #include "tm1637.h"
+#include "web_snapshot.h"
 
 typedef struct
 {
@@ -133,7 +134,9 @@ THERMOSTAT_STATE_T control_thermostat_relays(long int temperaturex10)
             // reset hvac gpio
             set_hvac_gpio(thermostat_state);
         }
+        web_write_begin(WEB_GROUP_THERMOSTAT);
         web.thermostat_effective_mode = effective_mode;
+        web_write_end(WEB_GROUP_THERMOSTAT);
 
         if (temporary_setpoint_offset_changed())
         {
@@ -603,6 +606,10 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
     static bool heating_disabled = false;
     static int current_start_mow = 0;
     int delta = 10079;  // number of minutes in a week
+    int set_point = web.thermostat_set_point;
+    int heating_set_point = web.thermostat_heating_set_point;
+    int cooling_set_point = web.thermostat_cooling_set_point;
+    WEB_POWERWALL_T powerwall;
 
     // get setpoint according to schedule
     if (!get_mow_local_tz(&mow))
@@ -665,9 +672,9 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
     case HVAC_FAN_ONLY:
     default: 
         // initial set points are identical
-        web.thermostat_set_point = candidate_temperature + temporary_set_point_offsetx10;
-        web.thermostat_heating_set_point = candidate_temperature + temporary_set_point_offsetx10;
-        web.thermostat_cooling_set_point = candidate_temperature + temporary_set_point_offsetx10;
+        set_point = candidate_temperature + temporary_set_point_offsetx10;
+        heating_set_point = candidate_temperature + temporary_set_point_offsetx10;
+        cooling_set_point = candidate_temperature + temporary_set_point_offsetx10;
 
         // adjust setpoint bias based on last heating or cooling cycle run
         switch(last_active)
@@ -686,20 +693,20 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         switch(setpoint_bias)
         {
         case SETPOINT_BIAS_HEATING:
-            web.thermostat_cooling_set_point += (3*config.thermostat_hysteresis);
+            cooling_set_point += (3*config.thermostat_hysteresis);
             break;
         case SETPOINT_BIAS_COOLING:
-            web.thermostat_heating_set_point -= (3*config.thermostat_hysteresis); 
+            heating_set_point -= (3*config.thermostat_hysteresis); 
             break;
         default:
         case SETPOINT_BIAS_UNDEFINED:
-            if (temperaturex10 < web.thermostat_set_point)
+            if (temperaturex10 < set_point)
             {
-                web.thermostat_cooling_set_point += (3*config.thermostat_hysteresis);
+                cooling_set_point += (3*config.thermostat_hysteresis);
             }
             else
             {
-                web.thermostat_heating_set_point -= (3*config.thermostat_hysteresis);       
+                heating_set_point -= (3*config.thermostat_hysteresis);       
             }
             break;    
         }   
@@ -718,18 +725,18 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         // set auto setpoint based on current temperature (non-functional in this mode but appears on status web page)
         if (web.thermostat_temperature < (candidate_cooling_temperature - config.thermostat_hysteresis))
         {
-            web.thermostat_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;  
+            set_point = candidate_heating_temperature + temporary_set_point_offsetx10;  
             display_set_base_temperature(candidate_heating_temperature);      
         }
         else
         {
-            web.thermostat_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;
+            set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;
             display_set_base_temperature(candidate_cooling_temperature);
         }
 
         // set individual heating and cooling setpoints
-        web.thermostat_heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
-        web.thermostat_cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;              
+        heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
+        cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;              
         break;
     case HVAC_HEATING_ONLY:
         // user defined setpoint is for heating
@@ -739,11 +746,11 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         candidate_cooling_temperature = candidate_heating_temperature + 3*config.thermostat_hysteresis;
 
         // set individual heating and cooling setpoints
-        web.thermostat_heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
-        web.thermostat_cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10; 
+        heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
+        cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10; 
         
         // set auto setpoint
-        web.thermostat_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;         
+        set_point = candidate_heating_temperature + temporary_set_point_offsetx10;         
 
         // set base temperature that will be used on front panel (plus offset provided by user)
         display_set_base_temperature(candidate_heating_temperature);         
@@ -756,24 +763,25 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         candidate_heating_temperature = candidate_cooling_temperature - 3*config.thermostat_hysteresis;
 
         // set individual heating and cooling setpoints        
-        web.thermostat_heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
-        web.thermostat_cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;    
+        heating_set_point = candidate_heating_temperature + temporary_set_point_offsetx10;
+        cooling_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10;    
 
         // set auto setpoint
-        web.thermostat_set_point = candidate_cooling_temperature + temporary_set_point_offsetx10; 
+        set_point = candidate_cooling_temperature + temporary_set_point_offsetx10; 
 
         // set base temperature that will be used on front panel (plus offset provided by user)
         display_set_base_temperature(candidate_cooling_temperature);        
         break;
     }
 
-    // adjust setpoint according to powerwall status
-    switch(web.powerwall_grid_status)
+    // adjust setpoint according to the last powerwall status published, never waits for the gateway
+    web_snapshot_powerwall(&powerwall);
+    switch(powerwall.grid_status)
     {
     case GRID_DOWN:
         // grid down setpoint adjustments -- relax setpoints when grid down
-        web.thermostat_heating_set_point -= config.grid_down_heating_setpoint_decrease;
-        web.thermostat_cooling_set_point += config.grid_down_cooling_setpoint_increase;
+        heating_set_point -= config.grid_down_heating_setpoint_decrease;
+        cooling_set_point += config.grid_down_cooling_setpoint_increase;
 
         // sanitize user configured battery levels
         CLIP(config.grid_down_cooling_disable_battery_level, 300, 950);   // 30% - 95%
@@ -794,27 +802,27 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         }        
 
         // disable cooling if battery level too low -- keep disabled until satisfactory level reached
-        if ((web.powerwall_battery_percentage < config.grid_down_cooling_disable_battery_level) || cooling_disabled)
+        if ((powerwall.battery_percentage < config.grid_down_cooling_disable_battery_level) || cooling_disabled)
         {
-            web.thermostat_cooling_set_point = 1500;  //max temp so that cooling is disabled
+            cooling_set_point = 1500;  //max temp so that cooling is disabled
             cooling_disabled = true;
         }
 
         // disable heating if battery level too low -- keep disabled until satisfactory level reached
-        if ((web.powerwall_battery_percentage < config.grid_down_heating_disable_battery_level) || heating_disabled)
+        if ((powerwall.battery_percentage < config.grid_down_heating_disable_battery_level) || heating_disabled)
         {
-            web.thermostat_heating_set_point = -1000;  //min temp so that heating is disabled
+            heating_set_point = -1000;  //min temp so that heating is disabled
             heating_disabled = true;
         }
 
         // enable cooling if battery level satisfactory
-        if ((web.powerwall_battery_percentage > config.grid_down_cooling_enable_battery_level))
+        if ((powerwall.battery_percentage > config.grid_down_cooling_enable_battery_level))
         {
             cooling_disabled = false;
         }    
 
         // enable heating if battery level satisfactory
-        if ((web.powerwall_battery_percentage > config.grid_down_heating_enable_battery_level))
+        if ((powerwall.battery_percentage > config.grid_down_heating_enable_battery_level))
         {
             heating_disabled = false;
         }                  
@@ -830,6 +838,13 @@ int update_current_setpoints(THERMOSTAT_STATE_T last_active, long int temperatur
         break;
     }
 
+    // publish set points together so that readers never see a mix of old and new
+    web_write_begin(WEB_GROUP_THERMOSTAT);
+    web.thermostat_set_point = set_point;
+    web.thermostat_heating_set_point = heating_set_point;
+    web.thermostat_cooling_set_point = cooling_set_point;
+    web_write_end(WEB_GROUP_THERMOSTAT);
+
     return(err);
 }
 
@@ -43,9 +43,10 @@
 #include "config.h"
 #include "pluto.h"
 #include "tm1637.h"
+#include "web_snapshot.h"
+#include "fixed_format.h"
 
 // defines
-#define SIZE_CLIMATE_HISTORY (100)          
 #define SIZE_TREND_WINDOW (10)
 #define LAG_MIN_REPORTABLE_TEMP_DELTA (2) 
 
@@ -149,7 +150,9 @@ int predicted_time_to_temperature(long int target_temperature)
     {
 
         predicted_time_in_samples = (temperature_delta*100)/climate_trend.gradient; 
+        web_write_begin(WEB_GROUP_THERMOSTAT);
         web.thermostat_temperature_prediction = predicted_time_in_samples;        
+        web_write_end(WEB_GROUP_THERMOSTAT);
 
         if (predicted_time_in_samples < 0)
         {
@@ -269,6 +272,8 @@ int update_trend_buffer(CLIMATE_DATAPOINT_T *sample, CLIMATE_DATAPOINT_T *previo
     int i;
     long int gradient = 0;
     char timestamp[32];
+    char temperature_string[FFMT_NUMBER_MAX];
+    char gradient_string[FFMT_NUMBER_MAX];
    
     // store sample in sample_buffer
     climate_trend.sample_buffer[climate_trend.buffer_index] = *sample;
@@ -307,11 +312,15 @@ int update_trend_buffer(CLIMATE_DATAPOINT_T *sample, CLIMATE_DATAPOINT_T *previo
 
     // print temperature and gradient
     get_timestamp_from_unix_time(climate_trend.moving_average.unix_time, timestamp, NUM_ROWS(timestamp), 0, 1);
-    printf("%s     Temperature %c%ld.%ld degrees     Gradient %c%ld.%02ld degrees per sample\n", timestamp, climate_trend.moving_average.temperaturex10<0?'-':' ', abs(climate_trend.moving_average.temperaturex10)/10, abs(climate_trend.moving_average.temperaturex10%10), climate_trend.gradient<0?'-':' ', abs(climate_trend.gradient)/100, abs(climate_trend.gradient%100));
+    ffmt_fixed(temperature_string, sizeof(temperature_string), climate_trend.moving_average.temperaturex10, 1, ' ');
+    ffmt_fixed(gradient_string, sizeof(gradient_string), climate_trend.gradient, 2, ' ');
+    printf("%s     Temperature %s degrees     Gradient %s degrees per sample\n", timestamp, temperature_string, gradient_string);
     
     // update web interface TODO: should web variables be long int?
+    web_write_begin(WEB_GROUP_THERMOSTAT);
     web.thermostat_temperature_moving_average = climate_trend.moving_average.temperaturex10;
     web.thermostat_temperature_gradient = climate_trend.gradient;
+    web_write_end(WEB_GROUP_THERMOSTAT);
    
     // zero delta counters
     climate_trend.deltas[NEGATIVE_DELTA] = 0;
@@ -465,11 +474,15 @@ void log_climate_change(int temperaturex10, int humidityx10)
 {
     static int sent_temperaturex10 = 0;
     static int sent_humidityx10 = 0;
+    char temperature_string[FFMT_NUMBER_MAX];
+    char humidity_string[FFMT_NUMBER_MAX];
 
     // check if values changed
     if ((temperaturex10 != sent_temperaturex10) || (humidityx10 != sent_humidityx10))
     {
-        send_syslog_message("temperature", "Temperature = %c%ld.%ld Humidity = %ld.%ld\n", temperaturex10<0?'-':' ', abs(temperaturex10/10), abs(temperaturex10%10), humidityx10/10, humidityx10%10);
+        ffmt_fixed(temperature_string, sizeof(temperature_string), temperaturex10, 1, ' ');
+        ffmt_fixed(humidity_string, sizeof(humidity_string), humidityx10, 1, 0);
+        send_syslog_message("temperature", "Temperature = %s Humidity = %s\n", temperature_string, humidity_string);
 
         // remember what we sent
         sent_temperaturex10 = temperaturex10;
@@ -480,80 +493,46 @@ void log_climate_change(int temperaturex10, int humidityx10)
 }
 
 /*!
- * \brief print temperature history for insertion into web page  
+ * \brief copy temperature history, oldest sample first, for streaming to the web ui
  *
- * \param[out]  buffer           pointer to output buffer
- * \param[in]   length           size of output buffer  
- * \param[in]   start_position   offset into buffer to place output
- * \param[in]   num_data_points  max number of (time, temperature) pairs to output  
- * \return number of bytes printed
+ * \param[out]  unix_time        sample times
+ * \param[out]  temperaturex10   sample temperatures
+ * \param[in]   max_points       size of output arrays
+ *
+ * \return number of samples copied
  */
-int print_temperature_history(char *buffer, int length, int start_position, int num_data_points)
+int copy_temperature_history(uint32_t *unix_time, int16_t *temperaturex10, int max_points)
 {
     int i;
-    int history_index = 0;
-    int printed_characters = 0;
-    int total_printed_characters = 0;
-    char iso_timestamp[32];
-    char *buff = 0;
+    int oldest = 0;
+    int population;
+    int history_index;
 
-    // output xy data in format expected by javascript e.g. { x: '2025-10-01T08:00:00', y: 65 },
-    buff = buffer;
-    *buffer = 0;
+    population = climate_history.buffer_population;
 
-    if (start_position < climate_history.buffer_population)
+    if (population == NUM_ROWS(climate_history.buffer))
     {
-        // limit data points to number in the circular buffer
-        if ((start_position + num_data_points) > climate_history.buffer_population)
-        {
-            num_data_points = climate_history.buffer_population - start_position;
-        }
-
-        if (num_data_points > 0)
-        {
-            for(i=0; i < num_data_points; i++)
-            {
-                if (climate_history.buffer_population == NUM_ROWS(climate_history.buffer))
-                {
-                    // circular buffer is full, so oldest entry is the current buffer index (that we will overwrite next with new data)
-                    history_index = (climate_history.buffer_index + start_position + i)%climate_history.buffer_population;
-                }
-                else
-                {
-                    // circular buffer not full, so oldest entry is at buffer index 0
-                    history_index = start_position + i;   
-                    
-                    //printf("Circular buffer not full because %d != %d\n", climate_history.buffer_population, NUM_ROWS(climate_history.buffer));
-                }
-
-                // generatre timestamp string
-                unix_to_iso8601(climate_history.buffer[history_index].unix_time, iso_timestamp, sizeof(iso_timestamp)); 
-
-                // print xy data
-                printed_characters = snprintf(buffer, length, "{x: '%s', y: %d.%d },\n", iso_timestamp, climate_history.buffer[history_index].temperaturex10/10, climate_history.buffer[history_index].temperaturex10%10);
-                //printf("i=%d history_index=%d time=%s\n", i, history_index, iso_timestamp);
-                if (printed_characters < length)
-                {
-                    total_printed_characters += printed_characters;
-                    length -= printed_characters;
-                    buffer += printed_characters;
-                }
-                else
-                {
-                    // hit the end of buffer truncate at START of last print attempt (erasing the last line printed)
-                    *buffer = 0;
-                    printf("BUFFER TERMINATED due to excess length\n%s\n", buff);
-                    break;
-                }
-            }
-        }
+        // circular buffer is full, so oldest entry is the current buffer index (that we will overwrite next with new data)
+        oldest = climate_history.buffer_index;
     }
 
+    if (population > max_points)
+    {
+        // keep the most recent samples
+        oldest += population - max_points;
+        population = max_points;
+    }
 
+    for(i=0; i < population; i++)
+    {
+        history_index = (oldest + i)%NUM_ROWS(climate_history.buffer);
+        unix_time[i] = climate_history.buffer[history_index].unix_time;
+        temperaturex10[i] = (int16_t)climate_history.buffer[history_index].temperaturex10;
+    }
 
-    return(total_printed_characters);
+    return(population);
 }
-        
+
 /*!
  * \brief Filter out noise in temperature readings
  * 
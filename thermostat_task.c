@@ -42,6 +42,8 @@
 #include "powerwall.h"
 #include "pluto.h"
 #include "tm1637.h"
+#include "events.h"
+#include "web_snapshot.h"
 
 // typdedefs
 typedef struct
@@ -69,7 +71,6 @@ THERMOSTAT_INITIALIZATION_T initialization_table[] =
 {
     {initialize_climate_metrics,                false},
     {initialize_hvac_control,                   false},    
-    {powerwall_init,                            false}, 
     {thermostat_initialize_buttons,             false}, 
     {thermostat_display_initialize,             false}, 
     {thermostat_initialize_temperature_sensor,  false}             
@@ -108,7 +109,6 @@ void thermostat_task(void *params)
 
     // set initial status
     temperaturex10 = thermostat_get_default_temperature();   
-    web.powerwall_grid_status = GRID_UNKNOWN;
 
     // check and correct critical user configuration settings
     thermostat_sanitize_user_config();
@@ -145,14 +145,14 @@ void thermostat_task(void *params)
 
                 // update web ui
                 //web.thermostat_temperature = filter_temperature_noise(temperaturex10);
+                web_write_begin(WEB_GROUP_THERMOSTAT);
                 web.thermostat_temperature = temperaturex10;
+                web_write_end(WEB_GROUP_THERMOSTAT);
             }
             
-            // check powerwall status
-            powerwall_check();
-
             // set hvac relays
             control_thermostat_relays(temperaturex10);
+            events_publish(EVENT_THERMOSTAT);
 
             if (buttons_initialized)
             {
@@ -21,6 +21,7 @@
 #include "thermostat.h"
 #include "hc_task.h"
 #include "discovery_task.h"
+#include "powerwall.h"
 
 // worker tasks to launch and monitor
 WORKER_TASK_T worker_tasks[] =
@@ -31,6 +32,7 @@ WORKER_TASK_T worker_tasks[] =
     {   message_task,   "Message Task",         1024,   1},  
 #ifdef INCORPORATE_THERMOSTAT    
     {   thermostat_task,"Thermostat Task",      8096,   5},        
+    {   powerwall_task, "Powerwall Task",       2048,   2},
 #endif
 #ifdef INCORPORATE_HOME_CONTROLLER    
     {   hc_task,        "Home Controller Task", 8096,   6},      
@@ -1,2 +1,10 @@
 void main_task(__unused void *params);
-int ping_device(const ip_addr_t* ping_addr, int max_attempts);
\ No newline at end of file
+int ping_device(const ip_addr_t* ping_addr, int max_attempts);
+
+#define PING_SWEEP_MAX_HOSTS    (1024)      // addresses in one sweep, a multiple of 32
+#define PING_SWEEP_BURST        (4)         // echoes sent back to back, below ARP_TABLE_SIZE so each can wait for its arp reply
+
+// called for each address that replies to a sweep, address in host byte order
+typedef void (*ping_sweep_fn)(void *arg, u32_t ip);
+
+int ping_sweep(u32_t first, u32_t count, u32_t rate, int attempts, u32_t timeout_ms, ping_sweep_fn found, void *arg);
@@ -33,6 +33,7 @@
 #include "config.h"
 #include "watchdog.h"
 #include "pluto.h"
+#include "store_forward.h"
 
 
 #define FLASH_TARGET_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
@@ -42,6 +43,8 @@
 //prototype
 //void establish_socket_dns_found(const char* hostname, const ip_addr_t *ipaddr, void *arg);
 int get_socket(char *address_string, int port, int type);
+static int format_syslog_message(char *syslog_message, int len, char *log_name, const char *format, va_list args);
+static int format_syslog_message_va(char *syslog_message, int len, char *log_name, const char *format, ...);
 
 // external variables
 extern NON_VOL_VARIABLES_T config;
@@ -179,65 +182,155 @@ void hex_dump(const uint8_t *bptr, uint32_t len) {
 
 
 /*!
- * \brief Send a syslog message
+ * \brief Send a syslog message -- queued for later delivery if the syslog server is unreachable
  *
  * \param[in]   log_name      name of log file on server
  * \param[in]   format, ...   variable parameters printf style  
  * 
- * \return num bytes sent or -1 on error
+ * \return num bytes sent, 0 if queued or -1 on error
  */
 int send_syslog_message(char *log_name, const char *format, ...)
 {
-    static int syslog_socket = -1;
-    //tatic struct sockaddr_in syslog_address;
-    static char ip_address_string[50] = "";  
-    int message_chars_remaining = 0;
     int sent_bytes = -1;  
+    int length;
     va_list args;
-    char timestamp[50];
     char syslog_message[200];
 
-
     if (config.syslog_enable)
     {
-        // cache our ip address for use in syslog messages 
-        if (!*ip_address_string) STRNCPY(ip_address_string, ipaddr_ntoa(netif_ip4_addr(&cyw43_state.netif[0])), sizeof(ip_address_string));
+        va_start(args, format);  
+        length = format_syslog_message(syslog_message, sizeof(syslog_message), log_name, format, args);
+        va_end(args); 
 
-        // (re)establish socket connection
-        if (syslog_socket < 0) syslog_socket = establish_socket(config.syslog_server_ip, /*&syslog_address,*/ 514, SOCK_DGRAM);    
-
-        if (syslog_socket >= 0)
+        if (length > 0)
         {
-            if (!get_timestamp(timestamp, sizeof(timestamp), true, true))
-            {   
-                message_chars_remaining = sizeof(syslog_message);
-                snprintf(syslog_message, message_chars_remaining, "<165>1 %s %s %s 1 - - %%%% ", timestamp, ip_address_string, log_name);
-
-                message_chars_remaining = sizeof(syslog_message) - strlen(syslog_message);
-                va_start(args, format);  
-                vsnprintf(syslog_message+strlen(syslog_message), message_chars_remaining, format, args); 
-                va_end(args); 
-                syslog_message[199] = 0;  // ensure string terminated
-
-                //cyw43_arch_lwip_begin();
-                sent_bytes = send(syslog_socket, syslog_message, strlen(syslog_message), 0);
-                //cyw43_arch_lwip_end();
-                //printf("sent %d bytes.  MSG: %s\n", sent_bytes, syslog_message); 
-
-                if (sent_bytes < 0)
-                {
-                    //cyw43_arch_lwip_begin();
-                    close(syslog_socket);
-                    //cyw43_arch_lwip_end();
-                    syslog_socket = -1;
-                    web.syslog_transmit_failures++;
-                }          
-            }
+            sent_bytes = store_forward_submit(syslog_message, length);
         }
     }
     return(sent_bytes);
 }
 
+/*!
+ * \brief Format a syslog message with the current time
+ *
+ * \param[out]  syslog_message   destination
+ * \param[in]   len              size of destination
+ * \param[in]   log_name         name of log file on server
+ * \param[in]   format           printf style format
+ * \param[in]   args             format parameters
+ * 
+ * \return length of message or -1 if the time is not known
+ */
+static int format_syslog_message(char *syslog_message, int len, char *log_name, const char *format, va_list args)
+{
+    static char ip_address_string[50] = "";  
+    int message_chars_remaining = 0;
+    char timestamp[50];
+
+    // cache our ip address for use in syslog messages 
+    if (!*ip_address_string) STRNCPY(ip_address_string, ipaddr_ntoa(netif_ip4_addr(&cyw43_state.netif[0])), sizeof(ip_address_string));
+
+    if (get_timestamp(timestamp, sizeof(timestamp), true, true))
+    {
+        return(-1);
+    }
+
+    message_chars_remaining = len;
+    snprintf(syslog_message, message_chars_remaining, "<165>1 %s %s %s 1 - - %%%% ", timestamp, ip_address_string, log_name);
+
+    message_chars_remaining = len - strlen(syslog_message);
+    vsnprintf(syslog_message+strlen(syslog_message), message_chars_remaining, format, args); 
+    syslog_message[len-1] = 0;  // ensure string terminated
+
+    return(strlen(syslog_message));
+}
+
+/*!
+ * \brief Transmit a formatted syslog message -- called by the store and forward queue
+ *
+ * \param[in]   syslog_message   message to send
+ * \param[in]   length           length of message
+ * 
+ * \return num bytes sent or -1 if the link or syslog server is down
+ */
+int syslog_transmit(const char *syslog_message, int length)
+{
+    static int syslog_socket = -1;
+    int sent_bytes = -1;  
+
+    // no point trying while wifi is down
+    if (cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) != CYW43_LINK_UP)
+    {
+        return(-1);
+    }
+
+    // (re)establish socket connection
+    if (syslog_socket < 0) syslog_socket = establish_socket(config.syslog_server_ip, /*&syslog_address,*/ 514, SOCK_DGRAM);    
+
+    if (syslog_socket >= 0)
+    {
+        //cyw43_arch_lwip_begin();
+        sent_bytes = send(syslog_socket, syslog_message, length, 0);
+        //cyw43_arch_lwip_end();
+        //printf("sent %d bytes.  MSG: %s\n", sent_bytes, syslog_message); 
+
+        if (sent_bytes < 0)
+        {
+            //cyw43_arch_lwip_begin();
+            close(syslog_socket);
+            //cyw43_arch_lwip_end();
+            syslog_socket = -1;
+            web.syslog_transmit_failures++;
+        }          
+    }
+
+    return(sent_bytes);
+}
+
+/*!
+ * \brief Transmit a syslog message in place of messages discarded while the server was unreachable
+ *
+ * \param[in]   lost   number of messages discarded
+ * 
+ * \return num bytes sent or -1 if the link or syslog server is down
+ */
+int syslog_transmit_gap(uint32_t lost)
+{
+    char syslog_message[200];
+    int length;
+
+    length = format_syslog_message_va(syslog_message, sizeof(syslog_message), "syslog", "*GAP* %lu messages lost while syslog server unreachable", lost);
+
+    if (length < 0)
+    {
+        return(-1);
+    }
+
+    return(syslog_transmit(syslog_message, length));
+}
+
+/*!
+ * \brief Format a syslog message with the current time
+ *
+ * \param[out]  syslog_message   destination
+ * \param[in]   len              size of destination
+ * \param[in]   log_name         name of log file on server
+ * \param[in]   format, ...      variable parameters printf style
+ * 
+ * \return length of message or -1 if the time is not known
+ */
+static int format_syslog_message_va(char *syslog_message, int len, char *log_name, const char *format, ...)
+{
+    int length;
+    va_list args;
+
+    va_start(args, format);  
+    length = format_syslog_message(syslog_message, len, log_name, format, args);
+    va_end(args); 
+
+    return(length);
+}
+
 
 /*!
  * \brief Log watchdog reset if it occured
@@ -269,7 +362,7 @@ int check_watchdog_reboot(void)
     if (watchdog_reset && config.syslog_enable && !syslog_sent)
     {
         // log watchdog event
-        if ((send_syslog_message("usurper", "REBOOT @ %s [reason = %lu]", web.watchdog_timestring, get_reboot_reason())) > 0)   
+        if ((send_syslog_message("usurper", "REBOOT @ %s [reason = %lu]", web.watchdog_timestring, get_reboot_reason())) >= 0)   
         {
             syslog_sent = true;
         }
@@ -21,6 +21,8 @@ void hex_dump_to_string(const uint8_t *bptr, uint32_t len, char *out_string, int
 void hex_dump(const uint8_t *bptr, uint32_t len);
 int establish_socket(char *address_string, /*struct sockaddr_in *ipv4_address,*/ int port, int type);
 int send_syslog_message(char *log_name, const char *format, ...);
+int syslog_transmit(const char *syslog_message, int length);
+int syslog_transmit_gap(uint32_t lost);
 int check_watchdog_reboot(void);
 int send_govee_command(int on, int red, int green, int blue);
 int establish_multicast_socket(struct sockaddr_in *ipv4_address, int port, int type);
@@ -35,8 +35,10 @@
 #include "led_strip.h"
 #include "message.h"
 #include "pluto.h"
+#include "events.h"
+#include "web_snapshot.h"
+#include "fixed_format.h"
 
-#define BUF_SIZE (900)
 #define RELAY_GPIO_PIN (3)
 #define MAX_WINDSPEED (50)
 
@@ -107,54 +109,9 @@ const ECOWITT_REQUEST_T aEcowittRequests[] =
 };
 
 
-typedef struct ECOWITTT_PARAMETER_STUCT
-{
-    unsigned char id;
-    char *name;
-    char *units;
-    unsigned char num_bytes;
-    unsigned char *latest_value;
-} ECOWITT_PARAMETER_T;
-
-// raw bytes of relevant parameters extracted from received packets
-static unsigned char raw_outsidetemp[2]     = {0,0};
-static unsigned char raw_windspeed[2]       = {0,0};
-static unsigned char raw_dailyrain[4]       = {0,0,0,0};
-static unsigned char raw_weeklyrain[4]      = {0,0,0,0};
-static unsigned char raw_monthlyrain[4]     = {0,0,0,0};
-static unsigned char raw_soilmoisture1[16]  = {0};
-
-const ECOWITT_PARAMETER_T aEcowittParameters[] =
-{
-    //item tag                 name                            units              num_bytes    store
-    {ITEM_INTEMP,              "Inside Temperature",           "C x 10",          2,           NULL},
-    {ITEM_INHUMI,              "Inside Humidity",              "%%",               1,           NULL},
-    {ITEM_ABSBARO,             "Absolute Pressure",            "hpa",             2,           NULL},
-    {ITEM_RELBARO,             "Relative Pressure",            "hpa",             2,           NULL},
-    {ITEM_OUTTEMP,             "Outside Temperature",           "C x 10",         2,           raw_outsidetemp},
-    {ITEM_OUTHUMI,             "Outside Humidity",              "%%",              1,           NULL},        
-    {ITEM_WINDDIRECTION,       "Wind Direction",                "360°",           2,           NULL},
-    {ITEM_WINDSPEED,           "Wind Speed",                    "m/s",            2,           raw_windspeed},    
-    {ITEM_GUSTSPEED,           "Gust Speed",                    "m/s",            2,           NULL},  
-    {ITEM_LIGHT,               "Light",                         "m/s",            4,           NULL},  
-    {ITEM_UV,                  "UV",                            "m/s",            2,           NULL},  
-    {ITEM_UVI,                 "UV Index",                      "m/s",            1,           NULL},  
-    {ITEM_DAYLWINDMAX,         "Wind Day Max",                  "m/s",            2,           NULL},  
-    {ITEM_Piezo_Rain_Rate,     "Rain Rate",                     "mm/h",           2,           NULL},  
-    {ITEM_Piezo_Event_Rain,    "Rain Event",                    "units",          2,           NULL},  
-    {ITEM_Piezo_Hourly_Rain,   "Rain Hourly",                   "mm",             2,           NULL},  
-    {ITEM_Piezo_Daily_Rain,    "Rain Daily",                    "mm",             4,           raw_dailyrain},  
-    {ITEM_Piezo_Weekly_Rain,   "Rain Weekly",                   "mm",             4,           raw_weeklyrain},  
-    {ITEM_Piezo_Monthly_Rain,  "Rain Monthly",                  "mm",             4,           raw_monthlyrain},  
-    {ITEM_Piezo_yearly_Rain,   "Rain Yearly",                   "mm",             4,           NULL},  
-    {ITEM_Piezo_Gain10,        "Piezo Gain",                    "gainx10",        20,          NULL},  
-    {ITEM_RST_RainTime,        "Rain Time",                     "units",          3,           NULL},   
-    {0x7a,                     "Rain Unknown1",                 "units",          1,           NULL},
-    {0x7b,                     "Rain Unknown2",                 "units",          1,           NULL},  
-    {0x6c,                     "Unknown",                       "units",          4,           NULL},  // len 4 is guess  
-    {ITEM_SOILMOISTURE1,       "Soil Moisture 1",               "%%",             1,           raw_soilmoisture1},      
-};
-
+// replies reassembled from the gateway's tcp stream and the values decoded from them
+static ECOWITT_STREAM_T ecowitt_stream;
+static ECOWITT_OBSERVATION_T ecowitt_observation;
 
 
 /*!
@@ -271,12 +228,12 @@ void weather_task(void *params)
  * \param[out] web.wind_speed           global variable used by user interface                    
  * \param[out] web.daily_rain           global variable used by user interface                   
  * \param[out] web.weekly_rain          global variable used by user interface 
- * \param[out] web.soil_moisture[0]     global variable used by user interface  
+ * \param[out] web.soil_moisture        global variable used by user interface  
  * \return WEATHER_READ_SUCCESS or WEATHER_READ_FAILED
  */
 WEATHER_QUERY_STATUS_T query_weather_station(void)
 {
-    int err = WEATHER_READ_SUCCESS;
+    int err = WEATHER_READ_FAILED;
     int ret;
     int wrote_bytes;
     int read_bytes;
@@ -284,11 +241,19 @@ WEATHER_QUERY_STATUS_T query_weather_station(void)
     int retry;
     fd_set readset;
     struct timeval tv;  
-    unsigned char rx_buffer[BUF_SIZE];  
+    uint8_t *space;
+    int space_len;
+    const uint8_t *frame;
+    int frame_length;
+    int i;
     static int ecowitt_socket = -1;
 
     // (re)establish socket connection
-    if (ecowitt_socket < 0) ecowitt_socket = establish_socket(config.weather_station_ip, 45000, SOCK_STREAM);
+    if (ecowitt_socket < 0)
+    {
+        ecowitt_socket = establish_socket(config.weather_station_ip, 45000, SOCK_STREAM);
+        ecowitt_stream_init(&ecowitt_stream);
+    }
 
     if(ecowitt_socket >= 0)
     {
@@ -299,8 +264,7 @@ WEATHER_QUERY_STATUS_T query_weather_station(void)
 
         if (wrote_bytes > 0)
         {
-            //printf("read live_data\n");                    
-            for (retry=0; retry<5; retry++)
+            for (retry=0; (retry<5) && (err != WEATHER_READ_SUCCESS) && (ecowitt_socket >= 0); retry++)
             {
                 FD_ZERO(&readset);
                 FD_SET(ecowitt_socket, &readset);
@@ -311,189 +275,122 @@ WEATHER_QUERY_STATUS_T query_weather_station(void)
 
                 if ((ret > 0) && FD_ISSET(ecowitt_socket, &readset))
                 {
-                    read_bytes = recv(ecowitt_socket, rx_buffer, BUF_SIZE, 0);
+                    // receive straight into the reassembly buffer
+                    space = ecowitt_stream_space(&ecowitt_stream, &space_len);
+                    read_bytes = recv(ecowitt_socket, space, space_len, 0);
 
                     if (read_bytes > 0)
                     {
-                        //hex_dump(rx_buffer, read_bytes);
-                        if (!receive_weather_info_from_ecowitt(rx_buffer, read_bytes))
+                        ecowitt_stream_received(&ecowitt_stream, read_bytes);
+
+                        // a read can hold part of a reply or several replies
+                        while (ecowitt_stream_next(&ecowitt_stream, &frame, &frame_length))
                         {
-                            err = WEATHER_READ_SUCCESS;
-
-                            // store parameters of interest
-                            web.outside_temperature = (s16_t)ntohs(*((s16_t *)raw_outsidetemp));
-                            web.wind_speed          = ntohs(*(u16_t *)raw_windspeed);                            
-                            web.daily_rain          = ntohl(*(u32_t *)raw_dailyrain);                            
-                            web.weekly_rain         = ntohl(*(u32_t *)raw_weeklyrain);
-                            web.soil_moisture[0]    = raw_soilmoisture1[0];
-                            
-                            // clip parameters to sane ranges
-                            CLIP(web.outside_temperature, -1000, 600);
-                            CLIP(web.wind_speed, 0, 1100);
-                            CLIP(web.daily_rain, 0, 2000);
-                            CLIP(web.soil_moisture[0], 0, 7*2000);                                                                                                                                        
-                            break;
+                            if (!receive_weather_info_from_ecowitt((unsigned char *)frame, frame_length))
+                            {
+                                err = WEATHER_READ_SUCCESS;
+                            }
                         }
                     }
                     else
                     {
-                        err = WEATHER_READ_FAILED;
+                        // connection closed by the gateway
+                        close(ecowitt_socket);
+                        ecowitt_socket = -1;
                     }
                 }
+            }
+
+            if (err == WEATHER_READ_SUCCESS)
+            {
+                // store parameters of interest, piezo rain gauge in preference to tipping bucket
+                web_write_begin(WEB_GROUP_WEATHER);
+                web.outside_temperature = ecowitt_observation.outdoor_temperature;
+                web.wind_speed          = ecowitt_observation.wind_speed;
+                web.wind_gust           = ecowitt_observation.gust_speed;
+                if (ecowitt_present(&ecowitt_observation, ITEM_Piezo_Daily_Rain))
+                {
+                    web.daily_rain      = ecowitt_observation.piezo_rain_day;
+                    web.weekly_rain     = ecowitt_observation.piezo_rain_week;
+                }
                 else
                 {
-                    err = WEATHER_READ_FAILED;
-                }  
+                    web.daily_rain      = ecowitt_observation.rain_day;
+                    web.weekly_rain     = ecowitt_observation.rain_week;
+                }
+                for (i=0; i<ECOWITT_SOIL_CHANNELS; i++)
+                {
+                    web.soil_moisture[i] = ecowitt_observation.soil_moisture[i];
+                }
+
+                // clip parameters to sane ranges
+                CLIP(web.outside_temperature, -1000, 600);
+                CLIP(web.wind_speed, 0, 1100);
+                CLIP(web.wind_gust, 0, 1100);
+                CLIP(web.daily_rain, 0, 2000);
+                web_write_end(WEB_GROUP_WEATHER);
 
-            }         
+                events_publish(EVENT_WEATHER);
+            }
+            else
+            {
+                // drop a partial reply so that it cannot be joined to the reply to the next request
+                ecowitt_stream_init(&ecowitt_stream);
+            }
         }
         else
         {
             // close socket
             close(ecowitt_socket);
             ecowitt_socket = -1;
-            err = WEATHER_READ_FAILED;
         }
     }
-    else
-    {
-        err = WEATHER_READ_FAILED;
-    }
 
     return(err);
 }
 
 
 /*!
- * \brief Extract parameter values from ecowitt response message and store in global table
+ * \brief Decode one reply from the ecowitt gateway into the latest observation
  *
- * \param[out]  rx_bytes    pointer to array containing message
- * \param[in]   len         length of message  
+ * \param[in]   rx_bytes    complete reply with a good checksum, from ecowitt_stream_next()
+ * \param[in]   rx_len      length of reply
  * 
- * \return 0 on success, non-zero on error
+ * \return 0 if the reply carried weather data, non-zero otherwise
  */
 int receive_weather_info_from_ecowitt(unsigned char *rx_bytes, int rx_len)
 {
-    int ecowitt_msg_len = 0;
-    int computed_checksum = 0;
-    int i;
-    int j;
-    int found_id;
-    int complete_msg_received = 0;
-    int error = 0;
-    bool rx_header = false;
+    ECOWITT_RESULT_T result;
+    static uint8_t reported_item = 0;
 
+    result = ecowitt_decode(rx_bytes, rx_len, &ecowitt_observation);
 
-    // check if we have recieved an entire well formed message (simplistic approach -- assume one msg per buffer)
-    if (rx_len > 4)
+    switch(result)
     {
-        if ((rx_bytes[0] == 0xff) && (rx_bytes[1] == 0xff))
-        {
-           //printf("Receieved header 0xff 0xff\n"); 
-           rx_header = true;
-        }
-
-        ecowitt_msg_len = rx_bytes[3]*256 + rx_bytes[4];
-        //printf("Receieved ecowitt message length %d  [bytes %x %x]\n", ecowitt_msg_len, rx_bytes[3], rx_bytes[4]);
-
-        if (rx_header && (rx_len >= ecowitt_msg_len+2))
-        {
-            //printf("Read bytes conatin complete Ecowitt message.  ecowitt_len = %d  read_bytes = %d\n", ecowitt_msg_len, rx_len); 
-            complete_msg_received = 1;
-
-            //compute checksum and compare
-            for (i=0; i<(ecowitt_msg_len-1); i++)
-            {
-                computed_checksum +=rx_bytes[i+2]; 
-            }
-            if (computed_checksum%256 != rx_bytes[ecowitt_msg_len+1])
+        case ECOWITT_OK:
+            break;
+        case ECOWITT_UNKNOWN_ITEM:
+            // items before the unknown one were decoded, report each new id once
+            if (ecowitt_observation.unknown_item != reported_item)
             {
-                printf("Ecowitt checksum error.  computed = %d  received = %d\n", computed_checksum%256, rx_bytes[ecowitt_msg_len-1]);
-                error = 2;
+                reported_item = ecowitt_observation.unknown_item;
+                printf("Ecowitt message parsing stopped at unknown parameter ID 0x%x\n", reported_item);
+                hex_dump(rx_bytes, rx_len);
             }
-        }
-        else
-        {
-            printf("Ecowitt message ***does not*** fit within current buffer of read bytes.  ecowitt_len = %d  buffer_len = %d\n", ecowitt_msg_len, rx_len);
-            error = 3; 
-        }
+            break;
+        case ECOWITT_TRUNCATED:
+            printf("Ecowitt message parsing stopped due to insufficient bytes remaining\n");
+            break;
+        default:
+            return(1);
     }
 
-    if (!error && complete_msg_received)
-    {
-        //record when packet received
-        web.us_last_rx_packet = time_us_32();
-        
-        // parse response parameters
-        i = 5;  //offset to first parameter following 0xff 0xff CMD LEN1 LEN2
-
-        while (!error && (i < (ecowitt_msg_len-1)))  // parse all bytes except the last which is the checksum
-        {            
-            found_id = 0;
-
-            // search for parameter id
-            for (j=0; j < sizeof(aEcowittParameters)/sizeof(aEcowittParameters[0]); j++)
-            {
-                if (rx_bytes[i] == aEcowittParameters[j].id)
-                {
-                    found_id = 1;
-
-                    //printf("Parameter: %s \n", aEcowittParameters[j].name);
-
-
-                    // check sufficient bytes remain in buffer to extract valid parameter value
-                    if ((ecowitt_msg_len - i) >= aEcowittParameters[j].num_bytes)
-                    {
-                        // index first byte of parameter value
-                        i += 1;
-
-                        // check if parameter is one we wish to store
-                        if (aEcowittParameters[j].latest_value)
-                        {
-                            switch (aEcowittParameters[j].num_bytes)
-                            {
-                                case 1:
-                                    aEcowittParameters[j].latest_value[0] = rx_bytes[i];
-                                    break;
-                                case 2:
-                                    aEcowittParameters[j].latest_value[0] = rx_bytes[i];
-                                    aEcowittParameters[j].latest_value[1] = rx_bytes[i+1];
-                                    break;
-                                case 4:
-                                    aEcowittParameters[j].latest_value[0] = rx_bytes[i];
-                                    aEcowittParameters[j].latest_value[1] = rx_bytes[i+1]; 
-                                    aEcowittParameters[j].latest_value[2] = rx_bytes[i+2];
-                                    aEcowittParameters[j].latest_value[3] = rx_bytes[i+3];
-                                    break;
-                                default:
-                                    printf("Ecowitt parameter has unhandled number of bytes.  Ignoring.");
-                                    break;
-                            }
-                        }
-
-                        // move index to next parameter
-                        i += aEcowittParameters[j].num_bytes; 
-                    }
-                    else
-                    {
-                        printf("Ecowitt message parsing stopped @ byte %d due to insufficient bytes remaining.  Parameter ID = 0x%x Parameter length = %d Bytes remaning = %d\n", i, rx_bytes[i], aEcowittParameters[j].num_bytes, ecowitt_msg_len - 1 - i);
-                        hex_dump(rx_bytes, rx_len);
-                        error = 5;
-                        break;
-                    }                      
-                }       
-            }
-
-            if (!found_id)
-            {
-                printf("Ecowitt message parsing stopped @ byte %d.  Parameter ID not recognized: 0x%x\n", i, rx_bytes[i]);
-                error = 4;
-                break;
-            }  
-        }
-    }
+    //record when packet received
+    web_write_begin(WEB_GROUP_WEATHER);
+    web.us_last_rx_packet = time_us_32();
+    web_write_end(WEB_GROUP_WEATHER);
 
-    return (error);
+    return(0);
 }
 
 
@@ -552,6 +449,7 @@ int init_web_variables(void)
     
     web.outside_temperature = 0;
     web.wind_speed = 0;
+    web.wind_gust = 0;
     web.daily_rain = 0;
     web.weekly_rain = 0;
     web.trailing_seven_days_rain = 0;
@@ -597,12 +495,18 @@ int init_web_variables(void)
  */
 int invalidate_weather_variables(void)
 {
+    web_write_begin(WEB_GROUP_WEATHER);
     web.outside_temperature = 0;
     web.wind_speed = 0;
+    web.wind_gust = 0;
     web.daily_rain = 0;
     web.weekly_rain = 0;
     //web.trailing_seven_days_rain = 0;  // useful for a few days if comms lost to weather station
-    web.soil_moisture[0] = 0;
+    memset(web.soil_moisture, 0, sizeof(web.soil_moisture));
+    web_write_end(WEB_GROUP_WEATHER);
+
+    // do not publish stale values if only some replies are received after communication resumes
+    memset(&ecowitt_observation, 0, sizeof(ecowitt_observation));
 
     return(0);
 }
@@ -618,6 +522,7 @@ IRRIGATION_STATE_T control_irrigation_relays(void)
     SCHEDULE_QUERY_STATUS_LT irrigation_schedule_status = SCHEDULE_FUTURE; 
     static int active_zone = 0;       
     int weekday;
+    int trailing_rain;
     int min_now;
     int mow_now;
     int schedule_start_mow = 0;
@@ -631,7 +536,10 @@ IRRIGATION_STATE_T control_irrigation_relays(void)
     get_mow_local_tz(&mow_now);
 
     // track last seven days of rain
-    web.trailing_seven_days_rain = accumulate_trailing_seven_day_total_rain(web.daily_rain, weekday);
+    trailing_rain = accumulate_trailing_seven_day_total_rain(web.daily_rain, weekday);
+    web_write_begin(WEB_GROUP_WEATHER);
+    web.trailing_seven_days_rain = trailing_rain;
+    web_write_end(WEB_GROUP_WEATHER);
 
     // check irrigation schedule
     irrigation_schedule_status = get_next_irrigation_period(&schedule_start_mow, &schedule_end_mow, &mins_till_irrigation, &zone);
@@ -1235,6 +1143,10 @@ int syslog_report_weather (void)
     static int previous_rain_day = 0;
     static int previous_rain_week = 0;  
     static int previous_soil_moisture = 0;        
+    char temperature_string[FFMT_NUMBER_MAX];
+    char wind_string[FFMT_NUMBER_MAX];
+    char rain_day_string[FFMT_NUMBER_MAX];
+    char rain_week_string[FFMT_NUMBER_MAX];
  
     // convert current measurements to archaic units if necessary
     switch(config.use_archaic_units)
@@ -1272,16 +1184,21 @@ int syslog_report_weather (void)
         previous_rain_week =  rain_week;
         previous_soil_moisture = soil_moisture;  
 
+        ffmt_fixed(temperature_string, sizeof(temperature_string), outside_temp, 1, 0);
+        ffmt_fixed(wind_string, sizeof(wind_string), wind_speed, 1, 0);
+        ffmt_fixed(rain_day_string, sizeof(rain_day_string), rain_day, 1, 0);
+        ffmt_fixed(rain_week_string, sizeof(rain_week_string), rain_week, 1, 0);
+
         switch(config.use_archaic_units)
         {
         case true:
-            send_syslog_message("usurper", "Temperature = %d.%d F Wind speed = %d.%d ft/s Daily rain = %d.%d inches Weekly rain = %d.%d inches Soil Moisture = %d%%",
-                outside_temp/10, abs(outside_temp%10), wind_speed/10, wind_speed%10, rain_day/10, rain_day%10, rain_week/10, rain_week%10, web.soil_moisture[0]);
+            send_syslog_message("usurper", "Temperature = %s F Wind speed = %s ft/s Daily rain = %s inches Weekly rain = %s inches Soil Moisture = %d%%",
+                temperature_string, wind_string, rain_day_string, rain_week_string, web.soil_moisture[0]);
             break;            
         default:
         case false:
-            send_syslog_message("usurper", "Temperature = %d.%d C Wind speed = %d.%d m/s Daily rain = %d.%d mm Weekly rain = %d.%d mm Soil Moisture = %d%%",
-                outside_temp/10, abs(outside_temp%10), wind_speed/10, wind_speed%10, rain_day/10, rain_day%10, rain_week/10, rain_week%10, web.soil_moisture[0]);
+            send_syslog_message("usurper", "Temperature = %s C Wind speed = %s m/s Daily rain = %s mm Weekly rain = %s mm Soil Moisture = %d%%",
+                temperature_string, wind_string, rain_day_string, rain_week_string, web.soil_moisture[0]);
             break;
         }  
     }   
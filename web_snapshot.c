@@ -0,0 +1,276 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "FreeRTOSConfig.h"
+#include "task.h"
+
+#include "weather.h"
+#include "seqlock.h"
+#include "web_snapshot.h"
+
+/*
+ * Consistent snapshots of web variables
+ *
+ * Several tasks on both cores write web field by field while httpd, the udp responders and the api read it from the
+ * tcpip thread.  Each group of related fields has a sequence lock: a producer brackets its stores with
+ * web_write_begin() and web_write_end() and a reader copies the whole group with web_snapshot_*(), retrying if a
+ * producer was part way through.  The bracket is a critical section so producers of the same group are serialised
+ * and never preempted mid update, which keeps a reader's wait for an odd sequence to a few copies.
+ *
+ * The locks are kept outside web because init_web_variables() clears it with memset.  A consumer that reacts to
+ * changes can be woken by web_write_end() with web_snapshot_listen() rather than polling web_epoch().
+ */
+
+// prototypes
+static uint32_t web_snapshot(WEB_GROUP_T group, void (*copy)(void *snapshot), void *snapshot);
+static void web_copy_wind(void *snapshot);
+static void web_copy_weather(void *snapshot);
+static void web_copy_thermostat(void *snapshot);
+static void web_copy_network(void *snapshot);
+static void web_copy_powerwall(void *snapshot);
+
+// external variables
+extern WEB_VARIABLES_T web;
+
+static SEQLOCK_T web_locks[NUM_WEB_GROUPS];
+static TaskHandle_t web_listener = NULL;
+static uint32_t web_listener_groups = 0;
+
+/*!
+ * \brief Start updating a group of web variables
+ *
+ * \param[in]   group     group about to be written
+ *
+ * \return nothing
+ */
+void web_write_begin(WEB_GROUP_T group)
+{
+    taskENTER_CRITICAL();
+    seqlock_write_begin(&web_locks[group]);
+}
+
+/*!
+ * \brief Finish updating a group of web variables
+ *
+ * \param[in]   group     group that was written
+ *
+ * \return nothing
+ */
+void web_write_end(WEB_GROUP_T group)
+{
+    seqlock_write_end(&web_locks[group]);
+    taskEXIT_CRITICAL();
+
+    if (web_listener && (web_listener_groups & (1UL << group)))
+    {
+        xTaskNotifyGiveIndexed(web_listener, 0);
+    }
+}
+
+/*!
+ * \brief Have a task notified when groups of web variables are written
+ *
+ * \param[in]   task      TaskHandle_t of the listener, NULL to stop notifying
+ * \param[in]   groups    bit (1 << group) for each group of interest
+ *
+ * \return nothing
+ */
+void web_snapshot_listen(void *task, uint32_t groups)
+{
+    web_listener_groups = groups;
+    web_listener = (TaskHandle_t)task;
+}
+
+/*!
+ * \brief Copy the anemometer readings
+ *
+ * \param[out]  wind      snapshot
+ *
+ * \return epoch of the copy
+ */
+uint32_t web_snapshot_wind(WEB_WIND_T *wind)
+{
+    return(web_snapshot(WEB_GROUP_WIND, web_copy_wind, wind));
+}
+
+/*!
+ * \brief Copy the weather station readings
+ *
+ * \param[out]  weather   snapshot
+ *
+ * \return epoch of the copy
+ */
+uint32_t web_snapshot_weather(WEB_WEATHER_T *weather)
+{
+    return(web_snapshot(WEB_GROUP_WEATHER, web_copy_weather, weather));
+}
+
+/*!
+ * \brief Copy the thermostat state
+ *
+ * \param[out]  thermostat    snapshot
+ *
+ * \return epoch of the copy
+ */
+uint32_t web_snapshot_thermostat(WEB_THERMOSTAT_T *thermostat)
+{
+    return(web_snapshot(WEB_GROUP_THERMOSTAT, web_copy_thermostat, thermostat));
+}
+
+/*!
+ * \brief Copy the network settings
+ *
+ * \param[out]  network   snapshot
+ *
+ * \return epoch of the copy
+ */
+uint32_t web_snapshot_network(WEB_NETWORK_T *network)
+{
+    return(web_snapshot(WEB_GROUP_NETWORK, web_copy_network, network));
+}
+
+/*!
+ * \brief Copy the powerwall status
+ *
+ * \param[out]  powerwall     snapshot
+ *
+ * \return epoch of the copy
+ */
+uint32_t web_snapshot_powerwall(WEB_POWERWALL_T *powerwall)
+{
+    return(web_snapshot(WEB_GROUP_POWERWALL, web_copy_powerwall, powerwall));
+}
+
+/*!
+ * \brief Current epoch of a group, changes whenever a producer writes to it
+ *
+ * \param[in]   group     group of interest
+ *
+ * \return epoch, comparable with the value returned by web_snapshot_*()
+ */
+uint32_t web_epoch(WEB_GROUP_T group)
+{
+    return(web_locks[group].sequence);
+}
+
+/*!
+ * \brief Copy a group, repeating until no producer interfered
+ *
+ * \param[in]   group     group to copy
+ * \param[in]   copy      copies the group's fields out of web
+ * \param[out]  snapshot  destination
+ *
+ * \return epoch of the copy
+ */
+static uint32_t web_snapshot(WEB_GROUP_T group, void (*copy)(void *snapshot), void *snapshot)
+{
+    uint32_t start;
+
+    do
+    {
+        start = seqlock_read_begin(&web_locks[group]);
+        copy(snapshot);
+    } while (seqlock_read_retry(&web_locks[group], start));
+
+    return(start);
+}
+
+/*!
+ * \brief Copy web.anemometer_*
+ *
+ * \param[out]  snapshot  WEB_WIND_T
+ *
+ * \return nothing
+ */
+static void web_copy_wind(void *snapshot)
+{
+    WEB_WIND_T *wind = (WEB_WIND_T *)snapshot;
+
+    wind->wind_speed = web.anemometer_wind_speed;
+    wind->adc_min = web.anemometer_adc_min;
+    wind->adc_max = web.anemometer_adc_max;
+    wind->sample_time_us = web.anemometer_sample_time_us;
+}
+
+/*!
+ * \brief Copy the weather station fields
+ *
+ * \param[out]  snapshot  WEB_WEATHER_T
+ *
+ * \return nothing
+ */
+static void web_copy_weather(void *snapshot)
+{
+    WEB_WEATHER_T *weather = (WEB_WEATHER_T *)snapshot;
+
+    weather->outside_temperature = web.outside_temperature;
+    weather->wind_speed = web.wind_speed;
+    weather->wind_gust = web.wind_gust;
+    weather->daily_rain = web.daily_rain;
+    weather->weekly_rain = web.weekly_rain;
+    weather->trailing_seven_days_rain = web.trailing_seven_days_rain;
+    memcpy(weather->soil_moisture, web.soil_moisture, sizeof(weather->soil_moisture));
+    weather->us_last_rx_packet = web.us_last_rx_packet;
+}
+
+/*!
+ * \brief Copy web.thermostat_* state
+ *
+ * \param[out]  snapshot  WEB_THERMOSTAT_T
+ *
+ * \return nothing
+ */
+static void web_copy_thermostat(void *snapshot)
+{
+    WEB_THERMOSTAT_T *thermostat = (WEB_THERMOSTAT_T *)snapshot;
+
+    thermostat->temperature = web.thermostat_temperature;
+    thermostat->set_point = web.thermostat_set_point;
+    thermostat->heating_set_point = web.thermostat_heating_set_point;
+    thermostat->cooling_set_point = web.thermostat_cooling_set_point;
+    thermostat->moving_average = web.thermostat_temperature_moving_average;
+    thermostat->gradient = web.thermostat_temperature_gradient;
+    thermostat->prediction = web.thermostat_temperature_prediction;
+    thermostat->effective_mode = web.thermostat_effective_mode;
+}
+
+/*!
+ * \brief Copy the network settings
+ *
+ * \param[out]  snapshot  WEB_NETWORK_T
+ *
+ * \return nothing
+ */
+static void web_copy_network(void *snapshot)
+{
+    WEB_NETWORK_T *network = (WEB_NETWORK_T *)snapshot;
+
+    network->access_point_mode = web.access_point_mode;
+    memcpy(network->ip_address_string, web.ip_address_string, sizeof(network->ip_address_string));
+    memcpy(network->network_mask_string, web.network_mask_string, sizeof(network->network_mask_string));
+    memcpy(network->gateway_string, web.gateway_string, sizeof(network->gateway_string));
+}
+
+/*!
+ * \brief Copy web.powerwall_*
+ *
+ * \param[out]  snapshot  WEB_POWERWALL_T
+ *
+ * \return nothing
+ */
+static void web_copy_powerwall(void *snapshot)
+{
+    WEB_POWERWALL_T *powerwall = (WEB_POWERWALL_T *)snapshot;
+
+    powerwall->grid_status = web.powerwall_grid_status;
+    powerwall->battery_percentage = web.powerwall_battery_percentage;
+    powerwall->update_time_us = web.powerwall_update_time_us;
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024 NewmanIsTheStar
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef WEB_SNAPSHOT_H
+#define WEB_SNAPSHOT_H
+
+#include "weather.h"
+
+// groups of web variables that are always read together
+typedef enum
+{
+    WEB_GROUP_WIND = 0,
+    WEB_GROUP_WEATHER,
+    WEB_GROUP_THERMOSTAT,
+    WEB_GROUP_NETWORK,
+    WEB_GROUP_POWERWALL,
+    NUM_WEB_GROUPS
+} WEB_GROUP_T;
+
+// web.anemometer_*
+typedef struct
+{
+    int wind_speed;
+    int adc_min;
+    int adc_max;
+    uint64_t sample_time_us;
+} WEB_WIND_T;
+
+// weather station readings
+typedef struct
+{
+    int outside_temperature;
+    int wind_speed;
+    int wind_gust;
+    int daily_rain;
+    int weekly_rain;
+    int trailing_seven_days_rain;
+    uint8_t soil_moisture[16];
+    uint32_t us_last_rx_packet;
+} WEB_WEATHER_T;
+
+// web.thermostat_* state computed by the thermostat task
+typedef struct
+{
+    int temperature;
+    int set_point;
+    int heating_set_point;
+    int cooling_set_point;
+    int moving_average;
+    int gradient;
+    int prediction;
+    THERMOSTAT_MODE_T effective_mode;
+} WEB_THERMOSTAT_T;
+
+typedef struct
+{
+    int access_point_mode;
+    char ip_address_string[50];
+    char network_mask_string[50];
+    char gateway_string[50];
+} WEB_NETWORK_T;
+
+// web.powerwall_* published by the powerwall task
+typedef struct
+{
+    int grid_status;
+    int battery_percentage;
+    uint64_t update_time_us;
+} WEB_POWERWALL_T;
+
+// producers bracket every store to a group's fields in web, keep the bracketed code short
+void web_write_begin(WEB_GROUP_T group);
+void web_write_end(WEB_GROUP_T group);
+
+// consistent copies for readers on any task or core, each returns the epoch it was taken at
+uint32_t web_snapshot_wind(WEB_WIND_T *wind);
+uint32_t web_snapshot_weather(WEB_WEATHER_T *weather);
+uint32_t web_snapshot_thermostat(WEB_THERMOSTAT_T *thermostat);
+uint32_t web_snapshot_network(WEB_NETWORK_T *network);
+uint32_t web_snapshot_powerwall(WEB_POWERWALL_T *powerwall);
+uint32_t web_epoch(WEB_GROUP_T group);
+
+// wake a task whenever one of the groups in a mask of (1 << WEB_GROUP_*) is written
+void web_snapshot_listen(void *task, uint32_t groups);
+
+#endif